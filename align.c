@@ -0,0 +1,515 @@
+/****************************************************************************
+ *
+ * Copyright 2021 Lee Mitchell <lee@indigopepper.com>
+ * This file is part of OCC (Orlaco Camera Configurator)
+ *
+ * OCC (Orlaco Camera Configurator) is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * OCC (Orlaco Camera Configurator) is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with OCC (Orlaco Camera Configurator).  If not,
+ * see <http://www.gnu.org/licenses/>.
+ *
+ ****************************************************************************/
+
+/****************************************************************************/
+/***        Include files                                                 ***/
+/****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "common.h"
+#include "mjpeg.h"
+#include "align.h"
+
+/****************************************************************************/
+/***        Macro Definitions                                             ***/
+/****************************************************************************/
+
+/****************************************************************************/
+/***        Type Definitions                                              ***/
+/****************************************************************************/
+
+/****************************************************************************/
+/***        Local Function Prototypes                                     ***/
+/****************************************************************************/
+
+static bool_t ALIGN_bQueueFrame(ALIGN_tsCamera *psCamera, RTP_tsFrame *psFrame, uint64_t u64CaptureTimeUs);
+static void ALIGN_vPop(ALIGN_tsCamera *psCamera);
+static void ALIGN_vMatch(ALIGN_tsInstance *psAlign);
+static void ALIGN_vFinishSet(ALIGN_tsInstance *psAlign, uint64_t u64TimeUs, uint64_t u64SkewUs);
+static void ALIGN_vEmitSet(ALIGN_tsInstance *psAlign, ALIGN_tsSet *psSet);
+#ifndef _WIN32
+static void *ALIGN_pvOutputThread(void *pvAlign);
+#endif
+
+/****************************************************************************/
+/***        Exported Variables                                            ***/
+/****************************************************************************/
+
+/****************************************************************************/
+/***        Local Variables                                               ***/
+/****************************************************************************/
+
+/****************************************************************************/
+/***        Exported Functions                                            ***/
+/****************************************************************************/
+
+/****************************************************************************
+ *
+ * NAME: ALIGN_bInit
+ *
+ * DESCRIPTION:
+ * Prepares to group the frames of the given cameras into sets taken within
+ * u32ToleranceUs of each other, and starts the thread that prints and
+ * writes the sets
+ *
+ * RETURNS:
+ * bool_t TRUE if successful, FALSE otherwise
+ *
+ ****************************************************************************/
+bool_t ALIGN_bInit(ALIGN_tsInstance *psAlign, ORLACO_tuIP *puCameraIPs, uint32_t u32NumCameras, uint32_t u32ToleranceUs, char *pcPrefix)
+{
+    uint32_t n;
+
+    memset(psAlign, 0, sizeof(ALIGN_tsInstance));
+
+    if((u32NumCameras < 2) || (u32NumCameras > ALIGN_MAX_CAMERAS))
+    {
+        printf("Error: Aligning needs 2 to %d cameras in %s\n", ALIGN_MAX_CAMERAS, __FUNCTION__);
+        return FALSE;
+    }
+
+    for(n = 0; n < u32NumCameras; n++)
+    {
+        psAlign->asCameras[n].uIP = puCameraIPs[n];
+    }
+    psAlign->u32NumCameras = u32NumCameras;
+    psAlign->u32ToleranceUs = (u32ToleranceUs != 0) ? u32ToleranceUs : ALIGN_DEFAULT_TOLERANCE_US;
+    psAlign->pcPrefix = pcPrefix;
+
+#ifndef _WIN32
+    pthread_mutex_init(&psAlign->sLock, NULL);
+    pthread_cond_init(&psAlign->sSetReady, NULL);
+    if(pthread_create(&psAlign->sThread, NULL, ALIGN_pvOutputThread, psAlign) != 0)
+    {
+        printf("Error: Failed to start the set output in %s\n", __FUNCTION__);
+        pthread_cond_destroy(&psAlign->sSetReady);
+        pthread_mutex_destroy(&psAlign->sLock);
+        psAlign->u32NumCameras = 0;
+        return FALSE;
+    }
+#endif
+
+    return TRUE;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: ALIGN_vDeInit
+ *
+ * DESCRIPTION:
+ * Waits for the sets already found to be output, then frees the queued
+ * frames
+ *
+ * RETURNS:
+ * void
+ *
+ ****************************************************************************/
+void ALIGN_vDeInit(ALIGN_tsInstance *psAlign)
+{
+    uint32_t n;
+    uint32_t s;
+
+#ifndef _WIN32
+    if(psAlign->u32NumCameras != 0)
+    {
+        pthread_mutex_lock(&psAlign->sLock);
+        psAlign->bStop = TRUE;
+        pthread_cond_signal(&psAlign->sSetReady);
+        pthread_mutex_unlock(&psAlign->sLock);
+        pthread_join(psAlign->sThread, NULL);
+    }
+#endif
+
+    for(s = 0; s < ALIGN_OUTPUT_SETS; s++)
+    {
+        for(n = 0; n < ALIGN_MAX_CAMERAS; n++)
+        {
+            free(psAlign->asSets[s].asSlots[n].pu8Buffer);
+            psAlign->asSets[s].asSlots[n].pu8Buffer = NULL;
+        }
+    }
+
+    for(n = 0; n < psAlign->u32NumCameras; n++)
+    {
+        for(s = 0; s < ALIGN_QUEUE_LENGTH; s++)
+        {
+            free(psAlign->asCameras[n].asSlots[s].pu8Buffer);
+            psAlign->asCameras[n].asSlots[s].pu8Buffer = NULL;
+        }
+    }
+
+#ifndef _WIN32
+    if(psAlign->u32NumCameras != 0)
+    {
+        pthread_cond_destroy(&psAlign->sSetReady);
+        pthread_mutex_destroy(&psAlign->sLock);
+    }
+#endif
+}
+
+
+/****************************************************************************
+ *
+ * NAME: ALIGN_vPushFrame
+ *
+ * DESCRIPTION:
+ * Queues a frame and hands every set that can now be completed to the
+ * output thread. A capture time of 0 means the camera's clock isn't known
+ * yet, and the frame is only counted. Safe to call from any worker.
+ *
+ * RETURNS:
+ * void
+ *
+ ****************************************************************************/
+void ALIGN_vPushFrame(ALIGN_tsInstance *psAlign, RTP_tsFrame *psFrame, uint64_t u64CaptureTimeUs)
+{
+    ALIGN_tsCamera *psCamera = NULL;
+    uint32_t n;
+
+    for(n = 0; n < psAlign->u32NumCameras; n++)
+    {
+        if(psAlign->asCameras[n].uIP.u32IP == psFrame->uSrcIP.u32IP)
+        {
+            psCamera = &psAlign->asCameras[n];
+            break;
+        }
+    }
+    if(psCamera == NULL)
+    {
+        return;
+    }
+
+#ifndef _WIN32
+    pthread_mutex_lock(&psAlign->sLock);
+#endif
+
+    if(u64CaptureTimeUs == 0)
+    {
+        psAlign->u64Unsynced++;
+    }
+    else if(ALIGN_bQueueFrame(psCamera, psFrame, u64CaptureTimeUs))
+    {
+        ALIGN_vMatch(psAlign);
+    }
+
+#ifndef _WIN32
+    pthread_mutex_unlock(&psAlign->sLock);
+#else
+    // No output thread here, so the single worker outputs the sets itself
+    while(psAlign->u32SetCount > 0)
+    {
+        ALIGN_vEmitSet(psAlign, &psAlign->asSets[psAlign->u32SetHead]);
+        psAlign->u32SetHead = (psAlign->u32SetHead + 1) % ALIGN_OUTPUT_SETS;
+        psAlign->u32SetCount--;
+    }
+#endif
+}
+
+/****************************************************************************/
+/***        Local Functions                                               ***/
+/****************************************************************************/
+
+/****************************************************************************
+ *
+ * NAME: ALIGN_bQueueFrame
+ *
+ * DESCRIPTION:
+ * Copies a frame onto the end of a camera's queue, dropping the oldest
+ * frame if the queue is full. Frames must arrive in capture order.
+ *
+ * RETURNS:
+ * bool_t TRUE if the frame was queued, FALSE otherwise
+ *
+ ****************************************************************************/
+static bool_t ALIGN_bQueueFrame(ALIGN_tsCamera *psCamera, RTP_tsFrame *psFrame, uint64_t u64CaptureTimeUs)
+{
+    ALIGN_tsSlot *psSlot;
+    uint8_t *pu8Buffer;
+
+    psCamera->u64Frames++;
+
+    if((u64CaptureTimeUs <= psCamera->u64LastCaptureTimeUs) || (psFrame->u32Length > ALIGN_MAX_FRAME_LENGTH))
+    {
+        psCamera->u64Dropped++;
+        return FALSE;
+    }
+    psCamera->u64LastCaptureTimeUs = u64CaptureTimeUs;
+
+    if(psCamera->u32Count == ALIGN_QUEUE_LENGTH)
+    {
+        ALIGN_vPop(psCamera);
+        psCamera->u64Dropped++;
+    }
+
+    psSlot = &psCamera->asSlots[(psCamera->u32Head + psCamera->u32Count) % ALIGN_QUEUE_LENGTH];
+    if(psSlot->u32BufferLength < psFrame->u32Length)
+    {
+        pu8Buffer = (uint8_t*)realloc(psSlot->pu8Buffer, psFrame->u32Length);
+        if(pu8Buffer == NULL)
+        {
+            printf("Error: Failed to allocate memory for frame in %s\n", __FUNCTION__);
+            psCamera->u64Dropped++;
+            return FALSE;
+        }
+        psSlot->pu8Buffer = pu8Buffer;
+        psSlot->u32BufferLength = psFrame->u32Length;
+    }
+
+    memcpy(psSlot->pu8Buffer, psFrame->pu8Data, psFrame->u32Length);
+    memcpy(&psSlot->sFrame, psFrame, sizeof(RTP_tsFrame));
+    psSlot->sFrame.pu8Data = psSlot->pu8Buffer;
+    psSlot->u64CaptureTimeUs = u64CaptureTimeUs;
+    psCamera->u32Count++;
+
+    return TRUE;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: ALIGN_vPop
+ *
+ * DESCRIPTION:
+ * Removes the oldest frame from a camera's queue
+ *
+ * RETURNS:
+ * void
+ *
+ ****************************************************************************/
+static void ALIGN_vPop(ALIGN_tsCamera *psCamera)
+{
+    psCamera->u32Head = (psCamera->u32Head + 1) % ALIGN_QUEUE_LENGTH;
+    psCamera->u32Count--;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: ALIGN_vMatch
+ *
+ * DESCRIPTION:
+ * Emits sets while every camera has a frame queued. The latest of the
+ * oldest frames sets the reference time; any camera whose oldest frame is
+ * more than the tolerance before it can never join that set, so the frame
+ * is dropped and the next one tried. Once all are within the tolerance
+ * they form a set.
+ *
+ * RETURNS:
+ * void
+ *
+ ****************************************************************************/
+static void ALIGN_vMatch(ALIGN_tsInstance *psAlign)
+{
+    ALIGN_tsCamera *psCamera;
+    uint64_t u64ReferenceUs;
+    uint64_t u64EarliestUs;
+    uint64_t u64TimeUs;
+    bool_t bDropped;
+    uint32_t n;
+
+    while(TRUE)
+    {
+        u64ReferenceUs = 0;
+        u64EarliestUs = UINT64_MAX;
+        for(n = 0; n < psAlign->u32NumCameras; n++)
+        {
+            psCamera = &psAlign->asCameras[n];
+            if(psCamera->u32Count == 0)
+            {
+                return;
+            }
+            u64TimeUs = psCamera->asSlots[psCamera->u32Head].u64CaptureTimeUs;
+            if(u64TimeUs > u64ReferenceUs) u64ReferenceUs = u64TimeUs;
+            if(u64TimeUs < u64EarliestUs) u64EarliestUs = u64TimeUs;
+        }
+
+        bDropped = FALSE;
+        for(n = 0; n < psAlign->u32NumCameras; n++)
+        {
+            psCamera = &psAlign->asCameras[n];
+            if(psCamera->asSlots[psCamera->u32Head].u64CaptureTimeUs + psAlign->u32ToleranceUs < u64ReferenceUs)
+            {
+                ALIGN_vPop(psCamera);
+                psCamera->u64Dropped++;
+                bDropped = TRUE;
+            }
+        }
+
+        if(!bDropped)
+        {
+            ALIGN_vFinishSet(psAlign, u64ReferenceUs, u64ReferenceUs - u64EarliestUs);
+            for(n = 0; n < psAlign->u32NumCameras; n++)
+            {
+                ALIGN_vPop(&psAlign->asCameras[n]);
+            }
+        }
+    }
+}
+
+
+/****************************************************************************
+ *
+ * NAME: ALIGN_vFinishSet
+ *
+ * DESCRIPTION:
+ * Counts a set of frames, one at the head of each camera's queue, and
+ * queues it for output by swapping the frames' buffers with those of a
+ * free output set, so nothing is copied. If the output is too far behind
+ * the set is only counted.
+ *
+ * RETURNS:
+ * void
+ *
+ ****************************************************************************/
+static void ALIGN_vFinishSet(ALIGN_tsInstance *psAlign, uint64_t u64TimeUs, uint64_t u64SkewUs)
+{
+    ALIGN_tsCamera *psCamera;
+    ALIGN_tsSlot sSpare;
+    ALIGN_tsSet *psSet;
+    uint32_t n;
+
+    if(psAlign->u32SetCount == ALIGN_OUTPUT_SETS)
+    {
+        psAlign->u64SetsDropped++;
+    }
+    else
+    {
+        psSet = &psAlign->asSets[(psAlign->u32SetHead + psAlign->u32SetCount) % ALIGN_OUTPUT_SETS];
+        psSet->u32Set = psAlign->u32Sets;
+        psSet->u64TimeUs = u64TimeUs;
+        psSet->u64SkewUs = u64SkewUs;
+        for(n = 0; n < psAlign->u32NumCameras; n++)
+        {
+            psCamera = &psAlign->asCameras[n];
+            sSpare = psSet->asSlots[n];
+            psSet->asSlots[n] = psCamera->asSlots[psCamera->u32Head];
+            psCamera->asSlots[psCamera->u32Head] = sSpare;
+        }
+        psAlign->u32SetCount++;
+#ifndef _WIN32
+        pthread_cond_signal(&psAlign->sSetReady);
+#endif
+    }
+
+    psAlign->u32Sets++;
+    psAlign->u64SkewSumUs += u64SkewUs;
+    if(u64SkewUs > psAlign->u64SkewMaxUs)
+    {
+        psAlign->u64SkewMaxUs = u64SkewUs;
+    }
+}
+
+
+/****************************************************************************
+ *
+ * NAME: ALIGN_vEmitSet
+ *
+ * DESCRIPTION:
+ * Prints a set as a line of JSON with each frame's offset from the latest,
+ * and writes the JPEG frames to <prefix>_<ip>_<ssrc>_<set>.jpg if enabled
+ *
+ * RETURNS:
+ * void
+ *
+ ****************************************************************************/
+static void ALIGN_vEmitSet(ALIGN_tsInstance *psAlign, ALIGN_tsSet *psSet)
+{
+    ALIGN_tsSlot *psSlot;
+    uint32_t n;
+
+    printf("{\"set\":%u,\"time_us\":%llu,\"skew_us\":%llu,\"frames\":[",
+           psSet->u32Set, (unsigned long long)psSet->u64TimeUs, (unsigned long long)psSet->u64SkewUs);
+
+    for(n = 0; n < psAlign->u32NumCameras; n++)
+    {
+        psSlot = &psSet->asSlots[n];
+        printf("%s{\"camera\":\"%d.%d.%d.%d\",\"ssrc\":\"%08x\",\"rtp\":%u,\"offset_us\":-%llu}",
+               (n == 0) ? "" : ",",
+               psSlot->sFrame.uSrcIP.au8IP[3],
+               psSlot->sFrame.uSrcIP.au8IP[2],
+               psSlot->sFrame.uSrcIP.au8IP[1],
+               psSlot->sFrame.uSrcIP.au8IP[0],
+               psSlot->sFrame.u32Ssrc,
+               psSlot->sFrame.u32Timestamp,
+               (unsigned long long)(psSet->u64TimeUs - psSlot->u64CaptureTimeUs));
+
+        if((psAlign->pcPrefix != NULL) && (psSlot->sFrame.eCodec == E_RTP_CODEC_JPEG))
+        {
+            MJPEG_bWriteFrameToFile(&psSlot->sFrame, psAlign->pcPrefix, psSet->u32Set);
+        }
+    }
+    printf("]}\n");
+    fflush(stdout);
+}
+
+
+#ifndef _WIN32
+/****************************************************************************
+ *
+ * NAME: ALIGN_pvOutputThread
+ *
+ * DESCRIPTION:
+ * Prints and writes the sets in the order they were found, without holding
+ * the lock the workers queue frames under. The set at the head stays out of
+ * the workers' reach until it's done. Once stopped, the sets still queued
+ * are output before it returns.
+ *
+ * RETURNS:
+ * void * - Always NULL
+ *
+ ****************************************************************************/
+static void *ALIGN_pvOutputThread(void *pvAlign)
+{
+    ALIGN_tsInstance *psAlign = (ALIGN_tsInstance *)pvAlign;
+    ALIGN_tsSet *psSet;
+
+    pthread_mutex_lock(&psAlign->sLock);
+    while(TRUE)
+    {
+        while((psAlign->u32SetCount == 0) && !psAlign->bStop)
+        {
+            pthread_cond_wait(&psAlign->sSetReady, &psAlign->sLock);
+        }
+        if(psAlign->u32SetCount == 0)
+        {
+            break;
+        }
+        psSet = &psAlign->asSets[psAlign->u32SetHead];
+        pthread_mutex_unlock(&psAlign->sLock);
+
+        ALIGN_vEmitSet(psAlign, psSet);
+
+        pthread_mutex_lock(&psAlign->sLock);
+        psAlign->u32SetHead = (psAlign->u32SetHead + 1) % ALIGN_OUTPUT_SETS;
+        psAlign->u32SetCount--;
+    }
+    pthread_mutex_unlock(&psAlign->sLock);
+
+    return NULL;
+}
+#endif
+
+/****************************************************************************/
+/***        END OF FILE                                                   ***/
+/****************************************************************************/
@@ -0,0 +1,93 @@
+#ifndef ALIGN_H
+#define ALIGN_H
+
+/****************************************************************************/
+/***        Include files                                                 ***/
+/****************************************************************************/
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#ifndef _WIN32
+#include <pthread.h>
+#endif
+
+#include "common.h"
+#include "orlaco.h"
+#include "rtp.h"
+
+/****************************************************************************/
+/***        Macro Definitions                                             ***/
+/****************************************************************************/
+
+#define ALIGN_MAX_CAMERAS               16
+#define ALIGN_QUEUE_LENGTH              8                   // Frames held per camera while waiting for the others
+#define ALIGN_DEFAULT_TOLERANCE_US      10000
+#define ALIGN_MAX_FRAME_LENGTH          (8 * 1024 * 1024)
+#define ALIGN_OUTPUT_SETS               4                   // Finished sets held while the output thread catches up
+
+/****************************************************************************/
+/***        Type Definitions                                              ***/
+/****************************************************************************/
+
+typedef struct {
+    uint64_t u64CaptureTimeUs;                      // Wall clock time the frame was taken, from the camera's sender reports
+    RTP_tsFrame sFrame;                             // pu8Data points into pu8Buffer
+    uint8_t *pu8Buffer;
+    uint32_t u32BufferLength;
+} ALIGN_tsSlot;
+
+typedef struct {
+    ORLACO_tuIP uIP;
+    ALIGN_tsSlot asSlots[ALIGN_QUEUE_LENGTH];
+    uint32_t u32Head;
+    uint32_t u32Count;
+    uint64_t u64LastCaptureTimeUs;
+    uint64_t u64Frames;
+    uint64_t u64Dropped;                            // Frames that weren't part of any set
+} ALIGN_tsCamera;
+
+// A finished set, its frames taken over from the head of each camera's queue
+typedef struct {
+    uint32_t u32Set;
+    uint64_t u64TimeUs;
+    uint64_t u64SkewUs;
+    ALIGN_tsSlot asSlots[ALIGN_MAX_CAMERAS];
+} ALIGN_tsSet;
+
+// Groups frames taken at the same instant by a fixed set of cameras. Each camera
+// has a short queue, so buffering is bounded however far apart the streams are.
+typedef struct {
+    ALIGN_tsCamera asCameras[ALIGN_MAX_CAMERAS];
+    uint32_t u32NumCameras;
+    uint32_t u32ToleranceUs;                        // Largest skew accepted within a set
+    char *pcPrefix;                                 // Write the JPEG frames of each set to files with this prefix, NULL to disable
+    uint32_t u32Sets;
+    uint64_t u64SkewSumUs;
+    uint64_t u64SkewMaxUs;
+    uint64_t u64Unsynced;                           // Frames from cameras that haven't sent a sender report yet
+    ALIGN_tsSet asSets[ALIGN_OUTPUT_SETS];          // Printed and written away from the workers, oldest at u32SetHead
+    uint32_t u32SetHead;
+    uint32_t u32SetCount;
+    uint64_t u64SetsDropped;                        // Sets found while the output was too far behind to take them
+#ifndef _WIN32
+    pthread_mutex_t sLock;                          // Frames arrive from every worker
+    pthread_cond_t sSetReady;
+    volatile bool_t bStop;
+    pthread_t sThread;
+#endif
+} ALIGN_tsInstance;
+
+/****************************************************************************/
+/***        Exported Functions                                            ***/
+/****************************************************************************/
+
+bool_t ALIGN_bInit(ALIGN_tsInstance *psAlign, ORLACO_tuIP *puCameraIPs, uint32_t u32NumCameras, uint32_t u32ToleranceUs, char *pcPrefix);
+void ALIGN_vDeInit(ALIGN_tsInstance *psAlign);
+void ALIGN_vPushFrame(ALIGN_tsInstance *psAlign, RTP_tsFrame *psFrame, uint64_t u64CaptureTimeUs);
+
+#endif // ALIGN_H
+
+/****************************************************************************/
+/***        END OF FILE                                                   ***/
+/****************************************************************************/
@@ -0,0 +1,1297 @@
+/****************************************************************************
+ *
+ * Copyright 2021 Lee Mitchell <lee@indigopepper.com>
+ * This file is part of OCC (Orlaco Camera Configurator)
+ *
+ * OCC (Orlaco Camera Configurator) is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * OCC (Orlaco Camera Configurator) is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with OCC (Orlaco Camera Configurator).  If not,
+ * see <http://www.gnu.org/licenses/>.
+ *
+ ****************************************************************************/
+
+// Needed for struct ucred
+#ifdef __linux__
+#define _GNU_SOURCE
+#endif
+
+/****************************************************************************/
+/***        Include files                                                 ***/
+/****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "common.h"
+#include "daemon.h"
+
+#ifndef _WIN32
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#endif
+
+/****************************************************************************/
+/***        Macro Definitions                                             ***/
+/****************************************************************************/
+
+#define DAEMON_CLIENT_POLL_MS           100                 // How often a client checks for signals to pass on
+#define DAEMON_MAX_PATH_LENGTH          104                 // The shortest sun_path of the platforms
+
+/****************************************************************************/
+/***        Type Definitions                                              ***/
+/****************************************************************************/
+
+/****************************************************************************/
+/***        Local Function Prototypes                                     ***/
+/****************************************************************************/
+
+#ifndef _WIN32
+static char *DAEMON_pcGetDefaultPath(bool_t bCreate);
+static bool_t DAEMON_bIsOwnUser(int iSocket);
+static int DAEMON_iConnect(char *pcPath);
+static int DAEMON_iReceive(DAEMON_tsClient *psClient);
+static bool_t DAEMON_bParseRequest(DAEMON_tsInstance *psDaemon, DAEMON_tsClient *psClient, uint32_t u32Length);
+static void DAEMON_vClassify(DAEMON_tsInstance *psDaemon, DAEMON_tsClient *psClient);
+static bool_t DAEMON_bHasRoomForBulk(DAEMON_tsInstance *psDaemon, uint32_t u32Index);
+static int32_t DAEMON_i32NextRequest(DAEMON_tsInstance *psDaemon);
+static DAEMON_tsShare *DAEMON_psGetShare(DAEMON_tsInstance *psDaemon, char *pcCamera, bool_t bCreate);
+static void DAEMON_vMoveToFront(DAEMON_tsInstance *psDaemon, uint32_t u32Index);
+static bool_t DAEMON_bStartRequest(DAEMON_tsInstance *psDaemon);
+static void DAEMON_vFinishRequest(DAEMON_tsInstance *psDaemon);
+static void DAEMON_vRemoveClient(DAEMON_tsInstance *psDaemon, uint32_t u32Index);
+static void DAEMON_vCloseClient(DAEMON_tsClient *psClient);
+#endif
+
+/****************************************************************************/
+/***        Exported Variables                                            ***/
+/****************************************************************************/
+
+/****************************************************************************/
+/***        Local Variables                                               ***/
+/****************************************************************************/
+
+#ifndef _WIN32
+static char acDefaultPath[DAEMON_MAX_PATH_LENGTH];
+#endif
+
+/****************************************************************************/
+/***        Exported Functions                                            ***/
+/****************************************************************************/
+
+/****************************************************************************
+ *
+ * NAME: DAEMON_bInit
+ *
+ * DESCRIPTION:
+ * Listens for clients on the Unix socket at pcPath, or the per-user one if
+ * pcPath is DAEMON_DEFAULT_SOCKET, replacing a stale one but not one a
+ * running daemon still answers on. The socket is only accessible to us.
+ * pcOptions and psLongOptions are those requests will be parsed with.
+ *
+ * RETURNS:
+ * bool_t TRUE if successful, FALSE otherwise
+ *
+ ****************************************************************************/
+bool_t DAEMON_bInit(DAEMON_tsInstance *psDaemon, char *pcPath, const char *pcOptions, const struct option *psLongOptions)
+{
+    memset(psDaemon, 0, sizeof(DAEMON_tsInstance));
+    psDaemon->iSocket = -1;
+    psDaemon->iChildPipe = -1;
+    psDaemon->pcOptions = pcOptions;
+    psDaemon->psLongOptions = psLongOptions;
+
+#ifdef _WIN32
+    (void)pcPath;
+    printf("Error: The daemon isn't supported on this platform\n");
+    return FALSE;
+#else
+    {
+        struct sockaddr_un sAddr;
+        mode_t tMask;
+        int iSocket;
+        int iResult;
+
+        if(strcmp(pcPath, DAEMON_DEFAULT_SOCKET) == 0)
+        {
+            pcPath = DAEMON_pcGetDefaultPath(TRUE);
+            if(pcPath == NULL)
+            {
+                return FALSE;
+            }
+        }
+        psDaemon->pcPath = pcPath;
+
+        if(strlen(pcPath) >= sizeof(sAddr.sun_path))
+        {
+            printf("Error: Socket path %s is too long in %s\n", pcPath, __FUNCTION__);
+            return FALSE;
+        }
+
+        iSocket = DAEMON_iConnect(pcPath);
+        if(iSocket >= 0)
+        {
+            close(iSocket);
+            printf("Error: A daemon is already running on %s in %s\n", pcPath, __FUNCTION__);
+            return FALSE;
+        }
+
+        psDaemon->iSocket = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+        if(psDaemon->iSocket < 0)
+        {
+            printf("Error: Failed to create socket in %s\n", __FUNCTION__);
+            return FALSE;
+        }
+
+        memset(&sAddr, 0, sizeof(sAddr));
+        sAddr.sun_family = AF_UNIX;
+        strcpy(sAddr.sun_path, pcPath);
+        unlink(pcPath);
+
+        // Created without access for anyone else, as a client's requests run as us
+        tMask = umask(0077);
+        iResult = bind(psDaemon->iSocket, (struct sockaddr*)&sAddr, sizeof(sAddr));
+        umask(tMask);
+        if((iResult < 0) || (listen(psDaemon->iSocket, DAEMON_MAX_CLIENTS) < 0))
+        {
+            printf("Error: Failed to listen on %s in %s\n", pcPath, __FUNCTION__);
+            close(psDaemon->iSocket);
+            psDaemon->iSocket = -1;
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+#endif
+}
+
+
+/****************************************************************************
+ *
+ * NAME: DAEMON_vDeInit
+ *
+ * DESCRIPTION:
+ * Stops the running request, drops the clients and removes the socket
+ *
+ * RETURNS:
+ * void
+ *
+ ****************************************************************************/
+void DAEMON_vDeInit(DAEMON_tsInstance *psDaemon)
+{
+#ifndef _WIN32
+    if(psDaemon->iChild != 0)
+    {
+        kill(psDaemon->iChild, SIGINT);
+        DAEMON_vFinishRequest(psDaemon);
+    }
+
+    while(psDaemon->u32NumClients > 0)
+    {
+        DAEMON_vRemoveClient(psDaemon, psDaemon->u32NumClients - 1);
+    }
+
+    if(psDaemon->iSocket >= 0)
+    {
+        close(psDaemon->iSocket);
+        psDaemon->iSocket = -1;
+        unlink(psDaemon->pcPath);
+    }
+#else
+    (void)psDaemon;
+#endif
+}
+
+
+/****************************************************************************
+ *
+ * NAME: DAEMON_bService
+ *
+ * DESCRIPTION:
+ * Waits up to u32TimeoutMs for clients, their requests and signals, and for
+ * the running request to exit, then starts the next request if none is
+ * running. That forks, and in the child *piArgc and *pppcArgv are the
+ * command line to run, with stdin, stdout and stderr those of the client.
+ * A bulk request that would take more than its share of the queue is sent
+ * back as busy as soon as it arrives.
+ *
+ * RETURNS:
+ * bool_t TRUE in the child that is to run a request, FALSE otherwise
+ *
+ ****************************************************************************/
+bool_t DAEMON_bService(DAEMON_tsInstance *psDaemon, uint32_t u32TimeoutMs, int *piArgc, char ***pppcArgv)
+{
+#ifdef _WIN32
+    (void)psDaemon; (void)u32TimeoutMs; (void)piArgc; (void)pppcArgv;
+    return FALSE;
+#else
+    struct pollfd asPoll[DAEMON_MAX_CLIENTS + 2];
+    DAEMON_tsClient *psClient;
+    uint8_t au8Message[2];
+    uint32_t u32NumClients = psDaemon->u32NumClients;
+    int32_t i32Next;
+    uint32_t n;
+    int iLength;
+
+    asPoll[0].fd = psDaemon->iSocket;
+    asPoll[0].events = POLLIN;
+    asPoll[1].fd = psDaemon->iChildPipe;
+    asPoll[1].events = POLLIN;
+    for(n = 0; n < u32NumClients; n++)
+    {
+        asPoll[n + 2].fd = psDaemon->asClients[n].iSocket;
+        asPoll[n + 2].events = POLLIN;
+    }
+
+    if(poll(asPoll, u32NumClients + 2, (int)u32TimeoutMs) <= 0)
+    {
+        return FALSE;
+    }
+
+    for(n = u32NumClients; n-- > 0;)
+    {
+        if(asPoll[n + 2].revents == 0)
+        {
+            continue;
+        }
+        psClient = &psDaemon->asClients[n];
+
+        if(psClient->iArgc == 0)
+        {
+            iLength = DAEMON_iReceive(psClient);
+            if((iLength <= 0) || !DAEMON_bParseRequest(psDaemon, psClient, (uint32_t)iLength))
+            {
+                DAEMON_vRemoveClient(psDaemon, n);
+            }
+            else if((psClient->eClass == E_DAEMON_CLASS_BULK) && !psClient->bOneCamera)
+            {
+                // A request holds the camera socket until it ends, so bulk ones are kept to one camera to bound the wait of the others
+                if(psClient->aiFds[2] >= 0)
+                {
+                    dprintf(psClient->aiFds[2], "Error: A bulk command is for the one camera given with -i, run one per camera\n");
+                }
+                au8Message[0] = DAEMON_MSG_EXIT;
+                au8Message[1] = EXIT_FAILURE;
+                send(psClient->iSocket, au8Message, 2, MSG_NOSIGNAL);
+                DAEMON_vRemoveClient(psDaemon, n);
+            }
+            else if((psClient->eClass == E_DAEMON_CLASS_BULK) && !DAEMON_bHasRoomForBulk(psDaemon, n))
+            {
+                au8Message[0] = DAEMON_MSG_BUSY;
+                au8Message[1] = 0;
+                send(psClient->iSocket, au8Message, 2, MSG_NOSIGNAL);
+                DAEMON_vRemoveClient(psDaemon, n);
+                psDaemon->u32Busy++;
+            }
+            continue;
+        }
+
+        iLength = recv(psClient->iSocket, au8Message, sizeof(au8Message), MSG_DONTWAIT);
+        if((iLength == 2) && (au8Message[0] == DAEMON_MSG_SIGNAL))
+        {
+            if((n == 0) && (psDaemon->iChild != 0))
+            {
+                kill(psDaemon->iChild, au8Message[1]);
+            }
+            else if(au8Message[1] != SIGUSR1)
+            {
+                // Given up on while still queued
+                au8Message[0] = DAEMON_MSG_EXIT;
+                au8Message[1] = (uint8_t)(128 + au8Message[1]);
+                send(psClient->iSocket, au8Message, 2, MSG_NOSIGNAL);
+                DAEMON_vRemoveClient(psDaemon, n);
+            }
+        }
+        else if((iLength == 0) || ((iLength < 0) && (errno != EAGAIN) && (errno != EWOULDBLOCK)))
+        {
+            if((n == 0) && (psDaemon->iChild != 0))
+            {
+                // Nobody is left to see the output, so stop the request
+                kill(psDaemon->iChild, SIGINT);
+                DAEMON_vCloseClient(psClient);
+            }
+            else
+            {
+                DAEMON_vRemoveClient(psDaemon, n);
+            }
+        }
+    }
+
+    // After the clients, as finishing the request moves them up one
+    if((psDaemon->iChild != 0) && (asPoll[1].revents != 0))
+    {
+        DAEMON_vFinishRequest(psDaemon);
+    }
+
+    if(asPoll[0].revents & POLLIN)
+    {
+        int iSocket = accept(psDaemon->iSocket, NULL, NULL);
+        if(iSocket >= 0)
+        {
+            if(!DAEMON_bIsOwnUser(iSocket))
+            {
+                printf("Warning: Refused a client run by another user\n");
+                close(iSocket);
+            }
+            else if(psDaemon->u32NumClients < DAEMON_MAX_CLIENTS)
+            {
+                psClient = &psDaemon->asClients[psDaemon->u32NumClients++];
+                memset(psClient, 0, sizeof(DAEMON_tsClient));
+                psClient->iSocket = iSocket;
+                psClient->aiFds[0] = psClient->aiFds[1] = psClient->aiFds[2] = -1;
+            }
+            else
+            {
+                printf("Warning: Too many clients, dropped one\n");
+                close(iSocket);
+            }
+        }
+    }
+
+    if((psDaemon->iChild == 0) && ((i32Next = DAEMON_i32NextRequest(psDaemon)) >= 0))
+    {
+        DAEMON_vMoveToFront(psDaemon, (uint32_t)i32Next);
+        if(DAEMON_bStartRequest(psDaemon))
+        {
+            *piArgc = psDaemon->asClients[0].iArgc;
+            *pppcArgv = psDaemon->asClients[0].apcArgv;
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+#endif
+}
+
+
+/****************************************************************************
+ *
+ * NAME: DAEMON_bIsBusy
+ *
+ * DESCRIPTION:
+ * Whether a request is running, and so using the camera socket
+ *
+ * RETURNS:
+ * bool_t TRUE if a request is running, FALSE otherwise
+ *
+ ****************************************************************************/
+bool_t DAEMON_bIsBusy(DAEMON_tsInstance *psDaemon)
+{
+    return (psDaemon->iChild != 0) ? TRUE : FALSE;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: DAEMON_pcGetSocketPath
+ *
+ * DESCRIPTION:
+ * Where clients look for the daemon, given by DAEMON_SOCKET_VARIABLE.
+ * Commands are only forwarded when it's set, so a socket someone else
+ * created can't take them over unasked.
+ *
+ * RETURNS:
+ * char * The path, NULL if commands are to run locally
+ *
+ ****************************************************************************/
+char *DAEMON_pcGetSocketPath(void)
+{
+#ifdef _WIN32
+    return NULL;
+#else
+    char *pcPath = getenv(DAEMON_SOCKET_VARIABLE);
+
+    if((pcPath == NULL) || (pcPath[0] == '\0'))
+    {
+        return NULL;
+    }
+
+    if(strcmp(pcPath, DAEMON_DEFAULT_SOCKET) == 0)
+    {
+        return DAEMON_pcGetDefaultPath(FALSE);
+    }
+
+    return pcPath;
+#endif
+}
+
+
+/****************************************************************************
+ *
+ * NAME: DAEMON_bGetClass
+ *
+ * DESCRIPTION:
+ * Looks up a request class by its name, interactive, control or bulk
+ *
+ * RETURNS:
+ * bool_t TRUE if the name is known, with the class in *peClass, FALSE otherwise
+ *
+ ****************************************************************************/
+bool_t DAEMON_bGetClass(char *pcName, DAEMON_teClass *peClass)
+{
+    if(strcasecmp(pcName, "interactive") == 0)
+    {
+        *peClass = E_DAEMON_CLASS_INTERACTIVE;
+    }
+    else if(strcasecmp(pcName, "control") == 0)
+    {
+        *peClass = E_DAEMON_CLASS_CONTROL;
+    }
+    else if(strcasecmp(pcName, "bulk") == 0)
+    {
+        *peClass = E_DAEMON_CLASS_BULK;
+    }
+    else
+    {
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: DAEMON_bForward
+ *
+ * DESCRIPTION:
+ * Has the daemon listening on pcPath run the command line, with our stdin,
+ * stdout and stderr, and waits for it to finish. Only a daemon run by our
+ * own user is given the command. Exit requests and triggers
+ * raised by our signal handlers are passed on as SIGINT and SIGUSR1. If the
+ * daemon is too busy for a bulk request, it's asked again after a jittered
+ * wait that doubles each time.
+ *
+ * RETURNS:
+ * bool_t TRUE if a daemon ran the command, with its exit status in
+ * *piStatus, FALSE if there's no daemon to run it
+ *
+ ****************************************************************************/
+bool_t DAEMON_bForward(char *pcPath, int argc, char *argv[], volatile bool_t *pbExit, volatile uint32_t *pu32Trigger, int *piStatus)
+{
+#ifdef _WIN32
+    (void)pcPath; (void)argc; (void)argv; (void)pbExit; (void)pu32Trigger; (void)piStatus;
+    return FALSE;
+#else
+    uint8_t au8Request[DAEMON_MAX_REQUEST_LENGTH];
+    uint8_t au8Message[2];
+    int aiFds[3] = { STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO };
+    char acControl[CMSG_SPACE(sizeof(aiFds))];
+    struct msghdr sMsg;
+    struct iovec sIov;
+    struct cmsghdr *psCmsg;
+    struct pollfd sPoll;
+    uint32_t u32Length = 2;
+    uint32_t u32Trigger = *pu32Trigger;
+    uint32_t u32ArgLength;
+    uint32_t u32RetryMs = DAEMON_BUSY_RETRY_MS;
+    uint32_t u32Random = ((uint32_t)getpid() * 2654435761U) | 1;
+    uint32_t u32WaitMs;
+    bool_t bExitSent = FALSE;
+    bool_t bBusy = FALSE;
+    int iSocket;
+    int iLength;
+    int n;
+
+    if((pcPath == NULL) || (pcPath[0] == '\0'))
+    {
+        return FALSE;
+    }
+
+    iSocket = DAEMON_iConnect(pcPath);
+    if(iSocket < 0)
+    {
+        return FALSE;
+    }
+
+    *piStatus = EXIT_FAILURE;
+
+    if((argc > DAEMON_MAX_ARGUMENTS) || (getcwd((char*)&au8Request[2], sizeof(au8Request) - 2) == NULL))
+    {
+        printf("Error: Command line too long for the daemon in %s\n", __FUNCTION__);
+        close(iSocket);
+        return TRUE;
+    }
+    u32Length += strlen((char*)&au8Request[2]) + 1;
+
+    au8Request[0] = DAEMON_MSG_RUN;
+    au8Request[1] = (uint8_t)argc;
+    for(n = 0; n < argc; n++)
+    {
+        u32ArgLength = strlen(argv[n]) + 1;
+        if(u32Length + u32ArgLength > sizeof(au8Request))
+        {
+            printf("Error: Command line too long for the daemon in %s\n", __FUNCTION__);
+            close(iSocket);
+            return TRUE;
+        }
+        memcpy(&au8Request[u32Length], argv[n], u32ArgLength);
+        u32Length += u32ArgLength;
+    }
+
+    // The request is a single message carrying our stdio descriptors
+    sIov.iov_base = au8Request;
+    sIov.iov_len = u32Length;
+    memset(&sMsg, 0, sizeof(sMsg));
+    memset(acControl, 0, sizeof(acControl));
+    sMsg.msg_iov = &sIov;
+    sMsg.msg_iovlen = 1;
+    sMsg.msg_control = acControl;
+    sMsg.msg_controllen = sizeof(acControl);
+    psCmsg = CMSG_FIRSTHDR(&sMsg);
+    psCmsg->cmsg_level = SOL_SOCKET;
+    psCmsg->cmsg_type = SCM_RIGHTS;
+    psCmsg->cmsg_len = CMSG_LEN(sizeof(aiFds));
+    memcpy(CMSG_DATA(psCmsg), aiFds, sizeof(aiFds));
+
+    while(1)
+    {
+        if(sendmsg(iSocket, &sMsg, MSG_NOSIGNAL) != (ssize_t)u32Length)
+        {
+            printf("Error: Failed to send the request to the daemon in %s\n", __FUNCTION__);
+            close(iSocket);
+            return TRUE;
+        }
+
+        sPoll.fd = iSocket;
+        sPoll.events = POLLIN;
+        bBusy = FALSE;
+        while(1)
+        {
+            if(*pbExit && !bExitSent)
+            {
+                au8Message[0] = DAEMON_MSG_SIGNAL;
+                au8Message[1] = SIGINT;
+                send(iSocket, au8Message, 2, MSG_NOSIGNAL);
+                bExitSent = TRUE;
+            }
+
+            if(*pu32Trigger != u32Trigger)
+            {
+                u32Trigger = *pu32Trigger;
+                au8Message[0] = DAEMON_MSG_SIGNAL;
+                au8Message[1] = SIGUSR1;
+                send(iSocket, au8Message, 2, MSG_NOSIGNAL);
+            }
+
+            if(poll(&sPoll, 1, DAEMON_CLIENT_POLL_MS) <= 0)
+            {
+                continue;
+            }
+
+            iLength = recv(iSocket, au8Message, sizeof(au8Message), 0);
+            if((iLength == 2) && (au8Message[0] == DAEMON_MSG_EXIT))
+            {
+                *piStatus = au8Message[1];
+                break;
+            }
+            if((iLength == 2) && (au8Message[0] == DAEMON_MSG_BUSY))
+            {
+                bBusy = TRUE;
+                break;
+            }
+            if((iLength <= 0) && (errno != EINTR))
+            {
+                printf("Error: The daemon went away in %s\n", __FUNCTION__);
+                break;
+            }
+        }
+
+        if(!bBusy)
+        {
+            break;
+        }
+        close(iSocket);
+
+        // Between half and all of the wait, so clients turned away together don't all come back together
+        u32Random ^= u32Random << 13;
+        u32Random ^= u32Random >> 17;
+        u32Random ^= u32Random << 5;
+        u32WaitMs = (u32RetryMs / 2) + (u32Random % ((u32RetryMs / 2) + 1));
+        u32RetryMs = (u32RetryMs * 2 < DAEMON_BUSY_MAX_RETRY_MS) ? u32RetryMs * 2 : DAEMON_BUSY_MAX_RETRY_MS;
+        while((u32WaitMs > 0) && !*pbExit)
+        {
+            n = (u32WaitMs < DAEMON_CLIENT_POLL_MS) ? (int)u32WaitMs : DAEMON_CLIENT_POLL_MS;
+            usleep((useconds_t)n * 1000);
+            u32WaitMs -= (uint32_t)n;
+        }
+        if(*pbExit)
+        {
+            *piStatus = 128 + SIGINT;
+            return TRUE;
+        }
+
+        iSocket = DAEMON_iConnect(pcPath);
+        if(iSocket < 0)
+        {
+            printf("Error: The daemon went away in %s\n", __FUNCTION__);
+            return TRUE;
+        }
+    }
+
+    close(iSocket);
+    return TRUE;
+#endif
+}
+
+/****************************************************************************/
+/***        Local Functions                                               ***/
+/****************************************************************************/
+
+#ifndef _WIN32
+/****************************************************************************
+ *
+ * NAME: DAEMON_pcGetDefaultPath
+ *
+ * DESCRIPTION:
+ * Finds the per-user socket, in $XDG_RUNTIME_DIR if it's set, otherwise in
+ * a directory in /tmp that only we can access. The daemon creates that
+ * directory if needed; either way it's refused if someone else owns it or
+ * can get into it.
+ *
+ * RETURNS:
+ * char * The path, NULL if there's no private place for it
+ *
+ ****************************************************************************/
+static char *DAEMON_pcGetDefaultPath(bool_t bCreate)
+{
+    char acDir[DAEMON_MAX_PATH_LENGTH];
+    char *pcRuntimeDir = getenv("XDG_RUNTIME_DIR");
+    struct stat sStat;
+
+    if((pcRuntimeDir != NULL) && (pcRuntimeDir[0] != '\0'))
+    {
+        snprintf(acDir, sizeof(acDir), "%s", pcRuntimeDir);
+    }
+    else
+    {
+        snprintf(acDir, sizeof(acDir), DAEMON_PRIVATE_DIR, (unsigned int)geteuid());
+        if(bCreate && (mkdir(acDir, 0700) < 0) && (errno != EEXIST))
+        {
+            printf("Error: Failed to create %s in %s\n", acDir, __FUNCTION__);
+            return NULL;
+        }
+    }
+
+    if((lstat(acDir, &sStat) < 0) || !S_ISDIR(sStat.st_mode) || (sStat.st_uid != geteuid()) || ((sStat.st_mode & 0077) != 0))
+    {
+        printf("Error: %s isn't a directory only we can access in %s\n", acDir, __FUNCTION__);
+        return NULL;
+    }
+
+    if(snprintf(acDefaultPath, sizeof(acDefaultPath), "%s/%s", acDir, DAEMON_SOCKET_NAME) >= (int)sizeof(acDefaultPath))
+    {
+        printf("Error: Socket path in %s is too long in %s\n", acDir, __FUNCTION__);
+        return NULL;
+    }
+
+    return acDefaultPath;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: DAEMON_bIsOwnUser
+ *
+ * DESCRIPTION:
+ * Checks that the process at the other end of a connection runs as our
+ * user, as a daemon runs its clients' commands with its own privileges
+ *
+ * RETURNS:
+ * bool_t TRUE if it's our user, FALSE otherwise
+ *
+ ****************************************************************************/
+static bool_t DAEMON_bIsOwnUser(int iSocket)
+{
+    uid_t tUid;
+
+#ifdef __linux__
+    struct ucred sCred;
+    socklen_t tCredLen = sizeof(sCred);
+
+    if(getsockopt(iSocket, SOL_SOCKET, SO_PEERCRED, &sCred, &tCredLen) < 0)
+    {
+        return FALSE;
+    }
+    tUid = sCred.uid;
+#else
+    gid_t tGid;
+
+    if(getpeereid(iSocket, &tUid, &tGid) < 0)
+    {
+        return FALSE;
+    }
+#endif
+
+    return (tUid == geteuid()) ? TRUE : FALSE;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: DAEMON_iConnect
+ *
+ * DESCRIPTION:
+ * Connects to the daemon listening on pcPath, if it's run by our user
+ *
+ * RETURNS:
+ * int The socket, -1 if no daemon of ours is listening
+ *
+ ****************************************************************************/
+static int DAEMON_iConnect(char *pcPath)
+{
+    struct sockaddr_un sAddr;
+    int iSocket;
+
+    if(strlen(pcPath) >= sizeof(sAddr.sun_path))
+    {
+        return -1;
+    }
+
+    iSocket = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+    if(iSocket < 0)
+    {
+        return -1;
+    }
+
+    memset(&sAddr, 0, sizeof(sAddr));
+    sAddr.sun_family = AF_UNIX;
+    strcpy(sAddr.sun_path, pcPath);
+    if(connect(iSocket, (struct sockaddr*)&sAddr, sizeof(sAddr)) < 0)
+    {
+        close(iSocket);
+        return -1;
+    }
+
+    if(!DAEMON_bIsOwnUser(iSocket))
+    {
+        printf("Warning: Ignoring the daemon on %s, it's run by another user\n", pcPath);
+        close(iSocket);
+        return -1;
+    }
+
+    return iSocket;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: DAEMON_iReceive
+ *
+ * DESCRIPTION:
+ * Receives a client's request along with the descriptors attached to it
+ *
+ * RETURNS:
+ * int The length of the request, 0 if the client hung up, -1 on error
+ *
+ ****************************************************************************/
+static int DAEMON_iReceive(DAEMON_tsClient *psClient)
+{
+    char acControl[CMSG_SPACE(sizeof(psClient->aiFds))];
+    struct msghdr sMsg;
+    struct iovec sIov;
+    struct cmsghdr *psCmsg;
+    int iLength;
+
+    sIov.iov_base = psClient->au8Request;
+    sIov.iov_len = DAEMON_MAX_REQUEST_LENGTH;
+    memset(&sMsg, 0, sizeof(sMsg));
+    sMsg.msg_iov = &sIov;
+    sMsg.msg_iovlen = 1;
+    sMsg.msg_control = acControl;
+    sMsg.msg_controllen = sizeof(acControl);
+
+    iLength = recvmsg(psClient->iSocket, &sMsg, MSG_DONTWAIT | MSG_CMSG_CLOEXEC);
+    if(iLength <= 0)
+    {
+        return iLength;
+    }
+
+    for(psCmsg = CMSG_FIRSTHDR(&sMsg); psCmsg != NULL; psCmsg = CMSG_NXTHDR(&sMsg, psCmsg))
+    {
+        if((psCmsg->cmsg_level == SOL_SOCKET) && (psCmsg->cmsg_type == SCM_RIGHTS) && (psCmsg->cmsg_len == CMSG_LEN(sizeof(psClient->aiFds))))
+        {
+            memcpy(psClient->aiFds, CMSG_DATA(psCmsg), sizeof(psClient->aiFds));
+        }
+    }
+
+    return iLength;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: DAEMON_bParseRequest
+ *
+ * DESCRIPTION:
+ * Splits a run request into the working directory and arguments
+ *
+ * RETURNS:
+ * bool_t TRUE if the request is complete, FALSE otherwise
+ *
+ ****************************************************************************/
+static bool_t DAEMON_bParseRequest(DAEMON_tsInstance *psDaemon, DAEMON_tsClient *psClient, uint32_t u32Length)
+{
+    char *pcString = (char*)&psClient->au8Request[2];
+    char *pcEnd = (char*)&psClient->au8Request[u32Length];
+    int iArgc;
+    int n;
+
+    if((u32Length < 2) || (psClient->au8Request[0] != DAEMON_MSG_RUN) || (psClient->aiFds[0] < 0))
+    {
+        printf("Warning: Malformed request\n");
+        return FALSE;
+    }
+
+    iArgc = psClient->au8Request[1];
+    if((iArgc == 0) || (iArgc > DAEMON_MAX_ARGUMENTS))
+    {
+        printf("Warning: Malformed request\n");
+        return FALSE;
+    }
+
+    // Working directory first, then the arguments
+    psClient->au8Request[u32Length] = '\0';
+    for(n = -1; n < iArgc; n++)
+    {
+        if(pcString >= pcEnd)
+        {
+            printf("Warning: Malformed request\n");
+            return FALSE;
+        }
+        if(n < 0)
+        {
+            psClient->pcDirectory = pcString;
+        }
+        else
+        {
+            psClient->apcArgv[n] = pcString;
+        }
+        pcString += strlen(pcString) + 1;
+    }
+    psClient->apcArgv[iArgc] = NULL;
+    psClient->iArgc = iArgc;
+    psClient->u32Length = u32Length;
+    DAEMON_vClassify(psDaemon, psClient);
+
+    return TRUE;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: DAEMON_vClassify
+ *
+ * DESCRIPTION:
+ * Picks the class given with -N out of a request's arguments, and the camera
+ * given with -i, without its port. Notes whether other cameras are addressed
+ * too, with -c or discovery (-d). The arguments are parsed the way the
+ * request will parse them, so abbreviated long options count too.
+ *
+ * RETURNS:
+ * void
+ *
+ ****************************************************************************/
+static void DAEMON_vClassify(DAEMON_tsInstance *psDaemon, DAEMON_tsClient *psClient)
+{
+    char *apcArgv[DAEMON_MAX_ARGUMENTS + 1];
+    char *pcClass = NULL;
+    char *pcCamera = NULL;
+    bool_t bOthers = FALSE;
+    size_t tLength;
+    int iOptErr = opterr;
+    int c;
+
+    // getopt reorders the arguments it's given, so it gets a copy
+    memcpy(apcArgv, psClient->apcArgv, sizeof(apcArgv));
+    opterr = 0;
+    optind = 0;
+    while((c = getopt_long(psClient->iArgc, apcArgv, psDaemon->pcOptions, psDaemon->psLongOptions, NULL)) != -1)
+    {
+        switch(c)
+        {
+        case 'N':
+            pcClass = optarg;
+            break;
+
+        case 'i':
+            pcCamera = optarg;
+            break;
+
+        case 'c':
+        case 'd':
+            bOthers = TRUE;
+            break;
+
+        default:
+            break;
+        }
+    }
+    opterr = iOptErr;
+    optind = 0;
+
+    if((pcClass == NULL) || !DAEMON_bGetClass(pcClass, &psClient->eClass))
+    {
+        psClient->eClass = E_DAEMON_CLASS_INTERACTIVE;
+    }
+
+    psClient->bOneCamera = ((pcCamera != NULL) && !bOthers) ? TRUE : FALSE;
+
+    psClient->acCamera[0] = '\0';
+    if(pcCamera != NULL)
+    {
+        tLength = strcspn(pcCamera, ":");
+        if(tLength >= DAEMON_MAX_CAMERA_LENGTH)
+        {
+            tLength = DAEMON_MAX_CAMERA_LENGTH - 1;
+        }
+        memcpy(psClient->acCamera, pcCamera, tLength);
+        psClient->acCamera[tLength] = '\0';
+    }
+}
+
+
+/****************************************************************************
+ *
+ * NAME: DAEMON_bHasRoomForBulk
+ *
+ * DESCRIPTION:
+ * Whether the bulk request of the client at u32Index can be queued, without
+ * its camera having more than its share of bulk requests queued or running,
+ * or bulk requests taking the places kept for the other classes
+ *
+ * RETURNS:
+ * bool_t TRUE if there's room, FALSE otherwise
+ *
+ ****************************************************************************/
+static bool_t DAEMON_bHasRoomForBulk(DAEMON_tsInstance *psDaemon, uint32_t u32Index)
+{
+    DAEMON_tsClient *psClient = &psDaemon->asClients[u32Index];
+    uint32_t u32NumBulk = 0;
+    uint32_t u32NumCamera = 0;
+    uint32_t n;
+
+    for(n = 0; n < psDaemon->u32NumClients; n++)
+    {
+        if((n == u32Index) || (psDaemon->asClients[n].iArgc == 0) || (psDaemon->asClients[n].eClass != E_DAEMON_CLASS_BULK))
+        {
+            continue;
+        }
+
+        u32NumBulk++;
+        if(strcmp(psDaemon->asClients[n].acCamera, psClient->acCamera) == 0)
+        {
+            u32NumCamera++;
+        }
+    }
+
+    return ((u32NumBulk < DAEMON_MAX_CLIENTS - DAEMON_RESERVED_CLIENTS) && (u32NumCamera < DAEMON_MAX_BULK_PER_CAMERA)) ? TRUE : FALSE;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: DAEMON_i32NextRequest
+ *
+ * DESCRIPTION:
+ * Picks the queued request to run next. The highest class goes first, and
+ * within a class the one that arrived first, except that bulk requests go
+ * to the camera whose bulk request was run longest ago.
+ *
+ * RETURNS:
+ * int32_t Index of the client, -1 if no request is waiting
+ *
+ ****************************************************************************/
+static int32_t DAEMON_i32NextRequest(DAEMON_tsInstance *psDaemon)
+{
+    DAEMON_tsClient *psClient;
+    DAEMON_tsClient *psBest = NULL;
+    DAEMON_tsShare *psShare;
+    uint32_t u32BestLast = 0;
+    uint32_t u32Last;
+    int32_t i32Best = -1;
+    uint32_t n;
+
+    for(n = 0; n < psDaemon->u32NumClients; n++)
+    {
+        psClient = &psDaemon->asClients[n];
+        if(psClient->iArgc == 0)
+        {
+            continue;
+        }
+
+        psShare = DAEMON_psGetShare(psDaemon, psClient->acCamera, FALSE);
+        u32Last = (psShare != NULL) ? psShare->u32LastRequest : 0;
+
+        if((psBest == NULL) || (psClient->eClass > psBest->eClass) ||
+           ((psClient->eClass == E_DAEMON_CLASS_BULK) && (psBest->eClass == E_DAEMON_CLASS_BULK) && (u32Last < u32BestLast)))
+        {
+            psBest = psClient;
+            u32BestLast = u32Last;
+            i32Best = (int32_t)n;
+        }
+    }
+
+    return i32Best;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: DAEMON_psGetShare
+ *
+ * DESCRIPTION:
+ * Finds when a camera last had a bulk request run. If asked to create it,
+ * a camera that isn't known takes the place of the one that went longest
+ * without one.
+ *
+ * RETURNS:
+ * DAEMON_tsShare* or NULL if the camera isn't known and isn't to be created
+ *
+ ****************************************************************************/
+static DAEMON_tsShare *DAEMON_psGetShare(DAEMON_tsInstance *psDaemon, char *pcCamera, bool_t bCreate)
+{
+    DAEMON_tsShare *psOldest = &psDaemon->asShares[0];
+    uint32_t n;
+
+    for(n = 0; n < DAEMON_MAX_CLIENTS; n++)
+    {
+        if((psDaemon->asShares[n].u32LastRequest != 0) && (strcmp(psDaemon->asShares[n].acCamera, pcCamera) == 0))
+        {
+            return &psDaemon->asShares[n];
+        }
+        if(psDaemon->asShares[n].u32LastRequest < psOldest->u32LastRequest)
+        {
+            psOldest = &psDaemon->asShares[n];
+        }
+    }
+
+    if(!bCreate)
+    {
+        return NULL;
+    }
+
+    strcpy(psOldest->acCamera, pcCamera);
+    psOldest->u32LastRequest = 0;
+
+    return psOldest;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: DAEMON_vMoveToFront
+ *
+ * DESCRIPTION:
+ * Moves a client to the head of the queue, where the running request is,
+ * keeping the order of those it passes
+ *
+ * RETURNS:
+ * void
+ *
+ ****************************************************************************/
+static void DAEMON_vMoveToFront(DAEMON_tsInstance *psDaemon, uint32_t u32Index)
+{
+    DAEMON_tsClient sClient;
+
+    if(u32Index == 0)
+    {
+        return;
+    }
+
+    memcpy(&sClient, &psDaemon->asClients[u32Index], sizeof(DAEMON_tsClient));
+    memmove(&psDaemon->asClients[1], &psDaemon->asClients[0], u32Index * sizeof(DAEMON_tsClient));
+    memcpy(&psDaemon->asClients[0], &sClient, sizeof(DAEMON_tsClient));
+}
+
+
+/****************************************************************************
+ *
+ * NAME: DAEMON_bStartRequest
+ *
+ * DESCRIPTION:
+ * Forks a child to run the first client's request. The child keeps a pipe
+ * open that hangs up when it exits, so the daemon can wait on it in poll.
+ *
+ * RETURNS:
+ * bool_t TRUE in the child, FALSE in the daemon
+ *
+ ****************************************************************************/
+static bool_t DAEMON_bStartRequest(DAEMON_tsInstance *psDaemon)
+{
+    DAEMON_tsClient *psClient = &psDaemon->asClients[0];
+    int aiPipe[2];
+    int iChild;
+    uint32_t n;
+
+    // The arguments point into the request, which has moved up the queue since
+    DAEMON_bParseRequest(psDaemon, psClient, psClient->u32Length);
+
+    if(pipe(aiPipe) < 0)
+    {
+        printf("Error: Failed to create pipe in %s\n", __FUNCTION__);
+        DAEMON_vRemoveClient(psDaemon, 0);
+        return FALSE;
+    }
+
+    // Anything still buffered would otherwise be written by both processes
+    fflush(stdout);
+    fflush(stderr);
+
+    psDaemon->u32Requests++;
+    if(psClient->eClass == E_DAEMON_CLASS_BULK)
+    {
+        DAEMON_psGetShare(psDaemon, psClient->acCamera, TRUE)->u32LastRequest = psDaemon->u32Requests;
+    }
+
+    iChild = fork();
+    if(iChild < 0)
+    {
+        printf("Error: Failed to fork in %s\n", __FUNCTION__);
+        close(aiPipe[0]);
+        close(aiPipe[1]);
+        DAEMON_vRemoveClient(psDaemon, 0);
+        return FALSE;
+    }
+
+    if(iChild == 0)
+    {
+        close(aiPipe[0]);
+        close(psDaemon->iSocket);
+        psDaemon->iSocket = -1;
+        for(n = 1; n < psDaemon->u32NumClients; n++)
+        {
+            DAEMON_vCloseClient(&psDaemon->asClients[n]);
+        }
+        psDaemon->u32NumClients = 1;
+
+        dup2(psClient->aiFds[0], STDIN_FILENO);
+        dup2(psClient->aiFds[1], STDOUT_FILENO);
+        dup2(psClient->aiFds[2], STDERR_FILENO);
+        DAEMON_vCloseClient(psClient);
+        setvbuf(stdout, NULL, _IOLBF, 0);
+
+        if(chdir(psClient->pcDirectory) < 0)
+        {
+            printf("Warning: Can't change to %s\n", psClient->pcDirectory);
+        }
+        return TRUE;
+    }
+
+    close(aiPipe[1]);
+    psDaemon->iChildPipe = aiPipe[0];
+    psDaemon->iChild = iChild;
+
+    // Only the child writes to them
+    for(n = 0; n < 3; n++)
+    {
+        close(psClient->aiFds[n]);
+        psClient->aiFds[n] = -1;
+    }
+
+    return FALSE;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: DAEMON_vFinishRequest
+ *
+ * DESCRIPTION:
+ * Waits for the running request to exit and sends its status to its client
+ *
+ * RETURNS:
+ * void
+ *
+ ****************************************************************************/
+static void DAEMON_vFinishRequest(DAEMON_tsInstance *psDaemon)
+{
+    DAEMON_tsClient *psClient = &psDaemon->asClients[0];
+    uint8_t au8Message[2];
+    int iStatus = 0;
+
+    while((waitpid(psDaemon->iChild, &iStatus, 0) < 0) && (errno == EINTR));
+
+    au8Message[0] = DAEMON_MSG_EXIT;
+    au8Message[1] = WIFEXITED(iStatus) ? (uint8_t)WEXITSTATUS(iStatus) : (uint8_t)(128 + WTERMSIG(iStatus));
+    if(psClient->iSocket >= 0)
+    {
+        send(psClient->iSocket, au8Message, 2, MSG_NOSIGNAL);
+    }
+
+    close(psDaemon->iChildPipe);
+    psDaemon->iChildPipe = -1;
+    psDaemon->iChild = 0;
+    DAEMON_vRemoveClient(psDaemon, 0);
+}
+
+
+/****************************************************************************
+ *
+ * NAME: DAEMON_vRemoveClient
+ *
+ * DESCRIPTION:
+ * Closes a client and moves the ones queued behind it up
+ *
+ * RETURNS:
+ * void
+ *
+ ****************************************************************************/
+static void DAEMON_vRemoveClient(DAEMON_tsInstance *psDaemon, uint32_t u32Index)
+{
+    DAEMON_vCloseClient(&psDaemon->asClients[u32Index]);
+
+    psDaemon->u32NumClients--;
+    memmove(&psDaemon->asClients[u32Index], &psDaemon->asClients[u32Index + 1], (psDaemon->u32NumClients - u32Index) * sizeof(DAEMON_tsClient));
+}
+
+
+/****************************************************************************
+ *
+ * NAME: DAEMON_vCloseClient
+ *
+ * DESCRIPTION:
+ * Closes a client's socket and the descriptors it sent
+ *
+ * RETURNS:
+ * void
+ *
+ ****************************************************************************/
+static void DAEMON_vCloseClient(DAEMON_tsClient *psClient)
+{
+    uint32_t n;
+
+    if(psClient->iSocket >= 0)
+    {
+        close(psClient->iSocket);
+        psClient->iSocket = -1;
+    }
+
+    for(n = 0; n < 3; n++)
+    {
+        if(psClient->aiFds[n] >= 0)
+        {
+            close(psClient->aiFds[n]);
+            psClient->aiFds[n] = -1;
+        }
+    }
+}
+#endif
+
+/****************************************************************************/
+/***        END OF FILE                                                   ***/
+/****************************************************************************/
@@ -0,0 +1,107 @@
+#ifndef DAEMON_H
+#define DAEMON_H
+
+/****************************************************************************/
+/***        Include files                                                 ***/
+/****************************************************************************/
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <getopt.h>
+
+#include "common.h"
+
+/****************************************************************************/
+/***        Macro Definitions                                             ***/
+/****************************************************************************/
+
+#define DAEMON_DEFAULT_SOCKET           "default"           // Given as the path, the per-user socket DAEMON_SOCKET_NAME in $XDG_RUNTIME_DIR or DAEMON_PRIVATE_DIR
+#define DAEMON_SOCKET_NAME              "occd.sock"
+#define DAEMON_PRIVATE_DIR              "/tmp/occ-%u"       // Created with mode 0700, %u is the user ID
+#define DAEMON_SOCKET_VARIABLE          "OCC_SOCKET"        // Environment variable giving the daemon's socket, commands run locally unless it's set
+#define DAEMON_MAX_REQUEST_LENGTH       4096
+#define DAEMON_MAX_ARGUMENTS            64
+#define DAEMON_MAX_CLIENTS              16
+#define DAEMON_SERVICE_INTERVAL_MS      1000                // Leases are serviced at least this often while idle
+#define DAEMON_DISCOVERY_INTERVAL       60                  // Seconds between refreshes of the discovery table
+#define DAEMON_SESSION_RANGE            1024                // Session IDs given to each request, so late responses can't match the next one
+#define DAEMON_RESERVED_CLIENTS         4                   // Queue places bulk requests can't take, kept for the other classes
+#define DAEMON_MAX_BULK_PER_CAMERA      2                   // Bulk requests queued for any one camera
+#define DAEMON_MAX_CAMERA_LENGTH        32
+#define DAEMON_BUSY_RETRY_MS            50                  // First wait of a bulk client turned away, doubling up to DAEMON_BUSY_MAX_RETRY_MS
+#define DAEMON_BUSY_MAX_RETRY_MS        1000
+
+// Messages are a type byte followed by the payload
+#define DAEMON_MSG_RUN                  1                   // Client to daemon: argument count, then working directory and arguments, each NUL terminated, with stdin, stdout and stderr attached
+#define DAEMON_MSG_SIGNAL               2                   // Client to daemon: signal number to pass on to the request
+#define DAEMON_MSG_EXIT                 3                   // Daemon to client: exit status of the request
+#define DAEMON_MSG_BUSY                 4                   // Daemon to client: no room for another bulk request, ask again later
+
+/****************************************************************************/
+/***        Type Definitions                                              ***/
+/****************************************************************************/
+
+// Requests are run highest class first, and in the order they arrived within a class
+typedef enum {
+    E_DAEMON_CLASS_BULK,
+    E_DAEMON_CLASS_CONTROL,
+    E_DAEMON_CLASS_INTERACTIVE
+} DAEMON_teClass;
+
+typedef struct {
+    int iSocket;
+    int aiFds[3];                                   // The client's stdin, stdout and stderr
+    DAEMON_teClass eClass;                          // Given with -N, interactive by default
+    char acCamera[DAEMON_MAX_CAMERA_LENGTH];        // Given with -i, empty if none
+    bool_t bOneCamera;                              // Only acCamera is addressed, no -c or -d
+    int iArgc;
+    char *apcArgv[DAEMON_MAX_ARGUMENTS + 1];        // Point into au8Request
+    char *pcDirectory;
+    uint32_t u32Length;
+    uint8_t au8Request[DAEMON_MAX_REQUEST_LENGTH + 1];
+} DAEMON_tsClient;
+
+// Camera a bulk request was last run for, so bulk requests take turns by camera
+typedef struct {
+    char acCamera[DAEMON_MAX_CAMERA_LENGTH];
+    uint32_t u32LastRequest;
+} DAEMON_tsShare;
+
+// Accepts commands from occ clients on a Unix socket and runs each in a child
+// forked from the daemon, so they start with its camera socket, register table
+// and discovery table rather than setting them up again. The camera socket is
+// shared, so requests run one at a time. Interactive requests go ahead of
+// control requests, and both ahead of bulk ones, which take turns by camera
+// and are turned away, to ask again, once a camera has its share queued or
+// only the places kept for the other classes are left.
+typedef struct {
+    char *pcPath;
+    int iSocket;
+    const char *pcOptions;                          // Options requests are parsed with, to classify them as they'll be run
+    const struct option *psLongOptions;
+    DAEMON_tsClient asClients[DAEMON_MAX_CLIENTS];  // The first is running when iChild isn't 0
+    uint32_t u32NumClients;
+    int iChild;                                     // Process ID of the running request
+    int iChildPipe;                                 // Hangs up when the request exits
+    uint32_t u32Requests;
+    DAEMON_tsShare asShares[DAEMON_MAX_CLIENTS];
+    uint32_t u32Busy;                               // Bulk requests turned away
+} DAEMON_tsInstance;
+
+/****************************************************************************/
+/***        Exported Functions                                            ***/
+/****************************************************************************/
+
+bool_t DAEMON_bInit(DAEMON_tsInstance *psDaemon, char *pcPath, const char *pcOptions, const struct option *psLongOptions);
+void DAEMON_vDeInit(DAEMON_tsInstance *psDaemon);
+bool_t DAEMON_bService(DAEMON_tsInstance *psDaemon, uint32_t u32TimeoutMs, int *piArgc, char ***pppcArgv);
+bool_t DAEMON_bIsBusy(DAEMON_tsInstance *psDaemon);
+char *DAEMON_pcGetSocketPath(void);
+bool_t DAEMON_bGetClass(char *pcName, DAEMON_teClass *peClass);
+bool_t DAEMON_bForward(char *pcPath, int argc, char *argv[], volatile bool_t *pbExit, volatile uint32_t *pu32Trigger, int *piStatus);
+
+#endif // DAEMON_H
+
+/****************************************************************************/
+/***        END OF FILE                                                   ***/
+/****************************************************************************/
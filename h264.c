@@ -0,0 +1,805 @@
+/****************************************************************************
+ *
+ * Copyright 2021 Lee Mitchell <lee@indigopepper.com>
+ * This file is part of OCC (Orlaco Camera Configurator)
+ *
+ * OCC (Orlaco Camera Configurator) is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * OCC (Orlaco Camera Configurator) is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with OCC (Orlaco Camera Configurator).  If not,
+ * see <http://www.gnu.org/licenses/>.
+ *
+ ****************************************************************************/
+
+/****************************************************************************/
+/***        Include files                                                 ***/
+/****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "common.h"
+#include "h264.h"
+
+/****************************************************************************/
+/***        Macro Definitions                                             ***/
+/****************************************************************************/
+
+#define H264_START_CODE_LENGTH          4
+#define H264_FU_START                   0x80
+#define H264_FU_END                     0x40
+
+/****************************************************************************/
+/***        Type Definitions                                              ***/
+/****************************************************************************/
+
+// Reads the bits of a parameter set's RBSP, most significant bit first
+typedef struct {
+    const uint8_t *pu8Data;
+    uint32_t u32Length;
+    uint32_t u32BitPos;
+    bool_t bOverrun;
+} H264_tsBitReader;
+
+/****************************************************************************/
+/***        Local Function Prototypes                                     ***/
+/****************************************************************************/
+
+static bool_t H264_bEnsureCapacity(H264_tsDepacketizer *psDepacketizer, uint32_t u32Length);
+static void H264_vStartFrame(H264_tsDepacketizer *psDepacketizer, RTP_tsPacket *psPacket);
+static bool_t H264_bAppendNal(H264_tsDepacketizer *psDepacketizer, const uint8_t *pu8Nal, uint32_t u32Length);
+static bool_t H264_bAppend(H264_tsDepacketizer *psDepacketizer, const uint8_t *pu8Data, uint32_t u32Length);
+static void H264_vNoteNal(H264_tsDepacketizer *psDepacketizer, const uint8_t *pu8Nal, uint32_t u32Length);
+static uint32_t H264_u32Prepend(H264_tsDepacketizer *psDepacketizer, uint32_t u32HeaderLength, const uint8_t *pu8Nal, uint32_t u32Length);
+static uint32_t H264_u32ReadBits(H264_tsBitReader *psReader, uint32_t u32NumBits);
+static uint32_t H264_u32ReadUe(H264_tsBitReader *psReader);
+static int32_t H264_i32ReadSe(H264_tsBitReader *psReader);
+static void H264_vSkipScalingList(H264_tsBitReader *psReader, int iSize);
+
+/****************************************************************************/
+/***        Exported Variables                                            ***/
+/****************************************************************************/
+
+/****************************************************************************/
+/***        Local Variables                                               ***/
+/****************************************************************************/
+
+static const uint8_t H264_au8StartCode[H264_START_CODE_LENGTH] = { 0x00, 0x00, 0x00, 0x01 };
+
+/****************************************************************************/
+/***        Exported Functions                                            ***/
+/****************************************************************************/
+
+/****************************************************************************
+ *
+ * NAME: H264_bInit
+ *
+ * DESCRIPTION:
+ * Initialises an RTP/H.264 depacketizer and allocates its frame buffer
+ *
+ * RETURNS:
+ * bool_t TRUE if successful, FALSE otherwise
+ *
+ ****************************************************************************/
+bool_t H264_bInit(H264_tsDepacketizer *psDepacketizer)
+{
+    memset(psDepacketizer, 0, sizeof(H264_tsDepacketizer));
+
+    psDepacketizer->pu8Buffer = (uint8_t*)malloc(H264_MAX_HEADER_LENGTH + H264_INITIAL_FRAME_LENGTH);
+    if(psDepacketizer->pu8Buffer == NULL)
+    {
+        printf("Error: Failed to allocate memory for frame buffer in %s\n", __FUNCTION__);
+        return FALSE;
+    }
+    psDepacketizer->u32BufferLength = H264_INITIAL_FRAME_LENGTH;
+
+    // Nothing can be decoded until the first IDR
+    psDepacketizer->bWaitForKeyFrame = TRUE;
+
+    return TRUE;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: H264_vDeInit
+ *
+ * DESCRIPTION:
+ * Frees the memory used by an RTP/H.264 depacketizer
+ *
+ * RETURNS:
+ * void
+ *
+ ****************************************************************************/
+void H264_vDeInit(H264_tsDepacketizer *psDepacketizer)
+{
+    if(psDepacketizer->pu8Buffer != NULL)
+    {
+        free(psDepacketizer->pu8Buffer);
+        psDepacketizer->pu8Buffer = NULL;
+    }
+}
+
+
+/****************************************************************************
+ *
+ * NAME: H264_bPushPacket
+ *
+ * DESCRIPTION:
+ * Adds an RTP/H.264 packet to the access unit being reassembled. Single NAL
+ * unit, STAP-A and FU-A packets are supported. Packets must arrive in order,
+ * a gap in the sequence numbers discards the access unit and every following
+ * one up to the next IDR, as they would reference a picture we don't have.
+ * The most recent SPS and PPS are repeated in front of IDRs that arrive
+ * without them, so every key frame returned can be decoded on its own.
+ *
+ * RETURNS:
+ * bool_t TRUE if psFrame now holds a complete access unit, FALSE otherwise
+ *
+ ****************************************************************************/
+bool_t H264_bPushPacket(H264_tsDepacketizer *psDepacketizer, RTP_tsPacket *psPacket, RTP_tsFrame *psFrame)
+{
+    const uint8_t *pu8Ptr = psPacket->pu8Payload;
+    uint32_t u32Remaining = psPacket->u32PayloadLength;
+    uint32_t u32NalLength;
+    uint32_t u32HeaderLength = 0;
+    uint8_t u8FuHeader;
+    uint8_t u8NalHeader;
+    bool_t bLoss = FALSE;
+
+    if(u32Remaining < 1)
+    {
+        return FALSE;
+    }
+
+    if(psDepacketizer->bSeqValid && (psPacket->u16SequenceNumber != psDepacketizer->u16NextSeq))
+    {
+        bLoss = TRUE;
+    }
+    psDepacketizer->u16NextSeq = (uint16_t)(psPacket->u16SequenceNumber + 1);
+    psDepacketizer->bSeqValid = TRUE;
+
+    // A new timestamp means a new access unit, anything left over from the previous one lost its end
+    if(!psDepacketizer->bInFrame || (psDepacketizer->u32Timestamp != psPacket->u32Timestamp))
+    {
+        if(psDepacketizer->bInFrame)
+        {
+            psDepacketizer->u32FramesDropped++;
+            psDepacketizer->bWaitForKeyFrame = TRUE;
+        }
+        H264_vStartFrame(psDepacketizer, psPacket);
+    }
+
+    if(bLoss)
+    {
+        psDepacketizer->bCorrupt = TRUE;
+    }
+
+    switch(pu8Ptr[0] & 0x1f)
+    {
+    case H264_NAL_TYPE_STAP_A:
+        pu8Ptr++;
+        u32Remaining--;
+        while(u32Remaining >= 2)
+        {
+            u32NalLength = ((uint32_t)pu8Ptr[0] << 8) | pu8Ptr[1];
+            pu8Ptr += 2;
+            u32Remaining -= 2;
+            if((u32NalLength == 0) || (u32NalLength > u32Remaining) || !H264_bAppendNal(psDepacketizer, pu8Ptr, u32NalLength))
+            {
+                psDepacketizer->bCorrupt = TRUE;
+                break;
+            }
+            pu8Ptr += u32NalLength;
+            u32Remaining -= u32NalLength;
+        }
+        break;
+
+    case H264_NAL_TYPE_FU_A:
+        if(u32Remaining < 3)
+        {
+            psDepacketizer->bCorrupt = TRUE;
+            break;
+        }
+        u8FuHeader = pu8Ptr[1];
+        if(u8FuHeader & H264_FU_START)
+        {
+            // Rebuild the NAL header from the FU indicator and the FU header
+            u8NalHeader = (uint8_t)((pu8Ptr[0] & 0xe0) | (u8FuHeader & 0x1f));
+            if(psDepacketizer->bInFragment ||
+               !H264_bAppend(psDepacketizer, H264_au8StartCode, H264_START_CODE_LENGTH) ||
+               !H264_bAppend(psDepacketizer, &u8NalHeader, 1))
+            {
+                psDepacketizer->bCorrupt = TRUE;
+            }
+            H264_vNoteNal(psDepacketizer, &u8NalHeader, 1);
+            psDepacketizer->bInFragment = TRUE;
+        }
+        else if(!psDepacketizer->bInFragment)
+        {
+            psDepacketizer->bCorrupt = TRUE;
+            break;
+        }
+        if(!H264_bAppend(psDepacketizer, pu8Ptr + 2, u32Remaining - 2))
+        {
+            psDepacketizer->bCorrupt = TRUE;
+        }
+        if(u8FuHeader & H264_FU_END)
+        {
+            psDepacketizer->bInFragment = FALSE;
+        }
+        break;
+
+    default:
+        // STAP-B, MTAP and FU-B are only used in interleaved mode
+        if(((pu8Ptr[0] & 0x1f) == 0) || ((pu8Ptr[0] & 0x1f) > 23) || !H264_bAppendNal(psDepacketizer, pu8Ptr, u32Remaining))
+        {
+            psDepacketizer->bCorrupt = TRUE;
+        }
+        break;
+    }
+
+    if(!psPacket->bMarker)
+    {
+        return FALSE;
+    }
+
+    psDepacketizer->bInFrame = FALSE;
+
+    if(psDepacketizer->bCorrupt || psDepacketizer->bInFragment || (psDepacketizer->u32Length == 0))
+    {
+        psDepacketizer->u32FramesDropped++;
+        psDepacketizer->bWaitForKeyFrame = TRUE;
+        return FALSE;
+    }
+
+    if(!psDepacketizer->bKeyFrame)
+    {
+        if(psDepacketizer->bWaitForKeyFrame)
+        {
+            psDepacketizer->u32FramesDropped++;
+            return FALSE;
+        }
+    }
+    else
+    {
+        psDepacketizer->bWaitForKeyFrame = FALSE;
+
+        // The PPS goes in first so that the SPS ends up in front of it
+        if(!psDepacketizer->bHasPps && (psDepacketizer->u32PpsLength > 0))
+        {
+            u32HeaderLength = H264_u32Prepend(psDepacketizer, u32HeaderLength, psDepacketizer->au8Pps, psDepacketizer->u32PpsLength);
+        }
+        if(!psDepacketizer->bHasSps && (psDepacketizer->u32SpsLength > 0))
+        {
+            u32HeaderLength = H264_u32Prepend(psDepacketizer, u32HeaderLength, psDepacketizer->au8Sps, psDepacketizer->u32SpsLength);
+        }
+    }
+
+    psFrame->eCodec = E_RTP_CODEC_H264;
+    psFrame->u32Ssrc = psPacket->u32Ssrc;
+    psFrame->u32Timestamp = psDepacketizer->u32Timestamp;
+    psFrame->u64FirstPacketTimeUs = psDepacketizer->u64FirstPacketTimeUs;
+    psFrame->u64ArrivalTimeUs = psPacket->u64ArrivalTimeUs;
+    psFrame->u16Width = psDepacketizer->sSps.u16Width;
+    psFrame->u16Height = psDepacketizer->sSps.u16Height;
+    psFrame->bKeyFrame = psDepacketizer->bKeyFrame;
+    psFrame->pu8Data = psDepacketizer->pu8Buffer + H264_MAX_HEADER_LENGTH - u32HeaderLength;
+    psFrame->u32Length = u32HeaderLength + psDepacketizer->u32Length;
+
+    psDepacketizer->u32FramesCompleted++;
+
+    return TRUE;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: H264_bParseSps
+ *
+ * DESCRIPTION:
+ * Extracts the profile, level, chroma format and picture size from a
+ * sequence parameter set NAL unit, including its NAL header
+ *
+ * RETURNS:
+ * bool_t TRUE if successful, FALSE otherwise
+ *
+ ****************************************************************************/
+bool_t H264_bParseSps(const uint8_t *pu8Nal, uint32_t u32Length, H264_tsSps *psSps)
+{
+    uint8_t au8Rbsp[H264_MAX_PARAMETER_SET_LENGTH];
+    H264_tsBitReader sReader;
+    uint32_t u32RbspLength = 0;
+    uint32_t u32Zeros = 0;
+    uint32_t u32PocType;
+    uint32_t u32Count;
+    uint32_t u32WidthMbs;
+    uint32_t u32HeightMapUnits;
+    uint32_t u32FrameMbsOnly;
+    uint32_t u32CropUnitX;
+    uint32_t u32CropUnitY;
+    uint32_t au32Crop[4] = { 0, 0, 0, 0 };
+    uint32_t n;
+
+    if((u32Length < 4) || ((pu8Nal[0] & 0x1f) != H264_NAL_TYPE_SPS))
+    {
+        return FALSE;
+    }
+
+    // Remove the emulation prevention bytes
+    for(n = 1; (n < u32Length) && (u32RbspLength < sizeof(au8Rbsp)); n++)
+    {
+        if((u32Zeros >= 2) && (pu8Nal[n] == 0x03))
+        {
+            u32Zeros = 0;
+            continue;
+        }
+        u32Zeros = (pu8Nal[n] == 0) ? (u32Zeros + 1) : 0;
+        au8Rbsp[u32RbspLength++] = pu8Nal[n];
+    }
+
+    memset(psSps, 0, sizeof(H264_tsSps));
+    memset(&sReader, 0, sizeof(H264_tsBitReader));
+    sReader.pu8Data = au8Rbsp;
+    sReader.u32Length = u32RbspLength;
+
+    psSps->u8Profile = (uint8_t)H264_u32ReadBits(&sReader, 8);
+    psSps->u8Constraints = (uint8_t)H264_u32ReadBits(&sReader, 8);
+    psSps->u8Level = (uint8_t)H264_u32ReadBits(&sReader, 8);
+    H264_u32ReadUe(&sReader);                                   // seq_parameter_set_id
+
+    psSps->u8ChromaFormat = 1;
+    psSps->u8BitDepthLuma = 8;
+    psSps->u8BitDepthChroma = 8;
+
+    switch(psSps->u8Profile)
+    {
+    case 100: case 110: case 122: case 244: case 44:
+    case 83: case 86: case 118: case 128: case 138:
+    case 139: case 134: case 135:
+        psSps->u8ChromaFormat = (uint8_t)H264_u32ReadUe(&sReader);
+        if(psSps->u8ChromaFormat == 3)
+        {
+            H264_u32ReadBits(&sReader, 1);                      // separate_colour_plane_flag
+        }
+        psSps->u8BitDepthLuma = (uint8_t)(H264_u32ReadUe(&sReader) + 8);
+        psSps->u8BitDepthChroma = (uint8_t)(H264_u32ReadUe(&sReader) + 8);
+        H264_u32ReadBits(&sReader, 1);                          // qpprime_y_zero_transform_bypass_flag
+        if(H264_u32ReadBits(&sReader, 1))                       // seq_scaling_matrix_present_flag
+        {
+            u32Count = (psSps->u8ChromaFormat != 3) ? 8 : 12;
+            for(n = 0; n < u32Count; n++)
+            {
+                if(H264_u32ReadBits(&sReader, 1))
+                {
+                    H264_vSkipScalingList(&sReader, (n < 6) ? 16 : 64);
+                }
+            }
+        }
+        break;
+
+    default:
+        break;
+    }
+
+    H264_u32ReadUe(&sReader);                                   // log2_max_frame_num_minus4
+    u32PocType = H264_u32ReadUe(&sReader);
+    if(u32PocType == 0)
+    {
+        H264_u32ReadUe(&sReader);                               // log2_max_pic_order_cnt_lsb_minus4
+    }
+    else if(u32PocType == 1)
+    {
+        H264_u32ReadBits(&sReader, 1);                          // delta_pic_order_always_zero_flag
+        H264_i32ReadSe(&sReader);                               // offset_for_non_ref_pic
+        H264_i32ReadSe(&sReader);                               // offset_for_top_to_bottom_field
+        u32Count = H264_u32ReadUe(&sReader);
+        for(n = 0; (n < u32Count) && !sReader.bOverrun; n++)
+        {
+            H264_i32ReadSe(&sReader);                           // offset_for_ref_frame
+        }
+    }
+    H264_u32ReadUe(&sReader);                                   // max_num_ref_frames
+    H264_u32ReadBits(&sReader, 1);                              // gaps_in_frame_num_value_allowed_flag
+    u32WidthMbs = H264_u32ReadUe(&sReader) + 1;
+    u32HeightMapUnits = H264_u32ReadUe(&sReader) + 1;
+    u32FrameMbsOnly = H264_u32ReadBits(&sReader, 1);
+    if(!u32FrameMbsOnly)
+    {
+        H264_u32ReadBits(&sReader, 1);                          // mb_adaptive_frame_field_flag
+    }
+    H264_u32ReadBits(&sReader, 1);                              // direct_8x8_inference_flag
+    if(H264_u32ReadBits(&sReader, 1))                           // frame_cropping_flag
+    {
+        for(n = 0; n < 4; n++)
+        {
+            au32Crop[n] = H264_u32ReadUe(&sReader);
+        }
+    }
+
+    if(sReader.bOverrun)
+    {
+        return FALSE;
+    }
+
+    // Cropping is in chroma sample units, see table 6-1 and equations 7-19 to 7-22
+    if(psSps->u8ChromaFormat == 0)
+    {
+        u32CropUnitX = 1;
+        u32CropUnitY = 2 - u32FrameMbsOnly;
+    }
+    else
+    {
+        u32CropUnitX = (psSps->u8ChromaFormat == 3) ? 1 : 2;
+        u32CropUnitY = ((psSps->u8ChromaFormat == 1) ? 2 : 1) * (2 - u32FrameMbsOnly);
+    }
+
+    psSps->u16Width = (uint16_t)(u32WidthMbs * 16 - u32CropUnitX * (au32Crop[0] + au32Crop[1]));
+    psSps->u16Height = (uint16_t)((2 - u32FrameMbsOnly) * u32HeightMapUnits * 16 - u32CropUnitY * (au32Crop[2] + au32Crop[3]));
+
+    return TRUE;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: H264_pu8NextNal
+ *
+ * DESCRIPTION:
+ * Finds the next NAL unit of an Annex B byte stream, starting the search at
+ * *pu32Offset and leaving *pu32Offset at the end of the NAL unit found
+ *
+ * RETURNS:
+ * uint8_t * - The first byte of the NAL unit, or NULL if there are no more
+ *
+ ****************************************************************************/
+uint8_t *H264_pu8NextNal(uint8_t *pu8Data, uint32_t u32Length, uint32_t *pu32Offset, uint32_t *pu32NalLength)
+{
+    uint32_t u32Pos = *pu32Offset;
+    uint32_t u32Start;
+
+    // Skip to just after the next start code
+    while((u32Pos + 3 <= u32Length) && !((pu8Data[u32Pos] == 0) && (pu8Data[u32Pos + 1] == 0) && (pu8Data[u32Pos + 2] == 1)))
+    {
+        u32Pos++;
+    }
+    if(u32Pos + 3 >= u32Length)
+    {
+        *pu32Offset = u32Length;
+        return NULL;
+    }
+    u32Start = u32Pos + 3;
+
+    // The NAL unit runs up to the next start code, less any zero bytes in front of it
+    u32Pos = u32Start;
+    while((u32Pos + 3 <= u32Length) && !((pu8Data[u32Pos] == 0) && (pu8Data[u32Pos + 1] == 0) && (pu8Data[u32Pos + 2] == 1)))
+    {
+        u32Pos++;
+    }
+    if(u32Pos + 3 > u32Length)
+    {
+        u32Pos = u32Length;
+    }
+    *pu32Offset = u32Pos;
+
+    while((u32Pos > u32Start) && (pu8Data[u32Pos - 1] == 0))
+    {
+        u32Pos--;
+    }
+    *pu32NalLength = u32Pos - u32Start;
+
+    return pu8Data + u32Start;
+}
+
+/****************************************************************************/
+/***        Local Functions                                               ***/
+/****************************************************************************/
+
+/****************************************************************************
+ *
+ * NAME: H264_bEnsureCapacity
+ *
+ * DESCRIPTION:
+ * Grows the frame buffer so that it can hold u32Length bytes of access unit
+ *
+ * RETURNS:
+ * bool_t TRUE if the buffer is large enough, FALSE otherwise
+ *
+ ****************************************************************************/
+static bool_t H264_bEnsureCapacity(H264_tsDepacketizer *psDepacketizer, uint32_t u32Length)
+{
+    uint32_t u32NewLength = psDepacketizer->u32BufferLength;
+    uint8_t *pu8NewBuffer;
+
+    if(u32Length <= psDepacketizer->u32BufferLength)
+    {
+        return TRUE;
+    }
+
+    if(u32Length > H264_MAX_FRAME_LENGTH)
+    {
+        return FALSE;
+    }
+
+    while(u32NewLength < u32Length)
+    {
+        u32NewLength *= 2;
+    }
+
+    pu8NewBuffer = (uint8_t*)realloc(psDepacketizer->pu8Buffer, H264_MAX_HEADER_LENGTH + u32NewLength);
+    if(pu8NewBuffer == NULL)
+    {
+        return FALSE;
+    }
+
+    psDepacketizer->pu8Buffer = pu8NewBuffer;
+    psDepacketizer->u32BufferLength = u32NewLength;
+
+    return TRUE;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: H264_vStartFrame
+ *
+ * DESCRIPTION:
+ * Resets the reassembly state for the access unit with the packet's timestamp
+ *
+ * RETURNS:
+ * void
+ *
+ ****************************************************************************/
+static void H264_vStartFrame(H264_tsDepacketizer *psDepacketizer, RTP_tsPacket *psPacket)
+{
+    psDepacketizer->bInFrame = TRUE;
+    psDepacketizer->bCorrupt = FALSE;
+    psDepacketizer->bInFragment = FALSE;
+    psDepacketizer->bKeyFrame = FALSE;
+    psDepacketizer->bHasSps = FALSE;
+    psDepacketizer->bHasPps = FALSE;
+    psDepacketizer->u32Timestamp = psPacket->u32Timestamp;
+    psDepacketizer->u32Length = 0;
+    psDepacketizer->u64FirstPacketTimeUs = psPacket->u64ArrivalTimeUs;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: H264_bAppendNal
+ *
+ * DESCRIPTION:
+ * Appends a complete NAL unit to the access unit, preceded by a start code
+ *
+ * RETURNS:
+ * bool_t TRUE if successful, FALSE if the access unit is too large
+ *
+ ****************************************************************************/
+static bool_t H264_bAppendNal(H264_tsDepacketizer *psDepacketizer, const uint8_t *pu8Nal, uint32_t u32Length)
+{
+    if(!H264_bAppend(psDepacketizer, H264_au8StartCode, H264_START_CODE_LENGTH) ||
+       !H264_bAppend(psDepacketizer, pu8Nal, u32Length))
+    {
+        return FALSE;
+    }
+
+    H264_vNoteNal(psDepacketizer, pu8Nal, u32Length);
+
+    return TRUE;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: H264_bAppend
+ *
+ * DESCRIPTION:
+ * Appends bytes to the access unit
+ *
+ * RETURNS:
+ * bool_t TRUE if successful, FALSE if the access unit is too large
+ *
+ ****************************************************************************/
+static bool_t H264_bAppend(H264_tsDepacketizer *psDepacketizer, const uint8_t *pu8Data, uint32_t u32Length)
+{
+    if(!H264_bEnsureCapacity(psDepacketizer, psDepacketizer->u32Length + u32Length))
+    {
+        return FALSE;
+    }
+    memcpy(psDepacketizer->pu8Buffer + H264_MAX_HEADER_LENGTH + psDepacketizer->u32Length, pu8Data, u32Length);
+    psDepacketizer->u32Length += u32Length;
+
+    return TRUE;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: H264_vNoteNal
+ *
+ * DESCRIPTION:
+ * Records what kind of NAL unit the access unit contains, caching parameter
+ * sets. Fragmented NAL units are only seen by their header.
+ *
+ * RETURNS:
+ * void
+ *
+ ****************************************************************************/
+static void H264_vNoteNal(H264_tsDepacketizer *psDepacketizer, const uint8_t *pu8Nal, uint32_t u32Length)
+{
+    switch(pu8Nal[0] & 0x1f)
+    {
+    case H264_NAL_TYPE_IDR:
+        psDepacketizer->bKeyFrame = TRUE;
+        break;
+
+    case H264_NAL_TYPE_SPS:
+        psDepacketizer->bHasSps = TRUE;
+        if((u32Length > 1) && (u32Length <= H264_MAX_PARAMETER_SET_LENGTH))
+        {
+            memcpy(psDepacketizer->au8Sps, pu8Nal, u32Length);
+            psDepacketizer->u32SpsLength = u32Length;
+            H264_bParseSps(pu8Nal, u32Length, &psDepacketizer->sSps);
+        }
+        break;
+
+    case H264_NAL_TYPE_PPS:
+        psDepacketizer->bHasPps = TRUE;
+        if((u32Length > 1) && (u32Length <= H264_MAX_PARAMETER_SET_LENGTH))
+        {
+            memcpy(psDepacketizer->au8Pps, pu8Nal, u32Length);
+            psDepacketizer->u32PpsLength = u32Length;
+        }
+        break;
+
+    default:
+        break;
+    }
+}
+
+
+/****************************************************************************
+ *
+ * NAME: H264_u32Prepend
+ *
+ * DESCRIPTION:
+ * Places a NAL unit and its start code in the header space, in front of the
+ * u32HeaderLength bytes already there
+ *
+ * RETURNS:
+ * uint32_t The new length of the header
+ *
+ ****************************************************************************/
+static uint32_t H264_u32Prepend(H264_tsDepacketizer *psDepacketizer, uint32_t u32HeaderLength, const uint8_t *pu8Nal, uint32_t u32Length)
+{
+    uint8_t *pu8Ptr;
+
+    u32HeaderLength += H264_START_CODE_LENGTH + u32Length;
+    pu8Ptr = psDepacketizer->pu8Buffer + H264_MAX_HEADER_LENGTH - u32HeaderLength;
+    memcpy(pu8Ptr, H264_au8StartCode, H264_START_CODE_LENGTH);
+    memcpy(pu8Ptr + H264_START_CODE_LENGTH, pu8Nal, u32Length);
+
+    return u32HeaderLength;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: H264_u32ReadBits
+ *
+ * DESCRIPTION:
+ * Reads up to 32 bits, flagging an overrun if the data runs out
+ *
+ * RETURNS:
+ * uint32_t The bits read
+ *
+ ****************************************************************************/
+static uint32_t H264_u32ReadBits(H264_tsBitReader *psReader, uint32_t u32NumBits)
+{
+    uint32_t u32Value = 0;
+
+    while(u32NumBits--)
+    {
+        if(psReader->u32BitPos >= psReader->u32Length * 8)
+        {
+            psReader->bOverrun = TRUE;
+            return 0;
+        }
+        u32Value = (u32Value << 1) | ((psReader->pu8Data[psReader->u32BitPos >> 3] >> (7 - (psReader->u32BitPos & 7))) & 1);
+        psReader->u32BitPos++;
+    }
+
+    return u32Value;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: H264_u32ReadUe
+ *
+ * DESCRIPTION:
+ * Reads an unsigned Exp-Golomb coded value
+ *
+ * RETURNS:
+ * uint32_t The value read
+ *
+ ****************************************************************************/
+static uint32_t H264_u32ReadUe(H264_tsBitReader *psReader)
+{
+    uint32_t u32LeadingZeros = 0;
+
+    while(!H264_u32ReadBits(psReader, 1))
+    {
+        if(psReader->bOverrun || (++u32LeadingZeros > 31))
+        {
+            psReader->bOverrun = TRUE;
+            return 0;
+        }
+    }
+
+    return ((1U << u32LeadingZeros) - 1) + H264_u32ReadBits(psReader, u32LeadingZeros);
+}
+
+
+/****************************************************************************
+ *
+ * NAME: H264_i32ReadSe
+ *
+ * DESCRIPTION:
+ * Reads a signed Exp-Golomb coded value
+ *
+ * RETURNS:
+ * int32_t The value read
+ *
+ ****************************************************************************/
+static int32_t H264_i32ReadSe(H264_tsBitReader *psReader)
+{
+    uint32_t u32Value = H264_u32ReadUe(psReader);
+
+    if(u32Value & 1)
+    {
+        return (int32_t)((u32Value + 1) / 2);
+    }
+
+    return -(int32_t)(u32Value / 2);
+}
+
+
+/****************************************************************************
+ *
+ * NAME: H264_vSkipScalingList
+ *
+ * DESCRIPTION:
+ * Skips over a scaling list of an SPS, as described in section 7.3.2.1.1.1
+ *
+ * RETURNS:
+ * void
+ *
+ ****************************************************************************/
+static void H264_vSkipScalingList(H264_tsBitReader *psReader, int iSize)
+{
+    int iLastScale = 8;
+    int iNextScale = 8;
+    int n;
+
+    for(n = 0; (n < iSize) && !psReader->bOverrun; n++)
+    {
+        if(iNextScale != 0)
+        {
+            iNextScale = (iLastScale + H264_i32ReadSe(psReader) + 256) % 256;
+        }
+        iLastScale = (iNextScale == 0) ? iLastScale : iNextScale;
+    }
+}
+
+/****************************************************************************/
+/***        END OF FILE                                                   ***/
+/****************************************************************************/
@@ -0,0 +1,89 @@
+#ifndef H264_H
+#define H264_H
+
+/****************************************************************************/
+/***        Include files                                                 ***/
+/****************************************************************************/
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "common.h"
+#include "rtp.h"
+
+/****************************************************************************/
+/***        Macro Definitions                                             ***/
+/****************************************************************************/
+
+#define H264_MAX_PARAMETER_SET_LENGTH   256
+#define H264_MAX_HEADER_LENGTH          (2 * (4 + H264_MAX_PARAMETER_SET_LENGTH))  // Space reserved in front of an access unit for SPS and PPS
+#define H264_INITIAL_FRAME_LENGTH       (512 * 1024)
+#define H264_MAX_FRAME_LENGTH           (8 * 1024 * 1024)
+
+#define H264_NAL_TYPE_SLICE             1
+#define H264_NAL_TYPE_IDR               5
+#define H264_NAL_TYPE_SEI               6
+#define H264_NAL_TYPE_SPS               7
+#define H264_NAL_TYPE_PPS               8
+#define H264_NAL_TYPE_AUD               9
+#define H264_NAL_TYPE_STAP_A            24
+#define H264_NAL_TYPE_FU_A              28
+
+/****************************************************************************/
+/***        Type Definitions                                              ***/
+/****************************************************************************/
+
+// Fields of a sequence parameter set needed to describe the stream to a container
+typedef struct {
+    uint8_t u8Profile;
+    uint8_t u8Constraints;
+    uint8_t u8Level;
+    uint8_t u8ChromaFormat;
+    uint8_t u8BitDepthLuma;
+    uint8_t u8BitDepthChroma;
+    uint16_t u16Width;
+    uint16_t u16Height;
+} H264_tsSps;
+
+// Reassembly state for one RTP/H.264 (RFC 6184, non-interleaved mode) stream.
+// Access units are returned in Annex B format with 4 byte start codes, so
+// every NAL unit can be turned into a length prefixed one in place.
+typedef struct {
+    uint8_t *pu8Buffer;                             // H264_MAX_HEADER_LENGTH bytes of header space followed by the access unit
+    uint32_t u32BufferLength;                       // Capacity available for the access unit
+    uint32_t u32Length;
+    bool_t bInFrame;
+    bool_t bCorrupt;                                // A packet of the access unit was lost or malformed
+    bool_t bInFragment;                             // Between the start and end of a FU-A
+    bool_t bKeyFrame;
+    bool_t bHasSps;
+    bool_t bHasPps;
+    bool_t bWaitForKeyFrame;                        // After a loss, frames can't be decoded until the next IDR
+    uint32_t u32Timestamp;
+    bool_t bSeqValid;
+    uint16_t u16NextSeq;
+    uint64_t u64FirstPacketTimeUs;
+    uint8_t au8Sps[H264_MAX_PARAMETER_SET_LENGTH];  // Most recent parameter sets, repeated in front of IDRs without them
+    uint32_t u32SpsLength;
+    uint8_t au8Pps[H264_MAX_PARAMETER_SET_LENGTH];
+    uint32_t u32PpsLength;
+    H264_tsSps sSps;
+    uint32_t u32FramesCompleted;
+    uint32_t u32FramesDropped;
+} H264_tsDepacketizer;
+
+/****************************************************************************/
+/***        Exported Functions                                            ***/
+/****************************************************************************/
+
+bool_t H264_bInit(H264_tsDepacketizer *psDepacketizer);
+void H264_vDeInit(H264_tsDepacketizer *psDepacketizer);
+bool_t H264_bPushPacket(H264_tsDepacketizer *psDepacketizer, RTP_tsPacket *psPacket, RTP_tsFrame *psFrame);
+bool_t H264_bParseSps(const uint8_t *pu8Nal, uint32_t u32Length, H264_tsSps *psSps);
+uint8_t *H264_pu8NextNal(uint8_t *pu8Data, uint32_t u32Length, uint32_t *pu32Offset, uint32_t *pu32NalLength);
+
+#endif // H264_H
+
+/****************************************************************************/
+/***        END OF FILE                                                   ***/
+/****************************************************************************/
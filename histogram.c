@@ -0,0 +1,494 @@
+/****************************************************************************
+ *
+ * Copyright 2021 Lee Mitchell <lee@indigopepper.com>
+ * This file is part of OCC (Orlaco Camera Configurator)
+ *
+ * OCC (Orlaco Camera Configurator) is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * OCC (Orlaco Camera Configurator) is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with OCC (Orlaco Camera Configurator).  If not,
+ * see <http://www.gnu.org/licenses/>.
+ *
+ ****************************************************************************/
+
+/****************************************************************************/
+/***        Include files                                                 ***/
+/****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "common.h"
+#include "histogram.h"
+
+/****************************************************************************/
+/***        Macro Definitions                                             ***/
+/****************************************************************************/
+
+#define HISTOGRAM_LANES                 4                   // Bins per vector, ORLACO_HISTOGRAM_MAX_BINS is a multiple of this
+
+// GCC and clang vector extensions, which turn into SSE or NEON without any target specific code
+#if defined(__clang__) || (defined(__GNUC__) && (__GNUC__ >= 9))
+#define HISTOGRAM_VECTORS
+#endif
+
+/****************************************************************************/
+/***        Type Definitions                                              ***/
+/****************************************************************************/
+
+#ifdef HISTOGRAM_VECTORS
+typedef uint32_t HISTOGRAM_tvU32 __attribute__((vector_size(HISTOGRAM_LANES * sizeof(uint32_t))));
+typedef float HISTOGRAM_tvF32 __attribute__((vector_size(HISTOGRAM_LANES * sizeof(float))));
+#endif
+
+/****************************************************************************/
+/***        Local Function Prototypes                                     ***/
+/****************************************************************************/
+
+static HISTOGRAM_tsSeries *HISTOGRAM_psGetSeries(HISTOGRAM_tsInstance *psHistograms, ORLACO_tuIP uIP, uint32_t u32RegionOfInterest);
+static void HISTOGRAM_vResetSeries(HISTOGRAM_tsInstance *psHistograms, HISTOGRAM_tsSeries *psSeries, uint32_t u32NumBins);
+static uint64_t HISTOGRAM_u64GetTotal(HISTOGRAM_tsSeries *psSeries);
+static void HISTOGRAM_vRoll(uint32_t *pu32Sum, const uint32_t *pu32Add, const uint32_t *pu32Remove, uint32_t u32NumBins);
+static void HISTOGRAM_vAccumulate(float *pfPdf, const uint32_t *pu32Sum, float fScale, uint32_t u32NumBins);
+static void HISTOGRAM_vSummarise(const float *pfPdf, uint32_t u32NumBins, HISTOGRAM_tsStats *psStats);
+
+/****************************************************************************/
+/***        Exported Variables                                            ***/
+/****************************************************************************/
+
+/****************************************************************************/
+/***        Local Variables                                               ***/
+/****************************************************************************/
+
+/****************************************************************************/
+/***        Exported Functions                                            ***/
+/****************************************************************************/
+
+/****************************************************************************
+ *
+ * NAME: HISTOGRAM_bInit
+ *
+ * DESCRIPTION:
+ * Sets up rolling sums over the last u32Window histograms of each camera
+ *
+ * RETURNS:
+ * bool_t TRUE if successful, FALSE otherwise
+ *
+ ****************************************************************************/
+bool_t HISTOGRAM_bInit(HISTOGRAM_tsInstance *psHistograms, uint32_t u32Window)
+{
+    memset(psHistograms, 0, sizeof(HISTOGRAM_tsInstance));
+
+    if((u32Window == 0) || (u32Window > HISTOGRAM_MAX_WINDOW))
+    {
+        printf("Error: Histogram window must be 1 to %d in %s\n", HISTOGRAM_MAX_WINDOW, __FUNCTION__);
+        return FALSE;
+    }
+
+    psHistograms->u32Window = u32Window;
+
+    return TRUE;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: HISTOGRAM_vDeInit
+ *
+ * DESCRIPTION:
+ * Frees the windows of every series
+ *
+ * RETURNS:
+ * void
+ *
+ ****************************************************************************/
+void HISTOGRAM_vDeInit(HISTOGRAM_tsInstance *psHistograms)
+{
+    uint32_t n;
+
+    for(n = 0; n < psHistograms->u32NumSeries; n++)
+    {
+        free(psHistograms->asSeries[n].pu32Window);
+    }
+
+    psHistograms->u32NumSeries = 0;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: HISTOGRAM_bPush
+ *
+ * DESCRIPTION:
+ * Adds a histogram to the rolling sum of its camera and ROI, taking out the
+ * one that falls out of the window. A change in the number of bins starts
+ * the series again.
+ *
+ * RETURNS:
+ * bool_t TRUE if successful, FALSE if there's no room for a new series
+ *
+ ****************************************************************************/
+bool_t HISTOGRAM_bPush(HISTOGRAM_tsInstance *psHistograms, ORLACO_tsHistogram *psHistogram)
+{
+    HISTOGRAM_tsSeries *psSeries;
+    uint32_t au32New[ORLACO_HISTOGRAM_MAX_BINS];
+    uint32_t *pu32Row;
+
+    psSeries = HISTOGRAM_psGetSeries(psHistograms, psHistogram->uIP, psHistogram->u32RegionOfInterest);
+    if(psSeries == NULL)
+    {
+        return FALSE;
+    }
+
+    if(psSeries->u32NumBins != psHistogram->u16NumBins)
+    {
+        HISTOGRAM_vResetSeries(psHistograms, psSeries, psHistogram->u16NumBins);
+    }
+
+    // Pad to a whole number of vectors so the kernels never need a tail
+    memset(au32New, 0, sizeof(au32New));
+    memcpy(au32New, psHistogram->au32Bins, psSeries->u32NumBins * sizeof(uint32_t));
+
+    // Until the window fills, the row being replaced is still all zeros
+    pu32Row = psSeries->pu32Window + (psSeries->u32Head * ORLACO_HISTOGRAM_MAX_BINS);
+    HISTOGRAM_vRoll(psSeries->au32Sum, au32New, pu32Row, psSeries->u32NumBins);
+    memcpy(pu32Row, au32New, sizeof(au32New));
+
+    psSeries->u32Head = (psSeries->u32Head + 1) % psHistograms->u32Window;
+    if(psSeries->u32Count < psHistograms->u32Window)
+    {
+        psSeries->u32Count++;
+    }
+    psSeries->u32LastFrameCounter = psHistogram->u32FrameCounter;
+    psSeries->u64Histograms++;
+
+    return TRUE;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: HISTOGRAM_bGetStats
+ *
+ * DESCRIPTION:
+ * Summarises the rolling sum of one series
+ *
+ * RETURNS:
+ * bool_t TRUE if successful, FALSE if the series is empty
+ *
+ ****************************************************************************/
+bool_t HISTOGRAM_bGetStats(HISTOGRAM_tsInstance *psHistograms, uint32_t u32Series, HISTOGRAM_tsStats *psStats)
+{
+    HISTOGRAM_tsSeries *psSeries;
+    float afPdf[ORLACO_HISTOGRAM_MAX_BINS];
+    uint64_t u64Total;
+
+    if(u32Series >= psHistograms->u32NumSeries)
+    {
+        return FALSE;
+    }
+    psSeries = &psHistograms->asSeries[u32Series];
+
+    u64Total = HISTOGRAM_u64GetTotal(psSeries);
+    if(u64Total == 0)
+    {
+        return FALSE;
+    }
+
+    memset(afPdf, 0, sizeof(afPdf));
+    HISTOGRAM_vAccumulate(afPdf, psSeries->au32Sum, 1.0f / (float)u64Total, psSeries->u32NumBins);
+
+    HISTOGRAM_vSummarise(afPdf, psSeries->u32NumBins, psStats);
+    psStats->u32Histograms = psSeries->u32Count;
+
+    return TRUE;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: HISTOGRAM_bGetCombinedStats
+ *
+ * DESCRIPTION:
+ * Summarises all series together. Each is normalised first so every camera
+ * counts the same whatever its resolution. Series with a different number
+ * of bins from the first one can't be combined and are left out.
+ *
+ * RETURNS:
+ * bool_t TRUE if successful, FALSE if there's nothing to summarise
+ *
+ ****************************************************************************/
+bool_t HISTOGRAM_bGetCombinedStats(HISTOGRAM_tsInstance *psHistograms, HISTOGRAM_tsStats *psStats)
+{
+    float afPdf[ORLACO_HISTOGRAM_MAX_BINS];
+    uint64_t au64Totals[HISTOGRAM_MAX_SERIES];
+    uint32_t u32NumBins = 0;
+    uint32_t u32NumCombined = 0;
+    uint32_t u32Histograms = 0;
+    uint32_t n;
+
+    for(n = 0; n < psHistograms->u32NumSeries; n++)
+    {
+        au64Totals[n] = HISTOGRAM_u64GetTotal(&psHistograms->asSeries[n]);
+        if(au64Totals[n] == 0)
+        {
+            continue;
+        }
+        if(u32NumBins == 0)
+        {
+            u32NumBins = psHistograms->asSeries[n].u32NumBins;
+        }
+        if(psHistograms->asSeries[n].u32NumBins != u32NumBins)
+        {
+            au64Totals[n] = 0;
+            continue;
+        }
+        u32NumCombined++;
+    }
+
+    if(u32NumCombined == 0)
+    {
+        return FALSE;
+    }
+
+    memset(afPdf, 0, sizeof(afPdf));
+    for(n = 0; n < psHistograms->u32NumSeries; n++)
+    {
+        if(au64Totals[n] != 0)
+        {
+            HISTOGRAM_vAccumulate(afPdf, psHistograms->asSeries[n].au32Sum, 1.0f / ((float)au64Totals[n] * (float)u32NumCombined), u32NumBins);
+            u32Histograms += psHistograms->asSeries[n].u32Count;
+        }
+    }
+
+    HISTOGRAM_vSummarise(afPdf, u32NumBins, psStats);
+    psStats->u32Histograms = u32Histograms;
+
+    return TRUE;
+}
+
+
+/****************************************************************************/
+/***        Local Functions                                               ***/
+/****************************************************************************/
+
+/****************************************************************************
+ *
+ * NAME: HISTOGRAM_psGetSeries
+ *
+ * DESCRIPTION:
+ * Finds the series of a camera and ROI, adding it if it's new
+ *
+ * RETURNS:
+ * HISTOGRAM_tsSeries * - The series, or NULL if there's no room for it
+ *
+ ****************************************************************************/
+static HISTOGRAM_tsSeries *HISTOGRAM_psGetSeries(HISTOGRAM_tsInstance *psHistograms, ORLACO_tuIP uIP, uint32_t u32RegionOfInterest)
+{
+    HISTOGRAM_tsSeries *psSeries;
+    uint32_t n;
+
+    for(n = 0; n < psHistograms->u32NumSeries; n++)
+    {
+        psSeries = &psHistograms->asSeries[n];
+        if((psSeries->uIP.u32IP == uIP.u32IP) && (psSeries->u32RegionOfInterest == u32RegionOfInterest))
+        {
+            return psSeries;
+        }
+    }
+
+    if(psHistograms->u32NumSeries == HISTOGRAM_MAX_SERIES)
+    {
+        return NULL;
+    }
+
+    psSeries = &psHistograms->asSeries[psHistograms->u32NumSeries];
+    memset(psSeries, 0, sizeof(HISTOGRAM_tsSeries));
+    psSeries->pu32Window = calloc(psHistograms->u32Window * ORLACO_HISTOGRAM_MAX_BINS, sizeof(uint32_t));
+    if(psSeries->pu32Window == NULL)
+    {
+        printf("Error: Failed to allocate a histogram window in %s\n", __FUNCTION__);
+        return NULL;
+    }
+    psSeries->uIP = uIP;
+    psSeries->u32RegionOfInterest = u32RegionOfInterest;
+    psHistograms->u32NumSeries++;
+
+    return psSeries;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: HISTOGRAM_vResetSeries
+ *
+ * DESCRIPTION:
+ * Empties the window of a series and sets its number of bins
+ *
+ * RETURNS:
+ * void
+ *
+ ****************************************************************************/
+static void HISTOGRAM_vResetSeries(HISTOGRAM_tsInstance *psHistograms, HISTOGRAM_tsSeries *psSeries, uint32_t u32NumBins)
+{
+    memset(psSeries->pu32Window, 0, psHistograms->u32Window * ORLACO_HISTOGRAM_MAX_BINS * sizeof(uint32_t));
+    memset(psSeries->au32Sum, 0, sizeof(psSeries->au32Sum));
+    psSeries->u32NumBins = u32NumBins;
+    psSeries->u32Head = 0;
+    psSeries->u32Count = 0;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: HISTOGRAM_u64GetTotal
+ *
+ * DESCRIPTION:
+ * Counts the pixels in the rolling sum of a series
+ *
+ * RETURNS:
+ * uint64_t The number of pixels
+ *
+ ****************************************************************************/
+static uint64_t HISTOGRAM_u64GetTotal(HISTOGRAM_tsSeries *psSeries)
+{
+    uint64_t u64Total = 0;
+    uint32_t n;
+
+    for(n = 0; n < psSeries->u32NumBins; n++)
+    {
+        u64Total += psSeries->au32Sum[n];
+    }
+
+    return u64Total;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: HISTOGRAM_vRoll
+ *
+ * DESCRIPTION:
+ * Adds one histogram to a rolling sum and takes another out of it. The
+ * arrays must be padded to a whole number of vectors.
+ *
+ * RETURNS:
+ * void
+ *
+ ****************************************************************************/
+static void HISTOGRAM_vRoll(uint32_t *pu32Sum, const uint32_t *pu32Add, const uint32_t *pu32Remove, uint32_t u32NumBins)
+{
+    uint32_t n;
+
+#ifdef HISTOGRAM_VECTORS
+    HISTOGRAM_tvU32 vSum, vAdd, vRemove;
+
+    for(n = 0; n < u32NumBins; n += HISTOGRAM_LANES)
+    {
+        // memcpy rather than casts, the arrays are only aligned for their elements
+        memcpy(&vSum, &pu32Sum[n], sizeof(vSum));
+        memcpy(&vAdd, &pu32Add[n], sizeof(vAdd));
+        memcpy(&vRemove, &pu32Remove[n], sizeof(vRemove));
+        vSum += vAdd - vRemove;
+        memcpy(&pu32Sum[n], &vSum, sizeof(vSum));
+    }
+#else
+    for(n = 0; n < u32NumBins; n++)
+    {
+        pu32Sum[n] += pu32Add[n] - pu32Remove[n];
+    }
+#endif
+}
+
+
+/****************************************************************************
+ *
+ * NAME: HISTOGRAM_vAccumulate
+ *
+ * DESCRIPTION:
+ * Adds a rolling sum scaled by fScale to a probability density. The arrays
+ * must be padded to a whole number of vectors.
+ *
+ * RETURNS:
+ * void
+ *
+ ****************************************************************************/
+static void HISTOGRAM_vAccumulate(float *pfPdf, const uint32_t *pu32Sum, float fScale, uint32_t u32NumBins)
+{
+    uint32_t n;
+
+#ifdef HISTOGRAM_VECTORS
+    HISTOGRAM_tvU32 vSum;
+    HISTOGRAM_tvF32 vPdf;
+
+    for(n = 0; n < u32NumBins; n += HISTOGRAM_LANES)
+    {
+        memcpy(&vSum, &pu32Sum[n], sizeof(vSum));
+        memcpy(&vPdf, &pfPdf[n], sizeof(vPdf));
+        vPdf += __builtin_convertvector(vSum, HISTOGRAM_tvF32) * fScale;
+        memcpy(&pfPdf[n], &vPdf, sizeof(vPdf));
+    }
+#else
+    for(n = 0; n < u32NumBins; n++)
+    {
+        pfPdf[n] += (float)pu32Sum[n] * fScale;
+    }
+#endif
+}
+
+
+/****************************************************************************
+ *
+ * NAME: HISTOGRAM_vSummarise
+ *
+ * DESCRIPTION:
+ * Works out the mean, percentiles and clipping of a probability density,
+ * taking each bin to be at its centre
+ *
+ * RETURNS:
+ * void
+ *
+ ****************************************************************************/
+static void HISTOGRAM_vSummarise(const float *pfPdf, uint32_t u32NumBins, HISTOGRAM_tsStats *psStats)
+{
+    uint32_t u32Edge = (u32NumBins >= 16) ? (u32NumBins / 16) : 1;
+    float fCumulative = 0.0f;
+    float fLevel;
+    uint32_t n;
+
+    memset(psStats, 0, sizeof(HISTOGRAM_tsStats));
+    psStats->u32P5 = psStats->u32Median = psStats->u32P95 = 255;
+
+    for(n = 0; n < u32NumBins; n++)
+    {
+        fLevel = ((float)n + 0.5f) * 256.0f / (float)u32NumBins;
+        psStats->fMean += pfPdf[n] * fLevel;
+
+        // Compare against the previous total so each percentile is only set once
+        if((fCumulative < 0.05f) && (fCumulative + pfPdf[n] >= 0.05f)) psStats->u32P5 = (uint32_t)fLevel;
+        if((fCumulative < 0.50f) && (fCumulative + pfPdf[n] >= 0.50f)) psStats->u32Median = (uint32_t)fLevel;
+        if((fCumulative < 0.95f) && (fCumulative + pfPdf[n] >= 0.95f)) psStats->u32P95 = (uint32_t)fLevel;
+        fCumulative += pfPdf[n];
+
+        if(n < u32Edge)
+        {
+            psStats->fDarkPercent += pfPdf[n] * 100.0f;
+        }
+        if(n >= (u32NumBins - u32Edge))
+        {
+            psStats->fBrightPercent += pfPdf[n] * 100.0f;
+        }
+    }
+}
+
+/****************************************************************************/
+/***        END OF FILE                                                   ***/
+/****************************************************************************/
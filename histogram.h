@@ -0,0 +1,71 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+/****************************************************************************/
+/***        Include files                                                 ***/
+/****************************************************************************/
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "common.h"
+#include "orlaco.h"
+
+/****************************************************************************/
+/***        Macro Definitions                                             ***/
+/****************************************************************************/
+
+#define HISTOGRAM_MAX_SERIES            32                  // Camera and ROI pairs tracked
+#define HISTOGRAM_MAX_WINDOW            64
+#define HISTOGRAM_DEFAULT_WINDOW        25                  // Histograms each rolling sum covers
+#define HISTOGRAM_DEFAULT_BINS          64
+
+/****************************************************************************/
+/***        Type Definitions                                              ***/
+/****************************************************************************/
+
+// The last u32Window histograms from one region of interest of one camera and their per bin sum
+typedef struct {
+    ORLACO_tuIP uIP;
+    uint32_t u32RegionOfInterest;
+    uint32_t u32NumBins;
+    uint32_t *pu32Window;                           // u32Window rows of ORLACO_HISTOGRAM_MAX_BINS, oldest at u32Head once full
+    uint32_t au32Sum[ORLACO_HISTOGRAM_MAX_BINS];    // Bins past u32NumBins stay zero
+    uint32_t u32Head;
+    uint32_t u32Count;
+    uint32_t u32LastFrameCounter;
+    uint64_t u64Histograms;
+} HISTOGRAM_tsSeries;
+
+// Exposure summary of a rolling sum, brightness on a 0 to 255 scale whatever the number of bins
+typedef struct {
+    uint32_t u32Histograms;                         // In the window(s) summarised
+    float fMean;
+    uint32_t u32Median;
+    uint32_t u32P5;
+    uint32_t u32P95;
+    float fDarkPercent;                             // Pixels in the darkest sixteenth of the range
+    float fBrightPercent;                           // Pixels in the brightest sixteenth of the range
+} HISTOGRAM_tsStats;
+
+typedef struct {
+    HISTOGRAM_tsSeries asSeries[HISTOGRAM_MAX_SERIES];
+    uint32_t u32NumSeries;
+    uint32_t u32Window;
+} HISTOGRAM_tsInstance;
+
+/****************************************************************************/
+/***        Exported Functions                                            ***/
+/****************************************************************************/
+
+bool_t HISTOGRAM_bInit(HISTOGRAM_tsInstance *psHistograms, uint32_t u32Window);
+void HISTOGRAM_vDeInit(HISTOGRAM_tsInstance *psHistograms);
+bool_t HISTOGRAM_bPush(HISTOGRAM_tsInstance *psHistograms, ORLACO_tsHistogram *psHistogram);
+bool_t HISTOGRAM_bGetStats(HISTOGRAM_tsInstance *psHistograms, uint32_t u32Series, HISTOGRAM_tsStats *psStats);
+bool_t HISTOGRAM_bGetCombinedStats(HISTOGRAM_tsInstance *psHistograms, HISTOGRAM_tsStats *psStats);
+
+#endif // HISTOGRAM_H
+
+/****************************************************************************/
+/***        END OF FILE                                                   ***/
+/****************************************************************************/
@@ -0,0 +1,903 @@
+/****************************************************************************
+ *
+ * Copyright 2021 Lee Mitchell <lee@indigopepper.com>
+ * This file is part of OCC (Orlaco Camera Configurator)
+ *
+ * OCC (Orlaco Camera Configurator) is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * OCC (Orlaco Camera Configurator) is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with OCC (Orlaco Camera Configurator).  If not,
+ * see <http://www.gnu.org/licenses/>.
+ *
+ ****************************************************************************/
+
+/****************************************************************************/
+/***        Include files                                                 ***/
+/****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "common.h"
+#include "history.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+/****************************************************************************/
+/***        Macro Definitions                                             ***/
+/****************************************************************************/
+
+#define HISTORY_RECORD_LENGTH           (sizeof(uint32_t) + sizeof(uint16_t) + sizeof(uint32_t))
+#define HISTORY_MAX_OFFSET_MS           0xffffffffULL       // Furthest a record can be from its segment's base
+#define HISTORY_MAX_FILE_PATH_LENGTH    (HISTORY_MAX_PATH_LENGTH + 48) // Room for the camera and segment names after the directory
+
+/****************************************************************************/
+/***        Type Definitions                                              ***/
+/****************************************************************************/
+
+// What a query knows of the value of a key before the change it's looking at
+typedef struct {
+    uint16_t u16Key;
+    bool_t bKnown;
+    uint32_t u32Value;
+} HISTORY_tsWas;
+
+/****************************************************************************/
+/***        Local Function Prototypes                                     ***/
+/****************************************************************************/
+
+#ifndef _WIN32
+static HISTORY_tsCamera *HISTORY_psGetCamera(HISTORY_tsInstance *psHistory, ORLACO_tuIP uIP, uint64_t u64TimeMs);
+static bool_t HISTORY_bOpenLatest(HISTORY_tsInstance *psHistory, HISTORY_tsCamera *psCamera, uint64_t u64TimeMs);
+static void HISTORY_vCatchUp(HISTORY_tsCamera *psCamera, uint32_t u32NumRecords);
+static HISTORY_tsValue *HISTORY_psGetValue(HISTORY_tsCamera *psCamera, uint16_t u16Key);
+static bool_t HISTORY_bMap(HISTORY_tsSegment *psSegment, char *pcPath, bool_t bWrite, ORLACO_tuIP uIP, uint64_t u64BaseMs);
+static void HISTORY_vUnmap(HISTORY_tsSegment *psSegment);
+static uint32_t HISTORY_u32ListSegments(HISTORY_tsInstance *psHistory, ORLACO_tuIP uIP, uint64_t *pu64Bases);
+static bool_t HISTORY_bMapSegment(HISTORY_tsInstance *psHistory, ORLACO_tuIP uIP, uint64_t u64BaseMs, bool_t bWrite, HISTORY_tsSegment *psSegment);
+static bool_t HISTORY_bFindWas(HISTORY_tsInstance *psHistory, ORLACO_tuIP uIP, uint64_t *pu64Bases, uint32_t u32Segment, HISTORY_tsSegment *psSegment, uint32_t u32Record, uint16_t u16Key, uint32_t *pu32Was);
+static int HISTORY_iCompare(const void *pvA, const void *pvB);
+#endif
+
+/****************************************************************************/
+/***        Exported Variables                                            ***/
+/****************************************************************************/
+
+/****************************************************************************/
+/***        Local Variables                                               ***/
+/****************************************************************************/
+
+/****************************************************************************/
+/***        Exported Functions                                            ***/
+/****************************************************************************/
+
+#ifndef _WIN32
+
+/****************************************************************************
+ *
+ * NAME: HISTORY_bOpen
+ *
+ * DESCRIPTION:
+ * Opens the history kept in a directory, creating it if need be. Each
+ * camera's segments are only opened once there's something to add.
+ *
+ * RETURNS:
+ * bool_t TRUE if successful, FALSE otherwise
+ *
+ ****************************************************************************/
+bool_t HISTORY_bOpen(HISTORY_tsInstance *psHistory, char *pcDirectory)
+{
+    memset(psHistory, 0, sizeof(HISTORY_tsInstance));
+
+    if(strlen(pcDirectory) >= HISTORY_MAX_PATH_LENGTH)
+    {
+        printf("Error: History directory name %s is too long in %s\n", pcDirectory, __FUNCTION__);
+        return FALSE;
+    }
+    strcpy(psHistory->acDirectory, pcDirectory);
+
+    if((mkdir(pcDirectory, 0755) != 0) && (errno != EEXIST))
+    {
+        printf("Error: Can't create history directory %s in %s\n", pcDirectory, __FUNCTION__);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: HISTORY_vClose
+ *
+ * DESCRIPTION:
+ * Unmaps the segments being appended to
+ *
+ * RETURNS:
+ * void
+ *
+ ****************************************************************************/
+void HISTORY_vClose(HISTORY_tsInstance *psHistory)
+{
+    uint32_t n;
+
+    for(n = 0; n < psHistory->u32NumCameras; n++)
+    {
+        HISTORY_vUnmap(&psHistory->apsCameras[n]->sSegment);
+        free(psHistory->apsCameras[n]);
+        psHistory->apsCameras[n] = NULL;
+    }
+    psHistory->u32NumCameras = 0;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: HISTORY_bAppend
+ *
+ * DESCRIPTION:
+ * Adds a value seen on a camera at u64TimeMs to its latest segment, unless
+ * it's the value last recorded there for the key. A new segment is started
+ * when the latest is full or too far back for the time to fit. Other
+ * processes may be appending to the same segment, so each record is added
+ * under a lock on the file, and the record count is only moved on once the
+ * record is complete for queries reading at the same time. The values
+ * remembered are only trusted without the lock while nothing has been added
+ * to the segment since; otherwise they're brought up to date from the new
+ * records under the lock before deciding.
+ *
+ * RETURNS:
+ * bool_t TRUE if the value was recorded or didn't need to be, FALSE otherwise
+ *
+ ****************************************************************************/
+bool_t HISTORY_bAppend(HISTORY_tsInstance *psHistory, ORLACO_tuIP uIP, uint16_t u16Key, uint32_t u32Value, uint64_t u64TimeMs)
+{
+    HISTORY_tsCamera *psCamera = HISTORY_psGetCamera(psHistory, uIP, u64TimeMs);
+    HISTORY_tsSegment *psSegment;
+    HISTORY_tsValue *psValue;
+    uint64_t u64OffsetMs;
+    uint32_t u32Record;
+
+    if(psCamera == NULL)
+    {
+        return FALSE;
+    }
+    psSegment = &psCamera->sSegment;
+
+    // Nothing else has recorded a change since, so the value remembered is still the last one
+    psValue = HISTORY_psGetValue(psCamera, u16Key);
+    if((psValue != NULL) && (psValue->u32Value == u32Value) &&
+       (__atomic_load_n(&psSegment->psHeader->u32NumRecords, __ATOMIC_ACQUIRE) == psCamera->u32NumRecordsSeen))
+    {
+        return TRUE;
+    }
+
+    flock(psSegment->iFd, LOCK_EX);
+    u32Record = __atomic_load_n(&psSegment->psHeader->u32NumRecords, __ATOMIC_RELAXED);
+    if((u32Record >= psSegment->psHeader->u32Capacity) || (u64TimeMs > psSegment->psHeader->u64BaseMs + HISTORY_MAX_OFFSET_MS))
+    {
+        flock(psSegment->iFd, LOCK_UN);
+        HISTORY_vUnmap(psSegment);
+        if(!HISTORY_bOpenLatest(psHistory, psCamera, u64TimeMs))
+        {
+            return FALSE;
+        }
+        flock(psSegment->iFd, LOCK_EX);
+        u32Record = __atomic_load_n(&psSegment->psHeader->u32NumRecords, __ATOMIC_RELAXED);
+        if(u32Record >= psSegment->psHeader->u32Capacity)
+        {
+            flock(psSegment->iFd, LOCK_UN);
+            return FALSE;
+        }
+    }
+
+    // Take in what other processes have recorded, as one may have changed the value back
+    HISTORY_vCatchUp(psCamera, u32Record);
+    psValue = HISTORY_psGetValue(psCamera, u16Key);
+    if((psValue != NULL) && (psValue->u32Value == u32Value))
+    {
+        flock(psSegment->iFd, LOCK_UN);
+        return TRUE;
+    }
+
+    // Keep the time column sorted if the clock steps back
+    u64OffsetMs = (u64TimeMs > psSegment->psHeader->u64BaseMs) ? u64TimeMs - psSegment->psHeader->u64BaseMs : 0;
+    if((u32Record > 0) && (u64OffsetMs < psSegment->pu32Times[u32Record - 1]))
+    {
+        u64OffsetMs = psSegment->pu32Times[u32Record - 1];
+    }
+
+    psSegment->pu32Times[u32Record] = (uint32_t)u64OffsetMs;
+    psSegment->pu16Keys[u32Record] = u16Key;
+    psSegment->pu32Values[u32Record] = u32Value;
+    __atomic_store_n(&psSegment->psHeader->u32NumRecords, u32Record + 1, __ATOMIC_RELEASE);
+    HISTORY_vCatchUp(psCamera, u32Record + 1);
+    flock(psSegment->iFd, LOCK_UN);
+
+    psHistory->u32Appended++;
+
+    return TRUE;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: HISTORY_vObserve
+ *
+ * DESCRIPTION:
+ * Records a value as of now, to be given to ORLACO_vSetObserver with the
+ * history as its context
+ *
+ * RETURNS:
+ * void
+ *
+ ****************************************************************************/
+void HISTORY_vObserve(void *pvContext, ORLACO_tuIP uIP, uint16_t u16Key, uint32_t u32Value)
+{
+    HISTORY_bAppend((HISTORY_tsInstance *)pvContext, uIP, u16Key, u32Value, HISTORY_u64GetTimeMs());
+}
+
+
+/****************************************************************************
+ *
+ * NAME: HISTORY_u32Query
+ *
+ * DESCRIPTION:
+ * Finds the changes to keys u16FirstKey to u16LastKey of a camera between
+ * two times, oldest first. Segments are skipped by the base time in their
+ * names, and the start of the range is found by binary searching the time
+ * column, so only the records within the range are looked at, other than
+ * a search back through the key column for the value each key had before.
+ * Values recorded again that hadn't changed, such as those repeated at the
+ * start of each segment, aren't reported.
+ *
+ * RETURNS:
+ * uint32_t Number of changes found
+ *
+ ****************************************************************************/
+uint32_t HISTORY_u32Query(HISTORY_tsInstance *psHistory, ORLACO_tuIP uIP, uint16_t u16FirstKey, uint16_t u16LastKey, uint64_t u64FromMs, uint64_t u64ToMs, HISTORY_tpfvChange pfvChange, void *pvContext)
+{
+    HISTORY_tsWas asWas[HISTORY_MAX_KEYS];
+    HISTORY_tsSegment sSegment;
+    HISTORY_tsChange sChange;
+    HISTORY_tsWas *psWas;
+    uint64_t *pu64Bases;
+    uint32_t u32NumSegments;
+    uint32_t u32NumWas = 0;
+    uint32_t u32NumRecords;
+    uint32_t u32Changes = 0;
+    uint32_t u32First, u32Last, u32Mid;
+    uint64_t u64FromOffsetMs;
+    uint32_t s, r, n;
+
+    pu64Bases = malloc(HISTORY_MAX_SEGMENTS * sizeof(uint64_t));
+    if(pu64Bases == NULL)
+    {
+        printf("Error: Memory allocation failed in %s\n", __FUNCTION__);
+        return 0;
+    }
+
+    u32NumSegments = HISTORY_u32ListSegments(psHistory, uIP, pu64Bases);
+
+    // Start from the last segment begun before the range
+    for(s = 0; (s + 1 < u32NumSegments) && (pu64Bases[s + 1] <= u64FromMs); s++);
+
+    for(; (s < u32NumSegments) && (pu64Bases[s] <= u64ToMs); s++)
+    {
+        if(!HISTORY_bMapSegment(psHistory, uIP, pu64Bases[s], FALSE, &sSegment))
+        {
+            continue;
+        }
+
+        u32NumRecords = __atomic_load_n(&sSegment.psHeader->u32NumRecords, __ATOMIC_ACQUIRE);
+        u64FromOffsetMs = (u64FromMs > pu64Bases[s]) ? u64FromMs - pu64Bases[s] : 0;
+
+        // First record at or after the start of the range
+        u32First = 0;
+        u32Last = u32NumRecords;
+        while(u32First < u32Last)
+        {
+            u32Mid = u32First + (u32Last - u32First) / 2;
+            if((uint64_t)sSegment.pu32Times[u32Mid] < u64FromOffsetMs)
+            {
+                u32First = u32Mid + 1;
+            }
+            else
+            {
+                u32Last = u32Mid;
+            }
+        }
+
+        for(r = u32First; r < u32NumRecords; r++)
+        {
+            sChange.u64TimeMs = pu64Bases[s] + sSegment.pu32Times[r];
+            if(sChange.u64TimeMs > u64ToMs)
+            {
+                break;
+            }
+
+            sChange.u16Key = sSegment.pu16Keys[r];
+            if((sChange.u16Key < u16FirstKey) || (sChange.u16Key > u16LastKey))
+            {
+                continue;
+            }
+            sChange.u32Value = sSegment.pu32Values[r];
+
+            psWas = NULL;
+            for(n = 0; n < u32NumWas; n++)
+            {
+                if(asWas[n].u16Key == sChange.u16Key)
+                {
+                    psWas = &asWas[n];
+                    break;
+                }
+            }
+
+            if(psWas != NULL)
+            {
+                sChange.bWasKnown = psWas->bKnown;
+                sChange.u32Was = psWas->u32Value;
+            }
+            else
+            {
+                sChange.bWasKnown = HISTORY_bFindWas(psHistory, uIP, pu64Bases, s, &sSegment, r, sChange.u16Key, &sChange.u32Was);
+                if(u32NumWas < HISTORY_MAX_KEYS)
+                {
+                    psWas = &asWas[u32NumWas++];
+                    psWas->u16Key = sChange.u16Key;
+                }
+            }
+
+            if(psWas != NULL)
+            {
+                psWas->bKnown = TRUE;
+                psWas->u32Value = sChange.u32Value;
+            }
+
+            if(sChange.bWasKnown && (sChange.u32Was == sChange.u32Value))
+            {
+                continue;
+            }
+
+            pfvChange(pvContext, uIP, &sChange);
+            u32Changes++;
+        }
+
+        HISTORY_vUnmap(&sSegment);
+    }
+
+    free(pu64Bases);
+
+    return u32Changes;
+}
+
+#else
+
+bool_t HISTORY_bOpen(HISTORY_tsInstance *psHistory, char *pcDirectory)
+{
+    printf("Error: The value history isn't supported on this platform\n");
+    return FALSE;
+}
+
+void HISTORY_vClose(HISTORY_tsInstance *psHistory)
+{
+}
+
+bool_t HISTORY_bAppend(HISTORY_tsInstance *psHistory, ORLACO_tuIP uIP, uint16_t u16Key, uint32_t u32Value, uint64_t u64TimeMs)
+{
+    return FALSE;
+}
+
+void HISTORY_vObserve(void *pvContext, ORLACO_tuIP uIP, uint16_t u16Key, uint32_t u32Value)
+{
+}
+
+uint32_t HISTORY_u32Query(HISTORY_tsInstance *psHistory, ORLACO_tuIP uIP, uint16_t u16FirstKey, uint16_t u16LastKey, uint64_t u64FromMs, uint64_t u64ToMs, HISTORY_tpfvChange pfvChange, void *pvContext)
+{
+    return 0;
+}
+
+#endif
+
+
+/****************************************************************************
+ *
+ * NAME: HISTORY_u64GetTimeMs
+ *
+ * DESCRIPTION:
+ * Gets the wall clock time, which the history is kept in so it can be
+ * searched across restarts
+ *
+ * RETURNS:
+ * uint64_t Milliseconds since 1970
+ *
+ ****************************************************************************/
+uint64_t HISTORY_u64GetTimeMs(void)
+{
+#ifdef _WIN32
+    FILETIME sFileTime;
+    uint64_t u64Ticks;
+
+    // 100ns ticks since 1601
+    GetSystemTimeAsFileTime(&sFileTime);
+    u64Ticks = ((uint64_t)sFileTime.dwHighDateTime << 32) | sFileTime.dwLowDateTime;
+    return (u64Ticks / 10000ULL) - 11644473600000ULL;
+#else
+    struct timespec sTime;
+
+    clock_gettime(CLOCK_REALTIME, &sTime);
+    return ((uint64_t)sTime.tv_sec * 1000ULL) + ((uint64_t)sTime.tv_nsec / 1000000ULL);
+#endif
+}
+
+/****************************************************************************/
+/***        Local Functions                                               ***/
+/****************************************************************************/
+
+#ifndef _WIN32
+
+/****************************************************************************
+ *
+ * NAME: HISTORY_psGetCamera
+ *
+ * DESCRIPTION:
+ * Finds a camera's state, setting it up and opening its latest segment, or
+ * one to take a value from u64TimeMs, the first time it's asked for, or
+ * whenever it's left without one by a failed rollover
+ *
+ * RETURNS:
+ * HISTORY_tsCamera* or NULL if there's no room or its segment can't be opened
+ *
+ ****************************************************************************/
+static HISTORY_tsCamera *HISTORY_psGetCamera(HISTORY_tsInstance *psHistory, ORLACO_tuIP uIP, uint64_t u64TimeMs)
+{
+    HISTORY_tsCamera *psCamera;
+    char acPath[HISTORY_MAX_FILE_PATH_LENGTH];
+    uint32_t n;
+
+    for(n = 0; n < psHistory->u32NumCameras; n++)
+    {
+        if(psHistory->apsCameras[n]->uIP.u32IP == uIP.u32IP)
+        {
+            psCamera = psHistory->apsCameras[n];
+
+            // Its last rollover couldn't open a new segment, so try again
+            if((psCamera->sSegment.psHeader == NULL) && !HISTORY_bOpenLatest(psHistory, psCamera, u64TimeMs))
+            {
+                return NULL;
+            }
+            return psCamera;
+        }
+    }
+
+    if(psHistory->u32NumCameras == HISTORY_MAX_CAMERAS)
+    {
+        return NULL;
+    }
+
+    snprintf(acPath, sizeof(acPath), "%s/%d.%d.%d.%d", psHistory->acDirectory, uIP.au8IP[3], uIP.au8IP[2], uIP.au8IP[1], uIP.au8IP[0]);
+    if((mkdir(acPath, 0755) != 0) && (errno != EEXIST))
+    {
+        printf("Error: Can't create history directory %s in %s\n", acPath, __FUNCTION__);
+        return NULL;
+    }
+
+    psCamera = calloc(1, sizeof(HISTORY_tsCamera));
+    if(psCamera == NULL)
+    {
+        printf("Error: Memory allocation failed in %s\n", __FUNCTION__);
+        return NULL;
+    }
+    psCamera->uIP = uIP;
+    psCamera->sSegment.iFd = -1;
+
+    if(!HISTORY_bOpenLatest(psHistory, psCamera, u64TimeMs))
+    {
+        free(psCamera);
+        return NULL;
+    }
+
+    psHistory->apsCameras[psHistory->u32NumCameras++] = psCamera;
+
+    return psCamera;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: HISTORY_bOpenLatest
+ *
+ * DESCRIPTION:
+ * Maps a camera's latest segment for appending, or starts a new one if it's
+ * full or u64TimeMs won't fit in it, and remembers the last value of each
+ * key recorded in it. A new segment starts with nothing remembered, so the
+ * values still current are recorded in it again as they're seen.
+ *
+ * RETURNS:
+ * bool_t TRUE if successful, FALSE otherwise
+ *
+ ****************************************************************************/
+static bool_t HISTORY_bOpenLatest(HISTORY_tsInstance *psHistory, HISTORY_tsCamera *psCamera, uint64_t u64TimeMs)
+{
+    HISTORY_tsSegment *psSegment = &psCamera->sSegment;
+    char acPath[HISTORY_MAX_FILE_PATH_LENGTH];
+    uint64_t *pu64Bases;
+    uint64_t u64BaseMs = u64TimeMs;
+    uint32_t u32NumSegments;
+    uint32_t u32NumRecords;
+
+    pu64Bases = malloc(HISTORY_MAX_SEGMENTS * sizeof(uint64_t));
+    if(pu64Bases == NULL)
+    {
+        printf("Error: Memory allocation failed in %s\n", __FUNCTION__);
+        return FALSE;
+    }
+
+    psCamera->u32NumValues = 0;
+    psCamera->u32NumRecordsSeen = 0;
+    u32NumSegments = HISTORY_u32ListSegments(psHistory, psCamera->uIP, pu64Bases);
+    if(u32NumSegments > 0)
+    {
+        if(HISTORY_bMapSegment(psHistory, psCamera->uIP, pu64Bases[u32NumSegments - 1], TRUE, psSegment))
+        {
+            u32NumRecords = __atomic_load_n(&psSegment->psHeader->u32NumRecords, __ATOMIC_ACQUIRE);
+            if((u32NumRecords < psSegment->psHeader->u32Capacity) && (u64TimeMs <= psSegment->psHeader->u64BaseMs + HISTORY_MAX_OFFSET_MS))
+            {
+                HISTORY_vCatchUp(psCamera, u32NumRecords);
+                free(pu64Bases);
+                return TRUE;
+            }
+            HISTORY_vUnmap(psSegment);
+        }
+
+        // Segments are ordered by the base time in their names
+        if(u64BaseMs <= pu64Bases[u32NumSegments - 1])
+        {
+            u64BaseMs = pu64Bases[u32NumSegments - 1] + 1;
+        }
+    }
+    free(pu64Bases);
+
+    snprintf(acPath, sizeof(acPath), "%s/%d.%d.%d.%d/%llu.seg", psHistory->acDirectory,
+             psCamera->uIP.au8IP[3], psCamera->uIP.au8IP[2], psCamera->uIP.au8IP[1], psCamera->uIP.au8IP[0], (unsigned long long)u64BaseMs);
+
+    return HISTORY_bMap(psSegment, acPath, TRUE, psCamera->uIP, u64BaseMs);
+}
+
+
+/****************************************************************************
+ *
+ * NAME: HISTORY_vCatchUp
+ *
+ * DESCRIPTION:
+ * Brings the values remembered for a camera up to date with the records of
+ * its segment up to u32NumRecords, whichever process added them
+ *
+ * RETURNS:
+ * void
+ *
+ ****************************************************************************/
+static void HISTORY_vCatchUp(HISTORY_tsCamera *psCamera, uint32_t u32NumRecords)
+{
+    HISTORY_tsSegment *psSegment = &psCamera->sSegment;
+    uint32_t r, n;
+
+    for(r = psCamera->u32NumRecordsSeen; r < u32NumRecords; r++)
+    {
+        for(n = 0; (n < psCamera->u32NumValues) && (psCamera->asValues[n].u16Key != psSegment->pu16Keys[r]); n++);
+        if(n == HISTORY_MAX_KEYS)
+        {
+            continue;
+        }
+        psCamera->asValues[n].u16Key = psSegment->pu16Keys[r];
+        psCamera->asValues[n].u32Value = psSegment->pu32Values[r];
+        if(n == psCamera->u32NumValues)
+        {
+            psCamera->u32NumValues++;
+        }
+    }
+    psCamera->u32NumRecordsSeen = u32NumRecords;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: HISTORY_psGetValue
+ *
+ * DESCRIPTION:
+ * Finds the value remembered for a key of a camera
+ *
+ * RETURNS:
+ * HISTORY_tsValue* or NULL if none is
+ *
+ ****************************************************************************/
+static HISTORY_tsValue *HISTORY_psGetValue(HISTORY_tsCamera *psCamera, uint16_t u16Key)
+{
+    uint32_t n;
+
+    for(n = 0; n < psCamera->u32NumValues; n++)
+    {
+        if(psCamera->asValues[n].u16Key == u16Key)
+        {
+            return &psCamera->asValues[n];
+        }
+    }
+
+    return NULL;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: HISTORY_bMap
+ *
+ * DESCRIPTION:
+ * Opens and maps a segment file, read write, creating it at its full size
+ * if need be, to append to, or read only at whatever size it is to query
+ *
+ * RETURNS:
+ * bool_t TRUE if successful, FALSE otherwise
+ *
+ ****************************************************************************/
+static bool_t HISTORY_bMap(HISTORY_tsSegment *psSegment, char *pcPath, bool_t bWrite, ORLACO_tuIP uIP, uint64_t u64BaseMs)
+{
+    uint64_t u64Length = sizeof(HISTORY_tsHeader) + ((uint64_t)HISTORY_SEGMENT_RECORDS * HISTORY_RECORD_LENGTH);
+    HISTORY_tsHeader *psHeader;
+    struct stat sStat;
+
+    memset(psSegment, 0, sizeof(HISTORY_tsSegment));
+    psSegment->iFd = open(pcPath, bWrite ? (O_RDWR | O_CREAT) : O_RDONLY, 0644);
+    if(psSegment->iFd < 0)
+    {
+        printf("Error: Can't open history segment %s in %s\n", pcPath, __FUNCTION__);
+        return FALSE;
+    }
+
+    flock(psSegment->iFd, bWrite ? LOCK_EX : LOCK_SH);
+    if(fstat(psSegment->iFd, &sStat) != 0)
+    {
+        sStat.st_size = 0;
+    }
+    if(bWrite && ((uint64_t)sStat.st_size < u64Length))
+    {
+        if(ftruncate(psSegment->iFd, (off_t)u64Length) != 0)
+        {
+            printf("Error: Can't size history segment %s in %s\n", pcPath, __FUNCTION__);
+            flock(psSegment->iFd, LOCK_UN);
+            HISTORY_vUnmap(psSegment);
+            return FALSE;
+        }
+        sStat.st_size = (off_t)u64Length;
+    }
+
+    psSegment->u64MapLength = (uint64_t)sStat.st_size;
+    if(psSegment->u64MapLength >= sizeof(HISTORY_tsHeader))
+    {
+        psSegment->pu8Map = mmap(NULL, (size_t)psSegment->u64MapLength, bWrite ? (PROT_READ | PROT_WRITE) : PROT_READ, MAP_SHARED, psSegment->iFd, 0);
+        if(psSegment->pu8Map == MAP_FAILED)
+        {
+            psSegment->pu8Map = NULL;
+        }
+    }
+    if(psSegment->pu8Map == NULL)
+    {
+        printf("Error: Can't map history segment %s in %s\n", pcPath, __FUNCTION__);
+        flock(psSegment->iFd, LOCK_UN);
+        HISTORY_vUnmap(psSegment);
+        return FALSE;
+    }
+
+    psHeader = (HISTORY_tsHeader *)psSegment->pu8Map;
+    if(bWrite && (psHeader->u32Magic == 0))
+    {
+        psHeader->u32Version = HISTORY_VERSION;
+        psHeader->u32IP = uIP.u32IP;
+        psHeader->u32Capacity = HISTORY_SEGMENT_RECORDS;
+        psHeader->u64BaseMs = u64BaseMs;
+        psHeader->u32NumRecords = 0;
+        __atomic_store_n(&psHeader->u32Magic, HISTORY_MAGIC, __ATOMIC_RELEASE);
+    }
+    flock(psSegment->iFd, LOCK_UN);
+
+    if((__atomic_load_n(&psHeader->u32Magic, __ATOMIC_ACQUIRE) != HISTORY_MAGIC) || (psHeader->u32Version != HISTORY_VERSION) ||
+       (psSegment->u64MapLength < sizeof(HISTORY_tsHeader) + ((uint64_t)psHeader->u32Capacity * HISTORY_RECORD_LENGTH)))
+    {
+        printf("Error: %s isn't a history segment in %s\n", pcPath, __FUNCTION__);
+        HISTORY_vUnmap(psSegment);
+        return FALSE;
+    }
+
+    psSegment->psHeader = psHeader;
+    psSegment->pu32Times = (uint32_t *)(psSegment->pu8Map + sizeof(HISTORY_tsHeader));
+    psSegment->pu16Keys = (uint16_t *)(psSegment->pu32Times + psHeader->u32Capacity);
+    psSegment->pu32Values = (uint32_t *)(psSegment->pu16Keys + psHeader->u32Capacity);
+
+    return TRUE;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: HISTORY_vUnmap
+ *
+ * DESCRIPTION:
+ * Unmaps and closes a segment
+ *
+ * RETURNS:
+ * void
+ *
+ ****************************************************************************/
+static void HISTORY_vUnmap(HISTORY_tsSegment *psSegment)
+{
+    if(psSegment->pu8Map != NULL)
+    {
+        munmap(psSegment->pu8Map, (size_t)psSegment->u64MapLength);
+    }
+
+    if(psSegment->iFd >= 0)
+    {
+        close(psSegment->iFd);
+    }
+
+    memset(psSegment, 0, sizeof(HISTORY_tsSegment));
+    psSegment->iFd = -1;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: HISTORY_u32ListSegments
+ *
+ * DESCRIPTION:
+ * Gets the base times of a camera's segments from their file names
+ *
+ * RETURNS:
+ * uint32_t Number of segments, their base times are in pu64Bases, oldest first
+ *
+ ****************************************************************************/
+static uint32_t HISTORY_u32ListSegments(HISTORY_tsInstance *psHistory, ORLACO_tuIP uIP, uint64_t *pu64Bases)
+{
+    char acPath[HISTORY_MAX_FILE_PATH_LENGTH];
+    struct dirent *psEntry;
+    unsigned long long ullBaseMs;
+    uint32_t u32NumSegments = 0;
+    char acSuffix[8];
+    DIR *psDir;
+
+    snprintf(acPath, sizeof(acPath), "%s/%d.%d.%d.%d", psHistory->acDirectory, uIP.au8IP[3], uIP.au8IP[2], uIP.au8IP[1], uIP.au8IP[0]);
+    psDir = opendir(acPath);
+    if(psDir == NULL)
+    {
+        return 0;
+    }
+
+    while(((psEntry = readdir(psDir)) != NULL) && (u32NumSegments < HISTORY_MAX_SEGMENTS))
+    {
+        if((sscanf(psEntry->d_name, "%llu.%7s", &ullBaseMs, acSuffix) == 2) && (strcmp(acSuffix, "seg") == 0))
+        {
+            pu64Bases[u32NumSegments++] = (uint64_t)ullBaseMs;
+        }
+    }
+    closedir(psDir);
+
+    qsort(pu64Bases, u32NumSegments, sizeof(uint64_t), HISTORY_iCompare);
+
+    return u32NumSegments;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: HISTORY_bMapSegment
+ *
+ * DESCRIPTION:
+ * Maps one of a camera's segments by its base time, read write to append to
+ * or read only to query
+ *
+ * RETURNS:
+ * bool_t TRUE if successful, FALSE otherwise
+ *
+ ****************************************************************************/
+static bool_t HISTORY_bMapSegment(HISTORY_tsInstance *psHistory, ORLACO_tuIP uIP, uint64_t u64BaseMs, bool_t bWrite, HISTORY_tsSegment *psSegment)
+{
+    char acPath[HISTORY_MAX_FILE_PATH_LENGTH];
+
+    snprintf(acPath, sizeof(acPath), "%s/%d.%d.%d.%d/%llu.seg", psHistory->acDirectory,
+             uIP.au8IP[3], uIP.au8IP[2], uIP.au8IP[1], uIP.au8IP[0], (unsigned long long)u64BaseMs);
+
+    return HISTORY_bMap(psSegment, acPath, bWrite, uIP, u64BaseMs);
+}
+
+
+/****************************************************************************
+ *
+ * NAME: HISTORY_bFindWas
+ *
+ * DESCRIPTION:
+ * Finds the value a key had before a record, searching back through the key
+ * column of its segment and then those of the segments before
+ *
+ * RETURNS:
+ * bool_t TRUE if found, the value is in *pu32Was, FALSE otherwise
+ *
+ ****************************************************************************/
+static bool_t HISTORY_bFindWas(HISTORY_tsInstance *psHistory, ORLACO_tuIP uIP, uint64_t *pu64Bases, uint32_t u32Segment, HISTORY_tsSegment *psSegment, uint32_t u32Record, uint16_t u16Key, uint32_t *pu32Was)
+{
+    HISTORY_tsSegment sEarlier;
+    uint32_t r;
+
+    for(r = u32Record; r > 0; r--)
+    {
+        if(psSegment->pu16Keys[r - 1] == u16Key)
+        {
+            *pu32Was = psSegment->pu32Values[r - 1];
+            return TRUE;
+        }
+    }
+
+    for(; u32Segment > 0; u32Segment--)
+    {
+        if(!HISTORY_bMapSegment(psHistory, uIP, pu64Bases[u32Segment - 1], FALSE, &sEarlier))
+        {
+            continue;
+        }
+
+        for(r = __atomic_load_n(&sEarlier.psHeader->u32NumRecords, __ATOMIC_ACQUIRE); r > 0; r--)
+        {
+            if(sEarlier.pu16Keys[r - 1] == u16Key)
+            {
+                *pu32Was = sEarlier.pu32Values[r - 1];
+                HISTORY_vUnmap(&sEarlier);
+                return TRUE;
+            }
+        }
+        HISTORY_vUnmap(&sEarlier);
+    }
+
+    return FALSE;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: HISTORY_iCompare
+ *
+ * DESCRIPTION:
+ * Orders segment base times for qsort
+ *
+ * RETURNS:
+ * int less than, equal to or greater than zero
+ *
+ ****************************************************************************/
+static int HISTORY_iCompare(const void *pvA, const void *pvB)
+{
+    uint64_t u64A = *(const uint64_t *)pvA;
+    uint64_t u64B = *(const uint64_t *)pvB;
+
+    return (u64A > u64B) - (u64A < u64B);
+}
+
+#endif
+
+/****************************************************************************/
+/***        END OF FILE                                                   ***/
+/****************************************************************************/
@@ -0,0 +1,103 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+/****************************************************************************/
+/***        Include files                                                 ***/
+/****************************************************************************/
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "common.h"
+#include "orlaco.h"
+
+/****************************************************************************/
+/***        Macro Definitions                                             ***/
+/****************************************************************************/
+
+#define HISTORY_MAGIC                   0x484f4343          // "OCCH"
+#define HISTORY_VERSION                 1
+#define HISTORY_SEGMENT_RECORDS         65536               // Changes each segment file has room for
+#define HISTORY_MAX_CAMERAS             64
+#define HISTORY_MAX_KEYS                512                 // Values remembered per camera to tell changes from repeats
+#define HISTORY_MAX_SEGMENTS            4096                // Per camera, that a query looks through
+#define HISTORY_MAX_PATH_LENGTH         256
+
+/****************************************************************************/
+/***        Type Definitions                                              ***/
+/****************************************************************************/
+
+// Segment file layout: this header, then the time, key and value columns,
+// each u32Capacity long. The times are milliseconds from u64BaseMs rather
+// than from the record before, so the column stays sorted where it's mapped
+// and a query can binary search it without decoding anything.
+typedef struct {
+    uint32_t u32Magic;
+    uint32_t u32Version;
+    uint32_t u32IP;                                 // In ORLACO_tuIP order
+    uint32_t u32Capacity;
+    uint64_t u64BaseMs;                             // Unix time in ms, also the file name
+    uint32_t u32NumRecords;                         // Only moved on once the record's columns are written
+    uint8_t au8Pad[36];
+} HISTORY_tsHeader;
+
+typedef struct {
+    int iFd;
+    uint8_t *pu8Map;
+    uint64_t u64MapLength;
+    HISTORY_tsHeader *psHeader;
+    uint32_t *pu32Times;
+    uint16_t *pu16Keys;                             // Register address or ORLACO_ROI_KEY
+    uint32_t *pu32Values;
+} HISTORY_tsSegment;
+
+typedef struct {
+    uint16_t u16Key;
+    uint32_t u32Value;
+} HISTORY_tsValue;
+
+typedef struct {
+    ORLACO_tuIP uIP;
+    HISTORY_tsSegment sSegment;                     // Being appended to
+    HISTORY_tsValue asValues[HISTORY_MAX_KEYS];     // Last recorded in it, by any process
+    uint32_t u32NumValues;
+    uint32_t u32NumRecordsSeen;                     // Records of the segment that asValues is up to date with
+} HISTORY_tsCamera;
+
+// Keeps every value change seen on each camera in its own directory of
+// memory mapped segment files, <directory>/<camera ip>/<base ms>.seg, so
+// it can be searched by time later on without a database
+typedef struct {
+    char acDirectory[HISTORY_MAX_PATH_LENGTH];
+    HISTORY_tsCamera *apsCameras[HISTORY_MAX_CAMERAS];
+    uint32_t u32NumCameras;
+    uint32_t u32Appended;
+} HISTORY_tsInstance;
+
+// A change found by a query, bWasKnown is FALSE when the value before it wasn't recorded
+typedef struct {
+    uint64_t u64TimeMs;
+    uint16_t u16Key;
+    uint32_t u32Value;
+    bool_t bWasKnown;
+    uint32_t u32Was;
+} HISTORY_tsChange;
+
+typedef void (*HISTORY_tpfvChange)(void *pvContext, ORLACO_tuIP uIP, HISTORY_tsChange *psChange);
+
+/****************************************************************************/
+/***        Exported Functions                                            ***/
+/****************************************************************************/
+
+bool_t HISTORY_bOpen(HISTORY_tsInstance *psHistory, char *pcDirectory);
+void HISTORY_vClose(HISTORY_tsInstance *psHistory);
+bool_t HISTORY_bAppend(HISTORY_tsInstance *psHistory, ORLACO_tuIP uIP, uint16_t u16Key, uint32_t u32Value, uint64_t u64TimeMs);
+void HISTORY_vObserve(void *pvContext, ORLACO_tuIP uIP, uint16_t u16Key, uint32_t u32Value);
+uint32_t HISTORY_u32Query(HISTORY_tsInstance *psHistory, ORLACO_tuIP uIP, uint16_t u16FirstKey, uint16_t u16LastKey, uint64_t u64FromMs, uint64_t u64ToMs, HISTORY_tpfvChange pfvChange, void *pvContext);
+uint64_t HISTORY_u64GetTimeMs(void);
+
+#endif // HISTORY_H
+
+/****************************************************************************/
+/***        END OF FILE                                                   ***/
+/****************************************************************************/
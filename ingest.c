@@ -0,0 +1,2646 @@
+/****************************************************************************
+ *
+ * Copyright 2021 Lee Mitchell <lee@indigopepper.com>
+ * This file is part of OCC (Orlaco Camera Configurator)
+ *
+ * OCC (Orlaco Camera Configurator) is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * OCC (Orlaco Camera Configurator) is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with OCC (Orlaco Camera Configurator).  If not,
+ * see <http://www.gnu.org/licenses/>.
+ *
+ ****************************************************************************/
+
+// Needed for recvmmsg() and pthread_setaffinity_np()
+#ifdef __linux__
+#define _GNU_SOURCE
+#endif
+
+/****************************************************************************/
+/***        Include files                                                 ***/
+/****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "common.h"
+#include "ingest.h"
+
+#ifndef _WIN32
+#include <poll.h>
+#include <sched.h>
+#include <errno.h>
+#include <unistd.h>
+#endif
+
+/****************************************************************************/
+/***        Macro Definitions                                             ***/
+/****************************************************************************/
+
+#if defined(__linux__) && (INGEST_MAX_CPUS > CPU_SETSIZE)
+#error INGEST_MAX_CPUS must fit in a cpu_set_t
+#endif
+
+/****************************************************************************/
+/***        Type Definitions                                              ***/
+/****************************************************************************/
+
+/****************************************************************************/
+/***        Local Function Prototypes                                     ***/
+/****************************************************************************/
+
+static bool_t INGEST_bCreateWorkers(INGEST_tsInstance *psInstance);
+static bool_t INGEST_bCreateRingWorkers(INGEST_tsInstance *psInstance);
+static void INGEST_vDestroyWorkers(INGEST_tsInstance *psInstance);
+static bool_t INGEST_bCreatePreEventRings(INGEST_tsInstance *psInstance);
+static void INGEST_vDestroyPreEventRings(INGEST_tsInstance *psInstance);
+static bool_t INGEST_bOpenSocket(INGEST_tsWorker *psWorker, uint16_t u16Port, bool_t bReusePort);
+static bool_t INGEST_bOpenPlaceholderSocket(INGEST_tsWorker *psWorker, uint16_t u16Port);
+static void INGEST_vCloseSocket(UDPSOCKET Socket);
+static bool_t INGEST_bOpenRtcpSocket(INGEST_tsInstance *psInstance);
+static void *INGEST_pvWorkerThread(void *pvWorker);
+static void INGEST_vReceive(INGEST_tsWorker *psWorker, UDPSOCKET Socket);
+static INGEST_tsStream *INGEST_psGetStream(INGEST_tsWorker *psWorker, ORLACO_tuIP uSrcIP, RTP_tsPacket *psPacket);
+static void INGEST_vOpenFrameRing(INGEST_tsWorker *psWorker, INGEST_tsStream *psStream);
+static void INGEST_vOpenPreEventRing(INGEST_tsWorker *psWorker, INGEST_tsStream *psStream);
+static void INGEST_vFreeStream(INGEST_tsInstance *psInstance, INGEST_tsStream *psStream);
+static void INGEST_vDispatchFrame(INGEST_tsWorker *psWorker, INGEST_tsStream *psStream, RTP_tsFrame *psFrame);
+static void INGEST_vProcessRtcp(INGEST_tsWorker *psWorker, ORLACO_tuIP uSrcIP, uint16_t u16SrcPort, uint8_t *pu8Data, uint32_t u32Length, uint64_t u64TimeUs);
+static INGEST_tsSender *INGEST_psGetSender(INGEST_tsInstance *psInstance, ORLACO_tuIP uIP, uint32_t u32Ssrc, uint64_t u64TimeUs);
+static void INGEST_vRefreshSender(INGEST_tsWorker *psWorker, INGEST_tsStream *psStream);
+static void INGEST_vServiceRtcp(INGEST_tsWorker *psWorker);
+static void INGEST_vServiceRateControl(INGEST_tsWorker *psWorker);
+static bool_t INGEST_bGetCaptureTimeUs(INGEST_tsWorker *psWorker, INGEST_tsStream *psStream, uint32_t u32Timestamp, uint64_t *pu64TimeUs);
+static bool_t INGEST_bFinished(INGEST_tsInstance *psInstance);
+static ORLACO_tuIP INGEST_uGetSenderIP(struct sockaddr_in *psAddr);
+static void INGEST_vReportStats(INGEST_tsWorker *psWorker);
+#ifndef _WIN32
+static void *INGEST_pvDumpThread(void *pvInstance);
+#endif
+static bool_t INGEST_bServicePreEvent(INGEST_tsInstance *psInstance);
+static bool_t INGEST_bCheckTriggers(INGEST_tsInstance *psInstance);
+static void INGEST_vRingPacket(void *pvWorker, ORLACO_tuIP uSrcIP, uint16_t u16SrcPort, uint8_t *pu8Data, uint32_t u32Length, uint64_t u64TimeUs);
+static bool_t INGEST_bStartWriter(INGEST_tsInstance *psInstance);
+static void INGEST_vStopWriter(INGEST_tsInstance *psInstance);
+static bool_t INGEST_bQueueWrite(INGEST_tsInstance *psInstance, INGEST_teWrite eWrite, MP4_tsRecorder *psRecorder, RTP_tsFrame *psFrame, uint32_t u32FrameNumber);
+static void INGEST_vWrite(INGEST_tsInstance *psInstance, INGEST_tsWrite *psWrite);
+#ifndef _WIN32
+static void *INGEST_pvWriterThread(void *pvInstance);
+#endif
+
+/****************************************************************************/
+/***        Exported Variables                                            ***/
+/****************************************************************************/
+
+/****************************************************************************/
+/***        Local Variables                                               ***/
+/****************************************************************************/
+
+/****************************************************************************/
+/***        Exported Functions                                            ***/
+/****************************************************************************/
+
+/****************************************************************************
+ *
+ * NAME: INGEST_bRun
+ *
+ * DESCRIPTION:
+ * Receives RTP streams on the configured ports and reassembles them into
+ * frames until an exit is requested or the frame limit is reached.
+ *
+ * Streams are sharded across the worker threads. With more ports than
+ * workers each worker owns a subset of the ports (one port per camera).
+ * Otherwise every worker binds every port with SO_REUSEPORT and the kernel
+ * hashes each camera's flow onto one of the workers' sockets. Either way a
+ * stream is only ever handled by one worker, so its depacketizer state and
+ * buffers are never shared.
+ *
+ * RETURNS:
+ * bool_t TRUE if successful, FALSE otherwise
+ *
+ ****************************************************************************/
+bool_t INGEST_bRun(INGEST_tsConfig *psConfig)
+{
+    INGEST_tsInstance sInstance;
+    INGEST_tsWorker *psWorker;
+    uint64_t u64ElapsedUs;
+    uint32_t n;
+    int s;
+
+    if(psConfig->u32NumPorts == 0)
+    {
+        printf("Error: No RTP ports configured in %s\n", __FUNCTION__);
+        return FALSE;
+    }
+
+    if(((psConfig->pcTriggerFile != NULL) || (psConfig->pcTriggerSocket != NULL)) && (psConfig->pcPreEventPrefix == NULL))
+    {
+        printf("Error: A dump trigger needs a pre-event prefix in %s\n", __FUNCTION__);
+        return FALSE;
+    }
+
+    if((psConfig->pcPreEventPrefix != NULL) && (psConfig->u32NumCameraIPs == 0))
+    {
+        printf("Error: Pre-event recording needs the cameras to be listed in %s\n", __FUNCTION__);
+        return FALSE;
+    }
+
+    if(psConfig->bAlign && !psConfig->bRtcp)
+    {
+        printf("Error: Aligning frames needs RTCP in %s\n", __FUNCTION__);
+        return FALSE;
+    }
+
+    memset(&sInstance, 0, sizeof(sInstance));
+    sInstance.psConfig = psConfig;
+
+    if(psConfig->bAlign)
+    {
+        if(!ALIGN_bInit(&sInstance.sAlign, psConfig->auCameraIPs, psConfig->u32NumCameraIPs, psConfig->u32AlignToleranceUs, psConfig->pcAlignPrefix))
+        {
+            return FALSE;
+        }
+        sInstance.bAlign = TRUE;
+    }
+
+    if(psConfig->pcPreEventPrefix != NULL)
+    {
+        if(!PRERING_bOpenTrigger(&sInstance.sTrigger, psConfig->pcTriggerFile, psConfig->pcTriggerSocket))
+        {
+            ALIGN_vDeInit(&sInstance.sAlign);
+            return FALSE;
+        }
+        if(psConfig->pu32Trigger != NULL)
+        {
+            sInstance.u32AppTriggersSeen = *psConfig->pu32Trigger;
+        }
+        if(!INGEST_bCreatePreEventRings(&sInstance))
+        {
+            INGEST_vDestroyPreEventRings(&sInstance);
+            PRERING_vCloseTrigger(&sInstance.sTrigger);
+            ALIGN_vDeInit(&sInstance.sAlign);
+            return FALSE;
+        }
+    }
+
+    if(psConfig->bRtcp)
+    {
+        if(!INGEST_bOpenRtcpSocket(&sInstance))
+        {
+            INGEST_vDestroyPreEventRings(&sInstance);
+            PRERING_vCloseTrigger(&sInstance.sTrigger);
+            ALIGN_vDeInit(&sInstance.sAlign);
+            return FALSE;
+        }
+    }
+
+    if(((psConfig->pcMp4Prefix != NULL) || (psConfig->pcJpegPrefix != NULL)) && !INGEST_bStartWriter(&sInstance))
+    {
+        if(psConfig->bRtcp && psConfig->bPacketRing) INGEST_vCloseSocket(sInstance.RtcpSocket);
+        INGEST_vDestroyPreEventRings(&sInstance);
+        PRERING_vCloseTrigger(&sInstance.sTrigger);
+        ALIGN_vDeInit(&sInstance.sAlign);
+        return FALSE;
+    }
+
+    if(!INGEST_bCreateWorkers(&sInstance))
+    {
+        INGEST_vDestroyWorkers(&sInstance);
+        INGEST_vStopWriter(&sInstance);
+        if(psConfig->bRtcp && psConfig->bPacketRing) INGEST_vCloseSocket(sInstance.RtcpSocket);
+        INGEST_vDestroyPreEventRings(&sInstance);
+        PRERING_vCloseTrigger(&sInstance.sTrigger);
+        ALIGN_vDeInit(&sInstance.sAlign);
+        return FALSE;
+    }
+
+#ifndef _WIN32
+    // Dumps are written on their own thread so that the workers only ever copy frames into the rings
+    if((psConfig->pcPreEventPrefix != NULL) && (pthread_create(&sInstance.sDumpThread, NULL, INGEST_pvDumpThread, &sInstance) != 0))
+    {
+        printf("Error: Failed to start the pre-event dump thread in %s\n", __FUNCTION__);
+        INGEST_vDestroyWorkers(&sInstance);
+        INGEST_vStopWriter(&sInstance);
+        if(psConfig->bRtcp && psConfig->bPacketRing) INGEST_vCloseSocket(sInstance.RtcpSocket);
+        INGEST_vDestroyPreEventRings(&sInstance);
+        PRERING_vCloseTrigger(&sInstance.sTrigger);
+        ALIGN_vDeInit(&sInstance.sAlign);
+        return FALSE;
+    }
+#endif
+
+#ifndef _WIN32
+    pthread_mutex_init(&sInstance.sSenderLock, NULL);
+#endif
+
+    if(psConfig->eVerbosity >= E_ORLACO_VERBOSITY_INFO)
+    {
+        printf("Receiving RTP on port");
+        for(n = 0; n < psConfig->u32NumPorts; n++)
+        {
+            printf("%s %d", (n == 0) ? "" : ",", psConfig->au16Ports[n]);
+        }
+        printf(" with %u worker%s%s\n", sInstance.u32NumWorkers, (sInstance.u32NumWorkers == 1) ? "" : "s", psConfig->bPacketRing ? " from a packet ring" : "");
+    }
+
+    if((psConfig->u32StatsIntervalMs != 0) && (psConfig->eStatsFormat == E_INGEST_STATS_FORMAT_TABLE))
+    {
+        printf("%-8s %-15s %-8s %-6s %7s %5s %6s %3s %6s %6s %6s %5s %7s %7s %7s %7s %7s\n",
+               "Time", "Camera", "SSRC", "Codec", "Mbps", "Max", "Fps", "Cfg", "Expect", "Lost", "Reord", "TotLo", "Jitter", "Spread", "SprdMax", "Delay", "RTT");
+    }
+
+    sInstance.u64StartTimeUs = RTP_u64GetTimeUs();
+    for(n = 0; n < sInstance.u32NumWorkers; n++)
+    {
+        sInstance.apsWorkers[n]->u64NextReportUs = sInstance.u64StartTimeUs + ((uint64_t)psConfig->u32StatsIntervalMs * 1000ULL);
+    }
+
+#ifdef _WIN32
+    // No thread support here, so the single worker runs on the calling thread
+    INGEST_pvWorkerThread(sInstance.apsWorkers[0]);
+#else
+    for(n = 0; n < sInstance.u32NumWorkers; n++)
+    {
+        if(pthread_create(&sInstance.apsWorkers[n]->sThread, NULL, INGEST_pvWorkerThread, sInstance.apsWorkers[n]) != 0)
+        {
+            printf("Error: Failed to start worker %u in %s\n", n, __FUNCTION__);
+            sInstance.u32NumWorkers = n;
+            break;
+        }
+    }
+    for(n = 0; n < sInstance.u32NumWorkers; n++)
+    {
+        pthread_join(sInstance.apsWorkers[n]->sThread, NULL);
+    }
+
+    // Dumps in progress are completed before the thread exits
+    if(psConfig->pcPreEventPrefix != NULL)
+    {
+        sInstance.bStopDump = TRUE;
+        pthread_join(sInstance.sDumpThread, NULL);
+    }
+#endif
+
+    // The frames still queued are written before the recorders are closed
+    INGEST_vStopWriter(&sInstance);
+
+    u64ElapsedUs = RTP_u64GetTimeUs() - sInstance.u64StartTimeUs;
+    if(u64ElapsedUs == 0)
+    {
+        u64ElapsedUs = 1;
+    }
+
+    if(psConfig->eVerbosity >= E_ORLACO_VERBOSITY_INFO)
+    {
+        for(n = 0; n < sInstance.u32NumWorkers; n++)
+        {
+            psWorker = sInstance.apsWorkers[n];
+            printf("Worker %u CPU=%d Packets=%llu Bytes=%llu Frames=%llu Rate=%.1fMb/s\n",
+                   n,
+                   psWorker->iCpu,
+                   (unsigned long long)psWorker->u64Packets,
+                   (unsigned long long)psWorker->u64Bytes,
+                   (unsigned long long)psWorker->u64Frames,
+                   (double)psWorker->u64Bytes * 8.0 / (double)u64ElapsedUs);
+            if(psWorker->bRing)
+            {
+                printf("  Ring drops=%llu\n", (unsigned long long)psWorker->sRing.u64Drops);
+            }
+
+            for(s = 0; s < INGEST_MAX_STREAMS; s++)
+            {
+                if(psWorker->asStreams[s].bInUse)
+                {
+                    printf("  Stream %d.%d.%d.%d SSRC=%08x Codec=%s Frames=%u\n",
+                           psWorker->asStreams[s].uSrcIP.au8IP[3],
+                           psWorker->asStreams[s].uSrcIP.au8IP[2],
+                           psWorker->asStreams[s].uSrcIP.au8IP[1],
+                           psWorker->asStreams[s].uSrcIP.au8IP[0],
+                           psWorker->asStreams[s].u32Ssrc,
+                           RTP_pcGetCodecAsString(psWorker->asStreams[s].eCodec),
+                           psWorker->asStreams[s].u32FrameNumber);
+                    if(psWorker->asStreams[s].psRecorder != NULL)
+                    {
+                        printf("    Recorded %u segment%s, %u frames skipped\n",
+                               psWorker->asStreams[s].psRecorder->u32Segments,
+                               (psWorker->asStreams[s].psRecorder->u32Segments == 1) ? "" : "s",
+                               psWorker->asStreams[s].psRecorder->u32FramesSkipped);
+                    }
+                }
+            }
+        }
+
+        if(sInstance.u64WritesDropped != 0)
+        {
+            printf("%llu frames not written as the disk fell behind\n", (unsigned long long)sInstance.u64WritesDropped);
+        }
+
+        for(n = 0; n < sInstance.u32NumPreEvents; n++)
+        {
+            printf("Pre-event %d.%d.%d.%d frames evicted=%llu dropped=%llu\n",
+                   psConfig->auCameraIPs[n].au8IP[3],
+                   psConfig->auCameraIPs[n].au8IP[2],
+                   psConfig->auCameraIPs[n].au8IP[1],
+                   psConfig->auCameraIPs[n].au8IP[0],
+                   (unsigned long long)sInstance.pasPreEvents[n].u64Evicted,
+                   (unsigned long long)sInstance.pasPreEvents[n].u64Dropped);
+        }
+    }
+
+    if(sInstance.bAlign && (psConfig->eVerbosity >= E_ORLACO_VERBOSITY_INFO))
+    {
+        printf("Aligned %u sets", sInstance.sAlign.u32Sets);
+        if(sInstance.sAlign.u32Sets != 0)
+        {
+            printf(", skew avg=%.3fms max=%.3fms",
+                   (double)sInstance.sAlign.u64SkewSumUs / (double)sInstance.sAlign.u32Sets / 1000.0,
+                   (double)sInstance.sAlign.u64SkewMaxUs / 1000.0);
+        }
+        printf(", %llu frames before a sender report", (unsigned long long)sInstance.sAlign.u64Unsynced);
+        if(sInstance.sAlign.u64SetsDropped != 0)
+        {
+            printf(", %llu sets not output as it fell behind", (unsigned long long)sInstance.sAlign.u64SetsDropped);
+        }
+        printf("\n");
+        for(n = 0; n < sInstance.sAlign.u32NumCameras; n++)
+        {
+            printf("  Camera %d.%d.%d.%d Frames=%llu Unmatched=%llu\n",
+                   sInstance.sAlign.asCameras[n].uIP.au8IP[3],
+                   sInstance.sAlign.asCameras[n].uIP.au8IP[2],
+                   sInstance.sAlign.asCameras[n].uIP.au8IP[1],
+                   sInstance.sAlign.asCameras[n].uIP.au8IP[0],
+                   (unsigned long long)sInstance.sAlign.asCameras[n].u64Frames,
+                   (unsigned long long)sInstance.sAlign.asCameras[n].u64Dropped);
+        }
+    }
+
+    INGEST_vDestroyWorkers(&sInstance);
+    if(psConfig->bRtcp && psConfig->bPacketRing) INGEST_vCloseSocket(sInstance.RtcpSocket);
+    INGEST_vDestroyPreEventRings(&sInstance);
+    PRERING_vCloseTrigger(&sInstance.sTrigger);
+    ALIGN_vDeInit(&sInstance.sAlign);
+#ifndef _WIN32
+    pthread_mutex_destroy(&sInstance.sSenderLock);
+#endif
+
+    return TRUE;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: INGEST_bAddPort
+ *
+ * DESCRIPTION:
+ * Adds a local UDP port to receive RTP streams on, ignoring duplicates
+ *
+ * RETURNS:
+ * bool_t TRUE if successful, FALSE if there is no room for more ports
+ *
+ ****************************************************************************/
+bool_t INGEST_bAddPort(INGEST_tsConfig *psConfig, uint16_t u16Port)
+{
+    uint32_t n;
+
+    for(n = 0; n < psConfig->u32NumPorts; n++)
+    {
+        if(psConfig->au16Ports[n] == u16Port)
+        {
+            return TRUE;
+        }
+    }
+
+    if(psConfig->u32NumPorts >= INGEST_MAX_PORTS)
+    {
+        return FALSE;
+    }
+
+    psConfig->au16Ports[psConfig->u32NumPorts++] = u16Port;
+
+    return TRUE;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: INGEST_bAddCameraIP
+ *
+ * DESCRIPTION:
+ * Restricts capture to streams from the given camera, can be called
+ * repeatedly to accept several cameras
+ *
+ * RETURNS:
+ * bool_t TRUE if successful, FALSE if the address is invalid or there is no room
+ *
+ ****************************************************************************/
+bool_t INGEST_bAddCameraIP(INGEST_tsConfig *psConfig, char *pcIpAddress)
+{
+    struct sockaddr_in sAddr;
+
+    if(psConfig->u32NumCameraIPs >= INGEST_MAX_CAMERA_IPS)
+    {
+        return FALSE;
+    }
+
+    sAddr.sin_addr.s_addr = inet_addr(pcIpAddress);
+    if(sAddr.sin_addr.s_addr == INADDR_NONE)
+    {
+        return FALSE;
+    }
+
+    psConfig->auCameraIPs[psConfig->u32NumCameraIPs++] = INGEST_uGetSenderIP(&sAddr);
+
+    return TRUE;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: INGEST_bAddGroup
+ *
+ * DESCRIPTION:
+ * Adds a multicast group that every receive socket joins, so streams sent
+ * to it reach this host
+ *
+ * RETURNS:
+ * bool_t TRUE if successful, FALSE if the address isn't a group or there is no room
+ *
+ ****************************************************************************/
+bool_t INGEST_bAddGroup(INGEST_tsConfig *psConfig, char *pcGroup)
+{
+    struct sockaddr_in sAddr;
+    ORLACO_tuIP uGroup;
+
+    if(psConfig->u32NumGroups >= INGEST_MAX_GROUPS)
+    {
+        return FALSE;
+    }
+
+    sAddr.sin_addr.s_addr = inet_addr(pcGroup);
+    uGroup = INGEST_uGetSenderIP(&sAddr);
+    if((sAddr.sin_addr.s_addr == INADDR_NONE) || !ORLACO_bIsMulticast(uGroup))
+    {
+        return FALSE;
+    }
+
+    psConfig->auGroups[psConfig->u32NumGroups++] = uGroup;
+
+    return TRUE;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: INGEST_bSetCameraLimits
+ *
+ * DESCRIPTION:
+ * Records the bitrate and frame rate a camera's selected ROI is configured
+ * for, so the statistics can show whether the camera honours them
+ *
+ * RETURNS:
+ * bool_t TRUE if successful, FALSE if the address is invalid or there is no room
+ *
+ ****************************************************************************/
+bool_t INGEST_bSetCameraLimits(INGEST_tsConfig *psConfig, char *pcIpAddress, ORLACO_tsRegionOfInterest *psRegionOfInterest)
+{
+    INGEST_tsCameraLimits *psLimits = NULL;
+    struct sockaddr_in sAddr;
+    ORLACO_tuIP uIP;
+    uint32_t n;
+
+    sAddr.sin_addr.s_addr = inet_addr(pcIpAddress);
+    if(sAddr.sin_addr.s_addr == INADDR_NONE)
+    {
+        return FALSE;
+    }
+    uIP = INGEST_uGetSenderIP(&sAddr);
+
+    for(n = 0; n < psConfig->u32NumCameraLimits; n++)
+    {
+        if(psConfig->asCameraLimits[n].uIP.u32IP == uIP.u32IP)
+        {
+            psLimits = &psConfig->asCameraLimits[n];
+            break;
+        }
+    }
+
+    if(psLimits == NULL)
+    {
+        if(psConfig->u32NumCameraLimits >= INGEST_MAX_CAMERA_IPS)
+        {
+            return FALSE;
+        }
+        psLimits = &psConfig->asCameraLimits[psConfig->u32NumCameraLimits++];
+    }
+
+    psLimits->uIP = uIP;
+    psLimits->u32MaxBitrate = psRegionOfInterest->u32MaxBitrate;
+    psLimits->u8FrameRate = psRegionOfInterest->u8FrameRate;
+
+    return TRUE;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: INGEST_vProcessDatagram
+ *
+ * DESCRIPTION:
+ * Parses a received RTP datagram and passes it to the depacketizer of the
+ * stream it belongs to, dispatching any frame that it completes
+ *
+ * RETURNS:
+ * void
+ *
+ ****************************************************************************/
+void INGEST_vProcessDatagram(INGEST_tsWorker *psWorker, ORLACO_tuIP uSrcIP, uint16_t u16SrcPort, uint8_t *pu8Data, uint32_t u32Length, uint64_t u64TimeUs)
+{
+    RTP_tsPacket sPacket;
+    RTP_tsFrame sFrame;
+    INGEST_tsStream *psStream;
+    bool_t bFrameComplete = FALSE;
+
+    psWorker->u64Packets++;
+    psWorker->u64Bytes += u32Length;
+
+    if(RTCP_bIsRtcp(pu8Data, u32Length))
+    {
+        INGEST_vProcessRtcp(psWorker, uSrcIP, u16SrcPort, pu8Data, u32Length, u64TimeUs);
+        return;
+    }
+
+    if(!RTP_bParsePacket(pu8Data, u32Length, &sPacket))
+    {
+        if(psWorker->psInstance->psConfig->eVerbosity >= E_ORLACO_VERBOSITY_DEBUG) printf("Dropping non RTP datagram of %u bytes\n", u32Length);
+        return;
+    }
+    sPacket.u64ArrivalTimeUs = u64TimeUs;
+
+    psStream = INGEST_psGetStream(psWorker, uSrcIP, &sPacket);
+    if(psStream == NULL)
+    {
+        return;
+    }
+    psStream->u64LastPacketTimeUs = u64TimeUs;
+    psStream->u16SrcPort = u16SrcPort;
+
+    RTPSTATS_vUpdatePacket(&psStream->sStats, &sPacket, u32Length);
+
+    switch(psStream->eCodec)
+    {
+    case E_RTP_CODEC_JPEG:
+        bFrameComplete = MJPEG_bPushPacket(&psStream->sMjpeg, &sPacket, &sFrame);
+        break;
+
+    case E_RTP_CODEC_H264:
+        bFrameComplete = H264_bPushPacket(&psStream->sH264, &sPacket, &sFrame);
+        break;
+
+    default:
+        break;
+    }
+
+    if(bFrameComplete)
+    {
+        sFrame.uSrcIP = uSrcIP;
+        INGEST_vDispatchFrame(psWorker, psStream, &sFrame);
+    }
+}
+
+/****************************************************************************/
+/***        Local Functions                                               ***/
+/****************************************************************************/
+
+/****************************************************************************
+ *
+ * NAME: INGEST_bCreateWorkers
+ *
+ * DESCRIPTION:
+ * Allocates the workers and opens their sockets
+ *
+ * RETURNS:
+ * bool_t TRUE if successful, FALSE otherwise
+ *
+ ****************************************************************************/
+static bool_t INGEST_bCreateWorkers(INGEST_tsInstance *psInstance)
+{
+    INGEST_tsConfig *psConfig = psInstance->psConfig;
+    INGEST_tsWorker *psWorker;
+    bool_t bShareAllPorts;
+    uint32_t n;
+    uint32_t p;
+
+    psInstance->u32NumWorkers = (psConfig->u32NumWorkers == 0) ? 1 : psConfig->u32NumWorkers;
+    if(psInstance->u32NumWorkers > INGEST_MAX_WORKERS)
+    {
+        psInstance->u32NumWorkers = INGEST_MAX_WORKERS;
+    }
+
+#ifdef _WIN32
+    if(psInstance->u32NumWorkers > 1)
+    {
+        printf("Warning: Multiple receive workers aren't supported on this platform, using one\n");
+        psInstance->u32NumWorkers = 1;
+    }
+#endif
+
+    if(psConfig->bPacketRing)
+    {
+        if(psConfig->u32NumGroups > 0)
+        {
+            printf("Warning: Multicast groups are only joined when receiving from sockets\n");
+        }
+        return INGEST_bCreateRingWorkers(psInstance);
+    }
+
+    // With at least one port per worker, give each worker its own ports. Otherwise all workers share all ports.
+    bShareAllPorts = (psConfig->u32NumPorts < psInstance->u32NumWorkers);
+
+#ifndef SO_REUSEPORT
+    if(bShareAllPorts)
+    {
+        printf("Warning: SO_REUSEPORT isn't supported on this platform, using one worker per port\n");
+        psInstance->u32NumWorkers = psConfig->u32NumPorts;
+        bShareAllPorts = FALSE;
+    }
+#endif
+
+    for(n = 0; n < psInstance->u32NumWorkers; n++)
+    {
+        // Workers are allocated separately so that their hot data never shares a cache line
+        psWorker = (INGEST_tsWorker*)malloc(sizeof(INGEST_tsWorker));
+        if(psWorker == NULL)
+        {
+            printf("Error: Failed to allocate memory for worker in %s\n", __FUNCTION__);
+            return FALSE;
+        }
+        memset(psWorker, 0, sizeof(INGEST_tsWorker));
+        psWorker->psInstance = psInstance;
+        psWorker->u32Index = n;
+        psWorker->iCpu = (psConfig->u32NumCpus > 0) ? psConfig->aiCpus[n % psConfig->u32NumCpus] : -1;
+        psInstance->apsWorkers[n] = psWorker;
+
+        for(p = 0; p < psConfig->u32NumPorts; p++)
+        {
+            if(bShareAllPorts || ((p % psInstance->u32NumWorkers) == n))
+            {
+                if(!INGEST_bOpenSocket(psWorker, psConfig->au16Ports[p], bShareAllPorts))
+                {
+                    return FALSE;
+                }
+            }
+
+            // RTCP is a few packets a second, so its sockets aren't shared but spread over the workers
+            if(psConfig->bRtcp && ((p % psInstance->u32NumWorkers) == n))
+            {
+                if(!INGEST_bOpenSocket(psWorker, (uint16_t)(psConfig->au16Ports[p] + 1), FALSE))
+                {
+                    return FALSE;
+                }
+                if(p == 0)
+                {
+                    psInstance->RtcpSocket = psWorker->aSockets[psWorker->u32NumSockets - 1];
+                }
+            }
+        }
+    }
+
+    return TRUE;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: INGEST_bCreateRingWorkers
+ *
+ * DESCRIPTION:
+ * Allocates the workers, each with its own packet ring. The rings form a
+ * fanout group so the kernel hashes every camera's flow onto one worker.
+ *
+ * RETURNS:
+ * bool_t TRUE if successful, FALSE otherwise
+ *
+ ****************************************************************************/
+static bool_t INGEST_bCreateRingWorkers(INGEST_tsInstance *psInstance)
+{
+    INGEST_tsConfig *psConfig = psInstance->psConfig;
+    INGEST_tsWorker *psWorker;
+    uint16_t au16Ports[INGEST_MAX_SOCKETS];
+    uint32_t u32NumPorts = 0;
+    uint16_t u16FanoutGroup = 0;
+    uint32_t n;
+
+    for(n = 0; n < psConfig->u32NumPorts; n++)
+    {
+        au16Ports[u32NumPorts++] = psConfig->au16Ports[n];
+        if(psConfig->bRtcp)
+        {
+            au16Ports[u32NumPorts++] = (uint16_t)(psConfig->au16Ports[n] + 1);
+        }
+    }
+
+#ifndef _WIN32
+    // Fanout groups are system wide, so use one unlikely to collide with another capture
+    if(psInstance->u32NumWorkers > 1)
+    {
+        u16FanoutGroup = (uint16_t)getpid();
+        if(u16FanoutGroup == 0)
+        {
+            u16FanoutGroup = 1;
+        }
+    }
+#endif
+
+    for(n = 0; n < psInstance->u32NumWorkers; n++)
+    {
+        psWorker = (INGEST_tsWorker*)malloc(sizeof(INGEST_tsWorker));
+        if(psWorker == NULL)
+        {
+            printf("Error: Failed to allocate memory for worker in %s\n", __FUNCTION__);
+            return FALSE;
+        }
+        memset(psWorker, 0, sizeof(INGEST_tsWorker));
+        psWorker->psInstance = psInstance;
+        psWorker->u32Index = n;
+        psWorker->iCpu = (psConfig->u32NumCpus > 0) ? psConfig->aiCpus[n % psConfig->u32NumCpus] : -1;
+        psInstance->apsWorkers[n] = psWorker;
+
+        if(!RXRING_bOpen(&psWorker->sRing,
+                         psConfig->pcInterface,
+                         au16Ports,
+                         u32NumPorts,
+                         psConfig->auCameraIPs,
+                         psConfig->u32NumCameraIPs,
+                         u16FanoutGroup))
+        {
+            return FALSE;
+        }
+        psWorker->bRing = TRUE;
+    }
+
+    // The ring sees the datagrams whether or not anything is bound to the ports, but with
+    // nothing bound the kernel also answers each one with ICMP port unreachable, which makes
+    // some cameras stop streaming. Worker 0 holds sockets on the ports that it never reads.
+    for(n = 0; n < psConfig->u32NumPorts; n++)
+    {
+        if(!INGEST_bOpenPlaceholderSocket(psInstance->apsWorkers[0], psConfig->au16Ports[n]))
+        {
+            return FALSE;
+        }
+        // The first RTCP port is already bound to send receiver reports from
+        if(psConfig->bRtcp && (n != 0))
+        {
+            if(!INGEST_bOpenPlaceholderSocket(psInstance->apsWorkers[0], (uint16_t)(psConfig->au16Ports[n] + 1)))
+            {
+                return FALSE;
+            }
+        }
+    }
+
+    return TRUE;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: INGEST_vDestroyWorkers
+ *
+ * DESCRIPTION:
+ * Closes the workers' sockets and frees their streams
+ *
+ * RETURNS:
+ * void
+ *
+ ****************************************************************************/
+static void INGEST_vDestroyWorkers(INGEST_tsInstance *psInstance)
+{
+    INGEST_tsWorker *psWorker;
+    uint32_t n;
+    uint32_t s;
+
+    for(n = 0; n < INGEST_MAX_WORKERS; n++)
+    {
+        psWorker = psInstance->apsWorkers[n];
+        if(psWorker == NULL)
+        {
+            continue;
+        }
+
+        for(s = 0; s < psWorker->u32NumSockets; s++)
+        {
+            INGEST_vCloseSocket(psWorker->aSockets[s]);
+        }
+
+        if(psWorker->bRing)
+        {
+            RXRING_vClose(&psWorker->sRing);
+        }
+
+        for(s = 0; s < INGEST_MAX_STREAMS; s++)
+        {
+            // Frame rings outlive streams that are recycled, but not the capture
+            if(psWorker->asStreams[s].bShm)
+            {
+                SHMRING_vClose(&psWorker->asStreams[s].sShm, TRUE);
+                psWorker->asStreams[s].bShm = FALSE;
+            }
+            INGEST_vFreeStream(psInstance, &psWorker->asStreams[s]);
+        }
+
+        free(psWorker);
+        psInstance->apsWorkers[n] = NULL;
+    }
+}
+
+
+/****************************************************************************
+ *
+ * NAME: INGEST_bCreatePreEventRings
+ *
+ * DESCRIPTION:
+ * Allocates a pre-event ring for each camera before reception starts, so
+ * that no worker allocates or touches a ring's memory on the receive path.
+ *
+ * RETURNS:
+ * bool_t TRUE if successful, FALSE otherwise
+ *
+ ****************************************************************************/
+static bool_t INGEST_bCreatePreEventRings(INGEST_tsInstance *psInstance)
+{
+    INGEST_tsConfig *psConfig = psInstance->psConfig;
+    uint32_t n;
+
+    psInstance->pasPreEvents = (PRERING_tsInstance*)calloc(psConfig->u32NumCameraIPs, sizeof(PRERING_tsInstance));
+    if(psInstance->pasPreEvents == NULL)
+    {
+        printf("Error: Failed to allocate memory for pre-event rings in %s\n", __FUNCTION__);
+        return FALSE;
+    }
+
+    for(n = 0; n < psConfig->u32NumCameraIPs; n++)
+    {
+        if(!PRERING_bInit(&psInstance->pasPreEvents[n], psConfig->u64PreEventLength, psConfig->u32PreEventSeconds))
+        {
+            return FALSE;
+        }
+        psInstance->u32NumPreEvents++;
+
+        if(psConfig->eVerbosity >= E_ORLACO_VERBOSITY_INFO) printf("Keeping %u seconds of frames from %d.%d.%d.%d in %llu bytes\n",
+                                                                   psInstance->pasPreEvents[n].u32Seconds,
+                                                                   psConfig->auCameraIPs[n].au8IP[3],
+                                                                   psConfig->auCameraIPs[n].au8IP[2],
+                                                                   psConfig->auCameraIPs[n].au8IP[1],
+                                                                   psConfig->auCameraIPs[n].au8IP[0],
+                                                                   (unsigned long long)psInstance->pasPreEvents[n].u64DataLength);
+    }
+
+    return TRUE;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: INGEST_vDestroyPreEventRings
+ *
+ * DESCRIPTION:
+ * Frees the pre-event rings once the workers and the dump thread are done
+ *
+ * RETURNS:
+ * void
+ *
+ ****************************************************************************/
+static void INGEST_vDestroyPreEventRings(INGEST_tsInstance *psInstance)
+{
+    uint32_t n;
+
+    for(n = 0; n < psInstance->u32NumPreEvents; n++)
+    {
+        PRERING_vDeInit(&psInstance->pasPreEvents[n]);
+    }
+    psInstance->u32NumPreEvents = 0;
+
+    free(psInstance->pasPreEvents);
+    psInstance->pasPreEvents = NULL;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: INGEST_bOpenSocket
+ *
+ * DESCRIPTION:
+ * Creates a UDP socket for a worker bound to the given port
+ *
+ * RETURNS:
+ * bool_t TRUE if successful, FALSE otherwise
+ *
+ ****************************************************************************/
+static bool_t INGEST_bOpenSocket(INGEST_tsWorker *psWorker, uint16_t u16Port, bool_t bReusePort)
+{
+    INGEST_tsConfig *psConfig = psWorker->psInstance->psConfig;
+    struct ip_mreq sMembership;
+    struct sockaddr_in sAddr;
+    uint32_t n;
+    int iBufferLength = INGEST_SOCKET_BUFFER_LENGTH;
+    int iEnable = 1;
+    UDPSOCKET Socket;
+
+    Socket = socket(PF_INET, SOCK_DGRAM, IPPROTO_UDP);
+
+#ifdef _WIN32
+    if (Socket == INVALID_SOCKET)
+#else
+    if (Socket < 0)
+#endif
+    {
+        printf("Error: Can't create UDP socket in %s\n", __FUNCTION__);
+        return FALSE;
+    }
+
+    // Video arrives in bursts of a whole frame, so give the kernel plenty of room to queue it
+    if(setsockopt(Socket, SOL_SOCKET, SO_RCVBUF, (const char*)&iBufferLength, sizeof(iBufferLength)) != 0)
+    {
+        if(psConfig->eVerbosity >= E_ORLACO_VERBOSITY_INFO) printf("Warning: Can't set socket receive buffer length in %s\n", __FUNCTION__);
+    }
+
+#ifdef SO_REUSEPORT
+    if(bReusePort)
+    {
+        if(setsockopt(Socket, SOL_SOCKET, SO_REUSEPORT, (const char*)&iEnable, sizeof(iEnable)) != 0)
+        {
+            printf("Error: Can't set SO_REUSEPORT in %s\n", __FUNCTION__);
+            INGEST_vCloseSocket(Socket);
+            return FALSE;
+        }
+    }
+#else
+    (void)iEnable;
+    (void)bReusePort;
+#endif
+
+    memset((char *) &sAddr, 0, sizeof(sAddr));
+    sAddr.sin_family = AF_INET;
+    sAddr.sin_port = htons(u16Port);
+    sAddr.sin_addr.s_addr = INADDR_ANY;
+
+    if(bind(Socket, (const struct sockaddr*)&sAddr, sizeof(sAddr)) < 0)
+    {
+        printf("Error: Bind to port %d failed in %s\n", u16Port, __FUNCTION__);
+        INGEST_vCloseSocket(Socket);
+        return FALSE;
+    }
+
+    // Membership is per socket, so sockets sharing a port with SO_REUSEPORT each join
+    for(n = 0; n < psConfig->u32NumGroups; n++)
+    {
+        sMembership.imr_multiaddr.s_addr = htonl(psConfig->auGroups[n].u32IP);
+        sMembership.imr_interface.s_addr = htonl(psConfig->uGroupInterface.u32IP);
+        if(setsockopt(Socket, IPPROTO_IP, IP_ADD_MEMBERSHIP, (const char*)&sMembership, sizeof(sMembership)) != 0)
+        {
+            printf("Error: Can't join group %d.%d.%d.%d on port %d in %s\n",
+                   psConfig->auGroups[n].au8IP[3], psConfig->auGroups[n].au8IP[2], psConfig->auGroups[n].au8IP[1], psConfig->auGroups[n].au8IP[0], u16Port, __FUNCTION__);
+            INGEST_vCloseSocket(Socket);
+            return FALSE;
+        }
+    }
+
+    psWorker->aSockets[psWorker->u32NumSockets++] = Socket;
+
+    return TRUE;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: INGEST_bOpenPlaceholderSocket
+ *
+ * DESCRIPTION:
+ * Binds a UDP socket to a port captured from a packet ring, only so that the
+ * port counts as open. It is never read, so its receive buffer is kept as
+ * small as the kernel allows and datagrams beyond that are dropped.
+ *
+ * RETURNS:
+ * bool_t TRUE if successful, FALSE otherwise
+ *
+ ****************************************************************************/
+static bool_t INGEST_bOpenPlaceholderSocket(INGEST_tsWorker *psWorker, uint16_t u16Port)
+{
+    struct sockaddr_in sAddr;
+    int iBufferLength = 0;
+    UDPSOCKET Socket;
+
+    Socket = socket(PF_INET, SOCK_DGRAM, IPPROTO_UDP);
+
+#ifdef _WIN32
+    if (Socket == INVALID_SOCKET)
+#else
+    if (Socket < 0)
+#endif
+    {
+        printf("Error: Can't create UDP socket in %s\n", __FUNCTION__);
+        return FALSE;
+    }
+
+    // The kernel rounds this up to its minimum
+    (void)setsockopt(Socket, SOL_SOCKET, SO_RCVBUF, (const char*)&iBufferLength, sizeof(iBufferLength));
+
+    memset((char *) &sAddr, 0, sizeof(sAddr));
+    sAddr.sin_family = AF_INET;
+    sAddr.sin_port = htons(u16Port);
+    sAddr.sin_addr.s_addr = INADDR_ANY;
+
+    if(bind(Socket, (const struct sockaddr*)&sAddr, sizeof(sAddr)) < 0)
+    {
+        printf("Error: Bind to port %d failed in %s\n", u16Port, __FUNCTION__);
+        INGEST_vCloseSocket(Socket);
+        return FALSE;
+    }
+
+    psWorker->aSockets[psWorker->u32NumSockets++] = Socket;
+
+    return TRUE;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: INGEST_bOpenRtcpSocket
+ *
+ * DESCRIPTION:
+ * Picks the SSRC and CNAME we report as. Receiver reports are sent from the
+ * port above the first RTP port, so that cameras answering to where they
+ * came from reach our RTCP sockets. Workers reading sockets open that one
+ * themselves; with a packet ring a socket is bound to it here just to send
+ * from, as the ring sees everything that arrives.
+ *
+ * RETURNS:
+ * bool_t TRUE if successful, FALSE otherwise
+ *
+ ****************************************************************************/
+static bool_t INGEST_bOpenRtcpSocket(INGEST_tsInstance *psInstance)
+{
+    INGEST_tsConfig *psConfig = psInstance->psConfig;
+    struct sockaddr_in sAddr;
+    char acHostName[64];
+
+    // Only has to differ from the cameras' SSRCs, and from another instance of us
+    psInstance->u32RtcpSsrc = (uint32_t)(RTCP_u64GetNtpTime() ^ (RTP_u64GetTimeUs() << 12));
+
+    if(gethostname(acHostName, sizeof(acHostName)) != 0)
+    {
+        strcpy(acHostName, "localhost");
+    }
+    acHostName[sizeof(acHostName) - 1] = '\0';
+    snprintf(psInstance->acRtcpCname, sizeof(psInstance->acRtcpCname), "occ@%s", acHostName);
+
+    if(!psConfig->bPacketRing)
+    {
+        return TRUE;
+    }
+
+    psInstance->RtcpSocket = socket(PF_INET, SOCK_DGRAM, IPPROTO_UDP);
+
+#ifdef _WIN32
+    if (psInstance->RtcpSocket == INVALID_SOCKET)
+#else
+    if (psInstance->RtcpSocket < 0)
+#endif
+    {
+        printf("Error: Can't create RTCP socket in %s\n", __FUNCTION__);
+        return FALSE;
+    }
+
+    memset((char *) &sAddr, 0, sizeof(sAddr));
+    sAddr.sin_family = AF_INET;
+    sAddr.sin_port = htons((uint16_t)(psConfig->au16Ports[0] + 1));
+    sAddr.sin_addr.s_addr = INADDR_ANY;
+
+    if(bind(psInstance->RtcpSocket, (const struct sockaddr*)&sAddr, sizeof(sAddr)) < 0)
+    {
+        printf("Error: Bind to port %d failed in %s\n", psConfig->au16Ports[0] + 1, __FUNCTION__);
+        INGEST_vCloseSocket(psInstance->RtcpSocket);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: INGEST_vCloseSocket
+ *
+ * DESCRIPTION:
+ * Closes an RTP socket
+ *
+ * RETURNS:
+ * void
+ *
+ ****************************************************************************/
+static void INGEST_vCloseSocket(UDPSOCKET Socket)
+{
+#ifdef _WIN32
+    closesocket(Socket);
+#else
+    close(Socket);
+#endif
+}
+
+
+/****************************************************************************
+ *
+ * NAME: INGEST_pvWorkerThread
+ *
+ * DESCRIPTION:
+ * Receive loop of a worker. Waits on all of the worker's sockets with a
+ * timeout so that exit requests are noticed.
+ *
+ * RETURNS:
+ * void * - Always NULL
+ *
+ ****************************************************************************/
+static void *INGEST_pvWorkerThread(void *pvWorker)
+{
+    INGEST_tsWorker *psWorker = (INGEST_tsWorker*)pvWorker;
+    uint32_t n;
+
+#ifdef _WIN32
+    struct timeval sTimeout;
+    fd_set sReadSet;
+    UDPSOCKET MaxSocket = 0;
+    bool_t bBusy;
+
+    while(!INGEST_bFinished(psWorker->psInstance))
+    {
+        INGEST_vReportStats(psWorker);
+        INGEST_vServiceRtcp(psWorker);
+        INGEST_vServiceRateControl(psWorker);
+        // Without threads the single worker writes the dumps too
+        bBusy = INGEST_bServicePreEvent(psWorker->psInstance);
+
+        FD_ZERO(&sReadSet);
+        for(n = 0; n < psWorker->u32NumSockets; n++)
+        {
+            FD_SET(psWorker->aSockets[n], &sReadSet);
+            if(psWorker->aSockets[n] > MaxSocket) MaxSocket = psWorker->aSockets[n];
+        }
+        sTimeout.tv_sec = 0;
+        sTimeout.tv_usec = bBusy ? 0 : INGEST_POLL_TIMEOUT_MS * 1000;
+        if(select((int)MaxSocket + 1, &sReadSet, NULL, NULL, &sTimeout) <= 0)
+        {
+            continue;
+        }
+        for(n = 0; n < psWorker->u32NumSockets; n++)
+        {
+            if(FD_ISSET(psWorker->aSockets[n], &sReadSet))
+            {
+                INGEST_vReceive(psWorker, psWorker->aSockets[n]);
+            }
+        }
+    }
+#else
+    struct pollfd asPollFds[INGEST_MAX_SOCKETS];
+
+#ifdef __linux__
+    cpu_set_t sCpuSet;
+
+    if(psWorker->iCpu >= 0)
+    {
+        CPU_ZERO(&sCpuSet);
+        CPU_SET(psWorker->iCpu, &sCpuSet);
+        if(pthread_setaffinity_np(pthread_self(), sizeof(sCpuSet), &sCpuSet) != 0)
+        {
+            printf("Warning: Failed to pin worker %u to CPU %d\n", psWorker->u32Index, psWorker->iCpu);
+            psWorker->iCpu = -1;
+        }
+    }
+#else
+    psWorker->iCpu = -1;
+#endif
+
+    if(psWorker->bRing)
+    {
+        while(!INGEST_bFinished(psWorker->psInstance))
+        {
+            INGEST_vReportStats(psWorker);
+            INGEST_vServiceRtcp(psWorker);
+            INGEST_vServiceRateControl(psWorker);
+
+            if(!RXRING_bReceive(&psWorker->sRing, INGEST_POLL_TIMEOUT_MS, INGEST_vRingPacket, psWorker))
+            {
+                printf("Error: Packet ring receive failed on worker %u\n", psWorker->u32Index);
+                break;
+            }
+        }
+        return NULL;
+    }
+
+    for(n = 0; n < psWorker->u32NumSockets; n++)
+    {
+        asPollFds[n].fd = psWorker->aSockets[n];
+        asPollFds[n].events = POLLIN;
+    }
+
+    while(!INGEST_bFinished(psWorker->psInstance))
+    {
+        INGEST_vReportStats(psWorker);
+        INGEST_vServiceRtcp(psWorker);
+        INGEST_vServiceRateControl(psWorker);
+
+        if(poll(asPollFds, psWorker->u32NumSockets, INGEST_POLL_TIMEOUT_MS) <= 0)
+        {
+            continue;
+        }
+        for(n = 0; n < psWorker->u32NumSockets; n++)
+        {
+            if(asPollFds[n].revents & POLLIN)
+            {
+                INGEST_vReceive(psWorker, psWorker->aSockets[n]);
+            }
+        }
+    }
+#endif
+
+    return NULL;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: INGEST_vReceive
+ *
+ * DESCRIPTION:
+ * Drains a readable socket. On Linux datagrams are fetched in batches with
+ * recvmmsg() to cut the number of system calls per packet.
+ *
+ * RETURNS:
+ * void
+ *
+ ****************************************************************************/
+static void INGEST_vReceive(INGEST_tsWorker *psWorker, UDPSOCKET Socket)
+{
+    struct sockaddr_in asRxAddr[INGEST_BATCH_LENGTH];
+    uint64_t u64TimeUs;
+    int iLen;
+    int n;
+
+#ifdef __linux__
+    struct mmsghdr asMsgs[INGEST_BATCH_LENGTH];
+    struct iovec asIov[INGEST_BATCH_LENGTH];
+
+    for(n = 0; n < INGEST_BATCH_LENGTH; n++)
+    {
+        asIov[n].iov_base = psWorker->au8Data[n];
+        asIov[n].iov_len = RTP_MAX_PACKET_LENGTH;
+        memset(&asMsgs[n], 0, sizeof(struct mmsghdr));
+        asMsgs[n].msg_hdr.msg_name = &asRxAddr[n];
+        asMsgs[n].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+        asMsgs[n].msg_hdr.msg_iov = &asIov[n];
+        asMsgs[n].msg_hdr.msg_iovlen = 1;
+    }
+
+    do
+    {
+        iLen = recvmmsg(Socket, asMsgs, INGEST_BATCH_LENGTH, MSG_DONTWAIT, NULL);
+        if(iLen <= 0)
+        {
+            break;
+        }
+
+        u64TimeUs = RTP_u64GetTimeUs();
+        for(n = 0; n < iLen; n++)
+        {
+            INGEST_vProcessDatagram(psWorker, INGEST_uGetSenderIP(&asRxAddr[n]), ntohs(asRxAddr[n].sin_port), psWorker->au8Data[n], asMsgs[n].msg_len, u64TimeUs);
+            asMsgs[n].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+        }
+    }
+    while((iLen == INGEST_BATCH_LENGTH) && !INGEST_bFinished(psWorker->psInstance));
+#else
+    socklen_t tRxAddrLen = sizeof(asRxAddr[0]);
+
+    (void)n;
+    iLen = recvfrom(Socket, (char*)psWorker->au8Data[0], RTP_MAX_PACKET_LENGTH, 0, (struct sockaddr*)&asRxAddr[0], &tRxAddrLen);
+    if(iLen > 0)
+    {
+        u64TimeUs = RTP_u64GetTimeUs();
+        INGEST_vProcessDatagram(psWorker, INGEST_uGetSenderIP(&asRxAddr[0]), ntohs(asRxAddr[0].sin_port), psWorker->au8Data[0], (uint32_t)iLen, u64TimeUs);
+    }
+#endif
+}
+
+
+/****************************************************************************
+ *
+ * NAME: INGEST_psGetStream
+ *
+ * DESCRIPTION:
+ * Finds the stream a packet belongs to, creating it if this is the first
+ * packet seen. The least recently used stream is recycled if the table is full.
+ *
+ * RETURNS:
+ * INGEST_tsStream * - The stream, or NULL if the packet can't be handled
+ *
+ ****************************************************************************/
+static INGEST_tsStream *INGEST_psGetStream(INGEST_tsWorker *psWorker, ORLACO_tuIP uSrcIP, RTP_tsPacket *psPacket)
+{
+    INGEST_tsStream *psStream = NULL;
+    INGEST_tsStream *psOldest = NULL;
+    INGEST_tsStream *psFree = NULL;
+    RTP_teCodec eCodec;
+    uint32_t u32Camera;
+    int n;
+
+    for(n = 0; n < INGEST_MAX_STREAMS; n++)
+    {
+        psStream = &psWorker->asStreams[n];
+        if(psStream->bInUse)
+        {
+            if((psStream->uSrcIP.u32IP == uSrcIP.u32IP) && (psStream->u32Ssrc == psPacket->u32Ssrc))
+            {
+                return psStream;
+            }
+            if((psOldest == NULL) || (psStream->u64LastPacketTimeUs < psOldest->u64LastPacketTimeUs))
+            {
+                psOldest = psStream;
+            }
+        }
+        else if(psFree == NULL)
+        {
+            psFree = psStream;
+        }
+    }
+
+    // A packet ring has already filtered on the camera, but sockets accept from anyone
+    if(psWorker->psInstance->psConfig->u32NumCameraIPs > 0)
+    {
+        for(u32Camera = 0; u32Camera < psWorker->psInstance->psConfig->u32NumCameraIPs; u32Camera++)
+        {
+            if(psWorker->psInstance->psConfig->auCameraIPs[u32Camera].u32IP == uSrcIP.u32IP)
+            {
+                break;
+            }
+        }
+        if(u32Camera == psWorker->psInstance->psConfig->u32NumCameraIPs)
+        {
+            return NULL;
+        }
+    }
+
+    // Work out how to depacketize the new stream from its payload type
+    switch(psPacket->u8PayloadType)
+    {
+    case RTP_PAYLOAD_TYPE_JPEG:
+        eCodec = E_RTP_CODEC_JPEG;
+        break;
+
+    default:
+        // The cameras only use a dynamic payload type for H.264
+        if(psPacket->u8PayloadType >= RTP_PAYLOAD_TYPE_DYNAMIC)
+        {
+            eCodec = E_RTP_CODEC_H264;
+            break;
+        }
+        if(psWorker->psInstance->psConfig->eVerbosity >= E_ORLACO_VERBOSITY_DEBUG) printf("Ignoring stream with unsupported payload type %d\n", psPacket->u8PayloadType);
+        return NULL;
+    }
+
+    psStream = (psFree != NULL) ? psFree : psOldest;
+    INGEST_vFreeStream(psWorker->psInstance, psStream);
+
+    memset(psStream, 0, sizeof(INGEST_tsStream));
+    psStream->uSrcIP = uSrcIP;
+    psStream->u32Ssrc = psPacket->u32Ssrc;
+    psStream->eCodec = eCodec;
+    RTPSTATS_vInit(&psStream->sStats, RTPSTATS_VIDEO_CLOCK_RATE, psPacket->u64ArrivalTimeUs);
+
+    for(u32Camera = 0; u32Camera < psWorker->psInstance->psConfig->u32NumCameraLimits; u32Camera++)
+    {
+        if(psWorker->psInstance->psConfig->asCameraLimits[u32Camera].uIP.u32IP == uSrcIP.u32IP)
+        {
+            psStream->psLimits = &psWorker->psInstance->psConfig->asCameraLimits[u32Camera];
+            break;
+        }
+    }
+
+    switch(eCodec)
+    {
+    case E_RTP_CODEC_JPEG:
+        if(!MJPEG_bInit(&psStream->sMjpeg))
+        {
+            return NULL;
+        }
+        break;
+
+    case E_RTP_CODEC_H264:
+        if(!H264_bInit(&psStream->sH264))
+        {
+            return NULL;
+        }
+        break;
+
+    default:
+        break;
+    }
+
+    psStream->bInUse = TRUE;
+
+    // The recorder outlives the stream until the writer thread has finished with it
+    if((psWorker->psInstance->psConfig->pcMp4Prefix != NULL) && (eCodec == E_RTP_CODEC_H264))
+    {
+        psStream->psRecorder = (MP4_tsRecorder*)malloc(sizeof(MP4_tsRecorder));
+        if(psStream->psRecorder == NULL)
+        {
+            printf("Error: Failed to allocate memory for recorder in %s\n", __FUNCTION__);
+        }
+        else if(!MP4_bInit(psStream->psRecorder,
+                           psWorker->psInstance->psConfig->pcMp4Prefix,
+                           psWorker->psInstance->psConfig->u32SegmentSeconds,
+                           psWorker->psInstance->psConfig->bDirectIO))
+        {
+            free(psStream->psRecorder);
+            psStream->psRecorder = NULL;
+        }
+    }
+
+    if(psWorker->psInstance->psConfig->pcShmPrefix != NULL)
+    {
+        INGEST_vOpenFrameRing(psWorker, psStream);
+    }
+
+    if(psWorker->psInstance->psConfig->pcPreEventPrefix != NULL)
+    {
+        INGEST_vOpenPreEventRing(psWorker, psStream);
+    }
+
+    if(psWorker->psInstance->psConfig->eVerbosity >= E_ORLACO_VERBOSITY_INFO) printf("New %s stream from %d.%d.%d.%d SSRC=%08x on worker %u\n",
+                                                                                    RTP_pcGetCodecAsString(eCodec),
+                                                                                    uSrcIP.au8IP[3],
+                                                                                    uSrcIP.au8IP[2],
+                                                                                    uSrcIP.au8IP[1],
+                                                                                    uSrcIP.au8IP[0],
+                                                                                    psPacket->u32Ssrc,
+                                                                                    psWorker->u32Index);
+
+    return psStream;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: INGEST_vOpenFrameRing
+ *
+ * DESCRIPTION:
+ * Opens the shared memory ring a stream's frames are published to. Rings
+ * are named after the camera so consumers needn't know its SSRC, which
+ * changes when the camera restarts. A new stream from the same camera
+ * takes the ring over from the old one, so it only ever has one producer.
+ *
+ * RETURNS:
+ * void
+ *
+ ****************************************************************************/
+static void INGEST_vOpenFrameRing(INGEST_tsWorker *psWorker, INGEST_tsStream *psStream)
+{
+    INGEST_tsConfig *psConfig = psWorker->psInstance->psConfig;
+    char acName[SHMRING_MAX_NAME_LENGTH];
+    int n;
+
+    for(n = 0; n < INGEST_MAX_STREAMS; n++)
+    {
+        if((&psWorker->asStreams[n] != psStream) && psWorker->asStreams[n].bShm && (psWorker->asStreams[n].uSrcIP.u32IP == psStream->uSrcIP.u32IP))
+        {
+            memcpy(&psStream->sShm, &psWorker->asStreams[n].sShm, sizeof(SHMRING_tsInstance));
+            psWorker->asStreams[n].bShm = FALSE;
+            psStream->bShm = TRUE;
+            return;
+        }
+    }
+
+    snprintf(acName, sizeof(acName), "%s-%d.%d.%d.%d",
+             psConfig->pcShmPrefix,
+             psStream->uSrcIP.au8IP[3],
+             psStream->uSrcIP.au8IP[2],
+             psStream->uSrcIP.au8IP[1],
+             psStream->uSrcIP.au8IP[0]);
+
+    psStream->bShm = SHMRING_bCreate(&psStream->sShm,
+                                     acName,
+                                     SHMRING_DEFAULT_NUM_SLOTS,
+                                     (psConfig->u64ShmLength != 0) ? psConfig->u64ShmLength : SHMRING_DEFAULT_DATA_LENGTH);
+
+    if(psStream->bShm && (psConfig->eVerbosity >= E_ORLACO_VERBOSITY_INFO)) printf("Publishing frames from %d.%d.%d.%d to %s\n",
+                                                                                 psStream->uSrcIP.au8IP[3],
+                                                                                 psStream->uSrcIP.au8IP[2],
+                                                                                 psStream->uSrcIP.au8IP[1],
+                                                                                 psStream->uSrcIP.au8IP[0],
+                                                                                 psStream->sShm.acName);
+}
+
+
+/****************************************************************************
+ *
+ * NAME: INGEST_vOpenPreEventRing
+ *
+ * DESCRIPTION:
+ * Attaches a stream to its camera's pre-event ring. All of a camera's
+ * streams share the one ring whichever worker they are on, so the history
+ * survives a camera restart and memory stays bounded per camera.
+ *
+ * RETURNS:
+ * void
+ *
+ ****************************************************************************/
+static void INGEST_vOpenPreEventRing(INGEST_tsWorker *psWorker, INGEST_tsStream *psStream)
+{
+    INGEST_tsInstance *psInstance = psWorker->psInstance;
+    uint32_t n;
+
+    for(n = 0; n < psInstance->u32NumPreEvents; n++)
+    {
+        if(psInstance->psConfig->auCameraIPs[n].u32IP == psStream->uSrcIP.u32IP)
+        {
+            psStream->psPreEvent = &psInstance->pasPreEvents[n];
+            return;
+        }
+    }
+}
+
+
+/****************************************************************************
+ *
+ * NAME: INGEST_vFreeStream
+ *
+ * DESCRIPTION:
+ * Frees the depacketizer and recorder state of a stream
+ *
+ * RETURNS:
+ * void
+ *
+ ****************************************************************************/
+static void INGEST_vFreeStream(INGEST_tsInstance *psInstance, INGEST_tsStream *psStream)
+{
+    if(!psStream->bInUse)
+    {
+        return;
+    }
+
+    switch(psStream->eCodec)
+    {
+    case E_RTP_CODEC_JPEG:
+        MJPEG_vDeInit(&psStream->sMjpeg);
+        break;
+
+    case E_RTP_CODEC_H264:
+        H264_vDeInit(&psStream->sH264);
+        break;
+
+    default:
+        break;
+    }
+
+    // Finish the segment being written, once the frames queued for it are in
+    if(psStream->psRecorder != NULL)
+    {
+        INGEST_bQueueWrite(psInstance, E_INGEST_WRITE_CLOSE_MP4, psStream->psRecorder, NULL, 0);
+        psStream->psRecorder = NULL;
+    }
+
+    // Leave the ring in place for consumers, the camera's next stream will take it over
+    if(psStream->bShm)
+    {
+        SHMRING_vClose(&psStream->sShm, FALSE);
+        psStream->bShm = FALSE;
+    }
+
+    // The pre-event ring belongs to the camera, its dumps carry on
+    psStream->psPreEvent = NULL;
+
+    psStream->bInUse = FALSE;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: INGEST_vDispatchFrame
+ *
+ * DESCRIPTION:
+ * Passes a complete frame to the configured outputs
+ *
+ * RETURNS:
+ * void
+ *
+ ****************************************************************************/
+static void INGEST_vDispatchFrame(INGEST_tsWorker *psWorker, INGEST_tsStream *psStream, RTP_tsFrame *psFrame)
+{
+    INGEST_tsInstance *psInstance = psWorker->psInstance;
+    INGEST_tsConfig *psConfig = psInstance->psConfig;
+    uint64_t u64CaptureTimeUs;
+
+    RTPSTATS_vUpdateFrame(&psStream->sStats, psFrame);
+
+    // Claim a slot against the frame limit, once it is reached ignore any frames still arriving
+    if(psConfig->u32MaxFrames != 0)
+    {
+        if(__atomic_fetch_add(&psInstance->u32FramesTotal, 1, __ATOMIC_RELAXED) >= psConfig->u32MaxFrames)
+        {
+            return;
+        }
+    }
+
+    if(psConfig->eVerbosity >= E_ORLACO_VERBOSITY_DEBUG) printf("Frame %u from %d.%d.%d.%d SSRC=%08x TS=%u %ux%u %u bytes\n",
+                                                                psStream->u32FrameNumber,
+                                                                psFrame->uSrcIP.au8IP[3],
+                                                                psFrame->uSrcIP.au8IP[2],
+                                                                psFrame->uSrcIP.au8IP[1],
+                                                                psFrame->uSrcIP.au8IP[0],
+                                                                psFrame->u32Ssrc,
+                                                                psFrame->u32Timestamp,
+                                                                psFrame->u16Width,
+                                                                psFrame->u16Height,
+                                                                psFrame->u32Length);
+
+    if((psConfig->pcJpegPrefix != NULL) && (psFrame->eCodec == E_RTP_CODEC_JPEG))
+    {
+        INGEST_bQueueWrite(psInstance, E_INGEST_WRITE_JPEG, NULL, psFrame, psStream->u32FrameNumber);
+    }
+
+    if(psStream->psRecorder != NULL)
+    {
+        // The frames after one that didn't reach the recorder can't be decoded until the next key frame
+        if(psFrame->bKeyFrame)
+        {
+            psStream->bRecordGap = FALSE;
+        }
+        if(!psStream->bRecordGap && !INGEST_bQueueWrite(psInstance, E_INGEST_WRITE_MP4, psStream->psRecorder, psFrame, 0))
+        {
+            psStream->bRecordGap = TRUE;
+        }
+    }
+
+    if(psStream->bShm)
+    {
+        if(!SHMRING_bPublish(&psStream->sShm, psFrame))
+        {
+            if(psConfig->eVerbosity >= E_ORLACO_VERBOSITY_DEBUG) printf("Frame of %u bytes doesn't fit in ring %s\n", psFrame->u32Length, psStream->sShm.acName);
+        }
+    }
+
+    if(psInstance->bAlign)
+    {
+        if(!INGEST_bGetCaptureTimeUs(psWorker, psStream, psFrame->u32Timestamp, &u64CaptureTimeUs))
+        {
+            u64CaptureTimeUs = 0;
+        }
+        ALIGN_vPushFrame(&psInstance->sAlign, psFrame, u64CaptureTimeUs);
+    }
+
+    if(psStream->psPreEvent != NULL)
+    {
+        if(!PRERING_bPush(psStream->psPreEvent, psFrame))
+        {
+            if(psConfig->eVerbosity >= E_ORLACO_VERBOSITY_DEBUG) printf("Frame of %u bytes not kept for pre-event dump\n", psFrame->u32Length);
+        }
+    }
+
+    if(psConfig->prFrameCallback != NULL)
+    {
+        psConfig->prFrameCallback(psConfig->pvFrameCallbackContext, psFrame);
+    }
+
+    psStream->u32FrameNumber++;
+    psWorker->u64Frames++;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: INGEST_vProcessRtcp
+ *
+ * DESCRIPTION:
+ * Handles a compound RTCP packet, storing the clock mapping from a sender
+ * report and the round trip time from a DLRR block in the shared table.
+ * The least recently updated entry is replaced if it is full.
+ *
+ * RETURNS:
+ * void
+ *
+ ****************************************************************************/
+static void INGEST_vProcessRtcp(INGEST_tsWorker *psWorker, ORLACO_tuIP uSrcIP, uint16_t u16SrcPort, uint8_t *pu8Data, uint32_t u32Length, uint64_t u64TimeUs)
+{
+    INGEST_tsInstance *psInstance = psWorker->psInstance;
+    INGEST_tsSender *psEntry;
+    RTCP_tsSenderReport sReport;
+    bool_t bReport;
+    bool_t bDlrr;
+    uint32_t u32DlrrSsrc = 0;
+    uint32_t u32LastRr = 0;
+    uint32_t u32DelaySinceLastRr = 0;
+    uint32_t u32RoundTripUs = 0;
+
+    bReport = RTCP_bParseSenderReport(pu8Data, u32Length, &sReport);
+    bDlrr = RTCP_bParseDlrr(pu8Data, u32Length, psInstance->u32RtcpSsrc, &u32DlrrSsrc, &u32LastRr, &u32DelaySinceLastRr);
+    if(bDlrr)
+    {
+        u32RoundTripUs = RTCP_u32GetRoundTripUs(RTCP_u64GetNtpTime(), u32LastRr, u32DelaySinceLastRr);
+    }
+
+    if(psInstance->psConfig->eVerbosity >= E_ORLACO_VERBOSITY_DEBUG)
+    {
+        if(bReport) printf("Sender report from %d.%d.%d.%d:%d SSRC=%08x NTP=%llu.%06llu TS=%u\n",
+                           uSrcIP.au8IP[3],
+                           uSrcIP.au8IP[2],
+                           uSrcIP.au8IP[1],
+                           uSrcIP.au8IP[0],
+                           u16SrcPort,
+                           sReport.u32Ssrc,
+                           (unsigned long long)(RTCP_u64NtpToUnixUs(sReport.u64NtpTime) / 1000000ULL),
+                           (unsigned long long)(RTCP_u64NtpToUnixUs(sReport.u64NtpTime) % 1000000ULL),
+                           sReport.u32RtpTimestamp);
+        if(bDlrr) printf("DLRR from %d.%d.%d.%d SSRC=%08x RTT=%uus\n",
+                         uSrcIP.au8IP[3],
+                         uSrcIP.au8IP[2],
+                         uSrcIP.au8IP[1],
+                         uSrcIP.au8IP[0],
+                         u32DlrrSsrc,
+                         u32RoundTripUs);
+    }
+
+    if(!bReport && !bDlrr)
+    {
+        return;
+    }
+
+#ifndef _WIN32
+    pthread_mutex_lock(&psInstance->sSenderLock);
+#endif
+
+    psEntry = INGEST_psGetSender(psInstance, uSrcIP, bReport ? sReport.u32Ssrc : u32DlrrSsrc, u64TimeUs);
+    psEntry->u16Port = u16SrcPort;
+    if(bReport)
+    {
+        RTCP_vUpdateClock(&psEntry->sClock, &sReport, RTPSTATS_VIDEO_CLOCK_RATE, u64TimeUs);
+    }
+    if(bDlrr && (u32RoundTripUs != 0))
+    {
+        psEntry->u32RoundTripUs = u32RoundTripUs;
+    }
+    __atomic_fetch_add(&psInstance->u32SenderGeneration, 1, __ATOMIC_RELEASE);
+
+#ifndef _WIN32
+    pthread_mutex_unlock(&psInstance->sSenderLock);
+#endif
+}
+
+
+/****************************************************************************
+ *
+ * NAME: INGEST_psGetSender
+ *
+ * DESCRIPTION:
+ * Finds the shared table entry of a sender, creating it or replacing the
+ * least recently updated one if needed. Call with the table locked.
+ *
+ * RETURNS:
+ * INGEST_tsSender * - The entry
+ *
+ ****************************************************************************/
+static INGEST_tsSender *INGEST_psGetSender(INGEST_tsInstance *psInstance, ORLACO_tuIP uIP, uint32_t u32Ssrc, uint64_t u64TimeUs)
+{
+    INGEST_tsSender *psEntry;
+    uint32_t n;
+
+    for(n = 0; n < psInstance->u32NumSenders; n++)
+    {
+        if((psInstance->asSenders[n].uIP.u32IP == uIP.u32IP) && (psInstance->asSenders[n].u32Ssrc == u32Ssrc))
+        {
+            return &psInstance->asSenders[n];
+        }
+    }
+
+    if(psInstance->u32NumSenders < INGEST_MAX_SENDERS)
+    {
+        psEntry = &psInstance->asSenders[psInstance->u32NumSenders++];
+    }
+    else
+    {
+        psEntry = &psInstance->asSenders[0];
+        for(n = 1; n < INGEST_MAX_SENDERS; n++)
+        {
+            if(psInstance->asSenders[n].sClock.u64ReceivedUs < psEntry->sClock.u64ReceivedUs)
+            {
+                psEntry = &psInstance->asSenders[n];
+            }
+        }
+    }
+
+    memset(psEntry, 0, sizeof(INGEST_tsSender));
+    psEntry->uIP = uIP;
+    psEntry->u32Ssrc = u32Ssrc;
+    psEntry->sClock.u64ReceivedUs = u64TimeUs;
+
+    return psEntry;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: INGEST_vRefreshSender
+ *
+ * DESCRIPTION:
+ * Refreshes a stream's copy of what RTCP has told us about its sender, if
+ * anything has arrived since it was last taken
+ *
+ * RETURNS:
+ * void
+ *
+ ****************************************************************************/
+static void INGEST_vRefreshSender(INGEST_tsWorker *psWorker, INGEST_tsStream *psStream)
+{
+    INGEST_tsInstance *psInstance = psWorker->psInstance;
+    uint32_t u32Generation;
+    uint32_t n;
+
+    u32Generation = __atomic_load_n(&psInstance->u32SenderGeneration, __ATOMIC_ACQUIRE);
+    if(u32Generation == psStream->u32SenderGeneration)
+    {
+        return;
+    }
+
+#ifndef _WIN32
+    pthread_mutex_lock(&psInstance->sSenderLock);
+#endif
+    for(n = 0; n < psInstance->u32NumSenders; n++)
+    {
+        if((psInstance->asSenders[n].uIP.u32IP == psStream->uSrcIP.u32IP) && (psInstance->asSenders[n].u32Ssrc == psStream->u32Ssrc))
+        {
+            memcpy(&psStream->sSender, &psInstance->asSenders[n], sizeof(INGEST_tsSender));
+            break;
+        }
+    }
+#ifndef _WIN32
+    pthread_mutex_unlock(&psInstance->sSenderLock);
+#endif
+    psStream->u32SenderGeneration = u32Generation;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: INGEST_vServiceRtcp
+ *
+ * DESCRIPTION:
+ * Sends a receiver report for each of the worker's streams that is due one,
+ * to the sender's RTCP port if it has sent RTCP, or else the port above its
+ * RTP source port. Reports are spread around INGEST_RTCP_INTERVAL_MS so
+ * streams don't report in step.
+ *
+ * RETURNS:
+ * void
+ *
+ ****************************************************************************/
+static void INGEST_vServiceRtcp(INGEST_tsWorker *psWorker)
+{
+    INGEST_tsInstance *psInstance = psWorker->psInstance;
+    INGEST_tsStream *psStream;
+    RTCP_tsReportBlock sBlock;
+    struct sockaddr_in sAddr;
+    uint8_t au8Packet[RTCP_MAX_PACKET_LENGTH];
+    uint32_t u32Length;
+    uint64_t u64TimeUs;
+    int n;
+
+    if(!psInstance->psConfig->bRtcp)
+    {
+        return;
+    }
+
+    u64TimeUs = RTP_u64GetTimeUs();
+
+    for(n = 0; n < INGEST_MAX_STREAMS; n++)
+    {
+        psStream = &psWorker->asStreams[n];
+        if(!psStream->bInUse || (u64TimeUs < psStream->u64NextRtcpUs))
+        {
+            continue;
+        }
+
+        psStream->u64NextRtcpUs = u64TimeUs + (INGEST_RTCP_INTERVAL_MS / 2) * 1000ULL + ((u64TimeUs ^ psStream->u32Ssrc) % (INGEST_RTCP_INTERVAL_MS * 1000ULL));
+        if(!psStream->sStats.bStarted)
+        {
+            continue;
+        }
+
+        INGEST_vRefreshSender(psWorker, psStream);
+
+        memset(&sBlock, 0, sizeof(sBlock));
+        sBlock.u32Ssrc = psStream->u32Ssrc;
+        RTPSTATS_vGetReportBlock(&psStream->sStats, &sBlock);
+        RTCP_vGetLastSr(&psStream->sSender.sClock, u64TimeUs, &sBlock.u32LastSr, &sBlock.u32DelaySinceLastSr);
+        u32Length = RTCP_u32BuildReceiverReport(au8Packet, psInstance->u32RtcpSsrc, &sBlock, psInstance->acRtcpCname, RTCP_u64GetNtpTime());
+
+        memset(&sAddr, 0, sizeof(sAddr));
+        sAddr.sin_family = AF_INET;
+        sAddr.sin_addr.s_addr = htonl(psStream->uSrcIP.u32IP);
+        sAddr.sin_port = htons((psStream->sSender.u16Port != 0) ? psStream->sSender.u16Port : (uint16_t)(psStream->u16SrcPort + 1));
+
+        if(sendto(psInstance->RtcpSocket, (const char*)au8Packet, u32Length, 0, (struct sockaddr*)&sAddr, sizeof(sAddr)) < 0)
+        {
+            if(psInstance->psConfig->eVerbosity >= E_ORLACO_VERBOSITY_DEBUG) printf("Failed to send receiver report to %d.%d.%d.%d\n",
+                                                                                    psStream->uSrcIP.au8IP[3],
+                                                                                    psStream->uSrcIP.au8IP[2],
+                                                                                    psStream->uSrcIP.au8IP[1],
+                                                                                    psStream->uSrcIP.au8IP[0]);
+        }
+    }
+}
+
+
+/****************************************************************************
+ *
+ * NAME: INGEST_vServiceRateControl
+ *
+ * DESCRIPTION:
+ * Passes what each of the worker's streams received since the last time to
+ * the rate controller, a few times per controller interval so each of its
+ * intervals sees nearly all of the packets that arrived during it
+ *
+ * RETURNS:
+ * void
+ *
+ ****************************************************************************/
+static void INGEST_vServiceRateControl(INGEST_tsWorker *psWorker)
+{
+    RATECTL_tsInstance *psRate = psWorker->psInstance->psConfig->psRateControl;
+    INGEST_tsStream *psStream;
+    uint64_t u64Expected;
+    uint64_t u64Lost;
+    uint64_t u64Bytes;
+    uint64_t u64TimeUs;
+    int n;
+
+    if(psRate == NULL)
+    {
+        return;
+    }
+
+    u64TimeUs = RTP_u64GetTimeUs();
+    if(u64TimeUs < psWorker->u64NextControlUs)
+    {
+        return;
+    }
+    psWorker->u64NextControlUs = u64TimeUs + (uint64_t)psRate->u32IntervalMs * (1000ULL / 4);
+
+    for(n = 0; n < INGEST_MAX_STREAMS; n++)
+    {
+        psStream = &psWorker->asStreams[n];
+        if(!psStream->bInUse || !psStream->sStats.bStarted)
+        {
+            continue;
+        }
+
+        RTPSTATS_vGetControlSample(&psStream->sStats, &u64Expected, &u64Lost, &u64Bytes);
+        RATECTL_vAddSample(psRate, psStream->uSrcIP, u64Expected, u64Lost, u64Bytes,
+                           (uint32_t)((uint64_t)(psStream->sStats.u32Jitter >> 4) * 1000000ULL / psStream->sStats.u32ClockRate));
+    }
+}
+
+
+/****************************************************************************
+ *
+ * NAME: INGEST_bGetCaptureTimeUs
+ *
+ * DESCRIPTION:
+ * Converts a stream's RTP timestamp to the camera's wall clock
+ *
+ * RETURNS:
+ * bool_t TRUE if successful, FALSE if the camera hasn't sent a sender report
+ *
+ ****************************************************************************/
+static bool_t INGEST_bGetCaptureTimeUs(INGEST_tsWorker *psWorker, INGEST_tsStream *psStream, uint32_t u32Timestamp, uint64_t *pu64TimeUs)
+{
+    INGEST_vRefreshSender(psWorker, psStream);
+
+    return RTCP_bGetWallClockUs(&psStream->sSender.sClock, u32Timestamp, pu64TimeUs);
+}
+
+
+/****************************************************************************
+ *
+ * NAME: INGEST_bFinished
+ *
+ * DESCRIPTION:
+ * Checks whether receiving should stop
+ *
+ * RETURNS:
+ * bool_t TRUE if an exit was requested or the frame limit reached
+ *
+ ****************************************************************************/
+static bool_t INGEST_bFinished(INGEST_tsInstance *psInstance)
+{
+    if((psInstance->psConfig->pbExit != NULL) && *psInstance->psConfig->pbExit)
+    {
+        return TRUE;
+    }
+
+    if((psInstance->psConfig->u32MaxFrames != 0) && (__atomic_load_n(&psInstance->u32FramesTotal, __ATOMIC_RELAXED) >= psInstance->psConfig->u32MaxFrames))
+    {
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: INGEST_uGetSenderIP
+ *
+ * DESCRIPTION:
+ * Converts a socket address into the IP representation used by the Orlaco functions
+ *
+ * RETURNS:
+ * ORLACO_tuIP The sender's IP address
+ *
+ ****************************************************************************/
+static ORLACO_tuIP INGEST_uGetSenderIP(struct sockaddr_in *psAddr)
+{
+    ORLACO_tuIP uIP;
+
+#ifdef _WIN32
+    uIP.au8IP[3] = psAddr->sin_addr.S_un.S_un_b.s_b1;
+    uIP.au8IP[2] = psAddr->sin_addr.S_un.S_un_b.s_b2;
+    uIP.au8IP[1] = psAddr->sin_addr.S_un.S_un_b.s_b3;
+    uIP.au8IP[0] = psAddr->sin_addr.S_un.S_un_b.s_b4;
+#else
+    uIP.au8IP[3] = (uint8_t)((psAddr->sin_addr.s_addr >> 0) & 0xff);
+    uIP.au8IP[2] = (uint8_t)((psAddr->sin_addr.s_addr >> 8) & 0xff);
+    uIP.au8IP[1] = (uint8_t)((psAddr->sin_addr.s_addr >> 16) & 0xff);
+    uIP.au8IP[0] = (uint8_t)((psAddr->sin_addr.s_addr >> 24) & 0xff);
+#endif
+
+    return uIP;
+}
+
+
+
+/****************************************************************************
+ *
+ * NAME: INGEST_vReportStats
+ *
+ * DESCRIPTION:
+ * Prints the statistics of the worker's streams once the reporting interval
+ * has passed. Each worker reports its own streams so that statistics are
+ * never read by a thread that doesn't own them, holding stdout while it does
+ * so that its rows don't interleave with those of the other workers.
+ *
+ * RETURNS:
+ * void
+ *
+ ****************************************************************************/
+static void INGEST_vReportStats(INGEST_tsWorker *psWorker)
+{
+    INGEST_tsConfig *psConfig = psWorker->psInstance->psConfig;
+    INGEST_tsStream *psStream;
+    RTPSTATS_tsReport sReport;
+    char acIP[16];
+    uint64_t u64TimeUs;
+    double dTime;
+    int n;
+
+    if(psConfig->u32StatsIntervalMs == 0)
+    {
+        return;
+    }
+
+    u64TimeUs = RTP_u64GetTimeUs();
+    if(u64TimeUs < psWorker->u64NextReportUs)
+    {
+        return;
+    }
+
+    // Stay on the original schedule rather than drifting by the poll timeout each interval
+    while(psWorker->u64NextReportUs <= u64TimeUs)
+    {
+        psWorker->u64NextReportUs += (uint64_t)psConfig->u32StatsIntervalMs * 1000ULL;
+    }
+
+    dTime = (double)(u64TimeUs - psWorker->psInstance->u64StartTimeUs) / 1000000.0;
+
+#ifndef _WIN32
+    flockfile(stdout);
+#endif
+
+    for(n = 0; n < INGEST_MAX_STREAMS; n++)
+    {
+        psStream = &psWorker->asStreams[n];
+        if(!psStream->bInUse)
+        {
+            continue;
+        }
+
+        RTPSTATS_vGetReport(&psStream->sStats, u64TimeUs, &sReport);
+        INGEST_vRefreshSender(psWorker, psStream);
+
+        sprintf(acIP, "%d.%d.%d.%d", psStream->uSrcIP.au8IP[3], psStream->uSrcIP.au8IP[2], psStream->uSrcIP.au8IP[1], psStream->uSrcIP.au8IP[0]);
+
+        if(psConfig->eStatsFormat == E_INGEST_STATS_FORMAT_NDJSON)
+        {
+            printf("{\"time\":%.3f,\"camera\":\"%s\",\"ssrc\":\"%08x\",\"codec\":\"%s\",\"worker\":%u,"
+                   "\"mbps\":%.3f,\"fps\":%.2f,",
+                   dTime, acIP, psStream->u32Ssrc, RTP_pcGetCodecAsString(psStream->eCodec), psWorker->u32Index,
+                   sReport.dBitrateMbps, sReport.dFrameRate);
+            if(psStream->psLimits != NULL)
+            {
+                printf("\"max_mbps\":%u,\"cfg_fps\":%u,\"over_bitrate\":%s,",
+                       psStream->psLimits->u32MaxBitrate, psStream->psLimits->u8FrameRate,
+                       (sReport.dBitrateMbps > (double)psStream->psLimits->u32MaxBitrate) ? "true" : "false");
+            }
+            if(psStream->sSender.u32RoundTripUs != 0)
+            {
+                printf("\"rtt_ms\":%.3f,", (double)psStream->sSender.u32RoundTripUs / 1000.0);
+            }
+            printf("\"expected\":%llu,\"lost\":%llu,\"reordered\":%llu,\"lost_total\":%llu,\"jitter_ms\":%.3f,"
+                   "\"spread_avg_ms\":%.3f,\"spread_max_ms\":%.3f,\"delay_avg_ms\":%.3f,\"delay_max_ms\":%.3f}\n",
+                   (unsigned long long)sReport.u64Expected, (unsigned long long)sReport.u64Lost,
+                   (unsigned long long)sReport.u64Reordered, (unsigned long long)sReport.u64LostTotal, sReport.dJitterMs,
+                   sReport.dSpreadAvgMs, sReport.dSpreadMaxMs, sReport.dDelayAvgMs, sReport.dDelayMaxMs);
+        }
+        else
+        {
+            printf("%-8.1f %-15s %08x %-6s %7.2f ", dTime, acIP, psStream->u32Ssrc, RTP_pcGetCodecAsString(psStream->eCodec), sReport.dBitrateMbps);
+            if(psStream->psLimits != NULL)
+            {
+                printf("%4u%s %6.2f %3u ",
+                       psStream->psLimits->u32MaxBitrate,
+                       (sReport.dBitrateMbps > (double)psStream->psLimits->u32MaxBitrate) ? "!" : " ",
+                       sReport.dFrameRate,
+                       psStream->psLimits->u8FrameRate);
+            }
+            else
+            {
+                printf("%5s %6.2f %3s ", "-", sReport.dFrameRate, "-");
+            }
+            printf("%6llu %6llu %6llu %5llu %7.2f %7.2f %7.2f %7.2f ",
+                   (unsigned long long)sReport.u64Expected, (unsigned long long)sReport.u64Lost,
+                   (unsigned long long)sReport.u64Reordered, (unsigned long long)sReport.u64LostTotal,
+                   sReport.dJitterMs, sReport.dSpreadAvgMs, sReport.dSpreadMaxMs, sReport.dDelayAvgMs);
+            if(psStream->sSender.u32RoundTripUs != 0)
+            {
+                printf("%7.2f\n", (double)psStream->sSender.u32RoundTripUs / 1000.0);
+            }
+            else
+            {
+                printf("%7s\n", "-");
+            }
+        }
+    }
+
+    fflush(stdout);
+
+#ifndef _WIN32
+    funlockfile(stdout);
+#endif
+}
+
+
+#ifndef _WIN32
+/****************************************************************************
+ *
+ * NAME: INGEST_pvDumpThread
+ *
+ * DESCRIPTION:
+ * Checks the triggers and writes the pre-event dumps until stopped, then
+ * completes any dumps still in progress
+ *
+ * RETURNS:
+ * void * NULL
+ *
+ ****************************************************************************/
+static void *INGEST_pvDumpThread(void *pvInstance)
+{
+    INGEST_tsInstance *psInstance = (INGEST_tsInstance*)pvInstance;
+    bool_t bBusy = FALSE;
+
+    while(bBusy || !psInstance->bStopDump)
+    {
+        bBusy = INGEST_bServicePreEvent(psInstance);
+        if(!bBusy)
+        {
+            usleep(PRERING_TRIGGER_CHECK_MS * 1000);
+        }
+    }
+
+    return NULL;
+}
+#endif
+
+
+/****************************************************************************
+ *
+ * NAME: INGEST_bServicePreEvent
+ *
+ * DESCRIPTION:
+ * Checks the trigger sources, starts a dump of every camera's pre-event
+ * ring when one fires and writes the next chunk of any dumps in progress
+ *
+ * RETURNS:
+ * bool_t TRUE if dumps are still in progress, FALSE otherwise
+ *
+ ****************************************************************************/
+static bool_t INGEST_bServicePreEvent(INGEST_tsInstance *psInstance)
+{
+    INGEST_tsConfig *psConfig = psInstance->psConfig;
+    PRERING_tsInstance *psRing;
+    ORLACO_tuIP *puIP;
+    bool_t bBusy = FALSE;
+    uint32_t n;
+
+    if(psConfig->pcPreEventPrefix == NULL)
+    {
+        return FALSE;
+    }
+
+    if(INGEST_bCheckTriggers(psInstance))
+    {
+        for(n = 0; n < psInstance->u32NumPreEvents; n++)
+        {
+            psRing = &psInstance->pasPreEvents[n];
+            puIP = &psConfig->auCameraIPs[n];
+            if(psRing->bDumping)
+            {
+                printf("Warning: Pre-event dump of %d.%d.%d.%d still in progress, trigger ignored\n",
+                       puIP->au8IP[3], puIP->au8IP[2], puIP->au8IP[1], puIP->au8IP[0]);
+                continue;
+            }
+            if(PRERING_bStartDump(psRing, psInstance->acEventPrefix))
+            {
+                if(psConfig->eVerbosity >= E_ORLACO_VERBOSITY_INFO) printf("Dumping %llu frames from %d.%d.%d.%d to %s\n",
+                                                                           (unsigned long long)(psRing->u64DumpEnd - psRing->u64DumpSeq),
+                                                                           puIP->au8IP[3],
+                                                                           puIP->au8IP[2],
+                                                                           puIP->au8IP[1],
+                                                                           puIP->au8IP[0],
+                                                                           psRing->acPrefix);
+            }
+        }
+    }
+
+    for(n = 0; n < psInstance->u32NumPreEvents; n++)
+    {
+        psRing = &psInstance->pasPreEvents[n];
+        if(psRing->bDumping)
+        {
+            bBusy |= PRERING_bContinueDump(psRing, PRERING_DUMP_CHUNK_LENGTH);
+        }
+    }
+
+    return bBusy;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: INGEST_bCheckTriggers
+ *
+ * DESCRIPTION:
+ * Checks the trigger file, socket and application counter, and names the
+ * event if any fired. Triggers within PRERING_TRIGGER_HOLDOFF_MS of the
+ * last are merged into it.
+ *
+ * RETURNS:
+ * bool_t TRUE if a dump should start, FALSE otherwise
+ *
+ ****************************************************************************/
+static bool_t INGEST_bCheckTriggers(INGEST_tsInstance *psInstance)
+{
+    INGEST_tsConfig *psConfig = psInstance->psConfig;
+    uint64_t u64TimeUs = RTP_u64GetTimeUs();
+    bool_t bTriggered;
+    uint32_t u32AppTriggers;
+    char acTime[32];
+    time_t tNow;
+
+    bTriggered = PRERING_bCheckTrigger(&psInstance->sTrigger, u64TimeUs);
+
+    if(psConfig->pu32Trigger != NULL)
+    {
+        u32AppTriggers = *psConfig->pu32Trigger;
+        if(u32AppTriggers != psInstance->u32AppTriggersSeen)
+        {
+            psInstance->u32AppTriggersSeen = u32AppTriggers;
+            bTriggered = TRUE;
+        }
+    }
+
+    if(!bTriggered)
+    {
+        return FALSE;
+    }
+
+    if((psInstance->u64LastTriggerUs != 0) && (u64TimeUs - psInstance->u64LastTriggerUs < PRERING_TRIGGER_HOLDOFF_MS * 1000ULL))
+    {
+        if(psConfig->eVerbosity >= E_ORLACO_VERBOSITY_DEBUG) printf("Trigger merged with the previous one\n");
+        return FALSE;
+    }
+    psInstance->u64LastTriggerUs = u64TimeUs;
+
+    tNow = time(NULL);
+    strftime(acTime, sizeof(acTime), "%Y%m%d-%H%M%S", localtime(&tNow));
+    snprintf(psInstance->acEventPrefix, sizeof(psInstance->acEventPrefix), "%s-%s", psConfig->pcPreEventPrefix, acTime);
+
+    if(psConfig->eVerbosity >= E_ORLACO_VERBOSITY_INFO) printf("Pre-event dump triggered, writing to %s\n", psInstance->acEventPrefix);
+
+    return TRUE;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: INGEST_vRingPacket
+ *
+ * DESCRIPTION:
+ * Passes a datagram taken from a worker's packet ring to the depacketizers
+ *
+ * RETURNS:
+ * void
+ *
+ ****************************************************************************/
+static void INGEST_vRingPacket(void *pvWorker, ORLACO_tuIP uSrcIP, uint16_t u16SrcPort, uint8_t *pu8Data, uint32_t u32Length, uint64_t u64TimeUs)
+{
+    INGEST_vProcessDatagram((INGEST_tsWorker*)pvWorker, uSrcIP, u16SrcPort, pu8Data, u32Length, u64TimeUs);
+}
+
+
+/****************************************************************************
+ *
+ * NAME: INGEST_bStartWriter
+ *
+ * DESCRIPTION:
+ * Starts the thread that writes frames to disk for the workers. Without
+ * threads each write is done by the worker that asks for it.
+ *
+ * RETURNS:
+ * bool_t TRUE if successful, FALSE otherwise
+ *
+ ****************************************************************************/
+static bool_t INGEST_bStartWriter(INGEST_tsInstance *psInstance)
+{
+#ifndef _WIN32
+    pthread_mutex_init(&psInstance->sWriteLock, NULL);
+    pthread_cond_init(&psInstance->sWriteReady, NULL);
+    pthread_cond_init(&psInstance->sWriteDone, NULL);
+    if(pthread_create(&psInstance->sWriteThread, NULL, INGEST_pvWriterThread, psInstance) != 0)
+    {
+        printf("Error: Failed to start the frame writer in %s\n", __FUNCTION__);
+        pthread_cond_destroy(&psInstance->sWriteDone);
+        pthread_cond_destroy(&psInstance->sWriteReady);
+        pthread_mutex_destroy(&psInstance->sWriteLock);
+        return FALSE;
+    }
+    psInstance->bWriter = TRUE;
+#endif
+
+    return TRUE;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: INGEST_vStopWriter
+ *
+ * DESCRIPTION:
+ * Waits for the writer thread to write everything queued and frees the
+ * queue. Any later writes are done by the caller.
+ *
+ * RETURNS:
+ * void
+ *
+ ****************************************************************************/
+static void INGEST_vStopWriter(INGEST_tsInstance *psInstance)
+{
+    uint32_t n;
+
+#ifndef _WIN32
+    if(psInstance->bWriter)
+    {
+        pthread_mutex_lock(&psInstance->sWriteLock);
+        psInstance->bStopWrite = TRUE;
+        pthread_cond_signal(&psInstance->sWriteReady);
+        pthread_mutex_unlock(&psInstance->sWriteLock);
+        pthread_join(psInstance->sWriteThread, NULL);
+
+        pthread_cond_destroy(&psInstance->sWriteDone);
+        pthread_cond_destroy(&psInstance->sWriteReady);
+        pthread_mutex_destroy(&psInstance->sWriteLock);
+        psInstance->bWriter = FALSE;
+    }
+#endif
+
+    for(n = 0; n < INGEST_WRITE_QUEUE_LENGTH; n++)
+    {
+        free(psInstance->asWrites[n].pu8Buffer);
+        psInstance->asWrites[n].pu8Buffer = NULL;
+        psInstance->asWrites[n].u32BufferLength = 0;
+    }
+}
+
+
+/****************************************************************************
+ *
+ * NAME: INGEST_bQueueWrite
+ *
+ * DESCRIPTION:
+ * Hands a JPEG frame to be written to its file, or an H.264 frame to be
+ * recorded, or the closing of a recorder, to the writer thread. The
+ * frame is copied into a queue entry so the worker can reuse its buffer
+ * straight away. Only the claiming and releasing of the entry is done
+ * under the lock. A frame is dropped if the queue is full, but a recorder
+ * is always closed, waiting for room if need be.
+ *
+ * RETURNS:
+ * bool_t TRUE if queued, or written when there is no writer thread,
+ * FALSE if the frame was dropped
+ *
+ ****************************************************************************/
+static bool_t INGEST_bQueueWrite(INGEST_tsInstance *psInstance, INGEST_teWrite eWrite, MP4_tsRecorder *psRecorder, RTP_tsFrame *psFrame, uint32_t u32FrameNumber)
+{
+    INGEST_tsWrite sWrite;
+#ifndef _WIN32
+    INGEST_tsWrite *psWrite;
+    uint8_t *pu8Buffer;
+    bool_t bOk = TRUE;
+#endif
+
+    if(!psInstance->bWriter)
+    {
+        memset(&sWrite, 0, sizeof(sWrite));
+        sWrite.eWrite = eWrite;
+        sWrite.psRecorder = psRecorder;
+        sWrite.u32FrameNumber = u32FrameNumber;
+        if(psFrame != NULL)
+        {
+            sWrite.sFrame = *psFrame;
+        }
+        INGEST_vWrite(psInstance, &sWrite);
+        return TRUE;
+    }
+
+#ifndef _WIN32
+    pthread_mutex_lock(&psInstance->sWriteLock);
+    if(psFrame == NULL)
+    {
+        while(psInstance->u32WriteCount == INGEST_WRITE_QUEUE_LENGTH)
+        {
+            pthread_cond_wait(&psInstance->sWriteDone, &psInstance->sWriteLock);
+        }
+    }
+    else if(psInstance->u32WriteCount == INGEST_WRITE_QUEUE_LENGTH)
+    {
+        psInstance->u64WritesDropped++;
+        pthread_mutex_unlock(&psInstance->sWriteLock);
+        return FALSE;
+    }
+    psWrite = &psInstance->asWrites[(psInstance->u32WriteHead + psInstance->u32WriteCount) % INGEST_WRITE_QUEUE_LENGTH];
+    psWrite->bReady = FALSE;
+    psInstance->u32WriteCount++;
+    pthread_mutex_unlock(&psInstance->sWriteLock);
+
+    // The entry is ours until it's marked ready
+    psWrite->eWrite = eWrite;
+    psWrite->psRecorder = psRecorder;
+    psWrite->u32FrameNumber = u32FrameNumber;
+    if(psFrame != NULL)
+    {
+        if(psWrite->u32BufferLength < psFrame->u32Length)
+        {
+            pu8Buffer = (uint8_t*)realloc(psWrite->pu8Buffer, psFrame->u32Length);
+            if(pu8Buffer == NULL)
+            {
+                printf("Error: Failed to allocate memory for frame in %s\n", __FUNCTION__);
+                psWrite->eWrite = E_INGEST_WRITE_NONE;
+                bOk = FALSE;
+            }
+            else
+            {
+                psWrite->pu8Buffer = pu8Buffer;
+                psWrite->u32BufferLength = psFrame->u32Length;
+            }
+        }
+        if(bOk)
+        {
+            psWrite->sFrame = *psFrame;
+            psWrite->sFrame.pu8Data = psWrite->pu8Buffer;
+            memcpy(psWrite->pu8Buffer, psFrame->pu8Data, psFrame->u32Length);
+        }
+    }
+
+    pthread_mutex_lock(&psInstance->sWriteLock);
+    psWrite->bReady = TRUE;
+    if(!bOk)
+    {
+        psInstance->u64WritesDropped++;
+    }
+    pthread_cond_signal(&psInstance->sWriteReady);
+    pthread_mutex_unlock(&psInstance->sWriteLock);
+
+    return bOk;
+#else
+    return FALSE;
+#endif
+}
+
+
+/****************************************************************************
+ *
+ * NAME: INGEST_vWrite
+ *
+ * DESCRIPTION:
+ * Does the disk work of a queue entry
+ *
+ * RETURNS:
+ * void
+ *
+ ****************************************************************************/
+static void INGEST_vWrite(INGEST_tsInstance *psInstance, INGEST_tsWrite *psWrite)
+{
+    switch(psWrite->eWrite)
+    {
+    case E_INGEST_WRITE_JPEG:
+        MJPEG_bWriteFrameToFile(&psWrite->sFrame, psInstance->psConfig->pcJpegPrefix, psWrite->u32FrameNumber);
+        break;
+
+    case E_INGEST_WRITE_MP4:
+        MP4_bPushFrame(psWrite->psRecorder, &psWrite->sFrame);
+        break;
+
+    case E_INGEST_WRITE_CLOSE_MP4:
+        MP4_vDeInit(psWrite->psRecorder);
+        free(psWrite->psRecorder);
+        break;
+
+    default:
+        break;
+    }
+}
+
+
+#ifndef _WIN32
+/****************************************************************************
+ *
+ * NAME: INGEST_pvWriterThread
+ *
+ * DESCRIPTION:
+ * Writes the queued frames in the order the workers queued them, so each
+ * recorder gets its frames in stream order, without holding the lock the
+ * workers queue under. Once stopped, what is still queued is written
+ * before it returns.
+ *
+ * RETURNS:
+ * void * - Always NULL
+ *
+ ****************************************************************************/
+static void *INGEST_pvWriterThread(void *pvInstance)
+{
+    INGEST_tsInstance *psInstance = (INGEST_tsInstance *)pvInstance;
+    INGEST_tsWrite *psWrite;
+
+    pthread_mutex_lock(&psInstance->sWriteLock);
+    while(TRUE)
+    {
+        while(((psInstance->u32WriteCount == 0) && !psInstance->bStopWrite) ||
+              ((psInstance->u32WriteCount != 0) && !psInstance->asWrites[psInstance->u32WriteHead].bReady))
+        {
+            pthread_cond_wait(&psInstance->sWriteReady, &psInstance->sWriteLock);
+        }
+        if(psInstance->u32WriteCount == 0)
+        {
+            break;
+        }
+        psWrite = &psInstance->asWrites[psInstance->u32WriteHead];
+        pthread_mutex_unlock(&psInstance->sWriteLock);
+
+        INGEST_vWrite(psInstance, psWrite);
+
+        pthread_mutex_lock(&psInstance->sWriteLock);
+        psInstance->u32WriteHead = (psInstance->u32WriteHead + 1) % INGEST_WRITE_QUEUE_LENGTH;
+        psInstance->u32WriteCount--;
+        pthread_cond_broadcast(&psInstance->sWriteDone);
+    }
+    pthread_mutex_unlock(&psInstance->sWriteLock);
+
+    return NULL;
+}
+#endif
+
+/****************************************************************************/
+/***        END OF FILE                                                   ***/
+/****************************************************************************/
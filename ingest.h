@@ -0,0 +1,242 @@
+#ifndef INGEST_H
+#define INGEST_H
+
+/****************************************************************************/
+/***        Include files                                                 ***/
+/****************************************************************************/
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#ifndef _WIN32
+#include <pthread.h>
+#endif
+
+#include "common.h"
+#include "orlaco.h"
+#include "rtp.h"
+#include "mjpeg.h"
+#include "h264.h"
+#include "mp4.h"
+#include "rxring.h"
+#include "rtpstats.h"
+#include "shmring.h"
+#include "prering.h"
+#include "rtcp.h"
+#include "align.h"
+#include "ratectl.h"
+
+/****************************************************************************/
+/***        Macro Definitions                                             ***/
+/****************************************************************************/
+
+#define INGEST_MAX_STREAMS              64                  // Per worker
+#define INGEST_MAX_PORTS                16
+#define INGEST_MAX_SOCKETS              (2 * INGEST_MAX_PORTS) // RTP and RTCP
+#define INGEST_MAX_WORKERS              32
+#define INGEST_MAX_CPUS                 1024                // Workers can be pinned to CPUs below this, glibc's CPU_SETSIZE
+#define INGEST_MAX_CAMERA_IPS           64
+#define INGEST_MAX_GROUPS               8
+#define INGEST_BATCH_LENGTH             32                  // Datagrams fetched per receive call
+#define INGEST_SOCKET_BUFFER_LENGTH     (4 * 1024 * 1024)
+#define INGEST_POLL_TIMEOUT_MS          100
+#define INGEST_MAX_SENDERS              64                  // Senders whose RTCP state is kept
+#define INGEST_RTCP_CNAME_LENGTH        72
+#define INGEST_RTCP_INTERVAL_MS         1000                // Average receiver report interval, randomised by half either way
+#define INGEST_WRITE_QUEUE_LENGTH       64                  // Frames held while the writer thread catches up with the disk
+
+/****************************************************************************/
+/***        Type Definitions                                              ***/
+/****************************************************************************/
+
+typedef struct INGEST_tsInstance INGEST_tsInstance;
+
+// What RTCP has told us about a sender
+typedef struct {
+    ORLACO_tuIP uIP;
+    uint32_t u32Ssrc;
+    uint16_t u16Port;                               // Its RTCP port, 0 until it has sent RTCP
+    RTCP_tsClock sClock;                            // Wall clock mapping from its latest sender report
+    uint32_t u32RoundTripUs;                        // From its latest DLRR block, 0 if unknown
+} INGEST_tsSender;
+
+typedef enum {
+    E_INGEST_STATS_FORMAT_TABLE = 0,
+    E_INGEST_STATS_FORMAT_NDJSON,
+} INGEST_teStatsFormat;
+
+// What a camera's selected ROI is configured to send, for comparison with what arrives
+typedef struct {
+    ORLACO_tuIP uIP;
+    uint32_t u32MaxBitrate;                         // Megabits per second
+    uint8_t u8FrameRate;
+} INGEST_tsCameraLimits;
+
+// Per stream state, a stream is identified by its source IP and SSRC
+typedef struct {
+    bool_t bInUse;
+    ORLACO_tuIP uSrcIP;
+    uint32_t u32Ssrc;
+    RTP_teCodec eCodec;
+    uint64_t u64LastPacketTimeUs;
+    uint32_t u32FrameNumber;
+    INGEST_tsCameraLimits *psLimits;                // NULL if the camera's ROI isn't known
+    RTPSTATS_tsStream sStats;
+    bool_t bShm;
+    SHMRING_tsInstance sShm;                        // Frames are published here for local consumers
+    MP4_tsRecorder *psRecorder;                     // Only used on the writer thread once recording starts, NULL if not recording
+    bool_t bRecordGap;                              // A frame didn't reach the recorder, skip to the next key frame
+    MJPEG_tsDepacketizer sMjpeg;
+    H264_tsDepacketizer sH264;
+    uint16_t u16SrcPort;                            // RTP source port, receiver reports go to the port above if the sender's RTCP port isn't known
+    INGEST_tsSender sSender;                        // Copied from the instance's table when it changes
+    uint32_t u32SenderGeneration;
+    uint64_t u64NextRtcpUs;
+    PRERING_tsInstance *psPreEvent;                 // The camera's recent frames, shared by all of its streams, NULL if not kept
+} INGEST_tsStream;
+
+typedef struct {
+    ORLACO_eVerbosityLevel eVerbosity;
+    uint16_t au16Ports[INGEST_MAX_PORTS];           // Local UDP ports the RTP streams are sent to
+    uint32_t u32NumPorts;
+    uint32_t u32NumWorkers;                         // Number of receive threads, 0 or 1 for a single thread
+    int aiCpus[INGEST_MAX_WORKERS];                 // CPUs to pin the workers to, used round robin
+    uint32_t u32NumCpus;
+    bool_t bPacketRing;                             // Capture from a TPACKET_V3 ring instead of UDP sockets (Linux only)
+    char *pcInterface;                              // Interface for the packet ring, NULL or "any" for all
+    ORLACO_tuIP auCameraIPs[INGEST_MAX_CAMERA_IPS]; // Only accept streams from these cameras, none to accept any
+    uint32_t u32NumCameraIPs;
+    ORLACO_tuIP auGroups[INGEST_MAX_GROUPS];        // Multicast groups to join on every socket
+    uint32_t u32NumGroups;
+    ORLACO_tuIP uGroupInterface;                    // Address of the interface to join them on, zero to let the routing table choose
+    uint32_t u32StatsIntervalMs;                    // Report stream statistics this often, 0 to disable
+    INGEST_teStatsFormat eStatsFormat;
+    INGEST_tsCameraLimits asCameraLimits[INGEST_MAX_CAMERA_IPS];
+    uint32_t u32NumCameraLimits;
+    char *pcShmPrefix;                              // Publish frames to shared memory rings named <prefix>-<camera ip>, NULL to disable
+    uint64_t u64ShmLength;                          // Frame data bytes per ring
+    char *pcJpegPrefix;                             // Write JPEG frames to files with this prefix, NULL to disable
+    char *pcMp4Prefix;                              // Record H.264 streams to fragmented MP4 segments with this prefix, NULL to disable
+    uint32_t u32SegmentSeconds;                     // Start a new segment at the first key frame after this long, 0 for the default
+    bool_t bDirectIO;                               // Write segments with O_DIRECT (Linux only)
+    char *pcPreEventPrefix;                         // Keep recent frames of each camera in auCameraIPs and dump them to files with this prefix when triggered, NULL to disable
+    uint32_t u32PreEventSeconds;                    // How much to dump, 0 for the default
+    uint64_t u64PreEventLength;                     // Frame data bytes held per camera, 0 for the default
+    char *pcTriggerFile;                            // Dump when this file is touched, NULL to disable
+    char *pcTriggerSocket;                          // Dump when "dump" is sent to this Unix datagram socket, NULL to disable
+    bool_t bRtcp;                                   // Receive RTCP on the port above each RTP port and send receiver reports
+    bool_t bAlign;                                  // Group frames from the cameras in auCameraIPs taken at the same instant
+    uint32_t u32AlignToleranceUs;                   // Largest skew within a set, 0 for the default
+    char *pcAlignPrefix;                            // Write the JPEG frames of each set to files with this prefix, NULL to disable
+    RATECTL_tsInstance *psRateControl;              // Feed each stream's loss and jitter to this controller, NULL to disable
+    uint32_t u32MaxFrames;                          // Stop after this many frames, 0 to run until an exit is requested
+    RTP_tpfFrameCallback prFrameCallback;           // Optional callback for every complete frame, called on the worker that owns the stream
+    void *pvFrameCallbackContext;
+    volatile bool_t *pbExit;                        // Set by the application to stop receiving
+    volatile uint32_t *pu32Trigger;                 // Incremented by the application to request a dump, NULL if unused
+} INGEST_tsConfig;
+
+typedef enum {
+    E_INGEST_WRITE_NONE = 0,
+    E_INGEST_WRITE_JPEG,
+    E_INGEST_WRITE_MP4,
+    E_INGEST_WRITE_CLOSE_MP4,
+} INGEST_teWrite;
+
+// Disk work handed from a worker to the writer thread, with its own copy of the frame
+typedef struct {
+    INGEST_teWrite eWrite;
+    volatile bool_t bReady;                         // Set once the worker has filled it in
+    MP4_tsRecorder *psRecorder;
+    uint32_t u32FrameNumber;                        // For JPEG file names
+    RTP_tsFrame sFrame;                             // pu8Data points into pu8Buffer
+    uint8_t *pu8Buffer;
+    uint32_t u32BufferLength;
+} INGEST_tsWrite;
+
+// Everything a receive thread touches is owned by its worker so that workers share nothing on the fast path
+typedef struct {
+    INGEST_tsInstance *psInstance;
+    uint32_t u32Index;
+    int iCpu;                                       // CPU the worker is pinned to, -1 if not pinned
+    UDPSOCKET aSockets[INGEST_MAX_SOCKETS];         // With a packet ring, placeholders on the ports that are never read
+    uint32_t u32NumSockets;
+    bool_t bRing;
+    RXRING_tsInstance sRing;
+    uint64_t u64Packets;
+    uint64_t u64Bytes;
+    uint64_t u64Frames;
+    uint64_t u64NextReportUs;
+    uint64_t u64NextControlUs;
+    INGEST_tsStream asStreams[INGEST_MAX_STREAMS];
+    uint8_t au8Data[INGEST_BATCH_LENGTH][RTP_MAX_PACKET_LENGTH];
+#ifndef _WIN32
+    pthread_t sThread;
+#endif
+} INGEST_tsWorker;
+
+struct INGEST_tsInstance {
+    INGEST_tsConfig *psConfig;
+    volatile uint32_t u32FramesTotal;               // Shared between workers, only updated atomically
+    uint64_t u64StartTimeUs;
+
+    // Pre-event rings are allocated up front, one per camera in auCameraIPs and in the same
+    // order. The workers push frames into them and the dump thread writes them out.
+    PRERING_tsInstance *pasPreEvents;
+    uint32_t u32NumPreEvents;
+    PRERING_tsTrigger sTrigger;                     // Only checked by the thread writing the dumps
+    uint32_t u32AppTriggersSeen;
+    uint64_t u64LastTriggerUs;
+    char acEventPrefix[PRERING_MAX_PREFIX_LENGTH];  // Of the latest dump
+#ifndef _WIN32
+    volatile bool_t bStopDump;
+    pthread_t sDumpThread;
+#endif
+
+    // RTCP may arrive on a different worker from the stream it describes, so what it
+    // carries goes into a shared table. Streams only take the lock when the generation changes.
+    UDPSOCKET RtcpSocket;                           // Receiver reports are sent from here by every worker, bound to the first RTCP port
+    uint32_t u32RtcpSsrc;
+    char acRtcpCname[INGEST_RTCP_CNAME_LENGTH];
+    INGEST_tsSender asSenders[INGEST_MAX_SENDERS];
+    uint32_t u32NumSenders;
+    volatile uint32_t u32SenderGeneration;
+#ifndef _WIN32
+    pthread_mutex_t sSenderLock;
+#endif
+    bool_t bAlign;
+    ALIGN_tsInstance sAlign;
+
+    // Frames are written to disk on their own thread so that a slow disk never holds up reception
+    bool_t bWriter;                                 // The writer thread is running, otherwise writes are done by the caller
+    INGEST_tsWrite asWrites[INGEST_WRITE_QUEUE_LENGTH]; // Oldest at u32WriteHead
+    uint32_t u32WriteHead;
+    uint32_t u32WriteCount;
+    uint64_t u64WritesDropped;                      // Frames the queue was too full to take
+#ifndef _WIN32
+    pthread_mutex_t sWriteLock;
+    pthread_cond_t sWriteReady;
+    pthread_cond_t sWriteDone;
+    bool_t bStopWrite;
+    pthread_t sWriteThread;
+#endif
+    uint32_t u32NumWorkers;
+    INGEST_tsWorker *apsWorkers[INGEST_MAX_WORKERS];
+};
+
+/****************************************************************************/
+/***        Exported Functions                                            ***/
+/****************************************************************************/
+
+bool_t INGEST_bRun(INGEST_tsConfig *psConfig);
+bool_t INGEST_bAddPort(INGEST_tsConfig *psConfig, uint16_t u16Port);
+bool_t INGEST_bAddCameraIP(INGEST_tsConfig *psConfig, char *pcIpAddress);
+bool_t INGEST_bAddGroup(INGEST_tsConfig *psConfig, char *pcGroup);
+bool_t INGEST_bSetCameraLimits(INGEST_tsConfig *psConfig, char *pcIpAddress, ORLACO_tsRegionOfInterest *psRegionOfInterest);
+void INGEST_vProcessDatagram(INGEST_tsWorker *psWorker, ORLACO_tuIP uSrcIP, uint16_t u16SrcPort, uint8_t *pu8Data, uint32_t u32Length, uint64_t u64TimeUs);
+
+#endif // INGEST_H
+
+/****************************************************************************/
+/***        END OF FILE                                                   ***/
+/****************************************************************************/
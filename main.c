@@ -28,11 +28,21 @@
 #include <getopt.h>
 #include <string.h>
 #include <errno.h>
+#include <signal.h>
 #include "common.h"
 #include "orlaco.h"
+#include "ingest.h"
+#include "histogram.h"
+#include "plan.h"
+#include "roiswitch.h"
+#include "daemon.h"
+#include "watch.h"
+#include "history.h"
 
 #ifdef _WIN32
 #include <windows.h>
+#else
+#include <poll.h>
 #endif
 
 /****************************************************************************/
@@ -65,16 +75,65 @@ typedef struct
 {
 	volatile bool_t		bExitRequest;
 	volatile bool_t		bExit;
+	volatile uint32_t	u32TriggerRequests;
 	bool_t				bDiscoverCameras;
 	bool_t				bReadRegisters;
 	bool_t				bWriteRegisters;
 	bool_t				bReadRegionsOfInterest;
 	bool_t				bWriteRegionsOfInterest;
 	bool_t				bSetCameraMode;
+	bool_t				bCapture;
+	bool_t				bCameraIP;
+	bool_t				bHistograms;
+	uint32_t			u32HistogramRoi;
+	ORLACO_tsHistogramFormat	sHistogramFormat;
+	bool_t				bRateControl;
+	uint32_t			u32MinBitrate;
+	uint32_t			u32MaxBitrate;
+	uint8_t				u8MinFrameRate;
+	uint8_t				u8MaxFrameRate;
+	RATECTL_tsInstance	sRateControl;
+	bool_t				bPlan;
+	bool_t				bPlanReject;
+	uint32_t			u32PlanCapacityMbps;
+	bool_t				bBalance;
+	char				*pcBalanceInterfaces;
+	uint16_t			u16BalancePort;
+	uint32_t			u32BalancePorts;
+	bool_t				bMulticast;
+	ORLACO_tuIP			uMulticastGroup;
+	uint16_t			u16MulticastPort;
+	bool_t				bSwitch;
+	uint8_t				au8SwitchRois[ROISWITCH_MAX_PRESETS];
+	uint32_t			u32NumSwitchRois;
+	uint32_t			u32SwitchCount;
+	uint32_t			u32SwitchLease;
+	bool_t				bStageRegisterSet;
+	uint8_t				u8StageRegisterSet;
+	uint8_t				u8ActiveRegisterSet;
+	bool_t				bUseRegisterSet;
+	uint8_t				u8UseRegisterSet;
+	uint32_t			u32LeaseTime;
+	bool_t				bWatch;
+	uint32_t			u32WatchIntervalMs;
+	uint8_t				au8WatchRegisters[ORLACO_MAX_WRITE_REGISTERS];
+	uint16_t			u16NumWatchRegisters;
+	char				*pcHistoryDirectory;
+	HISTORY_tsInstance	sHistory;
+	bool_t				bHistoryQuery;
+	ORLACO_tuIP			uHistoryCamera;
+	uint16_t			u16HistoryFirstKey;
+	uint16_t			u16HistoryLastKey;
+	uint32_t			u32HistorySeconds;
+	char				*pcDaemonSocket;
+	bool_t				bDaemonRequest;
+	char				*pcFrameRingName;
+	char				*pcFrameRingJpegPrefix;
 	teVerbosity			eVerbosity;
 	char				*pstrIpAddress;
 	int					iPort;
 	ORLACO_tsInstance	sOrlaco;
+	INGEST_tsConfig		sIngest;
 } tsInstance;
 
 /****************************************************************************/
@@ -85,10 +144,34 @@ static void vParseCommandLineOptions(tsInstance *psInstance, int argc, char *arg
 
 #ifdef _WIN32
 static BOOL WINAPI bCtrlHandler(DWORD dwCtrlType);
+#else
+static void vSignalHandler(int iSignal);
 #endif
 
+static bool_t bGetSelectedRoi(tsInstance *psInstance, uint8_t *pu8RegionOfInterest, ORLACO_tsRegionOfInterest *psRegionOfInterest);
+static void vGetStreamLimits(tsInstance *psInstance);
+static uint32_t u32GetCameraIPs(tsInstance *psInstance, ORLACO_tuIP *puIPs);
+static bool_t bStartRateControl(tsInstance *psInstance);
+static bool_t bPlanBandwidth(tsInstance *psInstance);
+static bool_t bApplyMoves(tsInstance *psInstance, PLAN_tsInstance *psPlan);
+static bool_t bReadFrameRing(tsInstance *psInstance);
+static bool_t bAcquireLeases(tsInstance *psInstance);
+#ifndef _WIN32
+static bool_t bIsDaemonCommand(int argc, char *argv[]);
+static bool_t bServeRequests(tsInstance *psInstance);
+#endif
+static bool_t bStageRegisterSet(tsInstance *psInstance);
+static bool_t bUseRegisterSet(tsInstance *psInstance);
+static bool_t bSwitchRois(tsInstance *psInstance);
+static void vPrintSwitchStats(ROISWITCH_tsInstance *psSwitch);
+static bool_t bMonitorHistograms(tsInstance *psInstance);
+static bool_t bWatchRegisters(tsInstance *psInstance);
+static bool_t bQueryHistory(tsInstance *psInstance);
+static void vPrintHistoryChange(void *pvContext, ORLACO_tuIP uIP, HISTORY_tsChange *psChange);
+static void vPrintHistogramStats(tsInstance *psInstance, double dTime, char *pcCamera, uint32_t u32RegionOfInterest, HISTOGRAM_tsStats *psStats);
 static void vPrintRegisterDefinitions(ORLACO_tsInstance *psInstance);
 static bool_t bIsPrintable(char c);
+static bool_t bGetNumber(char *pcToken, long lMin, long lMax, long *plValue);
 
 /****************************************************************************/
 /***        Exported Variables                                            ***/
@@ -100,6 +183,65 @@ static bool_t bIsPrintable(char c);
 
 static tsInstance sInstance;
 
+// Shared with the daemon, which parses requests the same way to classify them
+static const char acOptions[] = "d:w:r:R:g:G:s:i:e:m:j:n:x:t:a:P:c:S:o:O:M:E:T:U:A:CH:B:L:D:u:W:K:k:l:b:Z:f:p:y:Y:N:v:?h";
+
+static const struct option asLongOptions[] = {
+	{ "discover",		required_argument,	0, 	'd'	},
+	{ "write-reg",		required_argument,	0, 	'w'	},
+	{ "read-reg",		required_argument,	0, 	'r'	},
+	{ "read-regs",		required_argument,	0, 	'R'	},
+
+	{ "get-roi",		required_argument,	0, 	'g'	},
+	{ "get-rois",		required_argument,	0, 	'G'	},
+	{ "set-roi",		required_argument,	0, 	's'	},
+
+	{ "ip", 			required_argument,	0, 	'i'	},
+	{ "service-id",		required_argument,	0, 	'e'	},
+
+	{ "set-mode", 		required_argument,	0, 	'm'	},
+
+	{ "capture-jpeg",	required_argument,	0, 	'j'	},
+	{ "frames",			required_argument,	0, 	'n'	},
+	{ "rx-ports",		required_argument,	0, 	'x'	},
+	{ "rx-threads",		required_argument,	0, 	't'	},
+	{ "rx-affinity",	required_argument,	0, 	'a'	},
+	{ "rx-ring",		required_argument,	0, 	'P'	},
+	{ "rx-camera",		required_argument,	0, 	'c'	},
+	{ "stats",			required_argument,	0, 	'S'	},
+	{ "shm",			required_argument,	0, 	'o'	},
+	{ "shm-read",		required_argument,	0, 	'O'	},
+	{ "record",			required_argument,	0, 	'M'	},
+	{ "pre-event",		required_argument,	0, 	'E'	},
+	{ "trigger-file",	required_argument,	0, 	'T'	},
+	{ "trigger-socket",	required_argument,	0, 	'U'	},
+	{ "align",			required_argument,	0, 	'A'	},
+	{ "rtcp",			no_argument,		0, 	'C'	},
+	{ "histogram",		required_argument,	0, 	'H'	},
+	{ "rate-control",	required_argument,	0, 	'B'	},
+	{ "plan",			required_argument,	0, 	'L'	},
+	{ "balance",		required_argument,	0, 	'D'	},
+	{ "multicast",		required_argument,	0, 	'u'	},
+	{ "switch",			required_argument,	0, 	'W'	},
+	{ "stage-set",		required_argument,	0, 	'K'	},
+	{ "use-set",		required_argument,	0, 	'k'	},
+	{ "lease",			required_argument,	0, 	'l'	},
+	{ "lock-wait",		required_argument,	0, 	'b'	},
+	{ "daemon",			required_argument,	0, 	'Z'	},
+	{ "fresh",			required_argument,	0, 	'f'	},
+	{ "watch",			required_argument,	0, 	'p'	},
+	{ "history",		required_argument,	0, 	'y'	},
+	{ "history-query",	required_argument,	0, 	'Y'	},
+	{ "priority",		required_argument,	0, 	'N'	},
+
+    { "verbosity",     	required_argument, 	0,  'v' },
+
+    { "help",       	no_argument,		0,  'h' },
+    { "help",          	no_argument, 		0,  '?' },
+
+	{ NULL, 0, 0, 0 },
+};
+
 /****************************************************************************/
 /***        Exported Functions                                            ***/
 /****************************************************************************/
@@ -128,10 +270,12 @@ int main(int argc, char *argv[])
 	int n;
 
 	bool_t bOk = TRUE;
+	bool_t bLock;
 	ORLACO_tuIP auIP[10];
 	ORLACO_tsRegionOfInterest sROI;
 
 	int iNumCameras = 0;
+	int iStatus;
 
 	/* Initialise application state and set some defaults */
 	sInstance.bReadRegisters = FALSE;
@@ -148,6 +292,16 @@ int main(int argc, char *argv[])
     WSAStartup(MAKEWORD(2, 2), &wsaData);
 
 	SetConsoleCtrlHandler(bCtrlHandler, TRUE);
+#else
+	signal(SIGINT, vSignalHandler);
+	signal(SIGTERM, vSignalHandler);
+	signal(SIGUSR1, vSignalHandler);
+
+	// Hand the command to the daemon if one is running, it owns the camera socket
+	if(!bIsDaemonCommand(argc, argv) && DAEMON_bForward(DAEMON_pcGetSocketPath(), argc, argv, &sInstance.bExitRequest, &sInstance.u32TriggerRequests, &iStatus))
+	{
+		return iStatus;
+	}
 #endif
 
 
@@ -158,15 +312,81 @@ int main(int argc, char *argv[])
 	// Set the default service ID
 	sInstance.sOrlaco.u16ServiceID = 0x433f;
 
+	// Set the default stream capture options
+	memset(&sInstance.sIngest, 0, sizeof(sInstance.sIngest));
+	sInstance.sIngest.pbExit = &sInstance.bExitRequest;
+	sInstance.sIngest.pu32Trigger = &sInstance.u32TriggerRequests;
+
     /* Parse the command line options */
     vParseCommandLineOptions(&sInstance, argc, argv);
 
-	if(bOk && sInstance.bDiscoverCameras)
+#ifndef _WIN32
+	// Carry on below only in the children running requests
+	if(sInstance.pcDaemonSocket != NULL)
+	{
+		bOk = bServeRequests(&sInstance);
+		if(!sInstance.bDaemonRequest)
+		{
+			ORLACO_vDeInit(&sInstance.sOrlaco);
+			return bOk ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+	}
+#endif
+
+	// Every value read from or written to a camera from here on goes into the history
+	if(sInstance.pcHistoryDirectory != NULL)
+	{
+		bOk &= HISTORY_bOpen(&sInstance.sHistory, sInstance.pcHistoryDirectory);
+		if(bOk)
+		{
+			ORLACO_vSetObserver(&sInstance.sOrlaco, HISTORY_vObserve, &sInstance.sHistory);
+		}
+	}
+
+	if(bOk && sInstance.bHistoryQuery)
+	{
+		bOk &= bQueryHistory(&sInstance);
+	}
+
+	if(sInstance.bMulticast && sInstance.bCameraIP)
+	{
+		bOk &= ORLACO_bSetMulticastDestination(&sInstance.sOrlaco, sInstance.uMulticastGroup, sInstance.u16MulticastPort);
+		sInstance.bWriteRegisters = TRUE;
+	}
+
+	// Catch a destination that wouldn't reach anyone before anything is written
+	if(bOk && sInstance.bWriteRegisters)
+	{
+		bOk &= ORLACO_bCheckDestination(&sInstance.sOrlaco);
+	}
+
+	// Requests to the daemon are answered from its discovery table
+	if(bOk && sInstance.bDiscoverCameras && !(sInstance.bDaemonRequest && (sInstance.sOrlaco.u16NumCameras != 0)))
 	{
 		bOk &= ORLACO_bDiscover(&sInstance.sOrlaco);
 	}
 
-	if(bOk && (sInstance.bWriteRegisters || sInstance.bWriteRegionsOfInterest))
+	if(bOk && (sInstance.u32LeaseTime != 0))
+	{
+		bOk &= bAcquireLeases(&sInstance);
+	}
+
+	if(bOk && (sInstance.bPlan || sInstance.bBalance))
+	{
+		bOk &= bPlanBandwidth(&sInstance);
+	}
+
+	// The writes go into the staged register set instead of the one in use
+	if(bOk && sInstance.bStageRegisterSet)
+	{
+		bOk &= bStageRegisterSet(&sInstance);
+		sInstance.bWriteRegisters = FALSE;
+	}
+
+	// No need for the lock if the camera already holds every register value
+	bLock = (sInstance.bWriteRegisters && ORLACO_bHasChanges(&sInstance.sOrlaco)) || sInstance.bWriteRegionsOfInterest;
+
+	if(bOk && bLock)
 	{
 		bOk &= ORLACO_bSetCamExclusive(&sInstance.sOrlaco, 100);
 	}
@@ -191,11 +411,16 @@ int main(int argc, char *argv[])
 		bOk &= ORLACO_bGetRegionsOfInterest(&sInstance.sOrlaco);
 	}
 
-	if(bOk && (sInstance.bWriteRegisters || sInstance.bWriteRegionsOfInterest))
+	if(bOk && bLock)
 	{
 		bOk &= ORLACO_bEraseCamExclusive(&sInstance.sOrlaco);
 	}
 
+	if(bOk && sInstance.bUseRegisterSet)
+	{
+		bOk &= bUseRegisterSet(&sInstance);
+	}
+
 	if(bOk && sInstance.bDiscoverCameras)
 	{
 		printf("Found %d devices\n", sInstance.sOrlaco.u16NumCameras);
@@ -256,7 +481,57 @@ int main(int argc, char *argv[])
 		bOk &= ORLACO_bSetCamMode(&sInstance.sOrlaco, sInstance.sOrlaco.eCameraMode);
 	}
 
+	if(bOk && sInstance.bSwitch)
+	{
+		bOk &= bSwitchRois(&sInstance);
+	}
+
+	if(bOk && sInstance.bCapture && sInstance.bCameraIP && (sInstance.sIngest.u32StatsIntervalMs != 0))
+	{
+		vGetStreamLimits(&sInstance);
+	}
+
+	if(bOk && sInstance.bCapture && sInstance.bRateControl)
+	{
+		bOk &= bStartRateControl(&sInstance);
+	}
+
+	if(bOk && sInstance.bCapture)
+	{
+		sInstance.sIngest.eVerbosity = sInstance.sOrlaco.eVerbosity;
+		bOk &= INGEST_bRun(&sInstance.sIngest);
+	}
+
+	if(sInstance.sIngest.psRateControl != NULL)
+	{
+		RATECTL_vStop(&sInstance.sRateControl);
+		RATECTL_vDeInit(&sInstance.sRateControl);
+		sInstance.sIngest.psRateControl = NULL;
+	}
+
+	if(bOk && (sInstance.pcFrameRingName != NULL))
+	{
+		bOk &= bReadFrameRing(&sInstance);
+	}
+
+	if(bOk && sInstance.bHistograms)
+	{
+		bOk &= bMonitorHistograms(&sInstance);
+	}
+
+	if(bOk && sInstance.bWatch)
+	{
+		bOk &= bWatchRegisters(&sInstance);
+	}
+
+	// The daemon's leases outlive its requests
+	if(sInstance.bDaemonRequest)
+	{
+		sInstance.sOrlaco.u32NumLeases = 0;
+	}
+
 	ORLACO_vDeInit(&sInstance.sOrlaco);
+	HISTORY_vClose(&sInstance.sHistory);
 
 
 
@@ -278,7 +553,7 @@ int main(int argc, char *argv[])
 	WSACleanup();
 #endif
 
-	return EXIT_SUCCESS;
+	return bOk ? EXIT_SUCCESS : EXIT_FAILURE;
 }
 
 
@@ -303,35 +578,15 @@ static void vParseCommandLineOptions(tsInstance *psInstance, int argc, char *arg
 	int c;
 	char *token, *fromStr, *toStr, *ipStr, *portStr;
 	int index, value, from, to, port;
-
-	static const struct option lopts[] = {
-		{ "discover",		required_argument,	0, 	'd'	},
-		{ "write-reg",		required_argument,	0, 	'w'	},
-		{ "read-reg",		required_argument,	0, 	'r'	},
-		{ "read-regs",		required_argument,	0, 	'R'	},
-
-		{ "get-roi",		required_argument,	0, 	'g'	},
-		{ "get-rois",		required_argument,	0, 	'G'	},
-		{ "set-roi",		required_argument,	0, 	's'	},
-
-		{ "ip", 			required_argument,	0, 	'i'	},
-		{ "service-id",		required_argument,	0, 	'e'	},
-
-		{ "set-mode", 		required_argument,	0, 	'm'	},
-
-        { "verbosity",     	required_argument, 	0,  'v' },
-
-        { "help",       	no_argument,		0,  'h' },
-        { "help",          	no_argument, 		0,  '?' },
-
-		{ NULL, 0, 0, 0 },
-	};
-
+	long lValue;
+	double dValue;
+	char *pcEnd;
+	DAEMON_teClass eClass;
 
 	while(1)
 	{
 
-		c = getopt_long(argc, argv, "d:w:r:R:g:G:s:i:e:m:v:?h", lopts, NULL);
+		c = getopt_long(argc, argv, acOptions, asLongOptions, NULL);
 
 		if (c == -1)
 			break;
@@ -368,6 +623,8 @@ static void vParseCommandLineOptions(tsInstance *psInstance, int argc, char *arg
 				printf("Error: Failed to set the camera IP to %s:%d\n", ipStr, port);
 				exit(EXIT_FAILURE);
 			}
+			psInstance->pstrIpAddress = ipStr;
+			psInstance->bCameraIP = TRUE;
 			break;
 
 		case 'e':
@@ -540,133 +797,1844 @@ static void vParseCommandLineOptions(tsInstance *psInstance, int argc, char *arg
 			psInstance->bSetCameraMode = TRUE;
 			break;
 
-		case 'v':
-			switch(atoi(optarg))
+		case 'j':
+			portStr = strtok(optarg, ":");
+			psInstance->sIngest.pcJpegPrefix = strtok(NULL, ":");
+			if(psInstance->sIngest.pcJpegPrefix == NULL)
 			{
-			case -1:
-				psInstance->eVerbosity = E_VERBOSITY_ERRORS_ONLY;
-				ORLACO_vSetVerbosity(&psInstance->sOrlaco, E_ORLACO_VERBOSITY_ERRORS_ONLY);
-				break;
+				psInstance->sIngest.pcJpegPrefix = "frame";
+			}
+			if(!bGetNumber(portStr, 1, 65535, &lValue))
+			{
+				printf("Error: Capturing needs an RTP port from 1 to 65535, e.g. -j 50004\n");
+				exit(EXIT_FAILURE);
+			}
+			if(!INGEST_bAddPort(&psInstance->sIngest, (uint16_t)lValue))
+			{
+				printf("Error: Too many RTP ports\n");
+				exit(EXIT_FAILURE);
+			}
+			psInstance->bCapture = TRUE;
+			break;
 
-			case 0:
-				psInstance->eVerbosity = E_VERBOSITY_LOW;
-				ORLACO_vSetVerbosity(&psInstance->sOrlaco, E_ORLACO_VERBOSITY_ERRORS_ONLY);
-				break;
-			
-			case 1:
-				psInstance->eVerbosity = E_VERBOSITY_MEDIUM;
-				ORLACO_vSetVerbosity(&psInstance->sOrlaco, E_ORLACO_VERBOSITY_INFO);
-				break;
-			
-			case 2:
-				psInstance->eVerbosity = E_VERBOSITY_HIGH;
-				ORLACO_vSetVerbosity(&psInstance->sOrlaco, E_ORLACO_VERBOSITY_DEBUG);
-				break;
+		case 'n':
+			if(!bGetNumber(optarg, 0, 1000000000, &lValue))
+			{
+				printf("Error: Frame count must be 0 (no limit) to 1000000000, e.g. -n 100\n");
+				exit(EXIT_FAILURE);
+			}
+			psInstance->sIngest.u32MaxFrames = (uint32_t)lValue;
+			break;
 
-			default:
-				psInstance->eVerbosity = E_VERBOSITY_HIGH;
-				ORLACO_vSetVerbosity(&psInstance->sOrlaco, E_ORLACO_VERBOSITY_DEBUG);
-				break;
+		case 'x':
+			portStr = strtok(optarg, ",");
+			while(portStr != NULL)
+			{
+				port = atoi(portStr);
+				if((port <= 0) || (port > 65535))
+				{
+					printf("Error: RTP port %d is out of range\n", port);
+					exit(EXIT_FAILURE);
+				}
+				if(!INGEST_bAddPort(&psInstance->sIngest, (uint16_t)port))
+				{
+					printf("Error: Too many RTP ports\n");
+					exit(EXIT_FAILURE);
+				}
+				portStr = strtok(NULL, ",");
+			}
+			psInstance->bCapture = TRUE;
+			break;
 
+		case 't':
+			if(!bGetNumber(optarg, 1, INGEST_MAX_WORKERS, &lValue))
+			{
+				printf("Error: Number of receive threads must be 1 to %d\n", INGEST_MAX_WORKERS);
+				exit(EXIT_FAILURE);
 			}
+			psInstance->sIngest.u32NumWorkers = (uint32_t)lValue;
 			break;
 
-        case '?':
-		case 'h':
-		default:
-			printf("+----------------------------------------------------------------------+\n" \
-		   "|               OCC (Orlaco Camera Configurator)                       |\n" \
-		   "| Copyright (C) 2021 Lee Mitchell <lee@indigopepper.com>               |\n" \
-		   "|                                                                      |\n" \
-	       "| This program comes with ABSOLUTELY NO WARRANTY.                      |\n" \
-		   "| This is free software, and you are welcome to redistribute it        |\n" \
-		   "| under certain conditions; See the GNU General Public License         |\n" \
-		   "| version 3 or later for more details. You should have received a copy |\n" \
-		   "| of the GNU General Public License along with OCC (Orlaco Camera      |\n" \
-		   "| Configurator) If not, see <http://www.gnu.org/licenses/>.            |\n" \
-		   "+----------------------------------------------------------------------+\n\n");
+		case 'a':
+			psInstance->sIngest.u32NumCpus = 0;
+			token = strtok(optarg, ",");
+			while((token != NULL) && (psInstance->sIngest.u32NumCpus < INGEST_MAX_WORKERS))
+			{
+				if(!bGetNumber(token, 0, INGEST_MAX_CPUS - 1, &lValue))
+				{
+					printf("Error: CPU %s is out of range, CPUs are 0 to %d\n", token, INGEST_MAX_CPUS - 1);
+					exit(EXIT_FAILURE);
+				}
+				psInstance->sIngest.aiCpus[psInstance->sIngest.u32NumCpus++] = (int)lValue;
+				token = strtok(NULL, ",");
+			}
+			break;
 
-			if((optarg != NULL) && (strcasecmp(optarg, "regs") == 0))
+		case 'P':
+			psInstance->sIngest.bPacketRing = TRUE;
+			psInstance->sIngest.pcInterface = optarg;
+			break;
+
+		case 'c':
+			ipStr = strtok(optarg, ",");
+			while(ipStr != NULL)
 			{
-				vPrintRegisterDefinitions(&psInstance->sOrlaco);
+				if(!INGEST_bAddCameraIP(&psInstance->sIngest, ipStr))
+				{
+					printf("Error: Invalid or too many camera IPs at %s\n", ipStr);
+					exit(EXIT_FAILURE);
+				}
+				ipStr = strtok(NULL, ",");
 			}
-			else
+			break;
+
+		case 'S':
+			if(!bGetNumber(strtok(optarg, ":"), 1, 3600000, &lValue))
 			{
-				printf("\nUsage: %s <options>\n\n", argv[0]);
-				puts("  -d --discover <IP>:<Port>        Discover cameras using broadcast IP:Port(17215 default)\n\n"
-					"  -i --ip <IP>:<port>              Set the IP address and port of the camera, e.g. 192.168.2.1:17215\n\n"
-					"  -e --service-id <service-id>     Set the service id to <service-id>\n\n"
-					"  -r --read-reg  <index>           Read the value from register <index>\n\n"
-					"  -R --read-regs <from>:<to>       Read the value from register at index <from> to index <to>\n\n"
-					"  -w --write-reg <index>=<value>   Write <value> into register <index>\n\n"
-					"  -g --get-roi <index>             Read the Region Of Interest at index <index>\n\n"
-					"  -G --read-rois <from>:<to>       Read the Region Of Interest at index <from> to index <to>\n\n"
-					"  -s --set-roi <index>=<p1x>,<p1y>,<p2x>,<p2y>,<width>,<height>,<maxBitRate>,<fps>,<compression mode>\n"
-					"                                   Write region of interest at index <index>\n\n"
-					"  -v --verbosity <level>           Set verbosity level -1, 0, 1 & 2 are valid\n\n"
-					"  -q --quiet                       Enable quiet mode (no updates on console)\n\n"
-					"  -d --debug                       Enable debugging mode (extra console messages)\n\n"
-					"  -? --help                        Display help\n\n"
-					"     --help regs                   Display the list of registers available\n\n"
-					);
+				printf("Error: Statistics need an interval from 1 to 3600000ms, e.g. -S 1000\n");
+				exit(EXIT_FAILURE);
+			}
+			psInstance->sIngest.u32StatsIntervalMs = (uint32_t)lValue;
+			token = strtok(NULL, ":");
+			if((token != NULL) && (strcasecmp(token, "ndjson") == 0))
+			{
+				psInstance->sIngest.eStatsFormat = E_INGEST_STATS_FORMAT_NDJSON;
+			}
+			else if((token != NULL) && (strcasecmp(token, "table") != 0))
+			{
+				printf("Error: Unknown statistics format %s\n", token);
+				exit(EXIT_FAILURE);
 			}
+			break;
 
-			exit(EXIT_FAILURE);
+		case 'o':
+			psInstance->sIngest.pcShmPrefix = strtok(optarg, ":");
+			token = strtok(NULL, ":");
+			if(token != NULL)
+			{
+				if(!bGetNumber(token, 1, 4096, &lValue))
+				{
+					printf("Error: Shared memory rings must be 1 to 4096 MB, e.g. -o occ:32\n");
+					exit(EXIT_FAILURE);
+				}
+				psInstance->sIngest.u64ShmLength = (uint64_t)lValue * 1024 * 1024;
+			}
 			break;
-		}
 
-	}
+		case 'O':
+			psInstance->pcFrameRingName = strtok(optarg, ":");
+			psInstance->pcFrameRingJpegPrefix = strtok(NULL, ":");
+			break;
 
-}
+		case 'M':
+			psInstance->sIngest.pcMp4Prefix = strtok(optarg, ":");
+			token = strtok(NULL, ":");
+			while(token != NULL)
+			{
+				if(strcasecmp(token, "direct") == 0)
+				{
+					psInstance->sIngest.bDirectIO = TRUE;
+				}
+				else if(bGetNumber(token, 1, 86400, &lValue))
+				{
+					psInstance->sIngest.u32SegmentSeconds = (uint32_t)lValue;
+				}
+				else
+				{
+					printf("Error: Unknown recording option %s, segments are 1 to 86400 seconds\n", token);
+					exit(EXIT_FAILURE);
+				}
+				token = strtok(NULL, ":");
+			}
+			break;
 
+		case 'E':
+			psInstance->sIngest.pcPreEventPrefix = strtok(optarg, ":");
+			token = strtok(NULL, ":");
+			if(token != NULL)
+			{
+				if(!bGetNumber(token, 1, 3600, &lValue))
+				{
+					printf("Error: Pre-event recording keeps 1 to 3600 seconds, e.g. -E event:20\n");
+					exit(EXIT_FAILURE);
+				}
+				psInstance->sIngest.u32PreEventSeconds = (uint32_t)lValue;
+				token = strtok(NULL, ":");
+				if(token != NULL)
+				{
+					if(!bGetNumber(token, 1, 4096, &lValue))
+					{
+						printf("Error: Pre-event rings must be 1 to 4096 MB, e.g. -E event:20:64\n");
+						exit(EXIT_FAILURE);
+					}
+					psInstance->sIngest.u64PreEventLength = (uint64_t)lValue * 1024 * 1024;
+				}
+			}
+			break;
 
-/****************************************************************************
- *
- * NAME: bCtrlHandler
- *
- * DESCRIPTION:
- * Handles Ctrl+C events
- *
- * RETURNS:
- * BOOL
- *
- ****************************************************************************/
-#ifdef _WIN32
-static BOOL WINAPI bCtrlHandler(DWORD dwCtrlType)
-{
-    switch (dwCtrlType)
-    {
+		case 'T':
+			psInstance->sIngest.pcTriggerFile = optarg;
+			break;
 
-    case CTRL_C_EVENT:
-    case CTRL_SHUTDOWN_EVENT:
-        printf("\nExit requested\n");
-        sInstance.bExitRequest = TRUE;
-        return TRUE;
+		case 'U':
+			psInstance->sIngest.pcTriggerSocket = optarg;
+			break;
 
-    case CTRL_BREAK_EVENT:
-        printf("\nImmediate exit requested\n");
-        sInstance.bExit = TRUE;
-    	return TRUE;
+		case 'A':
+			token = strtok(optarg, ":");
+			dValue = (token != NULL) ? strtod(token, &pcEnd) : 0.0;
+			if((token == NULL) || (*pcEnd != '\0') || !(dValue > 0.0) || (dValue > 1000.0))
+			{
+				printf("Error: Alignment needs a tolerance from 0.001 to 1000ms, e.g. -A 2\n");
+				exit(EXIT_FAILURE);
+			}
+			psInstance->sIngest.u32AlignToleranceUs = (uint32_t)(dValue * 1000.0);
+			psInstance->sIngest.pcAlignPrefix = strtok(NULL, ":");
+			psInstance->sIngest.bAlign = TRUE;
+			psInstance->sIngest.bRtcp = TRUE;
+			break;
 
-    default:
-        return FALSE;
-    }
-}
-#endif
+		case 'C':
+			psInstance->sIngest.bRtcp = TRUE;
+			break;
 
-/****************************************************************************
- *
- * NAME: vPrintRegisterDefinitions
- *
- * DESCRIPTION:
- * Prints out a list of the registers in the Orlaco Emos camera
- *
- * RETURNS:
- * void
- *
- ****************************************************************************/
-static void vPrintRegisterDefinitions(ORLACO_tsInstance *psInstance)
-{
+		case 'H':
+			if(!bGetNumber(strtok(optarg, ":"), 0, psInstance->sOrlaco.u16NumRegionsOfInterest - 1, &lValue))
+			{
+				printf("Error: Histograms need an ROI from 0 to %d, e.g. -H 1\n", psInstance->sOrlaco.u16NumRegionsOfInterest - 1);
+				exit(EXIT_FAILURE);
+			}
+			psInstance->u32HistogramRoi = (uint32_t)lValue;
+			psInstance->sHistogramFormat.u16NumBins = HISTOGRAM_DEFAULT_BINS;
+			psInstance->sHistogramFormat.u8Channel = 0;
+			psInstance->sHistogramFormat.u8Interval = 1;
+			token = strtok(NULL, ":");
+			if(token != NULL)
+			{
+				if(!bGetNumber(token, 1, ORLACO_HISTOGRAM_MAX_BINS, &lValue))
+				{
+					printf("Error: Histograms need 1 to %d bins\n", ORLACO_HISTOGRAM_MAX_BINS);
+					exit(EXIT_FAILURE);
+				}
+				psInstance->sHistogramFormat.u16NumBins = (uint16_t)lValue;
+				token = strtok(NULL, ":");
+				if(token != NULL)
+				{
+					if(!bGetNumber(token, 1, 255, &lValue))
+					{
+						printf("Error: Histograms need an interval from 1 to 255 frames\n");
+						exit(EXIT_FAILURE);
+					}
+					psInstance->sHistogramFormat.u8Interval = (uint8_t)lValue;
+				}
+			}
+			psInstance->bHistograms = TRUE;
+			break;
+
+		case 'B':
+			if(!bGetNumber(strtok(optarg, ":"), 1, 1000, &lValue))
+			{
+				printf("Error: Rate control needs a minimum and maximum bitrate, e.g. -B 2:10\n");
+				exit(EXIT_FAILURE);
+			}
+			psInstance->u32MinBitrate = (uint32_t)lValue;
+			if(!bGetNumber(strtok(NULL, ":"), psInstance->u32MinBitrate, 1000, &lValue))
+			{
+				printf("Error: Rate control needs a minimum and maximum bitrate, e.g. -B 2:10\n");
+				exit(EXIT_FAILURE);
+			}
+			psInstance->u32MaxBitrate = (uint32_t)lValue;
+			token = strtok(NULL, ":");
+			if(token != NULL)
+			{
+				if(!bGetNumber(token, 0, 255, &lValue))
+				{
+					printf("Error: Frame rates must be 0 to 255 fps\n");
+					exit(EXIT_FAILURE);
+				}
+				psInstance->u8MinFrameRate = (uint8_t)lValue;
+				token = strtok(NULL, ":");
+				if(token != NULL)
+				{
+					if(!bGetNumber(token, 0, 255, &lValue))
+					{
+						printf("Error: Frame rates must be 0 to 255 fps\n");
+						exit(EXIT_FAILURE);
+					}
+					psInstance->u8MaxFrameRate = (uint8_t)lValue;
+				}
+			}
+			psInstance->bRateControl = TRUE;
+			break;
+
+		case 'L':
+			token = strtok(optarg, ":");
+			if((token != NULL) && (strcmp(token, "auto") != 0))
+			{
+				if(!bGetNumber(token, 1, 1000000, &lValue))
+				{
+					printf("Error: Link capacity must be given as 1 to 1000000 Mbps or as auto, e.g. -L 1000\n");
+					exit(EXIT_FAILURE);
+				}
+				psInstance->u32PlanCapacityMbps = (uint32_t)lValue;
+			}
+			token = strtok(NULL, ":");
+			psInstance->bPlanReject = ((token != NULL) && (strcmp(token, "reject") == 0));
+			psInstance->bPlan = TRUE;
+			break;
+
+		case 'D':
+			psInstance->pcBalanceInterfaces = strtok(optarg, ":");
+			portStr = strtok(NULL, ":");
+			token = strtok(NULL, ":");
+			if((psInstance->pcBalanceInterfaces == NULL) ||
+			   ((portStr != NULL) && !bGetNumber(portStr, 1, 65535, &lValue)) ||
+			   ((token != NULL) && !bGetNumber(token, 0, PLAN_MAX_PORTS, &lValue)))
+			{
+				printf("Error: Balancing needs interfaces, a base port and up to %d ports each, e.g. -D eth0,eth1:50004:4\n", PLAN_MAX_PORTS);
+				exit(EXIT_FAILURE);
+			}
+			// Both have been checked to be in range
+			psInstance->u16BalancePort = (portStr != NULL) ? (uint16_t)atoi(portStr) : 50004;
+			psInstance->u32BalancePorts = (token != NULL) ? (uint32_t)atoi(token) : 0;
+			psInstance->bBalance = TRUE;
+			break;
+
+		case 'u':
+			token = strtok(optarg, ":");
+			if((token == NULL) || !INGEST_bAddGroup(&psInstance->sIngest, token))
+			{
+				printf("Error: %s isn't a multicast group, or there are too many\n", (token != NULL) ? token : optarg);
+				exit(EXIT_FAILURE);
+			}
+			psInstance->uMulticastGroup = psInstance->sIngest.auGroups[psInstance->sIngest.u32NumGroups - 1];
+			token = strtok(NULL, ":");
+			lValue = 0;
+			if((token != NULL) && !bGetNumber(token, 1, 65535, &lValue))
+			{
+				printf("Error: Multicast port %s is out of range\n", token);
+				exit(EXIT_FAILURE);
+			}
+			psInstance->u16MulticastPort = (uint16_t)lValue;
+			token = strtok(NULL, ":");
+			if(token != NULL)
+			{
+				if(inet_addr(token) == INADDR_NONE)
+				{
+					printf("Error: Invalid interface address %s\n", token);
+					exit(EXIT_FAILURE);
+				}
+				psInstance->sIngest.uGroupInterface.u32IP = ntohl(inet_addr(token));
+			}
+			psInstance->bMulticast = TRUE;
+			break;
+
+		case 'W':
+			psInstance->u32NumSwitchRois = 0;
+			fromStr = strtok(optarg, ":");
+			token = strtok(NULL, ":");
+			lValue = 0;
+			if((token != NULL) && !bGetNumber(token, 0, 1000000, &lValue))
+			{
+				printf("Error: Switch count %s is out of range, max is 1000000\n", token);
+				exit(EXIT_FAILURE);
+			}
+			psInstance->u32SwitchCount = (uint32_t)lValue;
+			token = strtok(NULL, ":");
+			lValue = 0;
+			if((token != NULL) && !bGetNumber(token, 0, 86400, &lValue))
+			{
+				printf("Error: Switch lease %s is out of range, max is 86400 seconds\n", token);
+				exit(EXIT_FAILURE);
+			}
+			psInstance->u32SwitchLease = (uint32_t)lValue;
+			for(token = strtok(fromStr, ","); token != NULL; token = strtok(NULL, ","))
+			{
+				if(psInstance->u32NumSwitchRois == ROISWITCH_MAX_PRESETS)
+				{
+					printf("Error: Up to %d ROIs can be switched between\n", ROISWITCH_MAX_PRESETS);
+					exit(EXIT_FAILURE);
+				}
+				if(!bGetNumber(token, 1, psInstance->sOrlaco.u16NumRegionsOfInterest - 1, &lValue))
+				{
+					printf("Error: ROI %s is out of range, max is %d\n", token, psInstance->sOrlaco.u16NumRegionsOfInterest - 1);
+					exit(EXIT_FAILURE);
+				}
+				psInstance->au8SwitchRois[psInstance->u32NumSwitchRois++] = (uint8_t)lValue;
+			}
+			psInstance->bSwitch = TRUE;
+			break;
+
+		case 'K':
+			token = strtok(optarg, ":");
+			toStr = strtok(NULL, ":");
+			if(!bGetNumber(token, 0, 255, &lValue) || ((toStr != NULL) && !bGetNumber(toStr, 0, 255, &lValue)))
+			{
+				printf("Error: Register sets must be 0 to 255, e.g. -K 1:0\n");
+				exit(EXIT_FAILURE);
+			}
+			// Both have been checked to be in range
+			psInstance->u8StageRegisterSet = (uint8_t)atoi(token);
+			psInstance->u8ActiveRegisterSet = (toStr != NULL) ? (uint8_t)atoi(toStr) : 0;
+			if(psInstance->u8StageRegisterSet == psInstance->u8ActiveRegisterSet)
+			{
+				printf("Error: The staged register set must differ from the active one, e.g. -K 1:0\n");
+				exit(EXIT_FAILURE);
+			}
+			psInstance->bStageRegisterSet = TRUE;
+			break;
+
+		case 'p':
+			if(!bGetNumber(strtok(optarg, ":"), 1, 3600000, &lValue))
+			{
+				printf("Error: Watching needs an interval from 1 to 3600000ms, e.g. -p 5000\n");
+				exit(EXIT_FAILURE);
+			}
+			psInstance->u32WatchIntervalMs = (uint32_t)lValue;
+			for(token = strtok(strtok(NULL, ":"), ","); token != NULL; token = strtok(NULL, ","))
+			{
+				if(!bGetNumber(token, 0, psInstance->sOrlaco.u16NumRegisters - 1, &lValue))
+				{
+					printf("Error: Register index %s is out of range, max is %d\n", token, psInstance->sOrlaco.u16NumRegisters - 1);
+					exit(EXIT_FAILURE);
+				}
+				index = (int)lValue;
+				if(psInstance->u16NumWatchRegisters == ORLACO_MAX_WRITE_REGISTERS)
+				{
+					printf("Error: Up to %d registers can be watched\n", ORLACO_MAX_WRITE_REGISTERS);
+					exit(EXIT_FAILURE);
+				}
+				psInstance->au8WatchRegisters[psInstance->u16NumWatchRegisters++] = index;
+			}
+			if(psInstance->u16NumWatchRegisters == 0)
+			{
+				psInstance->au8WatchRegisters[psInstance->u16NumWatchRegisters++] = E_ORLACO_REGISTER_INDEX_LED_MODE;
+				psInstance->au8WatchRegisters[psInstance->u16NumWatchRegisters++] = E_ORLACO_REGISTER_INDEX_STREAM_PROTOCOL;
+				psInstance->au8WatchRegisters[psInstance->u16NumWatchRegisters++] = E_ORLACO_REGISTER_INDEX_SELECTED_ROI;
+				psInstance->au8WatchRegisters[psInstance->u16NumWatchRegisters++] = E_ORLACO_REGISTER_INDEX_DHCP;
+			}
+			psInstance->bWatch = TRUE;
+			break;
+
+		case 'y':
+			psInstance->pcHistoryDirectory = optarg;
+			break;
+
+		case 'Y':
+			ipStr = strtok(optarg, ":");
+			if((ipStr == NULL) || (inet_addr(ipStr) == INADDR_NONE))
+			{
+				printf("Error: History needs a camera IP, e.g. -Y 192.168.2.10\n");
+				exit(EXIT_FAILURE);
+			}
+			psInstance->uHistoryCamera.u32IP = ntohl(inet_addr(ipStr));
+			psInstance->u16HistoryFirstKey = 0;
+			psInstance->u16HistoryLastKey = 0xffff;
+			token = strtok(NULL, ":");
+			if((token != NULL) && (strncasecmp(token, "roi", 3) == 0))
+			{
+				if(!bGetNumber(&token[3], 1, psInstance->sOrlaco.u16NumRegionsOfInterest - 1, &lValue))
+				{
+					printf("Error: ROI %s is out of range, max is %d\n", &token[3], psInstance->sOrlaco.u16NumRegionsOfInterest - 1);
+					exit(EXIT_FAILURE);
+				}
+				index = (int)lValue;
+				psInstance->u16HistoryFirstKey = ORLACO_ROI_KEY(index, 0);
+				psInstance->u16HistoryLastKey = ORLACO_ROI_KEY(index, E_ORLACO_ROI_NUM_FIELDS - 1);
+			}
+			else if((token != NULL) && (strcasecmp(token, "all") != 0))
+			{
+				if(!bGetNumber(token, 0, psInstance->sOrlaco.u16NumRegisters - 1, &lValue))
+				{
+					printf("Error: Register index %s is out of range, max is %d\n", token, psInstance->sOrlaco.u16NumRegisters - 1);
+					exit(EXIT_FAILURE);
+				}
+				index = (int)lValue;
+				psInstance->u16HistoryFirstKey = psInstance->sOrlaco.psRegisters[index].u16Address;
+				psInstance->u16HistoryLastKey = psInstance->sOrlaco.psRegisters[index].u16Address;
+			}
+			token = strtok(NULL, ":");
+			lValue = 0;
+			if((token != NULL) && !bGetNumber(token, 0, 315360000, &lValue))
+			{
+				printf("Error: History period %s is out of range, max is 315360000 seconds\n", token);
+				exit(EXIT_FAILURE);
+			}
+			psInstance->u32HistorySeconds = (uint32_t)lValue;
+			psInstance->bHistoryQuery = TRUE;
+			break;
+
+		case 'N':
+			// Only the daemon takes any notice of it
+			if(!DAEMON_bGetClass(optarg, &eClass))
+			{
+				printf("Error: Unknown priority %s, use interactive, control or bulk\n", optarg);
+				exit(EXIT_FAILURE);
+			}
+			break;
+
+		case 'k':
+			if(!bGetNumber(optarg, 0, 255, &lValue))
+			{
+				printf("Error: Register sets must be 0 to 255, e.g. -k 1\n");
+				exit(EXIT_FAILURE);
+			}
+			psInstance->u8UseRegisterSet = (uint8_t)lValue;
+			psInstance->bUseRegisterSet = TRUE;
+			break;
+
+		case 'l':
+			if(!bGetNumber(optarg, 1, 86400, &lValue))
+			{
+				printf("Error: The lease needs a length of 1 to 86400 seconds, e.g. -l 30\n");
+				exit(EXIT_FAILURE);
+			}
+			psInstance->u32LeaseTime = (uint32_t)lValue;
+			break;
+
+		case 'b':
+			if(!bGetNumber(optarg, 0, 3600000, &lValue))
+			{
+				printf("Error: The lock wait must be 0 to 3600000ms, e.g. -b 5000\n");
+				exit(EXIT_FAILURE);
+			}
+			psInstance->sOrlaco.u32LockWaitMs = (uint32_t)lValue;
+			break;
+
+		case 'Z':
+			psInstance->pcDaemonSocket = optarg;
+			break;
+
+		case 'f':
+			if(!bGetNumber(optarg, 0, 3600000, &lValue))
+			{
+				printf("Error: Freshness must be 0 to 3600000ms, e.g. -f 10000\n");
+				exit(EXIT_FAILURE);
+			}
+			psInstance->sOrlaco.u32FreshnessMs = (uint32_t)lValue;
+			break;
+
+		case 'v':
+			switch(atoi(optarg))
+			{
+			case -1:
+				psInstance->eVerbosity = E_VERBOSITY_ERRORS_ONLY;
+				ORLACO_vSetVerbosity(&psInstance->sOrlaco, E_ORLACO_VERBOSITY_ERRORS_ONLY);
+				break;
+
+			case 0:
+				psInstance->eVerbosity = E_VERBOSITY_LOW;
+				ORLACO_vSetVerbosity(&psInstance->sOrlaco, E_ORLACO_VERBOSITY_ERRORS_ONLY);
+				break;
+			
+			case 1:
+				psInstance->eVerbosity = E_VERBOSITY_MEDIUM;
+				ORLACO_vSetVerbosity(&psInstance->sOrlaco, E_ORLACO_VERBOSITY_INFO);
+				break;
+			
+			case 2:
+				psInstance->eVerbosity = E_VERBOSITY_HIGH;
+				ORLACO_vSetVerbosity(&psInstance->sOrlaco, E_ORLACO_VERBOSITY_DEBUG);
+				break;
+
+			default:
+				psInstance->eVerbosity = E_VERBOSITY_HIGH;
+				ORLACO_vSetVerbosity(&psInstance->sOrlaco, E_ORLACO_VERBOSITY_DEBUG);
+				break;
+
+			}
+			break;
+
+        case '?':
+		case 'h':
+		default:
+			printf("+----------------------------------------------------------------------+\n" \
+		   "|               OCC (Orlaco Camera Configurator)                       |\n" \
+		   "| Copyright (C) 2021 Lee Mitchell <lee@indigopepper.com>               |\n" \
+		   "|                                                                      |\n" \
+	       "| This program comes with ABSOLUTELY NO WARRANTY.                      |\n" \
+		   "| This is free software, and you are welcome to redistribute it        |\n" \
+		   "| under certain conditions; See the GNU General Public License         |\n" \
+		   "| version 3 or later for more details. You should have received a copy |\n" \
+		   "| of the GNU General Public License along with OCC (Orlaco Camera      |\n" \
+		   "| Configurator) If not, see <http://www.gnu.org/licenses/>.            |\n" \
+		   "+----------------------------------------------------------------------+\n\n");
+
+			if((optarg != NULL) && (strcasecmp(optarg, "regs") == 0))
+			{
+				vPrintRegisterDefinitions(&psInstance->sOrlaco);
+			}
+			else
+			{
+				printf("\nUsage: %s <options>\n\n", argv[0]);
+				puts("  -d --discover <IP>:<Port>        Discover cameras using broadcast IP:Port(17215 default)\n\n"
+					"  -i --ip <IP>:<port>              Set the IP address and port of the camera, e.g. 192.168.2.1:17215\n\n"
+					"  -e --service-id <service-id>     Set the service id to <service-id>\n\n"
+					"  -r --read-reg  <index>           Read the value from register <index>\n\n"
+					"  -R --read-regs <from>:<to>       Read the value from register at index <from> to index <to>\n\n"
+					"  -w --write-reg <index>=<value>   Write <value> into register <index>\n\n"
+					"  -g --get-roi <index>             Read the Region Of Interest at index <index>\n\n"
+					"  -G --read-rois <from>:<to>       Read the Region Of Interest at index <from> to index <to>\n\n"
+					"  -s --set-roi <index>=<p1x>,<p1y>,<p2x>,<p2y>,<width>,<height>,<maxBitRate>,<fps>,<compression mode>\n"
+					"                                   Write region of interest at index <index>\n\n"
+					"  -j --capture-jpeg <port>:<prefix> Receive RTP/JPEG streams on UDP <port> and write each\n"
+					"                                   frame to <prefix>_<ip>_<ssrc>_<number>.jpg\n\n"
+					"  -n --frames <count>              Stop capturing after <count> frames\n\n"
+					"  -x --rx-ports <port>[,<port>...] Receive RTP streams on additional UDP ports\n\n"
+					"  -t --rx-threads <count>          Spread the received streams over <count> threads\n\n"
+					"  -a --rx-affinity <cpu>[,<cpu>...] Pin the receive threads to these CPUs\n\n"
+					"  -P --rx-ring <interface>         Capture from a memory mapped packet ring on <interface>\n"
+					"                                   (or any) instead of UDP sockets, Linux only, needs CAP_NET_RAW\n\n"
+					"  -c --rx-camera <ip>[,<ip>...]    Only accept streams from these cameras\n\n"
+					"  -S --stats <ms>[:table|ndjson]   Print stream statistics every <ms> milliseconds. With -i\n"
+					"                                   they are compared against the camera's selected ROI\n\n"
+					"  -o --shm <prefix>[:<MB>]         Publish received frames to shared memory rings named\n"
+					"                                   <prefix>-<camera ip>, <MB> of frame data each (32 default)\n\n"
+					"  -O --shm-read <name>[:<prefix>]  Read frames from shared memory ring <name>, writing\n"
+					"                                   JPEG frames to <prefix>_<ip>_<ssrc>_<number>.jpg if given\n\n"
+					"  -M --record <prefix>[:<s>][:direct] Record H.264 streams to fragmented MP4 segments of\n"
+					"                                   about <s> seconds (60 default) named\n"
+					"                                   <prefix>_<ip>_<ssrc>_<number>.mp4, each with a key frame\n"
+					"                                   index <...>.idx, optionally written with O_DIRECT\n\n"
+					"  -E --pre-event <prefix>[:<s>[:<MB>]] Keep the last <s> seconds (30 default) of each camera\n"
+					"                                   given with -c in <MB> of memory (32 default) and write\n"
+					"                                   them to <prefix>-<date>-<time>_<ip>_<ssrc>_... when\n"
+					"                                   triggered by SIGUSR1, -T or -U\n\n"
+					"  -T --trigger-file <path>         Trigger a pre-event dump when <path> is touched\n\n"
+					"  -U --trigger-socket <path>       Trigger a pre-event dump when \"dump\" is sent to Unix\n"
+					"                                   datagram socket <path>\n\n"
+					"  -A --align <ms>[:<prefix>]       Group frames from the cameras given with -c taken within\n"
+					"                                   <ms> of each other, by their RTP timestamps and RTCP sender\n"
+					"                                   reports on the port above each RTP port. Prints each set as\n"
+					"                                   JSON and writes its JPEG frames to\n"
+					"                                   <prefix>_<ip>_<ssrc>_<set>.jpg if given\n\n"
+					"  -C --rtcp                        Send RTCP receiver reports with loss and jitter to each\n"
+					"                                   camera and show the round trip time of those that answer\n"
+					"                                   with an extended report\n\n"
+					"  -H --histogram <roi>[:<bins>[:<frames>]] Subscribe to the luma histogram of ROI <roi>\n"
+					"                                   with <bins> bins (64 default) every <frames> frames (1\n"
+					"                                   default) from the cameras given with -i and -c, and print\n"
+					"                                   exposure statistics over the last 25 at the -S interval\n\n"
+					"  -B --rate-control <min>:<max>[:<min fps>[:<max fps>]] While capturing, lower the bitrate\n"
+					"                                   and then the frame rate of the ROI each camera given with\n"
+					"                                   -i and -c streams when its streams see loss or jitter, and\n"
+					"                                   raise them again once they're clear, keeping within\n"
+					"                                   <min> to <max> Mbps and <min fps> to <max fps> (the\n"
+					"                                   configured frame rate, unchanged, by default)\n\n"
+					"  -L --plan <Mbps>|auto[:reject]   Before any writes, add up the worst case bitrate the\n"
+					"                                   cameras given with -i and -c would send to each local\n"
+					"                                   interface and destination, with the writes to the -i\n"
+					"                                   camera applied, against links of <Mbps> or their link\n"
+					"                                   speed. Warn if a link is oversubscribed, or with reject\n"
+					"                                   don't apply the writes\n\n"
+					"  -D --balance <if>[,<if>...][:<port>[:<ports>]] Give the cameras given with -i and -c\n"
+					"                                   destinations spread over interfaces <if> and, on each,\n"
+					"                                   <ports> ports (one per receive queue by default) every\n"
+					"                                   other port from <port> (50004 default), largest streams\n"
+					"                                   first, and write them to all the cameras at once\n\n"
+					"  -u --multicast <group>[:<port>[:<address>]] Join multicast group <group> on the\n"
+					"                                   interface with <address> when capturing, and set the\n"
+					"                                   camera given with -i to stream to it, and to <port>\n\n"
+					"  -W --switch <roi>[,<roi>...][:<count>[:<lease>]] Hold the exclusive lock on the camera\n"
+					"                                   given with -i, renewing it every third of <lease> seconds\n"
+					"                                   (10 default), and switch it between ROIs <roi> as fast as\n"
+					"                                   possible, reading which from stdin, or cycling through them\n"
+					"                                   <count> times, then print the switch latency percentiles\n\n"
+					"  -K --stage-set <set>[:<active>]  Write the registers given with -w into register set\n"
+					"                                   <set> of the cameras given with -i and -c, then put\n"
+					"                                   register set <active> (0 default) back in use\n\n"
+					"  -k --use-set <set>               Switch the cameras given with -i and -c over to register\n"
+					"                                   set <set>, with one request each\n\n"
+					"  -l --lease <seconds>             Take the exclusive lock on the cameras given with -i and\n"
+					"                                   -c once for the whole run, renewing it half way through\n"
+					"                                   each <seconds>, instead of around each write, and release\n"
+					"                                   it on exit\n\n"
+					"  -b --lock-wait <ms>              Keep trying for up to <ms> (5000 default, 0 not to) for\n"
+					"                                   cameras locked by another client, backing off with jitter,\n"
+					"                                   while the other cameras go ahead\n\n"
+					"  -Z --daemon <path>               Stay running and serve the commands of other occ\n"
+					"                                   instances from Unix socket <path>, sharing the camera\n"
+					"                                   socket, discovery table (-d) and leases (-l). Only those\n"
+					"                                   run by the same user with $" DAEMON_SOCKET_VARIABLE " set to <path> use\n"
+					"                                   it. \"" DAEMON_DEFAULT_SOCKET "\" is " DAEMON_SOCKET_NAME " in $XDG_RUNTIME_DIR, or in\n"
+					"                                   /tmp/occ-<uid> (mode 0700) if that isn't set\n\n"
+					"  -f --fresh <ms>                  Answer reads from register values read or written within\n"
+					"                                   the last <ms> (10000 default, 0 not to), and leave those\n"
+					"                                   already holding their value out of writes\n\n"
+					"  -p --watch <ms>[:<index>[,<index>...]] Read the registers at <index> (LED mode, stream\n"
+					"                                   protocol, selected ROI and DHCP default) of the cameras\n"
+					"                                   given with -i and -c every <ms>, spread over the interval,\n"
+					"                                   and print those that change as NDJSON until Ctrl+C\n\n"
+					"  -y --history <dir>               Record every register and ROI value read from or written\n"
+					"                                   to a camera that differs from the last one recorded, in\n"
+					"                                   memory mapped segment files <dir>/<camera ip>/<ms>.seg\n\n"
+					"  -Y --history-query <ip>[:<index>|roi<roi>|all[:<s>]] Print the changes recorded in the\n"
+					"                                   -y history to register <index>, the fields of ROI <roi>, or\n"
+					"                                   everything (default) of camera <ip> in the last <s> seconds\n"
+					"                                   (all of them default) as NDJSON\n\n"
+					"  -N --priority <class>            Have the daemon run the command as interactive (default),\n"
+					"                                   control or bulk. Interactive commands go ahead of control\n"
+					"                                   ones and both ahead of bulk ones, which take turns by\n"
+					"                                   camera. A bulk command is for the one camera given with -i,\n"
+					"                                   send one per camera. Bulk commands are held back while their\n"
+					"                                   camera has 2 queued, or the queue is nearly full, until\n"
+					"                                   there's room\n\n"
+					"  -v --verbosity <level>           Set verbosity level -1, 0, 1 & 2 are valid\n\n"
+					"  -q --quiet                       Enable quiet mode (no updates on console)\n\n"
+					"  -d --debug                       Enable debugging mode (extra console messages)\n\n"
+					"  -? --help                        Display help\n\n"
+					"     --help regs                   Display the list of registers available\n\n"
+					);
+			}
+
+			exit(EXIT_FAILURE);
+			break;
+		}
+
+	}
+
+}
+
+
+/****************************************************************************
+ *
+ * NAME: bCtrlHandler
+ *
+ * DESCRIPTION:
+ * Handles Ctrl+C events
+ *
+ * RETURNS:
+ * BOOL
+ *
+ ****************************************************************************/
+#ifdef _WIN32
+static BOOL WINAPI bCtrlHandler(DWORD dwCtrlType)
+{
+    switch (dwCtrlType)
+    {
+
+    case CTRL_C_EVENT:
+    case CTRL_SHUTDOWN_EVENT:
+        printf("\nExit requested\n");
+        sInstance.bExitRequest = TRUE;
+        return TRUE;
+
+    case CTRL_BREAK_EVENT:
+        printf("\nImmediate exit requested\n");
+        sInstance.bExit = TRUE;
+    	return TRUE;
+
+    default:
+        return FALSE;
+    }
+}
+#endif
+
+/****************************************************************************
+ *
+ * NAME: vSignalHandler
+ *
+ * DESCRIPTION:
+ * Handles SIGINT and SIGTERM by requesting an orderly exit, and SIGUSR1
+ * by requesting a pre-event dump
+ *
+ * RETURNS:
+ * void
+ *
+ ****************************************************************************/
+#ifndef _WIN32
+static void vSignalHandler(int iSignal)
+{
+	if(iSignal == SIGUSR1)
+	{
+		sInstance.u32TriggerRequests++;
+		return;
+	}
+	sInstance.bExitRequest = TRUE;
+}
+#endif
+
+/****************************************************************************
+ *
+ * NAME: bGetSelectedRoi
+ *
+ * DESCRIPTION:
+ * Reads which ROI the camera at the unicast address is streaming and how
+ * that ROI is configured
+ *
+ * RETURNS:
+ * bool_t TRUE if successful, FALSE otherwise
+ *
+ ****************************************************************************/
+static bool_t bGetSelectedRoi(tsInstance *psInstance, uint8_t *pu8RegionOfInterest, ORLACO_tsRegionOfInterest *psRegionOfInterest)
+{
+	ORLACO_tsRegisterValue *psSelectedRoi;
+
+	psSelectedRoi = ORLACO_psGetRegister(&psInstance->sOrlaco, E_ORLACO_REGISTER_ADDRESS_SELECTED_ROI);
+	if(psSelectedRoi == NULL)
+	{
+		return FALSE;
+	}
+	psSelectedRoi->bRead = TRUE;
+
+	if(!ORLACO_bGetRegisters(&psInstance->sOrlaco) ||
+	   !ORLACO_bGetRegionOfInterest(&psInstance->sOrlaco, psSelectedRoi->u8Value, psRegionOfInterest))
+	{
+		return FALSE;
+	}
+
+	*pu8RegionOfInterest = psSelectedRoi->u8Value;
+
+	return TRUE;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: vGetStreamLimits
+ *
+ * DESCRIPTION:
+ * Reads which ROI the camera is streaming and what that ROI is configured
+ * to send, so the stream statistics can be compared against it
+ *
+ * RETURNS:
+ * void
+ *
+ ****************************************************************************/
+static void vGetStreamLimits(tsInstance *psInstance)
+{
+	ORLACO_tsRegionOfInterest sROI;
+	uint8_t u8SelectedRoi;
+
+	if(!bGetSelectedRoi(psInstance, &u8SelectedRoi, &sROI))
+	{
+		printf("Warning: Couldn't read the selected ROI, statistics won't be compared against it\n");
+		return;
+	}
+
+	if(psInstance->eVerbosity >= E_VERBOSITY_MEDIUM) printf("Camera %s is streaming ROI %d at up to %dMbps and %dfps\n", psInstance->pstrIpAddress, u8SelectedRoi, sROI.u32MaxBitrate, sROI.u8FrameRate);
+
+	INGEST_bSetCameraLimits(&psInstance->sIngest, psInstance->pstrIpAddress, &sROI);
+}
+
+
+/****************************************************************************
+ *
+ * NAME: bReadFrameRing
+ *
+ * DESCRIPTION:
+ * Consumes frames from a shared memory ring published by another occ
+ * instance until an exit is requested or the frame limit is reached
+ *
+ * RETURNS:
+ * bool_t TRUE if successful, FALSE otherwise
+ *
+ ****************************************************************************/
+static bool_t bReadFrameRing(tsInstance *psInstance)
+{
+	SHMRING_tsInstance sRing;
+	RTP_tsFrame sFrame;
+	uint32_t u32NumFrames = 0;
+	uint64_t u64NumTorn = 0;
+
+	// The ring only appears once the producer receives the camera's stream
+	while(!SHMRING_bAttach(&sRing, psInstance->pcFrameRingName))
+	{
+		if(psInstance->bExitRequest)
+		{
+			return FALSE;
+		}
+		if((u64NumTorn++ == 0) && (psInstance->eVerbosity >= E_VERBOSITY_MEDIUM)) printf("Waiting for frame ring %s\n", psInstance->pcFrameRingName);
+#ifdef _WIN32
+		return FALSE;
+#else
+		usleep(100000);
+#endif
+	}
+	u64NumTorn = 0;
+
+	while(!psInstance->bExitRequest && ((psInstance->sIngest.u32MaxFrames == 0) || (u32NumFrames < psInstance->sIngest.u32MaxFrames)))
+	{
+		if(!SHMRING_bNext(&sRing, 100, &sFrame))
+		{
+			continue;
+		}
+
+		if(psInstance->eVerbosity >= E_VERBOSITY_HIGH) printf("Frame %u from %d.%d.%d.%d SSRC=%08x TS=%u %ux%u %u bytes\n",
+															   u32NumFrames,
+															   sFrame.uSrcIP.au8IP[3],
+															   sFrame.uSrcIP.au8IP[2],
+															   sFrame.uSrcIP.au8IP[1],
+															   sFrame.uSrcIP.au8IP[0],
+															   sFrame.u32Ssrc,
+															   sFrame.u32Timestamp,
+															   sFrame.u16Width,
+															   sFrame.u16Height,
+															   sFrame.u32Length);
+
+		if((psInstance->pcFrameRingJpegPrefix != NULL) && (sFrame.eCodec == E_RTP_CODEC_JPEG))
+		{
+			MJPEG_bWriteFrameToFile(&sFrame, psInstance->pcFrameRingJpegPrefix, u32NumFrames);
+		}
+
+		// The frame was used in place, make sure the producer didn't lap us while we did
+		if(!SHMRING_bIsValid(&sRing))
+		{
+			u64NumTorn++;
+		}
+
+		u32NumFrames++;
+	}
+
+	if(psInstance->eVerbosity >= E_VERBOSITY_MEDIUM) printf("Read %u frames from %s, %llu overwritten before being read, %llu overwritten while being used\n",
+															 u32NumFrames,
+															 sRing.acName,
+															 (unsigned long long)sRing.u64Overruns,
+															 (unsigned long long)u64NumTorn);
+
+	SHMRING_vClose(&sRing, FALSE);
+
+	return TRUE;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: u32GetCameraIPs
+ *
+ * DESCRIPTION:
+ * Lists the camera given with -i followed by those given with -c
+ *
+ * RETURNS:
+ * uint32_t The number of cameras, up to INGEST_MAX_CAMERA_IPS + 1
+ *
+ ****************************************************************************/
+static uint32_t u32GetCameraIPs(tsInstance *psInstance, ORLACO_tuIP *puIPs)
+{
+	uint32_t u32NumIPs = 0;
+	uint32_t n;
+
+	if(psInstance->bCameraIP)
+	{
+		puIPs[u32NumIPs++].u32IP = ntohl(psInstance->sOrlaco.fdUnicast.sin_addr.s_addr);
+	}
+	for(n = 0; n < psInstance->sIngest.u32NumCameraIPs; n++)
+	{
+		if((u32NumIPs == 0) || (psInstance->sIngest.auCameraIPs[n].u32IP != puIPs[0].u32IP))
+		{
+			puIPs[u32NumIPs++] = psInstance->sIngest.auCameraIPs[n];
+		}
+	}
+
+	return u32NumIPs;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: bStartRateControl
+ *
+ * DESCRIPTION:
+ * Puts the ROI each camera given with -i and -c is streaming under control
+ * of the loss and jitter its streams see, and starts the controller
+ *
+ * RETURNS:
+ * bool_t TRUE if successful, FALSE otherwise
+ *
+ ****************************************************************************/
+static bool_t bStartRateControl(tsInstance *psInstance)
+{
+	ORLACO_tsRegionOfInterest sROI;
+	ORLACO_tuIP auIPs[INGEST_MAX_CAMERA_IPS + 1];
+	uint32_t u32NumIPs;
+	uint8_t u8SelectedRoi;
+	uint32_t n;
+
+	u32NumIPs = u32GetCameraIPs(psInstance, auIPs);
+	if(u32NumIPs == 0)
+	{
+		printf("Error: Rate control needs a camera given with -i or -c\n");
+		return FALSE;
+	}
+
+	if(!RATECTL_bInit(&psInstance->sRateControl, &psInstance->sOrlaco, psInstance->u32MinBitrate, psInstance->u32MaxBitrate, psInstance->u8MinFrameRate, psInstance->u8MaxFrameRate))
+	{
+		return FALSE;
+	}
+	psInstance->sRateControl.bNdjson = (psInstance->sIngest.eStatsFormat == E_INGEST_STATS_FORMAT_NDJSON);
+
+	for(n = 0; n < u32NumIPs; n++)
+	{
+		psInstance->sOrlaco.fdUnicast.sin_addr.s_addr = htonl(auIPs[n].u32IP);
+		if(!bGetSelectedRoi(psInstance, &u8SelectedRoi, &sROI))
+		{
+			printf("Warning: Couldn't read the selected ROI of camera %d.%d.%d.%d, its rate won't be controlled\n", auIPs[n].au8IP[3], auIPs[n].au8IP[2], auIPs[n].au8IP[1], auIPs[n].au8IP[0]);
+			continue;
+		}
+		if(!RATECTL_bAddCamera(&psInstance->sRateControl, auIPs[n], u8SelectedRoi, &sROI))
+		{
+			printf("Warning: Too many cameras, the rate of %d.%d.%d.%d won't be controlled\n", auIPs[n].au8IP[3], auIPs[n].au8IP[2], auIPs[n].au8IP[1], auIPs[n].au8IP[0]);
+		}
+	}
+
+	if((psInstance->sRateControl.u32NumCameras == 0) || !RATECTL_bStart(&psInstance->sRateControl))
+	{
+		RATECTL_vDeInit(&psInstance->sRateControl);
+		return FALSE;
+	}
+
+	psInstance->sIngest.psRateControl = &psInstance->sRateControl;
+
+	return TRUE;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: bPlanBandwidth
+ *
+ * DESCRIPTION:
+ * Works out the worst case load the cameras given with -i and -c would put
+ * on each local interface and destination once the pending writes to the -i
+ * camera are applied. When balancing, the cameras are given new destinations
+ * first and, unless that's rejected, moved to them.
+ *
+ * RETURNS:
+ * bool_t FALSE if the plan couldn't be made, or oversubscribes a link and
+ * should be rejected, TRUE otherwise
+ *
+ ****************************************************************************/
+static bool_t bPlanBandwidth(tsInstance *psInstance)
+{
+	PLAN_tsInstance *psPlan;
+	ORLACO_tuIP auIPs[INGEST_MAX_CAMERA_IPS + 1];
+	uint32_t u32UnicastIP = psInstance->sOrlaco.fdUnicast.sin_addr.s_addr;
+	uint32_t u32NumIPs;
+	bool_t bOk = TRUE;
+	uint32_t n;
+
+	u32NumIPs = u32GetCameraIPs(psInstance, auIPs);
+	if(u32NumIPs == 0)
+	{
+		printf("Error: Planning needs a camera given with -i or -c\n");
+		return FALSE;
+	}
+
+	psPlan = malloc(sizeof(PLAN_tsInstance));
+	if((psPlan == NULL) || !PLAN_bInit(psPlan, psInstance->u32PlanCapacityMbps))
+	{
+		free(psPlan);
+		return FALSE;
+	}
+
+	for(n = 0; n < u32NumIPs; n++)
+	{
+		// Only the -i camera has writes queued up for it
+		if(!PLAN_bAddCamera(psPlan, &psInstance->sOrlaco, auIPs[n], psInstance->bCameraIP && (n == 0)))
+		{
+			printf("Warning: Couldn't read the stream configuration of camera %d.%d.%d.%d, it isn't part of the plan\n", auIPs[n].au8IP[3], auIPs[n].au8IP[2], auIPs[n].au8IP[1], auIPs[n].au8IP[0]);
+		}
+	}
+	psInstance->sOrlaco.fdUnicast.sin_addr.s_addr = u32UnicastIP;
+
+	if(psInstance->bBalance && !PLAN_bBalance(psPlan, psInstance->pcBalanceInterfaces, psInstance->u16BalancePort, psInstance->u32BalancePorts))
+	{
+		free(psPlan);
+		return FALSE;
+	}
+
+	if(!PLAN_bEvaluate(psPlan) && psInstance->bPlanReject)
+	{
+		bOk = FALSE;
+	}
+
+	if(!bOk || (psInstance->eVerbosity >= E_VERBOSITY_LOW))
+	{
+		PLAN_vPrint(psPlan, (psInstance->sIngest.eStatsFormat == E_INGEST_STATS_FORMAT_NDJSON));
+	}
+	if(!bOk)
+	{
+		printf("Error: The plan oversubscribes %u link%s, nothing was written\n", psPlan->u32Oversubscribed, (psPlan->u32Oversubscribed == 1) ? "" : "s");
+	}
+	else if((psPlan->u32Unknown > 0) && (psInstance->eVerbosity >= E_VERBOSITY_MEDIUM))
+	{
+		printf("Warning: The capacity of %u link%s isn't known, give it with -L <Mbps>\n", psPlan->u32Unknown, (psPlan->u32Unknown == 1) ? "" : "s");
+	}
+
+	if(bOk && psInstance->bBalance)
+	{
+		bOk = bApplyMoves(psInstance, psPlan);
+	}
+
+	free(psPlan);
+
+	return bOk;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: bApplyMoves
+ *
+ * DESCRIPTION:
+ * Writes the new destination of every camera the balancer moved, to all of
+ * them in one pass
+ *
+ * RETURNS:
+ * bool_t TRUE if every camera was moved, FALSE otherwise
+ *
+ ****************************************************************************/
+static bool_t bApplyMoves(tsInstance *psInstance, PLAN_tsInstance *psPlan)
+{
+	ORLACO_tsRegisterWrite asWrites[PLAN_MAX_STREAMS];
+	uint32_t u32NumWrites;
+	uint32_t u32NumMoved = 0;
+	uint32_t n;
+
+	u32NumWrites = PLAN_u32GetMoves(psPlan, asWrites);
+	if(u32NumWrites == 0)
+	{
+		if(psInstance->eVerbosity >= E_VERBOSITY_MEDIUM) printf("Every camera already streams to its balanced destination\n");
+		return TRUE;
+	}
+
+	ORLACO_bSetRegistersPipelined(&psInstance->sOrlaco, asWrites, u32NumWrites);
+
+	for(n = 0; n < u32NumWrites; n++)
+	{
+		if(asWrites[n].bOk)
+		{
+			u32NumMoved++;
+		}
+		else
+		{
+			printf("Warning: Camera %d.%d.%d.%d couldn't be moved\n", asWrites[n].uIP.au8IP[3], asWrites[n].uIP.au8IP[2], asWrites[n].uIP.au8IP[1], asWrites[n].uIP.au8IP[0]);
+		}
+	}
+
+	if(psInstance->eVerbosity >= E_VERBOSITY_MEDIUM) printf("Moved %u of %u camera%s\n", u32NumMoved, u32NumWrites, (u32NumWrites == 1) ? "" : "s");
+
+	return (u32NumMoved == u32NumWrites);
+}
+
+
+/****************************************************************************
+ *
+ * NAME: bAcquireLeases
+ *
+ * DESCRIPTION:
+ * Takes the exclusive lock on every camera given with -i and -c for the rest
+ * of the run
+ *
+ * RETURNS:
+ * bool_t TRUE if successful, FALSE otherwise
+ *
+ ****************************************************************************/
+static bool_t bAcquireLeases(tsInstance *psInstance)
+{
+	ORLACO_tuIP auIPs[INGEST_MAX_CAMERA_IPS + 1];
+	uint32_t u32NumIPs;
+	uint32_t u32NumLeased = 0;
+	uint32_t n;
+
+	u32NumIPs = u32GetCameraIPs(psInstance, auIPs);
+	if(u32NumIPs == 0)
+	{
+		printf("Error: Leasing needs a camera given with -i or -c\n");
+		return FALSE;
+	}
+
+	// Cameras locked by another client are retried in the background and don't count as failures
+	if(!ORLACO_bAcquireLeases(&psInstance->sOrlaco, auIPs, u32NumIPs, psInstance->u32LeaseTime))
+	{
+		printf("Error: Couldn't lease every camera\n");
+		return FALSE;
+	}
+
+	for(n = 0; n < u32NumIPs; n++)
+	{
+		if(ORLACO_bIsLeased(&psInstance->sOrlaco, auIPs[n]))
+		{
+			u32NumLeased++;
+		}
+	}
+
+	if(psInstance->eVerbosity >= E_VERBOSITY_HIGH) printf("Leased %u of %u camera%s for %u seconds\n", u32NumLeased, u32NumIPs, (u32NumIPs == 1) ? "" : "s", psInstance->u32LeaseTime);
+	if((u32NumLeased < u32NumIPs) && (psInstance->eVerbosity >= E_VERBOSITY_MEDIUM)) printf("%u camera%s locked by another client, retrying\n", u32NumIPs - u32NumLeased, (u32NumIPs - u32NumLeased == 1) ? " is" : "s are");
+
+	return TRUE;
+}
+
+
+#ifndef _WIN32
+/****************************************************************************
+ *
+ * NAME: bIsDaemonCommand
+ *
+ * DESCRIPTION:
+ * Whether the command line asks to run the daemon, checked before the
+ * options are parsed so that it isn't forwarded to a running one
+ *
+ * RETURNS:
+ * bool_t TRUE if it does, FALSE otherwise
+ *
+ ****************************************************************************/
+static bool_t bIsDaemonCommand(int argc, char *argv[])
+{
+	int n;
+
+	for(n = 1; n < argc; n++)
+	{
+		if((strncmp(argv[n], "-Z", 2) == 0) || (strncmp(argv[n], "--daemon", 8) == 0))
+		{
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: bServeRequests
+ *
+ * DESCRIPTION:
+ * Runs the daemon. Discovery and leases are done here once, and kept up to
+ * date while no request is running, then each request is forked off with
+ * them and has its command line parsed as if it had been given to us.
+ *
+ * RETURNS:
+ * bool_t TRUE if successful, FALSE otherwise. Children that are to run a
+ * request return with bDaemonRequest set.
+ *
+ ****************************************************************************/
+static bool_t bServeRequests(tsInstance *psInstance)
+{
+	DAEMON_tsInstance sDaemon;
+	uint16_t u16ServiceID = psInstance->sOrlaco.u16ServiceID;
+	uint64_t u64DiscoverUs = 0;
+	int iArgc;
+	char **ppcArgv;
+
+	if(psInstance->u32LeaseTime != 0)
+	{
+		bAcquireLeases(psInstance);
+	}
+
+	if(!DAEMON_bInit(&sDaemon, psInstance->pcDaemonSocket, acOptions, asLongOptions))
+	{
+		return FALSE;
+	}
+
+	if(psInstance->eVerbosity >= E_VERBOSITY_MEDIUM) printf("Serving requests on %s\n", sDaemon.pcPath);
+
+	while(!psInstance->bExitRequest)
+	{
+		// The camera socket belongs to the request while one is running
+		if(!DAEMON_bIsBusy(&sDaemon))
+		{
+			if(psInstance->bDiscoverCameras && (RTP_u64GetTimeUs() >= u64DiscoverUs))
+			{
+				ORLACO_bDiscover(&psInstance->sOrlaco);
+				psInstance->sOrlaco.u16ServiceID = u16ServiceID;
+				u64DiscoverUs = RTP_u64GetTimeUs() + DAEMON_DISCOVERY_INTERVAL * 1000000ULL;
+			}
+			ORLACO_bServiceLeases(&psInstance->sOrlaco);
+		}
+
+		if(DAEMON_bService(&sDaemon, DAEMON_SERVICE_INTERVAL_MS, &iArgc, &ppcArgv))
+		{
+			// Our own options carry over as defaults, apart from those that are the daemon's
+			psInstance->pcDaemonSocket = NULL;
+			psInstance->bDiscoverCameras = FALSE;
+			psInstance->u32LeaseTime = 0;
+			psInstance->bDaemonRequest = TRUE;
+			psInstance->sOrlaco.u16SessionID = (uint16_t)(sDaemon.u32Requests * DAEMON_SESSION_RANGE);
+
+			optind = 0;
+			vParseCommandLineOptions(psInstance, iArgc, ppcArgv);
+			return TRUE;
+		}
+	}
+
+	if(psInstance->eVerbosity >= E_VERBOSITY_MEDIUM) printf("Stopped serving requests\n");
+	DAEMON_vDeInit(&sDaemon);
+
+	return TRUE;
+}
+#endif
+
+
+/****************************************************************************
+ *
+ * NAME: bStageRegisterSet
+ *
+ * DESCRIPTION:
+ * Writes the registers given with -w into a register set other than the one
+ * in use, on every camera given with -i and -c
+ *
+ * RETURNS:
+ * bool_t TRUE if successful, FALSE otherwise
+ *
+ ****************************************************************************/
+static bool_t bStageRegisterSet(tsInstance *psInstance)
+{
+	ORLACO_tsRegisterWrite asWrites[INGEST_MAX_CAMERA_IPS + 1];
+	ORLACO_tuIP auIPs[INGEST_MAX_CAMERA_IPS + 1];
+	uint32_t u32NumIPs;
+	uint32_t u32NumStaged = 0;
+	uint16_t u16NumRegisters = 0;
+	uint32_t n;
+	int i;
+
+	u32NumIPs = u32GetCameraIPs(psInstance, auIPs);
+	if(u32NumIPs == 0)
+	{
+		printf("Error: Register set staging needs a camera given with -i or -c\n");
+		return FALSE;
+	}
+
+	for(i = 0; i < psInstance->sOrlaco.u16NumRegisters; i++)
+	{
+		if(!psInstance->sOrlaco.psRegisters[i].bWrite)
+		{
+			continue;
+		}
+		if(u16NumRegisters == ORLACO_MAX_WRITE_REGISTERS)
+		{
+			printf("Error: Up to %d registers can be staged at once\n", ORLACO_MAX_WRITE_REGISTERS);
+			return FALSE;
+		}
+		asWrites[0].au16Addresses[u16NumRegisters] = psInstance->sOrlaco.psRegisters[i].u16Address;
+		asWrites[0].au8Values[u16NumRegisters] = psInstance->sOrlaco.psRegisters[i].u8Value;
+		u16NumRegisters++;
+	}
+	if(u16NumRegisters == 0)
+	{
+		printf("Error: Register set staging needs registers given with -w\n");
+		return FALSE;
+	}
+	asWrites[0].u16NumRegisters = u16NumRegisters;
+
+	for(n = 0; n < u32NumIPs; n++)
+	{
+		asWrites[n] = asWrites[0];
+		asWrites[n].uIP = auIPs[n];
+	}
+
+	ORLACO_bStageRegisterSetPipelined(&psInstance->sOrlaco, asWrites, u32NumIPs, psInstance->u8StageRegisterSet, psInstance->u8ActiveRegisterSet);
+
+	for(n = 0; n < u32NumIPs; n++)
+	{
+		if(asWrites[n].bOk)
+		{
+			u32NumStaged++;
+		}
+		else
+		{
+			printf("Warning: Register set %d of camera %d.%d.%d.%d couldn't be staged\n", psInstance->u8StageRegisterSet, auIPs[n].au8IP[3], auIPs[n].au8IP[2], auIPs[n].au8IP[1], auIPs[n].au8IP[0]);
+		}
+	}
+
+	if(psInstance->eVerbosity >= E_VERBOSITY_MEDIUM) printf("Staged %u register%s into register set %d of %u of %u camera%s\n", u16NumRegisters, (u16NumRegisters == 1) ? "" : "s", psInstance->u8StageRegisterSet, u32NumStaged, u32NumIPs, (u32NumIPs == 1) ? "" : "s");
+
+	return (u32NumStaged == u32NumIPs);
+}
+
+
+/****************************************************************************
+ *
+ * NAME: bUseRegisterSet
+ *
+ * DESCRIPTION:
+ * Switches every camera given with -i and -c over to a register set at once
+ *
+ * RETURNS:
+ * bool_t TRUE if successful, FALSE otherwise
+ *
+ ****************************************************************************/
+static bool_t bUseRegisterSet(tsInstance *psInstance)
+{
+	ORLACO_tsRegisterWrite asWrites[INGEST_MAX_CAMERA_IPS + 1];
+	ORLACO_tuIP auIPs[INGEST_MAX_CAMERA_IPS + 1];
+	uint32_t u32NumIPs;
+	uint32_t u32NumSwitched = 0;
+	uint32_t n;
+
+	u32NumIPs = u32GetCameraIPs(psInstance, auIPs);
+	if(u32NumIPs == 0)
+	{
+		printf("Error: Register set switching needs a camera given with -i or -c\n");
+		return FALSE;
+	}
+
+	memset(asWrites, 0, sizeof(asWrites));
+	for(n = 0; n < u32NumIPs; n++)
+	{
+		asWrites[n].uIP = auIPs[n];
+		asWrites[n].u8RegisterSet = psInstance->u8UseRegisterSet;
+	}
+
+	ORLACO_bSetUsedRegisterSetPipelined(&psInstance->sOrlaco, asWrites, u32NumIPs);
+
+	for(n = 0; n < u32NumIPs; n++)
+	{
+		if(asWrites[n].bOk)
+		{
+			u32NumSwitched++;
+		}
+		else
+		{
+			printf("Warning: Camera %d.%d.%d.%d couldn't be switched to register set %d\n", auIPs[n].au8IP[3], auIPs[n].au8IP[2], auIPs[n].au8IP[1], auIPs[n].au8IP[0], psInstance->u8UseRegisterSet);
+		}
+	}
+
+	if(psInstance->eVerbosity >= E_VERBOSITY_MEDIUM) printf("Switched %u of %u camera%s to register set %d\n", u32NumSwitched, u32NumIPs, (u32NumIPs == 1) ? "" : "s", psInstance->u8UseRegisterSet);
+
+	return (u32NumSwitched == u32NumIPs);
+}
+
+
+/****************************************************************************
+ *
+ * NAME: bSwitchRois
+ *
+ * DESCRIPTION:
+ * Switches the camera at the unicast address between ROIs while holding its
+ * exclusive lock, either cycling through them a number of times, or as they
+ * are asked for on stdin, one per line, until EOF, q or an exit request
+ *
+ * RETURNS:
+ * bool_t TRUE if every switch and lease renewal succeeded, FALSE otherwise
+ *
+ ****************************************************************************/
+static bool_t bSwitchRois(tsInstance *psInstance)
+{
+	static ROISWITCH_tsInstance sSwitch;
+	uint32_t u32NextMs;
+	char acLine[32];
+	bool_t bOk = TRUE;
+	uint32_t n;
+#ifndef _WIN32
+	struct pollfd sPoll;
+	int iReady;
+#endif
+
+	if(!psInstance->bCameraIP)
+	{
+		printf("Error: ROI switching needs a camera given with -i\n");
+		return FALSE;
+	}
+
+	if(!ROISWITCH_bInit(&sSwitch, &psInstance->sOrlaco, psInstance->au8SwitchRois, psInstance->u32NumSwitchRois, psInstance->u32SwitchLease))
+	{
+		return FALSE;
+	}
+
+	if(psInstance->u32SwitchCount != 0)
+	{
+		for(n = 0; !psInstance->bExitRequest && (n < psInstance->u32SwitchCount * sSwitch.u32NumPresets); n++)
+		{
+			if(!ROISWITCH_bService(&sSwitch, NULL))
+			{
+				bOk = FALSE;
+			}
+			if(!ROISWITCH_bSelect(&sSwitch, sSwitch.asPresets[n % sSwitch.u32NumPresets].u8RegionOfInterest))
+			{
+				bOk = FALSE;
+			}
+		}
+	}
+	else
+	{
+		if(psInstance->eVerbosity >= E_VERBOSITY_MEDIUM) printf("Ready, enter an ROI to switch to or q to quit\n");
+		fflush(stdout);
+
+		while(!psInstance->bExitRequest)
+		{
+			if(!ROISWITCH_bService(&sSwitch, &u32NextMs))
+			{
+				bOk = FALSE;
+			}
+#ifndef _WIN32
+			// Wake up in time to renew the lease when nothing is asked for
+			sPoll.fd = 0;
+			sPoll.events = POLLIN;
+			iReady = poll(&sPoll, 1, (int)u32NextMs);
+			if(iReady <= 0)
+			{
+				continue;
+			}
+#endif
+			if((fgets(acLine, sizeof(acLine), stdin) == NULL) || (acLine[0] == 'q'))
+			{
+				break;
+			}
+			if(acLine[0] == '\n')
+			{
+				continue;
+			}
+			if(!ROISWITCH_bSelect(&sSwitch, (uint8_t)atoi(acLine)))
+			{
+				bOk = FALSE;
+			}
+			else if(psInstance->eVerbosity >= E_VERBOSITY_HIGH)
+			{
+				printf("ROI %d in %u us\n", atoi(acLine), sSwitch.au32LatencyUs[(sSwitch.u32NumSamples - 1) % ROISWITCH_MAX_SAMPLES]);
+			}
+			fflush(stdout);
+		}
+	}
+
+	vPrintSwitchStats(&sSwitch);
+	ROISWITCH_vDeInit(&sSwitch);
+
+	return bOk;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: vPrintSwitchStats
+ *
+ * DESCRIPTION:
+ * Prints the ROI switch latency percentiles
+ *
+ * RETURNS:
+ * void
+ *
+ ****************************************************************************/
+static void vPrintSwitchStats(ROISWITCH_tsInstance *psSwitch)
+{
+	ROISWITCH_tsStats sStats;
+
+	ROISWITCH_vGetStats(psSwitch, &sStats);
+	printf("Switches=%u Failed=%u P50=%uus P90=%uus P99=%uus Max=%uus\n",
+		sStats.u32Count, psSwitch->u32Failures, sStats.u32P50Us, sStats.u32P90Us, sStats.u32P99Us, sStats.u32MaxUs);
+}
+
+
+/****************************************************************************
+ *
+ * NAME: bMonitorHistograms
+ *
+ * DESCRIPTION:
+ * Subscribes to the histograms of one ROI of the camera given with -i and
+ * those given with -c, and prints rolling exposure statistics of each and of
+ * all of them together until an exit is requested
+ *
+ * RETURNS:
+ * bool_t TRUE if successful, FALSE otherwise
+ *
+ ****************************************************************************/
+static bool_t bMonitorHistograms(tsInstance *psInstance)
+{
+	HISTOGRAM_tsInstance sHistograms;
+	HISTOGRAM_tsStats sStats;
+	ORLACO_tsHistogram sHistogram;
+	ORLACO_tsHistogramFormat sFormat;
+	ORLACO_tuIP auIPs[INGEST_MAX_CAMERA_IPS + 1];
+	uint32_t u32NumIPs;
+	uint32_t u32NumSubscribed = 0;
+	uint32_t u32IntervalMs = (psInstance->sIngest.u32StatsIntervalMs != 0) ? psInstance->sIngest.u32StatsIntervalMs : 1000;
+	uint64_t u64StartTimeUs;
+	uint64_t u64NextReportUs;
+	uint64_t u64TimeUs;
+	double dTime;
+	char acIP[16];
+	bool_t bOk = TRUE;
+	uint32_t n;
+
+	u32NumIPs = u32GetCameraIPs(psInstance, auIPs);
+	if(u32NumIPs == 0)
+	{
+		printf("Error: Histogram monitoring needs a camera given with -i or -c\n");
+		return FALSE;
+	}
+
+	if(!HISTOGRAM_bInit(&sHistograms, HISTOGRAM_DEFAULT_WINDOW))
+	{
+		return FALSE;
+	}
+
+	for(n = 0; bOk && (n < u32NumIPs); n++)
+	{
+		psInstance->sOrlaco.fdUnicast.sin_addr.s_addr = htonl(auIPs[n].u32IP);
+
+		bOk &= ORLACO_bSetHistogramFormat(&psInstance->sOrlaco, psInstance->u32HistogramRoi, &psInstance->sHistogramFormat);
+
+		// Cameras round the format to what they support, so report what we'll actually get
+		if(bOk && ORLACO_bGetHistogramFormat(&psInstance->sOrlaco, psInstance->u32HistogramRoi, &sFormat) &&
+		   (sFormat.u16NumBins != psInstance->sHistogramFormat.u16NumBins))
+		{
+			printf("Warning: Camera %d.%d.%d.%d uses %d histogram bins instead of %d\n", auIPs[n].au8IP[3], auIPs[n].au8IP[2], auIPs[n].au8IP[1], auIPs[n].au8IP[0], sFormat.u16NumBins, psInstance->sHistogramFormat.u16NumBins);
+		}
+
+		bOk &= ORLACO_bSubscribeRoiHistogram(&psInstance->sOrlaco, psInstance->u32HistogramRoi, TRUE);
+		if(!bOk)
+		{
+			printf("Error: Couldn't subscribe to the histograms of ROI %u of camera %d.%d.%d.%d\n", psInstance->u32HistogramRoi, auIPs[n].au8IP[3], auIPs[n].au8IP[2], auIPs[n].au8IP[1], auIPs[n].au8IP[0]);
+			break;
+		}
+		u32NumSubscribed++;
+	}
+
+	if(bOk && (psInstance->sIngest.eStatsFormat == E_INGEST_STATS_FORMAT_TABLE))
+	{
+		printf("%-8s %-15s %3s %5s %6s %4s %6s %4s %6s %6s\n", "Time", "Camera", "ROI", "Hists", "Mean", "P5", "Median", "P95", "Dark%", "Brt%");
+	}
+
+	u64StartTimeUs = RTP_u64GetTimeUs();
+	u64NextReportUs = u64StartTimeUs + (uint64_t)u32IntervalMs * 1000ULL;
+
+	while(bOk && !psInstance->bExitRequest)
+	{
+		// Returns after the socket read timeout when nothing arrives, so exit requests and reports aren't held up
+		if(ORLACO_bReceiveHistogram(&psInstance->sOrlaco, &sHistogram) && !HISTOGRAM_bPush(&sHistograms, &sHistogram))
+		{
+			if(psInstance->eVerbosity >= E_VERBOSITY_HIGH) printf("Warning: No room for the histograms of %d.%d.%d.%d ROI %u\n", sHistogram.uIP.au8IP[3], sHistogram.uIP.au8IP[2], sHistogram.uIP.au8IP[1], sHistogram.uIP.au8IP[0], sHistogram.u32RegionOfInterest);
+		}
+
+		u64TimeUs = RTP_u64GetTimeUs();
+		if(u64TimeUs < u64NextReportUs)
+		{
+			continue;
+		}
+		while(u64NextReportUs <= u64TimeUs)
+		{
+			u64NextReportUs += (uint64_t)u32IntervalMs * 1000ULL;
+		}
+		dTime = (double)(u64TimeUs - u64StartTimeUs) / 1000000.0;
+
+		// Keep any leases on the cameras for when monitoring stops
+		ORLACO_bServiceLeases(&psInstance->sOrlaco);
+
+		for(n = 0; n < sHistograms.u32NumSeries; n++)
+		{
+			if(HISTOGRAM_bGetStats(&sHistograms, n, &sStats))
+			{
+				sprintf(acIP, "%d.%d.%d.%d", sHistograms.asSeries[n].uIP.au8IP[3], sHistograms.asSeries[n].uIP.au8IP[2], sHistograms.asSeries[n].uIP.au8IP[1], sHistograms.asSeries[n].uIP.au8IP[0]);
+				vPrintHistogramStats(psInstance, dTime, acIP, sHistograms.asSeries[n].u32RegionOfInterest, &sStats);
+			}
+		}
+		if((sHistograms.u32NumSeries > 1) && HISTOGRAM_bGetCombinedStats(&sHistograms, &sStats))
+		{
+			vPrintHistogramStats(psInstance, dTime, "all", psInstance->u32HistogramRoi, &sStats);
+		}
+		fflush(stdout);
+	}
+
+	for(n = 0; n < u32NumSubscribed; n++)
+	{
+		psInstance->sOrlaco.fdUnicast.sin_addr.s_addr = htonl(auIPs[n].u32IP);
+		ORLACO_bSubscribeRoiHistogram(&psInstance->sOrlaco, psInstance->u32HistogramRoi, FALSE);
+	}
+
+	HISTOGRAM_vDeInit(&sHistograms);
+
+	return bOk;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: vPrintHistogramStats
+ *
+ * DESCRIPTION:
+ * Prints one line of histogram statistics in the statistics format
+ *
+ * RETURNS:
+ * void
+ *
+ ****************************************************************************/
+static void vPrintHistogramStats(tsInstance *psInstance, double dTime, char *pcCamera, uint32_t u32RegionOfInterest, HISTOGRAM_tsStats *psStats)
+{
+	if(psInstance->sIngest.eStatsFormat == E_INGEST_STATS_FORMAT_NDJSON)
+	{
+		printf("{\"time\":%.3f,\"camera\":\"%s\",\"roi\":%u,\"histograms\":%u,\"mean\":%.1f,\"p5\":%u,\"median\":%u,\"p95\":%u,"
+			   "\"dark_pct\":%.2f,\"bright_pct\":%.2f}\n",
+			   dTime, pcCamera, u32RegionOfInterest, psStats->u32Histograms, psStats->fMean, psStats->u32P5, psStats->u32Median, psStats->u32P95,
+			   psStats->fDarkPercent, psStats->fBrightPercent);
+	}
+	else
+	{
+		printf("%-8.1f %-15s %3u %5u %6.1f %4u %6u %4u %6.2f %6.2f\n",
+			   dTime, pcCamera, u32RegionOfInterest, psStats->u32Histograms, psStats->fMean, psStats->u32P5, psStats->u32Median, psStats->u32P95,
+			   psStats->fDarkPercent, psStats->fBrightPercent);
+	}
+}
+
+
+/****************************************************************************
+ *
+ * NAME: bWatchRegisters
+ *
+ * DESCRIPTION:
+ * Polls the watched registers of the camera given with -i and those given
+ * with -c, printing the values that change, until an exit is requested
+ *
+ * RETURNS:
+ * bool_t TRUE if successful, FALSE otherwise
+ *
+ ****************************************************************************/
+static bool_t bWatchRegisters(tsInstance *psInstance)
+{
+	static WATCH_tsInstance sWatch;
+	ORLACO_tuIP auIPs[INGEST_MAX_CAMERA_IPS + 1];
+	uint32_t u32NumIPs;
+	uint32_t u32NextMs;
+	uint32_t n;
+
+	u32NumIPs = u32GetCameraIPs(psInstance, auIPs);
+	if(u32NumIPs == 0)
+	{
+		printf("Error: Watching needs a camera given with -i or -c\n");
+		return FALSE;
+	}
+
+	if(!WATCH_bInit(&sWatch, &psInstance->sOrlaco, psInstance->u32WatchIntervalMs, psInstance->au8WatchRegisters, psInstance->u16NumWatchRegisters))
+	{
+		return FALSE;
+	}
+
+	for(n = 0; n < u32NumIPs; n++)
+	{
+		if(!WATCH_bAddCamera(&sWatch, auIPs[n]))
+		{
+			printf("Warning: Too many cameras, %d.%d.%d.%d won't be watched\n", auIPs[n].au8IP[3], auIPs[n].au8IP[2], auIPs[n].au8IP[1], auIPs[n].au8IP[0]);
+		}
+	}
+
+	while(!psInstance->bExitRequest)
+	{
+		WATCH_bService(&sWatch, &u32NextMs);
+
+		// Keep any leases on the cameras for when watching stops
+		ORLACO_bServiceLeases(&psInstance->sOrlaco);
+
+		if(u32NextMs != 0)
+		{
+#ifdef _WIN32
+			Sleep(u32NextMs);
+#else
+			usleep(u32NextMs * 1000);
+#endif
+		}
+	}
+
+	if(psInstance->eVerbosity >= E_VERBOSITY_MEDIUM) printf("Watched %u cameras, %u changes\n", sWatch.u32NumCameras, sWatch.u32Changes);
+
+	return TRUE;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: bQueryHistory
+ *
+ * DESCRIPTION:
+ * Prints the changes recorded in the history given with -y that match the
+ * query given with -Y
+ *
+ * RETURNS:
+ * bool_t TRUE if successful, FALSE otherwise
+ *
+ ****************************************************************************/
+static bool_t bQueryHistory(tsInstance *psInstance)
+{
+	uint64_t u64ToMs = HISTORY_u64GetTimeMs();
+	uint64_t u64FromMs = 0;
+	uint32_t u32Changes;
+
+	if(psInstance->pcHistoryDirectory == NULL)
+	{
+		printf("Error: Querying the history needs its directory given with -y\n");
+		return FALSE;
+	}
+
+	if((psInstance->u32HistorySeconds != 0) && ((uint64_t)psInstance->u32HistorySeconds * 1000ULL < u64ToMs))
+	{
+		u64FromMs = u64ToMs - (uint64_t)psInstance->u32HistorySeconds * 1000ULL;
+	}
+
+	u32Changes = HISTORY_u32Query(&psInstance->sHistory, psInstance->uHistoryCamera, psInstance->u16HistoryFirstKey, psInstance->u16HistoryLastKey,
+								  u64FromMs, u64ToMs, vPrintHistoryChange, psInstance);
+	fflush(stdout);
+
+	if(psInstance->eVerbosity >= E_VERBOSITY_MEDIUM) printf("Found %u changes\n", u32Changes);
+
+	return TRUE;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: vPrintHistoryChange
+ *
+ * DESCRIPTION:
+ * Prints a change found in the history as a line of NDJSON, in the same
+ * form as -p prints them but with the Unix time
+ *
+ * RETURNS:
+ * void
+ *
+ ****************************************************************************/
+static void vPrintHistoryChange(void *pvContext, ORLACO_tuIP uIP, HISTORY_tsChange *psChange)
+{
+	static const char *apcRoiFields[E_ORLACO_ROI_NUM_FIELDS] = { "p1x", "p1y", "p2x", "p2y", "width", "height", "max_bitrate", "fps", "compression" };
+	tsInstance *psInstance = (tsInstance *)pvContext;
+	ORLACO_tsRegisterValue *psRegister = NULL;
+	double dTime = (double)psChange->u64TimeMs / 1000.0;
+	char acIP[16];
+	char acWas[16];
+	int n;
+
+	sprintf(acIP, "%d.%d.%d.%d", uIP.au8IP[3], uIP.au8IP[2], uIP.au8IP[1], uIP.au8IP[0]);
+	if(psChange->bWasKnown)
+	{
+		sprintf(acWas, "%u", psChange->u32Was);
+	}
+	else
+	{
+		strcpy(acWas, "null");
+	}
+
+	if((psChange->u16Key & 0xf000) == ORLACO_ROI_KEY(0, 0))
+	{
+		n = psChange->u16Key & 0x0f;
+		printf("{\"time\":%.3f,\"camera\":\"%s\",\"roi\":%u,\"field\":\"%s\",\"value\":%u,\"was\":%s}\n",
+			   dTime, acIP, (psChange->u16Key >> 4) & 0xff, (n < E_ORLACO_ROI_NUM_FIELDS) ? apcRoiFields[n] : "unknown", psChange->u32Value, acWas);
+		return;
+	}
+
+	for(n = 0; n < psInstance->sOrlaco.u16NumRegisters; n++)
+	{
+		if(psInstance->sOrlaco.psRegisters[n].u16Address == psChange->u16Key)
+		{
+			psRegister = &psInstance->sOrlaco.psRegisters[n];
+			break;
+		}
+	}
+
+	printf("{\"time\":%.3f,\"camera\":\"%s\",\"register\":%d,\"address\":\"0x%04x\",\"name\":\"%s\",\"value\":%u,\"was\":%s}\n",
+		   dTime, acIP, (psRegister != NULL) ? n : -1, psChange->u16Key, (psRegister != NULL) ? psRegister->pcDescription : "", psChange->u32Value, acWas);
+}
+
+
+/****************************************************************************
+ *
+ * NAME: vPrintRegisterDefinitions
+ *
+ * DESCRIPTION:
+ * Prints out a list of the registers in the Orlaco Emos camera
+ *
+ * RETURNS:
+ * void
+ *
+ ****************************************************************************/
+static void vPrintRegisterDefinitions(ORLACO_tsInstance *psInstance)
+{
 	int n;
 
 	printf("Orlaco EMOS Camera Registers:\n\n"\
@@ -688,6 +2656,34 @@ static bool_t bIsPrintable(char c)
 	return FALSE;
 }
 
+
+/****************************************************************************
+ *
+ * NAME: bGetNumber
+ *
+ * DESCRIPTION:
+ * Converts a token of an option's argument to a number, checking that it
+ * was given and is in range before it's narrowed to wherever it's kept
+ *
+ * RETURNS:
+ * bool_t TRUE if the token is a number from lMin to lMax, FALSE otherwise
+ *
+ ****************************************************************************/
+static bool_t bGetNumber(char *pcToken, long lMin, long lMax, long *plValue)
+{
+	char *pcEnd;
+
+	if((pcToken == NULL) || (*pcToken == '\0'))
+	{
+		return FALSE;
+	}
+
+	errno = 0;
+	*plValue = strtol(pcToken, &pcEnd, 10);
+
+	return ((errno == 0) && (*pcEnd == '\0') && (*plValue >= lMin) && (*plValue <= lMax)) ? TRUE : FALSE;
+}
+
 /****************************************************************************/
 /***        END OF FILE                                                   ***/
 /****************************************************************************/
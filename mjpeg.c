@@ -0,0 +1,780 @@
+/****************************************************************************
+ *
+ * Copyright 2021 Lee Mitchell <lee@indigopepper.com>
+ * This file is part of OCC (Orlaco Camera Configurator)
+ *
+ * OCC (Orlaco Camera Configurator) is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * OCC (Orlaco Camera Configurator) is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with OCC (Orlaco Camera Configurator).  If not,
+ * see <http://www.gnu.org/licenses/>.
+ *
+ ****************************************************************************/
+
+/****************************************************************************/
+/***        Include files                                                 ***/
+/****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "common.h"
+#include "mjpeg.h"
+
+/****************************************************************************/
+/***        Macro Definitions                                             ***/
+/****************************************************************************/
+
+#define MJPEG_RTP_HEADER_LENGTH         8
+#define MJPEG_RESTART_HEADER_LENGTH     4
+#define MJPEG_QTABLE_HEADER_LENGTH      4
+
+#define MJPEG_TYPE_RESTART_FLAG         0x40    // Types 64-127 carry a restart marker header
+#define MJPEG_Q_INBAND_TABLES           128     // Q values 128-255 carry the tables in band
+
+/****************************************************************************/
+/***        Type Definitions                                              ***/
+/****************************************************************************/
+
+/****************************************************************************/
+/***        Local Function Prototypes                                     ***/
+/****************************************************************************/
+
+static void MJPEG_vMakeTables(uint8_t u8Q, uint8_t *pu8LumaTable, uint8_t *pu8ChromaTable);
+static uint32_t MJPEG_u32MakeHeaders(MJPEG_tsDepacketizer *psDepacketizer, uint8_t *pu8Header);
+static uint8_t *MJPEG_pu8MakeQuantHeader(uint8_t *pu8Ptr, uint8_t *pu8Table, uint8_t u8TableNo, bool_t bSixteenBit);
+static uint8_t *MJPEG_pu8MakeHuffmanHeader(uint8_t *pu8Ptr, const uint8_t *pu8CodeLengths, const uint8_t *pu8Symbols, uint8_t u8NumSymbols, uint8_t u8TableNo, uint8_t u8TableClass);
+static bool_t MJPEG_bEnsureCapacity(MJPEG_tsDepacketizer *psDepacketizer, uint32_t u32Length);
+static void MJPEG_vStartFrame(MJPEG_tsDepacketizer *psDepacketizer, RTP_tsPacket *psPacket);
+static bool_t MJPEG_bAddCoverage(MJPEG_tsDepacketizer *psDepacketizer, uint32_t u32Offset, uint32_t u32Length);
+
+/****************************************************************************/
+/***        Exported Variables                                            ***/
+/****************************************************************************/
+
+/****************************************************************************/
+/***        Local Variables                                               ***/
+/****************************************************************************/
+
+// Quantization tables from RFC 2435 Appendix A, in zigzag order
+static const uint8_t MJPEG_au8LumaQuantizer[64] = {
+    16, 11, 12, 14, 12, 10, 16, 14,
+    13, 14, 18, 17, 16, 19, 24, 40,
+    26, 24, 22, 22, 24, 49, 35, 37,
+    29, 40, 58, 51, 61, 60, 57, 51,
+    56, 55, 64, 72, 92, 78, 64, 68,
+    87, 69, 55, 56, 80, 109, 81, 87,
+    95, 98, 103, 104, 103, 62, 77, 113,
+    121, 112, 100, 120, 92, 101, 103, 99
+};
+
+static const uint8_t MJPEG_au8ChromaQuantizer[64] = {
+    17, 18, 18, 24, 21, 24, 47, 26,
+    26, 47, 99, 66, 56, 66, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99
+};
+
+// Default Huffman tables from RFC 2435 Appendix B (ITU-T T.81 Annex K.3)
+static const uint8_t MJPEG_au8LumaDcCodeLengths[16] = {
+    0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0
+};
+
+static const uint8_t MJPEG_au8LumaDcSymbols[12] = {
+    0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11
+};
+
+static const uint8_t MJPEG_au8LumaAcCodeLengths[16] = {
+    0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7d
+};
+
+static const uint8_t MJPEG_au8LumaAcSymbols[162] = {
+    0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12,
+    0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07,
+    0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xa1, 0x08,
+    0x23, 0x42, 0xb1, 0xc1, 0x15, 0x52, 0xd1, 0xf0,
+    0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0a, 0x16,
+    0x17, 0x18, 0x19, 0x1a, 0x25, 0x26, 0x27, 0x28,
+    0x29, 0x2a, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39,
+    0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49,
+    0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59,
+    0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69,
+    0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79,
+    0x7a, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
+    0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98,
+    0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7,
+    0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6,
+    0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4, 0xc5,
+    0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4,
+    0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda, 0xe1, 0xe2,
+    0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea,
+    0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+    0xf9, 0xfa
+};
+
+static const uint8_t MJPEG_au8ChromaDcCodeLengths[16] = {
+    0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0
+};
+
+static const uint8_t MJPEG_au8ChromaDcSymbols[12] = {
+    0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11
+};
+
+static const uint8_t MJPEG_au8ChromaAcCodeLengths[16] = {
+    0, 2, 1, 2, 4, 4, 3, 4, 7, 5, 4, 4, 0, 1, 2, 0x77
+};
+
+static const uint8_t MJPEG_au8ChromaAcSymbols[162] = {
+    0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21,
+    0x31, 0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71,
+    0x13, 0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91,
+    0xa1, 0xb1, 0xc1, 0x09, 0x23, 0x33, 0x52, 0xf0,
+    0x15, 0x62, 0x72, 0xd1, 0x0a, 0x16, 0x24, 0x34,
+    0xe1, 0x25, 0xf1, 0x17, 0x18, 0x19, 0x1a, 0x26,
+    0x27, 0x28, 0x29, 0x2a, 0x35, 0x36, 0x37, 0x38,
+    0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48,
+    0x49, 0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58,
+    0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68,
+    0x69, 0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78,
+    0x79, 0x7a, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87,
+    0x88, 0x89, 0x8a, 0x92, 0x93, 0x94, 0x95, 0x96,
+    0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5,
+    0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4,
+    0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3,
+    0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2,
+    0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda,
+    0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9,
+    0xea, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+    0xf9, 0xfa
+};
+
+/****************************************************************************/
+/***        Exported Functions                                            ***/
+/****************************************************************************/
+
+/****************************************************************************
+ *
+ * NAME: MJPEG_bInit
+ *
+ * DESCRIPTION:
+ * Initialises an RTP/JPEG depacketizer and allocates its frame buffer
+ *
+ * RETURNS:
+ * bool_t TRUE if successful, FALSE otherwise
+ *
+ ****************************************************************************/
+bool_t MJPEG_bInit(MJPEG_tsDepacketizer *psDepacketizer)
+{
+    memset(psDepacketizer, 0, sizeof(MJPEG_tsDepacketizer));
+
+    psDepacketizer->pu8Buffer = (uint8_t*)malloc(MJPEG_MAX_HEADER_LENGTH + MJPEG_INITIAL_FRAME_LENGTH);
+    if(psDepacketizer->pu8Buffer == NULL)
+    {
+        printf("Error: Failed to allocate memory for frame buffer in %s\n", __FUNCTION__);
+        return FALSE;
+    }
+    psDepacketizer->u32BufferLength = MJPEG_INITIAL_FRAME_LENGTH;
+
+    return TRUE;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: MJPEG_vDeInit
+ *
+ * DESCRIPTION:
+ * Frees the memory used by an RTP/JPEG depacketizer
+ *
+ * RETURNS:
+ * void
+ *
+ ****************************************************************************/
+void MJPEG_vDeInit(MJPEG_tsDepacketizer *psDepacketizer)
+{
+    if(psDepacketizer->pu8Buffer != NULL)
+    {
+        free(psDepacketizer->pu8Buffer);
+        psDepacketizer->pu8Buffer = NULL;
+    }
+}
+
+
+/****************************************************************************
+ *
+ * NAME: MJPEG_bPushPacket
+ *
+ * DESCRIPTION:
+ * Adds an RTP/JPEG packet to the frame being reassembled. Fragments are
+ * placed by their fragment offset so reordered packets are tolerated. When
+ * every byte up to the marker packet has arrived the JPEG headers are rebuilt
+ * in front of the scan data and the complete frame is returned.
+ *
+ * RETURNS:
+ * bool_t TRUE if psFrame now holds a complete frame, FALSE otherwise
+ *
+ ****************************************************************************/
+bool_t MJPEG_bPushPacket(MJPEG_tsDepacketizer *psDepacketizer, RTP_tsPacket *psPacket, RTP_tsFrame *psFrame)
+{
+    const uint8_t *pu8Ptr = psPacket->pu8Payload;
+    uint32_t u32Remaining = psPacket->u32PayloadLength;
+    uint32_t u32FragmentOffset;
+    uint8_t u8Type;
+    uint8_t u8Q;
+    uint16_t u16RestartInterval = 0;
+    uint16_t u16TableLength;
+    uint8_t u8Precision;
+    uint32_t u32LumaLength;
+    uint32_t u32ChromaLength;
+    uint32_t u32HeaderLength;
+    uint8_t au8Header[MJPEG_MAX_HEADER_LENGTH];
+
+    if(u32Remaining < MJPEG_RTP_HEADER_LENGTH)
+    {
+        return FALSE;
+    }
+
+    // Main JPEG header
+    u32FragmentOffset = ((uint32_t)pu8Ptr[1] << 16) | ((uint32_t)pu8Ptr[2] << 8) | pu8Ptr[3];
+    u8Type = pu8Ptr[4];
+    u8Q = pu8Ptr[5];
+    pu8Ptr += MJPEG_RTP_HEADER_LENGTH;
+    u32Remaining -= MJPEG_RTP_HEADER_LENGTH;
+
+    // Only the baseline 4:2:2 / 4:2:0 types are defined by RFC 2435
+    if((u8Type & ~MJPEG_TYPE_RESTART_FLAG) > 1)
+    {
+        return FALSE;
+    }
+
+    // Restart marker header
+    if(u8Type & MJPEG_TYPE_RESTART_FLAG)
+    {
+        if(u32Remaining < MJPEG_RESTART_HEADER_LENGTH)
+        {
+            return FALSE;
+        }
+        u16RestartInterval = (uint16_t)((pu8Ptr[0] << 8) | pu8Ptr[1]);
+        pu8Ptr += MJPEG_RESTART_HEADER_LENGTH;
+        u32Remaining -= MJPEG_RESTART_HEADER_LENGTH;
+    }
+
+    // A new timestamp means a new frame, anything left over from the previous one is incomplete
+    if(!psDepacketizer->bInFrame || (psDepacketizer->u32Timestamp != psPacket->u32Timestamp))
+    {
+        if(psDepacketizer->bInFrame)
+        {
+            psDepacketizer->u32FramesDropped++;
+        }
+        MJPEG_vStartFrame(psDepacketizer, psPacket);
+    }
+
+    // The first fragment describes the frame and may carry the quantization tables
+    if(u32FragmentOffset == 0)
+    {
+        psDepacketizer->u8Type = u8Type;
+        psDepacketizer->u8Q = u8Q;
+        psDepacketizer->u8Width = psPacket->pu8Payload[6];
+        psDepacketizer->u8Height = psPacket->pu8Payload[7];
+        psDepacketizer->u16RestartInterval = u16RestartInterval;
+
+        if(u8Q >= MJPEG_Q_INBAND_TABLES)
+        {
+            if(u32Remaining < MJPEG_QTABLE_HEADER_LENGTH)
+            {
+                return FALSE;
+            }
+            u8Precision = pu8Ptr[1];
+            u16TableLength = (uint16_t)((pu8Ptr[2] << 8) | pu8Ptr[3]);
+            pu8Ptr += MJPEG_QTABLE_HEADER_LENGTH;
+            u32Remaining -= MJPEG_QTABLE_HEADER_LENGTH;
+
+            // A zero length means the tables sent previously for this Q still apply
+            if(u16TableLength > 0)
+            {
+                u32LumaLength = (u8Precision & 0x01) ? 128 : 64;
+                u32ChromaLength = (u8Precision & 0x02) ? 128 : 64;
+                if((u16TableLength < u32LumaLength + u32ChromaLength) || (u32Remaining < u16TableLength))
+                {
+                    return FALSE;
+                }
+                memcpy(psDepacketizer->au8LumaTable, pu8Ptr, u32LumaLength);
+                memcpy(psDepacketizer->au8ChromaTable, pu8Ptr + u32LumaLength, u32ChromaLength);
+                psDepacketizer->u8TablesPrecision = u8Precision;
+                psDepacketizer->u8TablesQ = u8Q;
+                psDepacketizer->bTablesValid = TRUE;
+                pu8Ptr += u16TableLength;
+                u32Remaining -= u16TableLength;
+            }
+            else if(!psDepacketizer->bTablesValid || (psDepacketizer->u8TablesQ != u8Q))
+            {
+                // We never got the tables for this Q, so the frame can't be rebuilt
+                psDepacketizer->bInFrame = FALSE;
+                psDepacketizer->u32FramesDropped++;
+                return FALSE;
+            }
+        }
+        else if(!psDepacketizer->bTablesValid || (psDepacketizer->u8TablesQ != u8Q))
+        {
+            MJPEG_vMakeTables(u8Q, psDepacketizer->au8LumaTable, psDepacketizer->au8ChromaTable);
+            psDepacketizer->u8TablesPrecision = 0;
+            psDepacketizer->u8TablesQ = u8Q;
+            psDepacketizer->bTablesValid = TRUE;
+        }
+    }
+
+    // Place the scan data at its fragment offset, leaving room for the EOI marker
+    if(!MJPEG_bEnsureCapacity(psDepacketizer, u32FragmentOffset + u32Remaining + 2))
+    {
+        psDepacketizer->bInFrame = FALSE;
+        psDepacketizer->u32FramesDropped++;
+        return FALSE;
+    }
+    memcpy(psDepacketizer->pu8Buffer + MJPEG_MAX_HEADER_LENGTH + u32FragmentOffset, pu8Ptr, u32Remaining);
+    if(!MJPEG_bAddCoverage(psDepacketizer, u32FragmentOffset, u32Remaining))
+    {
+        psDepacketizer->bInFrame = FALSE;
+        psDepacketizer->u32FramesDropped++;
+        return FALSE;
+    }
+
+    if(psPacket->bMarker)
+    {
+        psDepacketizer->u32FrameLength = u32FragmentOffset + u32Remaining;
+    }
+
+    // Wait until the marker packet has been seen and every byte before it has arrived
+    if((psDepacketizer->u32FrameLength == 0) || (psDepacketizer->u32Contiguous < psDepacketizer->u32FrameLength))
+    {
+        return FALSE;
+    }
+
+    psDepacketizer->bInFrame = FALSE;
+
+    // We need the tables and dimensions from the first fragment to rebuild the headers
+    if(!psDepacketizer->bTablesValid || (psDepacketizer->u8Width == 0) || (psDepacketizer->u8Height == 0))
+    {
+        psDepacketizer->u32FramesDropped++;
+        return FALSE;
+    }
+
+    // Terminate the scan with an EOI marker if the camera didn't
+    if((psDepacketizer->u32FrameLength < 2) ||
+       (psDepacketizer->pu8Buffer[MJPEG_MAX_HEADER_LENGTH + psDepacketizer->u32FrameLength - 2] != 0xff) ||
+       (psDepacketizer->pu8Buffer[MJPEG_MAX_HEADER_LENGTH + psDepacketizer->u32FrameLength - 1] != 0xd9))
+    {
+        psDepacketizer->pu8Buffer[MJPEG_MAX_HEADER_LENGTH + psDepacketizer->u32FrameLength++] = 0xff;
+        psDepacketizer->pu8Buffer[MJPEG_MAX_HEADER_LENGTH + psDepacketizer->u32FrameLength++] = 0xd9;
+    }
+
+    // Rebuild the headers directly in front of the scan data so the frame is contiguous
+    u32HeaderLength = MJPEG_u32MakeHeaders(psDepacketizer, au8Header);
+    memcpy(psDepacketizer->pu8Buffer + MJPEG_MAX_HEADER_LENGTH - u32HeaderLength, au8Header, u32HeaderLength);
+
+    psFrame->eCodec = E_RTP_CODEC_JPEG;
+    psFrame->u32Ssrc = psPacket->u32Ssrc;
+    psFrame->u32Timestamp = psDepacketizer->u32Timestamp;
+    psFrame->u64FirstPacketTimeUs = psDepacketizer->u64FirstPacketTimeUs;
+    psFrame->u64ArrivalTimeUs = psPacket->u64ArrivalTimeUs;
+    psFrame->u16Width = psDepacketizer->u8Width * 8;
+    psFrame->u16Height = psDepacketizer->u8Height * 8;
+    psFrame->bKeyFrame = TRUE;
+    psFrame->pu8Data = psDepacketizer->pu8Buffer + MJPEG_MAX_HEADER_LENGTH - u32HeaderLength;
+    psFrame->u32Length = u32HeaderLength + psDepacketizer->u32FrameLength;
+
+    psDepacketizer->u32FramesCompleted++;
+
+    return TRUE;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: MJPEG_bWriteFrameToFile
+ *
+ * DESCRIPTION:
+ * Writes a complete JPEG frame to <prefix>_<ip>_<ssrc>_<number>.jpg
+ *
+ * RETURNS:
+ * bool_t TRUE if successful, FALSE otherwise
+ *
+ ****************************************************************************/
+bool_t MJPEG_bWriteFrameToFile(RTP_tsFrame *psFrame, char *pcPrefix, uint32_t u32FrameNumber)
+{
+    char acFileName[256];
+    FILE *psFile;
+    size_t tWritten;
+
+    snprintf(acFileName, sizeof(acFileName), "%s_%d.%d.%d.%d_%08x_%06u.jpg",
+             pcPrefix,
+             psFrame->uSrcIP.au8IP[3],
+             psFrame->uSrcIP.au8IP[2],
+             psFrame->uSrcIP.au8IP[1],
+             psFrame->uSrcIP.au8IP[0],
+             psFrame->u32Ssrc,
+             u32FrameNumber);
+
+    psFile = fopen(acFileName, "wb");
+    if(psFile == NULL)
+    {
+        printf("Error: Failed to open %s in %s\n", acFileName, __FUNCTION__);
+        return FALSE;
+    }
+
+    tWritten = fwrite(psFrame->pu8Data, 1, psFrame->u32Length, psFile);
+    fclose(psFile);
+
+    if(tWritten != psFrame->u32Length)
+    {
+        printf("Error: Failed to write %s in %s\n", acFileName, __FUNCTION__);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/****************************************************************************/
+/***        Local Functions                                               ***/
+/****************************************************************************/
+
+/****************************************************************************
+ *
+ * NAME: MJPEG_vMakeTables
+ *
+ * DESCRIPTION:
+ * Derives the luma and chroma quantization tables for Q values 1-99 as
+ * described in RFC 2435 Appendix A
+ *
+ * RETURNS:
+ * void
+ *
+ ****************************************************************************/
+static void MJPEG_vMakeTables(uint8_t u8Q, uint8_t *pu8LumaTable, uint8_t *pu8ChromaTable)
+{
+    int n;
+    int iFactor = u8Q;
+    int iScale;
+    int iLuma;
+    int iChroma;
+
+    if(iFactor < 1) iFactor = 1;
+    if(iFactor > 99) iFactor = 99;
+
+    if(u8Q < 50)
+    {
+        iScale = 5000 / iFactor;
+    }
+    else
+    {
+        iScale = 200 - (iFactor * 2);
+    }
+
+    for(n = 0; n < 64; n++)
+    {
+        iLuma = (MJPEG_au8LumaQuantizer[n] * iScale + 50) / 100;
+        iChroma = (MJPEG_au8ChromaQuantizer[n] * iScale + 50) / 100;
+
+        // Limit the quantizers to 1 <= q <= 255
+        if(iLuma < 1) iLuma = 1;
+        if(iLuma > 255) iLuma = 255;
+        if(iChroma < 1) iChroma = 1;
+        if(iChroma > 255) iChroma = 255;
+
+        pu8LumaTable[n] = (uint8_t)iLuma;
+        pu8ChromaTable[n] = (uint8_t)iChroma;
+    }
+}
+
+
+/****************************************************************************
+ *
+ * NAME: MJPEG_u32MakeHeaders
+ *
+ * DESCRIPTION:
+ * Builds the JPEG interchange headers (SOI, DQT, DRI, SOF0, DHT, SOS) for the
+ * frame being reassembled, following RFC 2435 Appendix B
+ *
+ * RETURNS:
+ * uint32_t The length of the headers in bytes
+ *
+ ****************************************************************************/
+static uint32_t MJPEG_u32MakeHeaders(MJPEG_tsDepacketizer *psDepacketizer, uint8_t *pu8Header)
+{
+    uint8_t *pu8Ptr = pu8Header;
+    uint16_t u16Width = psDepacketizer->u8Width * 8;
+    uint16_t u16Height = psDepacketizer->u8Height * 8;
+
+    // Start of image
+    *pu8Ptr++ = 0xff;
+    *pu8Ptr++ = 0xd8;
+
+    // Quantization tables
+    pu8Ptr = MJPEG_pu8MakeQuantHeader(pu8Ptr, psDepacketizer->au8LumaTable, 0, psDepacketizer->u8TablesPrecision & 0x01);
+    pu8Ptr = MJPEG_pu8MakeQuantHeader(pu8Ptr, psDepacketizer->au8ChromaTable, 1, (psDepacketizer->u8TablesPrecision >> 1) & 0x01);
+
+    // Restart interval
+    if(psDepacketizer->u16RestartInterval != 0)
+    {
+        *pu8Ptr++ = 0xff;
+        *pu8Ptr++ = 0xdd;
+        *pu8Ptr++ = 0x00;
+        *pu8Ptr++ = 0x04;
+        *pu8Ptr++ = (psDepacketizer->u16RestartInterval >> 8) & 0xff;
+        *pu8Ptr++ = (psDepacketizer->u16RestartInterval >> 0) & 0xff;
+    }
+
+    // Baseline frame header with three components
+    *pu8Ptr++ = 0xff;
+    *pu8Ptr++ = 0xc0;
+    *pu8Ptr++ = 0x00;
+    *pu8Ptr++ = 17;
+    *pu8Ptr++ = 8;
+    *pu8Ptr++ = (u16Height >> 8) & 0xff;
+    *pu8Ptr++ = (u16Height >> 0) & 0xff;
+    *pu8Ptr++ = (u16Width >> 8) & 0xff;
+    *pu8Ptr++ = (u16Width >> 0) & 0xff;
+    *pu8Ptr++ = 3;
+
+    // Y, 2x1 sampling for type 0 (4:2:2), 2x2 for type 1 (4:2:0)
+    *pu8Ptr++ = 0;
+    *pu8Ptr++ = ((psDepacketizer->u8Type & ~MJPEG_TYPE_RESTART_FLAG) == 0) ? 0x21 : 0x22;
+    *pu8Ptr++ = 0;
+
+    // Cb
+    *pu8Ptr++ = 1;
+    *pu8Ptr++ = 0x11;
+    *pu8Ptr++ = 1;
+
+    // Cr
+    *pu8Ptr++ = 2;
+    *pu8Ptr++ = 0x11;
+    *pu8Ptr++ = 1;
+
+    // Huffman tables
+    pu8Ptr = MJPEG_pu8MakeHuffmanHeader(pu8Ptr, MJPEG_au8LumaDcCodeLengths, MJPEG_au8LumaDcSymbols, sizeof(MJPEG_au8LumaDcSymbols), 0, 0);
+    pu8Ptr = MJPEG_pu8MakeHuffmanHeader(pu8Ptr, MJPEG_au8LumaAcCodeLengths, MJPEG_au8LumaAcSymbols, sizeof(MJPEG_au8LumaAcSymbols), 0, 1);
+    pu8Ptr = MJPEG_pu8MakeHuffmanHeader(pu8Ptr, MJPEG_au8ChromaDcCodeLengths, MJPEG_au8ChromaDcSymbols, sizeof(MJPEG_au8ChromaDcSymbols), 1, 0);
+    pu8Ptr = MJPEG_pu8MakeHuffmanHeader(pu8Ptr, MJPEG_au8ChromaAcCodeLengths, MJPEG_au8ChromaAcSymbols, sizeof(MJPEG_au8ChromaAcSymbols), 1, 1);
+
+    // Start of scan
+    *pu8Ptr++ = 0xff;
+    *pu8Ptr++ = 0xda;
+    *pu8Ptr++ = 0x00;
+    *pu8Ptr++ = 12;
+    *pu8Ptr++ = 3;
+    *pu8Ptr++ = 0;
+    *pu8Ptr++ = 0x00;
+    *pu8Ptr++ = 1;
+    *pu8Ptr++ = 0x11;
+    *pu8Ptr++ = 2;
+    *pu8Ptr++ = 0x11;
+    *pu8Ptr++ = 0;
+    *pu8Ptr++ = 63;
+    *pu8Ptr++ = 0;
+
+    return (uint32_t)(pu8Ptr - pu8Header);
+}
+
+
+/****************************************************************************
+ *
+ * NAME: MJPEG_pu8MakeQuantHeader
+ *
+ * DESCRIPTION:
+ * Writes a DQT segment for a single 8 or 16 bit quantization table
+ *
+ * RETURNS:
+ * uint8_t * - Pointer to the byte following the segment
+ *
+ ****************************************************************************/
+static uint8_t *MJPEG_pu8MakeQuantHeader(uint8_t *pu8Ptr, uint8_t *pu8Table, uint8_t u8TableNo, bool_t bSixteenBit)
+{
+    uint32_t u32TableLength = bSixteenBit ? 128 : 64;
+
+    *pu8Ptr++ = 0xff;
+    *pu8Ptr++ = 0xdb;
+    *pu8Ptr++ = 0x00;
+    *pu8Ptr++ = (uint8_t)(u32TableLength + 3);
+    *pu8Ptr++ = (uint8_t)((bSixteenBit << 4) | u8TableNo);
+    memcpy(pu8Ptr, pu8Table, u32TableLength);
+
+    return pu8Ptr + u32TableLength;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: MJPEG_pu8MakeHuffmanHeader
+ *
+ * DESCRIPTION:
+ * Writes a DHT segment for a single Huffman table
+ *
+ * RETURNS:
+ * uint8_t * - Pointer to the byte following the segment
+ *
+ ****************************************************************************/
+static uint8_t *MJPEG_pu8MakeHuffmanHeader(uint8_t *pu8Ptr, const uint8_t *pu8CodeLengths, const uint8_t *pu8Symbols, uint8_t u8NumSymbols, uint8_t u8TableNo, uint8_t u8TableClass)
+{
+    *pu8Ptr++ = 0xff;
+    *pu8Ptr++ = 0xc4;
+    *pu8Ptr++ = 0x00;
+    *pu8Ptr++ = (uint8_t)(3 + 16 + u8NumSymbols);
+    *pu8Ptr++ = (uint8_t)((u8TableClass << 4) | u8TableNo);
+    memcpy(pu8Ptr, pu8CodeLengths, 16);
+    pu8Ptr += 16;
+    memcpy(pu8Ptr, pu8Symbols, u8NumSymbols);
+
+    return pu8Ptr + u8NumSymbols;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: MJPEG_bEnsureCapacity
+ *
+ * DESCRIPTION:
+ * Grows the frame buffer so it can hold at least u32Length bytes of scan data
+ *
+ * RETURNS:
+ * bool_t TRUE if the buffer is large enough, FALSE otherwise
+ *
+ ****************************************************************************/
+static bool_t MJPEG_bEnsureCapacity(MJPEG_tsDepacketizer *psDepacketizer, uint32_t u32Length)
+{
+    uint32_t u32NewLength = psDepacketizer->u32BufferLength;
+    uint8_t *pu8NewBuffer;
+
+    if(u32Length <= psDepacketizer->u32BufferLength)
+    {
+        return TRUE;
+    }
+
+    if(u32Length > MJPEG_MAX_FRAME_LENGTH)
+    {
+        return FALSE;
+    }
+
+    while(u32NewLength < u32Length)
+    {
+        u32NewLength *= 2;
+    }
+
+    pu8NewBuffer = (uint8_t*)realloc(psDepacketizer->pu8Buffer, MJPEG_MAX_HEADER_LENGTH + u32NewLength);
+    if(pu8NewBuffer == NULL)
+    {
+        return FALSE;
+    }
+
+    psDepacketizer->pu8Buffer = pu8NewBuffer;
+    psDepacketizer->u32BufferLength = u32NewLength;
+
+    return TRUE;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: MJPEG_vStartFrame
+ *
+ * DESCRIPTION:
+ * Resets the reassembly state for the frame with the packet's timestamp
+ *
+ * RETURNS:
+ * void
+ *
+ ****************************************************************************/
+static void MJPEG_vStartFrame(MJPEG_tsDepacketizer *psDepacketizer, RTP_tsPacket *psPacket)
+{
+    psDepacketizer->bInFrame = TRUE;
+    psDepacketizer->u32Timestamp = psPacket->u32Timestamp;
+    psDepacketizer->u32Contiguous = 0;
+    psDepacketizer->u32NumHeld = 0;
+    psDepacketizer->u32FrameLength = 0;
+    psDepacketizer->u64FirstPacketTimeUs = psPacket->u64ArrivalTimeUs;
+    psDepacketizer->u8Width = 0;
+    psDepacketizer->u8Height = 0;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: MJPEG_bAddCoverage
+ *
+ * DESCRIPTION:
+ * Records the part of the scan a fragment filled in. Coverage is kept as
+ * the run from the start of the frame with no gap in it, plus the fragments
+ * that arrived beyond a gap, so fragments that are repeated or overlap are
+ * only counted once and a frame with a hole never looks complete.
+ *
+ * RETURNS:
+ * bool_t TRUE if successful, FALSE if too many fragments are held beyond a gap
+ *
+ ****************************************************************************/
+static bool_t MJPEG_bAddCoverage(MJPEG_tsDepacketizer *psDepacketizer, uint32_t u32Offset, uint32_t u32Length)
+{
+    uint32_t u32End = u32Offset + u32Length;
+    uint32_t n;
+    bool_t bGrew;
+
+    if(u32Offset > psDepacketizer->u32Contiguous)
+    {
+        for(n = 0; n < psDepacketizer->u32NumHeld; n++)
+        {
+            if((psDepacketizer->asHeld[n].u32Offset == u32Offset) && (psDepacketizer->asHeld[n].u32Length >= u32Length))
+            {
+                return TRUE;
+            }
+        }
+        if(psDepacketizer->u32NumHeld == MJPEG_MAX_HELD_FRAGMENTS)
+        {
+            return FALSE;
+        }
+        psDepacketizer->asHeld[psDepacketizer->u32NumHeld].u32Offset = u32Offset;
+        psDepacketizer->asHeld[psDepacketizer->u32NumHeld].u32Length = u32Length;
+        psDepacketizer->u32NumHeld++;
+        return TRUE;
+    }
+
+    if(u32End > psDepacketizer->u32Contiguous)
+    {
+        psDepacketizer->u32Contiguous = u32End;
+    }
+
+    // The gap may have been filled, letting held fragments join the run
+    do
+    {
+        bGrew = FALSE;
+        for(n = 0; n < psDepacketizer->u32NumHeld; n++)
+        {
+            if(psDepacketizer->asHeld[n].u32Offset <= psDepacketizer->u32Contiguous)
+            {
+                u32End = psDepacketizer->asHeld[n].u32Offset + psDepacketizer->asHeld[n].u32Length;
+                if(u32End > psDepacketizer->u32Contiguous)
+                {
+                    psDepacketizer->u32Contiguous = u32End;
+                    bGrew = TRUE;
+                }
+                psDepacketizer->asHeld[n--] = psDepacketizer->asHeld[--psDepacketizer->u32NumHeld];
+            }
+        }
+    }
+    while(bGrew);
+
+    return TRUE;
+}
+
+/****************************************************************************/
+/***        END OF FILE                                                   ***/
+/****************************************************************************/
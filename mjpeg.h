@@ -0,0 +1,70 @@
+#ifndef MJPEG_H
+#define MJPEG_H
+
+/****************************************************************************/
+/***        Include files                                                 ***/
+/****************************************************************************/
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "common.h"
+#include "rtp.h"
+
+/****************************************************************************/
+/***        Macro Definitions                                             ***/
+/****************************************************************************/
+
+#define MJPEG_MAX_HEADER_LENGTH         1024                // Space reserved in front of the scan data for the rebuilt JPEG header
+#define MJPEG_INITIAL_FRAME_LENGTH      (256 * 1024)
+#define MJPEG_MAX_FRAME_LENGTH          (8 * 1024 * 1024)
+#define MJPEG_MAX_HELD_FRAGMENTS        64                  // Arrived ahead of a gap in the frame
+
+/****************************************************************************/
+/***        Type Definitions                                              ***/
+/****************************************************************************/
+
+typedef struct {
+    uint32_t u32Offset;
+    uint32_t u32Length;
+} MJPEG_tsFragment;
+
+// Reassembly state for one RTP/JPEG (RFC 2435) stream
+typedef struct {
+    uint8_t *pu8Buffer;                             // MJPEG_MAX_HEADER_LENGTH bytes of header space followed by the scan data
+    uint32_t u32BufferLength;                       // Capacity available for scan data
+    bool_t bInFrame;
+    uint32_t u32Timestamp;
+    uint32_t u32Contiguous;                         // Scan bytes received without a gap from the start of the frame
+    MJPEG_tsFragment asHeld[MJPEG_MAX_HELD_FRAGMENTS];  // Received beyond u32Contiguous
+    uint32_t u32NumHeld;
+    uint32_t u32FrameLength;                        // Total scan length, only known once the marker packet arrived
+    uint64_t u64FirstPacketTimeUs;
+    uint8_t u8Type;
+    uint8_t u8Q;
+    uint8_t u8Width;                                // In units of 8 pixels
+    uint8_t u8Height;                               // In units of 8 pixels
+    uint16_t u16RestartInterval;
+    bool_t bTablesValid;
+    uint8_t u8TablesQ;                              // Q value the cached tables belong to
+    uint8_t u8TablesPrecision;
+    uint8_t au8LumaTable[128];
+    uint8_t au8ChromaTable[128];
+    uint32_t u32FramesCompleted;
+    uint32_t u32FramesDropped;
+} MJPEG_tsDepacketizer;
+
+/****************************************************************************/
+/***        Exported Functions                                            ***/
+/****************************************************************************/
+
+bool_t MJPEG_bInit(MJPEG_tsDepacketizer *psDepacketizer);
+void MJPEG_vDeInit(MJPEG_tsDepacketizer *psDepacketizer);
+bool_t MJPEG_bPushPacket(MJPEG_tsDepacketizer *psDepacketizer, RTP_tsPacket *psPacket, RTP_tsFrame *psFrame);
+bool_t MJPEG_bWriteFrameToFile(RTP_tsFrame *psFrame, char *pcPrefix, uint32_t u32FrameNumber);
+
+#endif // MJPEG_H
+
+/****************************************************************************/
+/***        END OF FILE                                                   ***/
+/****************************************************************************/
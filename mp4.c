@@ -0,0 +1,1177 @@
+/****************************************************************************
+ *
+ * Copyright 2021 Lee Mitchell <lee@indigopepper.com>
+ * This file is part of OCC (Orlaco Camera Configurator)
+ *
+ * OCC (Orlaco Camera Configurator) is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * OCC (Orlaco Camera Configurator) is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with OCC (Orlaco Camera Configurator).  If not,
+ * see <http://www.gnu.org/licenses/>.
+ *
+ ****************************************************************************/
+
+// Needed for O_DIRECT
+#ifdef __linux__
+#define _GNU_SOURCE
+#endif
+
+/****************************************************************************/
+/***        Include files                                                 ***/
+/****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include "common.h"
+#include "mp4.h"
+
+#ifdef _WIN32
+#include <io.h>
+#include <malloc.h>
+#else
+#include <unistd.h>
+#include <sys/stat.h>
+#endif
+
+/****************************************************************************/
+/***        Macro Definitions                                             ***/
+/****************************************************************************/
+
+#define MP4_MAX_INIT_LENGTH             2048
+#define MP4_MAX_MOOF_LENGTH             (128 + 12 * MP4_MAX_FRAGMENT_SAMPLES)
+#define MP4_BOX_HEADER_LENGTH           8
+
+#define MP4_TRACK_ID                    1
+#define MP4_TFHD_DEFAULT_BASE_IS_MOOF   0x020000
+#define MP4_TRUN_FLAGS                  0x000701            // Data offset, sample duration, size and flags present
+#define MP4_SAMPLE_FLAGS_SYNC           0x02000000          // Depends on no other sample
+#define MP4_SAMPLE_FLAGS_NON_SYNC       0x01010000          // Depends on others, not a sync sample
+
+#define MP4_DEFAULT_DURATION            (MP4_TIMESCALE / 25)
+
+/****************************************************************************/
+/***        Type Definitions                                              ***/
+/****************************************************************************/
+
+/****************************************************************************/
+/***        Local Function Prototypes                                     ***/
+/****************************************************************************/
+
+static bool_t MP4_bOpenSegment(MP4_tsRecorder *psRecorder, RTP_tsFrame *psFrame);
+static void MP4_vCloseSegment(MP4_tsRecorder *psRecorder, bool_t bEndKnown, uint64_t u64EndDecodeTime);
+static bool_t MP4_bWriteFragment(MP4_tsRecorder *psRecorder, bool_t bEndKnown, uint64_t u64EndDecodeTime);
+static bool_t MP4_bAddSample(MP4_tsRecorder *psRecorder, RTP_tsFrame *psFrame, uint64_t u64DecodeTime);
+static bool_t MP4_bFindParameterSets(RTP_tsFrame *psFrame, uint8_t **ppu8Sps, uint32_t *pu32SpsLength, uint8_t **ppu8Pps, uint32_t *pu32PpsLength);
+static uint32_t MP4_u32MakeInit(MP4_tsRecorder *psRecorder, uint8_t *pu8Buffer);
+static uint8_t *MP4_pu8Put16(uint8_t *pu8Ptr, uint16_t u16Value);
+static uint8_t *MP4_pu8Put32(uint8_t *pu8Ptr, uint32_t u32Value);
+static uint8_t *MP4_pu8Put64(uint8_t *pu8Ptr, uint64_t u64Value);
+static uint8_t *MP4_pu8PutMatrix(uint8_t *pu8Ptr);
+static uint8_t *MP4_pu8StartBox(uint8_t *pu8Ptr, const char *pcType);
+static uint8_t *MP4_pu8StartFullBox(uint8_t *pu8Ptr, const char *pcType, uint8_t u8Version, uint32_t u32Flags);
+static void MP4_vEndBox(uint8_t *pu8Box, uint8_t *pu8Ptr);
+static void MP4_vPutLittle(uint8_t *pu8Ptr, uint64_t u64Value, uint32_t u32Length);
+static bool_t MP4_bOpenWriter(MP4_tsWriter *psWriter, char *pcFileName, bool_t bDirect);
+static bool_t MP4_bWrite(MP4_tsWriter *psWriter, const uint8_t *pu8Data, uint32_t u32Length);
+static bool_t MP4_bWriteAll(int iFd, const uint8_t *pu8Data, uint32_t u32Length);
+static bool_t MP4_bCloseWriter(MP4_tsWriter *psWriter);
+
+/****************************************************************************/
+/***        Exported Variables                                            ***/
+/****************************************************************************/
+
+/****************************************************************************/
+/***        Local Variables                                               ***/
+/****************************************************************************/
+
+/****************************************************************************/
+/***        Exported Functions                                            ***/
+/****************************************************************************/
+
+/****************************************************************************
+ *
+ * NAME: MP4_bInit
+ *
+ * DESCRIPTION:
+ * Initialises a recorder writing segments of about u32SegmentSeconds to
+ * files named <prefix>_<ip>_<ssrc>_<number>.mp4, optionally bypassing the
+ * page cache with O_DIRECT
+ *
+ * RETURNS:
+ * bool_t TRUE if successful, FALSE otherwise
+ *
+ ****************************************************************************/
+bool_t MP4_bInit(MP4_tsRecorder *psRecorder, char *pcPrefix, uint32_t u32SegmentSeconds, bool_t bDirect)
+{
+    memset(psRecorder, 0, sizeof(MP4_tsRecorder));
+    psRecorder->pcPrefix = pcPrefix;
+    psRecorder->u32SegmentSeconds = (u32SegmentSeconds != 0) ? u32SegmentSeconds : MP4_DEFAULT_SEGMENT_SECONDS;
+    psRecorder->bDirect = bDirect;
+    psRecorder->sWriter.iFd = -1;
+
+    psRecorder->pu8Fragment = (uint8_t*)malloc(MP4_INITIAL_FRAGMENT_LENGTH);
+    if(psRecorder->pu8Fragment == NULL)
+    {
+        printf("Error: Failed to allocate memory for fragment in %s\n", __FUNCTION__);
+        return FALSE;
+    }
+    psRecorder->u32FragmentCapacity = MP4_INITIAL_FRAGMENT_LENGTH;
+
+    return TRUE;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: MP4_vDeInit
+ *
+ * DESCRIPTION:
+ * Writes out the last fragment, closes the segment and frees the recorder
+ *
+ * RETURNS:
+ * void
+ *
+ ****************************************************************************/
+void MP4_vDeInit(MP4_tsRecorder *psRecorder)
+{
+    if(psRecorder->bSegmentOpen)
+    {
+        MP4_vCloseSegment(psRecorder, FALSE, 0);
+    }
+
+    if(psRecorder->pu8Fragment != NULL)
+    {
+        free(psRecorder->pu8Fragment);
+        psRecorder->pu8Fragment = NULL;
+    }
+}
+
+
+/****************************************************************************
+ *
+ * NAME: MP4_bPushFrame
+ *
+ * DESCRIPTION:
+ * Adds an H.264 access unit to the recording. Every key frame starts a new
+ * fragment, and a new segment once the current one is long enough or the
+ * parameter sets change. Frames before the first key frame are skipped.
+ *
+ * RETURNS:
+ * bool_t TRUE if the frame was recorded, FALSE otherwise
+ *
+ ****************************************************************************/
+bool_t MP4_bPushFrame(MP4_tsRecorder *psRecorder, RTP_tsFrame *psFrame)
+{
+    uint8_t *pu8Sps = NULL;
+    uint8_t *pu8Pps = NULL;
+    uint32_t u32SpsLength = 0;
+    uint32_t u32PpsLength = 0;
+    uint64_t u64DecodeTime = 0;
+    int32_t i32Delta;
+    bool_t bParametersChanged = FALSE;
+
+    if(psFrame->eCodec != E_RTP_CODEC_H264)
+    {
+        psRecorder->u32FramesSkipped++;
+        return FALSE;
+    }
+
+    if(psFrame->bKeyFrame && MP4_bFindParameterSets(psFrame, &pu8Sps, &u32SpsLength, &pu8Pps, &u32PpsLength))
+    {
+        bParametersChanged = (u32SpsLength != psRecorder->u32SpsLength) || (memcmp(pu8Sps, psRecorder->au8Sps, u32SpsLength) != 0) ||
+                             (u32PpsLength != psRecorder->u32PpsLength) || (memcmp(pu8Pps, psRecorder->au8Pps, u32PpsLength) != 0);
+    }
+
+    if(psRecorder->bSegmentOpen)
+    {
+        // Timestamps should only go forwards, without B frames decode and presentation order are the same
+        i32Delta = (int32_t)(psFrame->u32Timestamp - psRecorder->u32LastTimestamp);
+        u64DecodeTime = psRecorder->u64DecodeTime + ((i32Delta > 0) ? (uint32_t)i32Delta : 0);
+
+        if(psFrame->bKeyFrame && (bParametersChanged || (u64DecodeTime >= (uint64_t)psRecorder->u32SegmentSeconds * MP4_TIMESCALE)))
+        {
+            MP4_vCloseSegment(psRecorder, TRUE, u64DecodeTime);
+        }
+        else if((psRecorder->u32NumSamples > 0) &&
+                (psFrame->bKeyFrame ||
+                 (psRecorder->u32NumSamples == MP4_MAX_FRAGMENT_SAMPLES) ||
+                 (psRecorder->u32FragmentLength + psFrame->u32Length + 1024 > MP4_MAX_FRAGMENT_LENGTH)))
+        {
+            if(!MP4_bWriteFragment(psRecorder, TRUE, u64DecodeTime))
+            {
+                MP4_vCloseSegment(psRecorder, FALSE, 0);
+                return FALSE;
+            }
+        }
+    }
+
+    if(!psRecorder->bSegmentOpen)
+    {
+        if(pu8Sps == NULL)
+        {
+            psRecorder->u32FramesSkipped++;
+            return FALSE;
+        }
+
+        if((u32SpsLength > H264_MAX_PARAMETER_SET_LENGTH) || (u32PpsLength > H264_MAX_PARAMETER_SET_LENGTH) ||
+           !H264_bParseSps(pu8Sps, u32SpsLength, &psRecorder->sSps))
+        {
+            psRecorder->u32FramesSkipped++;
+            return FALSE;
+        }
+        memcpy(psRecorder->au8Sps, pu8Sps, u32SpsLength);
+        psRecorder->u32SpsLength = u32SpsLength;
+        memcpy(psRecorder->au8Pps, pu8Pps, u32PpsLength);
+        psRecorder->u32PpsLength = u32PpsLength;
+
+        if(!MP4_bOpenSegment(psRecorder, psFrame))
+        {
+            return FALSE;
+        }
+        u64DecodeTime = 0;
+    }
+
+    if(!MP4_bAddSample(psRecorder, psFrame, u64DecodeTime))
+    {
+        psRecorder->u32FramesSkipped++;
+        return FALSE;
+    }
+
+    psRecorder->u32LastTimestamp = psFrame->u32Timestamp;
+    psRecorder->u64DecodeTime = u64DecodeTime;
+
+    return TRUE;
+}
+
+/****************************************************************************/
+/***        Local Functions                                               ***/
+/****************************************************************************/
+
+/****************************************************************************
+ *
+ * NAME: MP4_bOpenSegment
+ *
+ * DESCRIPTION:
+ * Starts a new segment file and its index, writing the initialisation
+ * boxes (ftyp and moov) that describe the stream
+ *
+ * RETURNS:
+ * bool_t TRUE if successful, FALSE otherwise
+ *
+ ****************************************************************************/
+static bool_t MP4_bOpenSegment(MP4_tsRecorder *psRecorder, RTP_tsFrame *psFrame)
+{
+    char acIndexName[MP4_MAX_FILENAME_LENGTH + 8];
+    uint8_t au8Init[MP4_MAX_INIT_LENGTH];
+    uint8_t au8Header[MP4_INDEX_HEADER_LENGTH];
+    uint32_t u32Length;
+#ifndef _WIN32
+    struct timespec sTime;
+#endif
+
+    snprintf(psRecorder->acFileName, sizeof(psRecorder->acFileName), "%s_%d.%d.%d.%d_%08x_%06u.mp4",
+             psRecorder->pcPrefix,
+             psFrame->uSrcIP.au8IP[3],
+             psFrame->uSrcIP.au8IP[2],
+             psFrame->uSrcIP.au8IP[1],
+             psFrame->uSrcIP.au8IP[0],
+             psFrame->u32Ssrc,
+             psRecorder->u32SegmentNumber++);
+
+    if(!MP4_bOpenWriter(&psRecorder->sWriter, psRecorder->acFileName, psRecorder->bDirect))
+    {
+        return FALSE;
+    }
+
+    snprintf(acIndexName, sizeof(acIndexName), "%.*s.idx", (int)(strlen(psRecorder->acFileName) - 4), psRecorder->acFileName);
+    psRecorder->psIndex = fopen(acIndexName, "wb");
+    if(psRecorder->psIndex == NULL)
+    {
+        printf("Error: Failed to open %s in %s\n", acIndexName, __FUNCTION__);
+        MP4_bCloseWriter(&psRecorder->sWriter);
+        return FALSE;
+    }
+
+    MP4_vPutLittle(&au8Header[0], MP4_INDEX_MAGIC, 4);
+    MP4_vPutLittle(&au8Header[4], MP4_INDEX_VERSION, 4);
+    MP4_vPutLittle(&au8Header[8], psFrame->u32Ssrc, 4);
+    MP4_vPutLittle(&au8Header[12], MP4_TIMESCALE, 4);
+    fwrite(au8Header, 1, sizeof(au8Header), psRecorder->psIndex);
+
+    u32Length = MP4_u32MakeInit(psRecorder, au8Init);
+    if(!MP4_bWrite(&psRecorder->sWriter, au8Init, u32Length))
+    {
+        fclose(psRecorder->psIndex);
+        psRecorder->psIndex = NULL;
+        MP4_bCloseWriter(&psRecorder->sWriter);
+        return FALSE;
+    }
+
+    // Index entries carry wall clock times so recordings of different cameras can be lined up
+#ifdef _WIN32
+    psRecorder->i64WallClockOffsetUs = (int64_t)time(NULL) * 1000000LL - (int64_t)RTP_u64GetTimeUs();
+#else
+    clock_gettime(CLOCK_REALTIME, &sTime);
+    psRecorder->i64WallClockOffsetUs = ((int64_t)sTime.tv_sec * 1000000LL + sTime.tv_nsec / 1000) - (int64_t)RTP_u64GetTimeUs();
+#endif
+
+    psRecorder->bSegmentOpen = TRUE;
+    psRecorder->u32FragmentNumber = 1;
+    psRecorder->u32NumSamples = 0;
+    psRecorder->u32FragmentLength = 0;
+    psRecorder->u64DecodeTime = 0;
+    psRecorder->u32LastDuration = MP4_DEFAULT_DURATION;
+    psRecorder->u32Segments++;
+
+    return TRUE;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: MP4_vCloseSegment
+ *
+ * DESCRIPTION:
+ * Writes out any samples still pending and closes the segment and its index
+ *
+ * RETURNS:
+ * void
+ *
+ ****************************************************************************/
+static void MP4_vCloseSegment(MP4_tsRecorder *psRecorder, bool_t bEndKnown, uint64_t u64EndDecodeTime)
+{
+    if(psRecorder->u32NumSamples > 0)
+    {
+        MP4_bWriteFragment(psRecorder, bEndKnown, u64EndDecodeTime);
+    }
+
+    if(!MP4_bCloseWriter(&psRecorder->sWriter))
+    {
+        printf("Error: Failed to write %s in %s\n", psRecorder->acFileName, __FUNCTION__);
+    }
+
+    if(psRecorder->psIndex != NULL)
+    {
+        fclose(psRecorder->psIndex);
+        psRecorder->psIndex = NULL;
+    }
+
+    psRecorder->bSegmentOpen = FALSE;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: MP4_bWriteFragment
+ *
+ * DESCRIPTION:
+ * Writes the pending samples as a movie fragment (moof and mdat), adding an
+ * index entry if it starts with a key frame. The duration of the last sample
+ * is taken from the next one if that is known, or repeated from the one
+ * before it otherwise.
+ *
+ * RETURNS:
+ * bool_t TRUE if successful, FALSE otherwise
+ *
+ ****************************************************************************/
+static bool_t MP4_bWriteFragment(MP4_tsRecorder *psRecorder, bool_t bEndKnown, uint64_t u64EndDecodeTime)
+{
+    uint8_t au8Moof[MP4_MAX_MOOF_LENGTH];
+    uint8_t au8Entry[MP4_INDEX_ENTRY_LENGTH];
+    uint8_t *pu8Ptr = au8Moof;
+    uint8_t *pu8Moof;
+    uint8_t *pu8Traf;
+    uint8_t *pu8Box;
+    uint8_t *pu8DataOffset;
+    uint64_t u64Offset;
+    uint32_t u32Duration;
+    uint32_t u32MoofLength;
+    uint32_t n;
+
+    pu8Moof = pu8Ptr;
+    pu8Ptr = MP4_pu8StartBox(pu8Ptr, "moof");
+
+    pu8Box = pu8Ptr;
+    pu8Ptr = MP4_pu8StartFullBox(pu8Ptr, "mfhd", 0, 0);
+    pu8Ptr = MP4_pu8Put32(pu8Ptr, psRecorder->u32FragmentNumber++);
+    MP4_vEndBox(pu8Box, pu8Ptr);
+
+    pu8Traf = pu8Ptr;
+    pu8Ptr = MP4_pu8StartBox(pu8Ptr, "traf");
+
+    pu8Box = pu8Ptr;
+    pu8Ptr = MP4_pu8StartFullBox(pu8Ptr, "tfhd", 0, MP4_TFHD_DEFAULT_BASE_IS_MOOF);
+    pu8Ptr = MP4_pu8Put32(pu8Ptr, MP4_TRACK_ID);
+    MP4_vEndBox(pu8Box, pu8Ptr);
+
+    pu8Box = pu8Ptr;
+    pu8Ptr = MP4_pu8StartFullBox(pu8Ptr, "tfdt", 1, 0);
+    pu8Ptr = MP4_pu8Put64(pu8Ptr, psRecorder->au64SampleDecodeTime[0]);
+    MP4_vEndBox(pu8Box, pu8Ptr);
+
+    pu8Box = pu8Ptr;
+    pu8Ptr = MP4_pu8StartFullBox(pu8Ptr, "trun", 0, MP4_TRUN_FLAGS);
+    pu8Ptr = MP4_pu8Put32(pu8Ptr, psRecorder->u32NumSamples);
+    pu8DataOffset = pu8Ptr;
+    pu8Ptr = MP4_pu8Put32(pu8Ptr, 0);
+    for(n = 0; n < psRecorder->u32NumSamples; n++)
+    {
+        if(n + 1 < psRecorder->u32NumSamples)
+        {
+            u32Duration = (uint32_t)(psRecorder->au64SampleDecodeTime[n + 1] - psRecorder->au64SampleDecodeTime[n]);
+        }
+        else if(bEndKnown)
+        {
+            u32Duration = (uint32_t)(u64EndDecodeTime - psRecorder->au64SampleDecodeTime[n]);
+        }
+        else
+        {
+            u32Duration = psRecorder->u32LastDuration;
+        }
+        if(u32Duration != 0)
+        {
+            psRecorder->u32LastDuration = u32Duration;
+        }
+        pu8Ptr = MP4_pu8Put32(pu8Ptr, u32Duration);
+        pu8Ptr = MP4_pu8Put32(pu8Ptr, psRecorder->au32SampleLength[n]);
+        pu8Ptr = MP4_pu8Put32(pu8Ptr, psRecorder->abSampleKeyFrame[n] ? MP4_SAMPLE_FLAGS_SYNC : MP4_SAMPLE_FLAGS_NON_SYNC);
+    }
+    MP4_vEndBox(pu8Box, pu8Ptr);
+
+    MP4_vEndBox(pu8Traf, pu8Ptr);
+    MP4_vEndBox(pu8Moof, pu8Ptr);
+
+    // The sample data follows the mdat header, straight after the moof
+    u32MoofLength = (uint32_t)(pu8Ptr - au8Moof);
+    MP4_pu8Put32(pu8DataOffset, u32MoofLength + MP4_BOX_HEADER_LENGTH);
+    pu8Ptr = MP4_pu8Put32(pu8Ptr, MP4_BOX_HEADER_LENGTH + psRecorder->u32FragmentLength);
+    memcpy(pu8Ptr, "mdat", 4);
+    pu8Ptr += 4;
+
+    u64Offset = psRecorder->sWriter.u64Flushed + psRecorder->sWriter.u32Fill;
+
+    if(!MP4_bWrite(&psRecorder->sWriter, au8Moof, (uint32_t)(pu8Ptr - au8Moof)) ||
+       !MP4_bWrite(&psRecorder->sWriter, psRecorder->pu8Fragment, psRecorder->u32FragmentLength))
+    {
+        printf("Error: Failed to write %s in %s\n", psRecorder->acFileName, __FUNCTION__);
+        psRecorder->u32NumSamples = 0;
+        psRecorder->u32FragmentLength = 0;
+        return FALSE;
+    }
+    psRecorder->u64Bytes += (uint64_t)(pu8Ptr - au8Moof) + psRecorder->u32FragmentLength;
+
+    if(psRecorder->abSampleKeyFrame[0] && (psRecorder->psIndex != NULL))
+    {
+        MP4_vPutLittle(&au8Entry[0], u64Offset, 8);
+        MP4_vPutLittle(&au8Entry[8], (uint64_t)((int64_t)psRecorder->u64FirstArrivalTimeUs + psRecorder->i64WallClockOffsetUs), 8);
+        MP4_vPutLittle(&au8Entry[16], psRecorder->u32FirstTimestamp, 4);
+        MP4_vPutLittle(&au8Entry[20], (uint32_t)psRecorder->au64SampleDecodeTime[0], 4);
+        fwrite(au8Entry, 1, sizeof(au8Entry), psRecorder->psIndex);
+    }
+
+    psRecorder->u32NumSamples = 0;
+    psRecorder->u32FragmentLength = 0;
+
+    return TRUE;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: MP4_bAddSample
+ *
+ * DESCRIPTION:
+ * Appends an access unit to the pending fragment, converting its NAL units
+ * from Annex B to the length prefixed form MP4 uses. Parameter sets and
+ * access unit delimiters are left out as the sample entry describes them.
+ *
+ * RETURNS:
+ * bool_t TRUE if successful, FALSE if the fragment has no room for it
+ *
+ ****************************************************************************/
+static bool_t MP4_bAddSample(MP4_tsRecorder *psRecorder, RTP_tsFrame *psFrame, uint64_t u64DecodeTime)
+{
+    uint32_t u32Start = psRecorder->u32FragmentLength;
+    uint32_t u32Offset = 0;
+    uint32_t u32NalLength;
+    uint32_t u32NewCapacity;
+    uint8_t *pu8NewFragment;
+    uint8_t *pu8Nal;
+
+    // Each start code is replaced by a length of at most the same size, plus one for three byte start codes
+    if(u32Start + psFrame->u32Length + psFrame->u32Length / 3 > psRecorder->u32FragmentCapacity)
+    {
+        u32NewCapacity = psRecorder->u32FragmentCapacity;
+        while(u32NewCapacity < u32Start + psFrame->u32Length + psFrame->u32Length / 3)
+        {
+            u32NewCapacity *= 2;
+        }
+        if(u32NewCapacity > MP4_MAX_FRAGMENT_LENGTH * 2)
+        {
+            return FALSE;
+        }
+        pu8NewFragment = (uint8_t*)realloc(psRecorder->pu8Fragment, u32NewCapacity);
+        if(pu8NewFragment == NULL)
+        {
+            return FALSE;
+        }
+        psRecorder->pu8Fragment = pu8NewFragment;
+        psRecorder->u32FragmentCapacity = u32NewCapacity;
+    }
+
+    while((pu8Nal = H264_pu8NextNal(psFrame->pu8Data, psFrame->u32Length, &u32Offset, &u32NalLength)) != NULL)
+    {
+        switch(pu8Nal[0] & 0x1f)
+        {
+        case H264_NAL_TYPE_SPS:
+        case H264_NAL_TYPE_PPS:
+        case H264_NAL_TYPE_AUD:
+            break;
+
+        default:
+            MP4_pu8Put32(psRecorder->pu8Fragment + psRecorder->u32FragmentLength, u32NalLength);
+            memcpy(psRecorder->pu8Fragment + psRecorder->u32FragmentLength + 4, pu8Nal, u32NalLength);
+            psRecorder->u32FragmentLength += 4 + u32NalLength;
+            break;
+        }
+    }
+
+    if(psRecorder->u32FragmentLength == u32Start)
+    {
+        return FALSE;
+    }
+
+    if(psRecorder->u32NumSamples == 0)
+    {
+        psRecorder->u32FirstTimestamp = psFrame->u32Timestamp;
+        psRecorder->u64FirstArrivalTimeUs = psFrame->u64ArrivalTimeUs;
+    }
+    psRecorder->au32SampleLength[psRecorder->u32NumSamples] = psRecorder->u32FragmentLength - u32Start;
+    psRecorder->au64SampleDecodeTime[psRecorder->u32NumSamples] = u64DecodeTime;
+    psRecorder->abSampleKeyFrame[psRecorder->u32NumSamples] = psFrame->bKeyFrame;
+    psRecorder->u32NumSamples++;
+
+    return TRUE;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: MP4_bFindParameterSets
+ *
+ * DESCRIPTION:
+ * Finds the SPS and PPS in an access unit
+ *
+ * RETURNS:
+ * bool_t TRUE if both were found, FALSE otherwise
+ *
+ ****************************************************************************/
+static bool_t MP4_bFindParameterSets(RTP_tsFrame *psFrame, uint8_t **ppu8Sps, uint32_t *pu32SpsLength, uint8_t **ppu8Pps, uint32_t *pu32PpsLength)
+{
+    uint32_t u32Offset = 0;
+    uint32_t u32NalLength;
+    uint8_t *pu8Nal;
+
+    *ppu8Sps = NULL;
+    *ppu8Pps = NULL;
+
+    while((pu8Nal = H264_pu8NextNal(psFrame->pu8Data, psFrame->u32Length, &u32Offset, &u32NalLength)) != NULL)
+    {
+        switch(pu8Nal[0] & 0x1f)
+        {
+        case H264_NAL_TYPE_SPS:
+            *ppu8Sps = pu8Nal;
+            *pu32SpsLength = u32NalLength;
+            break;
+
+        case H264_NAL_TYPE_PPS:
+            *ppu8Pps = pu8Nal;
+            *pu32PpsLength = u32NalLength;
+            break;
+
+        case H264_NAL_TYPE_SLICE:
+        case H264_NAL_TYPE_IDR:
+            // Parameter sets precede the slices
+            u32Offset = psFrame->u32Length;
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    if((*ppu8Sps == NULL) || (*ppu8Pps == NULL))
+    {
+        *ppu8Sps = NULL;
+        *ppu8Pps = NULL;
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: MP4_u32MakeInit
+ *
+ * DESCRIPTION:
+ * Builds the ftyp and moov boxes of a segment, describing a single video
+ * track with no samples of its own and an avcC from the parameter sets
+ *
+ * RETURNS:
+ * uint32_t The length of the boxes
+ *
+ ****************************************************************************/
+static uint32_t MP4_u32MakeInit(MP4_tsRecorder *psRecorder, uint8_t *pu8Buffer)
+{
+    uint8_t *pu8Ptr = pu8Buffer;
+    uint8_t *apu8Box[8];
+    H264_tsSps *psSps = &psRecorder->sSps;
+
+    apu8Box[0] = pu8Ptr;
+    pu8Ptr = MP4_pu8StartBox(pu8Ptr, "ftyp");
+    memcpy(pu8Ptr, "iso5", 4);
+    pu8Ptr = MP4_pu8Put32(pu8Ptr + 4, 0x200);
+    memcpy(pu8Ptr, "iso5iso6avc1mp41", 16);
+    pu8Ptr += 16;
+    MP4_vEndBox(apu8Box[0], pu8Ptr);
+
+    apu8Box[0] = pu8Ptr;
+    pu8Ptr = MP4_pu8StartBox(pu8Ptr, "moov");
+
+    // Movie header, the duration is unknown as it is spread over the fragments
+    apu8Box[1] = pu8Ptr;
+    pu8Ptr = MP4_pu8StartFullBox(pu8Ptr, "mvhd", 0, 0);
+    pu8Ptr = MP4_pu8Put32(pu8Ptr, 0);                           // Creation time
+    pu8Ptr = MP4_pu8Put32(pu8Ptr, 0);                           // Modification time
+    pu8Ptr = MP4_pu8Put32(pu8Ptr, 1000);                        // Timescale
+    pu8Ptr = MP4_pu8Put32(pu8Ptr, 0);                           // Duration
+    pu8Ptr = MP4_pu8Put32(pu8Ptr, 0x00010000);                  // Rate 1.0
+    pu8Ptr = MP4_pu8Put16(pu8Ptr, 0x0100);                      // Volume 1.0
+    memset(pu8Ptr, 0, 10);
+    pu8Ptr = MP4_pu8PutMatrix(pu8Ptr + 10);
+    memset(pu8Ptr, 0, 24);
+    pu8Ptr = MP4_pu8Put32(pu8Ptr + 24, MP4_TRACK_ID + 1);       // Next track ID
+    MP4_vEndBox(apu8Box[1], pu8Ptr);
+
+    apu8Box[1] = pu8Ptr;
+    pu8Ptr = MP4_pu8StartBox(pu8Ptr, "trak");
+
+    apu8Box[2] = pu8Ptr;
+    pu8Ptr = MP4_pu8StartFullBox(pu8Ptr, "tkhd", 0, 0x000003); // Enabled, in movie
+    pu8Ptr = MP4_pu8Put32(pu8Ptr, 0);
+    pu8Ptr = MP4_pu8Put32(pu8Ptr, 0);
+    pu8Ptr = MP4_pu8Put32(pu8Ptr, MP4_TRACK_ID);
+    pu8Ptr = MP4_pu8Put32(pu8Ptr, 0);
+    pu8Ptr = MP4_pu8Put32(pu8Ptr, 0);                           // Duration
+    memset(pu8Ptr, 0, 16);                                      // Reserved, layer, alternate group, volume
+    pu8Ptr = MP4_pu8PutMatrix(pu8Ptr + 16);
+    pu8Ptr = MP4_pu8Put32(pu8Ptr, (uint32_t)psSps->u16Width << 16);
+    pu8Ptr = MP4_pu8Put32(pu8Ptr, (uint32_t)psSps->u16Height << 16);
+    MP4_vEndBox(apu8Box[2], pu8Ptr);
+
+    apu8Box[2] = pu8Ptr;
+    pu8Ptr = MP4_pu8StartBox(pu8Ptr, "mdia");
+
+    apu8Box[3] = pu8Ptr;
+    pu8Ptr = MP4_pu8StartFullBox(pu8Ptr, "mdhd", 0, 0);
+    pu8Ptr = MP4_pu8Put32(pu8Ptr, 0);
+    pu8Ptr = MP4_pu8Put32(pu8Ptr, 0);
+    pu8Ptr = MP4_pu8Put32(pu8Ptr, MP4_TIMESCALE);
+    pu8Ptr = MP4_pu8Put32(pu8Ptr, 0);
+    pu8Ptr = MP4_pu8Put16(pu8Ptr, 0x55c4);                      // Language "und"
+    pu8Ptr = MP4_pu8Put16(pu8Ptr, 0);
+    MP4_vEndBox(apu8Box[3], pu8Ptr);
+
+    apu8Box[3] = pu8Ptr;
+    pu8Ptr = MP4_pu8StartFullBox(pu8Ptr, "hdlr", 0, 0);
+    pu8Ptr = MP4_pu8Put32(pu8Ptr, 0);
+    memcpy(pu8Ptr, "vide", 4);
+    memset(pu8Ptr + 4, 0, 12);
+    memcpy(pu8Ptr + 16, "VideoHandler", 13);
+    pu8Ptr += 29;
+    MP4_vEndBox(apu8Box[3], pu8Ptr);
+
+    apu8Box[3] = pu8Ptr;
+    pu8Ptr = MP4_pu8StartBox(pu8Ptr, "minf");
+
+    apu8Box[4] = pu8Ptr;
+    pu8Ptr = MP4_pu8StartFullBox(pu8Ptr, "vmhd", 0, 1);
+    memset(pu8Ptr, 0, 8);                                       // Graphics mode and opcolor
+    pu8Ptr += 8;
+    MP4_vEndBox(apu8Box[4], pu8Ptr);
+
+    apu8Box[4] = pu8Ptr;
+    pu8Ptr = MP4_pu8StartBox(pu8Ptr, "dinf");
+    apu8Box[5] = pu8Ptr;
+    pu8Ptr = MP4_pu8StartFullBox(pu8Ptr, "dref", 0, 0);
+    pu8Ptr = MP4_pu8Put32(pu8Ptr, 1);
+    apu8Box[6] = pu8Ptr;
+    pu8Ptr = MP4_pu8StartFullBox(pu8Ptr, "url ", 0, 1);         // Media data is in this file
+    MP4_vEndBox(apu8Box[6], pu8Ptr);
+    MP4_vEndBox(apu8Box[5], pu8Ptr);
+    MP4_vEndBox(apu8Box[4], pu8Ptr);
+
+    apu8Box[4] = pu8Ptr;
+    pu8Ptr = MP4_pu8StartBox(pu8Ptr, "stbl");
+
+    apu8Box[5] = pu8Ptr;
+    pu8Ptr = MP4_pu8StartFullBox(pu8Ptr, "stsd", 0, 0);
+    pu8Ptr = MP4_pu8Put32(pu8Ptr, 1);
+
+    apu8Box[6] = pu8Ptr;
+    pu8Ptr = MP4_pu8StartBox(pu8Ptr, "avc1");
+    memset(pu8Ptr, 0, 6);
+    pu8Ptr = MP4_pu8Put16(pu8Ptr + 6, 1);                       // Data reference index
+    memset(pu8Ptr, 0, 16);
+    pu8Ptr = MP4_pu8Put16(pu8Ptr + 16, psSps->u16Width);
+    pu8Ptr = MP4_pu8Put16(pu8Ptr, psSps->u16Height);
+    pu8Ptr = MP4_pu8Put32(pu8Ptr, 0x00480000);                  // 72 dpi
+    pu8Ptr = MP4_pu8Put32(pu8Ptr, 0x00480000);
+    pu8Ptr = MP4_pu8Put32(pu8Ptr, 0);
+    pu8Ptr = MP4_pu8Put16(pu8Ptr, 1);                           // Frame count
+    memset(pu8Ptr, 0, 32);                                      // Compressor name
+    pu8Ptr = MP4_pu8Put16(pu8Ptr + 32, 0x0018);                 // Depth
+    pu8Ptr = MP4_pu8Put16(pu8Ptr, 0xffff);
+
+    apu8Box[7] = pu8Ptr;
+    pu8Ptr = MP4_pu8StartBox(pu8Ptr, "avcC");
+    *pu8Ptr++ = 1;                                              // Configuration version
+    *pu8Ptr++ = psRecorder->au8Sps[1];                          // Profile
+    *pu8Ptr++ = psRecorder->au8Sps[2];                          // Profile compatibility
+    *pu8Ptr++ = psRecorder->au8Sps[3];                          // Level
+    *pu8Ptr++ = 0xff;                                           // 4 byte NAL unit lengths
+    *pu8Ptr++ = 0xe1;                                           // One SPS
+    pu8Ptr = MP4_pu8Put16(pu8Ptr, (uint16_t)psRecorder->u32SpsLength);
+    memcpy(pu8Ptr, psRecorder->au8Sps, psRecorder->u32SpsLength);
+    pu8Ptr += psRecorder->u32SpsLength;
+    *pu8Ptr++ = 1;                                              // One PPS
+    pu8Ptr = MP4_pu8Put16(pu8Ptr, (uint16_t)psRecorder->u32PpsLength);
+    memcpy(pu8Ptr, psRecorder->au8Pps, psRecorder->u32PpsLength);
+    pu8Ptr += psRecorder->u32PpsLength;
+    if((psSps->u8Profile == 100) || (psSps->u8Profile == 110) || (psSps->u8Profile == 122) || (psSps->u8Profile == 144))
+    {
+        *pu8Ptr++ = (uint8_t)(0xfc | psSps->u8ChromaFormat);
+        *pu8Ptr++ = (uint8_t)(0xf8 | (psSps->u8BitDepthLuma - 8));
+        *pu8Ptr++ = (uint8_t)(0xf8 | (psSps->u8BitDepthChroma - 8));
+        *pu8Ptr++ = 0;                                          // No SPS extensions
+    }
+    MP4_vEndBox(apu8Box[7], pu8Ptr);
+    MP4_vEndBox(apu8Box[6], pu8Ptr);
+    MP4_vEndBox(apu8Box[5], pu8Ptr);
+
+    // The sample tables are empty, the samples are described by the fragments
+    apu8Box[5] = pu8Ptr;
+    pu8Ptr = MP4_pu8StartFullBox(pu8Ptr, "stts", 0, 0);
+    pu8Ptr = MP4_pu8Put32(pu8Ptr, 0);
+    MP4_vEndBox(apu8Box[5], pu8Ptr);
+    apu8Box[5] = pu8Ptr;
+    pu8Ptr = MP4_pu8StartFullBox(pu8Ptr, "stsc", 0, 0);
+    pu8Ptr = MP4_pu8Put32(pu8Ptr, 0);
+    MP4_vEndBox(apu8Box[5], pu8Ptr);
+    apu8Box[5] = pu8Ptr;
+    pu8Ptr = MP4_pu8StartFullBox(pu8Ptr, "stsz", 0, 0);
+    pu8Ptr = MP4_pu8Put32(pu8Ptr, 0);
+    pu8Ptr = MP4_pu8Put32(pu8Ptr, 0);
+    MP4_vEndBox(apu8Box[5], pu8Ptr);
+    apu8Box[5] = pu8Ptr;
+    pu8Ptr = MP4_pu8StartFullBox(pu8Ptr, "stco", 0, 0);
+    pu8Ptr = MP4_pu8Put32(pu8Ptr, 0);
+    MP4_vEndBox(apu8Box[5], pu8Ptr);
+
+    MP4_vEndBox(apu8Box[4], pu8Ptr);                            // stbl
+    MP4_vEndBox(apu8Box[3], pu8Ptr);                            // minf
+    MP4_vEndBox(apu8Box[2], pu8Ptr);                            // mdia
+    MP4_vEndBox(apu8Box[1], pu8Ptr);                            // trak
+
+    apu8Box[1] = pu8Ptr;
+    pu8Ptr = MP4_pu8StartBox(pu8Ptr, "mvex");
+    apu8Box[2] = pu8Ptr;
+    pu8Ptr = MP4_pu8StartFullBox(pu8Ptr, "trex", 0, 0);
+    pu8Ptr = MP4_pu8Put32(pu8Ptr, MP4_TRACK_ID);
+    pu8Ptr = MP4_pu8Put32(pu8Ptr, 1);                           // Sample description index
+    pu8Ptr = MP4_pu8Put32(pu8Ptr, 0);
+    pu8Ptr = MP4_pu8Put32(pu8Ptr, 0);
+    pu8Ptr = MP4_pu8Put32(pu8Ptr, 0);
+    MP4_vEndBox(apu8Box[2], pu8Ptr);
+    MP4_vEndBox(apu8Box[1], pu8Ptr);
+
+    MP4_vEndBox(apu8Box[0], pu8Ptr);                            // moov
+
+    return (uint32_t)(pu8Ptr - pu8Buffer);
+}
+
+
+/****************************************************************************
+ *
+ * NAME: MP4_pu8Put16
+ *
+ * DESCRIPTION:
+ * Stores a 16 bit big endian value
+ *
+ * RETURNS:
+ * uint8_t * - The position after the value
+ *
+ ****************************************************************************/
+static uint8_t *MP4_pu8Put16(uint8_t *pu8Ptr, uint16_t u16Value)
+{
+    pu8Ptr[0] = (uint8_t)(u16Value >> 8);
+    pu8Ptr[1] = (uint8_t)u16Value;
+
+    return pu8Ptr + 2;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: MP4_pu8Put32
+ *
+ * DESCRIPTION:
+ * Stores a 32 bit big endian value
+ *
+ * RETURNS:
+ * uint8_t * - The position after the value
+ *
+ ****************************************************************************/
+static uint8_t *MP4_pu8Put32(uint8_t *pu8Ptr, uint32_t u32Value)
+{
+    pu8Ptr[0] = (uint8_t)(u32Value >> 24);
+    pu8Ptr[1] = (uint8_t)(u32Value >> 16);
+    pu8Ptr[2] = (uint8_t)(u32Value >> 8);
+    pu8Ptr[3] = (uint8_t)u32Value;
+
+    return pu8Ptr + 4;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: MP4_pu8Put64
+ *
+ * DESCRIPTION:
+ * Stores a 64 bit big endian value
+ *
+ * RETURNS:
+ * uint8_t * - The position after the value
+ *
+ ****************************************************************************/
+static uint8_t *MP4_pu8Put64(uint8_t *pu8Ptr, uint64_t u64Value)
+{
+    pu8Ptr = MP4_pu8Put32(pu8Ptr, (uint32_t)(u64Value >> 32));
+
+    return MP4_pu8Put32(pu8Ptr, (uint32_t)u64Value);
+}
+
+
+/****************************************************************************
+ *
+ * NAME: MP4_pu8PutMatrix
+ *
+ * DESCRIPTION:
+ * Stores the identity transformation matrix of the movie and track headers
+ *
+ * RETURNS:
+ * uint8_t * - The position after the matrix
+ *
+ ****************************************************************************/
+static uint8_t *MP4_pu8PutMatrix(uint8_t *pu8Ptr)
+{
+    static const uint32_t au32Matrix[9] = { 0x00010000, 0, 0, 0, 0x00010000, 0, 0, 0, 0x40000000 };
+    int n;
+
+    for(n = 0; n < 9; n++)
+    {
+        pu8Ptr = MP4_pu8Put32(pu8Ptr, au32Matrix[n]);
+    }
+
+    return pu8Ptr;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: MP4_pu8StartBox
+ *
+ * DESCRIPTION:
+ * Starts a box, its size is filled in by MP4_vEndBox
+ *
+ * RETURNS:
+ * uint8_t * - The position of the box contents
+ *
+ ****************************************************************************/
+static uint8_t *MP4_pu8StartBox(uint8_t *pu8Ptr, const char *pcType)
+{
+    memcpy(pu8Ptr + 4, pcType, 4);
+
+    return pu8Ptr + MP4_BOX_HEADER_LENGTH;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: MP4_pu8StartFullBox
+ *
+ * DESCRIPTION:
+ * Starts a box with a version and flags
+ *
+ * RETURNS:
+ * uint8_t * - The position of the box contents
+ *
+ ****************************************************************************/
+static uint8_t *MP4_pu8StartFullBox(uint8_t *pu8Ptr, const char *pcType, uint8_t u8Version, uint32_t u32Flags)
+{
+    pu8Ptr = MP4_pu8StartBox(pu8Ptr, pcType);
+
+    return MP4_pu8Put32(pu8Ptr, ((uint32_t)u8Version << 24) | (u32Flags & 0x00ffffff));
+}
+
+
+/****************************************************************************
+ *
+ * NAME: MP4_vEndBox
+ *
+ * DESCRIPTION:
+ * Fills in the size of a box that started at pu8Box and ends at pu8Ptr
+ *
+ * RETURNS:
+ * void
+ *
+ ****************************************************************************/
+static void MP4_vEndBox(uint8_t *pu8Box, uint8_t *pu8Ptr)
+{
+    MP4_pu8Put32(pu8Box, (uint32_t)(pu8Ptr - pu8Box));
+}
+
+
+/****************************************************************************
+ *
+ * NAME: MP4_vPutLittle
+ *
+ * DESCRIPTION:
+ * Stores a little endian value of u32Length bytes for the side index
+ *
+ * RETURNS:
+ * void
+ *
+ ****************************************************************************/
+static void MP4_vPutLittle(uint8_t *pu8Ptr, uint64_t u64Value, uint32_t u32Length)
+{
+    uint32_t n;
+
+    for(n = 0; n < u32Length; n++)
+    {
+        pu8Ptr[n] = (uint8_t)(u64Value >> (8 * n));
+    }
+}
+
+
+/****************************************************************************
+ *
+ * NAME: MP4_bOpenWriter
+ *
+ * DESCRIPTION:
+ * Creates a file and an aligned buffer for writing it. If O_DIRECT is
+ * requested but the file system doesn't support it, buffered I/O is used.
+ *
+ * RETURNS:
+ * bool_t TRUE if successful, FALSE otherwise
+ *
+ ****************************************************************************/
+static bool_t MP4_bOpenWriter(MP4_tsWriter *psWriter, char *pcFileName, bool_t bDirect)
+{
+    int iFlags = O_WRONLY | O_CREAT | O_TRUNC;
+
+    memset(psWriter, 0, sizeof(MP4_tsWriter));
+    psWriter->iFd = -1;
+
+#ifdef _WIN32
+    iFlags |= O_BINARY;
+    psWriter->pu8Buffer = (uint8_t*)_aligned_malloc(MP4_WRITE_BUFFER_LENGTH, MP4_WRITE_ALIGNMENT);
+#else
+    if(posix_memalign((void**)&psWriter->pu8Buffer, MP4_WRITE_ALIGNMENT, MP4_WRITE_BUFFER_LENGTH) != 0)
+    {
+        psWriter->pu8Buffer = NULL;
+    }
+#endif
+    if(psWriter->pu8Buffer == NULL)
+    {
+        printf("Error: Failed to allocate memory for write buffer in %s\n", __FUNCTION__);
+        return FALSE;
+    }
+
+#ifdef __linux__
+    if(bDirect)
+    {
+        psWriter->iFd = open(pcFileName, iFlags | O_DIRECT, 0644);
+        if((psWriter->iFd < 0) && (errno == EINVAL))
+        {
+            printf("Warning: O_DIRECT isn't supported for %s, using buffered writes\n", pcFileName);
+        }
+        psWriter->bDirect = (psWriter->iFd >= 0);
+    }
+#else
+    if(bDirect)
+    {
+        printf("Warning: O_DIRECT is only supported on Linux, using buffered writes\n");
+    }
+#endif
+
+    if(psWriter->iFd < 0)
+    {
+        psWriter->iFd = open(pcFileName, iFlags, 0644);
+    }
+    if(psWriter->iFd < 0)
+    {
+        printf("Error: Failed to open %s in %s\n", pcFileName, __FUNCTION__);
+#ifdef _WIN32
+        _aligned_free(psWriter->pu8Buffer);
+#else
+        free(psWriter->pu8Buffer);
+#endif
+        psWriter->pu8Buffer = NULL;
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: MP4_bWrite
+ *
+ * DESCRIPTION:
+ * Adds data to the write buffer, writing the buffer out whenever it fills
+ *
+ * RETURNS:
+ * bool_t TRUE if successful, FALSE otherwise
+ *
+ ****************************************************************************/
+static bool_t MP4_bWrite(MP4_tsWriter *psWriter, const uint8_t *pu8Data, uint32_t u32Length)
+{
+    uint32_t u32Chunk;
+
+    while(u32Length > 0)
+    {
+        u32Chunk = MP4_WRITE_BUFFER_LENGTH - psWriter->u32Fill;
+        if(u32Chunk > u32Length)
+        {
+            u32Chunk = u32Length;
+        }
+        memcpy(psWriter->pu8Buffer + psWriter->u32Fill, pu8Data, u32Chunk);
+        psWriter->u32Fill += u32Chunk;
+        pu8Data += u32Chunk;
+        u32Length -= u32Chunk;
+
+        if(psWriter->u32Fill == MP4_WRITE_BUFFER_LENGTH)
+        {
+            if(!MP4_bWriteAll(psWriter->iFd, psWriter->pu8Buffer, MP4_WRITE_BUFFER_LENGTH))
+            {
+                return FALSE;
+            }
+            psWriter->u64Flushed += MP4_WRITE_BUFFER_LENGTH;
+            psWriter->u32Fill = 0;
+        }
+    }
+
+    return TRUE;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: MP4_bWriteAll
+ *
+ * DESCRIPTION:
+ * Writes a block of data, retrying partial and interrupted writes
+ *
+ * RETURNS:
+ * bool_t TRUE if successful, FALSE otherwise
+ *
+ ****************************************************************************/
+static bool_t MP4_bWriteAll(int iFd, const uint8_t *pu8Data, uint32_t u32Length)
+{
+    int iWritten;
+
+    while(u32Length > 0)
+    {
+        iWritten = (int)write(iFd, pu8Data, u32Length);
+        if(iWritten < 0)
+        {
+            if(errno == EINTR)
+            {
+                continue;
+            }
+            return FALSE;
+        }
+        pu8Data += iWritten;
+        u32Length -= (uint32_t)iWritten;
+    }
+
+    return TRUE;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: MP4_bCloseWriter
+ *
+ * DESCRIPTION:
+ * Writes out what is left in the buffer and closes the file. The tail is
+ * usually not a multiple of the alignment, so O_DIRECT is turned off for it.
+ *
+ * RETURNS:
+ * bool_t TRUE if successful, FALSE otherwise
+ *
+ ****************************************************************************/
+static bool_t MP4_bCloseWriter(MP4_tsWriter *psWriter)
+{
+    bool_t bOk = TRUE;
+
+    if(psWriter->iFd < 0)
+    {
+        return TRUE;
+    }
+
+    if(psWriter->u32Fill > 0)
+    {
+#ifdef __linux__
+        if(psWriter->bDirect && (psWriter->u32Fill % MP4_WRITE_ALIGNMENT != 0))
+        {
+            fcntl(psWriter->iFd, F_SETFL, fcntl(psWriter->iFd, F_GETFL) & ~O_DIRECT);
+        }
+#endif
+        bOk = MP4_bWriteAll(psWriter->iFd, psWriter->pu8Buffer, psWriter->u32Fill);
+        psWriter->u64Flushed += psWriter->u32Fill;
+        psWriter->u32Fill = 0;
+    }
+
+    close(psWriter->iFd);
+    psWriter->iFd = -1;
+
+#ifdef _WIN32
+    _aligned_free(psWriter->pu8Buffer);
+#else
+    free(psWriter->pu8Buffer);
+#endif
+    psWriter->pu8Buffer = NULL;
+
+    return bOk;
+}
+
+/****************************************************************************/
+/***        END OF FILE                                                   ***/
+/****************************************************************************/
@@ -0,0 +1,106 @@
+#ifndef MP4_H
+#define MP4_H
+
+/****************************************************************************/
+/***        Include files                                                 ***/
+/****************************************************************************/
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "common.h"
+#include "rtp.h"
+#include "h264.h"
+
+/****************************************************************************/
+/***        Macro Definitions                                             ***/
+/****************************************************************************/
+
+#define MP4_TIMESCALE                   90000               // The RTP clock, so sample times need no conversion
+#define MP4_DEFAULT_SEGMENT_SECONDS     60
+#define MP4_WRITE_ALIGNMENT             4096                // Buffer address, file offset and length alignment for O_DIRECT
+#define MP4_WRITE_BUFFER_LENGTH         (1024 * 1024)       // Data is written in chunks of this size
+#define MP4_MAX_FRAGMENT_SAMPLES        256
+#define MP4_INITIAL_FRAGMENT_LENGTH     (1024 * 1024)
+#define MP4_MAX_FRAGMENT_LENGTH         (16 * 1024 * 1024)
+#define MP4_MAX_FILENAME_LENGTH         256
+
+#define MP4_INDEX_MAGIC                 0x58444943          // "CIDX"
+#define MP4_INDEX_VERSION               1
+#define MP4_INDEX_HEADER_LENGTH         16
+#define MP4_INDEX_ENTRY_LENGTH          24
+
+/****************************************************************************/
+/***        Type Definitions                                              ***/
+/****************************************************************************/
+
+// Every segment <name>.mp4 has a side index <name>.idx, all fields little endian:
+//   header: u32 magic, u32 version, u32 SSRC, u32 timescale
+//   entry:  u64 file offset of the moof holding the key frame, u64 arrival time in us since the epoch,
+//           u32 RTP timestamp, u32 decode time since the start of the segment in timescale units
+// Entries are in stream order, so a key frame can be found with a binary search
+// and playback started from its moof without reading the segment.
+
+// Buffered writer that only issues aligned writes of MP4_WRITE_BUFFER_LENGTH, so the file can be opened with O_DIRECT
+typedef struct {
+    int iFd;
+    bool_t bDirect;
+    uint8_t *pu8Buffer;                             // Aligned to MP4_WRITE_ALIGNMENT
+    uint32_t u32Fill;
+    uint64_t u64Flushed;                            // Bytes written to the file, the logical position is this plus u32Fill
+} MP4_tsWriter;
+
+// Muxes the H.264 access units of one stream into fragmented MP4 segments
+typedef struct {
+    char *pcPrefix;
+    uint32_t u32SegmentSeconds;
+    bool_t bDirect;
+
+    // Parameter sets of the open segment, a change of either starts a new one
+    uint8_t au8Sps[H264_MAX_PARAMETER_SET_LENGTH];
+    uint32_t u32SpsLength;
+    uint8_t au8Pps[H264_MAX_PARAMETER_SET_LENGTH];
+    uint32_t u32PpsLength;
+    H264_tsSps sSps;
+
+    bool_t bSegmentOpen;
+    MP4_tsWriter sWriter;
+    FILE *psIndex;
+    char acFileName[MP4_MAX_FILENAME_LENGTH];
+    uint32_t u32SegmentNumber;
+    uint32_t u32FragmentNumber;                     // Sequence number of the next moof
+    uint32_t u32LastTimestamp;
+    uint64_t u64DecodeTime;                         // Of the last sample, since the start of the segment
+    int64_t i64WallClockOffsetUs;                   // Converts arrival times to time since the epoch for the index
+
+    // Samples of the fragment being built, with the length prefixed access units in pu8Fragment
+    uint8_t *pu8Fragment;
+    uint32_t u32FragmentCapacity;
+    uint32_t u32FragmentLength;
+    uint32_t u32NumSamples;
+    uint32_t au32SampleLength[MP4_MAX_FRAGMENT_SAMPLES];
+    uint64_t au64SampleDecodeTime[MP4_MAX_FRAGMENT_SAMPLES];
+    bool_t abSampleKeyFrame[MP4_MAX_FRAGMENT_SAMPLES];
+    uint32_t u32FirstTimestamp;                     // RTP timestamp and arrival time of the fragment's first sample
+    uint64_t u64FirstArrivalTimeUs;
+    uint32_t u32LastDuration;
+
+    uint64_t u64Bytes;
+    uint32_t u32Segments;
+    uint32_t u32FramesSkipped;                      // Before the first key frame, or not H.264
+} MP4_tsRecorder;
+
+/****************************************************************************/
+/***        Exported Functions                                            ***/
+/****************************************************************************/
+
+bool_t MP4_bInit(MP4_tsRecorder *psRecorder, char *pcPrefix, uint32_t u32SegmentSeconds, bool_t bDirect);
+void MP4_vDeInit(MP4_tsRecorder *psRecorder);
+bool_t MP4_bPushFrame(MP4_tsRecorder *psRecorder, RTP_tsFrame *psFrame);
+
+#endif // MP4_H
+
+/****************************************************************************/
+/***        END OF FILE                                                   ***/
+/****************************************************************************/
@@ -26,15 +26,39 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include "common.h"
 #include "orlaco.h"
+#include "rtp.h"
 #include "sys/time.h"
 
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
 /****************************************************************************/
 /***        Macro Definitions                                             ***/
 /****************************************************************************/
 
 #define ORLACO_SOCKET_READ_TIMEOUT_MS   (100)
+#define ORLACO_EVENT_ID_FLAG            (0x8000)        // Set in the method ID of SOME/IP notifications
+#define ORLACO_HISTOGRAM_FORMAT_LENGTH  (8)
+#define ORLACO_HEADER_LENGTH            (16)
+#define ORLACO_SESSION_ID_OFFSET        (10)
+#define ORLACO_SD_FLAGS_OFFSET          (16)        // First byte of the SD payload
+#define ORLACO_SD_ENTRY_OFFSET          (24)        // First entry, after the flags and the length of the entries array
+#define ORLACO_SD_ENTRY_TYPE_FIND       (0x00)
+#define ORLACO_EXCLUSIVE_TIME           (100)
+#define ORLACO_LEASE_RENEW_PERCENT      (50)        // Of the lease time passed before it is renewed
+#define ORLACO_BACKOFF_MIN_MS           (50)        // First wait for a camera locked by another client
+#define ORLACO_BACKOFF_MAX_MS           (2000)
+#define ORLACO_WINDOW_SCALE             (256)       // Windows are kept in fractions of a request, so they can grow by less than one
+#define ORLACO_CAMERA_WINDOW_MAX        (4)         // Requests one camera is trusted with at once
+#define ORLACO_SUBNET_WINDOW_INITIAL    (4)
+#define ORLACO_SUBNET_WINDOW_MAX        (256)
+#define ORLACO_LOST_INITIAL_MS          (1000)      // How long a request goes unanswered before it counts as lost, until the camera's been timed
+#define ORLACO_LOST_MIN_MS              (200)
+#define ORLACO_NOT_READY_RETRIES        (3)         // Times a request is sent again to a camera that answered it wasn't ready
 
 /****************************************************************************/
 /***        Type Definitions                                              ***/
@@ -93,76 +117,6 @@ typedef enum {
 } ORLACO_teMessageType;
 
 
-// Make sure these remain in the same order as the register indexes
-typedef enum {
-    E_ORLACO_REGISTER_ADDRESS_LED_MODE                             = 0xb00c,
-    E_ORLACO_REGISTER_ADDRESS_STREAM_PROTOCOL                      = 0xb041,
-    E_ORLACO_REGISTER_ADDRESS_STATIC_IP_ADDRESS_0                  = 0xb042,
-    E_ORLACO_REGISTER_ADDRESS_STATIC_IP_ADDRESS_1                  = 0xb043,
-    E_ORLACO_REGISTER_ADDRESS_STATIC_IP_ADDRESS_2                  = 0xb044,
-    E_ORLACO_REGISTER_ADDRESS_STATIC_IP_ADDRESS_3                  = 0xb045,
-    E_ORLACO_REGISTER_ADDRESS_STATIC_NETWORK_MASK_0                = 0xb046,
-    E_ORLACO_REGISTER_ADDRESS_STATIC_NETWORK_MASK_1                = 0xb047,
-    E_ORLACO_REGISTER_ADDRESS_STATIC_NETWORK_MASK_2                = 0xb048,
-    E_ORLACO_REGISTER_ADDRESS_STATIC_NETWORK_MASK_3                = 0xb049,
-    E_ORLACO_REGISTER_ADDRESS_MAC_ADDRESS_0                        = 0xb04a,
-    E_ORLACO_REGISTER_ADDRESS_MAC_ADDRESS_1                        = 0xb04b,
-    E_ORLACO_REGISTER_ADDRESS_MAC_ADDRESS_2                        = 0xb04c,
-    E_ORLACO_REGISTER_ADDRESS_MAC_ADDRESS_3                        = 0xb04d,
-    E_ORLACO_REGISTER_ADDRESS_MAC_ADDRESS_4                        = 0xb04e,
-    E_ORLACO_REGISTER_ADDRESS_MAC_ADDRESS_5                        = 0xb04f,
-    E_ORLACO_REGISTER_ADDRESS_VLAN_ID_0                            = 0xb055,
-    E_ORLACO_REGISTER_ADDRESS_VLAN_ID_1                            = 0xb056,
-    E_ORLACO_REGISTER_ADDRESS_STREAM_ID_0                          = 0xb057,  // 0xb057 - 0xb05e inclusive
-    E_ORLACO_REGISTER_ADDRESS_STREAM_ID_1                          = 0xb058,  // 0xb057 - 0xb05e inclusive
-    E_ORLACO_REGISTER_ADDRESS_STREAM_ID_2                          = 0xb059,  // 0xb057 - 0xb05e inclusive
-    E_ORLACO_REGISTER_ADDRESS_STREAM_ID_3                          = 0xb05a,  // 0xb057 - 0xb05e inclusive
-    E_ORLACO_REGISTER_ADDRESS_STREAM_ID_4                          = 0xb05b,  // 0xb057 - 0xb05e inclusive
-    E_ORLACO_REGISTER_ADDRESS_STREAM_ID_5                          = 0xb05c,  // 0xb057 - 0xb05e inclusive
-    E_ORLACO_REGISTER_ADDRESS_STREAM_ID_6                          = 0xb05d,  // 0xb057 - 0xb05e inclusive
-    E_ORLACO_REGISTER_ADDRESS_STREAM_ID_7                          = 0xb05e,  // 0xb057 - 0xb05e inclusive
-    E_ORLACO_REGISTER_ADDRESS_RTP_STREAM_DESTINATION_IP_ADDRESS_0  = 0xb05f,
-    E_ORLACO_REGISTER_ADDRESS_RTP_STREAM_DESTINATION_IP_ADDRESS_1  = 0xb060,
-    E_ORLACO_REGISTER_ADDRESS_RTP_STREAM_DESTINATION_IP_ADDRESS_2  = 0xb061,
-    E_ORLACO_REGISTER_ADDRESS_RTP_STREAM_DESTINATION_IP_ADDRESS_3  = 0xb062,
-    E_ORLACO_REGISTER_ADDRESS_RTP_STREAM_DESTINATION_MAC_ADDRESS_0 = 0xb063,
-    E_ORLACO_REGISTER_ADDRESS_RTP_STREAM_DESTINATION_MAC_ADDRESS_1 = 0xb064,
-    E_ORLACO_REGISTER_ADDRESS_RTP_STREAM_DESTINATION_MAC_ADDRESS_2 = 0xb065,
-    E_ORLACO_REGISTER_ADDRESS_RTP_STREAM_DESTINATION_MAC_ADDRESS_3 = 0xb066,
-    E_ORLACO_REGISTER_ADDRESS_RTP_STREAM_DESTINATION_MAC_ADDRESS_4 = 0xb067,
-    E_ORLACO_REGISTER_ADDRESS_RTP_STREAM_DESTINATION_MAC_ADDRESS_5 = 0xb068,
-    E_ORLACO_REGISTER_ADDRESS_RTP_STREAM_DESTINATION_PORT_0        = 0xb069,
-    E_ORLACO_REGISTER_ADDRESS_RTP_STREAM_DESTINATION_PORT_1        = 0xb06a,
-    E_ORLACO_REGISTER_ADDRESS_SELECTED_ROI                         = 0xb06b,
-    E_ORLACO_REGISTER_ADDRESS_NO_STREAM_AT_BOOT                    = 0xb06c,
-    E_ORLACO_REGISTER_ADDRESS_UDP_COMMUNICATION_PORT_0             = 0xb06d,
-    E_ORLACO_REGISTER_ADDRESS_UDP_COMMUNICATION_PORT_1             = 0xb06e,
-    E_ORLACO_REGISTER_ADDRESS_RTP_STREAM_SOURCE_PORT_0             = 0xb06f,
-    E_ORLACO_REGISTER_ADDRESS_RTP_STREAM_SOURCE_PORT_1             = 0xb070,
-    E_ORLACO_REGISTER_ADDRESS_HDR                                  = 0xb071,
-    E_ORLACO_REGISTER_ADDRESS_OVERLAY                              = 0xb072,
-    E_ORLACO_REGISTER_ADDRESS_DHCP                                 = 0xb073,
-    E_ORLACO_REGISTER_ADDRESS_WAIT_FOR_MAC                         = 0xb078,
-    E_ORLACO_REGISTER_ADDRESS_WAIT_FOR_PTP_SYNC                    = 0xb079,
-    E_ORLACO_REGISTER_ADDRESS_DHCP_HOSTNAME_0                      = 0xb171,   // 0xb171 - 0xb180 inclusive
-    E_ORLACO_REGISTER_ADDRESS_DHCP_HOSTNAME_1                      = 0xb172,   // 0xb171 - 0xb180 inclusive
-    E_ORLACO_REGISTER_ADDRESS_DHCP_HOSTNAME_2                      = 0xb173,   // 0xb171 - 0xb180 inclusive
-    E_ORLACO_REGISTER_ADDRESS_DHCP_HOSTNAME_3                      = 0xb174,   // 0xb171 - 0xb180 inclusive
-    E_ORLACO_REGISTER_ADDRESS_DHCP_HOSTNAME_4                      = 0xb175,   // 0xb171 - 0xb180 inclusive
-    E_ORLACO_REGISTER_ADDRESS_DHCP_HOSTNAME_5                      = 0xb176,   // 0xb171 - 0xb180 inclusive
-    E_ORLACO_REGISTER_ADDRESS_DHCP_HOSTNAME_6                      = 0xb177,   // 0xb171 - 0xb180 inclusive
-    E_ORLACO_REGISTER_ADDRESS_DHCP_HOSTNAME_7                      = 0xb178,   // 0xb171 - 0xb180 inclusive
-    E_ORLACO_REGISTER_ADDRESS_DHCP_HOSTNAME_8                      = 0xb179,   // 0xb171 - 0xb180 inclusive
-    E_ORLACO_REGISTER_ADDRESS_DHCP_HOSTNAME_9                      = 0xb17a,   // 0xb171 - 0xb180 inclusive
-    E_ORLACO_REGISTER_ADDRESS_DHCP_HOSTNAME_10                     = 0xb17b,   // 0xb171 - 0xb180 inclusive
-    E_ORLACO_REGISTER_ADDRESS_DHCP_HOSTNAME_11                     = 0xb17c,   // 0xb171 - 0xb180 inclusive
-    E_ORLACO_REGISTER_ADDRESS_DHCP_HOSTNAME_12                     = 0xb17d,   // 0xb171 - 0xb180 inclusive
-    E_ORLACO_REGISTER_ADDRESS_DHCP_HOSTNAME_13                     = 0xb17e,   // 0xb171 - 0xb180 inclusive
-    E_ORLACO_REGISTER_ADDRESS_DHCP_HOSTNAME_14                     = 0xb17f,   // 0xb171 - 0xb180 inclusive
-    E_ORLACO_REGISTER_ADDRESS_DHCP_HOSTNAME_15                     = 0xb180,   // 0xb171 - 0xb180 inclusive
-} ORLACO_teRegisterAddress;
-
-
 typedef struct {
     uint16_t    u16Address;
     char        *pcDescription;
@@ -192,6 +146,10 @@ typedef struct {
     uint32_t u32Mode;
 } ORLACO_tsSetCamModePayload;
 
+typedef struct {
+    uint32_t u32RegisterSet;
+} ORLACO_tsSetUsedRegisterSetPayload;
+
 typedef struct {
     uint32_t u32RegionOfInterestIndex;
     uint16_t u16P1X;
@@ -273,6 +231,16 @@ typedef struct {
 } ORLACO_tsSubscribeRegionOfInterestPayload;
 
 
+// The histogram payloads aren't documented; this layout follows the region of
+// interest requests, the ROI index first and then the format
+typedef struct {
+    uint32_t u32RegionOfInterest;
+    uint16_t u16NumBins;
+    uint8_t u8Channel;
+    uint8_t u8Interval;
+} ORLACO_tsHistogramFormatPayload;
+
+
 typedef struct {
     uint16_t u16Length;
     uint8_t u8Type;
@@ -309,6 +277,7 @@ typedef struct {
     union {
         ORLACO_tsSetCamExclusivePayload                sSetCamExclusivePayload;
         ORLACO_tsSetCamModePayload                     sSetCamModePayload;
+        ORLACO_tsSetUsedRegisterSetPayload             sSetUsedRegisterSetPayload;
         ORLACO_tsRegisterRequestsPayload               sRegisterRequestsPayload;
         ORLACO_tsGetRegistersResponsePayload           sGetRegistersResponsePayload;
         ORLACO_tsSetRegistersRequestPayload            sSetRegistersRequestPayload;
@@ -316,6 +285,7 @@ typedef struct {
         ORLACO_tsGetRegionOfInterestResponsePayload    sGetRegionOfInterestResponsePayload;
         ORLACO_tsSetRegionOfInterestPayload            sSetRegionOfInterestPayload;
         ORLACO_tsSubscribeRegionOfInterestPayload      sSubscribeRegionOfInterestPayload;
+        ORLACO_tsHistogramFormatPayload                sHistogramFormatPayload;
         ORLACO_tsServiceDiscoveryPayload               sServiceDiscoveryPayload;
     } uPayload;
 
@@ -328,6 +298,15 @@ typedef struct {
     uint8_t *pu8Data;
 } ORLACO_tsBuffer;
 
+
+// What to do with a set of cameras once they're locked, including releasing them
+typedef void (*ORLACO_tpfvSteps)(ORLACO_tsInstance *psInstance, ORLACO_tsRegisterWrite *psWrites, uint32_t u32NumWrites, void *pvContext);
+
+typedef struct {
+    uint8_t u8RegisterSet;
+    uint8_t u8ActiveSet;
+} ORLACO_tsStageContext;
+
 /****************************************************************************/
 /***        Local Function Prototypes                                     ***/
 /****************************************************************************/
@@ -354,6 +333,34 @@ static bool_t ORLACO_bWriteServiceDiscoveryServiceEntryIntoBuffer(ORLACO_tsBuffe
 static bool_t ORLACO_bReadServiceDiscoveryServiceEntryFromBuffer(ORLACO_tsBuffer *psBuffer, ORLACO_tsServiceDiscoveryServiceEntry *psServiceEntry);
 static bool_t ORLACO_bSendDatagram(UDPSOCKET sktTx, struct sockaddr_in *psDstAddr, ORLACO_tsBuffer *psBuffer);
 static bool_t ORLACO_bReceiveDatagram(ORLACO_tsInstance *psInstance, ORLACO_tsMsg *psRxMsg, uint16_t u16MethodID);
+static bool_t ORLACO_bPipeline(ORLACO_tsInstance *psInstance, ORLACO_tsRegisterWrite *psWrites, uint32_t u32NumWrites, uint16_t u16MethodID);
+static bool_t ORLACO_bSendPipelined(ORLACO_tsInstance *psInstance, ORLACO_tsRegisterWrite *psWrite, uint16_t u16MethodID);
+static uint32_t ORLACO_u32AwaitResponses(ORLACO_tsInstance *psInstance, ORLACO_tsRegisterWrite *psWrites, uint32_t u32NumWrites, uint16_t u16MethodID);
+static bool_t ORLACO_bCopyRegisterValues(ORLACO_tsMsg *psMsg, ORLACO_tsRegisterWrite *psRead);
+static ORLACO_tsWindow *ORLACO_psGetWindow(ORLACO_tsInstance *psInstance, ORLACO_tuIP uIP, bool_t bSubnet);
+static bool_t ORLACO_bWindowsHaveRoom(ORLACO_tsInstance *psInstance, ORLACO_tsRegisterWrite *psWrites, uint32_t u32NumWrites, ORLACO_tuIP uIP);
+static uint32_t ORLACO_u32GetLostMs(ORLACO_tsInstance *psInstance, ORLACO_tuIP uIP);
+static void ORLACO_vGrowWindows(ORLACO_tsInstance *psInstance, ORLACO_tsRegisterWrite *psWrite, uint64_t u64TimeUs);
+static void ORLACO_vShrinkWindows(ORLACO_tsInstance *psInstance, ORLACO_tsRegisterWrite *psWrite, uint64_t u64TimeUs);
+static void ORLACO_vGrowWindow(ORLACO_tsWindow *psWindow, uint32_t u32MaxWindow);
+static void ORLACO_vShrinkWindow(ORLACO_tsWindow *psWindow, uint64_t u64SentUs, uint64_t u64TimeUs);
+static ORLACO_tsLease *ORLACO_psGetLease(ORLACO_tsInstance *psInstance, ORLACO_tuIP uIP);
+static bool_t ORLACO_bRenewLeases(ORLACO_tsInstance *psInstance, bool_t bForce);
+static void ORLACO_vMarkLeased(ORLACO_tsInstance *psInstance, ORLACO_tsRegisterWrite *psWrites, uint32_t u32NumWrites);
+static bool_t ORLACO_bRequestCamExclusive(ORLACO_tsInstance *psInstance, uint32_t u32ExclusiveTime, uint8_t *pu8ReturnCode);
+static void ORLACO_vRunLocked(ORLACO_tsInstance *psInstance, ORLACO_tsRegisterWrite *psWrites, uint32_t u32NumWrites, ORLACO_tpfvSteps pfvSteps, void *pvContext);
+static uint32_t ORLACO_u32CountLocked(ORLACO_tsRegisterWrite *psWrites, uint32_t u32NumWrites);
+static void ORLACO_vStepsWrite(ORLACO_tsInstance *psInstance, ORLACO_tsRegisterWrite *psWrites, uint32_t u32NumWrites, void *pvContext);
+static void ORLACO_vStepsStage(ORLACO_tsInstance *psInstance, ORLACO_tsRegisterWrite *psWrites, uint32_t u32NumWrites, void *pvContext);
+static void ORLACO_vStartBackoff(ORLACO_tsInstance *psInstance, ORLACO_tsBackoff *psBackoff);
+static uint32_t ORLACO_u32GetBackoffMs(ORLACO_tsInstance *psInstance, ORLACO_tsBackoff *psBackoff);
+static bool_t ORLACO_bBackoff(ORLACO_tsInstance *psInstance, ORLACO_tsBackoff *psBackoff);
+static ORLACO_tsShadow *ORLACO_psGetShadow(ORLACO_tsInstance *psInstance, ORLACO_tuIP uIP, bool_t bCreate);
+static ORLACO_tsShadowRegister *ORLACO_psGetFresh(ORLACO_tsInstance *psInstance, ORLACO_tsShadow *psShadow, int iIndex, uint64_t u64TimeUs);
+static void ORLACO_vUpdateShadow(ORLACO_tsInstance *psInstance, ORLACO_tuIP uIP, uint16_t u16Address, uint8_t u8Value, uint64_t u64TimeUs);
+static void ORLACO_vObserveRegionOfInterest(ORLACO_tsInstance *psInstance, uint32_t u32RegionOfInterest, ORLACO_tsRegionOfInterest *psRegionOfInterest);
+static int ORLACO_iReceiveFrom(ORLACO_tsInstance *psInstance, uint8_t *pu8Data, uint32_t u32Length, int iFlags, struct sockaddr_in *psRxAddr, bool_t *pbMulticast);
+static void ORLACO_vTrackServiceDiscovery(ORLACO_tsInstance *psInstance, ORLACO_tuIP uIP, bool_t bMulticast, const uint8_t *pu8Data, int iLen);
 static char *ORLACO_pcGetReturnCodeAsString(ORLACO_teReturnCode eReturnCode);
 bool_t ORLACO_bIPAlreadyInArray(ORLACO_tsInstance *psInstance, ORLACO_tuIP IP);
 
@@ -458,6 +465,15 @@ bool_t ORLACO_bInit(ORLACO_tsInstance *psInstance, char *pcUnicastIP, char *pcBr
 
     psInstance->u16NumCameras = 0;
     psInstance->psCameras = NULL;
+    psInstance->u32NumLeases = 0;
+    psInstance->u32LeaseTime = 0;
+    psInstance->u32LockWaitMs = ORLACO_DEFAULT_LOCK_WAIT_MS;
+    psInstance->u32Random = (uint32_t)RTP_u64GetTimeUs() | 1;
+    psInstance->u32FreshnessMs = ORLACO_DEFAULT_FRESHNESS_MS;
+    psInstance->u32ResponseTimeMs = ORLACO_MAX_RESPONSE_TIME_MS;
+    psInstance->psShadows = NULL;
+    psInstance->pfvObserver = NULL;
+    psInstance->pvObserverContext = NULL;
 
     // Initialise the socket
     psInstance->Socket = socket(PF_INET, SOCK_DGRAM, IPPROTO_UDP);
@@ -480,6 +496,16 @@ bool_t ORLACO_bInit(ORLACO_tsInstance *psInstance, char *pcUnicastIP, char *pcBr
         return FALSE;
     }
 
+#if defined(IP_PKTINFO) && !defined(_WIN32)
+    // Find out where each datagram was sent, as SD messages to us and those to everyone have separate session IDs
+    iEnable = 1;
+    if(setsockopt(psInstance->Socket, IPPROTO_IP, IP_PKTINFO, (const char*)&iEnable, sizeof(iEnable)) != 0)
+    {
+		printf("Error: Can't set socket options in %s\n", __FUNCTION__);
+        return FALSE;
+    }
+#endif
+
     // Make sure socket doesn't receive its own broadcasts
     // iEnable = 0;
     // if(setsockopt(psInstance->Socket, IPPROTO_IP, IP_MULTICAST_LOOP, &iEnable, sizeof(iEnable)) != 0)
@@ -564,6 +590,23 @@ bool_t ORLACO_bInit(ORLACO_tsInstance *psInstance, char *pcUnicastIP, char *pcBr
     // Initialise the regions of interest
     memset(psInstance->psRegionsOfInterest, 0, psInstance->u16NumRegionsOfInterest * sizeof(ORLACO_tsRegionOfInterest));
 
+    // Allocate the register shadows where forked processes can share them
+#ifdef _WIN32
+    psInstance->psShadows = (ORLACO_tsShadowTable*)malloc(sizeof(ORLACO_tsShadowTable));
+#else
+    psInstance->psShadows = (ORLACO_tsShadowTable*)mmap(NULL, sizeof(ORLACO_tsShadowTable), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if(psInstance->psShadows == MAP_FAILED)
+    {
+        psInstance->psShadows = NULL;
+    }
+#endif
+    if(psInstance->psShadows == NULL)
+    {
+        printf("Error: Failed to allocate memory for register shadows in %s\n", __FUNCTION__);
+        return FALSE;
+    }
+    memset(psInstance->psShadows, 0, sizeof(ORLACO_tsShadowTable));
+
     return TRUE;
 }
 
@@ -581,6 +624,8 @@ bool_t ORLACO_bInit(ORLACO_tsInstance *psInstance, char *pcUnicastIP, char *pcBr
  ****************************************************************************/
 void ORLACO_vDeInit(ORLACO_tsInstance *psInstance)
 {
+    // Give up any locks still held before the socket goes
+    ORLACO_vReleaseLeases(psInstance);
 
 #ifdef _WIN32
     closesocket(psInstance->Socket);
@@ -606,6 +651,17 @@ void ORLACO_vDeInit(ORLACO_tsInstance *psInstance)
         free(psInstance->psCameras);
     }
 
+    // Free memory allocated for the register shadows
+    if(psInstance->psShadows != NULL)
+    {
+#ifdef _WIN32
+        free(psInstance->psShadows);
+#else
+        munmap(psInstance->psShadows, sizeof(ORLACO_tsShadowTable));
+#endif
+        psInstance->psShadows = NULL;
+    }
+
 }
 
 
@@ -672,6 +728,212 @@ bool_t ORLACO_bSetUnicastIP(ORLACO_tsInstance *psInstance, char *pcIpAddress, ui
 }
 
 
+/****************************************************************************
+ *
+ * NAME: ORLACO_psGetRegister
+ *
+ * DESCRIPTION:
+ * Finds the entry for a register in the register table by its address
+ *
+ * RETURNS:
+ * ORLACO_tsRegisterValue * - The register, or NULL if it isn't in the table
+ *
+ ****************************************************************************/
+ORLACO_tsRegisterValue *ORLACO_psGetRegister(ORLACO_tsInstance *psInstance, uint16_t u16Address)
+{
+    int n;
+
+    for(n = 0; n < psInstance->u16NumRegisters; n++)
+    {
+        if(psInstance->psRegisters[n].u16Address == u16Address)
+        {
+            return &psInstance->psRegisters[n];
+        }
+    }
+
+    return NULL;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: ORLACO_bIsMulticast
+ *
+ * DESCRIPTION:
+ * Checks whether an address is an IPv4 multicast group, 224.0.0.0/4
+ *
+ * RETURNS:
+ * bool_t TRUE if it is, FALSE otherwise
+ *
+ ****************************************************************************/
+bool_t ORLACO_bIsMulticast(ORLACO_tuIP uIP)
+{
+    return ((uIP.au8IP[3] & 0xf0) == 0xe0);
+}
+
+
+/****************************************************************************
+ *
+ * NAME: ORLACO_vGetMulticastMac
+ *
+ * DESCRIPTION:
+ * Derives the Ethernet address a multicast group is sent to, 01:00:5e
+ * followed by the low 23 bits of the group (RFC 1112)
+ *
+ * RETURNS:
+ * void
+ *
+ ****************************************************************************/
+void ORLACO_vGetMulticastMac(ORLACO_tuIP uGroup, uint8_t *pu8Mac)
+{
+    pu8Mac[0] = 0x01;
+    pu8Mac[1] = 0x00;
+    pu8Mac[2] = 0x5e;
+    pu8Mac[3] = uGroup.au8IP[2] & 0x7f;
+    pu8Mac[4] = uGroup.au8IP[1];
+    pu8Mac[5] = uGroup.au8IP[0];
+}
+
+
+/****************************************************************************
+ *
+ * NAME: ORLACO_bSetMulticastDestination
+ *
+ * DESCRIPTION:
+ * Marks the RTP destination address and hardware address registers, and the
+ * port if it isn't zero, for writing so the camera streams to a multicast
+ * group
+ *
+ * RETURNS:
+ * bool_t TRUE if successful, FALSE if the group can't be used
+ *
+ ****************************************************************************/
+bool_t ORLACO_bSetMulticastDestination(ORLACO_tsInstance *psInstance, ORLACO_tuIP uGroup, uint16_t u16Port)
+{
+    ORLACO_tsRegisterValue *psRegister;
+    uint8_t au8Mac[6];
+    int n;
+
+    if(!ORLACO_bIsMulticast(uGroup) || ((uGroup.u32IP & 0xffffff00) == 0xe0000000))
+    {
+        printf("Error: %d.%d.%d.%d isn't a multicast group outside 224.0.0.0/24 in %s\n", uGroup.au8IP[3], uGroup.au8IP[2], uGroup.au8IP[1], uGroup.au8IP[0], __FUNCTION__);
+        return FALSE;
+    }
+
+    ORLACO_vGetMulticastMac(uGroup, au8Mac);
+
+    for(n = 0; n < 4; n++)
+    {
+        psRegister = ORLACO_psGetRegister(psInstance, E_ORLACO_REGISTER_ADDRESS_RTP_STREAM_DESTINATION_IP_ADDRESS_0 + n);
+        psRegister->u8Value = uGroup.au8IP[3 - n];
+        psRegister->bWrite = TRUE;
+    }
+    for(n = 0; n < 6; n++)
+    {
+        psRegister = ORLACO_psGetRegister(psInstance, E_ORLACO_REGISTER_ADDRESS_RTP_STREAM_DESTINATION_MAC_ADDRESS_0 + n);
+        psRegister->u8Value = au8Mac[n];
+        psRegister->bWrite = TRUE;
+    }
+    if(u16Port != 0)
+    {
+        psRegister = ORLACO_psGetRegister(psInstance, E_ORLACO_REGISTER_ADDRESS_RTP_STREAM_DESTINATION_PORT_0);
+        psRegister->u8Value = (uint8_t)(u16Port >> 8);
+        psRegister->bWrite = TRUE;
+        psRegister = ORLACO_psGetRegister(psInstance, E_ORLACO_REGISTER_ADDRESS_RTP_STREAM_DESTINATION_PORT_1);
+        psRegister->u8Value = (uint8_t)(u16Port & 0xff);
+        psRegister->bWrite = TRUE;
+    }
+
+    return TRUE;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: ORLACO_bCheckDestination
+ *
+ * DESCRIPTION:
+ * Checks that the RTP destination address and hardware address registers
+ * marked for writing agree with each other. The address has to be written
+ * whole. A multicast group has to be written with the hardware address
+ * derived from it, and a unicast address without a multicast one, otherwise
+ * the stream would only reach one host, or none.
+ *
+ * RETURNS:
+ * bool_t TRUE if the writes are consistent, FALSE otherwise
+ *
+ ****************************************************************************/
+bool_t ORLACO_bCheckDestination(ORLACO_tsInstance *psInstance)
+{
+    ORLACO_tsRegisterValue *psRegister;
+    ORLACO_tuIP uIP = { .u32IP = 0 };
+    uint8_t au8Mac[6];
+    uint8_t au8Expected[6];
+    int iNumIP = 0;
+    int iNumMac = 0;
+    int n;
+
+    for(n = 0; n < 4; n++)
+    {
+        psRegister = ORLACO_psGetRegister(psInstance, E_ORLACO_REGISTER_ADDRESS_RTP_STREAM_DESTINATION_IP_ADDRESS_0 + n);
+        if(psRegister->bWrite)
+        {
+            uIP.au8IP[3 - n] = psRegister->u8Value;
+            iNumIP++;
+        }
+    }
+    for(n = 0; n < 6; n++)
+    {
+        psRegister = ORLACO_psGetRegister(psInstance, E_ORLACO_REGISTER_ADDRESS_RTP_STREAM_DESTINATION_MAC_ADDRESS_0 + n);
+        if(psRegister->bWrite)
+        {
+            au8Mac[n] = psRegister->u8Value;
+            iNumMac++;
+        }
+    }
+
+    if(((iNumIP != 0) && (iNumIP != 4)) || ((iNumMac != 0) && (iNumMac != 6)))
+    {
+        printf("Error: The destination address and hardware address must be written whole in %s\n", __FUNCTION__);
+        return FALSE;
+    }
+
+    if((iNumIP == 0) && (iNumMac == 0))
+    {
+        return TRUE;
+    }
+
+    if((iNumIP == 4) && ORLACO_bIsMulticast(uIP))
+    {
+        ORLACO_vGetMulticastMac(uIP, au8Expected);
+        if((uIP.u32IP & 0xffffff00) == 0xe0000000)
+        {
+            printf("Error: Group %d.%d.%d.%d is reserved for local network control in %s\n", uIP.au8IP[3], uIP.au8IP[2], uIP.au8IP[1], uIP.au8IP[0], __FUNCTION__);
+            return FALSE;
+        }
+        if((iNumMac == 0) || (memcmp(au8Mac, au8Expected, sizeof(au8Expected)) != 0))
+        {
+            printf("Error: Group %d.%d.%d.%d must be written with hardware address %02x:%02x:%02x:%02x:%02x:%02x in %s\n",
+                   uIP.au8IP[3], uIP.au8IP[2], uIP.au8IP[1], uIP.au8IP[0],
+                   au8Expected[0], au8Expected[1], au8Expected[2], au8Expected[3], au8Expected[4], au8Expected[5], __FUNCTION__);
+            return FALSE;
+        }
+    }
+    else if((iNumMac == 6) && (au8Mac[0] & 0x01))
+    {
+        // Without the address there's nothing to derive it from, so it must at least be a group's
+        if((iNumIP == 4) || (au8Mac[0] != 0x01) || (au8Mac[1] != 0x00) || (au8Mac[2] != 0x5e) || (au8Mac[3] & 0x80))
+        {
+            printf("Error: Hardware address %02x:%02x:%02x:%02x:%02x:%02x is a multicast address that doesn't match the destination in %s\n",
+                   au8Mac[0], au8Mac[1], au8Mac[2], au8Mac[3], au8Mac[4], au8Mac[5], __FUNCTION__);
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+
 /****************************************************************************
  *
  * NAME: ORLACO_bBufferTest
@@ -828,7 +1090,7 @@ bool_t ORLACO_bDiscover(ORLACO_tsInstance *psInstance)
         return FALSE;
     }
 
-    while(ORLACO_bReceiveDatagram(psInstance, &sMsg, E_ORLACO_MESSAGE_TYPE_NOTIFICATION))
+    while(ORLACO_bReceiveDatagram(psInstance, &sMsg, E_ORLACO_METHOD_ID_SERVICE_DISCOVERY))
     {
         // If we got some options but the service id is 0xffff, probably our own broadcast so drop it
         if((sMsg.uPayload.sServiceDiscoveryPayload.u32LengthOfEntriesArrayInBytes >= ORLACO_SD_OPTION_LENGTH) && (sMsg.uPayload.sServiceDiscoveryPayload.asServiceEntry[0].u16ServiceID == 0xffff))
@@ -885,18 +1147,79 @@ bool_t ORLACO_bDiscover(ORLACO_tsInstance *psInstance)
  * NAME: ORLACO_bSetCamExclusive
  *
  * DESCRIPTION:
- * Sends a "Set Camera Exclusive" message containing the specified exclusive time
+ * Sends a "Set Camera Exclusive" message containing the specified exclusive
+ * time. If another client has the camera locked, it's tried again, backing
+ * off exponentially with jitter, for up to the lock wait.
  *
  * RETURNS:
  * bool_t TRUE if successful, FALSE otherwise
  *
  ****************************************************************************/
 bool_t ORLACO_bSetCamExclusive(ORLACO_tsInstance *psInstance, uint32_t u32ExclusiveTime)
+{
+    ORLACO_tsBackoff sBackoff;
+    uint8_t u8ReturnCode;
+    ORLACO_tuIP uIP;
+
+    if(psInstance->eVerbosity >= E_ORLACO_VERBOSITY_DEBUG) printf("%s()\n", __FUNCTION__);
+
+    // Already held under a lease, which only needs renewing if it's due
+    uIP.u32IP = ntohl(psInstance->fdUnicast.sin_addr.s_addr);
+    if(ORLACO_bIsLeased(psInstance, uIP))
+    {
+        ORLACO_bServiceLeases(psInstance);
+        if(ORLACO_bIsLeased(psInstance, uIP))
+        {
+            return TRUE;
+        }
+    }
+
+    if(ORLACO_bRequestCamExclusive(psInstance, u32ExclusiveTime, &u8ReturnCode))
+    {
+        return TRUE;
+    }
+    if((u8ReturnCode != E_ORLACO_RETURN_CODE_LOCKED_BY_FOREIGN_INSTANCE) || (psInstance->u32LockWaitMs == 0))
+    {
+        return FALSE;
+    }
+
+    ORLACO_vStartBackoff(psInstance, &sBackoff);
+    while(ORLACO_bBackoff(psInstance, &sBackoff))
+    {
+        if(ORLACO_bRequestCamExclusive(psInstance, u32ExclusiveTime, &u8ReturnCode))
+        {
+            return TRUE;
+        }
+        if(u8ReturnCode != E_ORLACO_RETURN_CODE_LOCKED_BY_FOREIGN_INSTANCE)
+        {
+            return FALSE;
+        }
+    }
+
+    printf("Error: Camera %d.%d.%d.%d was still locked by another client after %u ms\n", uIP.au8IP[3], uIP.au8IP[2], uIP.au8IP[1], uIP.au8IP[0], psInstance->u32LockWaitMs);
+
+    return FALSE;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: ORLACO_bRequestCamExclusive
+ *
+ * DESCRIPTION:
+ * Sends a "Set Camera Exclusive" message once
+ *
+ * RETURNS:
+ * bool_t TRUE if successful, FALSE otherwise. *pu8ReturnCode is set to the
+ * camera's return code, E_ORLACO_RETURN_CODE_TIMEOUT if it didn't answer.
+ *
+ ****************************************************************************/
+static bool_t ORLACO_bRequestCamExclusive(ORLACO_tsInstance *psInstance, uint32_t u32ExclusiveTime, uint8_t *pu8ReturnCode)
 {
     bool_t bOk = TRUE;
     ORLACO_tsMsg sMsg;
 
-    if(psInstance->eVerbosity >= E_ORLACO_VERBOSITY_DEBUG) printf("%s()\n", __FUNCTION__);
+    *pu8ReturnCode = E_ORLACO_RETURN_CODE_NOT_OK;
 
     // Allocate a buffer
     ORLACO_tsBuffer *psBuffer = ORLACO_psBufferCreate(ORLACO_BUFFER_LENGTH);
@@ -945,6 +1268,7 @@ bool_t ORLACO_bSetCamExclusive(ORLACO_tsInstance *psInstance, uint32_t u32Exclus
 
     // See if we get a response
     bOk &= ORLACO_bReceiveDatagram(psInstance, &sMsg, E_ORLACO_METHOD_ID_SET_CAM_EXCLUSIVE);
+    *pu8ReturnCode = (sMsg.u16SessionID != 0) ? sMsg.u8ReturnCode : E_ORLACO_RETURN_CODE_TIMEOUT;
 
     return bOk;
  
@@ -966,9 +1290,17 @@ bool_t ORLACO_bEraseCamExclusive(ORLACO_tsInstance *psInstance)
 {
     bool_t bOk = TRUE;
     ORLACO_tsMsg sMsg;
+    ORLACO_tuIP uIP;
 
     if(psInstance->eVerbosity >= E_ORLACO_VERBOSITY_DEBUG) printf("%s()\n", __FUNCTION__);
 
+    // Held under a lease until the leases are released
+    uIP.u32IP = ntohl(psInstance->fdUnicast.sin_addr.s_addr);
+    if(ORLACO_bIsLeased(psInstance, uIP))
+    {
+        return TRUE;
+    }
+
     // Allocate a buffer
     ORLACO_tsBuffer *psBuffer = ORLACO_psBufferCreate(ORLACO_BUFFER_LENGTH);
     if(psBuffer == NULL)
@@ -1083,6 +1415,11 @@ bool_t ORLACO_bSetCamMode(ORLACO_tsInstance *psInstance, ORLACO_teCameraMode eMo
     // See if we get a response
     bOk &= ORLACO_bReceiveDatagram(psInstance, &sMsg, E_ORLACO_METHOD_ID_SET_CAM_MODE);
 
+    // A restart may come back with other values
+    ORLACO_tuIP uIP;
+    uIP.u32IP = ntohl(psInstance->fdUnicast.sin_addr.s_addr);
+    ORLACO_vForgetShadow(psInstance, uIP);
+
     return bOk;
  
 }
@@ -1093,7 +1430,9 @@ bool_t ORLACO_bSetCamMode(ORLACO_tsInstance *psInstance, ORLACO_teCameraMode eMo
  * NAME: ORLACO_bGetRegisters
  *
  * DESCRIPTION:
- * Reads registers from the camera
+ * Reads registers from the camera. Those with a value read or written within
+ * the freshness bound are answered from the camera's shadow instead, and if
+ * that's all of them nothing is sent.
  *
  * RETURNS:
  * bool_t TRUE if successful, FALSE otherwise
@@ -1105,21 +1444,55 @@ bool_t ORLACO_bGetRegisters(ORLACO_tsInstance *psInstance)
     int n;
     ORLACO_tsMsg sMsg;
     uint16_t u16Qtty = 0;
+    uint64_t u64TimeUs = RTP_u64GetTimeUs();
+    ORLACO_tsShadowRegister *psFresh;
+    ORLACO_tsShadow *psShadow;
+    bool_t *pbSend;
+    ORLACO_tuIP uIP;
 
     if(psInstance->eVerbosity >= E_ORLACO_VERBOSITY_DEBUG) printf("%s()\n", __FUNCTION__);
 
-    // Allocate a buffer
-    ORLACO_tsBuffer *psBuffer = ORLACO_psBufferCreate(ORLACO_BUFFER_LENGTH);
-    if(psBuffer == NULL)
+    uIP.u32IP = ntohl(psInstance->fdUnicast.sin_addr.s_addr);
+    psShadow = ORLACO_psGetShadow(psInstance, uIP, FALSE);
+
+    pbSend = (bool_t*)calloc(psInstance->u16NumRegisters, sizeof(bool_t));
+    if(pbSend == NULL)
     {
-        printf("Error: Buffer allocation failed in %s\n", __FUNCTION__);
+        printf("Error: Memory allocation failed in %s\n", __FUNCTION__);
         return FALSE;
     }
 
-    // See how many registers we will be reading
+    // See how many registers we will be reading, and answer the rest from the shadow
     for(n = 0; n < psInstance->u16NumRegisters; n++)
     {
-        if(psInstance->psRegisters[n].bRead) u16Qtty++;
+        if(!psInstance->psRegisters[n].bRead) continue;
+
+        psFresh = ORLACO_psGetFresh(psInstance, psShadow, n, u64TimeUs);
+        if(psFresh != NULL)
+        {
+            psInstance->psRegisters[n].u8Value = psFresh->u8Value;
+        }
+        else
+        {
+            pbSend[n] = TRUE;
+            u16Qtty++;
+        }
+    }
+
+    if(u16Qtty == 0)
+    {
+        if(psInstance->eVerbosity >= E_ORLACO_VERBOSITY_DEBUG) printf("%s: Every register answered from the shadow\n", __FUNCTION__);
+        free(pbSend);
+        return TRUE;
+    }
+
+    // Allocate a buffer
+    ORLACO_tsBuffer *psBuffer = ORLACO_psBufferCreate(ORLACO_BUFFER_LENGTH);
+    if(psBuffer == NULL)
+    {
+        printf("Error: Buffer allocation failed in %s\n", __FUNCTION__);
+        free(pbSend);
+        return FALSE;
     }
 
     // Construct the message header
@@ -1148,12 +1521,13 @@ bool_t ORLACO_bGetRegisters(ORLACO_tsInstance *psInstance)
     // Write the register addresses into the buffer
     for(n = 0; n < psInstance->u16NumRegisters; n++)
     {
-        // If the register is marked for reading, add its address to the payload
-        if(psInstance->psRegisters[n].bRead)
+        // If the register is marked for reading and wasn't in the shadow, add its address to the payload
+        if(pbSend[n])
         {
             bOk &= ORLACO_bWriteU16(psBuffer, psInstance->psRegisters[n].u16Address);
         }
     }
+    free(pbSend);
 
     // If we couldn't write the message to the buffer for some reason, free the buffer and then exit
     if(!bOk)
@@ -1188,6 +1562,7 @@ bool_t ORLACO_bGetRegisters(ORLACO_tsInstance *psInstance)
             if(sMsg.uPayload.sGetRegistersResponsePayload.asRegisterValues[x].u16Address == psInstance->psRegisters[n].u16Address)
             {
                 psInstance->psRegisters[n].u8Value = sMsg.uPayload.sGetRegistersResponsePayload.asRegisterValues[x].u8Value;
+                ORLACO_vUpdateShadow(psInstance, uIP, psInstance->psRegisters[n].u16Address, psInstance->psRegisters[n].u8Value, u64TimeUs);
             }
         }
     }
@@ -1202,7 +1577,8 @@ bool_t ORLACO_bGetRegisters(ORLACO_tsInstance *psInstance)
  * NAME: ORLACO_bSetRegisters
  *
  * DESCRIPTION:
- * Writes registers on the camera
+ * Writes registers on the camera, leaving out those its shadow shows already
+ * hold the value. Nothing is sent if that's all of them.
  *
  * RETURNS:
  * bool_t TRUE if successful, FALSE otherwise
@@ -1214,21 +1590,51 @@ bool_t ORLACO_bSetRegisters(ORLACO_tsInstance *psInstance)
     int n;
     ORLACO_tsMsg sMsg;
     uint16_t u16Qtty = 0;
+    uint64_t u64TimeUs = RTP_u64GetTimeUs();
+    ORLACO_tsShadowRegister *psFresh;
+    ORLACO_tsShadow *psShadow;
+    bool_t *pbSend;
+    ORLACO_tuIP uIP;
 
     if(psInstance->eVerbosity >= E_ORLACO_VERBOSITY_DEBUG) printf("%s()\n", __FUNCTION__);
 
-    // Allocate a buffer
-    ORLACO_tsBuffer *psBuffer = ORLACO_psBufferCreate(ORLACO_BUFFER_LENGTH);
-    if(psBuffer == NULL)
+    uIP.u32IP = ntohl(psInstance->fdUnicast.sin_addr.s_addr);
+    psShadow = ORLACO_psGetShadow(psInstance, uIP, FALSE);
+
+    pbSend = (bool_t*)calloc(psInstance->u16NumRegisters, sizeof(bool_t));
+    if(pbSend == NULL)
     {
-        printf("Error: Buffer allocation failed in %s\n", __FUNCTION__);
+        printf("Error: Memory allocation failed in %s\n", __FUNCTION__);
         return FALSE;
     }
 
-    // See how many registers we will be reading
+    // See how many registers we will be writing, leaving out those that wouldn't change
     for(n = 0; n < psInstance->u16NumRegisters; n++)
     {
-        if(psInstance->psRegisters[n].bWrite) u16Qtty++;
+        if(!psInstance->psRegisters[n].bWrite) continue;
+
+        psFresh = ORLACO_psGetFresh(psInstance, psShadow, n, u64TimeUs);
+        if((psFresh == NULL) || (psFresh->u8Value != psInstance->psRegisters[n].u8Value))
+        {
+            pbSend[n] = TRUE;
+            u16Qtty++;
+        }
+    }
+
+    if(u16Qtty == 0)
+    {
+        if(psInstance->eVerbosity >= E_ORLACO_VERBOSITY_DEBUG) printf("%s: Every register already holds its value\n", __FUNCTION__);
+        free(pbSend);
+        return TRUE;
+    }
+
+    // Allocate a buffer
+    ORLACO_tsBuffer *psBuffer = ORLACO_psBufferCreate(ORLACO_BUFFER_LENGTH);
+    if(psBuffer == NULL)
+    {
+        printf("Error: Buffer allocation failed in %s\n", __FUNCTION__);
+        free(pbSend);
+        return FALSE;
     }
 
     // Construct the message header
@@ -1257,8 +1663,8 @@ bool_t ORLACO_bSetRegisters(ORLACO_tsInstance *psInstance)
     // Write the register addresses and their values into the buffer
     for(n = 0; n < psInstance->u16NumRegisters; n++)
     {
-        // If the register is marked for writing, add its address and value to the payload
-        if(psInstance->psRegisters[n].bWrite)
+        // If the register is marked for writing and would change, add its address and value to the payload
+        if(pbSend[n])
         {
             bOk &= ORLACO_bWriteU16(psBuffer, psInstance->psRegisters[n].u16Address);
             bOk &= ORLACO_bWriteU8(psBuffer, psInstance->psRegisters[n].u8Padding);
@@ -1270,18 +1676,30 @@ bool_t ORLACO_bSetRegisters(ORLACO_tsInstance *psInstance)
     if(!bOk)
     {
         ORLACO_vBufferDestroy(psBuffer);
+        free(pbSend);
         return FALSE;
     }
 
     // Send the message
     if(!ORLACO_bSendDatagram(psInstance->Socket, &psInstance->fdUnicast, psBuffer))
     {
+        free(pbSend);
         return FALSE;
     }
 
     // See if we get a response
     bOk &= ORLACO_bReceiveDatagram(psInstance, &sMsg, E_ORLACO_METHOD_ID_SET_CAM_REGISTERS);
 
+    // The camera holds the values now, or if it didn't answer they aren't known
+    for(n = 0; n < psInstance->u16NumRegisters; n++)
+    {
+        if(pbSend[n])
+        {
+            ORLACO_vUpdateShadow(psInstance, uIP, psInstance->psRegisters[n].u16Address, psInstance->psRegisters[n].u8Value, bOk ? u64TimeUs : 0);
+        }
+    }
+    free(pbSend);
+
     return bOk;
 
 }
@@ -1289,34 +1707,217 @@ bool_t ORLACO_bSetRegisters(ORLACO_tsInstance *psInstance)
 
 /****************************************************************************
  *
- * NAME: ORLACO_bGetAllRegisters
+ * NAME: ORLACO_bHasChanges
  *
  * DESCRIPTION:
- * Reads all the registers on the camera
+ * Whether writing the registers marked for writing would change any of them
+ * on the camera, as far as its shadow shows
  *
  * RETURNS:
- * bool_t TRUE if successful, FALSE otherwise
+ * bool_t TRUE if a register would change or its value isn't known, FALSE
+ * otherwise
  *
  ****************************************************************************/
-bool_t ORLACO_bGetAllRegisters(ORLACO_tsInstance *psInstance)
+bool_t ORLACO_bHasChanges(ORLACO_tsInstance *psInstance)
 {
-
-    bool_t bOk = TRUE;
+    uint64_t u64TimeUs = RTP_u64GetTimeUs();
+    ORLACO_tsShadowRegister *psFresh;
+    ORLACO_tsShadow *psShadow;
+    ORLACO_tuIP uIP;
     int n;
 
-    if(psInstance->eVerbosity >= E_ORLACO_VERBOSITY_DEBUG) printf("%s()\n", __FUNCTION__);
+    uIP.u32IP = ntohl(psInstance->fdUnicast.sin_addr.s_addr);
+    psShadow = ORLACO_psGetShadow(psInstance, uIP, FALSE);
 
     for(n = 0; n < psInstance->u16NumRegisters; n++)
     {
-        psInstance->psRegisters[n].bRead = TRUE;
+        if(!psInstance->psRegisters[n].bWrite) continue;
+
+        psFresh = ORLACO_psGetFresh(psInstance, psShadow, n, u64TimeUs);
+        if((psFresh == NULL) || (psFresh->u8Value != psInstance->psRegisters[n].u8Value))
+        {
+            return TRUE;
+        }
     }
 
+    return FALSE;
+}
 
-    bOk &= ORLACO_bGetRegisters(psInstance);
 
-    for(int n = 0; n < psInstance->u16NumRegisters; n++)
+/****************************************************************************
+ *
+ * NAME: ORLACO_vForgetShadow
+ *
+ * DESCRIPTION:
+ * Forgets every register value known for the camera, so the next read of
+ * each goes to the camera and the next write is sent
+ *
+ * RETURNS:
+ * void
+ *
+ ****************************************************************************/
+void ORLACO_vForgetShadow(ORLACO_tsInstance *psInstance, ORLACO_tuIP uIP)
+{
+    ORLACO_tsShadow *psShadow = ORLACO_psGetShadow(psInstance, uIP, FALSE);
+
+    if(psShadow != NULL)
     {
-        printf("%02d) Addr=%04x Value=%02x - %3d - %c\t%s\n", n, psInstance->psRegisters[n].u16Address, psInstance->psRegisters[n].u8Value, psInstance->psRegisters[n].u8Value, psInstance->psRegisters[n].u8Value, psInstance->psRegisters[n].pcDescription);
+        memset(psShadow->asRegisters, 0, sizeof(psShadow->asRegisters));
+    }
+}
+
+
+/****************************************************************************
+ *
+ * NAME: ORLACO_u32GetRestarts
+ *
+ * DESCRIPTION:
+ * Counts the restarts of the camera seen in its SD messages. State kept
+ * about a camera, such as a lock or the configuration of an ROI, is stale
+ * once the count has moved on from when it was taken.
+ *
+ * RETURNS:
+ * uint32_t The number of restarts, 0 if none have been seen
+ *
+ ****************************************************************************/
+uint32_t ORLACO_u32GetRestarts(ORLACO_tsInstance *psInstance, ORLACO_tuIP uIP)
+{
+    ORLACO_tsShadow *psShadow = ORLACO_psGetShadow(psInstance, uIP, FALSE);
+
+    return (psShadow != NULL) ? psShadow->u32Restarts : 0;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: ORLACO_vPollServiceDiscovery
+ *
+ * DESCRIPTION:
+ * Reads whatever is waiting on the socket without blocking, tracking any SD
+ * messages and dropping the rest. Only call it with no responses awaited.
+ *
+ * RETURNS:
+ * void
+ *
+ ****************************************************************************/
+void ORLACO_vPollServiceDiscovery(ORLACO_tsInstance *psInstance)
+{
+#ifdef MSG_DONTWAIT
+    uint8_t au8Data[ORLACO_BUFFER_LENGTH];
+    struct sockaddr_in sRxAddr;
+    bool_t bMulticast;
+    ORLACO_tuIP uIP;
+    int iLen;
+
+    while((iLen = ORLACO_iReceiveFrom(psInstance, au8Data, sizeof(au8Data), MSG_DONTWAIT, &sRxAddr, &bMulticast)) > 0)
+    {
+        uIP.u32IP = ntohl(sRxAddr.sin_addr.s_addr);
+        ORLACO_vTrackServiceDiscovery(psInstance, uIP, bMulticast, au8Data, iLen);
+    }
+#else
+    (void)psInstance;
+#endif
+}
+
+
+/****************************************************************************
+ *
+ * NAME: ORLACO_vSetObserver
+ *
+ * DESCRIPTION:
+ * Sets a function to be told every register and ROI value successfully read
+ * from or written to a camera, or NULL for none
+ *
+ * RETURNS:
+ * void
+ *
+ ****************************************************************************/
+void ORLACO_vSetObserver(ORLACO_tsInstance *psInstance, ORLACO_tpfvObserver pfvObserver, void *pvContext)
+{
+    psInstance->pfvObserver = pfvObserver;
+    psInstance->pvObserverContext = pvContext;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: ORLACO_bSetRegistersPipelined
+ *
+ * DESCRIPTION:
+ * Writes registers on several cameras at once. Each step, taking the cameras
+ * exclusively, writing and releasing them, is sent to every camera before
+ * any of the responses are waited for, so the whole pass takes about three
+ * round trips however many cameras there are. A camera that fails a step is
+ * left out of the rest, and one locked by another client is retried after
+ * the others are done. Registers the camera's shadow shows already hold
+ * the value are taken out of its write, and a camera left with nothing to
+ * write is skipped altogether and marked bUnchanged.
+ *
+ * RETURNS:
+ * bool_t TRUE if every camera was written, FALSE otherwise
+ *
+ ****************************************************************************/
+bool_t ORLACO_bSetRegistersPipelined(ORLACO_tsInstance *psInstance, ORLACO_tsRegisterWrite *psWrites, uint32_t u32NumWrites)
+{
+    uint16_t u16MethodID = E_ORLACO_METHOD_ID_SET_CAM_REGISTERS;
+    uint64_t u64TimeUs = RTP_u64GetTimeUs();
+    ORLACO_tsShadowRegister *psFresh;
+    ORLACO_tsRegisterValue *psRegister;
+    ORLACO_tsShadow *psShadow;
+    bool_t bOk = TRUE;
+    uint16_t u16NumRegisters;
+    uint32_t n;
+    int i;
+
+    if(psInstance->eVerbosity >= E_ORLACO_VERBOSITY_DEBUG) printf("%s()\n", __FUNCTION__);
+
+    for(n = 0; n < u32NumWrites; n++)
+    {
+        psWrites[n].bOk = (psWrites[n].u16NumRegisters <= ORLACO_MAX_WRITE_REGISTERS);
+        psWrites[n].bUnchanged = FALSE;
+        if(!psWrites[n].bOk)
+        {
+            continue;
+        }
+
+        psShadow = ORLACO_psGetShadow(psInstance, psWrites[n].uIP, FALSE);
+        u16NumRegisters = 0;
+        for(i = 0; i < psWrites[n].u16NumRegisters; i++)
+        {
+            psRegister = ORLACO_psGetRegister(psInstance, psWrites[n].au16Addresses[i]);
+            psFresh = (psRegister == NULL) ? NULL : ORLACO_psGetFresh(psInstance, psShadow, psRegister - psInstance->psRegisters, u64TimeUs);
+            if((psFresh == NULL) || (psFresh->u8Value != psWrites[n].au8Values[i]))
+            {
+                psWrites[n].au16Addresses[u16NumRegisters] = psWrites[n].au16Addresses[i];
+                psWrites[n].au8Values[u16NumRegisters] = psWrites[n].au8Values[i];
+                u16NumRegisters++;
+            }
+        }
+        psWrites[n].u16NumRegisters = u16NumRegisters;
+
+        // Failed writes are left out of every step, so it doesn't take the lock either
+        if(u16NumRegisters == 0)
+        {
+            psWrites[n].bUnchanged = TRUE;
+            psWrites[n].bOk = FALSE;
+        }
+    }
+
+    ORLACO_vRunLocked(psInstance, psWrites, u32NumWrites, ORLACO_vStepsWrite, &u16MethodID);
+
+    for(n = 0; n < u32NumWrites; n++)
+    {
+        if(psWrites[n].bUnchanged)
+        {
+            psWrites[n].bOk = TRUE;
+            continue;
+        }
+
+        for(i = 0; i < psWrites[n].u16NumRegisters; i++)
+        {
+            ORLACO_vUpdateShadow(psInstance, psWrites[n].uIP, psWrites[n].au16Addresses[i], psWrites[n].au8Values[i], psWrites[n].bOk ? u64TimeUs : 0);
+        }
+        bOk &= psWrites[n].bOk;
     }
 
     return bOk;
@@ -1325,18 +1926,18 @@ bool_t ORLACO_bGetAllRegisters(ORLACO_tsInstance *psInstance)
 
 /****************************************************************************
  *
- * NAME: ORLACO_bGetRegionOfInterest
+ * NAME: ORLACO_bSetUsedRegisterSet
  *
  * DESCRIPTION:
- * Gets the specified region of interest from the camera
+ * Sends a "Set Used Register Set" message, switching the camera over to all
+ * of the register values held in the specified register set at once
  *
  * RETURNS:
  * bool_t TRUE if successful, FALSE otherwise
  *
  ****************************************************************************/
-bool_t ORLACO_bGetRegionOfInterest(ORLACO_tsInstance *psInstance, uint32_t u32RegionOfInterest, ORLACO_tsRegionOfInterest *psRegionOfInterest)
+bool_t ORLACO_bSetUsedRegisterSet(ORLACO_tsInstance *psInstance, uint8_t u8RegisterSet)
 {
-
     bool_t bOk = TRUE;
     ORLACO_tsMsg sMsg;
 
@@ -1352,7 +1953,7 @@ bool_t ORLACO_bGetRegionOfInterest(ORLACO_tsInstance *psInstance, uint32_t u32Re
 
     // Construct the message header
     sMsg.u16ServiceID = psInstance->u16ServiceID;
-    sMsg.u16MethodID = E_ORLACO_METHOD_ID_GET_REGION_OF_INTEREST;
+    sMsg.u16MethodID = E_ORLACO_METHOD_ID_SET_USED_REGISTER_SET;
 
     sMsg.u32Length = 8;
 
@@ -1365,14 +1966,14 @@ bool_t ORLACO_bGetRegionOfInterest(ORLACO_tsInstance *psInstance, uint32_t u32Re
     sMsg.u8ReturnCode = E_ORLACO_RETURN_CODE_OK;
 
     // Add the message payload and adjust the length field to include it
-    sMsg.u32Length += sizeof(sMsg.uPayload.sGetRegionOfInterestRequestPayload);
-    sMsg.uPayload.sGetRegionOfInterestRequestPayload.u32RegionOfInterest = u32RegionOfInterest;
+    sMsg.u32Length += sizeof(sMsg.uPayload.sSetUsedRegisterSetPayload);
+    sMsg.uPayload.sSetUsedRegisterSetPayload.u32RegisterSet = u8RegisterSet;
 
     // Write the message header into the byte array buffer
     bOk &= ORLACO_bWriteMessageHeaderIntoBuffer(psBuffer, &sMsg);
 
     // Write the payload into the buffer
-    bOk &= ORLACO_bWriteU32(psBuffer, sMsg.uPayload.sGetRegionOfInterestRequestPayload.u32RegionOfInterest);
+    bOk &= ORLACO_bWriteU32(psBuffer, sMsg.uPayload.sSetUsedRegisterSetPayload.u32RegisterSet);
 
     // If we couldn't write the message to the buffer for some reason, free the buffer and then exit
     if(!bOk)
@@ -1387,62 +1988,57 @@ bool_t ORLACO_bGetRegionOfInterest(ORLACO_tsInstance *psInstance, uint32_t u32Re
         return FALSE;
     }
 
-    // See if we get a response, exit if not
-    if(!ORLACO_bReceiveDatagram(psInstance, &sMsg, E_ORLACO_METHOD_ID_GET_REGION_OF_INTEREST))
-    {
-        return FALSE;
-    }
-
-    psRegionOfInterest->u16P1X = sMsg.uPayload.sGetRegionOfInterestResponsePayload.u16P1X;
-    psRegionOfInterest->u16P1Y = sMsg.uPayload.sGetRegionOfInterestResponsePayload.u16P1Y;
-    psRegionOfInterest->u16P2X = sMsg.uPayload.sGetRegionOfInterestResponsePayload.u16P2X;
-    psRegionOfInterest->u16P2Y = sMsg.uPayload.sGetRegionOfInterestResponsePayload.u16P2Y;
-    psRegionOfInterest->u16OutputWidth = sMsg.uPayload.sGetRegionOfInterestResponsePayload.u16OutputWidth;
-    psRegionOfInterest->u16OutputHeight = sMsg.uPayload.sGetRegionOfInterestResponsePayload.u16OutputHeight;
-    psRegionOfInterest->eCompressionMode = (ORLACO_teVideoCompressionMode)sMsg.uPayload.sGetRegionOfInterestResponsePayload.u8VideoCompressionMode;
-    psRegionOfInterest->u32MaxBitrate = sMsg.uPayload.sGetRegionOfInterestResponsePayload.u32MaxBitrate;
-    psRegionOfInterest->u8FrameRate = sMsg.uPayload.sGetRegionOfInterestResponsePayload.u8FrameRate;
-
-    if(psInstance->eVerbosity >= E_ORLACO_VERBOSITY_DEBUG) printf("P1X=%d P1Y=%d P2X=%d P2Y=%d OutputWidth=%d OutputHeight=%d MaxBitRate=%d FrameRate=%d CompressionMode=%d LastWord=%04x\n",
-                                  sMsg.uPayload.sGetRegionOfInterestResponsePayload.u16P1X,
-                                  sMsg.uPayload.sGetRegionOfInterestResponsePayload.u16P1Y,
-                                  sMsg.uPayload.sGetRegionOfInterestResponsePayload.u16P2X,
-                                  sMsg.uPayload.sGetRegionOfInterestResponsePayload.u16P2Y,
-                                  sMsg.uPayload.sGetRegionOfInterestResponsePayload.u16OutputWidth,
-                                  sMsg.uPayload.sGetRegionOfInterestResponsePayload.u16OutputHeight,
-                                  sMsg.uPayload.sGetRegionOfInterestResponsePayload.u32MaxBitrate,
-                                  sMsg.uPayload.sGetRegionOfInterestResponsePayload.u8FrameRate,
-                                  sMsg.uPayload.sGetRegionOfInterestResponsePayload.u8VideoCompressionMode,
-                                  sMsg.uPayload.sGetRegionOfInterestResponsePayload.u16Unknown12SetTo0x00ff
-                                  );
+    // See if we get a response
+    bOk &= ORLACO_bReceiveDatagram(psInstance, &sMsg, E_ORLACO_METHOD_ID_SET_USED_REGISTER_SET);
 
-    return TRUE;
+    // Every register may have changed
+    ORLACO_tuIP uIP;
+    uIP.u32IP = ntohl(psInstance->fdUnicast.sin_addr.s_addr);
+    ORLACO_vForgetShadow(psInstance, uIP);
 
+    return bOk;
 }
 
 
 /****************************************************************************
  *
- * NAME: ORLACO_bGetRegionsOfInterest
+ * NAME: ORLACO_bGetRegistersPipelined
  *
  * DESCRIPTION:
- * Get the regions of interest marked for reading
+ * Reads registers from several cameras at once, sending every request
+ * before waiting for any of the responses. The addresses to read are given
+ * in each read and the values are returned in it. Reads always go to the
+ * cameras, and what they return refreshes the shadows.
  *
  * RETURNS:
- * bool_t TRUE if successful, FALSE otherwise
+ * bool_t TRUE if every camera answered, FALSE otherwise
  *
  ****************************************************************************/
-bool_t ORLACO_bGetRegionsOfInterest(ORLACO_tsInstance *psInstance)
+bool_t ORLACO_bGetRegistersPipelined(ORLACO_tsInstance *psInstance, ORLACO_tsRegisterWrite *psReads, uint32_t u32NumReads)
 {
+    uint64_t u64TimeUs = RTP_u64GetTimeUs();
+    bool_t bOk;
+    uint32_t n;
+    int i;
 
-    bool_t bOk = TRUE;
-    int n;
+    if(psInstance->eVerbosity >= E_ORLACO_VERBOSITY_DEBUG) printf("%s(%u)\n", __FUNCTION__, u32NumReads);
 
-    for(n = 1; n < psInstance->u16NumRegionsOfInterest; n++)
+    for(n = 0; n < u32NumReads; n++)
     {
-        if(psInstance->psRegionsOfInterest[n].bRead)
+        psReads[n].bOk = TRUE;
+    }
+
+    bOk = ORLACO_bPipeline(psInstance, psReads, u32NumReads, E_ORLACO_METHOD_ID_GET_CAM_REGISTERS);
+
+    for(n = 0; n < u32NumReads; n++)
+    {
+        if(!psReads[n].bOk)
         {
-            bOk &= ORLACO_bGetRegionOfInterest(psInstance, n, &psInstance->psRegionsOfInterest[n]);
+            continue;
+        }
+        for(i = 0; i < psReads[n].u16NumRegisters; i++)
+        {
+            ORLACO_vUpdateShadow(psInstance, psReads[n].uIP, psReads[n].au16Addresses[i], psReads[n].au8Values[i], u64TimeUs);
         }
     }
 
@@ -1452,27 +2048,37 @@ bool_t ORLACO_bGetRegionsOfInterest(ORLACO_tsInstance *psInstance)
 
 /****************************************************************************
  *
- * NAME: ORLACO_bSetRegionsOfInterest
+ * NAME: ORLACO_bSetUsedRegisterSetPipelined
  *
  * DESCRIPTION:
- * Set the regions of interest marked for writing
+ * Switches several cameras over to the register set given in each write at
+ * once, taking each camera exclusively, sending the switch and releasing it,
+ * a step at a time to all of them. The registers in the writes are unused.
  *
  * RETURNS:
- * bool_t TRUE if successful, FALSE otherwise
+ * bool_t TRUE if every camera switched, FALSE otherwise
  *
  ****************************************************************************/
-bool_t ORLACO_bSetRegionsOfInterest(ORLACO_tsInstance *psInstance)
+bool_t ORLACO_bSetUsedRegisterSetPipelined(ORLACO_tsInstance *psInstance, ORLACO_tsRegisterWrite *psWrites, uint32_t u32NumWrites)
 {
-
+    uint16_t u16MethodID = E_ORLACO_METHOD_ID_SET_USED_REGISTER_SET;
     bool_t bOk = TRUE;
-    int n;
+    uint32_t n;
 
-    for(n = 1; n < psInstance->u16NumRegionsOfInterest; n++)
+    if(psInstance->eVerbosity >= E_ORLACO_VERBOSITY_DEBUG) printf("%s()\n", __FUNCTION__);
+
+    for(n = 0; n < u32NumWrites; n++)
     {
-        if(psInstance->psRegionsOfInterest[n].bWrite)
-        {
-            bOk &= ORLACO_bSetRegionOfInterest(psInstance, n, &psInstance->psRegionsOfInterest[n]);
-        }
+        psWrites[n].bOk = TRUE;
+    }
+
+    ORLACO_vRunLocked(psInstance, psWrites, u32NumWrites, ORLACO_vStepsWrite, &u16MethodID);
+
+    // Every register may have changed, even on cameras that didn't answer
+    for(n = 0; n < u32NumWrites; n++)
+    {
+        ORLACO_vForgetShadow(psInstance, psWrites[n].uIP);
+        bOk &= psWrites[n].bOk;
     }
 
     return bOk;
@@ -1481,422 +2087,520 @@ bool_t ORLACO_bSetRegionsOfInterest(ORLACO_tsInstance *psInstance)
 
 /****************************************************************************
  *
- * NAME: ORLACO_bSubscribeRoiVideo
+ * NAME: ORLACO_bStageRegisterSetPipelined
  *
  * DESCRIPTION:
- * Subscribe the selected region of interest
+ * Writes registers into a register set other than the one in use, on several
+ * cameras at once, so they can later be switched over to it in one go. There
+ * is no way to address a register set directly, so each camera is briefly
+ * switched to the staged set for the write and then back to the active set,
+ * which is done even if the write failed.
  *
  * RETURNS:
- * bool_t TRUE if successful, FALSE otherwise
+ * bool_t TRUE if every camera was staged, FALSE otherwise
  *
  ****************************************************************************/
-bool_t ORLACO_bSubscribeRoiVideo(ORLACO_tsInstance *psInstance, uint32_t u32RegionOfInterest)
+bool_t ORLACO_bStageRegisterSetPipelined(ORLACO_tsInstance *psInstance, ORLACO_tsRegisterWrite *psWrites, uint32_t u32NumWrites, uint8_t u8RegisterSet, uint8_t u8ActiveSet)
 {
+    ORLACO_tsStageContext sContext;
     bool_t bOk = TRUE;
-    ORLACO_tsMsg sMsg;
+    uint32_t n;
 
     if(psInstance->eVerbosity >= E_ORLACO_VERBOSITY_DEBUG) printf("%s()\n", __FUNCTION__);
 
-    // Allocate a buffer
-    ORLACO_tsBuffer *psBuffer = ORLACO_psBufferCreate(ORLACO_BUFFER_LENGTH);
-    if(psBuffer == NULL)
+    if(u8RegisterSet == u8ActiveSet)
     {
-        printf("Error: Buffer allocation failed in %s\n", __FUNCTION__);
+        printf("Error: Register set %d is the active set in %s\n", u8RegisterSet, __FUNCTION__);
         return FALSE;
     }
 
-    // Construct the message header
-    sMsg.u16ServiceID = psInstance->u16ServiceID;
-    sMsg.u16MethodID = E_ORLACO_METHOD_ID_SUBSCRIBE_ROI_VIDEO;
+    for(n = 0; n < u32NumWrites; n++)
+    {
+        psWrites[n].bOk = (psWrites[n].u16NumRegisters <= ORLACO_MAX_WRITE_REGISTERS);
+    }
 
-    sMsg.u32Length = 8;
+    sContext.u8RegisterSet = u8RegisterSet;
+    sContext.u8ActiveSet = u8ActiveSet;
+    ORLACO_vRunLocked(psInstance, psWrites, u32NumWrites, ORLACO_vStepsStage, &sContext);
 
-    sMsg.u16ClientID = psInstance->u16ClientID;
-    sMsg.u16SessionID = ORLACO_u16GetSessionID(psInstance);
+    for(n = 0; n < u32NumWrites; n++)
+    {
+        bOk &= psWrites[n].bOk;
+    }
 
-    sMsg.u8SomeIPVersion = 1;
-    sMsg.u8InterfaceVersion = 1;
-    sMsg.u8MessageType = E_ORLACO_MESSAGE_TYPE_REQUEST;
-    sMsg.u8ReturnCode = E_ORLACO_RETURN_CODE_OK;
+    return bOk;
+}
 
-    // Add the message payload and adjust the length field to include it
-    sMsg.u32Length += sizeof(sMsg.uPayload.sSubscribeRegionOfInterestPayload);
-    sMsg.uPayload.sSubscribeRegionOfInterestPayload.u32RegionOfInterest = u32RegionOfInterest;
 
-    // Write the message header into the byte array buffer
-    bOk &= ORLACO_bWriteMessageHeaderIntoBuffer(psBuffer, &sMsg);
+/****************************************************************************
+ *
+ * NAME: ORLACO_bAcquireLeases
+ *
+ * DESCRIPTION:
+ * Takes the exclusive lock on several cameras for the rest of the session,
+ * all at once. While a camera's lease is held, taking and releasing its lock
+ * around each operation is skipped, and the lease is renewed once half of it
+ * has passed by the next operation on any camera, or by
+ * ORLACO_bServiceLeases. The leases are released by ORLACO_vReleaseLeases
+ * or ORLACO_vDeInit.
+ *
+ * RETURNS:
+ * bool_t TRUE if every lease was acquired, FALSE otherwise
+ *
+ ****************************************************************************/
+bool_t ORLACO_bAcquireLeases(ORLACO_tsInstance *psInstance, ORLACO_tuIP *puIPs, uint32_t u32NumIPs, uint32_t u32LeaseTime)
+{
+    uint32_t n;
 
-    // Write the payload into the buffer
-    bOk &= ORLACO_bWriteU32(psBuffer, sMsg.uPayload.sSubscribeRegionOfInterestPayload.u32RegionOfInterest);
+    if(psInstance->eVerbosity >= E_ORLACO_VERBOSITY_DEBUG) printf("%s()\n", __FUNCTION__);
 
-    // If we couldn't write the message to the buffer for some reason, free the buffer and then exit
-    if(!bOk)
+    if((u32NumIPs > ORLACO_MAX_LEASES) || (u32LeaseTime == 0))
     {
-        ORLACO_vBufferDestroy(psBuffer);
+        printf("Error: Up to %d cameras can be leased, for at least a second, in %s\n", ORLACO_MAX_LEASES, __FUNCTION__);
         return FALSE;
     }
 
-    // Send the message
-    if(!ORLACO_bSendDatagram(psInstance->Socket, &psInstance->fdUnicast, psBuffer))
+    memset(psInstance->asLeases, 0, sizeof(psInstance->asLeases));
+    for(n = 0; n < u32NumIPs; n++)
     {
-        return FALSE;
+        psInstance->asLeases[n].uIP = puIPs[n];
     }
+    psInstance->u32NumLeases = u32NumIPs;
+    psInstance->u32LeaseTime = u32LeaseTime;
 
-    // See if we get a response
-    bOk &= !ORLACO_bReceiveDatagram(psInstance, &sMsg, E_ORLACO_METHOD_ID_SUBSCRIBE_ROI_VIDEO);
+    return ORLACO_bRenewLeases(psInstance, TRUE);
+}
 
-    return bOk;
 
+/****************************************************************************
+ *
+ * NAME: ORLACO_bServiceLeases
+ *
+ * DESCRIPTION:
+ * Renews, all at once, every lease that's half way to expiring, so a lease
+ * never lapses part way through a sequence of operations
+ *
+ * RETURNS:
+ * bool_t TRUE if every lease due was renewed, FALSE otherwise
+ *
+ ****************************************************************************/
+bool_t ORLACO_bServiceLeases(ORLACO_tsInstance *psInstance)
+{
+    return ORLACO_bRenewLeases(psInstance, FALSE);
 }
 
 
 /****************************************************************************
  *
- * NAME: ORLACO_bGetRegionOfInterest
+ * NAME: ORLACO_vReleaseLeases
  *
  * DESCRIPTION:
- * Writes the specified region of interest to the camera
+ * Releases the lock on every camera with a lease held, all at once
  *
  * RETURNS:
- * bool_t TRUE if successful, FALSE otherwise
+ * void
  *
  ****************************************************************************/
-bool_t ORLACO_bSetRegionOfInterest(ORLACO_tsInstance *psInstance, uint32_t u32RegionOfInterestIndex, ORLACO_tsRegionOfInterest *psRegionOfInterest)
+void ORLACO_vReleaseLeases(ORLACO_tsInstance *psInstance)
 {
-    bool_t bOk = TRUE;
-    ORLACO_tsMsg sMsg;
-
-    if(psInstance->eVerbosity >= E_ORLACO_VERBOSITY_DEBUG) printf("%s()\n", __FUNCTION__);
+    ORLACO_tsRegisterWrite asWrites[ORLACO_MAX_LEASES];
+    uint32_t u32NumWrites = 0;
+    uint32_t n;
 
-    // Allocate a buffer
-    ORLACO_tsBuffer *psBuffer = ORLACO_psBufferCreate(ORLACO_BUFFER_LENGTH);
-    if(psBuffer == NULL)
+    for(n = 0; n < psInstance->u32NumLeases; n++)
     {
-        printf("Error: Buffer allocation failed in %s\n", __FUNCTION__);
-        return FALSE;
+        if(psInstance->asLeases[n].bHeld)
+        {
+            memset(&asWrites[u32NumWrites], 0, sizeof(ORLACO_tsRegisterWrite));
+            asWrites[u32NumWrites].uIP = psInstance->asLeases[n].uIP;
+            asWrites[u32NumWrites].bOk = TRUE;
+            u32NumWrites++;
+            psInstance->asLeases[n].bHeld = FALSE;
+        }
     }
 
-    // Construct the message header
-    sMsg.u16ServiceID = psInstance->u16ServiceID;
-    sMsg.u16MethodID = E_ORLACO_METHOD_ID_SET_REGION_OF_INTEREST;
+    if(u32NumWrites > 0)
+    {
+        if(psInstance->eVerbosity >= E_ORLACO_VERBOSITY_DEBUG) printf("%s()\n", __FUNCTION__);
+        ORLACO_bPipeline(psInstance, asWrites, u32NumWrites, E_ORLACO_METHOD_ID_ERASE_CAM_EXCLUSIVE);
+    }
 
-    sMsg.u32Length = 8;
+    psInstance->u32NumLeases = 0;
+    psInstance->u32LeaseTime = 0;
+}
 
-    sMsg.u16ClientID = psInstance->u16ClientID;
-    sMsg.u16SessionID = ORLACO_u16GetSessionID(psInstance);
-
-    sMsg.u8SomeIPVersion = 1;
-    sMsg.u8InterfaceVersion = 1;
-    sMsg.u8MessageType = E_ORLACO_MESSAGE_TYPE_REQUEST;
-    sMsg.u8ReturnCode = E_ORLACO_RETURN_CODE_OK;
-
-    sMsg.uPayload.sSetRegionOfInterestPayload.u32RegionOfInterestIndex = u32RegionOfInterestIndex;
-    sMsg.uPayload.sSetRegionOfInterestPayload.u16P1X = psRegionOfInterest->u16P1X;
-    sMsg.uPayload.sSetRegionOfInterestPayload.u16P1Y = psRegionOfInterest->u16P1Y;
-    sMsg.uPayload.sSetRegionOfInterestPayload.u16P2X = psRegionOfInterest->u16P2X;
-    sMsg.uPayload.sSetRegionOfInterestPayload.u16P2Y = psRegionOfInterest->u16P2Y;
-    sMsg.uPayload.sSetRegionOfInterestPayload.u8Unknown1SetTo0x01 = 0x01; // no idea what this does yet, if set to 0, return code is 0x32 - invalid value in video format
-    sMsg.uPayload.sSetRegionOfInterestPayload.u8Unknown2SetTo0x00 = 0x00; // no idea what this does yet, if set to 1, return code is 0x32 - invalid value in video format
-    sMsg.uPayload.sSetRegionOfInterestPayload.u16Unknown3SetTo0x0000 = 0x0000; // no idea what this does yet, if set to 1, return code is 0x32 - invalid value in video format
-    sMsg.uPayload.sSetRegionOfInterestPayload.u16OutputWidth = psRegionOfInterest->u16OutputWidth;
-    sMsg.uPayload.sSetRegionOfInterestPayload.u16OutputHeight = psRegionOfInterest->u16OutputHeight;
-    sMsg.uPayload.sSetRegionOfInterestPayload.u8Unknown4SetTo0x00 = 0x00; // no idea what this does yet
-    sMsg.uPayload.sSetRegionOfInterestPayload.u8FrameRate = psRegionOfInterest->u8FrameRate;
-    sMsg.uPayload.sSetRegionOfInterestPayload.u16Unknown4bSetTo0x0000 = 0x0000; // no idea what this does yet
-    sMsg.uPayload.sSetRegionOfInterestPayload.u8Unknown5SetTo0x00 = 0x00; // no idea what this does yet
-    sMsg.uPayload.sSetRegionOfInterestPayload.u8Unknown6SetTo0x02 = 0x02; // no idea what this does yet, if set to 1, return code is 0x32 - invalid value in video format
-    sMsg.uPayload.sSetRegionOfInterestPayload.u32MaxBitrate = psRegionOfInterest->u32MaxBitrate;
-    sMsg.uPayload.sSetRegionOfInterestPayload.u8VideoCompressionMode = (uint8_t)psRegionOfInterest->eCompressionMode;
-    sMsg.uPayload.sSetRegionOfInterestPayload.u8Unknown7SetTo0x00 = 0x00; // no idea what this does yet, setting to 1 returns ok
-    sMsg.uPayload.sSetRegionOfInterestPayload.u8Unknown8SetTo0x00 = 0x00; // no idea what this does yet, setting to 1 returns ok
-    sMsg.uPayload.sSetRegionOfInterestPayload.u8Unknown9SetTo0x00 = 0x00; // no idea what this does yet, setting to 1 returns ok
-    sMsg.uPayload.sSetRegionOfInterestPayload.u8Unknown10SetTo0x04 = 0x04; // no idea what this does yet
-    sMsg.uPayload.sSetRegionOfInterestPayload.u8Unknown11SetTo0x01 = 0x01; // no idea what this does yet
-    sMsg.uPayload.sSetRegionOfInterestPayload.u16Unknown12SetTo0x00ff = 0x00ff; // no idea what this does yet
-
-
-    // Adjust the length field to include the payload
-    sMsg.u32Length += 38;
-
-    // printf("Len=%d %d\n", sMsg.u32Length, sizeof(ORLACO_tsSetRegionOfInterestPayload));
-
-    // Write the message header into the byte array buffer
-    bOk &= ORLACO_bWriteMessageHeaderIntoBuffer(psBuffer, &sMsg);
-
-    // Write the payload into the buffer
-    bOk &= ORLACO_bWriteU32(psBuffer, sMsg.uPayload.sSetRegionOfInterestPayload.u32RegionOfInterestIndex);
-    bOk &= ORLACO_bWriteU16(psBuffer, sMsg.uPayload.sSetRegionOfInterestPayload.u16P1X);
-    bOk &= ORLACO_bWriteU16(psBuffer, sMsg.uPayload.sSetRegionOfInterestPayload.u16P1Y);
-    bOk &= ORLACO_bWriteU16(psBuffer, sMsg.uPayload.sSetRegionOfInterestPayload.u16P2X);
-    bOk &= ORLACO_bWriteU16(psBuffer, sMsg.uPayload.sSetRegionOfInterestPayload.u16P2Y);
-    bOk &= ORLACO_bWriteU8(psBuffer, sMsg.uPayload.sSetRegionOfInterestPayload.u8Unknown1SetTo0x01);
-    bOk &= ORLACO_bWriteU8(psBuffer, sMsg.uPayload.sSetRegionOfInterestPayload.u8Unknown2SetTo0x00);
-    bOk &= ORLACO_bWriteU16(psBuffer, sMsg.uPayload.sSetRegionOfInterestPayload.u16Unknown3SetTo0x0000);
-    bOk &= ORLACO_bWriteU16(psBuffer, sMsg.uPayload.sSetRegionOfInterestPayload.u16OutputWidth);
-    bOk &= ORLACO_bWriteU16(psBuffer, sMsg.uPayload.sSetRegionOfInterestPayload.u16OutputHeight);
-    bOk &= ORLACO_bWriteU8(psBuffer, sMsg.uPayload.sSetRegionOfInterestPayload.u8Unknown4SetTo0x00);
-    bOk &= ORLACO_bWriteU8(psBuffer, sMsg.uPayload.sSetRegionOfInterestPayload.u8FrameRate);
-    bOk &= ORLACO_bWriteU16(psBuffer, sMsg.uPayload.sSetRegionOfInterestPayload.u16Unknown4bSetTo0x0000);
-    bOk &= ORLACO_bWriteU8(psBuffer, sMsg.uPayload.sSetRegionOfInterestPayload.u8Unknown5SetTo0x00);
-    bOk &= ORLACO_bWriteU8(psBuffer, sMsg.uPayload.sSetRegionOfInterestPayload.u8Unknown6SetTo0x02);
-    bOk &= ORLACO_bWriteU32(psBuffer, sMsg.uPayload.sSetRegionOfInterestPayload.u32MaxBitrate);
-    bOk &= ORLACO_bWriteU8(psBuffer, sMsg.uPayload.sSetRegionOfInterestPayload.u8VideoCompressionMode);
-    bOk &= ORLACO_bWriteU8(psBuffer, sMsg.uPayload.sSetRegionOfInterestPayload.u8Unknown7SetTo0x00);
-    bOk &= ORLACO_bWriteU8(psBuffer, sMsg.uPayload.sSetRegionOfInterestPayload.u8Unknown8SetTo0x00);
-    bOk &= ORLACO_bWriteU8(psBuffer, sMsg.uPayload.sSetRegionOfInterestPayload.u8Unknown9SetTo0x00);
-    bOk &= ORLACO_bWriteU8(psBuffer, sMsg.uPayload.sSetRegionOfInterestPayload.u8Unknown10SetTo0x04);
-    bOk &= ORLACO_bWriteU8(psBuffer, sMsg.uPayload.sSetRegionOfInterestPayload.u8Unknown11SetTo0x01);
-    bOk &= ORLACO_bWriteU16(psBuffer, sMsg.uPayload.sSetRegionOfInterestPayload.u16Unknown12SetTo0x00ff);
-
-    // If we couldn't write the message to the buffer for some reason, free the buffer and then exit
-    if(!bOk)
-    {
-        ORLACO_vBufferDestroy(psBuffer);
-        return FALSE;
-    }
-
-    // Send the message
-    if(!ORLACO_bSendDatagram(psInstance->Socket, &psInstance->fdUnicast, psBuffer))
-    {
-        return FALSE;
-    }
-
-    // See if we get a response
-    bOk &= ORLACO_bReceiveDatagram(psInstance, &sMsg, E_ORLACO_METHOD_ID_SET_REGION_OF_INTEREST);
-
-    return bOk;
-
-}
-
-/****************************************************************************/
-/***        Local Functions                                               ***/
-/****************************************************************************/
 
 /****************************************************************************
  *
- * NAME: ORLACO_u16GetSessionID
+ * NAME: ORLACO_bIsLeased
  *
  * DESCRIPTION:
- * Gets a session ID
+ * Checks whether the lock on a camera is held under a lease
  *
  * RETURNS:
- * uint16_t
+ * bool_t TRUE if it is, FALSE otherwise
  *
  ****************************************************************************/
-static uint16_t ORLACO_u16GetSessionID(ORLACO_tsInstance *psInstance)
+bool_t ORLACO_bIsLeased(ORLACO_tsInstance *psInstance, ORLACO_tuIP uIP)
 {
-    // increment the session ID. Add extra 1 if that rolls us over to zero since 0 = no session ID
-    psInstance->u16SessionID++;
-    if(psInstance->u16SessionID == 0)
-    {
-        psInstance->u16SessionID = 1;
-    }
-    return psInstance->u16SessionID;
+    ORLACO_tsLease *psLease = ORLACO_psGetLease(psInstance, uIP);
+
+    return ((psLease != NULL) && psLease->bHeld);
 }
 
 
 /****************************************************************************
  *
- * NAME: ORLACO_psBufferCreate
+ * NAME: ORLACO_bBuildSetCamExclusive
  *
  * DESCRIPTION:
- * Creates a buffer
+ * Serialises a "Set Camera Exclusive" request ahead of time, to be sent with
+ * ORLACO_bSendCommand
  *
  * RETURNS:
- * ORLACO_tsBuffer* A pointer to a buffer, or NULL if something failed
+ * bool_t TRUE if successful, FALSE otherwise
  *
  ****************************************************************************/
-static ORLACO_tsBuffer *ORLACO_psBufferCreate(uint32_t u32DataLength)
+bool_t ORLACO_bBuildSetCamExclusive(ORLACO_tsInstance *psInstance, uint32_t u32ExclusiveTime, ORLACO_tsCommand *psCommand)
 {
-    // Try and allocate some memory for a buffer. Exit if this fails
-    ORLACO_tsBuffer *psBuffer = (ORLACO_tsBuffer*)malloc(sizeof(ORLACO_tsBuffer));
+    bool_t bOk = TRUE;
+    ORLACO_tsBuffer *psBuffer;
+    ORLACO_tsMsg sMsg;
+
+    psBuffer = ORLACO_psBufferCreate(ORLACO_MAX_COMMAND_LENGTH);
     if(psBuffer == NULL)
     {
-        return NULL;
+        printf("Error: Buffer allocation failed in %s\n", __FUNCTION__);
+        return FALSE;
     }
 
-    // Initialise to 0
-    memset(psBuffer, 0, sizeof(ORLACO_tsBuffer));
+    sMsg.u16ServiceID = psInstance->u16ServiceID;
+    sMsg.u16MethodID = E_ORLACO_METHOD_ID_SET_CAM_EXCLUSIVE;
+    sMsg.u32Length = 8 + sizeof(sMsg.uPayload.sSetCamExclusivePayload);
+    sMsg.u16ClientID = psInstance->u16ClientID;
+    sMsg.u16SessionID = 0;
+    sMsg.u8SomeIPVersion = 1;
+    sMsg.u8InterfaceVersion = 1;
+    sMsg.u8MessageType = E_ORLACO_MESSAGE_TYPE_REQUEST;
+    sMsg.u8ReturnCode = E_ORLACO_RETURN_CODE_OK;
 
-    // Try and allocate the memory for the data. If this fails, free the buffer and return
-    psBuffer->pu8Data = (uint8_t*)malloc(u32DataLength);
-    if(psBuffer->pu8Data == NULL)
+    bOk &= ORLACO_bWriteMessageHeaderIntoBuffer(psBuffer, &sMsg);
+    bOk &= ORLACO_bWriteU32(psBuffer, u32ExclusiveTime);
+
+    if(bOk)
     {
-        free(psBuffer);
-        return NULL;
+        memcpy(psCommand->au8Data, psBuffer->pu8Data, psBuffer->u32Offset);
+        psCommand->u32Length = psBuffer->u32Offset;
+        psCommand->u16MethodID = sMsg.u16MethodID;
     }
 
-    psBuffer->u32Length = u32DataLength;
+    ORLACO_vBufferDestroy(psBuffer);
 
-    return psBuffer;
+    return bOk;
 }
 
 
 /****************************************************************************
  *
- * NAME: ORLACO_vBufferDestroy
+ * NAME: ORLACO_bBuildSetRegisters
  *
  * DESCRIPTION:
- * Destroys a buffer
+ * Serialises a "Set Camera Registers" request ahead of time, to be sent with
+ * ORLACO_bSendCommand
  *
  * RETURNS:
- * void
+ * bool_t TRUE if successful, FALSE otherwise
  *
  ****************************************************************************/
-static void ORLACO_vBufferDestroy(ORLACO_tsBuffer *psBuffer)
+bool_t ORLACO_bBuildSetRegisters(ORLACO_tsInstance *psInstance, uint16_t *pu16Addresses, uint8_t *pu8Values, uint16_t u16NumRegisters, ORLACO_tsCommand *psCommand)
 {
-    // Don't try and free a buffer that hasn't been allocated!
+    bool_t bOk = TRUE;
+    ORLACO_tsBuffer *psBuffer;
+    ORLACO_tsMsg sMsg;
+    int n;
+
+    psBuffer = ORLACO_psBufferCreate(ORLACO_MAX_COMMAND_LENGTH);
     if(psBuffer == NULL)
     {
-        return;
+        printf("Error: Buffer allocation failed in %s\n", __FUNCTION__);
+        return FALSE;
     }
 
-    // Only free the data buffer if it was successfully allocated in the first place
-    if(psBuffer->pu8Data != NULL)
+    sMsg.u16ServiceID = psInstance->u16ServiceID;
+    sMsg.u16MethodID = E_ORLACO_METHOD_ID_SET_CAM_REGISTERS;
+    sMsg.u32Length = 8 + sizeof(uint16_t) + (u16NumRegisters * 4);
+    sMsg.u16ClientID = psInstance->u16ClientID;
+    sMsg.u16SessionID = 0;
+    sMsg.u8SomeIPVersion = 1;
+    sMsg.u8InterfaceVersion = 1;
+    sMsg.u8MessageType = E_ORLACO_MESSAGE_TYPE_REQUEST;
+    sMsg.u8ReturnCode = E_ORLACO_RETURN_CODE_OK;
+
+    bOk &= ORLACO_bWriteMessageHeaderIntoBuffer(psBuffer, &sMsg);
+    bOk &= ORLACO_bWriteU16(psBuffer, u16NumRegisters);
+    for(n = 0; n < u16NumRegisters; n++)
     {
-        free(psBuffer->pu8Data);
+        bOk &= ORLACO_bWriteU16(psBuffer, pu16Addresses[n]);
+        bOk &= ORLACO_bWriteU8(psBuffer, 0);
+        bOk &= ORLACO_bWriteU8(psBuffer, pu8Values[n]);
     }
 
-    // Now we can free the buffer
-    free(psBuffer);
+    if(bOk)
+    {
+        memcpy(psCommand->au8Data, psBuffer->pu8Data, psBuffer->u32Offset);
+        psCommand->u32Length = psBuffer->u32Offset;
+        psCommand->u16MethodID = sMsg.u16MethodID;
+    }
+    else
+    {
+        printf("Error: Too many registers in %s\n", __FUNCTION__);
+    }
+
+    ORLACO_vBufferDestroy(psBuffer);
+
+    return bOk;
 }
 
 
 /****************************************************************************
  *
- * NAME: ORLACO_bWriteU8
+ * NAME: ORLACO_bSendCommand
  *
  * DESCRIPTION:
- * Writes an 8 bit value into a buffer
+ * Sends a serialised request to the camera at the unicast address, with
+ * only its session ID filled in, so nothing is allocated or encoded on the
+ * way out. The response is collected with ORLACO_bPollCommand.
  *
  * RETURNS:
- * bool_t - TRUE if the data was written, FALSE otherwise
+ * bool_t TRUE if successful, FALSE otherwise
  *
  ****************************************************************************/
-static bool_t ORLACO_bWriteU8(ORLACO_tsBuffer *psBuffer, uint8_t u8Data)
+bool_t ORLACO_bSendCommand(ORLACO_tsInstance *psInstance, ORLACO_tsCommand *psCommand)
 {
+    ORLACO_tuIP uIP;
+    uint16_t u16Qtty;
+    uint8_t *pu8Register;
+    uint32_t n;
 
-    uint8_t *pu8WritePtr = psBuffer->pu8Data + psBuffer->u32Offset;
+    // The registers it sets aren't known until they're read back
+    if((psCommand->u16MethodID == E_ORLACO_METHOD_ID_SET_CAM_REGISTERS) && (psCommand->u32Length >= ORLACO_HEADER_LENGTH + 2))
+    {
+        uIP.u32IP = ntohl(psInstance->fdUnicast.sin_addr.s_addr);
+        u16Qtty = (uint16_t)((psCommand->au8Data[ORLACO_HEADER_LENGTH] << 8) | psCommand->au8Data[ORLACO_HEADER_LENGTH + 1]);
+        for(n = 0; (n < u16Qtty) && (ORLACO_HEADER_LENGTH + 2 + (n + 1) * 4 <= psCommand->u32Length); n++)
+        {
+            pu8Register = &psCommand->au8Data[ORLACO_HEADER_LENGTH + 2 + n * 4];
+            ORLACO_vUpdateShadow(psInstance, uIP, (uint16_t)((pu8Register[0] << 8) | pu8Register[1]), 0, 0);
+        }
+    }
 
-    // Check we're not about to write past the end of the buffer
-    if((psBuffer->u32Offset + 1) >= psBuffer->u32Length)
+    psCommand->u16SessionID = ORLACO_u16GetSessionID(psInstance);
+    psCommand->au8Data[ORLACO_SESSION_ID_OFFSET] = (uint8_t)(psCommand->u16SessionID >> 8);
+    psCommand->au8Data[ORLACO_SESSION_ID_OFFSET + 1] = (uint8_t)(psCommand->u16SessionID & 0xff);
+    psCommand->u8ReturnCode = E_ORLACO_RETURN_CODE_OK;
+
+    if(sendto(psInstance->Socket, (const char *)psCommand->au8Data, psCommand->u32Length, 0, (const struct sockaddr*)&psInstance->fdUnicast, sizeof(struct sockaddr_in)) != (int)psCommand->u32Length)
     {
-        // Return failure
+        printf("Error: Send failed in %s\n", __FUNCTION__);
         return FALSE;
     }
 
-    // Write the data into the buffer and adjust the offset value
-    *pu8WritePtr = u8Data;
-    psBuffer->u32Offset += 1;
-
-    // Return success
     return TRUE;
 }
 
 
 /****************************************************************************
  *
- * NAME: ORLACO_bWriteU16
+ * NAME: ORLACO_bPollCommand
  *
  * DESCRIPTION:
- * Writes a 16 bit value into a buffer
+ * Reads whatever is waiting on the socket without blocking, looking for the
+ * response to a command sent with ORLACO_bSendCommand. Anything else, such
+ * as notifications or late responses, is dropped once any SD message in it
+ * has been tracked. Spinning on this keeps the wake up latency of a blocking
+ * receive out of the round trip.
  *
  * RETURNS:
- * bool_t - TRUE if the data was written, FALSE otherwise
+ * bool_t FALSE if the command was answered with an error, TRUE otherwise.
+ * *pbAnswered is set once the response has arrived.
  *
  ****************************************************************************/
-static bool_t ORLACO_bWriteU16(ORLACO_tsBuffer *psBuffer, uint16_t u16Data)
+bool_t ORLACO_bPollCommand(ORLACO_tsInstance *psInstance, ORLACO_tsCommand *psCommand, bool_t *pbAnswered)
 {
-    uint8_t *pu8WritePtr = psBuffer->pu8Data + psBuffer->u32Offset;
+    uint8_t au8Data[ORLACO_BUFFER_LENGTH];
+    struct sockaddr_in sRxAddr;
+    bool_t bMulticast;
+    ORLACO_tuIP uIP;
+    int iLen;
 
-    // Check we're not about to write past the end of the buffer
-    if((psBuffer->u32Offset + 1) >= psBuffer->u32Length)
+    *pbAnswered = FALSE;
+
+    for(;;)
     {
-        // Return failure
-        return FALSE;
-    }
+#ifdef MSG_DONTWAIT
+        iLen = ORLACO_iReceiveFrom(psInstance, au8Data, sizeof(au8Data), MSG_DONTWAIT, &sRxAddr, &bMulticast);
+#else
+        iLen = ORLACO_iReceiveFrom(psInstance, au8Data, sizeof(au8Data), 0, &sRxAddr, &bMulticast);
+#endif
+        if(iLen <= 0)
+        {
+            return TRUE;
+        }
 
-    // Write the data into the buffer and adjust the offset value
-    *pu8WritePtr = (u16Data >> 8) & 0xff;
-    pu8WritePtr++;
-    *pu8WritePtr = (u16Data >> 0) & 0xff;
-    psBuffer->u32Offset += 2;
+        uIP.u32IP = ntohl(sRxAddr.sin_addr.s_addr);
+        ORLACO_vTrackServiceDiscovery(psInstance, uIP, bMulticast, au8Data, iLen);
 
-    // Return success
-    return TRUE;
+        if((iLen < ORLACO_HEADER_LENGTH) ||
+           (((au8Data[2] << 8) | au8Data[3]) != psCommand->u16MethodID) ||
+           (((au8Data[ORLACO_SESSION_ID_OFFSET] << 8) | au8Data[ORLACO_SESSION_ID_OFFSET + 1]) != psCommand->u16SessionID) ||
+           (au8Data[14] == E_ORLACO_MESSAGE_TYPE_NOTIFICATION))
+        {
+            continue;
+        }
 
+        *pbAnswered = TRUE;
+        psCommand->u8ReturnCode = au8Data[15];
+        if(psCommand->u8ReturnCode != E_ORLACO_RETURN_CODE_OK)
+        {
+            printf("Error: Response code = %d: %s\n", psCommand->u8ReturnCode, ORLACO_pcGetReturnCodeAsString((ORLACO_teReturnCode)psCommand->u8ReturnCode));
+            return FALSE;
+        }
+        return TRUE;
+    }
 }
 
 
 /****************************************************************************
  *
- * NAME: ORLACO_bWriteU24
+ * NAME: ORLACO_bGetAllRegisters
  *
  * DESCRIPTION:
- * Writes a 24 bit value into a buffer
+ * Reads all the registers on the camera
  *
  * RETURNS:
- * bool_t - TRUE if the data was written, FALSE otherwise
+ * bool_t TRUE if successful, FALSE otherwise
  *
  ****************************************************************************/
-static bool_t ORLACO_bWriteU24(ORLACO_tsBuffer *psBuffer, uint32_t u24Data)
+bool_t ORLACO_bGetAllRegisters(ORLACO_tsInstance *psInstance)
 {
-    uint8_t *pu8WritePtr = psBuffer->pu8Data + psBuffer->u32Offset;
 
-    // Check we're not about to write past the end of the buffer
-    if((psBuffer->u32Offset + 1) >= psBuffer->u32Length)
+    bool_t bOk = TRUE;
+    int n;
+
+    if(psInstance->eVerbosity >= E_ORLACO_VERBOSITY_DEBUG) printf("%s()\n", __FUNCTION__);
+
+    for(n = 0; n < psInstance->u16NumRegisters; n++)
     {
-        // Return failure
-        return FALSE;
+        psInstance->psRegisters[n].bRead = TRUE;
     }
 
-    // Write the data into the buffer and adjust the offset value
-    *pu8WritePtr = (u24Data >> 16) & 0xff;
-    pu8WritePtr++;
-    *pu8WritePtr = (u24Data >> 8) & 0xff;
-    pu8WritePtr++;
-    *pu8WritePtr = (u24Data >> 0) & 0xff;
-    psBuffer->u32Offset += 3;
 
-    // Return success
-    return TRUE;
+    bOk &= ORLACO_bGetRegisters(psInstance);
+
+    for(int n = 0; n < psInstance->u16NumRegisters; n++)
+    {
+        printf("%02d) Addr=%04x Value=%02x - %3d - %c\t%s\n", n, psInstance->psRegisters[n].u16Address, psInstance->psRegisters[n].u8Value, psInstance->psRegisters[n].u8Value, psInstance->psRegisters[n].u8Value, psInstance->psRegisters[n].pcDescription);
+    }
 
+    return bOk;
 }
 
 
 /****************************************************************************
  *
- * NAME: ORLACO_bWriteU32
+ * NAME: ORLACO_bGetRegionOfInterest
  *
  * DESCRIPTION:
- * Writes a 32 bit value into a buffer
+ * Gets the specified region of interest from the camera
  *
  * RETURNS:
- * bool_t - TRUE if the data was written, FALSE otherwise
+ * bool_t TRUE if successful, FALSE otherwise
  *
  ****************************************************************************/
-static bool_t ORLACO_bWriteU32(ORLACO_tsBuffer *psBuffer, uint32_t u32Data)
+bool_t ORLACO_bGetRegionOfInterest(ORLACO_tsInstance *psInstance, uint32_t u32RegionOfInterest, ORLACO_tsRegionOfInterest *psRegionOfInterest)
 {
-    uint8_t *pu8WritePtr = psBuffer->pu8Data + psBuffer->u32Offset;
 
-    // Check we're not about to write past the end of the buffer
-    if((psBuffer->u32Offset + 1) >= psBuffer->u32Length)
+    bool_t bOk = TRUE;
+    ORLACO_tsMsg sMsg;
+
+    if(psInstance->eVerbosity >= E_ORLACO_VERBOSITY_DEBUG) printf("%s()\n", __FUNCTION__);
+
+    // Allocate a buffer
+    ORLACO_tsBuffer *psBuffer = ORLACO_psBufferCreate(ORLACO_BUFFER_LENGTH);
+    if(psBuffer == NULL)
     {
-        // Return failure
+        printf("Error: Buffer allocation failed in %s\n", __FUNCTION__);
         return FALSE;
     }
 
-    // Write the data into the buffer and adjust the offset value
-    *pu8WritePtr = (u32Data >> 24) & 0xff;
-    pu8WritePtr++;
-    *pu8WritePtr = (u32Data >> 16) & 0xff;
-    pu8WritePtr++;
-    *pu8WritePtr = (u32Data >> 8) & 0xff;
-    pu8WritePtr++;
-    *pu8WritePtr = (u32Data >> 0) & 0xff;
-    psBuffer->u32Offset += 4;
+    // Construct the message header
+    sMsg.u16ServiceID = psInstance->u16ServiceID;
+    sMsg.u16MethodID = E_ORLACO_METHOD_ID_GET_REGION_OF_INTEREST;
+
+    sMsg.u32Length = 8;
+
+    sMsg.u16ClientID = psInstance->u16ClientID;
+    sMsg.u16SessionID = ORLACO_u16GetSessionID(psInstance);
+
+    sMsg.u8SomeIPVersion = 1;
+    sMsg.u8InterfaceVersion = 1;
+    sMsg.u8MessageType = E_ORLACO_MESSAGE_TYPE_REQUEST;
+    sMsg.u8ReturnCode = E_ORLACO_RETURN_CODE_OK;
+
+    // Add the message payload and adjust the length field to include it
+    sMsg.u32Length += sizeof(sMsg.uPayload.sGetRegionOfInterestRequestPayload);
+    sMsg.uPayload.sGetRegionOfInterestRequestPayload.u32RegionOfInterest = u32RegionOfInterest;
+
+    // Write the message header into the byte array buffer
+    bOk &= ORLACO_bWriteMessageHeaderIntoBuffer(psBuffer, &sMsg);
+
+    // Write the payload into the buffer
+    bOk &= ORLACO_bWriteU32(psBuffer, sMsg.uPayload.sGetRegionOfInterestRequestPayload.u32RegionOfInterest);
+
+    // If we couldn't write the message to the buffer for some reason, free the buffer and then exit
+    if(!bOk)
+    {
+        ORLACO_vBufferDestroy(psBuffer);
+        return FALSE;
+    }
+
+    // Send the message
+    if(!ORLACO_bSendDatagram(psInstance->Socket, &psInstance->fdUnicast, psBuffer))
+    {
+        return FALSE;
+    }
+
+    // See if we get a response, exit if not
+    if(!ORLACO_bReceiveDatagram(psInstance, &sMsg, E_ORLACO_METHOD_ID_GET_REGION_OF_INTEREST))
+    {
+        return FALSE;
+    }
+
+    psRegionOfInterest->u16P1X = sMsg.uPayload.sGetRegionOfInterestResponsePayload.u16P1X;
+    psRegionOfInterest->u16P1Y = sMsg.uPayload.sGetRegionOfInterestResponsePayload.u16P1Y;
+    psRegionOfInterest->u16P2X = sMsg.uPayload.sGetRegionOfInterestResponsePayload.u16P2X;
+    psRegionOfInterest->u16P2Y = sMsg.uPayload.sGetRegionOfInterestResponsePayload.u16P2Y;
+    psRegionOfInterest->u16OutputWidth = sMsg.uPayload.sGetRegionOfInterestResponsePayload.u16OutputWidth;
+    psRegionOfInterest->u16OutputHeight = sMsg.uPayload.sGetRegionOfInterestResponsePayload.u16OutputHeight;
+    psRegionOfInterest->eCompressionMode = (ORLACO_teVideoCompressionMode)sMsg.uPayload.sGetRegionOfInterestResponsePayload.u8VideoCompressionMode;
+    psRegionOfInterest->u32MaxBitrate = sMsg.uPayload.sGetRegionOfInterestResponsePayload.u32MaxBitrate;
+    psRegionOfInterest->u8FrameRate = sMsg.uPayload.sGetRegionOfInterestResponsePayload.u8FrameRate;
+
+    ORLACO_vObserveRegionOfInterest(psInstance, u32RegionOfInterest, psRegionOfInterest);
+
+    if(psInstance->eVerbosity >= E_ORLACO_VERBOSITY_DEBUG) printf("P1X=%d P1Y=%d P2X=%d P2Y=%d OutputWidth=%d OutputHeight=%d MaxBitRate=%d FrameRate=%d CompressionMode=%d LastWord=%04x\n",
+                                  sMsg.uPayload.sGetRegionOfInterestResponsePayload.u16P1X,
+                                  sMsg.uPayload.sGetRegionOfInterestResponsePayload.u16P1Y,
+                                  sMsg.uPayload.sGetRegionOfInterestResponsePayload.u16P2X,
+                                  sMsg.uPayload.sGetRegionOfInterestResponsePayload.u16P2Y,
+                                  sMsg.uPayload.sGetRegionOfInterestResponsePayload.u16OutputWidth,
+                                  sMsg.uPayload.sGetRegionOfInterestResponsePayload.u16OutputHeight,
+                                  sMsg.uPayload.sGetRegionOfInterestResponsePayload.u32MaxBitrate,
+                                  sMsg.uPayload.sGetRegionOfInterestResponsePayload.u8FrameRate,
+                                  sMsg.uPayload.sGetRegionOfInterestResponsePayload.u8VideoCompressionMode,
+                                  sMsg.uPayload.sGetRegionOfInterestResponsePayload.u16Unknown12SetTo0x00ff
+                                  );
 
-    // Return success
     return TRUE;
 
 }
@@ -1904,562 +2608,2767 @@ static bool_t ORLACO_bWriteU32(ORLACO_tsBuffer *psBuffer, uint32_t u32Data)
 
 /****************************************************************************
  *
- * NAME: ORLACO_bReadU8
+ * NAME: ORLACO_bGetRegionsOfInterest
  *
  * DESCRIPTION:
- * Reads an 8 bit value from a buffer
+ * Get the regions of interest marked for reading
  *
  * RETURNS:
- * bool_t - TRUE if the data was read, FALSE otherwise
+ * bool_t TRUE if successful, FALSE otherwise
  *
  ****************************************************************************/
-static bool_t ORLACO_bReadU8(ORLACO_tsBuffer *psBuffer, uint8_t *pu8Data)
+bool_t ORLACO_bGetRegionsOfInterest(ORLACO_tsInstance *psInstance)
 {
-    uint8_t *pu8ReadPtr = psBuffer->pu8Data + psBuffer->u32Offset;
 
-    // Check we're not about to read past the end of the buffer
-    if((psBuffer->u32Offset + 1) > psBuffer->u32Length)
+    bool_t bOk = TRUE;
+    int n;
+
+    for(n = 1; n < psInstance->u16NumRegionsOfInterest; n++)
     {
-        // Return failure
-        return FALSE;
+        if(psInstance->psRegionsOfInterest[n].bRead)
+        {
+            bOk &= ORLACO_bGetRegionOfInterest(psInstance, n, &psInstance->psRegionsOfInterest[n]);
+        }
     }
 
-    // Read the data from the buffer
-    *pu8Data = *pu8ReadPtr;
-    psBuffer->u32Offset += 1;
-
-    // Return success
-    return TRUE;
-
+    return bOk;
 }
 
 
 /****************************************************************************
  *
- * NAME: ORLACO_bReadU16
+ * NAME: ORLACO_bSetRegionsOfInterest
  *
  * DESCRIPTION:
- * Reads a 16 bit value from a buffer
+ * Set the regions of interest marked for writing
  *
  * RETURNS:
- * bool_t - TRUE if the data was read, FALSE otherwise
+ * bool_t TRUE if successful, FALSE otherwise
  *
  ****************************************************************************/
-static bool_t ORLACO_bReadU16(ORLACO_tsBuffer *psBuffer, uint16_t *pu16Data)
+bool_t ORLACO_bSetRegionsOfInterest(ORLACO_tsInstance *psInstance)
 {
-    uint16_t u16Data = 0;
-    uint8_t *pu8ReadPtr = psBuffer->pu8Data + psBuffer->u32Offset;
 
-    // Check we're not about to read past the end of the buffer
-    if((psBuffer->u32Offset + 2) > psBuffer->u32Length)
+    bool_t bOk = TRUE;
+    int n;
+
+    for(n = 1; n < psInstance->u16NumRegionsOfInterest; n++)
     {
-        // Return failure
-        return FALSE;
+        if(psInstance->psRegionsOfInterest[n].bWrite)
+        {
+            bOk &= ORLACO_bSetRegionOfInterest(psInstance, n, &psInstance->psRegionsOfInterest[n]);
+        }
     }
 
-    // Read the data from the buffer
-    u16Data = (*(pu8ReadPtr++)) << 8;
-    u16Data |= (*(pu8ReadPtr++)) << 0;
-
-    *pu16Data = u16Data;
-    psBuffer->u32Offset += 2;
-
-    // Return success
-    return TRUE;
-
+    return bOk;
 }
 
 
 /****************************************************************************
  *
- * NAME: ORLACO_bReadU24
+ * NAME: ORLACO_bSubscribeRoiVideo
  *
  * DESCRIPTION:
- * Reads a 24 bit value from a buffer
+ * Subscribe the selected region of interest
  *
  * RETURNS:
- * bool_t - TRUE if the data was read, FALSE otherwise
+ * bool_t TRUE if successful, FALSE otherwise
  *
  ****************************************************************************/
-static bool_t ORLACO_bReadU24(ORLACO_tsBuffer *psBuffer, uint32_t *pu24Data)
+bool_t ORLACO_bSubscribeRoiVideo(ORLACO_tsInstance *psInstance, uint32_t u32RegionOfInterest)
 {
-    uint32_t u24Data = 0;
-    uint8_t *pu8ReadPtr = psBuffer->pu8Data + psBuffer->u32Offset;
+    bool_t bOk = TRUE;
+    ORLACO_tsMsg sMsg;
 
-    // Check we're not about to read past the end of the buffer
-    if((psBuffer->u32Offset + 3) > psBuffer->u32Length)
+    if(psInstance->eVerbosity >= E_ORLACO_VERBOSITY_DEBUG) printf("%s()\n", __FUNCTION__);
+
+    // Allocate a buffer
+    ORLACO_tsBuffer *psBuffer = ORLACO_psBufferCreate(ORLACO_BUFFER_LENGTH);
+    if(psBuffer == NULL)
     {
-        // Return failure
+        printf("Error: Buffer allocation failed in %s\n", __FUNCTION__);
         return FALSE;
     }
 
-    // Read the data from the buffer
-    u24Data  = (*(pu8ReadPtr++)) << 16;
-    u24Data |= (*(pu8ReadPtr++)) << 8;
-    u24Data |= (*(pu8ReadPtr++)) << 0;
+    // Construct the message header
+    sMsg.u16ServiceID = psInstance->u16ServiceID;
+    sMsg.u16MethodID = E_ORLACO_METHOD_ID_SUBSCRIBE_ROI_VIDEO;
 
-    *pu24Data = u24Data;
-    psBuffer->u32Offset += 3;
+    sMsg.u32Length = 8;
 
-    // Return success
-    return TRUE;
+    sMsg.u16ClientID = psInstance->u16ClientID;
+    sMsg.u16SessionID = ORLACO_u16GetSessionID(psInstance);
 
-}
+    sMsg.u8SomeIPVersion = 1;
+    sMsg.u8InterfaceVersion = 1;
+    sMsg.u8MessageType = E_ORLACO_MESSAGE_TYPE_REQUEST;
+    sMsg.u8ReturnCode = E_ORLACO_RETURN_CODE_OK;
 
+    // Add the message payload and adjust the length field to include it
+    sMsg.u32Length += sizeof(sMsg.uPayload.sSubscribeRegionOfInterestPayload);
+    sMsg.uPayload.sSubscribeRegionOfInterestPayload.u32RegionOfInterest = u32RegionOfInterest;
 
-/****************************************************************************
- *
- * NAME: ORLACO_bReadU32
- *
- * DESCRIPTION:
- * Reads a 32 bit value from a buffer
- *
- * RETURNS:
- * bool_t - TRUE if the data was read, FALSE otherwise
- *
- ****************************************************************************/
-static bool_t ORLACO_bReadU32(ORLACO_tsBuffer *psBuffer, uint32_t *pu32Data)
-{
-    uint32_t u32Data = 0;
-    uint8_t *pu8ReadPtr = psBuffer->pu8Data + psBuffer->u32Offset;
+    // Write the message header into the byte array buffer
+    bOk &= ORLACO_bWriteMessageHeaderIntoBuffer(psBuffer, &sMsg);
 
-    // Check we're not about to read past the end of the buffer
-    if((psBuffer->u32Offset + 4) > psBuffer->u32Length)
+    // Write the payload into the buffer
+    bOk &= ORLACO_bWriteU32(psBuffer, sMsg.uPayload.sSubscribeRegionOfInterestPayload.u32RegionOfInterest);
+
+    // If we couldn't write the message to the buffer for some reason, free the buffer and then exit
+    if(!bOk)
     {
-        // Return failure
+        ORLACO_vBufferDestroy(psBuffer);
         return FALSE;
     }
 
-    // Read the data from the buffer
-    u32Data  = (*(pu8ReadPtr++)) << 24;
-    u32Data |= (*(pu8ReadPtr++)) << 16;
-    u32Data |= (*(pu8ReadPtr++)) << 8;
-    u32Data |= (*(pu8ReadPtr++)) << 0;
+    // Send the message
+    if(!ORLACO_bSendDatagram(psInstance->Socket, &psInstance->fdUnicast, psBuffer))
+    {
+        return FALSE;
+    }
 
-    *pu32Data = u32Data;
-    psBuffer->u32Offset += 4;
+    // See if we get a response
+    bOk &= !ORLACO_bReceiveDatagram(psInstance, &sMsg, E_ORLACO_METHOD_ID_SUBSCRIBE_ROI_VIDEO);
 
-    // Return success
-    return TRUE;
+    return bOk;
 
 }
 
 
 /****************************************************************************
  *
- * NAME: ORLACO_bWriteMessageHeaderIntoBuffer
+ * NAME: ORLACO_bSetHistogramFormat
  *
  * DESCRIPTION:
- * Writes a message header into a buffer
+ * Sets the histogram the camera computes for a region of interest
  *
  * RETURNS:
- * bool_t - TRUE if successful, FALSE otherwise
+ * bool_t TRUE if successful, FALSE otherwise
  *
  ****************************************************************************/
-static bool_t ORLACO_bWriteMessageHeaderIntoBuffer(ORLACO_tsBuffer *psBuffer, ORLACO_tsMsg *psMsg)
+bool_t ORLACO_bSetHistogramFormat(ORLACO_tsInstance *psInstance, uint32_t u32RegionOfInterest, ORLACO_tsHistogramFormat *psFormat)
 {
-
     bool_t bOk = TRUE;
+    ORLACO_tsMsg sMsg;
 
-    // First part of the message so ensure the buffer offset is set to zero
-    psBuffer->u32Offset = 0;
+    if(psInstance->eVerbosity >= E_ORLACO_VERBOSITY_DEBUG) printf("%s()\n", __FUNCTION__);
 
+    if((psFormat->u16NumBins == 0) || (psFormat->u16NumBins > ORLACO_HISTOGRAM_MAX_BINS))
+    {
+        printf("Error: Histogram must have 1 to %d bins in %s\n", ORLACO_HISTOGRAM_MAX_BINS, __FUNCTION__);
+        return FALSE;
+    }
 
-    // Service ID
-    bOk &= ORLACO_bWriteU16(psBuffer, psMsg->u16ServiceID);
+    // Allocate a buffer
+    ORLACO_tsBuffer *psBuffer = ORLACO_psBufferCreate(ORLACO_BUFFER_LENGTH);
+    if(psBuffer == NULL)
+    {
+        printf("Error: Buffer allocation failed in %s\n", __FUNCTION__);
+        return FALSE;
+    }
+
+    // Construct the message header
+    sMsg.u16ServiceID = psInstance->u16ServiceID;
+    sMsg.u16MethodID = E_ORLACO_METHOD_ID_SET_HISTOGRAMM_FORMAT;
+
+    sMsg.u32Length = 8;
+
+    sMsg.u16ClientID = psInstance->u16ClientID;
+    sMsg.u16SessionID = ORLACO_u16GetSessionID(psInstance);
+
+    sMsg.u8SomeIPVersion = 1;
+    sMsg.u8InterfaceVersion = 1;
+    sMsg.u8MessageType = E_ORLACO_MESSAGE_TYPE_REQUEST;
+    sMsg.u8ReturnCode = E_ORLACO_RETURN_CODE_OK;
+
+    // Add the message payload and adjust the length field to include it
+    sMsg.u32Length += ORLACO_HISTOGRAM_FORMAT_LENGTH;
+    sMsg.uPayload.sHistogramFormatPayload.u32RegionOfInterest = u32RegionOfInterest;
+    sMsg.uPayload.sHistogramFormatPayload.u16NumBins = psFormat->u16NumBins;
+    sMsg.uPayload.sHistogramFormatPayload.u8Channel = psFormat->u8Channel;
+    sMsg.uPayload.sHistogramFormatPayload.u8Interval = psFormat->u8Interval;
+
+    // Write the message header into the byte array buffer
+    bOk &= ORLACO_bWriteMessageHeaderIntoBuffer(psBuffer, &sMsg);
+
+    // Write the payload into the buffer
+    bOk &= ORLACO_bWriteU32(psBuffer, sMsg.uPayload.sHistogramFormatPayload.u32RegionOfInterest);
+    bOk &= ORLACO_bWriteU16(psBuffer, sMsg.uPayload.sHistogramFormatPayload.u16NumBins);
+    bOk &= ORLACO_bWriteU8(psBuffer, sMsg.uPayload.sHistogramFormatPayload.u8Channel);
+    bOk &= ORLACO_bWriteU8(psBuffer, sMsg.uPayload.sHistogramFormatPayload.u8Interval);
+
+    // If we couldn't write the message to the buffer for some reason, free the buffer and then exit
+    if(!bOk)
+    {
+        ORLACO_vBufferDestroy(psBuffer);
+        return FALSE;
+    }
+
+    // Send the message
+    if(!ORLACO_bSendDatagram(psInstance->Socket, &psInstance->fdUnicast, psBuffer))
+    {
+        return FALSE;
+    }
+
+    // See if we get a response
+    bOk &= ORLACO_bReceiveDatagram(psInstance, &sMsg, E_ORLACO_METHOD_ID_SET_HISTOGRAMM_FORMAT);
+
+    return bOk;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: ORLACO_bGetHistogramFormat
+ *
+ * DESCRIPTION:
+ * Gets the histogram the camera computes for a region of interest
+ *
+ * RETURNS:
+ * bool_t TRUE if successful, FALSE otherwise
+ *
+ ****************************************************************************/
+bool_t ORLACO_bGetHistogramFormat(ORLACO_tsInstance *psInstance, uint32_t u32RegionOfInterest, ORLACO_tsHistogramFormat *psFormat)
+{
+    bool_t bOk = TRUE;
+    ORLACO_tsMsg sMsg;
+
+    if(psInstance->eVerbosity >= E_ORLACO_VERBOSITY_DEBUG) printf("%s()\n", __FUNCTION__);
+
+    // Allocate a buffer
+    ORLACO_tsBuffer *psBuffer = ORLACO_psBufferCreate(ORLACO_BUFFER_LENGTH);
+    if(psBuffer == NULL)
+    {
+        printf("Error: Buffer allocation failed in %s\n", __FUNCTION__);
+        return FALSE;
+    }
+
+    // Construct the message header
+    sMsg.u16ServiceID = psInstance->u16ServiceID;
+    sMsg.u16MethodID = E_ORLACO_METHOD_ID_GET_HISTOGRAMM_FORMAT;
+
+    sMsg.u32Length = 8;
+
+    sMsg.u16ClientID = psInstance->u16ClientID;
+    sMsg.u16SessionID = ORLACO_u16GetSessionID(psInstance);
+
+    sMsg.u8SomeIPVersion = 1;
+    sMsg.u8InterfaceVersion = 1;
+    sMsg.u8MessageType = E_ORLACO_MESSAGE_TYPE_REQUEST;
+    sMsg.u8ReturnCode = E_ORLACO_RETURN_CODE_OK;
+
+    // Add the message payload and adjust the length field to include it
+    sMsg.u32Length += sizeof(sMsg.uPayload.sGetRegionOfInterestRequestPayload);
+    sMsg.uPayload.sGetRegionOfInterestRequestPayload.u32RegionOfInterest = u32RegionOfInterest;
+
+    // Write the message header into the byte array buffer
+    bOk &= ORLACO_bWriteMessageHeaderIntoBuffer(psBuffer, &sMsg);
+
+    // Write the payload into the buffer
+    bOk &= ORLACO_bWriteU32(psBuffer, sMsg.uPayload.sGetRegionOfInterestRequestPayload.u32RegionOfInterest);
+
+    // If we couldn't write the message to the buffer for some reason, free the buffer and then exit
+    if(!bOk)
+    {
+        ORLACO_vBufferDestroy(psBuffer);
+        return FALSE;
+    }
+
+    // Send the message
+    if(!ORLACO_bSendDatagram(psInstance->Socket, &psInstance->fdUnicast, psBuffer))
+    {
+        return FALSE;
+    }
+
+    // See if we get a response, exit if not
+    if(!ORLACO_bReceiveDatagram(psInstance, &sMsg, E_ORLACO_METHOD_ID_GET_HISTOGRAMM_FORMAT))
+    {
+        return FALSE;
+    }
+
+    psFormat->u16NumBins = sMsg.uPayload.sHistogramFormatPayload.u16NumBins;
+    psFormat->u8Channel = sMsg.uPayload.sHistogramFormatPayload.u8Channel;
+    psFormat->u8Interval = sMsg.uPayload.sHistogramFormatPayload.u8Interval;
+
+    if(psInstance->eVerbosity >= E_ORLACO_VERBOSITY_DEBUG) printf("ROI=%d Bins=%d Channel=%d Interval=%d\n",
+                                  sMsg.uPayload.sHistogramFormatPayload.u32RegionOfInterest,
+                                  sMsg.uPayload.sHistogramFormatPayload.u16NumBins,
+                                  sMsg.uPayload.sHistogramFormatPayload.u8Channel,
+                                  sMsg.uPayload.sHistogramFormatPayload.u8Interval);
+
+    return TRUE;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: ORLACO_bSubscribeRoiHistogram
+ *
+ * DESCRIPTION:
+ * Subscribes to or unsubscribes from the histogram notifications of a region
+ * of interest. Notifications are sent to our port for as long as the
+ * subscription lasts.
+ *
+ * RETURNS:
+ * bool_t TRUE if successful, FALSE otherwise
+ *
+ ****************************************************************************/
+bool_t ORLACO_bSubscribeRoiHistogram(ORLACO_tsInstance *psInstance, uint32_t u32RegionOfInterest, bool_t bSubscribe)
+{
+    bool_t bOk = TRUE;
+    ORLACO_tsMsg sMsg;
+
+    if(psInstance->eVerbosity >= E_ORLACO_VERBOSITY_DEBUG) printf("%s()\n", __FUNCTION__);
+
+    // Allocate a buffer
+    ORLACO_tsBuffer *psBuffer = ORLACO_psBufferCreate(ORLACO_BUFFER_LENGTH);
+    if(psBuffer == NULL)
+    {
+        printf("Error: Buffer allocation failed in %s\n", __FUNCTION__);
+        return FALSE;
+    }
+
+    // Construct the message header
+    sMsg.u16ServiceID = psInstance->u16ServiceID;
+    sMsg.u16MethodID = bSubscribe ? E_ORLACO_METHOD_ID_SUBSCRIBE_ROI_HISTOGRAMM : E_ORLACO_METHOD_ID_UNSUBSCRIBE_ROI_HISTOGRAMM;
+
+    sMsg.u32Length = 8;
+
+    sMsg.u16ClientID = psInstance->u16ClientID;
+    sMsg.u16SessionID = ORLACO_u16GetSessionID(psInstance);
+
+    sMsg.u8SomeIPVersion = 1;
+    sMsg.u8InterfaceVersion = 1;
+    sMsg.u8MessageType = E_ORLACO_MESSAGE_TYPE_REQUEST;
+    sMsg.u8ReturnCode = E_ORLACO_RETURN_CODE_OK;
+
+    // Add the message payload and adjust the length field to include it
+    sMsg.u32Length += sizeof(sMsg.uPayload.sSubscribeRegionOfInterestPayload);
+    sMsg.uPayload.sSubscribeRegionOfInterestPayload.u32RegionOfInterest = u32RegionOfInterest;
+
+    // Write the message header into the byte array buffer
+    bOk &= ORLACO_bWriteMessageHeaderIntoBuffer(psBuffer, &sMsg);
+
+    // Write the payload into the buffer
+    bOk &= ORLACO_bWriteU32(psBuffer, sMsg.uPayload.sSubscribeRegionOfInterestPayload.u32RegionOfInterest);
+
+    // If we couldn't write the message to the buffer for some reason, free the buffer and then exit
+    if(!bOk)
+    {
+        ORLACO_vBufferDestroy(psBuffer);
+        return FALSE;
+    }
+
+    // Send the message
+    if(!ORLACO_bSendDatagram(psInstance->Socket, &psInstance->fdUnicast, psBuffer))
+    {
+        return FALSE;
+    }
+
+    // See if we get a response
+    bOk &= ORLACO_bReceiveDatagram(psInstance, &sMsg, sMsg.u16MethodID);
+
+    return bOk;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: ORLACO_bReceiveHistogram
+ *
+ * DESCRIPTION:
+ * Waits up to one socket read timeout for a histogram notification from any
+ * camera we have subscribed to. Anything else that arrives is dropped, once
+ * any SD message in it has been tracked.
+ *
+ * RETURNS:
+ * bool_t TRUE if a histogram was received, FALSE otherwise
+ *
+ ****************************************************************************/
+bool_t ORLACO_bReceiveHistogram(ORLACO_tsInstance *psInstance, ORLACO_tsHistogram *psHistogram)
+{
+    bool_t bOk = TRUE;
+    ORLACO_tsMsg sMsg;
+    struct sockaddr_in sRxAddr;
+    bool_t bMulticast;
+    ORLACO_tuIP uIP;
+    uint16_t u16Reserved;
+    int iLen;
+    int n;
+
+    // Allocate a buffer
+    ORLACO_tsBuffer *psBuffer = ORLACO_psBufferCreate(ORLACO_BUFFER_LENGTH);
+    if(psBuffer == NULL)
+    {
+        printf("Error: Buffer allocation failed in %s\n", __FUNCTION__);
+        return FALSE;
+    }
+
+    iLen = ORLACO_iReceiveFrom(psInstance, psBuffer->pu8Data, psBuffer->u32Length, 0, &sRxAddr, &bMulticast);
+    if(iLen <= 0)
+    {
+        ORLACO_vBufferDestroy(psBuffer);
+        return FALSE;
+    }
+    psBuffer->u32Length = (uint32_t)iLen;
+    psBuffer->u32Offset = 0;
+
+    bOk &= ORLACO_bReadMessageHeaderFromBuffer(psBuffer, &sMsg);
+    if(!bOk ||
+       (sMsg.u16ServiceID != psInstance->u16ServiceID) ||
+       (sMsg.u8MessageType != E_ORLACO_MESSAGE_TYPE_NOTIFICATION) ||
+       ((sMsg.u16MethodID & ~ORLACO_EVENT_ID_FLAG) != E_ORLACO_METHOD_ID_SUBSCRIBE_ROI_HISTOGRAMM))
+    {
+        if(psInstance->eVerbosity >= E_ORLACO_VERBOSITY_DEBUG) printf("Dropping message %04x:%04x type %02x in %s\n", sMsg.u16ServiceID, sMsg.u16MethodID, sMsg.u8MessageType, __FUNCTION__);
+        uIP.u32IP = ntohl(sRxAddr.sin_addr.s_addr);
+        ORLACO_vTrackServiceDiscovery(psInstance, uIP, bMulticast, psBuffer->pu8Data, iLen);
+        ORLACO_vBufferDestroy(psBuffer);
+        return FALSE;
+    }
+
+    // Get the IP address of the sender
+#ifdef _WIN32
+    psHistogram->uIP.au8IP[3] = sRxAddr.sin_addr.S_un.S_un_b.s_b1;
+    psHistogram->uIP.au8IP[2] = sRxAddr.sin_addr.S_un.S_un_b.s_b2;
+    psHistogram->uIP.au8IP[1] = sRxAddr.sin_addr.S_un.S_un_b.s_b3;
+    psHistogram->uIP.au8IP[0] = sRxAddr.sin_addr.S_un.S_un_b.s_b4;
+#else
+    psHistogram->uIP.au8IP[3] = (uint8_t)((sRxAddr.sin_addr.s_addr >> 0) & 0xff);
+    psHistogram->uIP.au8IP[2] = (uint8_t)((sRxAddr.sin_addr.s_addr >> 8) & 0xff);
+    psHistogram->uIP.au8IP[1] = (uint8_t)((sRxAddr.sin_addr.s_addr >> 16) & 0xff);
+    psHistogram->uIP.au8IP[0] = (uint8_t)((sRxAddr.sin_addr.s_addr >> 24) & 0xff);
+#endif
+
+    // Not documented either; ROI, frame counter, number of bins and padding, then one count per bin
+    bOk &= ORLACO_bReadU32(psBuffer, &psHistogram->u32RegionOfInterest);
+    bOk &= ORLACO_bReadU32(psBuffer, &psHistogram->u32FrameCounter);
+    bOk &= ORLACO_bReadU16(psBuffer, &psHistogram->u16NumBins);
+    bOk &= ORLACO_bReadU16(psBuffer, &u16Reserved);
+    if(!bOk || (psHistogram->u16NumBins == 0) || (psHistogram->u16NumBins > ORLACO_HISTOGRAM_MAX_BINS))
+    {
+        printf("Error: Malformed histogram from %d.%d.%d.%d in %s\n", psHistogram->uIP.au8IP[3], psHistogram->uIP.au8IP[2], psHistogram->uIP.au8IP[1], psHistogram->uIP.au8IP[0], __FUNCTION__);
+        ORLACO_vBufferDestroy(psBuffer);
+        return FALSE;
+    }
+
+    for(n = 0; n < psHistogram->u16NumBins; n++)
+    {
+        bOk &= ORLACO_bReadU32(psBuffer, &psHistogram->au32Bins[n]);
+    }
+
+    ORLACO_vBufferDestroy(psBuffer);
+
+    return bOk;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: ORLACO_bGetRegionOfInterest
+ *
+ * DESCRIPTION:
+ * Writes the specified region of interest to the camera
+ *
+ * RETURNS:
+ * bool_t TRUE if successful, FALSE otherwise
+ *
+ ****************************************************************************/
+bool_t ORLACO_bSetRegionOfInterest(ORLACO_tsInstance *psInstance, uint32_t u32RegionOfInterestIndex, ORLACO_tsRegionOfInterest *psRegionOfInterest)
+{
+    bool_t bOk = TRUE;
+    ORLACO_tsMsg sMsg;
+
+    if(psInstance->eVerbosity >= E_ORLACO_VERBOSITY_DEBUG) printf("%s()\n", __FUNCTION__);
+
+    // Allocate a buffer
+    ORLACO_tsBuffer *psBuffer = ORLACO_psBufferCreate(ORLACO_BUFFER_LENGTH);
+    if(psBuffer == NULL)
+    {
+        printf("Error: Buffer allocation failed in %s\n", __FUNCTION__);
+        return FALSE;
+    }
+
+    // Construct the message header
+    sMsg.u16ServiceID = psInstance->u16ServiceID;
+    sMsg.u16MethodID = E_ORLACO_METHOD_ID_SET_REGION_OF_INTEREST;
+
+    sMsg.u32Length = 8;
+
+    sMsg.u16ClientID = psInstance->u16ClientID;
+    sMsg.u16SessionID = ORLACO_u16GetSessionID(psInstance);
+
+    sMsg.u8SomeIPVersion = 1;
+    sMsg.u8InterfaceVersion = 1;
+    sMsg.u8MessageType = E_ORLACO_MESSAGE_TYPE_REQUEST;
+    sMsg.u8ReturnCode = E_ORLACO_RETURN_CODE_OK;
+
+    sMsg.uPayload.sSetRegionOfInterestPayload.u32RegionOfInterestIndex = u32RegionOfInterestIndex;
+    sMsg.uPayload.sSetRegionOfInterestPayload.u16P1X = psRegionOfInterest->u16P1X;
+    sMsg.uPayload.sSetRegionOfInterestPayload.u16P1Y = psRegionOfInterest->u16P1Y;
+    sMsg.uPayload.sSetRegionOfInterestPayload.u16P2X = psRegionOfInterest->u16P2X;
+    sMsg.uPayload.sSetRegionOfInterestPayload.u16P2Y = psRegionOfInterest->u16P2Y;
+    sMsg.uPayload.sSetRegionOfInterestPayload.u8Unknown1SetTo0x01 = 0x01; // no idea what this does yet, if set to 0, return code is 0x32 - invalid value in video format
+    sMsg.uPayload.sSetRegionOfInterestPayload.u8Unknown2SetTo0x00 = 0x00; // no idea what this does yet, if set to 1, return code is 0x32 - invalid value in video format
+    sMsg.uPayload.sSetRegionOfInterestPayload.u16Unknown3SetTo0x0000 = 0x0000; // no idea what this does yet, if set to 1, return code is 0x32 - invalid value in video format
+    sMsg.uPayload.sSetRegionOfInterestPayload.u16OutputWidth = psRegionOfInterest->u16OutputWidth;
+    sMsg.uPayload.sSetRegionOfInterestPayload.u16OutputHeight = psRegionOfInterest->u16OutputHeight;
+    sMsg.uPayload.sSetRegionOfInterestPayload.u8Unknown4SetTo0x00 = 0x00; // no idea what this does yet
+    sMsg.uPayload.sSetRegionOfInterestPayload.u8FrameRate = psRegionOfInterest->u8FrameRate;
+    sMsg.uPayload.sSetRegionOfInterestPayload.u16Unknown4bSetTo0x0000 = 0x0000; // no idea what this does yet
+    sMsg.uPayload.sSetRegionOfInterestPayload.u8Unknown5SetTo0x00 = 0x00; // no idea what this does yet
+    sMsg.uPayload.sSetRegionOfInterestPayload.u8Unknown6SetTo0x02 = 0x02; // no idea what this does yet, if set to 1, return code is 0x32 - invalid value in video format
+    sMsg.uPayload.sSetRegionOfInterestPayload.u32MaxBitrate = psRegionOfInterest->u32MaxBitrate;
+    sMsg.uPayload.sSetRegionOfInterestPayload.u8VideoCompressionMode = (uint8_t)psRegionOfInterest->eCompressionMode;
+    sMsg.uPayload.sSetRegionOfInterestPayload.u8Unknown7SetTo0x00 = 0x00; // no idea what this does yet, setting to 1 returns ok
+    sMsg.uPayload.sSetRegionOfInterestPayload.u8Unknown8SetTo0x00 = 0x00; // no idea what this does yet, setting to 1 returns ok
+    sMsg.uPayload.sSetRegionOfInterestPayload.u8Unknown9SetTo0x00 = 0x00; // no idea what this does yet, setting to 1 returns ok
+    sMsg.uPayload.sSetRegionOfInterestPayload.u8Unknown10SetTo0x04 = 0x04; // no idea what this does yet
+    sMsg.uPayload.sSetRegionOfInterestPayload.u8Unknown11SetTo0x01 = 0x01; // no idea what this does yet
+    sMsg.uPayload.sSetRegionOfInterestPayload.u16Unknown12SetTo0x00ff = 0x00ff; // no idea what this does yet
+
+
+    // Adjust the length field to include the payload
+    sMsg.u32Length += 38;
+
+    // printf("Len=%d %d\n", sMsg.u32Length, sizeof(ORLACO_tsSetRegionOfInterestPayload));
+
+    // Write the message header into the byte array buffer
+    bOk &= ORLACO_bWriteMessageHeaderIntoBuffer(psBuffer, &sMsg);
+
+    // Write the payload into the buffer
+    bOk &= ORLACO_bWriteU32(psBuffer, sMsg.uPayload.sSetRegionOfInterestPayload.u32RegionOfInterestIndex);
+    bOk &= ORLACO_bWriteU16(psBuffer, sMsg.uPayload.sSetRegionOfInterestPayload.u16P1X);
+    bOk &= ORLACO_bWriteU16(psBuffer, sMsg.uPayload.sSetRegionOfInterestPayload.u16P1Y);
+    bOk &= ORLACO_bWriteU16(psBuffer, sMsg.uPayload.sSetRegionOfInterestPayload.u16P2X);
+    bOk &= ORLACO_bWriteU16(psBuffer, sMsg.uPayload.sSetRegionOfInterestPayload.u16P2Y);
+    bOk &= ORLACO_bWriteU8(psBuffer, sMsg.uPayload.sSetRegionOfInterestPayload.u8Unknown1SetTo0x01);
+    bOk &= ORLACO_bWriteU8(psBuffer, sMsg.uPayload.sSetRegionOfInterestPayload.u8Unknown2SetTo0x00);
+    bOk &= ORLACO_bWriteU16(psBuffer, sMsg.uPayload.sSetRegionOfInterestPayload.u16Unknown3SetTo0x0000);
+    bOk &= ORLACO_bWriteU16(psBuffer, sMsg.uPayload.sSetRegionOfInterestPayload.u16OutputWidth);
+    bOk &= ORLACO_bWriteU16(psBuffer, sMsg.uPayload.sSetRegionOfInterestPayload.u16OutputHeight);
+    bOk &= ORLACO_bWriteU8(psBuffer, sMsg.uPayload.sSetRegionOfInterestPayload.u8Unknown4SetTo0x00);
+    bOk &= ORLACO_bWriteU8(psBuffer, sMsg.uPayload.sSetRegionOfInterestPayload.u8FrameRate);
+    bOk &= ORLACO_bWriteU16(psBuffer, sMsg.uPayload.sSetRegionOfInterestPayload.u16Unknown4bSetTo0x0000);
+    bOk &= ORLACO_bWriteU8(psBuffer, sMsg.uPayload.sSetRegionOfInterestPayload.u8Unknown5SetTo0x00);
+    bOk &= ORLACO_bWriteU8(psBuffer, sMsg.uPayload.sSetRegionOfInterestPayload.u8Unknown6SetTo0x02);
+    bOk &= ORLACO_bWriteU32(psBuffer, sMsg.uPayload.sSetRegionOfInterestPayload.u32MaxBitrate);
+    bOk &= ORLACO_bWriteU8(psBuffer, sMsg.uPayload.sSetRegionOfInterestPayload.u8VideoCompressionMode);
+    bOk &= ORLACO_bWriteU8(psBuffer, sMsg.uPayload.sSetRegionOfInterestPayload.u8Unknown7SetTo0x00);
+    bOk &= ORLACO_bWriteU8(psBuffer, sMsg.uPayload.sSetRegionOfInterestPayload.u8Unknown8SetTo0x00);
+    bOk &= ORLACO_bWriteU8(psBuffer, sMsg.uPayload.sSetRegionOfInterestPayload.u8Unknown9SetTo0x00);
+    bOk &= ORLACO_bWriteU8(psBuffer, sMsg.uPayload.sSetRegionOfInterestPayload.u8Unknown10SetTo0x04);
+    bOk &= ORLACO_bWriteU8(psBuffer, sMsg.uPayload.sSetRegionOfInterestPayload.u8Unknown11SetTo0x01);
+    bOk &= ORLACO_bWriteU16(psBuffer, sMsg.uPayload.sSetRegionOfInterestPayload.u16Unknown12SetTo0x00ff);
+
+    // If we couldn't write the message to the buffer for some reason, free the buffer and then exit
+    if(!bOk)
+    {
+        ORLACO_vBufferDestroy(psBuffer);
+        return FALSE;
+    }
+
+    // Send the message
+    if(!ORLACO_bSendDatagram(psInstance->Socket, &psInstance->fdUnicast, psBuffer))
+    {
+        return FALSE;
+    }
+
+    // See if we get a response
+    bOk &= ORLACO_bReceiveDatagram(psInstance, &sMsg, E_ORLACO_METHOD_ID_SET_REGION_OF_INTEREST);
+
+    if(bOk)
+    {
+        ORLACO_vObserveRegionOfInterest(psInstance, u32RegionOfInterestIndex, psRegionOfInterest);
+    }
+
+    return bOk;
+
+}
+
+/****************************************************************************/
+/***        Local Functions                                               ***/
+/****************************************************************************/
+
+/****************************************************************************
+ *
+ * NAME: ORLACO_u16GetSessionID
+ *
+ * DESCRIPTION:
+ * Gets a session ID
+ *
+ * RETURNS:
+ * uint16_t
+ *
+ ****************************************************************************/
+static uint16_t ORLACO_u16GetSessionID(ORLACO_tsInstance *psInstance)
+{
+    // increment the session ID. Add extra 1 if that rolls us over to zero since 0 = no session ID
+    psInstance->u16SessionID++;
+    if(psInstance->u16SessionID == 0)
+    {
+        psInstance->u16SessionID = 1;
+    }
+    return psInstance->u16SessionID;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: ORLACO_psBufferCreate
+ *
+ * DESCRIPTION:
+ * Creates a buffer
+ *
+ * RETURNS:
+ * ORLACO_tsBuffer* A pointer to a buffer, or NULL if something failed
+ *
+ ****************************************************************************/
+static ORLACO_tsBuffer *ORLACO_psBufferCreate(uint32_t u32DataLength)
+{
+    // Try and allocate some memory for a buffer. Exit if this fails
+    ORLACO_tsBuffer *psBuffer = (ORLACO_tsBuffer*)malloc(sizeof(ORLACO_tsBuffer));
+    if(psBuffer == NULL)
+    {
+        return NULL;
+    }
+
+    // Initialise to 0
+    memset(psBuffer, 0, sizeof(ORLACO_tsBuffer));
+
+    // Try and allocate the memory for the data. If this fails, free the buffer and return
+    psBuffer->pu8Data = (uint8_t*)malloc(u32DataLength);
+    if(psBuffer->pu8Data == NULL)
+    {
+        free(psBuffer);
+        return NULL;
+    }
+
+    psBuffer->u32Length = u32DataLength;
+
+    return psBuffer;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: ORLACO_vBufferDestroy
+ *
+ * DESCRIPTION:
+ * Destroys a buffer
+ *
+ * RETURNS:
+ * void
+ *
+ ****************************************************************************/
+static void ORLACO_vBufferDestroy(ORLACO_tsBuffer *psBuffer)
+{
+    // Don't try and free a buffer that hasn't been allocated!
+    if(psBuffer == NULL)
+    {
+        return;
+    }
+
+    // Only free the data buffer if it was successfully allocated in the first place
+    if(psBuffer->pu8Data != NULL)
+    {
+        free(psBuffer->pu8Data);
+    }
+
+    // Now we can free the buffer
+    free(psBuffer);
+}
+
+
+/****************************************************************************
+ *
+ * NAME: ORLACO_bWriteU8
+ *
+ * DESCRIPTION:
+ * Writes an 8 bit value into a buffer
+ *
+ * RETURNS:
+ * bool_t - TRUE if the data was written, FALSE otherwise
+ *
+ ****************************************************************************/
+static bool_t ORLACO_bWriteU8(ORLACO_tsBuffer *psBuffer, uint8_t u8Data)
+{
+
+    uint8_t *pu8WritePtr = psBuffer->pu8Data + psBuffer->u32Offset;
+
+    // Check we're not about to write past the end of the buffer
+    if((psBuffer->u32Offset + 1) >= psBuffer->u32Length)
+    {
+        // Return failure
+        return FALSE;
+    }
+
+    // Write the data into the buffer and adjust the offset value
+    *pu8WritePtr = u8Data;
+    psBuffer->u32Offset += 1;
+
+    // Return success
+    return TRUE;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: ORLACO_bWriteU16
+ *
+ * DESCRIPTION:
+ * Writes a 16 bit value into a buffer
+ *
+ * RETURNS:
+ * bool_t - TRUE if the data was written, FALSE otherwise
+ *
+ ****************************************************************************/
+static bool_t ORLACO_bWriteU16(ORLACO_tsBuffer *psBuffer, uint16_t u16Data)
+{
+    uint8_t *pu8WritePtr = psBuffer->pu8Data + psBuffer->u32Offset;
+
+    // Check we're not about to write past the end of the buffer
+    if((psBuffer->u32Offset + 1) >= psBuffer->u32Length)
+    {
+        // Return failure
+        return FALSE;
+    }
+
+    // Write the data into the buffer and adjust the offset value
+    *pu8WritePtr = (u16Data >> 8) & 0xff;
+    pu8WritePtr++;
+    *pu8WritePtr = (u16Data >> 0) & 0xff;
+    psBuffer->u32Offset += 2;
+
+    // Return success
+    return TRUE;
+
+}
+
+
+/****************************************************************************
+ *
+ * NAME: ORLACO_bWriteU24
+ *
+ * DESCRIPTION:
+ * Writes a 24 bit value into a buffer
+ *
+ * RETURNS:
+ * bool_t - TRUE if the data was written, FALSE otherwise
+ *
+ ****************************************************************************/
+static bool_t ORLACO_bWriteU24(ORLACO_tsBuffer *psBuffer, uint32_t u24Data)
+{
+    uint8_t *pu8WritePtr = psBuffer->pu8Data + psBuffer->u32Offset;
+
+    // Check we're not about to write past the end of the buffer
+    if((psBuffer->u32Offset + 1) >= psBuffer->u32Length)
+    {
+        // Return failure
+        return FALSE;
+    }
+
+    // Write the data into the buffer and adjust the offset value
+    *pu8WritePtr = (u24Data >> 16) & 0xff;
+    pu8WritePtr++;
+    *pu8WritePtr = (u24Data >> 8) & 0xff;
+    pu8WritePtr++;
+    *pu8WritePtr = (u24Data >> 0) & 0xff;
+    psBuffer->u32Offset += 3;
+
+    // Return success
+    return TRUE;
+
+}
+
+
+/****************************************************************************
+ *
+ * NAME: ORLACO_bWriteU32
+ *
+ * DESCRIPTION:
+ * Writes a 32 bit value into a buffer
+ *
+ * RETURNS:
+ * bool_t - TRUE if the data was written, FALSE otherwise
+ *
+ ****************************************************************************/
+static bool_t ORLACO_bWriteU32(ORLACO_tsBuffer *psBuffer, uint32_t u32Data)
+{
+    uint8_t *pu8WritePtr = psBuffer->pu8Data + psBuffer->u32Offset;
+
+    // Check we're not about to write past the end of the buffer
+    if((psBuffer->u32Offset + 1) >= psBuffer->u32Length)
+    {
+        // Return failure
+        return FALSE;
+    }
+
+    // Write the data into the buffer and adjust the offset value
+    *pu8WritePtr = (u32Data >> 24) & 0xff;
+    pu8WritePtr++;
+    *pu8WritePtr = (u32Data >> 16) & 0xff;
+    pu8WritePtr++;
+    *pu8WritePtr = (u32Data >> 8) & 0xff;
+    pu8WritePtr++;
+    *pu8WritePtr = (u32Data >> 0) & 0xff;
+    psBuffer->u32Offset += 4;
+
+    // Return success
+    return TRUE;
+
+}
+
+
+/****************************************************************************
+ *
+ * NAME: ORLACO_bReadU8
+ *
+ * DESCRIPTION:
+ * Reads an 8 bit value from a buffer
+ *
+ * RETURNS:
+ * bool_t - TRUE if the data was read, FALSE otherwise
+ *
+ ****************************************************************************/
+static bool_t ORLACO_bReadU8(ORLACO_tsBuffer *psBuffer, uint8_t *pu8Data)
+{
+    uint8_t *pu8ReadPtr = psBuffer->pu8Data + psBuffer->u32Offset;
+
+    // Check we're not about to read past the end of the buffer
+    if((psBuffer->u32Offset + 1) > psBuffer->u32Length)
+    {
+        // Return failure
+        return FALSE;
+    }
+
+    // Read the data from the buffer
+    *pu8Data = *pu8ReadPtr;
+    psBuffer->u32Offset += 1;
+
+    // Return success
+    return TRUE;
+
+}
+
+
+/****************************************************************************
+ *
+ * NAME: ORLACO_bReadU16
+ *
+ * DESCRIPTION:
+ * Reads a 16 bit value from a buffer
+ *
+ * RETURNS:
+ * bool_t - TRUE if the data was read, FALSE otherwise
+ *
+ ****************************************************************************/
+static bool_t ORLACO_bReadU16(ORLACO_tsBuffer *psBuffer, uint16_t *pu16Data)
+{
+    uint16_t u16Data = 0;
+    uint8_t *pu8ReadPtr = psBuffer->pu8Data + psBuffer->u32Offset;
+
+    // Check we're not about to read past the end of the buffer
+    if((psBuffer->u32Offset + 2) > psBuffer->u32Length)
+    {
+        // Return failure
+        return FALSE;
+    }
+
+    // Read the data from the buffer
+    u16Data = (*(pu8ReadPtr++)) << 8;
+    u16Data |= (*(pu8ReadPtr++)) << 0;
+
+    *pu16Data = u16Data;
+    psBuffer->u32Offset += 2;
+
+    // Return success
+    return TRUE;
+
+}
+
+
+/****************************************************************************
+ *
+ * NAME: ORLACO_bReadU24
+ *
+ * DESCRIPTION:
+ * Reads a 24 bit value from a buffer
+ *
+ * RETURNS:
+ * bool_t - TRUE if the data was read, FALSE otherwise
+ *
+ ****************************************************************************/
+static bool_t ORLACO_bReadU24(ORLACO_tsBuffer *psBuffer, uint32_t *pu24Data)
+{
+    uint32_t u24Data = 0;
+    uint8_t *pu8ReadPtr = psBuffer->pu8Data + psBuffer->u32Offset;
+
+    // Check we're not about to read past the end of the buffer
+    if((psBuffer->u32Offset + 3) > psBuffer->u32Length)
+    {
+        // Return failure
+        return FALSE;
+    }
+
+    // Read the data from the buffer
+    u24Data  = (*(pu8ReadPtr++)) << 16;
+    u24Data |= (*(pu8ReadPtr++)) << 8;
+    u24Data |= (*(pu8ReadPtr++)) << 0;
+
+    *pu24Data = u24Data;
+    psBuffer->u32Offset += 3;
+
+    // Return success
+    return TRUE;
+
+}
+
+
+/****************************************************************************
+ *
+ * NAME: ORLACO_bReadU32
+ *
+ * DESCRIPTION:
+ * Reads a 32 bit value from a buffer
+ *
+ * RETURNS:
+ * bool_t - TRUE if the data was read, FALSE otherwise
+ *
+ ****************************************************************************/
+static bool_t ORLACO_bReadU32(ORLACO_tsBuffer *psBuffer, uint32_t *pu32Data)
+{
+    uint32_t u32Data = 0;
+    uint8_t *pu8ReadPtr = psBuffer->pu8Data + psBuffer->u32Offset;
+
+    // Check we're not about to read past the end of the buffer
+    if((psBuffer->u32Offset + 4) > psBuffer->u32Length)
+    {
+        // Return failure
+        return FALSE;
+    }
+
+    // Read the data from the buffer
+    u32Data  = (*(pu8ReadPtr++)) << 24;
+    u32Data |= (*(pu8ReadPtr++)) << 16;
+    u32Data |= (*(pu8ReadPtr++)) << 8;
+    u32Data |= (*(pu8ReadPtr++)) << 0;
+
+    *pu32Data = u32Data;
+    psBuffer->u32Offset += 4;
+
+    // Return success
+    return TRUE;
+
+}
+
+
+/****************************************************************************
+ *
+ * NAME: ORLACO_bWriteMessageHeaderIntoBuffer
+ *
+ * DESCRIPTION:
+ * Writes a message header into a buffer
+ *
+ * RETURNS:
+ * bool_t - TRUE if successful, FALSE otherwise
+ *
+ ****************************************************************************/
+static bool_t ORLACO_bWriteMessageHeaderIntoBuffer(ORLACO_tsBuffer *psBuffer, ORLACO_tsMsg *psMsg)
+{
+
+    bool_t bOk = TRUE;
+
+    // First part of the message so ensure the buffer offset is set to zero
+    psBuffer->u32Offset = 0;
+
+
+    // Service ID
+    bOk &= ORLACO_bWriteU16(psBuffer, psMsg->u16ServiceID);
+
+    // Method ID
+    bOk &= ORLACO_bWriteU16(psBuffer, psMsg->u16MethodID);
+
+    // Length
+    bOk &= ORLACO_bWriteU32(psBuffer, psMsg->u32Length);
+
+    // Client ID
+    bOk &= ORLACO_bWriteU16(psBuffer, psMsg->u16ClientID);
+
+    // Session ID
+    bOk &= ORLACO_bWriteU16(psBuffer, psMsg->u16SessionID);
+
+    // SOME/IP Version
+    bOk &= ORLACO_bWriteU8(psBuffer, psMsg->u8SomeIPVersion);
+
+    // Interface Version
+    bOk &= ORLACO_bWriteU8(psBuffer, psMsg->u8InterfaceVersion);
+
+    // Message type
+    bOk &= ORLACO_bWriteU8(psBuffer, psMsg->u8MessageType);
+
+    // Return code
+    bOk &= ORLACO_bWriteU8(psBuffer, psMsg->u8ReturnCode);
+  
+    return bOk;
+
+}
+
+
+/****************************************************************************
+ *
+ * NAME: ORLACO_vPrintBuffer
+ *
+ * DESCRIPTION:
+ * Prints the contents of a buffer to the console
+ *
+ * RETURNS:
+ * void
+ *
+ ****************************************************************************/
+static void ORLACO_vPrintBuffer(ORLACO_tsBuffer *psBuffer)
+{
+    for(int n = 0; n < psBuffer->u32Offset; n++)
+    {
+        printf(" %02x", psBuffer->pu8Data[n]);
+    }
+}
+
+
+/****************************************************************************
+ *
+ * NAME: ORLACO_bReadMessageHeaderFromBuffer
+ *
+ * DESCRIPTION:
+ * Reads a message header from a buffer
+ *
+ * RETURNS:
+ * bool_t - TRUE if successful, FALSE otherwise
+ *
+ ****************************************************************************/
+static bool_t ORLACO_bReadMessageHeaderFromBuffer(ORLACO_tsBuffer *psBuffer, ORLACO_tsMsg *psMsg)
+{
+
+    bool_t bOk = TRUE;
+
+    // Service ID
+    bOk &= ORLACO_bReadU16(psBuffer, &psMsg->u16ServiceID);
+
+    // Method ID
+    bOk &= ORLACO_bReadU16(psBuffer, &psMsg->u16MethodID);
+
+    // Length
+    bOk &= ORLACO_bReadU32(psBuffer, &psMsg->u32Length);
+
+    // There should be at least 8 bytes in the rest of the header, exit if not
+    if(psMsg->u32Length < 8)
+    {
+        printf("Not enough length (%d)!\n", psMsg->u32Length);
+        return FALSE;
+    }
+
+    // Client ID
+    bOk &= ORLACO_bReadU16(psBuffer, &psMsg->u16ClientID);
+
+    // Session ID
+    bOk &= ORLACO_bReadU16(psBuffer, &psMsg->u16SessionID);
+
+    // SOME/IP Version
+    bOk &= ORLACO_bReadU8(psBuffer, &psMsg->u8SomeIPVersion);
+
+    // Interface Version
+    bOk &= ORLACO_bReadU8(psBuffer, &psMsg->u8InterfaceVersion);
+
+    // Message type
+    bOk &= ORLACO_bReadU8(psBuffer, &psMsg->u8MessageType);
+
+    // Return code
+    bOk &= ORLACO_bReadU8(psBuffer, &psMsg->u8ReturnCode);
+  
+    return bOk;
+
+}
+
+
+/****************************************************************************
+ *
+ * NAME: ORLACO_bWriteServiceDiscoveryServiceEntryIntoBuffer
+ *
+ * DESCRIPTION:
+ * Writes a service discovery service entry into a buffer
+ *
+ * RETURNS:
+ * bool_t - TRUE if successful, FALSE otherwise
+ *
+ ****************************************************************************/
+static bool_t ORLACO_bWriteServiceDiscoveryServiceEntryIntoBuffer(ORLACO_tsBuffer *psBuffer, ORLACO_tsServiceDiscoveryServiceEntry *psServiceEntry)
+{
+
+    bool_t bOk = TRUE;
+
+    bOk &= ORLACO_bWriteU8(psBuffer, psServiceEntry->u8Type);
+    bOk &= ORLACO_bWriteU8(psBuffer, psServiceEntry->u8Index1stOptions);
+    bOk &= ORLACO_bWriteU8(psBuffer, psServiceEntry->u8Index2ndOptions);
+    bOk &= ORLACO_bWriteU8(psBuffer, psServiceEntry->u8NumberOfOptions);
+    bOk &= ORLACO_bWriteU16(psBuffer, psServiceEntry->u16ServiceID);
+    bOk &= ORLACO_bWriteU16(psBuffer, psServiceEntry->u16InstanceID);
+    bOk &= ORLACO_bWriteU8(psBuffer, psServiceEntry->u8MajorVersion);
+    bOk &= ORLACO_bWriteU24(psBuffer, psServiceEntry->u24TTL);
+    bOk &= ORLACO_bWriteU32(psBuffer, psServiceEntry->u32MinorVersion);
+
+    return bOk;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: ORLACO_bReadServiceDiscoveryServiceEntryFromBuffer
+ *
+ * DESCRIPTION:
+ * Reads a service discovery service entry from a buffer
+ *
+ * RETURNS:
+ * bool_t - TRUE if successful, FALSE otherwise
+ *
+ ****************************************************************************/
+static bool_t ORLACO_bReadServiceDiscoveryServiceEntryFromBuffer(ORLACO_tsBuffer *psBuffer, ORLACO_tsServiceDiscoveryServiceEntry *psServiceEntry)
+{
+
+    bool_t bOk = TRUE;
+
+    bOk &= ORLACO_bReadU8(psBuffer, &psServiceEntry->u8Type);
+    bOk &= ORLACO_bReadU8(psBuffer, &psServiceEntry->u8Index1stOptions);
+    bOk &= ORLACO_bReadU8(psBuffer, &psServiceEntry->u8Index2ndOptions);
+    bOk &= ORLACO_bReadU8(psBuffer, &psServiceEntry->u8NumberOfOptions);
+    bOk &= ORLACO_bReadU16(psBuffer, &psServiceEntry->u16ServiceID);
+    bOk &= ORLACO_bReadU16(psBuffer, &psServiceEntry->u16InstanceID);
+    bOk &= ORLACO_bReadU8(psBuffer, &psServiceEntry->u8MajorVersion);
+    bOk &= ORLACO_bReadU24(psBuffer, &psServiceEntry->u24TTL);
+    bOk &= ORLACO_bReadU32(psBuffer, &psServiceEntry->u32MinorVersion);
+
+    return bOk;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: ORLACO_bSendDatagram
+ *
+ * DESCRIPTION:
+ * Sends the contents of the specified buffer as a UDP datagram to the specified IP address
+ *
+ * RETURNS:
+ * bool_t - TRUE if successful, FALSE otherwise
+ *
+ ****************************************************************************/
+static bool_t ORLACO_bSendDatagram(UDPSOCKET sktTx, struct sockaddr_in *psDstAddr, ORLACO_tsBuffer *psBuffer)
+{
+    bool_t bOk = TRUE;
+    int iLen;
+    // printf("Tx: ");
+    // ORLACO_vPrintBuffer(psBuffer);
+    // printf("\n");
+
+    iLen = sendto(sktTx, (const char *)psBuffer->pu8Data, psBuffer->u32Offset, 0, (const struct sockaddr*)psDstAddr, sizeof(struct sockaddr_in));
+    if(iLen != psBuffer->u32Offset)
+    {
+        printf("Sendto returned %d\n", iLen);
+        bOk &= FALSE;
+    }
+
+    // Buffer no longer required so free it here
+    ORLACO_vBufferDestroy(psBuffer);
+
+    return bOk;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: ORLACO_bReceiveDatagram
+ *
+ * DESCRIPTION:
+ * Receives a message
+ *
+ * RETURNS:
+ * bool_t - TRUE if successful, FALSE otherwise
+ *
+ ****************************************************************************/
+static bool_t ORLACO_bReceiveDatagram(ORLACO_tsInstance *psInstance, ORLACO_tsMsg *psRxMsg, uint16_t u16MethodID)
+{
+    bool_t bOk = TRUE;
+    int iTimeout = (int)psInstance->u32ResponseTimeMs;
+    time_t tDeadline = time(NULL) + (psInstance->u32ResponseTimeMs / 1000);
+    int iLen = 0;
+
+    uint16_t u16SenderPort;
+    int64_t i64BytesReceived = 0;
+
+    struct sockaddr_in sRxAddr = {};
+    bool_t bMulticast;
+
+    memset(psRxMsg, 0, sizeof(ORLACO_tsMsg));
+
+    // Allocate a buffer
+    ORLACO_tsBuffer *psBuffer = ORLACO_psBufferCreate(ORLACO_BUFFER_LENGTH);
+    if(psBuffer == NULL)
+    {
+        printf("Error: Buffer allocation failed in %s\n", __FUNCTION__);
+        return FALSE;
+    }
+
+    do
+    {
+
+        while((iLen = ORLACO_iReceiveFrom(psInstance, psBuffer->pu8Data, psBuffer->u32Length, 0, &sRxAddr, &bMulticast)) <= 0)
+        {
+            // if(iLen == SOCKET_ERROR)
+            // {
+            //     printf("Last error = %d, ptr = %p\n",WSAGetLastError(), sRxBuffer.pu8Data);
+            //     // return FALSE;
+            // }
+            iTimeout -= ORLACO_SOCKET_READ_TIMEOUT_MS;
+            if(iTimeout <= 0)
+            {
+                if(psInstance->eVerbosity >= E_ORLACO_VERBOSITY_DEBUG) printf("Rx Timeout\n");
+                ORLACO_vBufferDestroy(psBuffer);
+                return FALSE;
+            }
+#ifdef _WIN32
+            Sleep(1);
+#else
+            usleep(1000);
+#endif
+        }
+
+        // printf("Addr: %s\n", inet_ntoa(sRxAddr.sin_addr));
+
+        psBuffer->u32Length = (uint32_t)iLen;
+
+        // psBuffer->u32Offset = (uint32_t)iLen;
+        // printf("Rx: ");
+        // ORLACO_vPrintBuffer(psBuffer);
+        // printf("\n");
+
+        // Get the IP address of the sender
+#ifdef _WIN32
+        psRxMsg->uSrcAddr.au8IP[3] = sRxAddr.sin_addr.S_un.S_un_b.s_b1;
+        psRxMsg->uSrcAddr.au8IP[2] = sRxAddr.sin_addr.S_un.S_un_b.s_b2;
+        psRxMsg->uSrcAddr.au8IP[1] = sRxAddr.sin_addr.S_un.S_un_b.s_b3;
+        psRxMsg->uSrcAddr.au8IP[0] = sRxAddr.sin_addr.S_un.S_un_b.s_b4;
+#else
+        psRxMsg->uSrcAddr.au8IP[3] = (uint8_t)((sRxAddr.sin_addr.s_addr >> 0) & 0xff);
+        psRxMsg->uSrcAddr.au8IP[2] = (uint8_t)((sRxAddr.sin_addr.s_addr >> 8) & 0xff);
+        psRxMsg->uSrcAddr.au8IP[1] = (uint8_t)((sRxAddr.sin_addr.s_addr >> 16) & 0xff);
+        psRxMsg->uSrcAddr.au8IP[0] = (uint8_t)((sRxAddr.sin_addr.s_addr >> 24) & 0xff);
+#endif
+
+        psBuffer->u32Offset = 0;
+
+        bOk = ORLACO_bReadMessageHeaderFromBuffer(psBuffer, psRxMsg);
+        if(!bOk){
+            printf("Error reading message header\n");
+            continue;
+        }
+
+        // SD messages are notifications too, but they're what discovery waits for
+        ORLACO_vTrackServiceDiscovery(psInstance, psRxMsg->uSrcAddr, bMulticast, psBuffer->pu8Data, iLen);
+        if((u16MethodID == E_ORLACO_METHOD_ID_SERVICE_DISCOVERY) && (psRxMsg->u16ServiceID == 0xffff) && (psRxMsg->u16MethodID == E_ORLACO_METHOD_ID_SERVICE_DISCOVERY))
+        {
+            break;
+        }
+
+        // Subscribed notifications share the socket, they're never the response we're waiting for.
+        // They keep the socket busy, so bound the wait by the clock rather than by read timeouts.
+        if(psRxMsg->u8MessageType == E_ORLACO_MESSAGE_TYPE_NOTIFICATION)
+        {
+            if(time(NULL) > tDeadline)
+            {
+                if(psInstance->eVerbosity >= E_ORLACO_VERBOSITY_DEBUG) printf("Rx Timeout\n");
+                ORLACO_vBufferDestroy(psBuffer);
+                return FALSE;
+            }
+            psBuffer->u32Length = ORLACO_BUFFER_LENGTH;
+            continue;
+        }
+
+        // printf("RX: ServiceID=%04x MethodID=%04x Length=%08x ClientID=%04x SessionID=%04x SOME/IP Version=%d Interface Version=%d MessageType=%02x ReturnCode=%02x\n",
+        //             psRxMsg->u16ServiceID,
+        //             psRxMsg->u16MethodID,
+        //             psRxMsg->u32Length,
+        //             psRxMsg->u16ClientID,
+        //             psRxMsg->u16SessionID,
+        //             psRxMsg->u8SomeIPVersion,
+        //             psRxMsg->u8InterfaceVersion,
+        //             psRxMsg->u8MessageType,
+        //             psRxMsg->u8ReturnCode);
+    }
+    while(((psRxMsg->u16ServiceID != psInstance->u16ServiceID)&&(psRxMsg->u16MethodID != u16MethodID)&&(!bOk)) ||
+          (psRxMsg->u8MessageType == E_ORLACO_MESSAGE_TYPE_NOTIFICATION));
+
+    // Check the response code
+    if(psRxMsg->u8ReturnCode != E_ORLACO_RETURN_CODE_OK)
+    {
+        printf("Error: Response code = %d: %s\n", psRxMsg->u8ReturnCode, ORLACO_pcGetReturnCodeAsString((ORLACO_teReturnCode)psRxMsg->u8ReturnCode));
+        ORLACO_vBufferDestroy(psBuffer);
+        return FALSE;
+    }
+
+    // printf("Rx Success\n");
+
+    switch(psRxMsg->u16MethodID)
+    {
+
+    case E_ORLACO_METHOD_ID_GET_DATA_SHEET:
+        break;
+
+    case E_ORLACO_METHOD_ID_GET_CAM_STATUS:
+        break;
+
+    case E_ORLACO_METHOD_ID_GET_HOST_PARAMETERS:
+        break;
+
+    case E_ORLACO_METHOD_ID_GET_REGION_OF_INTEREST:
+        bOk &= ORLACO_bReadU16(psBuffer, &psRxMsg->uPayload.sGetRegionOfInterestResponsePayload.u16P1X);
+        bOk &= ORLACO_bReadU16(psBuffer, &psRxMsg->uPayload.sGetRegionOfInterestResponsePayload.u16P1Y);
+        bOk &= ORLACO_bReadU16(psBuffer, &psRxMsg->uPayload.sGetRegionOfInterestResponsePayload.u16P2X);
+        bOk &= ORLACO_bReadU16(psBuffer, &psRxMsg->uPayload.sGetRegionOfInterestResponsePayload.u16P2Y);
+        bOk &= ORLACO_bReadU8(psBuffer, &psRxMsg->uPayload.sGetRegionOfInterestResponsePayload.u8Unknown1SetTo0x01);
+        bOk &= ORLACO_bReadU8(psBuffer, &psRxMsg->uPayload.sGetRegionOfInterestResponsePayload.u8Unknown2SetTo0x00);
+        bOk &= ORLACO_bReadU16(psBuffer, &psRxMsg->uPayload.sGetRegionOfInterestResponsePayload.u16Unknown3SetTo0x0000);
+        bOk &= ORLACO_bReadU16(psBuffer, &psRxMsg->uPayload.sGetRegionOfInterestResponsePayload.u16OutputWidth);
+        bOk &= ORLACO_bReadU16(psBuffer, &psRxMsg->uPayload.sGetRegionOfInterestResponsePayload.u16OutputHeight);
+        bOk &= ORLACO_bReadU8(psBuffer, &psRxMsg->uPayload.sGetRegionOfInterestResponsePayload.u8Unknown4SetTo0x00);
+        bOk &= ORLACO_bReadU8(psBuffer, &psRxMsg->uPayload.sGetRegionOfInterestResponsePayload.u8FrameRate);
+        bOk &= ORLACO_bReadU16(psBuffer, &psRxMsg->uPayload.sGetRegionOfInterestResponsePayload.u16Unknown4bSetTo0x0000);
+        bOk &= ORLACO_bReadU8(psBuffer, &psRxMsg->uPayload.sGetRegionOfInterestResponsePayload.u8Unknown5SetTo0x00);
+        bOk &= ORLACO_bReadU8(psBuffer, &psRxMsg->uPayload.sGetRegionOfInterestResponsePayload.u8Unknown6SetTo0x02);
+        bOk &= ORLACO_bReadU32(psBuffer, &psRxMsg->uPayload.sGetRegionOfInterestResponsePayload.u32MaxBitrate);
+        bOk &= ORLACO_bReadU8(psBuffer, &psRxMsg->uPayload.sGetRegionOfInterestResponsePayload.u8VideoCompressionMode);
+        bOk &= ORLACO_bReadU8(psBuffer, &psRxMsg->uPayload.sGetRegionOfInterestResponsePayload.u8Unknown7SetTo0x00);
+        bOk &= ORLACO_bReadU8(psBuffer, &psRxMsg->uPayload.sGetRegionOfInterestResponsePayload.u8Unknown8SetTo0x00);
+        bOk &= ORLACO_bReadU8(psBuffer, &psRxMsg->uPayload.sGetRegionOfInterestResponsePayload.u8Unknown9SetTo0x00);
+        bOk &= ORLACO_bReadU8(psBuffer, &psRxMsg->uPayload.sGetRegionOfInterestResponsePayload.u8Unknown10SetTo0x04);
+        bOk &= ORLACO_bReadU8(psBuffer, &psRxMsg->uPayload.sGetRegionOfInterestResponsePayload.u8Unknown11SetTo0x01);
+        bOk &= ORLACO_bReadU16(psBuffer, &psRxMsg->uPayload.sGetRegionOfInterestResponsePayload.u16Unknown12SetTo0x00ff);
+        break;
+
+    case E_ORLACO_METHOD_ID_GET_REGIONS_OF_INTEREST:
+        break;
+
+    case E_ORLACO_METHOD_ID_GET_VIDEO_FORMAT:
+        break;
+
+    case E_ORLACO_METHOD_ID_GET_HISTOGRAMM_FORMAT:
+        bOk &= ORLACO_bReadU32(psBuffer, &psRxMsg->uPayload.sHistogramFormatPayload.u32RegionOfInterest);
+        bOk &= ORLACO_bReadU16(psBuffer, &psRxMsg->uPayload.sHistogramFormatPayload.u16NumBins);
+        bOk &= ORLACO_bReadU8(psBuffer, &psRxMsg->uPayload.sHistogramFormatPayload.u8Channel);
+        bOk &= ORLACO_bReadU8(psBuffer, &psRxMsg->uPayload.sHistogramFormatPayload.u8Interval);
+        break;
+
+    case E_ORLACO_METHOD_ID_GET_CAM_CONTROL:
+        break;
+
+    case E_ORLACO_METHOD_ID_GET_CAM_CONTROLS:
+        break;
+
+    case E_ORLACO_METHOD_ID_GET_CAM_REGISTER:
+        break;
+
+    case E_ORLACO_METHOD_ID_GET_CAM_REGISTERS:
+        bOk &= ORLACO_bReadU16(psBuffer, &psRxMsg->uPayload.sGetRegistersResponsePayload.u16Qtty);
+        for(int n = 0; n < psRxMsg->uPayload.sGetRegistersResponsePayload.u16Qtty; n++)
+        {
+            bOk &= ORLACO_bReadU16(psBuffer, &psRxMsg->uPayload.sGetRegistersResponsePayload.asRegisterValues[n].u16Address);
+            bOk &= ORLACO_bReadU8(psBuffer, &psRxMsg->uPayload.sGetRegistersResponsePayload.asRegisterValues[n].u8Padding);
+            bOk &= ORLACO_bReadU8(psBuffer, &psRxMsg->uPayload.sGetRegistersResponsePayload.asRegisterValues[n].u8Value);
+        }
+        break;
+
+    case E_ORLACO_METHOD_ID_SERVICE_DISCOVERY:
+        bOk &= ORLACO_bReadU8(psBuffer, &psRxMsg->uPayload.sServiceDiscoveryPayload.u8Flags);
+        bOk &= ORLACO_bReadU24(psBuffer, &psRxMsg->uPayload.sServiceDiscoveryPayload.u24Reserved);
+        bOk &= ORLACO_bReadU32(psBuffer, &psRxMsg->uPayload.sServiceDiscoveryPayload.u32LengthOfEntriesArrayInBytes);
+        for(int n = 0; n < psRxMsg->uPayload.sServiceDiscoveryPayload.u32LengthOfEntriesArrayInBytes; n += ORLACO_SD_OPTION_LENGTH)
+        {
+            bOk &= ORLACO_bReadServiceDiscoveryServiceEntryFromBuffer(psBuffer, &psRxMsg->uPayload.sServiceDiscoveryPayload.asServiceEntry[n]);
+        }
+        break;
+
+    // Either the response doesn't contain any data or no idea what it is
+    default:
+        break;
+
+    }
+
+    ORLACO_vBufferDestroy(psBuffer);
+
+    return bOk;
+
+}
+
+
+/****************************************************************************
+ *
+ * NAME: ORLACO_bPipeline
+ *
+ * DESCRIPTION:
+ * Sends one request to each camera still marked as OK, as fast as the in
+ * flight windows of the camera and its subnet allow, and matches the
+ * responses to them by session ID. Requests a camera answers it isn't ready
+ * for are sent again a few times. Cameras that don't acknowledge their
+ * request are marked as failed.
+ *
+ * RETURNS:
+ * bool_t TRUE if every camera acknowledged, FALSE otherwise
+ *
+ ****************************************************************************/
+static bool_t ORLACO_bPipeline(ORLACO_tsInstance *psInstance, ORLACO_tsRegisterWrite *psWrites, uint32_t u32NumWrites, uint16_t u16MethodID)
+{
+    bool_t bOk = TRUE;
+    uint32_t u32Pending = 0;
+    uint32_t u32Round;
+    uint32_t n;
+
+    for(n = 0; n < u32NumWrites; n++)
+    {
+        psWrites[n].u16SessionID = 0;
+        psWrites[n].bLost = FALSE;
+
+        // The lease holds the lock, and is released separately
+        psWrites[n].bUnsent = psWrites[n].bOk &&
+                              !(psWrites[n].bLeased && ((u16MethodID == E_ORLACO_METHOD_ID_SET_CAM_EXCLUSIVE) || (u16MethodID == E_ORLACO_METHOD_ID_ERASE_CAM_EXCLUSIVE)));
+    }
+
+    // Cameras that answer they're not ready didn't run the request, so it's sent again
+    for(u32Round = 0; u32Round <= ORLACO_NOT_READY_RETRIES; u32Round++)
+    {
+        for(n = 0; n < u32NumWrites; n++)
+        {
+            if(!psWrites[n].bUnsent)
+            {
+                continue;
+            }
+            psWrites[n].bUnsent = FALSE;
+            psWrites[n].bOk = TRUE;
+
+            while(!ORLACO_bWindowsHaveRoom(psInstance, psWrites, u32NumWrites, psWrites[n].uIP))
+            {
+                u32Pending -= ORLACO_u32AwaitResponses(psInstance, psWrites, u32NumWrites, u16MethodID);
+            }
+
+            if(ORLACO_bSendPipelined(psInstance, &psWrites[n], u16MethodID))
+            {
+                u32Pending++;
+            }
+        }
+
+        // The responses can come back in any order
+        while(u32Pending > 0)
+        {
+            u32Pending -= ORLACO_u32AwaitResponses(psInstance, psWrites, u32NumWrites, u16MethodID);
+        }
+    }
+
+    for(n = 0; n < u32NumWrites; n++)
+    {
+        psWrites[n].bUnsent = FALSE;
+        bOk &= psWrites[n].bOk;
+    }
+
+    return bOk;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: ORLACO_bSendPipelined
+ *
+ * DESCRIPTION:
+ * Sends one camera its request of a pipelined step
+ *
+ * RETURNS:
+ * bool_t TRUE if the request was sent, FALSE otherwise
+ *
+ ****************************************************************************/
+static bool_t ORLACO_bSendPipelined(ORLACO_tsInstance *psInstance, ORLACO_tsRegisterWrite *psWrite, uint16_t u16MethodID)
+{
+    struct sockaddr_in sAddr = psInstance->fdUnicast;
+    ORLACO_tsBuffer *psBuffer;
+    ORLACO_tsMsg sMsg;
+    int i;
+
+    psBuffer = ORLACO_psBufferCreate(ORLACO_BUFFER_LENGTH);
+    if(psBuffer == NULL)
+    {
+        printf("Error: Buffer allocation failed in %s\n", __FUNCTION__);
+        psWrite->bOk = FALSE;
+        return FALSE;
+    }
+
+    // Construct the message header
+    sMsg.u16ServiceID = psInstance->u16ServiceID;
+    sMsg.u16MethodID = u16MethodID;
+    sMsg.u32Length = 8;
+    sMsg.u16ClientID = psInstance->u16ClientID;
+    sMsg.u16SessionID = ORLACO_u16GetSessionID(psInstance);
+    sMsg.u8SomeIPVersion = 1;
+    sMsg.u8InterfaceVersion = 1;
+    sMsg.u8MessageType = E_ORLACO_MESSAGE_TYPE_REQUEST;
+    sMsg.u8ReturnCode = E_ORLACO_RETURN_CODE_OK;
+
+    switch(u16MethodID)
+    {
+    case E_ORLACO_METHOD_ID_SET_CAM_EXCLUSIVE:
+        sMsg.u32Length += sizeof(sMsg.uPayload.sSetCamExclusivePayload);
+        psWrite->bOk &= ORLACO_bWriteMessageHeaderIntoBuffer(psBuffer, &sMsg);
+        psWrite->bOk &= ORLACO_bWriteU32(psBuffer, (ORLACO_psGetLease(psInstance, psWrite->uIP) != NULL) ? psInstance->u32LeaseTime : ORLACO_EXCLUSIVE_TIME);
+        break;
+
+    case E_ORLACO_METHOD_ID_SET_CAM_REGISTERS:
+        sMsg.u32Length += sizeof(uint16_t) + (psWrite->u16NumRegisters * 4);
+        psWrite->bOk &= ORLACO_bWriteMessageHeaderIntoBuffer(psBuffer, &sMsg);
+        psWrite->bOk &= ORLACO_bWriteU16(psBuffer, psWrite->u16NumRegisters);
+        for(i = 0; i < psWrite->u16NumRegisters; i++)
+        {
+            psWrite->bOk &= ORLACO_bWriteU16(psBuffer, psWrite->au16Addresses[i]);
+            psWrite->bOk &= ORLACO_bWriteU8(psBuffer, 0);
+            psWrite->bOk &= ORLACO_bWriteU8(psBuffer, psWrite->au8Values[i]);
+        }
+        break;
+
+    case E_ORLACO_METHOD_ID_SET_USED_REGISTER_SET:
+        sMsg.u32Length += sizeof(sMsg.uPayload.sSetUsedRegisterSetPayload);
+        psWrite->bOk &= ORLACO_bWriteMessageHeaderIntoBuffer(psBuffer, &sMsg);
+        psWrite->bOk &= ORLACO_bWriteU32(psBuffer, psWrite->u8RegisterSet);
+        break;
+
+    case E_ORLACO_METHOD_ID_GET_CAM_REGISTERS:
+        sMsg.u32Length += sizeof(uint16_t) + (psWrite->u16NumRegisters * sizeof(uint16_t));
+        psWrite->bOk &= ORLACO_bWriteMessageHeaderIntoBuffer(psBuffer, &sMsg);
+        psWrite->bOk &= ORLACO_bWriteU16(psBuffer, psWrite->u16NumRegisters);
+        for(i = 0; i < psWrite->u16NumRegisters; i++)
+        {
+            psWrite->bOk &= ORLACO_bWriteU16(psBuffer, psWrite->au16Addresses[i]);
+        }
+        break;
+
+    default:
+        psWrite->bOk &= ORLACO_bWriteMessageHeaderIntoBuffer(psBuffer, &sMsg);
+        break;
+    }
+
+    if(!psWrite->bOk)
+    {
+        ORLACO_vBufferDestroy(psBuffer);
+        return FALSE;
+    }
+
+    sAddr.sin_addr.s_addr = htonl(psWrite->uIP.u32IP);
+    if(!ORLACO_bSendDatagram(psInstance->Socket, &sAddr, psBuffer))
+    {
+        psWrite->bOk = FALSE;
+        return FALSE;
+    }
+
+    psWrite->u16SessionID = sMsg.u16SessionID;
+    psWrite->u64SentUs = RTP_u64GetTimeUs();
+
+    return TRUE;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: ORLACO_u32AwaitResponses
+ *
+ * DESCRIPTION:
+ * Waits for the response to one of the pipelined requests, but no longer
+ * than it takes the next of them to count as lost, and matches it by session
+ * ID. Lost requests no longer take up room in the windows, and are given up
+ * on once the response time has run out.
+ *
+ * RETURNS:
+ * uint32_t The number of requests answered or given up on
+ *
+ ****************************************************************************/
+static uint32_t ORLACO_u32AwaitResponses(ORLACO_tsInstance *psInstance, ORLACO_tsRegisterWrite *psWrites, uint32_t u32NumWrites, uint16_t u16MethodID)
+{
+    ORLACO_tsMsg sMsg;
+    bool_t bResponse;
+    uint64_t u64TimeUs = RTP_u64GetTimeUs();
+    uint64_t u64WaitUs = ORLACO_MAX_RESPONSE_TIME_MS * 1000ULL;
+    uint64_t u64DueUs;
+    uint32_t u32Finished = 0;
+    uint32_t n;
+
+    for(n = 0; n < u32NumWrites; n++)
+    {
+        if(psWrites[n].u16SessionID == 0)
+        {
+            continue;
+        }
+        u64DueUs = psWrites[n].u64SentUs + (psWrites[n].bLost ? ORLACO_MAX_RESPONSE_TIME_MS : ORLACO_u32GetLostMs(psInstance, psWrites[n].uIP)) * 1000ULL;
+        if(u64DueUs <= u64TimeUs)
+        {
+            u64WaitUs = 0;
+        }
+        else if(u64DueUs - u64TimeUs < u64WaitUs)
+        {
+            u64WaitUs = u64DueUs - u64TimeUs;
+        }
+    }
+
+    psInstance->u32ResponseTimeMs = (uint32_t)(u64WaitUs / 1000) + 1;
+    bResponse = ORLACO_bReceiveDatagram(psInstance, &sMsg, u16MethodID);
+    psInstance->u32ResponseTimeMs = ORLACO_MAX_RESPONSE_TIME_MS;
+    u64TimeUs = RTP_u64GetTimeUs();
+
+    for(n = 0; (n < u32NumWrites) && (sMsg.u16SessionID != 0); n++)
+    {
+        if((psWrites[n].u16SessionID == sMsg.u16SessionID) && (psWrites[n].uIP.u32IP == sMsg.uSrcAddr.u32IP))
+        {
+            psWrites[n].bOk = bResponse;
+            psWrites[n].u8ReturnCode = sMsg.u8ReturnCode;
+            psWrites[n].u16SessionID = 0;
+            u32Finished++;
+            if(bResponse && (u16MethodID == E_ORLACO_METHOD_ID_GET_CAM_REGISTERS))
+            {
+                psWrites[n].bOk = ORLACO_bCopyRegisterValues(&sMsg, &psWrites[n]);
+            }
+
+            // The camera's too busy to run the request, which is as good as dropping it
+            if(sMsg.u8ReturnCode == E_ORLACO_RETURN_CODE_NOT_READY)
+            {
+                ORLACO_vShrinkWindows(psInstance, &psWrites[n], u64TimeUs);
+                psWrites[n].bUnsent = TRUE;
+            }
+            else if(!psWrites[n].bLost)
+            {
+                ORLACO_vGrowWindows(psInstance, &psWrites[n], u64TimeUs);
+            }
+            break;
+        }
+    }
+
+    for(n = 0; n < u32NumWrites; n++)
+    {
+        if(psWrites[n].u16SessionID == 0)
+        {
+            continue;
+        }
+
+        if(u64TimeUs - psWrites[n].u64SentUs >= ORLACO_MAX_RESPONSE_TIME_MS * 1000ULL)
+        {
+            printf("Error: No response from %d.%d.%d.%d in %s\n", psWrites[n].uIP.au8IP[3], psWrites[n].uIP.au8IP[2], psWrites[n].uIP.au8IP[1], psWrites[n].uIP.au8IP[0], __FUNCTION__);
+            if(!psWrites[n].bLost)
+            {
+                ORLACO_vShrinkWindows(psInstance, &psWrites[n], u64TimeUs);
+            }
+            psWrites[n].bOk = FALSE;
+            psWrites[n].u8ReturnCode = E_ORLACO_RETURN_CODE_TIMEOUT;
+            psWrites[n].u16SessionID = 0;
+            u32Finished++;
+        }
+        else if(!psWrites[n].bLost && (u64TimeUs - psWrites[n].u64SentUs >= ORLACO_u32GetLostMs(psInstance, psWrites[n].uIP) * 1000ULL))
+        {
+            // A late response is still taken, but the request has stopped holding up the others
+            psWrites[n].bLost = TRUE;
+            ORLACO_vShrinkWindows(psInstance, &psWrites[n], u64TimeUs);
+        }
+    }
+
+    return u32Finished;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: ORLACO_bCopyRegisterValues
+ *
+ * DESCRIPTION:
+ * Copies the values in a Get Camera Registers response into the read they
+ * answer, by address, since the camera needn't return them in the order
+ * they were asked for
+ *
+ * RETURNS:
+ * bool_t TRUE if every register asked for was returned, FALSE otherwise
+ *
+ ****************************************************************************/
+static bool_t ORLACO_bCopyRegisterValues(ORLACO_tsMsg *psMsg, ORLACO_tsRegisterWrite *psRead)
+{
+    uint16_t u16Found = 0;
+    int i;
+    int x;
+
+    if(psMsg->uPayload.sGetRegistersResponsePayload.u16Qtty != psRead->u16NumRegisters)
+    {
+        return FALSE;
+    }
+
+    for(i = 0; i < psRead->u16NumRegisters; i++)
+    {
+        for(x = 0; x < psMsg->uPayload.sGetRegistersResponsePayload.u16Qtty; x++)
+        {
+            if(psMsg->uPayload.sGetRegistersResponsePayload.asRegisterValues[x].u16Address == psRead->au16Addresses[i])
+            {
+                psRead->au8Values[i] = psMsg->uPayload.sGetRegistersResponsePayload.asRegisterValues[x].u8Value;
+                u16Found++;
+                break;
+            }
+        }
+    }
+
+    return (u16Found == psRead->u16NumRegisters);
+}
+
+
+/****************************************************************************
+ *
+ * NAME: ORLACO_psGetWindow
+ *
+ * DESCRIPTION:
+ * Looks up the in flight window of a camera, or of the subnet it's on,
+ * starting it off if it hasn't been used before. A camera starts with room
+ * for one request, and a subnet for a few.
+ *
+ * RETURNS:
+ * ORLACO_tsWindow * The window, NULL if there's no room left to remember it
+ *
+ ****************************************************************************/
+static ORLACO_tsWindow *ORLACO_psGetWindow(ORLACO_tsInstance *psInstance, ORLACO_tuIP uIP, bool_t bSubnet)
+{
+    ORLACO_tsShadowTable *psTable = psInstance->psShadows;
+    ORLACO_tsShadow *psShadow;
+    ORLACO_tsWindow *psWindow = NULL;
+    uint32_t u32Address = uIP.u32IP & ORLACO_SUBNET_MASK;
+    uint32_t n;
+
+    if(!bSubnet)
+    {
+        psShadow = ORLACO_psGetShadow(psInstance, uIP, TRUE);
+        if(psShadow == NULL)
+        {
+            return NULL;
+        }
+        psWindow = &psShadow->sWindow;
+        if(psWindow->u32Window == 0)
+        {
+            psWindow->u32Window = ORLACO_WINDOW_SCALE;
+            psWindow->u32Threshold = ORLACO_CAMERA_WINDOW_MAX * ORLACO_WINDOW_SCALE;
+        }
+        return psWindow;
+    }
+
+    if(psTable == NULL)
+    {
+        return NULL;
+    }
+
+    for(n = 0; n < psTable->u32NumSubnets; n++)
+    {
+        if(psTable->asSubnets[n].u32Address == u32Address)
+        {
+            return &psTable->asSubnets[n].sWindow;
+        }
+    }
+
+    if(psTable->u32NumSubnets == ORLACO_MAX_SUBNETS)
+    {
+        return NULL;
+    }
+
+    memset(&psTable->asSubnets[psTable->u32NumSubnets], 0, sizeof(ORLACO_tsSubnet));
+    psTable->asSubnets[psTable->u32NumSubnets].u32Address = u32Address;
+    psWindow = &psTable->asSubnets[psTable->u32NumSubnets++].sWindow;
+    psWindow->u32Window = ORLACO_SUBNET_WINDOW_INITIAL * ORLACO_WINDOW_SCALE;
+    psWindow->u32Threshold = ORLACO_SUBNET_WINDOW_MAX * ORLACO_WINDOW_SCALE;
+
+    return psWindow;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: ORLACO_bWindowsHaveRoom
+ *
+ * DESCRIPTION:
+ * Checks whether another request can be sent to a camera, counting those
+ * of the pipeline still in flight to it and to the rest of its subnet.
+ * Windows that can't be remembered are held at their starting size.
+ *
+ * RETURNS:
+ * bool_t TRUE if both the camera's and the subnet's windows have room
+ *
+ ****************************************************************************/
+static bool_t ORLACO_bWindowsHaveRoom(ORLACO_tsInstance *psInstance, ORLACO_tsRegisterWrite *psWrites, uint32_t u32NumWrites, ORLACO_tuIP uIP)
+{
+    ORLACO_tsWindow *psCamera = ORLACO_psGetWindow(psInstance, uIP, FALSE);
+    ORLACO_tsWindow *psSubnet = ORLACO_psGetWindow(psInstance, uIP, TRUE);
+    uint32_t u32CameraWindow = (psCamera != NULL) ? psCamera->u32Window / ORLACO_WINDOW_SCALE : 1;
+    uint32_t u32SubnetWindow = (psSubnet != NULL) ? psSubnet->u32Window / ORLACO_WINDOW_SCALE : ORLACO_SUBNET_WINDOW_INITIAL;
+    uint32_t u32Camera = 0;
+    uint32_t u32Subnet = 0;
+    uint32_t n;
+
+    for(n = 0; n < u32NumWrites; n++)
+    {
+        if((psWrites[n].u16SessionID == 0) || psWrites[n].bLost)
+        {
+            continue;
+        }
+        if(psWrites[n].uIP.u32IP == uIP.u32IP)
+        {
+            u32Camera++;
+        }
+        if((psWrites[n].uIP.u32IP & ORLACO_SUBNET_MASK) == (uIP.u32IP & ORLACO_SUBNET_MASK))
+        {
+            u32Subnet++;
+        }
+    }
+
+    return ((u32Camera < u32CameraWindow) && (u32Subnet < u32SubnetWindow)) ? TRUE : FALSE;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: ORLACO_u32GetLostMs
+ *
+ * DESCRIPTION:
+ * Works out how long a request to a camera can go unanswered before it's
+ * counted as lost, from the smoothed time the camera takes to respond and
+ * how much that varies, as TCP works out its retransmission timeout
+ *
+ * RETURNS:
+ * uint32_t The time in ms
+ *
+ ****************************************************************************/
+static uint32_t ORLACO_u32GetLostMs(ORLACO_tsInstance *psInstance, ORLACO_tuIP uIP)
+{
+    ORLACO_tsShadow *psShadow = ORLACO_psGetShadow(psInstance, uIP, FALSE);
+    uint32_t u32LostMs;
+
+    if((psShadow == NULL) || (psShadow->u32RttUs == 0))
+    {
+        return ORLACO_LOST_INITIAL_MS;
+    }
+
+    u32LostMs = (psShadow->u32RttUs + (4 * psShadow->u32RttVarianceUs)) / 1000;
+    if(u32LostMs < ORLACO_LOST_MIN_MS)
+    {
+        u32LostMs = ORLACO_LOST_MIN_MS;
+    }
+    if(u32LostMs > ORLACO_MAX_RESPONSE_TIME_MS)
+    {
+        u32LostMs = ORLACO_MAX_RESPONSE_TIME_MS;
+    }
+
+    return u32LostMs;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: ORLACO_vGrowWindows
+ *
+ * DESCRIPTION:
+ * Times the camera's response to a request answered before it was lost,
+ * and grows the windows of the camera and its subnet
+ *
+ * RETURNS:
+ * void
+ *
+ ****************************************************************************/
+static void ORLACO_vGrowWindows(ORLACO_tsInstance *psInstance, ORLACO_tsRegisterWrite *psWrite, uint64_t u64TimeUs)
+{
+    ORLACO_tsShadow *psShadow = ORLACO_psGetShadow(psInstance, psWrite->uIP, FALSE);
+    uint32_t u32RttUs = (uint32_t)(u64TimeUs - psWrite->u64SentUs);
+    uint32_t u32ErrorUs;
+
+    if(psShadow != NULL)
+    {
+        if(psShadow->u32RttUs == 0)
+        {
+            psShadow->u32RttUs = u32RttUs;
+            psShadow->u32RttVarianceUs = u32RttUs / 2;
+        }
+        else
+        {
+            u32ErrorUs = (u32RttUs > psShadow->u32RttUs) ? u32RttUs - psShadow->u32RttUs : psShadow->u32RttUs - u32RttUs;
+            psShadow->u32RttVarianceUs = (3 * psShadow->u32RttVarianceUs + u32ErrorUs) / 4;
+            psShadow->u32RttUs = (7 * psShadow->u32RttUs + u32RttUs) / 8;
+        }
+    }
+
+    ORLACO_vGrowWindow(ORLACO_psGetWindow(psInstance, psWrite->uIP, FALSE), ORLACO_CAMERA_WINDOW_MAX);
+    ORLACO_vGrowWindow(ORLACO_psGetWindow(psInstance, psWrite->uIP, TRUE), ORLACO_SUBNET_WINDOW_MAX);
+}
+
+
+/****************************************************************************
+ *
+ * NAME: ORLACO_vShrinkWindows
+ *
+ * DESCRIPTION:
+ * Halves the windows of a camera and its subnet when a request to it was
+ * lost, or it answered that it wasn't ready
+ *
+ * RETURNS:
+ * void
+ *
+ ****************************************************************************/
+static void ORLACO_vShrinkWindows(ORLACO_tsInstance *psInstance, ORLACO_tsRegisterWrite *psWrite, uint64_t u64TimeUs)
+{
+    ORLACO_tsWindow *psCamera = ORLACO_psGetWindow(psInstance, psWrite->uIP, FALSE);
+    ORLACO_tsWindow *psSubnet = ORLACO_psGetWindow(psInstance, psWrite->uIP, TRUE);
+
+    ORLACO_vShrinkWindow(psCamera, psWrite->u64SentUs, u64TimeUs);
+    ORLACO_vShrinkWindow(psSubnet, psWrite->u64SentUs, u64TimeUs);
+
+    if((psInstance->eVerbosity >= E_ORLACO_VERBOSITY_DEBUG) && (psSubnet != NULL))
+    {
+        printf("%d.%d.%d.%d is congested, its subnet now has room for %u requests at once\n",
+               psWrite->uIP.au8IP[3], psWrite->uIP.au8IP[2], psWrite->uIP.au8IP[1], psWrite->uIP.au8IP[0], psSubnet->u32Window / ORLACO_WINDOW_SCALE);
+    }
+}
+
+
+/****************************************************************************
+ *
+ * NAME: ORLACO_vGrowWindow
+ *
+ * DESCRIPTION:
+ * Grows a window by a request for each response while it's below its
+ * threshold, so it soon finds its level, and by a request for each window
+ * full of responses above it
+ *
+ * RETURNS:
+ * void
+ *
+ ****************************************************************************/
+static void ORLACO_vGrowWindow(ORLACO_tsWindow *psWindow, uint32_t u32MaxWindow)
+{
+    if(psWindow == NULL)
+    {
+        return;
+    }
+
+    if(psWindow->u32Window < psWindow->u32Threshold)
+    {
+        psWindow->u32Window += ORLACO_WINDOW_SCALE;
+    }
+    else
+    {
+        psWindow->u32Window += (ORLACO_WINDOW_SCALE * ORLACO_WINDOW_SCALE) / psWindow->u32Window;
+    }
+
+    if(psWindow->u32Window > u32MaxWindow * ORLACO_WINDOW_SCALE)
+    {
+        psWindow->u32Window = u32MaxWindow * ORLACO_WINDOW_SCALE;
+    }
+}
+
+
+/****************************************************************************
+ *
+ * NAME: ORLACO_vShrinkWindow
+ *
+ * DESCRIPTION:
+ * Halves a window, no smaller than one request, and stops growing it
+ * quickly. Requests sent before it was last halved went out into the same
+ * congestion, so they don't halve it again.
+ *
+ * RETURNS:
+ * void
+ *
+ ****************************************************************************/
+static void ORLACO_vShrinkWindow(ORLACO_tsWindow *psWindow, uint64_t u64SentUs, uint64_t u64TimeUs)
+{
+    if((psWindow == NULL) || (u64SentUs < psWindow->u64ShrunkUs))
+    {
+        return;
+    }
+
+    psWindow->u32Window = (psWindow->u32Window / 2 > ORLACO_WINDOW_SCALE) ? psWindow->u32Window / 2 : ORLACO_WINDOW_SCALE;
+    psWindow->u32Threshold = psWindow->u32Window;
+    psWindow->u64ShrunkUs = u64TimeUs;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: ORLACO_vRunLocked
+ *
+ * DESCRIPTION:
+ * Takes the lock on several cameras at once and runs the steps on those that
+ * were free. Cameras locked by another client are then retried together,
+ * backing off exponentially with jitter, until they're free or the lock
+ * wait runs out, so one busy camera doesn't hold up or fail the rest.
+ *
+ * RETURNS:
+ * void
+ *
+ ****************************************************************************/
+static void ORLACO_vRunLocked(ORLACO_tsInstance *psInstance, ORLACO_tsRegisterWrite *psWrites, uint32_t u32NumWrites, ORLACO_tpfvSteps pfvSteps, void *pvContext)
+{
+    ORLACO_tsRegisterWrite *psRetries;
+    uint32_t *pu32Indices;
+    uint32_t u32NumRetries;
+    ORLACO_tsBackoff sBackoff;
+    uint32_t n;
+
+    for(n = 0; n < u32NumWrites; n++)
+    {
+        psWrites[n].u8ReturnCode = E_ORLACO_RETURN_CODE_OK;
+    }
+
+    ORLACO_vMarkLeased(psInstance, psWrites, u32NumWrites);
+    ORLACO_bPipeline(psInstance, psWrites, u32NumWrites, E_ORLACO_METHOD_ID_SET_CAM_EXCLUSIVE);
+    pfvSteps(psInstance, psWrites, u32NumWrites, pvContext);
+
+    u32NumRetries = ORLACO_u32CountLocked(psWrites, u32NumWrites);
+    if((u32NumRetries == 0) || (psInstance->u32LockWaitMs == 0))
+    {
+        return;
+    }
 
-    // Method ID
-    bOk &= ORLACO_bWriteU16(psBuffer, psMsg->u16MethodID);
+    psRetries = malloc(u32NumRetries * sizeof(ORLACO_tsRegisterWrite));
+    pu32Indices = malloc(u32NumRetries * sizeof(uint32_t));
+    if((psRetries == NULL) || (pu32Indices == NULL))
+    {
+        printf("Error: Memory allocation failed in %s\n", __FUNCTION__);
+        free(psRetries);
+        free(pu32Indices);
+        return;
+    }
 
-    // Length
-    bOk &= ORLACO_bWriteU32(psBuffer, psMsg->u32Length);
+    ORLACO_vStartBackoff(psInstance, &sBackoff);
+    while((u32NumRetries > 0) && ORLACO_bBackoff(psInstance, &sBackoff))
+    {
+        u32NumRetries = 0;
+        for(n = 0; n < u32NumWrites; n++)
+        {
+            if(psWrites[n].u8ReturnCode == E_ORLACO_RETURN_CODE_LOCKED_BY_FOREIGN_INSTANCE)
+            {
+                psRetries[u32NumRetries] = psWrites[n];
+                psRetries[u32NumRetries].bOk = TRUE;
+                psRetries[u32NumRetries].u8ReturnCode = E_ORLACO_RETURN_CODE_OK;
+                pu32Indices[u32NumRetries] = n;
+                u32NumRetries++;
+            }
+        }
 
-    // Client ID
-    bOk &= ORLACO_bWriteU16(psBuffer, psMsg->u16ClientID);
+        if(psInstance->eVerbosity >= E_ORLACO_VERBOSITY_DEBUG) printf("%s: Retrying %u locked camera%s\n", __FUNCTION__, u32NumRetries, (u32NumRetries == 1) ? "" : "s");
 
-    // Session ID
-    bOk &= ORLACO_bWriteU16(psBuffer, psMsg->u16SessionID);
+        ORLACO_vMarkLeased(psInstance, psRetries, u32NumRetries);
+        ORLACO_bPipeline(psInstance, psRetries, u32NumRetries, E_ORLACO_METHOD_ID_SET_CAM_EXCLUSIVE);
+        pfvSteps(psInstance, psRetries, u32NumRetries, pvContext);
 
-    // SOME/IP Version
-    bOk &= ORLACO_bWriteU8(psBuffer, psMsg->u8SomeIPVersion);
+        for(n = 0; n < u32NumRetries; n++)
+        {
+            psWrites[pu32Indices[n]] = psRetries[n];
+        }
+        u32NumRetries = ORLACO_u32CountLocked(psWrites, u32NumWrites);
+    }
 
-    // Interface Version
-    bOk &= ORLACO_bWriteU8(psBuffer, psMsg->u8InterfaceVersion);
+    for(n = 0; n < u32NumWrites; n++)
+    {
+        if(psWrites[n].u8ReturnCode == E_ORLACO_RETURN_CODE_LOCKED_BY_FOREIGN_INSTANCE)
+        {
+            printf("Warning: Camera %d.%d.%d.%d was still locked by another client after %u ms\n", psWrites[n].uIP.au8IP[3], psWrites[n].uIP.au8IP[2], psWrites[n].uIP.au8IP[1], psWrites[n].uIP.au8IP[0], psInstance->u32LockWaitMs);
+        }
+    }
 
-    // Message type
-    bOk &= ORLACO_bWriteU8(psBuffer, psMsg->u8MessageType);
+    free(psRetries);
+    free(pu32Indices);
+}
 
-    // Return code
-    bOk &= ORLACO_bWriteU8(psBuffer, psMsg->u8ReturnCode);
-  
-    return bOk;
 
+/****************************************************************************
+ *
+ * NAME: ORLACO_u32CountLocked
+ *
+ * DESCRIPTION:
+ * Counts the writes to cameras that were locked by another client
+ *
+ * RETURNS:
+ * uint32_t The number of them
+ *
+ ****************************************************************************/
+static uint32_t ORLACO_u32CountLocked(ORLACO_tsRegisterWrite *psWrites, uint32_t u32NumWrites)
+{
+    uint32_t u32NumLocked = 0;
+    uint32_t n;
+
+    for(n = 0; n < u32NumWrites; n++)
+    {
+        if(psWrites[n].u8ReturnCode == E_ORLACO_RETURN_CODE_LOCKED_BY_FOREIGN_INSTANCE)
+        {
+            u32NumLocked++;
+        }
+    }
+
+    return u32NumLocked;
 }
 
 
 /****************************************************************************
  *
- * NAME: ORLACO_vPrintBuffer
+ * NAME: ORLACO_vStepsWrite
  *
  * DESCRIPTION:
- * Prints the contents of a buffer to the console
+ * Sends one request, given by its method ID, to every camera that was locked
+ * and then releases them, including those whose request failed
  *
  * RETURNS:
  * void
  *
  ****************************************************************************/
-static void ORLACO_vPrintBuffer(ORLACO_tsBuffer *psBuffer)
+static void ORLACO_vStepsWrite(ORLACO_tsInstance *psInstance, ORLACO_tsRegisterWrite *psWrites, uint32_t u32NumWrites, void *pvContext)
 {
-    for(int n = 0; n < psBuffer->u32Offset; n++)
+    bool_t *pbLocked;
+    bool_t *pbWritten;
+    uint32_t n;
+
+    if(u32NumWrites == 0)
     {
-        printf(" %02x", psBuffer->pu8Data[n]);
+        return;
+    }
+
+    pbLocked = malloc(2 * u32NumWrites * sizeof(bool_t));
+    if(pbLocked == NULL)
+    {
+        printf("Error: Memory allocation failed in %s\n", __FUNCTION__);
+        ORLACO_bPipeline(psInstance, psWrites, u32NumWrites, E_ORLACO_METHOD_ID_ERASE_CAM_EXCLUSIVE);
+        for(n = 0; n < u32NumWrites; n++)
+        {
+            psWrites[n].bOk = FALSE;
+        }
+        return;
+    }
+    pbWritten = &pbLocked[u32NumWrites];
+
+    for(n = 0; n < u32NumWrites; n++)
+    {
+        pbLocked[n] = psWrites[n].bOk;
+    }
+    ORLACO_bPipeline(psInstance, psWrites, u32NumWrites, *(uint16_t *)pvContext);
+
+    // Every camera that was locked has to be released, whether the write worked or not
+    for(n = 0; n < u32NumWrites; n++)
+    {
+        pbWritten[n] = psWrites[n].bOk;
+        psWrites[n].bOk = pbLocked[n];
+    }
+    ORLACO_bPipeline(psInstance, psWrites, u32NumWrites, E_ORLACO_METHOD_ID_ERASE_CAM_EXCLUSIVE);
+
+    for(n = 0; n < u32NumWrites; n++)
+    {
+        psWrites[n].bOk &= pbWritten[n];
     }
+
+    free(pbLocked);
 }
 
 
 /****************************************************************************
  *
- * NAME: ORLACO_bReadMessageHeaderFromBuffer
+ * NAME: ORLACO_vStepsStage
  *
  * DESCRIPTION:
- * Reads a message header from a buffer
+ * Switches every camera that was locked over to the staged register set,
+ * writes it, switches back to the active set, which is done even if the
+ * write failed, and releases them
  *
  * RETURNS:
- * bool_t - TRUE if successful, FALSE otherwise
+ * void
  *
  ****************************************************************************/
-static bool_t ORLACO_bReadMessageHeaderFromBuffer(ORLACO_tsBuffer *psBuffer, ORLACO_tsMsg *psMsg)
+static void ORLACO_vStepsStage(ORLACO_tsInstance *psInstance, ORLACO_tsRegisterWrite *psWrites, uint32_t u32NumWrites, void *pvContext)
 {
+    ORLACO_tsStageContext *psContext = (ORLACO_tsStageContext *)pvContext;
+    bool_t *pbWritten;
+    uint32_t n;
 
-    bool_t bOk = TRUE;
+    if(u32NumWrites == 0)
+    {
+        return;
+    }
 
-    // Service ID
-    bOk &= ORLACO_bReadU16(psBuffer, &psMsg->u16ServiceID);
+    pbWritten = malloc(u32NumWrites * sizeof(bool_t));
+    if(pbWritten == NULL)
+    {
+        printf("Error: Memory allocation failed in %s\n", __FUNCTION__);
+        for(n = 0; n < u32NumWrites; n++)
+        {
+            psWrites[n].bOk = FALSE;
+        }
+        return;
+    }
 
-    // Method ID
-    bOk &= ORLACO_bReadU16(psBuffer, &psMsg->u16MethodID);
+    for(n = 0; n < u32NumWrites; n++)
+    {
+        psWrites[n].u8RegisterSet = psContext->u8RegisterSet;
+    }
+    ORLACO_bPipeline(psInstance, psWrites, u32NumWrites, E_ORLACO_METHOD_ID_SET_USED_REGISTER_SET);
 
-    // Length
-    bOk &= ORLACO_bReadU32(psBuffer, &psMsg->u32Length);
+    // Every camera that switched over has to be switched back, whether the write worked or not
+    for(n = 0; n < u32NumWrites; n++)
+    {
+        psWrites[n].u8RegisterSet = psWrites[n].bOk ? psContext->u8ActiveSet : psContext->u8RegisterSet;
+    }
+    ORLACO_bPipeline(psInstance, psWrites, u32NumWrites, E_ORLACO_METHOD_ID_SET_CAM_REGISTERS);
+    for(n = 0; n < u32NumWrites; n++)
+    {
+        pbWritten[n] = psWrites[n].bOk;
+        psWrites[n].bOk = (psWrites[n].u8RegisterSet == psContext->u8ActiveSet);
+    }
+    ORLACO_bPipeline(psInstance, psWrites, u32NumWrites, E_ORLACO_METHOD_ID_SET_USED_REGISTER_SET);
+    for(n = 0; n < u32NumWrites; n++)
+    {
+        if(psWrites[n].u8RegisterSet == psContext->u8ActiveSet)
+        {
+            if(!psWrites[n].bOk)
+            {
+                printf("Warning: Camera %d.%d.%d.%d may have been left using register set %d\n", psWrites[n].uIP.au8IP[3], psWrites[n].uIP.au8IP[2], psWrites[n].uIP.au8IP[1], psWrites[n].uIP.au8IP[0], psContext->u8RegisterSet);
+            }
+            // Release the lock even if the camera couldn't be switched back
+            psWrites[n].bOk = TRUE;
+        }
+    }
+    ORLACO_bPipeline(psInstance, psWrites, u32NumWrites, E_ORLACO_METHOD_ID_ERASE_CAM_EXCLUSIVE);
 
-    // There should be at least 8 bytes in the rest of the header, exit if not
-    if(psMsg->u32Length < 8)
+    for(n = 0; n < u32NumWrites; n++)
+    {
+        psWrites[n].bOk &= pbWritten[n];
+    }
+
+    free(pbWritten);
+}
+
+
+/****************************************************************************
+ *
+ * NAME: ORLACO_vStartBackoff
+ *
+ * DESCRIPTION:
+ * Starts backing off from a lock held by another client, for up to the
+ * lock wait from now
+ *
+ * RETURNS:
+ * void
+ *
+ ****************************************************************************/
+static void ORLACO_vStartBackoff(ORLACO_tsInstance *psInstance, ORLACO_tsBackoff *psBackoff)
+{
+    psBackoff->u64DeadlineUs = RTP_u64GetTimeUs() + ((uint64_t)psInstance->u32LockWaitMs * 1000ULL);
+    psBackoff->u32DelayMs = ORLACO_BACKOFF_MIN_MS;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: ORLACO_u32GetBackoffMs
+ *
+ * DESCRIPTION:
+ * Picks how long to wait before the next attempt, somewhere between half and
+ * all of the current delay so that clients contending for a camera spread
+ * out, and doubles the delay for the attempt after, up to a limit
+ *
+ * RETURNS:
+ * uint32_t The wait in milliseconds, 0 once the deadline has passed
+ *
+ ****************************************************************************/
+static uint32_t ORLACO_u32GetBackoffMs(ORLACO_tsInstance *psInstance, ORLACO_tsBackoff *psBackoff)
+{
+    uint64_t u64TimeUs = RTP_u64GetTimeUs();
+    uint64_t u64LeftMs;
+    uint32_t u32WaitMs;
+
+    if(u64TimeUs >= psBackoff->u64DeadlineUs)
+    {
+        return 0;
+    }
+    u64LeftMs = (psBackoff->u64DeadlineUs - u64TimeUs + 999) / 1000;
+
+    // Xorshift, seeded per instance, so that separate processes don't keep colliding
+    psInstance->u32Random ^= psInstance->u32Random << 13;
+    psInstance->u32Random ^= psInstance->u32Random >> 17;
+    psInstance->u32Random ^= psInstance->u32Random << 5;
+
+    u32WaitMs = (psBackoff->u32DelayMs / 2) + (psInstance->u32Random % ((psBackoff->u32DelayMs / 2) + 1));
+    if(u32WaitMs > u64LeftMs)
+    {
+        u32WaitMs = (uint32_t)u64LeftMs;
+    }
+
+    psBackoff->u32DelayMs = (psBackoff->u32DelayMs * 2 < ORLACO_BACKOFF_MAX_MS) ? psBackoff->u32DelayMs * 2 : ORLACO_BACKOFF_MAX_MS;
+
+    return u32WaitMs;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: ORLACO_bBackoff
+ *
+ * DESCRIPTION:
+ * Waits before the next attempt at a lock held by another client
+ *
+ * RETURNS:
+ * bool_t TRUE if there's time for another attempt, FALSE otherwise
+ *
+ ****************************************************************************/
+static bool_t ORLACO_bBackoff(ORLACO_tsInstance *psInstance, ORLACO_tsBackoff *psBackoff)
+{
+    uint32_t u32WaitMs = ORLACO_u32GetBackoffMs(psInstance, psBackoff);
+
+    if(u32WaitMs == 0)
     {
-        printf("Not enough length (%d)!\n", psMsg->u32Length);
         return FALSE;
     }
 
-    // Client ID
-    bOk &= ORLACO_bReadU16(psBuffer, &psMsg->u16ClientID);
+#ifdef _WIN32
+    Sleep(u32WaitMs);
+#else
+    usleep(u32WaitMs * 1000);
+#endif
 
-    // Session ID
-    bOk &= ORLACO_bReadU16(psBuffer, &psMsg->u16SessionID);
+    return TRUE;
+}
 
-    // SOME/IP Version
-    bOk &= ORLACO_bReadU8(psBuffer, &psMsg->u8SomeIPVersion);
 
-    // Interface Version
-    bOk &= ORLACO_bReadU8(psBuffer, &psMsg->u8InterfaceVersion);
+/****************************************************************************
+ *
+ * NAME: ORLACO_psGetLease
+ *
+ * DESCRIPTION:
+ * Finds the lease on a camera
+ *
+ * RETURNS:
+ * ORLACO_tsLease * - The lease, NULL if the camera isn't leased
+ *
+ ****************************************************************************/
+static ORLACO_tsLease *ORLACO_psGetLease(ORLACO_tsInstance *psInstance, ORLACO_tuIP uIP)
+{
+    uint32_t n;
+
+    for(n = 0; n < psInstance->u32NumLeases; n++)
+    {
+        if(psInstance->asLeases[n].uIP.u32IP == uIP.u32IP)
+        {
+            return &psInstance->asLeases[n];
+        }
+    }
+
+    return NULL;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: ORLACO_bRenewLeases
+ *
+ * DESCRIPTION:
+ * Sends "Set Camera Exclusive" to every leased camera that's due, or to all
+ * of them if forced, before waiting for any of the responses. A camera
+ * locked by another client is retried on later calls, backing off, until
+ * the lock wait runs out. A lease that can't be renewed is dropped, so its
+ * camera goes back to being locked and released around each operation. A
+ * camera that has restarted since its lock was taken has lost it, so it's
+ * taken again straight away rather than when it's next due.
+ *
+ * RETURNS:
+ * bool_t TRUE if every lease due was renewed or is being retried, FALSE
+ * otherwise
+ *
+ ****************************************************************************/
+static bool_t ORLACO_bRenewLeases(ORLACO_tsInstance *psInstance, bool_t bForce)
+{
+    ORLACO_tsRegisterWrite asWrites[ORLACO_MAX_LEASES];
+    ORLACO_tsLease *psLease;
+    uint32_t au32Leases[ORLACO_MAX_LEASES];
+    uint32_t u32NumWrites = 0;
+    uint32_t u32WaitMs;
+    uint64_t u64TimeUs;
+    bool_t bOk = TRUE;
+    uint32_t n;
+
+    // Notice any restarts announced since the last time
+    ORLACO_vPollServiceDiscovery(psInstance);
+
+    u64TimeUs = RTP_u64GetTimeUs();
+    for(n = 0; n < psInstance->u32NumLeases; n++)
+    {
+        psLease = &psInstance->asLeases[n];
+        if(psLease->bHeld && (psLease->u32Restarts != ORLACO_u32GetRestarts(psInstance, psLease->uIP)))
+        {
+            printf("Warning: %d.%d.%d.%d has restarted, taking its lock again\n", psLease->uIP.au8IP[3], psLease->uIP.au8IP[2], psLease->uIP.au8IP[1], psLease->uIP.au8IP[0]);
+            psLease->u64RenewUs = u64TimeUs;
+        }
+        if(bForce || (psLease->bHeld && (u64TimeUs >= psLease->u64RenewUs)) || (psLease->bPending && (u64TimeUs >= psLease->u64RetryUs)))
+        {
+            memset(&asWrites[u32NumWrites], 0, sizeof(ORLACO_tsRegisterWrite));
+            asWrites[u32NumWrites].uIP = psLease->uIP;
+            asWrites[u32NumWrites].bOk = TRUE;
+            au32Leases[u32NumWrites] = n;
+            u32NumWrites++;
+        }
+    }
+
+    if(u32NumWrites == 0)
+    {
+        return TRUE;
+    }
+
+    if(psInstance->eVerbosity >= E_ORLACO_VERBOSITY_DEBUG) printf("%s(%u)\n", __FUNCTION__, u32NumWrites);
+
+    ORLACO_bPipeline(psInstance, asWrites, u32NumWrites, E_ORLACO_METHOD_ID_SET_CAM_EXCLUSIVE);
+
+    for(n = 0; n < u32NumWrites; n++)
+    {
+        psLease = &psInstance->asLeases[au32Leases[n]];
+        if(!asWrites[n].bOk)
+        {
+            // Another client has the camera, so keep trying in the background while the others go ahead
+            if((asWrites[n].u8ReturnCode == E_ORLACO_RETURN_CODE_LOCKED_BY_FOREIGN_INSTANCE) && (psInstance->u32LockWaitMs != 0))
+            {
+                if(!psLease->bPending)
+                {
+                    ORLACO_vStartBackoff(psInstance, &psLease->sBackoff);
+                    psLease->bPending = TRUE;
+                }
+                u32WaitMs = ORLACO_u32GetBackoffMs(psInstance, &psLease->sBackoff);
+                if(u32WaitMs != 0)
+                {
+                    psLease->bHeld = FALSE;
+                    psLease->u64RetryUs = RTP_u64GetTimeUs() + ((uint64_t)u32WaitMs * 1000ULL);
+                    continue;
+                }
+                printf("Warning: %d.%d.%d.%d was still locked by another client after %u ms\n", psLease->uIP.au8IP[3], psLease->uIP.au8IP[2], psLease->uIP.au8IP[1], psLease->uIP.au8IP[0], psInstance->u32LockWaitMs);
+            }
+            else if(psLease->bHeld || psLease->bPending || bForce)
+            {
+                printf("Warning: Couldn't %s the lock on %d.%d.%d.%d\n", psLease->bHeld ? "renew" : "lease", psLease->uIP.au8IP[3], psLease->uIP.au8IP[2], psLease->uIP.au8IP[1], psLease->uIP.au8IP[0]);
+            }
+            psLease->bHeld = FALSE;
+            psLease->bPending = FALSE;
+            bOk = FALSE;
+            continue;
+        }
+        psLease->bHeld = TRUE;
+        psLease->bPending = FALSE;
+        psLease->u32Restarts = ORLACO_u32GetRestarts(psInstance, psLease->uIP);
+        psLease->u64RenewUs = u64TimeUs + ((uint64_t)psInstance->u32LeaseTime * 1000000ULL * ORLACO_LEASE_RENEW_PERCENT / 100);
+    }
+
+    return bOk;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: ORLACO_vMarkLeased
+ *
+ * DESCRIPTION:
+ * Renews any leases that are due, then marks the writes to cameras with a
+ * lease held so that they aren't locked and released around the write
+ *
+ * RETURNS:
+ * void
+ *
+ ****************************************************************************/
+static void ORLACO_vMarkLeased(ORLACO_tsInstance *psInstance, ORLACO_tsRegisterWrite *psWrites, uint32_t u32NumWrites)
+{
+    uint32_t n;
+
+    ORLACO_bServiceLeases(psInstance);
+
+    for(n = 0; n < u32NumWrites; n++)
+    {
+        psWrites[n].bLeased = ORLACO_bIsLeased(psInstance, psWrites[n].uIP);
+    }
+}
+
+
+/****************************************************************************
+ *
+ * NAME: ORLACO_psGetShadow
+ *
+ * DESCRIPTION:
+ * Finds the shadow of the camera's registers, making one if bCreate is set
+ * and there's room
+ *
+ * RETURNS:
+ * ORLACO_tsShadow * The shadow, NULL if there's none
+ *
+ ****************************************************************************/
+static ORLACO_tsShadow *ORLACO_psGetShadow(ORLACO_tsInstance *psInstance, ORLACO_tuIP uIP, bool_t bCreate)
+{
+    ORLACO_tsShadowTable *psTable = psInstance->psShadows;
+    ORLACO_tsShadow *psShadow;
+    uint32_t n;
+
+    if(psTable == NULL)
+    {
+        return NULL;
+    }
+
+    for(n = 0; n < psTable->u32NumShadows; n++)
+    {
+        if(psTable->asShadows[n].uIP.u32IP == uIP.u32IP)
+        {
+            return &psTable->asShadows[n];
+        }
+    }
 
-    // Message type
-    bOk &= ORLACO_bReadU8(psBuffer, &psMsg->u8MessageType);
+    if(!bCreate || (psTable->u32NumShadows == ORLACO_MAX_SHADOWS))
+    {
+        return NULL;
+    }
 
-    // Return code
-    bOk &= ORLACO_bReadU8(psBuffer, &psMsg->u8ReturnCode);
-  
-    return bOk;
+    psShadow = &psTable->asShadows[psTable->u32NumShadows++];
+    memset(psShadow, 0, sizeof(ORLACO_tsShadow));
+    psShadow->uIP = uIP;
 
+    return psShadow;
 }
 
 
 /****************************************************************************
  *
- * NAME: ORLACO_bWriteServiceDiscoveryServiceEntryIntoBuffer
+ * NAME: ORLACO_psGetFresh
  *
  * DESCRIPTION:
- * Writes a service discovery service entry into a buffer
+ * Looks up the value of the register at iIndex in the shadow, if it was read
+ * or written within the freshness bound
  *
  * RETURNS:
- * bool_t - TRUE if successful, FALSE otherwise
+ * ORLACO_tsShadowRegister * The register's shadow, NULL if it isn't fresh
  *
  ****************************************************************************/
-static bool_t ORLACO_bWriteServiceDiscoveryServiceEntryIntoBuffer(ORLACO_tsBuffer *psBuffer, ORLACO_tsServiceDiscoveryServiceEntry *psServiceEntry)
+static ORLACO_tsShadowRegister *ORLACO_psGetFresh(ORLACO_tsInstance *psInstance, ORLACO_tsShadow *psShadow, int iIndex, uint64_t u64TimeUs)
 {
+    ORLACO_tsShadowRegister *psRegister;
 
-    bool_t bOk = TRUE;
+    if((psShadow == NULL) || (psInstance->u32FreshnessMs == 0) || (iIndex < 0) || (iIndex >= ORLACO_MAX_SHADOW_REGISTERS))
+    {
+        return NULL;
+    }
 
-    bOk &= ORLACO_bWriteU8(psBuffer, psServiceEntry->u8Type);
-    bOk &= ORLACO_bWriteU8(psBuffer, psServiceEntry->u8Index1stOptions);
-    bOk &= ORLACO_bWriteU8(psBuffer, psServiceEntry->u8Index2ndOptions);
-    bOk &= ORLACO_bWriteU8(psBuffer, psServiceEntry->u8NumberOfOptions);
-    bOk &= ORLACO_bWriteU16(psBuffer, psServiceEntry->u16ServiceID);
-    bOk &= ORLACO_bWriteU16(psBuffer, psServiceEntry->u16InstanceID);
-    bOk &= ORLACO_bWriteU8(psBuffer, psServiceEntry->u8MajorVersion);
-    bOk &= ORLACO_bWriteU24(psBuffer, psServiceEntry->u24TTL);
-    bOk &= ORLACO_bWriteU32(psBuffer, psServiceEntry->u32MinorVersion);
+    psRegister = &psShadow->asRegisters[iIndex];
+    if((psRegister->u64UpdatedUs == 0) || (u64TimeUs - psRegister->u64UpdatedUs > psInstance->u32FreshnessMs * 1000ULL))
+    {
+        return NULL;
+    }
 
-    return bOk;
+    return psRegister;
 }
 
 
 /****************************************************************************
  *
- * NAME: ORLACO_bReadServiceDiscoveryServiceEntryFromBuffer
+ * NAME: ORLACO_vUpdateShadow
  *
  * DESCRIPTION:
- * Reads a service discovery service entry from a buffer
+ * Records that the camera's register holds u8Value as of u64TimeUs, or with
+ * a time of 0 that its value isn't known
  *
  * RETURNS:
- * bool_t - TRUE if successful, FALSE otherwise
+ * void
  *
  ****************************************************************************/
-static bool_t ORLACO_bReadServiceDiscoveryServiceEntryFromBuffer(ORLACO_tsBuffer *psBuffer, ORLACO_tsServiceDiscoveryServiceEntry *psServiceEntry)
+static void ORLACO_vUpdateShadow(ORLACO_tsInstance *psInstance, ORLACO_tuIP uIP, uint16_t u16Address, uint8_t u8Value, uint64_t u64TimeUs)
 {
+    ORLACO_tsRegisterValue *psRegister = ORLACO_psGetRegister(psInstance, u16Address);
+    ORLACO_tsShadow *psShadow;
+    int iIndex;
 
-    bool_t bOk = TRUE;
+    if(psRegister == NULL)
+    {
+        return;
+    }
 
-    bOk &= ORLACO_bReadU8(psBuffer, &psServiceEntry->u8Type);
-    bOk &= ORLACO_bReadU8(psBuffer, &psServiceEntry->u8Index1stOptions);
-    bOk &= ORLACO_bReadU8(psBuffer, &psServiceEntry->u8Index2ndOptions);
-    bOk &= ORLACO_bReadU8(psBuffer, &psServiceEntry->u8NumberOfOptions);
-    bOk &= ORLACO_bReadU16(psBuffer, &psServiceEntry->u16ServiceID);
-    bOk &= ORLACO_bReadU16(psBuffer, &psServiceEntry->u16InstanceID);
-    bOk &= ORLACO_bReadU8(psBuffer, &psServiceEntry->u8MajorVersion);
-    bOk &= ORLACO_bReadU24(psBuffer, &psServiceEntry->u24TTL);
-    bOk &= ORLACO_bReadU32(psBuffer, &psServiceEntry->u32MinorVersion);
+    if((u64TimeUs != 0) && (psInstance->pfvObserver != NULL))
+    {
+        psInstance->pfvObserver(psInstance->pvObserverContext, uIP, u16Address, u8Value);
+    }
 
-    return bOk;
+    iIndex = psRegister - psInstance->psRegisters;
+    psShadow = ORLACO_psGetShadow(psInstance, uIP, (u64TimeUs != 0));
+    if((psShadow == NULL) || (iIndex >= ORLACO_MAX_SHADOW_REGISTERS))
+    {
+        return;
+    }
+
+    psShadow->asRegisters[iIndex].u8Value = u8Value;
+    psShadow->asRegisters[iIndex].u64UpdatedUs = u64TimeUs;
 }
 
 
 /****************************************************************************
  *
- * NAME: ORLACO_bSendDatagram
+ * NAME: ORLACO_vObserveRegionOfInterest
  *
  * DESCRIPTION:
- * Sends the contents of the specified buffer as a UDP datagram to the specified IP address
+ * Tells the observer, if there is one, each field of an ROI read from or
+ * written to the unicast camera
  *
  * RETURNS:
- * bool_t - TRUE if successful, FALSE otherwise
+ * void
  *
  ****************************************************************************/
-static bool_t ORLACO_bSendDatagram(UDPSOCKET sktTx, struct sockaddr_in *psDstAddr, ORLACO_tsBuffer *psBuffer)
+static void ORLACO_vObserveRegionOfInterest(ORLACO_tsInstance *psInstance, uint32_t u32RegionOfInterest, ORLACO_tsRegionOfInterest *psRegionOfInterest)
 {
-    bool_t bOk = TRUE;
-    int iLen;
-    // printf("Tx: ");
-    // ORLACO_vPrintBuffer(psBuffer);
-    // printf("\n");
+    uint32_t au32Values[E_ORLACO_ROI_NUM_FIELDS];
+    ORLACO_tuIP uIP;
+    int n;
 
-    iLen = sendto(sktTx, (const char *)psBuffer->pu8Data, psBuffer->u32Offset, 0, (const struct sockaddr*)psDstAddr, sizeof(struct sockaddr_in));
-    if(iLen != psBuffer->u32Offset)
+    if((psInstance->pfvObserver == NULL) || (u32RegionOfInterest >= 0x100))
     {
-        printf("Sendto returned %d\n", iLen);
-        bOk &= FALSE;
+        return;
     }
 
-    // Buffer no longer required so free it here
-    ORLACO_vBufferDestroy(psBuffer);
-
-    return bOk;
+    au32Values[E_ORLACO_ROI_FIELD_P1X] = psRegionOfInterest->u16P1X;
+    au32Values[E_ORLACO_ROI_FIELD_P1Y] = psRegionOfInterest->u16P1Y;
+    au32Values[E_ORLACO_ROI_FIELD_P2X] = psRegionOfInterest->u16P2X;
+    au32Values[E_ORLACO_ROI_FIELD_P2Y] = psRegionOfInterest->u16P2Y;
+    au32Values[E_ORLACO_ROI_FIELD_OUTPUT_WIDTH] = psRegionOfInterest->u16OutputWidth;
+    au32Values[E_ORLACO_ROI_FIELD_OUTPUT_HEIGHT] = psRegionOfInterest->u16OutputHeight;
+    au32Values[E_ORLACO_ROI_FIELD_MAX_BITRATE] = psRegionOfInterest->u32MaxBitrate;
+    au32Values[E_ORLACO_ROI_FIELD_FRAME_RATE] = psRegionOfInterest->u8FrameRate;
+    au32Values[E_ORLACO_ROI_FIELD_COMPRESSION_MODE] = (uint32_t)psRegionOfInterest->eCompressionMode;
+
+    uIP.u32IP = ntohl(psInstance->fdUnicast.sin_addr.s_addr);
+    for(n = 0; n < E_ORLACO_ROI_NUM_FIELDS; n++)
+    {
+        psInstance->pfvObserver(psInstance->pvObserverContext, uIP, (uint16_t)ORLACO_ROI_KEY(u32RegionOfInterest, n), au32Values[n]);
+    }
 }
 
 
 /****************************************************************************
  *
- * NAME: ORLACO_bReceiveDatagram
+ * NAME: ORLACO_iReceiveFrom
  *
  * DESCRIPTION:
- * Receives a message
+ * Receives a datagram like recvfrom(), also telling whether it was sent to
+ * a multicast or broadcast address rather than to us alone. Only then does
+ * the destination in the header differ from our own address. Where the
+ * destination can't be found out, everything counts as unicast.
  *
  * RETURNS:
- * bool_t - TRUE if successful, FALSE otherwise
+ * int The length received, 0 or less on error as recvfrom()
  *
  ****************************************************************************/
-static bool_t ORLACO_bReceiveDatagram(ORLACO_tsInstance *psInstance, ORLACO_tsMsg *psRxMsg, uint16_t u16MethodID)
+static int ORLACO_iReceiveFrom(ORLACO_tsInstance *psInstance, uint8_t *pu8Data, uint32_t u32Length, int iFlags, struct sockaddr_in *psRxAddr, bool_t *pbMulticast)
 {
-    bool_t bOk = TRUE;
-    int iTimeout = ORLACO_MAX_RESPONSE_TIME_MS;
-    int iLen = 0;
-
-    uint16_t u16SenderPort;
-    int64_t i64BytesReceived = 0;
+#if defined(IP_PKTINFO) && !defined(_WIN32)
+    char acControl[CMSG_SPACE(sizeof(struct in_pktinfo))];
+    struct in_pktinfo sInfo;
+    struct cmsghdr *psCmsg;
+    struct msghdr sMsg;
+    struct iovec sIov;
+    int iLen;
 
-    const struct sockaddr_in sRxAddr = {};
-    int iRxAddrLen = sizeof(sRxAddr);
+    *pbMulticast = FALSE;
 
-    memset(psRxMsg, 0, sizeof(ORLACO_tsMsg));
+    sIov.iov_base = pu8Data;
+    sIov.iov_len = u32Length;
+    memset(&sMsg, 0, sizeof(sMsg));
+    sMsg.msg_name = psRxAddr;
+    sMsg.msg_namelen = sizeof(struct sockaddr_in);
+    sMsg.msg_iov = &sIov;
+    sMsg.msg_iovlen = 1;
+    sMsg.msg_control = acControl;
+    sMsg.msg_controllen = sizeof(acControl);
 
-    // Allocate a buffer
-    ORLACO_tsBuffer *psBuffer = ORLACO_psBufferCreate(ORLACO_BUFFER_LENGTH);
-    if(psBuffer == NULL)
+    iLen = (int)recvmsg(psInstance->Socket, &sMsg, iFlags);
+    if(iLen <= 0)
     {
-        printf("Error: Buffer allocation failed in %s\n", __FUNCTION__);
-        return FALSE;
+        return iLen;
     }
 
-    do
+    for(psCmsg = CMSG_FIRSTHDR(&sMsg); psCmsg != NULL; psCmsg = CMSG_NXTHDR(&sMsg, psCmsg))
     {
-
-        while((iLen = recvfrom(psInstance->Socket, (char*)psBuffer->pu8Data, psBuffer->u32Length, 0, (struct sockaddr*)&sRxAddr, &iRxAddrLen)) <= 0)
+        if((psCmsg->cmsg_level == IPPROTO_IP) && (psCmsg->cmsg_type == IP_PKTINFO))
         {
-            // if(iLen == SOCKET_ERROR)
-            // {
-            //     printf("Last error = %d, ptr = %p\n",WSAGetLastError(), sRxBuffer.pu8Data);
-            //     // return FALSE;
-            // }
-            iTimeout -= ORLACO_SOCKET_READ_TIMEOUT_MS;
-            if(iTimeout <= 0)
-            {
-                if(psInstance->eVerbosity >= E_ORLACO_VERBOSITY_DEBUG) printf("Rx Timeout\n");
-                ORLACO_vBufferDestroy(psBuffer);
-                return FALSE;
-            }
-#ifdef _WIN32
-            Sleep(1);
-#else
-            usleep(1000);
-#endif
+            memcpy(&sInfo, CMSG_DATA(psCmsg), sizeof(sInfo));
+            *pbMulticast = (sInfo.ipi_addr.s_addr != sInfo.ipi_spec_dst.s_addr) ? TRUE : FALSE;
         }
+    }
 
-        // printf("Addr: %s\n", inet_ntoa(sRxAddr.sin_addr));
-
-        psBuffer->u32Length = (uint32_t)iLen;
+    return iLen;
+#else
+    socklen_t tRxAddrLen = sizeof(struct sockaddr_in);
 
-        // psBuffer->u32Offset = (uint32_t)iLen;
-        // printf("Rx: ");
-        // ORLACO_vPrintBuffer(psBuffer);
-        // printf("\n");
+    *pbMulticast = FALSE;
 
-        // Get the IP address of the sender
-#ifdef _WIN32
-        psRxMsg->uSrcAddr.au8IP[3] = sRxAddr.sin_addr.S_un.S_un_b.s_b1;
-        psRxMsg->uSrcAddr.au8IP[2] = sRxAddr.sin_addr.S_un.S_un_b.s_b2;
-        psRxMsg->uSrcAddr.au8IP[1] = sRxAddr.sin_addr.S_un.S_un_b.s_b3;
-        psRxMsg->uSrcAddr.au8IP[0] = sRxAddr.sin_addr.S_un.S_un_b.s_b4;
-#else
-        psRxMsg->uSrcAddr.au8IP[3] = (uint8_t)((sRxAddr.sin_addr.s_addr >> 0) & 0xff);
-        psRxMsg->uSrcAddr.au8IP[2] = (uint8_t)((sRxAddr.sin_addr.s_addr >> 8) & 0xff);
-        psRxMsg->uSrcAddr.au8IP[1] = (uint8_t)((sRxAddr.sin_addr.s_addr >> 16) & 0xff);
-        psRxMsg->uSrcAddr.au8IP[0] = (uint8_t)((sRxAddr.sin_addr.s_addr >> 24) & 0xff);
+    return recvfrom(psInstance->Socket, (char*)pu8Data, u32Length, iFlags, (struct sockaddr*)psRxAddr, &tRxAddrLen);
 #endif
+}
 
-        psBuffer->u32Offset = 0;
-
-        bOk = ORLACO_bReadMessageHeaderFromBuffer(psBuffer, psRxMsg);
-        if(!bOk){
-            printf("Error reading message header\n");
-            continue;
-        }
 
-        // printf("RX: ServiceID=%04x MethodID=%04x Length=%08x ClientID=%04x SessionID=%04x SOME/IP Version=%d Interface Version=%d MessageType=%02x ReturnCode=%02x\n",
-        //             psRxMsg->u16ServiceID,
-        //             psRxMsg->u16MethodID,
-        //             psRxMsg->u32Length,
-        //             psRxMsg->u16ClientID,
-        //             psRxMsg->u16SessionID,
-        //             psRxMsg->u8SomeIPVersion,
-        //             psRxMsg->u8InterfaceVersion,
-        //             psRxMsg->u8MessageType,
-        //             psRxMsg->u8ReturnCode);
-    }
-    while((psRxMsg->u16ServiceID != psInstance->u16ServiceID)&&(psRxMsg->u16MethodID != u16MethodID)&&(!bOk));
+/****************************************************************************
+ *
+ * NAME: ORLACO_vTrackServiceDiscovery
+ *
+ * DESCRIPTION:
+ * Follows the reboot flag and session ID of the SD messages a camera sends,
+ * whichever receive they turn up in. As in SOME/IP-SD, unicast and
+ * multicast messages are counted separately, so each is only compared with
+ * the last on the same channel. The camera has restarted if the reboot flag
+ * comes back on, or the session ID doesn't move forwards while it's still
+ * on. Its register shadow is then forgotten and its restart count moves on, so
+ * the holders of its lock or ROIs can tell theirs are stale. The state of
+ * other cameras is left alone. Anything that isn't an SD message from a
+ * camera, including our own Find broadcasts, is ignored.
+ *
+ * RETURNS:
+ * void
+ *
+ ****************************************************************************/
+static void ORLACO_vTrackServiceDiscovery(ORLACO_tsInstance *psInstance, ORLACO_tuIP uIP, bool_t bMulticast, const uint8_t *pu8Data, int iLen)
+{
+    ORLACO_tsShadow *psShadow;
+    ORLACO_tsSdChannel *psChannel;
+    uint16_t u16SessionID;
+    bool_t bRebootFlag;
 
-    // Check the response code
-    if(psRxMsg->u8ReturnCode != E_ORLACO_RETURN_CODE_OK)
+    if((iLen < ORLACO_SD_ENTRY_OFFSET + ORLACO_SD_OPTION_LENGTH) ||
+       (((pu8Data[0] << 8) | pu8Data[1]) != 0xffff) ||
+       (((pu8Data[2] << 8) | pu8Data[3]) != E_ORLACO_METHOD_ID_SERVICE_DISCOVERY) ||
+       (pu8Data[ORLACO_SD_ENTRY_OFFSET] == ORLACO_SD_ENTRY_TYPE_FIND))
     {
-        printf("Error: Response code = %d: %s\n", psRxMsg->u8ReturnCode, ORLACO_pcGetReturnCodeAsString((ORLACO_teReturnCode)psRxMsg->u8ReturnCode));
-        ORLACO_vBufferDestroy(psBuffer);
-        return FALSE;
+        return;
     }
 
-    // printf("Rx Success\n");
-
-    switch(psRxMsg->u16MethodID)
+    psShadow = ORLACO_psGetShadow(psInstance, uIP, TRUE);
+    if(psShadow == NULL)
     {
+        return;
+    }
 
-    case E_ORLACO_METHOD_ID_GET_DATA_SHEET:
-        break;
-
-    case E_ORLACO_METHOD_ID_GET_CAM_STATUS:
-        break;
-
-    case E_ORLACO_METHOD_ID_GET_HOST_PARAMETERS:
-        break;
-
-    case E_ORLACO_METHOD_ID_GET_REGION_OF_INTEREST:
-        bOk &= ORLACO_bReadU16(psBuffer, &psRxMsg->uPayload.sGetRegionOfInterestResponsePayload.u16P1X);
-        bOk &= ORLACO_bReadU16(psBuffer, &psRxMsg->uPayload.sGetRegionOfInterestResponsePayload.u16P1Y);
-        bOk &= ORLACO_bReadU16(psBuffer, &psRxMsg->uPayload.sGetRegionOfInterestResponsePayload.u16P2X);
-        bOk &= ORLACO_bReadU16(psBuffer, &psRxMsg->uPayload.sGetRegionOfInterestResponsePayload.u16P2Y);
-        bOk &= ORLACO_bReadU8(psBuffer, &psRxMsg->uPayload.sGetRegionOfInterestResponsePayload.u8Unknown1SetTo0x01);
-        bOk &= ORLACO_bReadU8(psBuffer, &psRxMsg->uPayload.sGetRegionOfInterestResponsePayload.u8Unknown2SetTo0x00);
-        bOk &= ORLACO_bReadU16(psBuffer, &psRxMsg->uPayload.sGetRegionOfInterestResponsePayload.u16Unknown3SetTo0x0000);
-        bOk &= ORLACO_bReadU16(psBuffer, &psRxMsg->uPayload.sGetRegionOfInterestResponsePayload.u16OutputWidth);
-        bOk &= ORLACO_bReadU16(psBuffer, &psRxMsg->uPayload.sGetRegionOfInterestResponsePayload.u16OutputHeight);
-        bOk &= ORLACO_bReadU8(psBuffer, &psRxMsg->uPayload.sGetRegionOfInterestResponsePayload.u8Unknown4SetTo0x00);
-        bOk &= ORLACO_bReadU8(psBuffer, &psRxMsg->uPayload.sGetRegionOfInterestResponsePayload.u8FrameRate);
-        bOk &= ORLACO_bReadU16(psBuffer, &psRxMsg->uPayload.sGetRegionOfInterestResponsePayload.u16Unknown4bSetTo0x0000);
-        bOk &= ORLACO_bReadU8(psBuffer, &psRxMsg->uPayload.sGetRegionOfInterestResponsePayload.u8Unknown5SetTo0x00);
-        bOk &= ORLACO_bReadU8(psBuffer, &psRxMsg->uPayload.sGetRegionOfInterestResponsePayload.u8Unknown6SetTo0x02);
-        bOk &= ORLACO_bReadU32(psBuffer, &psRxMsg->uPayload.sGetRegionOfInterestResponsePayload.u32MaxBitrate);
-        bOk &= ORLACO_bReadU8(psBuffer, &psRxMsg->uPayload.sGetRegionOfInterestResponsePayload.u8VideoCompressionMode);
-        bOk &= ORLACO_bReadU8(psBuffer, &psRxMsg->uPayload.sGetRegionOfInterestResponsePayload.u8Unknown7SetTo0x00);
-        bOk &= ORLACO_bReadU8(psBuffer, &psRxMsg->uPayload.sGetRegionOfInterestResponsePayload.u8Unknown8SetTo0x00);
-        bOk &= ORLACO_bReadU8(psBuffer, &psRxMsg->uPayload.sGetRegionOfInterestResponsePayload.u8Unknown9SetTo0x00);
-        bOk &= ORLACO_bReadU8(psBuffer, &psRxMsg->uPayload.sGetRegionOfInterestResponsePayload.u8Unknown10SetTo0x04);
-        bOk &= ORLACO_bReadU8(psBuffer, &psRxMsg->uPayload.sGetRegionOfInterestResponsePayload.u8Unknown11SetTo0x01);
-        bOk &= ORLACO_bReadU16(psBuffer, &psRxMsg->uPayload.sGetRegionOfInterestResponsePayload.u16Unknown12SetTo0x00ff);
-        break;
-
-    case E_ORLACO_METHOD_ID_GET_REGIONS_OF_INTEREST:
-        break;
-
-    case E_ORLACO_METHOD_ID_GET_VIDEO_FORMAT:
-        break;
-
-    case E_ORLACO_METHOD_ID_GET_HISTOGRAMM_FORMAT:
-        break;
-
-    case E_ORLACO_METHOD_ID_GET_CAM_CONTROL:
-        break;
-
-    case E_ORLACO_METHOD_ID_GET_CAM_CONTROLS:
-        break;
-
-    case E_ORLACO_METHOD_ID_GET_CAM_REGISTER:
-        break;
+    u16SessionID = (uint16_t)((pu8Data[ORLACO_SESSION_ID_OFFSET] << 8) | pu8Data[ORLACO_SESSION_ID_OFFSET + 1]);
+    bRebootFlag = ((pu8Data[ORLACO_SD_FLAGS_OFFSET] & ORLACO_SD_FLAG_REBOOT) != 0);
 
-    case E_ORLACO_METHOD_ID_GET_CAM_REGISTERS:
-        bOk &= ORLACO_bReadU16(psBuffer, &psRxMsg->uPayload.sGetRegistersResponsePayload.u16Qtty);
-        for(int n = 0; n < psRxMsg->uPayload.sGetRegistersResponsePayload.u16Qtty; n++)
-        {
-            bOk &= ORLACO_bReadU16(psBuffer, &psRxMsg->uPayload.sGetRegistersResponsePayload.asRegisterValues[n].u16Address);
-            bOk &= ORLACO_bReadU8(psBuffer, &psRxMsg->uPayload.sGetRegistersResponsePayload.asRegisterValues[n].u8Padding);
-            bOk &= ORLACO_bReadU8(psBuffer, &psRxMsg->uPayload.sGetRegistersResponsePayload.asRegisterValues[n].u8Value);
-        }
-        break;
+    psChannel = bMulticast ? &psShadow->sSdMulticast : &psShadow->sSdUnicast;
 
-    case E_ORLACO_METHOD_ID_SERVICE_DISCOVERY:
-        bOk &= ORLACO_bReadU8(psBuffer, &psRxMsg->uPayload.sServiceDiscoveryPayload.u8Flags);
-        bOk &= ORLACO_bReadU24(psBuffer, &psRxMsg->uPayload.sServiceDiscoveryPayload.u24Reserved);
-        bOk &= ORLACO_bReadU32(psBuffer, &psRxMsg->uPayload.sServiceDiscoveryPayload.u32LengthOfEntriesArrayInBytes);
-        for(int n = 0; n < psRxMsg->uPayload.sServiceDiscoveryPayload.u32LengthOfEntriesArrayInBytes; n += ORLACO_SD_OPTION_LENGTH)
-        {
-            bOk &= ORLACO_bReadServiceDiscoveryServiceEntryFromBuffer(psBuffer, &psRxMsg->uPayload.sServiceDiscoveryPayload.asServiceEntry[n]);
-        }
-        break;
+    if(psInstance->eVerbosity >= E_ORLACO_VERBOSITY_DEBUG) printf("SD from %d.%d.%d.%d %s session %u flags %02x in %s\n", uIP.au8IP[3], uIP.au8IP[2], uIP.au8IP[1], uIP.au8IP[0], bMulticast ? "multicast" : "unicast", u16SessionID, pu8Data[ORLACO_SD_FLAGS_OFFSET], __FUNCTION__);
 
-    // Either the response doesn't contain any data or no idea what it is
-    default:
-        break;
+    if(psChannel->bAnnounced && bRebootFlag && (!psChannel->bRebootFlag || (psChannel->u16SessionID >= u16SessionID)))
+    {
+        printf("Warning: %d.%d.%d.%d has restarted, forgetting what was known about it\n", uIP.au8IP[3], uIP.au8IP[2], uIP.au8IP[1], uIP.au8IP[0]);
+        memset(psShadow->asRegisters, 0, sizeof(psShadow->asRegisters));
+        psShadow->u32Restarts++;
 
+        // The other channel started again too, so it's followed afresh rather than taken for a second restart
+        memset(bMulticast ? &psShadow->sSdUnicast : &psShadow->sSdMulticast, 0, sizeof(ORLACO_tsSdChannel));
     }
 
-    ORLACO_vBufferDestroy(psBuffer);
-
-    return bOk;
-
+    psChannel->bAnnounced = TRUE;
+    psChannel->bRebootFlag = bRebootFlag;
+    psChannel->u16SessionID = u16SessionID;
 }
 
 
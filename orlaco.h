@@ -42,6 +42,19 @@
 
 #define ORLACO_BUFFER_LENGTH            1500
 #define ORLACO_NUM_REGIONS_OF_INTEREST  11
+#define ORLACO_HISTOGRAM_MAX_BINS       256
+#define ORLACO_MAX_WRITE_REGISTERS      16
+#define ORLACO_MAX_COMMAND_LENGTH       96
+#define ORLACO_MAX_LEASES               64
+#define ORLACO_DEFAULT_LOCK_WAIT_MS     5000
+#define ORLACO_MAX_SHADOWS              64                  // Cameras whose register values are remembered
+#define ORLACO_MAX_SHADOW_REGISTERS     128
+#define ORLACO_MAX_SUBNETS              16                  // Whose in flight windows are remembered
+#define ORLACO_SUBNET_MASK              0xffffff00          // Cameras sharing a window share a /24
+#define ORLACO_DEFAULT_FRESHNESS_MS     10000               // How long a remembered register value is trusted
+#define ORLACO_SD_FLAG_REBOOT           0x80                // In u8Flags of SD messages, from a restart until the session ID first wraps
+#define ORLACO_SD_FLAG_UNICAST          0x40
+#define ORLACO_ROI_KEY(roi, field)      (0x1000 | ((roi) << 4) | (field)) // Observer key of an ROI field, registers are keyed by address
 
 #ifndef TRUE
 #define TRUE                            (1)
@@ -199,6 +212,76 @@ typedef struct {
 } ORLACO_tsRegisterValue;
 
 
+// Make sure these remain in the same order as the register indexes
+typedef enum {
+    E_ORLACO_REGISTER_ADDRESS_LED_MODE                             = 0xb00c,
+    E_ORLACO_REGISTER_ADDRESS_STREAM_PROTOCOL                      = 0xb041,
+    E_ORLACO_REGISTER_ADDRESS_STATIC_IP_ADDRESS_0                  = 0xb042,
+    E_ORLACO_REGISTER_ADDRESS_STATIC_IP_ADDRESS_1                  = 0xb043,
+    E_ORLACO_REGISTER_ADDRESS_STATIC_IP_ADDRESS_2                  = 0xb044,
+    E_ORLACO_REGISTER_ADDRESS_STATIC_IP_ADDRESS_3                  = 0xb045,
+    E_ORLACO_REGISTER_ADDRESS_STATIC_NETWORK_MASK_0                = 0xb046,
+    E_ORLACO_REGISTER_ADDRESS_STATIC_NETWORK_MASK_1                = 0xb047,
+    E_ORLACO_REGISTER_ADDRESS_STATIC_NETWORK_MASK_2                = 0xb048,
+    E_ORLACO_REGISTER_ADDRESS_STATIC_NETWORK_MASK_3                = 0xb049,
+    E_ORLACO_REGISTER_ADDRESS_MAC_ADDRESS_0                        = 0xb04a,
+    E_ORLACO_REGISTER_ADDRESS_MAC_ADDRESS_1                        = 0xb04b,
+    E_ORLACO_REGISTER_ADDRESS_MAC_ADDRESS_2                        = 0xb04c,
+    E_ORLACO_REGISTER_ADDRESS_MAC_ADDRESS_3                        = 0xb04d,
+    E_ORLACO_REGISTER_ADDRESS_MAC_ADDRESS_4                        = 0xb04e,
+    E_ORLACO_REGISTER_ADDRESS_MAC_ADDRESS_5                        = 0xb04f,
+    E_ORLACO_REGISTER_ADDRESS_VLAN_ID_0                            = 0xb055,
+    E_ORLACO_REGISTER_ADDRESS_VLAN_ID_1                            = 0xb056,
+    E_ORLACO_REGISTER_ADDRESS_STREAM_ID_0                          = 0xb057,  // 0xb057 - 0xb05e inclusive
+    E_ORLACO_REGISTER_ADDRESS_STREAM_ID_1                          = 0xb058,  // 0xb057 - 0xb05e inclusive
+    E_ORLACO_REGISTER_ADDRESS_STREAM_ID_2                          = 0xb059,  // 0xb057 - 0xb05e inclusive
+    E_ORLACO_REGISTER_ADDRESS_STREAM_ID_3                          = 0xb05a,  // 0xb057 - 0xb05e inclusive
+    E_ORLACO_REGISTER_ADDRESS_STREAM_ID_4                          = 0xb05b,  // 0xb057 - 0xb05e inclusive
+    E_ORLACO_REGISTER_ADDRESS_STREAM_ID_5                          = 0xb05c,  // 0xb057 - 0xb05e inclusive
+    E_ORLACO_REGISTER_ADDRESS_STREAM_ID_6                          = 0xb05d,  // 0xb057 - 0xb05e inclusive
+    E_ORLACO_REGISTER_ADDRESS_STREAM_ID_7                          = 0xb05e,  // 0xb057 - 0xb05e inclusive
+    E_ORLACO_REGISTER_ADDRESS_RTP_STREAM_DESTINATION_IP_ADDRESS_0  = 0xb05f,
+    E_ORLACO_REGISTER_ADDRESS_RTP_STREAM_DESTINATION_IP_ADDRESS_1  = 0xb060,
+    E_ORLACO_REGISTER_ADDRESS_RTP_STREAM_DESTINATION_IP_ADDRESS_2  = 0xb061,
+    E_ORLACO_REGISTER_ADDRESS_RTP_STREAM_DESTINATION_IP_ADDRESS_3  = 0xb062,
+    E_ORLACO_REGISTER_ADDRESS_RTP_STREAM_DESTINATION_MAC_ADDRESS_0 = 0xb063,
+    E_ORLACO_REGISTER_ADDRESS_RTP_STREAM_DESTINATION_MAC_ADDRESS_1 = 0xb064,
+    E_ORLACO_REGISTER_ADDRESS_RTP_STREAM_DESTINATION_MAC_ADDRESS_2 = 0xb065,
+    E_ORLACO_REGISTER_ADDRESS_RTP_STREAM_DESTINATION_MAC_ADDRESS_3 = 0xb066,
+    E_ORLACO_REGISTER_ADDRESS_RTP_STREAM_DESTINATION_MAC_ADDRESS_4 = 0xb067,
+    E_ORLACO_REGISTER_ADDRESS_RTP_STREAM_DESTINATION_MAC_ADDRESS_5 = 0xb068,
+    E_ORLACO_REGISTER_ADDRESS_RTP_STREAM_DESTINATION_PORT_0        = 0xb069,
+    E_ORLACO_REGISTER_ADDRESS_RTP_STREAM_DESTINATION_PORT_1        = 0xb06a,
+    E_ORLACO_REGISTER_ADDRESS_SELECTED_ROI                         = 0xb06b,
+    E_ORLACO_REGISTER_ADDRESS_NO_STREAM_AT_BOOT                    = 0xb06c,
+    E_ORLACO_REGISTER_ADDRESS_UDP_COMMUNICATION_PORT_0             = 0xb06d,
+    E_ORLACO_REGISTER_ADDRESS_UDP_COMMUNICATION_PORT_1             = 0xb06e,
+    E_ORLACO_REGISTER_ADDRESS_RTP_STREAM_SOURCE_PORT_0             = 0xb06f,
+    E_ORLACO_REGISTER_ADDRESS_RTP_STREAM_SOURCE_PORT_1             = 0xb070,
+    E_ORLACO_REGISTER_ADDRESS_HDR                                  = 0xb071,
+    E_ORLACO_REGISTER_ADDRESS_OVERLAY                              = 0xb072,
+    E_ORLACO_REGISTER_ADDRESS_DHCP                                 = 0xb073,
+    E_ORLACO_REGISTER_ADDRESS_WAIT_FOR_MAC                         = 0xb078,
+    E_ORLACO_REGISTER_ADDRESS_WAIT_FOR_PTP_SYNC                    = 0xb079,
+    E_ORLACO_REGISTER_ADDRESS_DHCP_HOSTNAME_0                      = 0xb171,   // 0xb171 - 0xb180 inclusive
+    E_ORLACO_REGISTER_ADDRESS_DHCP_HOSTNAME_1                      = 0xb172,   // 0xb171 - 0xb180 inclusive
+    E_ORLACO_REGISTER_ADDRESS_DHCP_HOSTNAME_2                      = 0xb173,   // 0xb171 - 0xb180 inclusive
+    E_ORLACO_REGISTER_ADDRESS_DHCP_HOSTNAME_3                      = 0xb174,   // 0xb171 - 0xb180 inclusive
+    E_ORLACO_REGISTER_ADDRESS_DHCP_HOSTNAME_4                      = 0xb175,   // 0xb171 - 0xb180 inclusive
+    E_ORLACO_REGISTER_ADDRESS_DHCP_HOSTNAME_5                      = 0xb176,   // 0xb171 - 0xb180 inclusive
+    E_ORLACO_REGISTER_ADDRESS_DHCP_HOSTNAME_6                      = 0xb177,   // 0xb171 - 0xb180 inclusive
+    E_ORLACO_REGISTER_ADDRESS_DHCP_HOSTNAME_7                      = 0xb178,   // 0xb171 - 0xb180 inclusive
+    E_ORLACO_REGISTER_ADDRESS_DHCP_HOSTNAME_8                      = 0xb179,   // 0xb171 - 0xb180 inclusive
+    E_ORLACO_REGISTER_ADDRESS_DHCP_HOSTNAME_9                      = 0xb17a,   // 0xb171 - 0xb180 inclusive
+    E_ORLACO_REGISTER_ADDRESS_DHCP_HOSTNAME_10                     = 0xb17b,   // 0xb171 - 0xb180 inclusive
+    E_ORLACO_REGISTER_ADDRESS_DHCP_HOSTNAME_11                     = 0xb17c,   // 0xb171 - 0xb180 inclusive
+    E_ORLACO_REGISTER_ADDRESS_DHCP_HOSTNAME_12                     = 0xb17d,   // 0xb171 - 0xb180 inclusive
+    E_ORLACO_REGISTER_ADDRESS_DHCP_HOSTNAME_13                     = 0xb17e,   // 0xb171 - 0xb180 inclusive
+    E_ORLACO_REGISTER_ADDRESS_DHCP_HOSTNAME_14                     = 0xb17f,   // 0xb171 - 0xb180 inclusive
+    E_ORLACO_REGISTER_ADDRESS_DHCP_HOSTNAME_15                     = 0xb180,   // 0xb171 - 0xb180 inclusive
+} ORLACO_teRegisterAddress;
+
+
 typedef union {
     uint8_t au8IP[4];
     uint32_t u32IP;
@@ -220,6 +303,22 @@ typedef struct {
 } ORLACO_tsRegionOfInterest;
 
 
+typedef struct {
+    uint16_t u16NumBins;
+    uint8_t u8Channel;                              // 0 = luma
+    uint8_t u8Interval;                             // Frames between notifications
+} ORLACO_tsHistogramFormat;
+
+
+typedef struct {
+    ORLACO_tuIP uIP;                                // Camera that sent it
+    uint32_t u32RegionOfInterest;
+    uint32_t u32FrameCounter;
+    uint16_t u16NumBins;
+    uint32_t au32Bins[ORLACO_HISTOGRAM_MAX_BINS];   // Pixel counts, darkest first
+} ORLACO_tsHistogram;
+
+
 typedef struct {
     uint8_t u8Type;
     uint8_t u8Index1stOptions;
@@ -238,12 +337,125 @@ typedef struct {
     ORLACO_tsServiceDiscoveryServiceEntry sDiscoveryServiceEntry;
 } ORLACO_tsCamera;
 
+
+// Registers to write to one camera when writing to several at once, or to
+// read from it when reading from several
+typedef struct {
+    ORLACO_tuIP uIP;
+    uint16_t u16NumRegisters;
+    uint16_t au16Addresses[ORLACO_MAX_WRITE_REGISTERS];
+    uint8_t au8Values[ORLACO_MAX_WRITE_REGISTERS];
+    uint8_t u8RegisterSet;                          // Put in use by register set steps
+    bool_t bLeased;                                 // The lock is held under a lease, so isn't taken or released
+    bool_t bUnchanged;                              // The camera already held every value, so nothing was sent
+    bool_t bOk;                                     // Every step was acknowledged
+    uint8_t u8ReturnCode;                           // Of the last step answered
+    uint16_t u16SessionID;                          // Of the request awaiting a response
+    uint64_t u64SentUs;                             // When it was sent, on the RTP_u64GetTimeUs clock
+    bool_t bLost;                                   // It's been waited on so long it no longer counts as in flight
+    bool_t bUnsent;                                 // Still to be sent, or sent again after the camera answered it wasn't ready
+} ORLACO_tsRegisterWrite;
+
+
+// A request serialised ahead of time, so sending it only needs a session ID
+typedef struct {
+    uint8_t au8Data[ORLACO_MAX_COMMAND_LENGTH];
+    uint32_t u32Length;
+    uint16_t u16MethodID;
+    uint16_t u16SessionID;                          // Of the last time it was sent
+    uint8_t u8ReturnCode;                           // Of the last response
+} ORLACO_tsCommand;
+
+// Retrying a lock held by another client
+typedef struct {
+    uint64_t u64DeadlineUs;                         // When to give up, on the RTP_u64GetTimeUs clock
+    uint32_t u32DelayMs;                            // Upper bound of the next wait
+} ORLACO_tsBackoff;
+
+// The exclusive lock on a camera, held for a whole session
+typedef struct {
+    ORLACO_tuIP uIP;
+    bool_t bHeld;
+    uint64_t u64RenewUs;                            // When it's due to be renewed, on the RTP_u64GetTimeUs clock
+    bool_t bPending;                                // Locked by another client, so being retried
+    uint64_t u64RetryUs;
+    ORLACO_tsBackoff sBackoff;
+    uint32_t u32Restarts;                           // Of the camera when the lock was last taken
+} ORLACO_tsLease;
+
+// How many requests may await a response at once, from one camera or from
+// the cameras on one subnet. It grows as responses come back in time and is
+// halved when they don't, or a camera answers that it isn't ready, the same
+// way as TCP's congestion window.
+typedef struct {
+    uint32_t u32Window;                             // In 1/ORLACO_WINDOW_SCALE of a request, 0 until first used
+    uint32_t u32Threshold;                          // Grows a request per response below this, a request per window of them above it
+    uint64_t u64ShrunkUs;                           // Requests sent before then can't shrink it again
+} ORLACO_tsWindow;
+
+typedef struct {
+    uint32_t u32Address;                            // Masked by ORLACO_SUBNET_MASK
+    ORLACO_tsWindow sWindow;
+} ORLACO_tsSubnet;
+
+// A register value last read from or written to a camera
+typedef struct {
+    uint8_t u8Value;
+    uint64_t u64UpdatedUs;                          // On the RTP_u64GetTimeUs clock, 0 if not known
+} ORLACO_tsShadowRegister;
+
+// Where a camera's SD messages on one channel have got to. Its unicast and
+// multicast messages each have their own session ID and reboot flag.
+typedef struct {
+    bool_t bAnnounced;                              // An SD message has been seen on the channel
+    bool_t bRebootFlag;                             // Of its last SD message on the channel
+    uint16_t u16SessionID;                          // Of its last SD message on the channel
+} ORLACO_tsSdChannel;
+
+// What one camera's registers are known to hold, by register index, and
+// where its SD messages have got to
+typedef struct {
+    ORLACO_tuIP uIP;
+    ORLACO_tsShadowRegister asRegisters[ORLACO_MAX_SHADOW_REGISTERS];
+    ORLACO_tsSdChannel sSdUnicast;
+    ORLACO_tsSdChannel sSdMulticast;                // Multicast and broadcast
+    uint32_t u32Restarts;                           // Seen in its SD messages, anything held about the camera from before is stale
+    ORLACO_tsWindow sWindow;
+    uint32_t u32RttUs;                              // Smoothed time it takes to respond, 0 until measured
+    uint32_t u32RttVarianceUs;
+} ORLACO_tsShadow;
+
+// Shared with the processes forked from the instance, such as the daemon's
+// requests, so what each of them learns outlives it
+typedef struct {
+    uint32_t u32NumShadows;
+    ORLACO_tsShadow asShadows[ORLACO_MAX_SHADOWS];
+    uint32_t u32NumSubnets;
+    ORLACO_tsSubnet asSubnets[ORLACO_MAX_SUBNETS];
+} ORLACO_tsShadowTable;
+
 #ifdef _WIN32
     typedef unsigned int UDPSOCKET;
 #else
     typedef int UDPSOCKET;
 #endif
 
+typedef enum {
+    E_ORLACO_ROI_FIELD_P1X,
+    E_ORLACO_ROI_FIELD_P1Y,
+    E_ORLACO_ROI_FIELD_P2X,
+    E_ORLACO_ROI_FIELD_P2Y,
+    E_ORLACO_ROI_FIELD_OUTPUT_WIDTH,
+    E_ORLACO_ROI_FIELD_OUTPUT_HEIGHT,
+    E_ORLACO_ROI_FIELD_MAX_BITRATE,
+    E_ORLACO_ROI_FIELD_FRAME_RATE,
+    E_ORLACO_ROI_FIELD_COMPRESSION_MODE,
+    E_ORLACO_ROI_NUM_FIELDS
+} ORLACO_teRoiField;
+
+// Told each value read from or written to a camera, keyed by register address or ORLACO_ROI_KEY
+typedef void (*ORLACO_tpfvObserver)(void *pvContext, ORLACO_tuIP uIP, uint16_t u16Key, uint32_t u32Value);
+
 typedef struct {
     ORLACO_eVerbosityLevel eVerbosity;
     struct sockaddr_in fdServer;
@@ -255,6 +467,7 @@ typedef struct {
     uint16_t u16ClientID;
     uint16_t u16SessionID;
     uint16_t u16ResponseTimer;
+    uint32_t u32ResponseTimeMs;                     // How long a receive waits for a response
     ORLACO_teCameraMode eCameraMode;
     uint16_t u16NumRegisters;
     ORLACO_tsRegisterValue *psRegisters;
@@ -262,6 +475,15 @@ typedef struct {
     ORLACO_tsRegionOfInterest *psRegionsOfInterest;
     uint16_t u16NumCameras;
     ORLACO_tsCamera *psCameras;
+    ORLACO_tsLease asLeases[ORLACO_MAX_LEASES];
+    uint32_t u32NumLeases;
+    uint32_t u32LeaseTime;                          // Seconds, as requested from the cameras
+    uint32_t u32LockWaitMs;                         // How long to keep trying for a camera locked by another client
+    uint32_t u32Random;                             // Jitter for backing off from those cameras
+    ORLACO_tsShadowTable *psShadows;
+    uint32_t u32FreshnessMs;                        // Reads are answered from, and writes compared with, values this recent. 0 to always go to the camera
+    ORLACO_tpfvObserver pfvObserver;
+    void *pvObserverContext;
 } ORLACO_tsInstance;
 
 /****************************************************************************/
@@ -273,20 +495,47 @@ void ORLACO_vDeInit(ORLACO_tsInstance *psInstance);
 void ORLACO_vSetVerbosity(ORLACO_tsInstance *psInstance, ORLACO_eVerbosityLevel eVerbosityLevel);
 bool_t ORLACO_bSetBroadcastIP(ORLACO_tsInstance *psInstance, char *pcIpAddress, uint16_t u16DstPort);
 bool_t ORLACO_bSetUnicastIP(ORLACO_tsInstance *psInstance, char *pcIpAddress, uint16_t u16DstPort);
+ORLACO_tsRegisterValue *ORLACO_psGetRegister(ORLACO_tsInstance *psInstance, uint16_t u16Address);
+bool_t ORLACO_bIsMulticast(ORLACO_tuIP uIP);
+void ORLACO_vGetMulticastMac(ORLACO_tuIP uGroup, uint8_t *pu8Mac);
+bool_t ORLACO_bSetMulticastDestination(ORLACO_tsInstance *psInstance, ORLACO_tuIP uGroup, uint16_t u16Port);
+bool_t ORLACO_bCheckDestination(ORLACO_tsInstance *psInstance);
 
 // bool_t ORLACO_bBufferTest(ORLACO_tsInstance *psInstance);
 bool_t ORLACO_bDiscover(ORLACO_tsInstance *psInstance);
 bool_t ORLACO_bSetCamExclusive(ORLACO_tsInstance *psInstance, uint32_t u32ExclusiveTime);
 bool_t ORLACO_bEraseCamExclusive(ORLACO_tsInstance *psInstance);
 bool_t ORLACO_bSetCamMode(ORLACO_tsInstance *psInstance, ORLACO_teCameraMode eMode);
+bool_t ORLACO_bAcquireLeases(ORLACO_tsInstance *psInstance, ORLACO_tuIP *puIPs, uint32_t u32NumIPs, uint32_t u32LeaseTime);
+bool_t ORLACO_bServiceLeases(ORLACO_tsInstance *psInstance);
+void ORLACO_vReleaseLeases(ORLACO_tsInstance *psInstance);
+bool_t ORLACO_bIsLeased(ORLACO_tsInstance *psInstance, ORLACO_tuIP uIP);
 bool_t ORLACO_bGetRegisters(ORLACO_tsInstance *psInstance);
+bool_t ORLACO_bGetRegistersPipelined(ORLACO_tsInstance *psInstance, ORLACO_tsRegisterWrite *psReads, uint32_t u32NumReads);
+bool_t ORLACO_bHasChanges(ORLACO_tsInstance *psInstance);
+void ORLACO_vForgetShadow(ORLACO_tsInstance *psInstance, ORLACO_tuIP uIP);
+uint32_t ORLACO_u32GetRestarts(ORLACO_tsInstance *psInstance, ORLACO_tuIP uIP);
+void ORLACO_vPollServiceDiscovery(ORLACO_tsInstance *psInstance);
+void ORLACO_vSetObserver(ORLACO_tsInstance *psInstance, ORLACO_tpfvObserver pfvObserver, void *pvContext);
 bool_t ORLACO_bSetRegisters(ORLACO_tsInstance *psInstance);
+bool_t ORLACO_bSetRegistersPipelined(ORLACO_tsInstance *psInstance, ORLACO_tsRegisterWrite *psWrites, uint32_t u32NumWrites);
+bool_t ORLACO_bSetUsedRegisterSet(ORLACO_tsInstance *psInstance, uint8_t u8RegisterSet);
+bool_t ORLACO_bSetUsedRegisterSetPipelined(ORLACO_tsInstance *psInstance, ORLACO_tsRegisterWrite *psWrites, uint32_t u32NumWrites);
+bool_t ORLACO_bStageRegisterSetPipelined(ORLACO_tsInstance *psInstance, ORLACO_tsRegisterWrite *psWrites, uint32_t u32NumWrites, uint8_t u8RegisterSet, uint8_t u8ActiveSet);
+bool_t ORLACO_bBuildSetCamExclusive(ORLACO_tsInstance *psInstance, uint32_t u32ExclusiveTime, ORLACO_tsCommand *psCommand);
+bool_t ORLACO_bBuildSetRegisters(ORLACO_tsInstance *psInstance, uint16_t *pu16Addresses, uint8_t *pu8Values, uint16_t u16NumRegisters, ORLACO_tsCommand *psCommand);
+bool_t ORLACO_bSendCommand(ORLACO_tsInstance *psInstance, ORLACO_tsCommand *psCommand);
+bool_t ORLACO_bPollCommand(ORLACO_tsInstance *psInstance, ORLACO_tsCommand *psCommand, bool_t *pbAnswered);
 bool_t ORLACO_bGetAllRegisters(ORLACO_tsInstance *psInstance);
 bool_t ORLACO_bGetRegionOfInterest(ORLACO_tsInstance *psInstance, uint32_t u32RegionOfInterest, ORLACO_tsRegionOfInterest *psRegionOfInterest);
 bool_t ORLACO_bGetRegionsOfInterest(ORLACO_tsInstance *psInstance);
 bool_t ORLACO_bSetRegionOfInterest(ORLACO_tsInstance *psInstance, uint32_t u32RegionOfInterestIndex, ORLACO_tsRegionOfInterest *psRegionOfInterest);
 bool_t ORLACO_bSetRegionsOfInterest(ORLACO_tsInstance *psInstance);
 bool_t ORLACO_bSubscribeRoiVideo(ORLACO_tsInstance *psInstance, uint32_t u32RegionOfInterest);
+bool_t ORLACO_bSetHistogramFormat(ORLACO_tsInstance *psInstance, uint32_t u32RegionOfInterest, ORLACO_tsHistogramFormat *psFormat);
+bool_t ORLACO_bGetHistogramFormat(ORLACO_tsInstance *psInstance, uint32_t u32RegionOfInterest, ORLACO_tsHistogramFormat *psFormat);
+bool_t ORLACO_bSubscribeRoiHistogram(ORLACO_tsInstance *psInstance, uint32_t u32RegionOfInterest, bool_t bSubscribe);
+bool_t ORLACO_bReceiveHistogram(ORLACO_tsInstance *psInstance, ORLACO_tsHistogram *psHistogram);
 
 
 #endif // ORLACO_H
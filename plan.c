@@ -0,0 +1,813 @@
+/****************************************************************************
+ *
+ * Copyright 2021 Lee Mitchell <lee@indigopepper.com>
+ * This file is part of OCC (Orlaco Camera Configurator)
+ *
+ * OCC (Orlaco Camera Configurator) is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * OCC (Orlaco Camera Configurator) is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with OCC (Orlaco Camera Configurator).  If not,
+ * see <http://www.gnu.org/licenses/>.
+ *
+ ****************************************************************************/
+
+/****************************************************************************/
+/***        Include files                                                 ***/
+/****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "common.h"
+#include "plan.h"
+
+#ifndef _WIN32
+#include <dirent.h>
+#include <ifaddrs.h>
+#include <net/if.h>
+#endif
+
+/****************************************************************************/
+/***        Macro Definitions                                             ***/
+/****************************************************************************/
+
+#define PLAN_NUM_REGISTERS              7
+
+/****************************************************************************/
+/***        Type Definitions                                              ***/
+/****************************************************************************/
+
+/****************************************************************************/
+/***        Local Function Prototypes                                     ***/
+/****************************************************************************/
+
+static void PLAN_vFindNics(PLAN_tsInstance *psPlan);
+static uint32_t PLAN_u32GetLinkSpeed(const char *pcInterface);
+static void PLAN_vGetNicDetails(PLAN_tsLink *psNic);
+static int32_t PLAN_i32FindNic(PLAN_tsInstance *psPlan, ORLACO_tuIP uIP);
+static PLAN_tsLink *PLAN_psGetDestination(PLAN_tsInstance *psPlan, PLAN_tsStream *psStream);
+static void PLAN_vCheck(PLAN_tsInstance *psPlan, PLAN_tsLink *psLink);
+static void PLAN_vPrintLink(PLAN_tsLink *psLink, const char *pcType, bool_t bNdjson);
+
+/****************************************************************************/
+/***        Exported Variables                                            ***/
+/****************************************************************************/
+
+/****************************************************************************/
+/***        Local Variables                                               ***/
+/****************************************************************************/
+
+// Destination address, destination port and selected ROI, most significant byte first
+static const uint16_t au16Registers[PLAN_NUM_REGISTERS] = {
+    E_ORLACO_REGISTER_ADDRESS_RTP_STREAM_DESTINATION_IP_ADDRESS_0,
+    E_ORLACO_REGISTER_ADDRESS_RTP_STREAM_DESTINATION_IP_ADDRESS_1,
+    E_ORLACO_REGISTER_ADDRESS_RTP_STREAM_DESTINATION_IP_ADDRESS_2,
+    E_ORLACO_REGISTER_ADDRESS_RTP_STREAM_DESTINATION_IP_ADDRESS_3,
+    E_ORLACO_REGISTER_ADDRESS_RTP_STREAM_DESTINATION_PORT_0,
+    E_ORLACO_REGISTER_ADDRESS_RTP_STREAM_DESTINATION_PORT_1,
+    E_ORLACO_REGISTER_ADDRESS_SELECTED_ROI,
+};
+
+/****************************************************************************/
+/***        Exported Functions                                            ***/
+/****************************************************************************/
+
+/****************************************************************************
+ *
+ * NAME: PLAN_bInit
+ *
+ * DESCRIPTION:
+ * Starts an empty plan and lists the local interfaces streams can arrive on
+ *
+ * RETURNS:
+ * bool_t TRUE if successful, FALSE otherwise
+ *
+ ****************************************************************************/
+bool_t PLAN_bInit(PLAN_tsInstance *psPlan, uint32_t u32CapacityMbps)
+{
+    memset(psPlan, 0, sizeof(PLAN_tsInstance));
+
+    psPlan->u32CapacityMbps = u32CapacityMbps;
+
+    PLAN_vFindNics(psPlan);
+
+    return TRUE;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: PLAN_bAddCamera
+ *
+ * DESCRIPTION:
+ * Reads where a camera streams to, which ROI it streams and that ROI's
+ * maximum bitrate. With bPending the register and ROI writes queued up for
+ * the camera take the place of what it currently has, so a configuration can
+ * be checked before it's applied. The queued writes are left as they were.
+ *
+ * RETURNS:
+ * bool_t TRUE if successful, FALSE otherwise
+ *
+ ****************************************************************************/
+bool_t PLAN_bAddCamera(PLAN_tsInstance *psPlan, ORLACO_tsInstance *psOrlaco, ORLACO_tuIP uCameraIP, bool_t bPending)
+{
+    ORLACO_tsRegisterValue *apsRegisters[PLAN_NUM_REGISTERS];
+    ORLACO_tsRegisterValue asSaved[PLAN_NUM_REGISTERS];
+    uint8_t au8Values[PLAN_NUM_REGISTERS];
+    ORLACO_tsRegionOfInterest sROI;
+    PLAN_tsStream *psStream;
+    bool_t bFromPending = FALSE;
+    bool_t bOk;
+    int n;
+
+    if(psPlan->u32NumStreams >= PLAN_MAX_STREAMS)
+    {
+        printf("Error: Too many cameras in %s\n", __FUNCTION__);
+        return FALSE;
+    }
+
+    for(n = 0; n < PLAN_NUM_REGISTERS; n++)
+    {
+        apsRegisters[n] = ORLACO_psGetRegister(psOrlaco, au16Registers[n]);
+        if(apsRegisters[n] == NULL)
+        {
+            return FALSE;
+        }
+    }
+
+    // Reading overwrites the values of any queued writes, so put them back afterwards
+    for(n = 0; n < PLAN_NUM_REGISTERS; n++)
+    {
+        asSaved[n] = *apsRegisters[n];
+        apsRegisters[n]->bRead = TRUE;
+    }
+
+    psOrlaco->fdUnicast.sin_addr.s_addr = htonl(uCameraIP.u32IP);
+    bOk = ORLACO_bGetRegisters(psOrlaco);
+
+    for(n = 0; n < PLAN_NUM_REGISTERS; n++)
+    {
+        if(bPending && asSaved[n].bWrite)
+        {
+            au8Values[n] = asSaved[n].u8Value;
+            bFromPending = TRUE;
+        }
+        else
+        {
+            au8Values[n] = apsRegisters[n]->u8Value;
+        }
+        *apsRegisters[n] = asSaved[n];
+    }
+
+    if(!bOk)
+    {
+        return FALSE;
+    }
+
+    if(bPending && (au8Values[6] < psOrlaco->u16NumRegionsOfInterest) && psOrlaco->psRegionsOfInterest[au8Values[6]].bWrite)
+    {
+        sROI = psOrlaco->psRegionsOfInterest[au8Values[6]];
+        bFromPending = TRUE;
+    }
+    else if(!ORLACO_bGetRegionOfInterest(psOrlaco, au8Values[6], &sROI))
+    {
+        return FALSE;
+    }
+
+    psStream = &psPlan->asStreams[psPlan->u32NumStreams++];
+    psStream->uCameraIP = uCameraIP;
+    psStream->u8RegionOfInterest = au8Values[6];
+    psStream->u32MaxBitrate = sROI.u32MaxBitrate;
+    psStream->uDestinationIP.u32IP = ((uint32_t)au8Values[0] << 24) | ((uint32_t)au8Values[1] << 16) | ((uint32_t)au8Values[2] << 8) | au8Values[3];
+    psStream->u16DestinationPort = (uint16_t)((au8Values[4] << 8) | au8Values[5]);
+    psStream->bPending = bFromPending;
+
+    // Streams arrive on the interface that shares a subnet with their destination, or with the camera if the destination is elsewhere
+    psStream->i32Nic = PLAN_i32FindNic(psPlan, psStream->uDestinationIP);
+    if(psStream->i32Nic < 0)
+    {
+        psStream->i32Nic = PLAN_i32FindNic(psPlan, uCameraIP);
+    }
+
+    return TRUE;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: PLAN_bEvaluate
+ *
+ * DESCRIPTION:
+ * Adds up the worst case each interface and each destination would carry if
+ * every stream ran at its ROI's maximum bitrate
+ *
+ * RETURNS:
+ * bool_t TRUE if every link has the capacity for it, FALSE otherwise
+ *
+ ****************************************************************************/
+bool_t PLAN_bEvaluate(PLAN_tsInstance *psPlan)
+{
+    PLAN_tsStream *psStream;
+    PLAN_tsLink *psLink;
+    uint64_t u64Kbps;
+    uint32_t n;
+
+    for(n = 0; n < psPlan->u32NumNics; n++)
+    {
+        psPlan->asNics[n].u32NumStreams = 0;
+        psPlan->asNics[n].u64WorstCaseKbps = 0;
+    }
+    psPlan->u32NumDestinations = 0;
+    psPlan->u32Oversubscribed = 0;
+    psPlan->u32Unknown = 0;
+
+    for(n = 0; n < psPlan->u32NumStreams; n++)
+    {
+        psStream = &psPlan->asStreams[n];
+        u64Kbps = (uint64_t)psStream->u32MaxBitrate * 10 * (100 + PLAN_OVERHEAD_PERCENT);
+
+        if(psStream->i32Nic >= 0)
+        {
+            psLink = &psPlan->asNics[psStream->i32Nic];
+            psLink->u32NumStreams++;
+            psLink->u64WorstCaseKbps += u64Kbps;
+        }
+
+        psLink = PLAN_psGetDestination(psPlan, psStream);
+        if(psLink != NULL)
+        {
+            psLink->u32NumStreams++;
+            psLink->u64WorstCaseKbps += u64Kbps;
+        }
+    }
+
+    for(n = 0; n < psPlan->u32NumNics; n++)
+    {
+        if(psPlan->asNics[n].u32NumStreams > 0)
+        {
+            PLAN_vCheck(psPlan, &psPlan->asNics[n]);
+        }
+    }
+    for(n = 0; n < psPlan->u32NumDestinations; n++)
+    {
+        PLAN_vCheck(psPlan, &psPlan->asDestinations[n]);
+    }
+
+    return (psPlan->u32Oversubscribed == 0);
+}
+
+
+/****************************************************************************
+ *
+ * NAME: PLAN_bBalance
+ *
+ * DESCRIPTION:
+ * Gives each stream a destination on one of a comma separated list of local
+ * interfaces, spreading the streams over the interfaces and, within each,
+ * over one port per receive queue (or u32NumPorts) from u16BasePort up, so
+ * that receive side scaling spreads them over the queues too. The largest
+ * streams are placed first, each where it adds least to the load.
+ *
+ * RETURNS:
+ * bool_t TRUE if successful, FALSE if an interface wasn't found
+ *
+ ****************************************************************************/
+bool_t PLAN_bBalance(PLAN_tsInstance *psPlan, char *pcInterfaces, uint16_t u16BasePort, uint32_t u32NumPorts)
+{
+    int32_t ai32Nics[PLAN_MAX_LINKS];
+    uint32_t au32NumPorts[PLAN_MAX_LINKS];
+    uint32_t au32Load[PLAN_MAX_LINKS][PLAN_MAX_PORTS];
+    uint32_t au32Order[PLAN_MAX_STREAMS];
+    uint32_t u32NumNics = 0;
+    bool_t bCapacities = TRUE;
+    PLAN_tsStream *psStream;
+    PLAN_tsLink *psNic;
+    uint64_t u64Best;
+    uint64_t u64Cost;
+    uint32_t u32Nic;
+    uint32_t u32Port;
+    uint32_t n;
+    uint32_t i;
+    char *pcName;
+
+    for(pcName = strtok(pcInterfaces, ","); pcName != NULL; pcName = strtok(NULL, ","))
+    {
+        for(n = 0; n < psPlan->u32NumNics; n++)
+        {
+            if(strcmp(psPlan->asNics[n].acName, pcName) == 0)
+            {
+                break;
+            }
+        }
+        if(n == psPlan->u32NumNics)
+        {
+            printf("Error: Interface %s has no IPv4 address in %s\n", pcName, __FUNCTION__);
+            return FALSE;
+        }
+
+        psNic = &psPlan->asNics[n];
+        ai32Nics[u32NumNics] = (int32_t)n;
+        au32NumPorts[u32NumNics] = (u32NumPorts != 0) ? u32NumPorts : psNic->u32NumQueues;
+        if(au32NumPorts[u32NumNics] == 0)
+        {
+            au32NumPorts[u32NumNics] = 1;
+        }
+        else if(au32NumPorts[u32NumNics] > PLAN_MAX_PORTS)
+        {
+            au32NumPorts[u32NumNics] = PLAN_MAX_PORTS;
+        }
+        if((u16BasePort + (au32NumPorts[u32NumNics] * PLAN_PORT_STEP)) > 0xffff)
+        {
+            printf("Error: Base port %u leaves no room for %u ports in %s\n", u16BasePort, au32NumPorts[u32NumNics], __FUNCTION__);
+            return FALSE;
+        }
+        memset(au32Load[u32NumNics], 0, sizeof(au32Load[u32NumNics]));
+        bCapacities &= (psNic->u32CapacityMbps != 0);
+
+        if(++u32NumNics == PLAN_MAX_LINKS)
+        {
+            break;
+        }
+    }
+    if(u32NumNics == 0)
+    {
+        printf("Error: No interfaces to balance over in %s\n", __FUNCTION__);
+        return FALSE;
+    }
+
+    // Largest first, so the small streams even out what's left
+    for(n = 0; n < psPlan->u32NumStreams; n++)
+    {
+        for(i = n; (i > 0) && (psPlan->asStreams[au32Order[i - 1]].u32MaxBitrate < psPlan->asStreams[n].u32MaxBitrate); i--)
+        {
+            au32Order[i] = au32Order[i - 1];
+        }
+        au32Order[i] = n;
+    }
+
+    for(n = 0; n < psPlan->u32NumStreams; n++)
+    {
+        psStream = &psPlan->asStreams[au32Order[n]];
+
+        // The interface left least loaded relative to its speed, if every speed is known
+        u32Nic = 0;
+        u64Best = UINT64_MAX;
+        for(i = 0; i < u32NumNics; i++)
+        {
+            u64Cost = 0;
+            for(u32Port = 0; u32Port < au32NumPorts[i]; u32Port++)
+            {
+                u64Cost += au32Load[i][u32Port];
+            }
+            u64Cost = (u64Cost + psStream->u32MaxBitrate) * 1000000ULL;
+            if(bCapacities)
+            {
+                u64Cost /= psPlan->asNics[ai32Nics[i]].u32CapacityMbps;
+            }
+            if(u64Cost < u64Best)
+            {
+                u64Best = u64Cost;
+                u32Nic = i;
+            }
+        }
+
+        // And its least loaded port
+        u32Port = 0;
+        for(i = 1; i < au32NumPorts[u32Nic]; i++)
+        {
+            if(au32Load[u32Nic][i] < au32Load[u32Nic][u32Port])
+            {
+                u32Port = i;
+            }
+        }
+        au32Load[u32Nic][u32Port] += psStream->u32MaxBitrate;
+
+        psNic = &psPlan->asNics[ai32Nics[u32Nic]];
+        if((psStream->uDestinationIP.u32IP != psNic->uIP.u32IP) || (psStream->u16DestinationPort != (u16BasePort + (u32Port * PLAN_PORT_STEP))))
+        {
+            psStream->uDestinationIP = psNic->uIP;
+            psStream->u16DestinationPort = (uint16_t)(u16BasePort + (u32Port * PLAN_PORT_STEP));
+            psStream->bMoved = TRUE;
+        }
+        psStream->i32Nic = ai32Nics[u32Nic];
+    }
+
+    return TRUE;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: PLAN_u32GetMoves
+ *
+ * DESCRIPTION:
+ * Lists the destination address, hardware address and port register writes
+ * for every stream the balancer moved, one entry per camera
+ *
+ * RETURNS:
+ * uint32_t The number of cameras to write to
+ *
+ ****************************************************************************/
+uint32_t PLAN_u32GetMoves(PLAN_tsInstance *psPlan, ORLACO_tsRegisterWrite *psWrites)
+{
+    ORLACO_tsRegisterWrite *psWrite;
+    PLAN_tsStream *psStream;
+    uint32_t u32NumWrites = 0;
+    uint32_t n;
+    int i;
+
+    for(n = 0; n < psPlan->u32NumStreams; n++)
+    {
+        psStream = &psPlan->asStreams[n];
+        if(!psStream->bMoved)
+        {
+            continue;
+        }
+
+        psWrite = &psWrites[u32NumWrites++];
+        memset(psWrite, 0, sizeof(ORLACO_tsRegisterWrite));
+        psWrite->uIP = psStream->uCameraIP;
+
+        for(i = 0; i < 4; i++)
+        {
+            psWrite->au16Addresses[psWrite->u16NumRegisters] = E_ORLACO_REGISTER_ADDRESS_RTP_STREAM_DESTINATION_IP_ADDRESS_0 + i;
+            psWrite->au8Values[psWrite->u16NumRegisters++] = psStream->uDestinationIP.au8IP[3 - i];
+        }
+        for(i = 0; i < 6; i++)
+        {
+            psWrite->au16Addresses[psWrite->u16NumRegisters] = E_ORLACO_REGISTER_ADDRESS_RTP_STREAM_DESTINATION_MAC_ADDRESS_0 + i;
+            psWrite->au8Values[psWrite->u16NumRegisters++] = psPlan->asNics[psStream->i32Nic].au8Mac[i];
+        }
+        psWrite->au16Addresses[psWrite->u16NumRegisters] = E_ORLACO_REGISTER_ADDRESS_RTP_STREAM_DESTINATION_PORT_0;
+        psWrite->au8Values[psWrite->u16NumRegisters++] = (uint8_t)(psStream->u16DestinationPort >> 8);
+        psWrite->au16Addresses[psWrite->u16NumRegisters] = E_ORLACO_REGISTER_ADDRESS_RTP_STREAM_DESTINATION_PORT_1;
+        psWrite->au8Values[psWrite->u16NumRegisters++] = (uint8_t)(psStream->u16DestinationPort & 0xff);
+    }
+
+    return u32NumWrites;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: PLAN_vPrint
+ *
+ * DESCRIPTION:
+ * Prints each camera's stream, then the worst case load on each interface
+ * and destination they use
+ *
+ * RETURNS:
+ * void
+ *
+ ****************************************************************************/
+void PLAN_vPrint(PLAN_tsInstance *psPlan, bool_t bNdjson)
+{
+    PLAN_tsStream *psStream;
+    char acCamera[16];
+    char acDestination[16];
+    uint32_t n;
+
+    if(!bNdjson)
+    {
+        printf("\nStream plan\nCamera\t\tROI\tMbps\tDestination\t\tInterface\n");
+    }
+    for(n = 0; n < psPlan->u32NumStreams; n++)
+    {
+        psStream = &psPlan->asStreams[n];
+        sprintf(acCamera, "%d.%d.%d.%d", psStream->uCameraIP.au8IP[3], psStream->uCameraIP.au8IP[2], psStream->uCameraIP.au8IP[1], psStream->uCameraIP.au8IP[0]);
+        sprintf(acDestination, "%d.%d.%d.%d", psStream->uDestinationIP.au8IP[3], psStream->uDestinationIP.au8IP[2], psStream->uDestinationIP.au8IP[1], psStream->uDestinationIP.au8IP[0]);
+
+        if(bNdjson)
+        {
+            printf("{\"plan\":\"stream\",\"camera\":\"%s\",\"roi\":%u,\"max_mbps\":%u,\"destination\":\"%s:%u\",\"interface\":\"%s\",\"pending\":%s,\"moved\":%s}\n",
+                   acCamera, psStream->u8RegionOfInterest, psStream->u32MaxBitrate, acDestination, psStream->u16DestinationPort,
+                   (psStream->i32Nic >= 0) ? psPlan->asNics[psStream->i32Nic].acName : "",
+                   psStream->bPending ? "true" : "false",
+                   psStream->bMoved ? "true" : "false");
+        }
+        else
+        {
+            printf("%-15s\t%u\t%u\t%s:%-5u\t%s%s\n",
+                   acCamera, psStream->u8RegionOfInterest, psStream->u32MaxBitrate, acDestination, psStream->u16DestinationPort,
+                   (psStream->i32Nic >= 0) ? psPlan->asNics[psStream->i32Nic].acName : "-",
+                   psStream->bMoved ? "\t(moved)" : (psStream->bPending ? "\t(pending)" : ""));
+        }
+    }
+
+    if(!bNdjson)
+    {
+        printf("\nLink\t\t\tStreams\tWorst case\tCapacity\tLoad\n");
+    }
+    for(n = 0; n < psPlan->u32NumNics; n++)
+    {
+        if(psPlan->asNics[n].u32NumStreams > 0)
+        {
+            PLAN_vPrintLink(&psPlan->asNics[n], "interface", bNdjson);
+        }
+    }
+    for(n = 0; n < psPlan->u32NumDestinations; n++)
+    {
+        PLAN_vPrintLink(&psPlan->asDestinations[n], "destination", bNdjson);
+    }
+}
+
+/****************************************************************************/
+/***        Local Functions                                               ***/
+/****************************************************************************/
+
+/****************************************************************************
+ *
+ * NAME: PLAN_vFindNics
+ *
+ * DESCRIPTION:
+ * Lists the IPv4 addresses of the local interfaces and their link speeds
+ *
+ * RETURNS:
+ * void
+ *
+ ****************************************************************************/
+static void PLAN_vFindNics(PLAN_tsInstance *psPlan)
+{
+#ifndef _WIN32
+    struct ifaddrs *psAddrs;
+    struct ifaddrs *psAddr;
+    PLAN_tsLink *psNic;
+
+    if(getifaddrs(&psAddrs) != 0)
+    {
+        printf("Warning: Couldn't list the network interfaces, only destinations will be planned\n");
+        return;
+    }
+
+    for(psAddr = psAddrs; psAddr != NULL; psAddr = psAddr->ifa_next)
+    {
+        if((psAddr->ifa_addr == NULL) || (psAddr->ifa_netmask == NULL) || (psAddr->ifa_addr->sa_family != AF_INET) ||
+           !(psAddr->ifa_flags & IFF_UP) || (psPlan->u32NumNics >= PLAN_MAX_LINKS))
+        {
+            continue;
+        }
+
+        psNic = &psPlan->asNics[psPlan->u32NumNics++];
+        snprintf(psNic->acName, sizeof(psNic->acName), "%s", psAddr->ifa_name);
+        psNic->uIP.u32IP = ntohl(((struct sockaddr_in *)psAddr->ifa_addr)->sin_addr.s_addr);
+        psNic->uMask.u32IP = ntohl(((struct sockaddr_in *)psAddr->ifa_netmask)->sin_addr.s_addr);
+        psNic->u32CapacityMbps = (psPlan->u32CapacityMbps != 0) ? psPlan->u32CapacityMbps : PLAN_u32GetLinkSpeed(psAddr->ifa_name);
+        PLAN_vGetNicDetails(psNic);
+    }
+
+    freeifaddrs(psAddrs);
+#else
+    (void)psPlan;
+#endif
+}
+
+
+/****************************************************************************
+ *
+ * NAME: PLAN_u32GetLinkSpeed
+ *
+ * DESCRIPTION:
+ * Reads the negotiated speed of an interface
+ *
+ * RETURNS:
+ * uint32_t The speed in Megabits per second, zero if unknown
+ *
+ ****************************************************************************/
+static uint32_t PLAN_u32GetLinkSpeed(const char *pcInterface)
+{
+    char acPath[64];
+    FILE *psFile;
+    int iSpeed = 0;
+
+    snprintf(acPath, sizeof(acPath), "/sys/class/net/%s/speed", pcInterface);
+
+    // Virtual interfaces have no speed, or report -1
+    psFile = fopen(acPath, "r");
+    if(psFile == NULL)
+    {
+        return 0;
+    }
+    if(fscanf(psFile, "%d", &iSpeed) != 1)
+    {
+        iSpeed = 0;
+    }
+    fclose(psFile);
+
+    return (iSpeed > 0) ? (uint32_t)iSpeed : 0;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: PLAN_vGetNicDetails
+ *
+ * DESCRIPTION:
+ * Reads the hardware address of an interface and how many receive queues
+ * it has
+ *
+ * RETURNS:
+ * void
+ *
+ ****************************************************************************/
+static void PLAN_vGetNicDetails(PLAN_tsLink *psNic)
+{
+#ifndef _WIN32
+    unsigned int auMac[6];
+    struct dirent *psEntry;
+    char acPath[80];
+    FILE *psFile;
+    DIR *psDir;
+    int n;
+
+    snprintf(acPath, sizeof(acPath), "/sys/class/net/%s/address", psNic->acName);
+    psFile = fopen(acPath, "r");
+    if(psFile != NULL)
+    {
+        if(fscanf(psFile, "%x:%x:%x:%x:%x:%x", &auMac[0], &auMac[1], &auMac[2], &auMac[3], &auMac[4], &auMac[5]) == 6)
+        {
+            for(n = 0; n < 6; n++)
+            {
+                psNic->au8Mac[n] = (uint8_t)auMac[n];
+            }
+        }
+        fclose(psFile);
+    }
+
+    snprintf(acPath, sizeof(acPath), "/sys/class/net/%s/queues", psNic->acName);
+    psDir = opendir(acPath);
+    if(psDir != NULL)
+    {
+        while((psEntry = readdir(psDir)) != NULL)
+        {
+            if(strncmp(psEntry->d_name, "rx-", 3) == 0)
+            {
+                psNic->u32NumQueues++;
+            }
+        }
+        closedir(psDir);
+    }
+#else
+    (void)psNic;
+#endif
+}
+
+
+/****************************************************************************
+ *
+ * NAME: PLAN_i32FindNic
+ *
+ * DESCRIPTION:
+ * Finds the local interface on the same subnet as an address
+ *
+ * RETURNS:
+ * int32_t Index of the interface, -1 if there's none
+ *
+ ****************************************************************************/
+static int32_t PLAN_i32FindNic(PLAN_tsInstance *psPlan, ORLACO_tuIP uIP)
+{
+    PLAN_tsLink *psNic;
+    uint32_t n;
+
+    for(n = 0; n < psPlan->u32NumNics; n++)
+    {
+        psNic = &psPlan->asNics[n];
+        if((uIP.u32IP & psNic->uMask.u32IP) == (psNic->uIP.u32IP & psNic->uMask.u32IP))
+        {
+            return (int32_t)n;
+        }
+    }
+
+    return -1;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: PLAN_psGetDestination
+ *
+ * DESCRIPTION:
+ * Finds the destination a stream is sent to, adding it if it's new. A
+ * destination has the capacity of the interface it's reached through.
+ *
+ * RETURNS:
+ * PLAN_tsLink * The destination, NULL if there are too many
+ *
+ ****************************************************************************/
+static PLAN_tsLink *PLAN_psGetDestination(PLAN_tsInstance *psPlan, PLAN_tsStream *psStream)
+{
+    PLAN_tsLink *psLink;
+    uint32_t n;
+
+    for(n = 0; n < psPlan->u32NumDestinations; n++)
+    {
+        psLink = &psPlan->asDestinations[n];
+        if((psLink->uIP.u32IP == psStream->uDestinationIP.u32IP) && (psLink->u16Port == psStream->u16DestinationPort))
+        {
+            return psLink;
+        }
+    }
+
+    if(psPlan->u32NumDestinations >= PLAN_MAX_LINKS)
+    {
+        return NULL;
+    }
+
+    psLink = &psPlan->asDestinations[psPlan->u32NumDestinations++];
+    memset(psLink, 0, sizeof(PLAN_tsLink));
+    snprintf(psLink->acName, sizeof(psLink->acName), "%d.%d.%d.%d:%u",
+             psStream->uDestinationIP.au8IP[3], psStream->uDestinationIP.au8IP[2], psStream->uDestinationIP.au8IP[1], psStream->uDestinationIP.au8IP[0],
+             psStream->u16DestinationPort);
+    psLink->uIP = psStream->uDestinationIP;
+    psLink->u16Port = psStream->u16DestinationPort;
+    psLink->u32CapacityMbps = (psStream->i32Nic >= 0) ? psPlan->asNics[psStream->i32Nic].u32CapacityMbps : psPlan->u32CapacityMbps;
+
+    return psLink;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: PLAN_vCheck
+ *
+ * DESCRIPTION:
+ * Counts a link that can't carry its worst case, or whose capacity is unknown
+ *
+ * RETURNS:
+ * void
+ *
+ ****************************************************************************/
+static void PLAN_vCheck(PLAN_tsInstance *psPlan, PLAN_tsLink *psLink)
+{
+    if(psLink->u32CapacityMbps == 0)
+    {
+        psPlan->u32Unknown++;
+    }
+    else if(psLink->u64WorstCaseKbps > (uint64_t)psLink->u32CapacityMbps * 1000)
+    {
+        psPlan->u32Oversubscribed++;
+    }
+}
+
+
+/****************************************************************************
+ *
+ * NAME: PLAN_vPrintLink
+ *
+ * DESCRIPTION:
+ * Prints the worst case load on a link, and warns if it leaves too little
+ * headroom or exceeds the link's capacity
+ *
+ * RETURNS:
+ * void
+ *
+ ****************************************************************************/
+static void PLAN_vPrintLink(PLAN_tsLink *psLink, const char *pcType, bool_t bNdjson)
+{
+    uint32_t u32LoadPercent = 0;
+
+    if(psLink->u32CapacityMbps != 0)
+    {
+        u32LoadPercent = (uint32_t)((psLink->u64WorstCaseKbps + (psLink->u32CapacityMbps * 10ULL) - 1) / (psLink->u32CapacityMbps * 10ULL));
+    }
+
+    if(bNdjson)
+    {
+        printf("{\"plan\":\"%s\",\"link\":\"%s\",\"streams\":%u,\"worst_case_mbps\":%.1f,\"capacity_mbps\":%u,\"load_pct\":%u}\n",
+               pcType, psLink->acName, psLink->u32NumStreams, psLink->u64WorstCaseKbps / 1000.0, psLink->u32CapacityMbps, u32LoadPercent);
+        return;
+    }
+
+    if(psLink->u32CapacityMbps != 0)
+    {
+        printf("%-23s\t%u\t%.1fMbps\t%uMbps\t\t%u%%\n", psLink->acName, psLink->u32NumStreams, psLink->u64WorstCaseKbps / 1000.0, psLink->u32CapacityMbps, u32LoadPercent);
+    }
+    else
+    {
+        printf("%-23s\t%u\t%.1fMbps\t-\t\t-\n", psLink->acName, psLink->u32NumStreams, psLink->u64WorstCaseKbps / 1000.0);
+    }
+
+    if(psLink->u32CapacityMbps == 0)
+    {
+        return;
+    }
+    if(u32LoadPercent > 100)
+    {
+        printf("Warning: %s %s is oversubscribed, its streams could need up to %.1fMbps of %uMbps\n", pcType, psLink->acName, psLink->u64WorstCaseKbps / 1000.0, psLink->u32CapacityMbps);
+    }
+    else if(u32LoadPercent > PLAN_WARN_PERCENT)
+    {
+        printf("Warning: %s %s has little headroom, its streams could need up to %u%% of it\n", pcType, psLink->acName, u32LoadPercent);
+    }
+}
+
+/****************************************************************************/
+/***        END OF FILE                                                   ***/
+/****************************************************************************/
@@ -0,0 +1,82 @@
+#ifndef PLAN_H
+#define PLAN_H
+
+/****************************************************************************/
+/***        Include files                                                 ***/
+/****************************************************************************/
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "common.h"
+#include "orlaco.h"
+
+/****************************************************************************/
+/***        Macro Definitions                                             ***/
+/****************************************************************************/
+
+#define PLAN_MAX_STREAMS                64
+#define PLAN_MAX_LINKS                  (PLAN_MAX_STREAMS * 2)
+#define PLAN_OVERHEAD_PERCENT           4                   // RTP, UDP, IP and Ethernet headers on full size packets
+#define PLAN_WARN_PERCENT               80                  // Load above which a link is reported as short of headroom
+#define PLAN_MAX_NAME_LENGTH            32
+#define PLAN_MAX_PORTS                  16                  // Destination ports per interface when balancing
+#define PLAN_PORT_STEP                  2                   // Leaves the odd port above each RTP port for RTCP
+
+/****************************************************************************/
+/***        Type Definitions                                              ***/
+/****************************************************************************/
+
+// What one camera will send once the pending register and ROI writes are applied
+typedef struct {
+    ORLACO_tuIP uCameraIP;
+    uint8_t u8RegionOfInterest;                     // The selected ROI
+    uint32_t u32MaxBitrate;                         // Of the selected ROI, in Megabits per second
+    ORLACO_tuIP uDestinationIP;
+    uint16_t u16DestinationPort;
+    bool_t bPending;                                // Some of it comes from writes not applied yet
+    bool_t bMoved;                                  // Given a new destination by the balancer
+    int32_t i32Nic;                                 // Index of the local interface it arrives on, -1 if none
+} PLAN_tsStream;
+
+// A local interface or a destination address, and the streams converging on it
+typedef struct {
+    char acName[PLAN_MAX_NAME_LENGTH];
+    ORLACO_tuIP uIP;                                // Interface or destination address
+    ORLACO_tuIP uMask;                              // Interface network mask, zero for destinations
+    uint16_t u16Port;                               // Destination port, zero for interfaces
+    uint8_t au8Mac[6];                              // Interface hardware address
+    uint32_t u32NumQueues;                          // Interface receive queues, zero if unknown
+    uint32_t u32CapacityMbps;                       // Zero if unknown
+    uint32_t u32NumStreams;
+    uint64_t u64WorstCaseKbps;                      // Every stream at its ROI's maximum bitrate, with overheads
+} PLAN_tsLink;
+
+typedef struct {
+    PLAN_tsStream asStreams[PLAN_MAX_STREAMS];
+    uint32_t u32NumStreams;
+    PLAN_tsLink asNics[PLAN_MAX_LINKS];
+    uint32_t u32NumNics;
+    PLAN_tsLink asDestinations[PLAN_MAX_LINKS];
+    uint32_t u32NumDestinations;
+    uint32_t u32CapacityMbps;                       // Assumed for every link, zero to use each interface's link speed
+    uint32_t u32Oversubscribed;                     // Links whose worst case exceeds their capacity
+    uint32_t u32Unknown;                            // Links whose capacity isn't known
+} PLAN_tsInstance;
+
+/****************************************************************************/
+/***        Exported Functions                                            ***/
+/****************************************************************************/
+
+bool_t PLAN_bInit(PLAN_tsInstance *psPlan, uint32_t u32CapacityMbps);
+bool_t PLAN_bAddCamera(PLAN_tsInstance *psPlan, ORLACO_tsInstance *psOrlaco, ORLACO_tuIP uCameraIP, bool_t bPending);
+bool_t PLAN_bEvaluate(PLAN_tsInstance *psPlan);
+bool_t PLAN_bBalance(PLAN_tsInstance *psPlan, char *pcInterfaces, uint16_t u16BasePort, uint32_t u32NumPorts);
+uint32_t PLAN_u32GetMoves(PLAN_tsInstance *psPlan, ORLACO_tsRegisterWrite *psWrites);
+void PLAN_vPrint(PLAN_tsInstance *psPlan, bool_t bNdjson);
+
+#endif // PLAN_H
+
+/****************************************************************************/
+/***        END OF FILE                                                   ***/
+/****************************************************************************/
@@ -0,0 +1,643 @@
+/****************************************************************************
+ *
+ * Copyright 2021 Lee Mitchell <lee@indigopepper.com>
+ * This file is part of OCC (Orlaco Camera Configurator)
+ *
+ * OCC (Orlaco Camera Configurator) is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * OCC (Orlaco Camera Configurator) is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with OCC (Orlaco Camera Configurator).  If not,
+ * see <http://www.gnu.org/licenses/>.
+ *
+ ****************************************************************************/
+
+/****************************************************************************/
+/***        Include files                                                 ***/
+/****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "common.h"
+#include "mjpeg.h"
+#include "prering.h"
+
+#include <sys/stat.h>
+
+#ifndef _WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#endif
+
+/****************************************************************************/
+/***        Macro Definitions                                             ***/
+/****************************************************************************/
+
+#define PRERING_DUMP_SEGMENT_SECONDS    (24 * 60 * 60)      // Long enough that a dump is always a single segment
+#define PRERING_MAX_COMMAND_LENGTH      64
+
+/****************************************************************************/
+/***        Type Definitions                                              ***/
+/****************************************************************************/
+
+/****************************************************************************/
+/***        Local Function Prototypes                                     ***/
+/****************************************************************************/
+
+static bool_t PRERING_bStore(PRERING_tsInstance *psRing, RTP_tsFrame *psFrame);
+static MP4_tsRecorder *PRERING_psGetRecorder(PRERING_tsInstance *psRing, uint32_t u32Ssrc);
+static void PRERING_vFinishDump(PRERING_tsInstance *psRing);
+
+/****************************************************************************/
+/***        Exported Variables                                            ***/
+/****************************************************************************/
+
+/****************************************************************************/
+/***        Local Variables                                               ***/
+/****************************************************************************/
+
+/****************************************************************************/
+/***        Exported Functions                                            ***/
+/****************************************************************************/
+
+/****************************************************************************
+ *
+ * NAME: PRERING_bInit
+ *
+ * DESCRIPTION:
+ * Allocates a history of u64DataLength bytes of frames, of which the last
+ * u32Seconds are dumped when triggered. The memory is touched up front so
+ * that it is really there, and the ring never grows.
+ *
+ * RETURNS:
+ * bool_t TRUE if successful, FALSE otherwise
+ *
+ ****************************************************************************/
+bool_t PRERING_bInit(PRERING_tsInstance *psRing, uint64_t u64DataLength, uint32_t u32Seconds)
+{
+    memset(psRing, 0, sizeof(PRERING_tsInstance));
+#ifndef _WIN32
+    pthread_mutex_init(&psRing->sLock, NULL);
+#endif
+    psRing->u64DataLength = (u64DataLength != 0) ? u64DataLength : PRERING_DEFAULT_DATA_LENGTH;
+    psRing->u32Seconds = (u32Seconds != 0) ? u32Seconds : PRERING_DEFAULT_SECONDS;
+    psRing->u32MaxFrames = (psRing->u32Seconds + PRERING_MAX_GOP_SECONDS) * PRERING_MAX_FRAME_RATE;
+
+    psRing->pu8Data = (uint8_t*)malloc((size_t)psRing->u64DataLength);
+    psRing->psFrames = (PRERING_tsFrame*)malloc(psRing->u32MaxFrames * sizeof(PRERING_tsFrame));
+    if((psRing->pu8Data == NULL) || (psRing->psFrames == NULL))
+    {
+        printf("Error: Failed to allocate memory for pre-event ring in %s\n", __FUNCTION__);
+        PRERING_vDeInit(psRing);
+        return FALSE;
+    }
+    memset(psRing->pu8Data, 0, (size_t)psRing->u64DataLength);
+    memset(psRing->psFrames, 0, psRing->u32MaxFrames * sizeof(PRERING_tsFrame));
+
+    return TRUE;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: PRERING_vDeInit
+ *
+ * DESCRIPTION:
+ * Completes any dump in progress and frees the ring
+ *
+ * RETURNS:
+ * void
+ *
+ ****************************************************************************/
+void PRERING_vDeInit(PRERING_tsInstance *psRing)
+{
+    while(psRing->bDumping && PRERING_bContinueDump(psRing, PRERING_DUMP_CHUNK_LENGTH));
+
+    if(psRing->pu8Data != NULL)
+    {
+        free(psRing->pu8Data);
+        psRing->pu8Data = NULL;
+    }
+    if(psRing->psFrames != NULL)
+    {
+        free(psRing->psFrames);
+        psRing->psFrames = NULL;
+    }
+#ifndef _WIN32
+    pthread_mutex_destroy(&psRing->sLock);
+#endif
+}
+
+
+/****************************************************************************
+ *
+ * NAME: PRERING_bPush
+ *
+ * DESCRIPTION:
+ * Stores a frame, evicting the oldest frames to make room. Frames that a
+ * dump in progress has yet to write are never evicted, the new frame is
+ * dropped instead. Called from the worker that owns the stream, a camera's
+ * streams may be spread over several workers.
+ *
+ * RETURNS:
+ * bool_t TRUE if the frame was stored, FALSE otherwise
+ *
+ ****************************************************************************/
+bool_t PRERING_bPush(PRERING_tsInstance *psRing, RTP_tsFrame *psFrame)
+{
+    bool_t bStored;
+
+#ifndef _WIN32
+    pthread_mutex_lock(&psRing->sLock);
+#endif
+    bStored = PRERING_bStore(psRing, psFrame);
+#ifndef _WIN32
+    pthread_mutex_unlock(&psRing->sLock);
+#endif
+
+    return bStored;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: PRERING_bStartDump
+ *
+ * DESCRIPTION:
+ * Starts writing the frames held from the last key frame at least
+ * u32Seconds before the newest one, or the oldest key frame if the ring
+ * doesn't reach back that far. Frames arriving afterwards aren't included.
+ * H.264 is written as MP4 <prefix>_<ip>_<ssrc>_000000.mp4, JPEG as
+ * <prefix>_<ip>_<ssrc>_<number>.jpg.
+ *
+ * RETURNS:
+ * bool_t TRUE if a dump was started, FALSE otherwise
+ *
+ ****************************************************************************/
+bool_t PRERING_bStartDump(PRERING_tsInstance *psRing, char *pcPrefix)
+{
+    PRERING_tsFrame *psFrame;
+    uint64_t u64CutoffUs;
+    uint64_t u64Start;
+    uint64_t u64Seq;
+
+    if(psRing->bDumping)
+    {
+        return FALSE;
+    }
+
+#ifndef _WIN32
+    pthread_mutex_lock(&psRing->sLock);
+#endif
+    u64Start = psRing->u64Head;
+    if(psRing->u64Head != psRing->u64Tail)
+    {
+        u64CutoffUs = psRing->psFrames[(psRing->u64Head - 1) % psRing->u32MaxFrames].u64ArrivalTimeUs;
+        u64CutoffUs = (u64CutoffUs > (uint64_t)psRing->u32Seconds * 1000000ULL) ? (u64CutoffUs - (uint64_t)psRing->u32Seconds * 1000000ULL) : 0;
+
+        for(u64Seq = psRing->u64Tail; u64Seq < psRing->u64Head; u64Seq++)
+        {
+            psFrame = &psRing->psFrames[u64Seq % psRing->u32MaxFrames];
+            if(!psFrame->bKeyFrame)
+            {
+                continue;
+            }
+            if((u64Start == psRing->u64Head) || (psFrame->u64ArrivalTimeUs <= u64CutoffUs))
+            {
+                u64Start = u64Seq;
+            }
+            else
+            {
+                break;
+            }
+        }
+    }
+    if(u64Start != psRing->u64Head)
+    {
+        psRing->u64DumpSeq = u64Start;
+        psRing->u64DumpEnd = psRing->u64Head;
+        psRing->bDumping = TRUE;
+    }
+#ifndef _WIN32
+    pthread_mutex_unlock(&psRing->sLock);
+#endif
+
+    if(!psRing->bDumping)
+    {
+        return FALSE;
+    }
+
+    snprintf(psRing->acPrefix, sizeof(psRing->acPrefix), "%s", pcPrefix);
+    psRing->u32DumpFrames = 0;
+
+    return TRUE;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: PRERING_bContinueDump
+ *
+ * DESCRIPTION:
+ * Writes about u32MaxLength bytes of the dump in progress. Frames are
+ * written without holding the lock, a frame stays pinned until u64DumpSeq
+ * moves past it. Each H.264 stream of the camera goes to its own file.
+ *
+ * RETURNS:
+ * bool_t TRUE if there is more to write, FALSE once the dump is complete
+ *
+ ****************************************************************************/
+bool_t PRERING_bContinueDump(PRERING_tsInstance *psRing, uint32_t u32MaxLength)
+{
+    PRERING_tsFrame sSlot;
+    RTP_tsFrame sFrame;
+    MP4_tsRecorder *psRecorder;
+    uint32_t u32Written = 0;
+
+    if(!psRing->bDumping)
+    {
+        return FALSE;
+    }
+
+    while((psRing->u64DumpSeq < psRing->u64DumpEnd) && (u32Written < u32MaxLength))
+    {
+#ifndef _WIN32
+        pthread_mutex_lock(&psRing->sLock);
+#endif
+        memcpy(&sSlot, &psRing->psFrames[psRing->u64DumpSeq % psRing->u32MaxFrames], sizeof(PRERING_tsFrame));
+#ifndef _WIN32
+        pthread_mutex_unlock(&psRing->sLock);
+#endif
+
+        memset(&sFrame, 0, sizeof(RTP_tsFrame));
+        sFrame.eCodec = (RTP_teCodec)sSlot.u8Codec;
+        sFrame.uSrcIP = sSlot.uSrcIP;
+        sFrame.u32Ssrc = sSlot.u32Ssrc;
+        sFrame.u32Timestamp = sSlot.u32Timestamp;
+        sFrame.u64FirstPacketTimeUs = sSlot.u64ArrivalTimeUs;
+        sFrame.u64ArrivalTimeUs = sSlot.u64ArrivalTimeUs;
+        sFrame.u16Width = sSlot.u16Width;
+        sFrame.u16Height = sSlot.u16Height;
+        sFrame.bKeyFrame = sSlot.bKeyFrame;
+        sFrame.u32Length = sSlot.u32Length;
+        sFrame.pu8Data = psRing->pu8Data + (sSlot.u64DataPos % psRing->u64DataLength);
+
+        switch(sFrame.eCodec)
+        {
+        case E_RTP_CODEC_H264:
+            psRecorder = PRERING_psGetRecorder(psRing, sFrame.u32Ssrc);
+            if(psRecorder != NULL)
+            {
+                MP4_bPushFrame(psRecorder, &sFrame);
+            }
+            break;
+
+        case E_RTP_CODEC_JPEG:
+            MJPEG_bWriteFrameToFile(&sFrame, psRing->acPrefix, psRing->u32DumpFrames);
+            break;
+
+        default:
+            break;
+        }
+
+        u32Written += sFrame.u32Length;
+        psRing->u32DumpFrames++;
+
+#ifndef _WIN32
+        pthread_mutex_lock(&psRing->sLock);
+#endif
+        psRing->u64DumpSeq++;
+#ifndef _WIN32
+        pthread_mutex_unlock(&psRing->sLock);
+#endif
+    }
+
+    if(psRing->u64DumpSeq < psRing->u64DumpEnd)
+    {
+        return TRUE;
+    }
+
+    PRERING_vFinishDump(psRing);
+
+    return FALSE;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: PRERING_bOpenTrigger
+ *
+ * DESCRIPTION:
+ * Prepares the trigger sources. A trigger file that already exists only
+ * triggers once it is touched again. The socket is created afresh.
+ *
+ * RETURNS:
+ * bool_t TRUE if successful, FALSE otherwise
+ *
+ ****************************************************************************/
+bool_t PRERING_bOpenTrigger(PRERING_tsTrigger *psTrigger, char *pcFile, char *pcSocket)
+{
+    struct stat sStat;
+
+    memset(psTrigger, 0, sizeof(PRERING_tsTrigger));
+    psTrigger->pcFile = pcFile;
+    psTrigger->pcSocket = pcSocket;
+    psTrigger->iSocket = -1;
+
+    if((pcFile != NULL) && (stat(pcFile, &sStat) == 0))
+    {
+        psTrigger->bFileExists = TRUE;
+        psTrigger->tFileModified = sStat.st_mtime;
+    }
+
+    if(pcSocket == NULL)
+    {
+        return TRUE;
+    }
+
+#ifdef _WIN32
+    printf("Error: Trigger sockets aren't supported on this platform\n");
+    return FALSE;
+#else
+    {
+        struct sockaddr_un sAddr;
+
+        if(strlen(pcSocket) >= sizeof(sAddr.sun_path))
+        {
+            printf("Error: Socket path %s is too long in %s\n", pcSocket, __FUNCTION__);
+            return FALSE;
+        }
+
+        psTrigger->iSocket = socket(AF_UNIX, SOCK_DGRAM, 0);
+        if(psTrigger->iSocket < 0)
+        {
+            printf("Error: Failed to create socket in %s\n", __FUNCTION__);
+            return FALSE;
+        }
+        fcntl(psTrigger->iSocket, F_SETFL, fcntl(psTrigger->iSocket, F_GETFL) | O_NONBLOCK);
+
+        memset(&sAddr, 0, sizeof(sAddr));
+        sAddr.sun_family = AF_UNIX;
+        strcpy(sAddr.sun_path, pcSocket);
+        unlink(pcSocket);
+        if(bind(psTrigger->iSocket, (struct sockaddr*)&sAddr, sizeof(sAddr)) < 0)
+        {
+            printf("Error: Failed to bind %s in %s\n", pcSocket, __FUNCTION__);
+            close(psTrigger->iSocket);
+            psTrigger->iSocket = -1;
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+#endif
+}
+
+
+/****************************************************************************
+ *
+ * NAME: PRERING_bCheckTrigger
+ *
+ * DESCRIPTION:
+ * Checks the trigger sources, at most every PRERING_TRIGGER_CHECK_MS
+ *
+ * RETURNS:
+ * bool_t TRUE if a dump was requested, FALSE otherwise
+ *
+ ****************************************************************************/
+bool_t PRERING_bCheckTrigger(PRERING_tsTrigger *psTrigger, uint64_t u64TimeUs)
+{
+    bool_t bTriggered = FALSE;
+    struct stat sStat;
+
+    if(u64TimeUs < psTrigger->u64NextCheckUs)
+    {
+        return FALSE;
+    }
+    psTrigger->u64NextCheckUs = u64TimeUs + PRERING_TRIGGER_CHECK_MS * 1000ULL;
+
+    if(psTrigger->pcFile != NULL)
+    {
+        if(stat(psTrigger->pcFile, &sStat) == 0)
+        {
+            if(!psTrigger->bFileExists || (sStat.st_mtime != psTrigger->tFileModified))
+            {
+                bTriggered = TRUE;
+            }
+            psTrigger->bFileExists = TRUE;
+            psTrigger->tFileModified = sStat.st_mtime;
+        }
+        else
+        {
+            psTrigger->bFileExists = FALSE;
+        }
+    }
+
+#ifndef _WIN32
+    if(psTrigger->iSocket >= 0)
+    {
+        char acCommand[PRERING_MAX_COMMAND_LENGTH];
+        int iLen;
+
+        while((iLen = (int)recv(psTrigger->iSocket, acCommand, sizeof(acCommand) - 1, 0)) > 0)
+        {
+            acCommand[iLen] = '\0';
+            if(strncmp(acCommand, "dump", 4) == 0)
+            {
+                bTriggered = TRUE;
+            }
+            else
+            {
+                printf("Warning: Unknown trigger command %s\n", acCommand);
+            }
+        }
+    }
+#endif
+
+    return bTriggered;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: PRERING_vCloseTrigger
+ *
+ * DESCRIPTION:
+ * Closes and removes the trigger socket
+ *
+ * RETURNS:
+ * void
+ *
+ ****************************************************************************/
+void PRERING_vCloseTrigger(PRERING_tsTrigger *psTrigger)
+{
+#ifndef _WIN32
+    // Also called on a trigger that was never opened and is all zeros
+    if((psTrigger->pcSocket != NULL) && (psTrigger->iSocket >= 0))
+    {
+        close(psTrigger->iSocket);
+        unlink(psTrigger->pcSocket);
+        psTrigger->iSocket = -1;
+    }
+#else
+    (void)psTrigger;
+#endif
+}
+
+/****************************************************************************/
+/***        Local Functions                                               ***/
+/****************************************************************************/
+
+/****************************************************************************
+ *
+ * NAME: PRERING_bStore
+ *
+ * DESCRIPTION:
+ * Stores a frame with the ring's lock held
+ *
+ * RETURNS:
+ * bool_t TRUE if the frame was stored, FALSE otherwise
+ *
+ ****************************************************************************/
+static bool_t PRERING_bStore(PRERING_tsInstance *psRing, RTP_tsFrame *psFrame)
+{
+    PRERING_tsFrame *psSlot;
+    uint64_t u64Pos = psRing->u64WritePos;
+    uint64_t u64Offset;
+
+    if((uint64_t)psFrame->u32Length > psRing->u64DataLength / 2)
+    {
+        psRing->u64Dropped++;
+        return FALSE;
+    }
+
+    // Frames are stored contiguously, skipping the end of the data area if the frame doesn't fit
+    u64Offset = u64Pos % psRing->u64DataLength;
+    if(u64Offset + psFrame->u32Length > psRing->u64DataLength)
+    {
+        u64Pos += psRing->u64DataLength - u64Offset;
+        u64Offset = 0;
+    }
+
+    while((psRing->u64Tail < psRing->u64Head) &&
+          ((psRing->u64Head - psRing->u64Tail >= psRing->u32MaxFrames) ||
+           (psRing->psFrames[psRing->u64Tail % psRing->u32MaxFrames].u64DataPos + psRing->u64DataLength < u64Pos + psFrame->u32Length)))
+    {
+        if(psRing->bDumping && (psRing->u64Tail >= psRing->u64DumpSeq))
+        {
+            psRing->u64Dropped++;
+            return FALSE;
+        }
+        psRing->u64Tail++;
+        psRing->u64Evicted++;
+    }
+
+    memcpy(psRing->pu8Data + u64Offset, psFrame->pu8Data, psFrame->u32Length);
+
+    psSlot = &psRing->psFrames[psRing->u64Head % psRing->u32MaxFrames];
+    psSlot->u64DataPos = u64Pos;
+    psSlot->u64ArrivalTimeUs = psFrame->u64ArrivalTimeUs;
+    psSlot->u32Length = psFrame->u32Length;
+    psSlot->u32Timestamp = psFrame->u32Timestamp;
+    psSlot->u32Ssrc = psFrame->u32Ssrc;
+    psSlot->uSrcIP = psFrame->uSrcIP;
+    psSlot->u16Width = psFrame->u16Width;
+    psSlot->u16Height = psFrame->u16Height;
+    psSlot->u8Codec = (uint8_t)psFrame->eCodec;
+    psSlot->bKeyFrame = psFrame->bKeyFrame;
+
+    psRing->u64WritePos = u64Pos + psFrame->u32Length;
+    psRing->u64Head++;
+
+    return TRUE;
+}
+
+/****************************************************************************
+ *
+ * NAME: PRERING_psGetRecorder
+ *
+ * DESCRIPTION:
+ * Finds the recorder of a stream in the dump, opening one if it hasn't
+ * been seen yet. A camera restart changes the SSRC and the timestamps, so
+ * it starts a new file. With more streams than recorders the oldest
+ * recorder is closed.
+ *
+ * RETURNS:
+ * MP4_tsRecorder * of the stream, NULL if one couldn't be opened
+ *
+ ****************************************************************************/
+static MP4_tsRecorder *PRERING_psGetRecorder(PRERING_tsInstance *psRing, uint32_t u32Ssrc)
+{
+    uint32_t n;
+
+    for(n = 0; n < PRERING_MAX_DUMP_STREAMS; n++)
+    {
+        if(psRing->abRecorders[n] && (psRing->au32RecorderSsrcs[n] == u32Ssrc))
+        {
+            return &psRing->asRecorders[n];
+        }
+    }
+
+    for(n = 0; (n < PRERING_MAX_DUMP_STREAMS) && psRing->abRecorders[n]; n++);
+    if(n == PRERING_MAX_DUMP_STREAMS)
+    {
+        n = psRing->u32NextRecorder;
+        psRing->u32NextRecorder = (n + 1) % PRERING_MAX_DUMP_STREAMS;
+        MP4_vDeInit(&psRing->asRecorders[n]);
+    }
+
+    psRing->abRecorders[n] = MP4_bInit(&psRing->asRecorders[n], psRing->acPrefix, PRERING_DUMP_SEGMENT_SECONDS, FALSE);
+    psRing->au32RecorderSsrcs[n] = u32Ssrc;
+
+    return psRing->abRecorders[n] ? &psRing->asRecorders[n] : NULL;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: PRERING_vFinishDump
+ *
+ * DESCRIPTION:
+ * Closes the file of a completed dump and unpins its frames
+ *
+ * RETURNS:
+ * void
+ *
+ ****************************************************************************/
+static void PRERING_vFinishDump(PRERING_tsInstance *psRing)
+{
+    uint32_t n;
+
+    for(n = 0; n < PRERING_MAX_DUMP_STREAMS; n++)
+    {
+        if(psRing->abRecorders[n])
+        {
+            MP4_vDeInit(&psRing->asRecorders[n]);
+            psRing->abRecorders[n] = FALSE;
+        }
+    }
+    psRing->u32NextRecorder = 0;
+
+#ifndef _WIN32
+    pthread_mutex_lock(&psRing->sLock);
+#endif
+    psRing->bDumping = FALSE;
+#ifndef _WIN32
+    pthread_mutex_unlock(&psRing->sLock);
+#endif
+}
+
+/****************************************************************************/
+/***        END OF FILE                                                   ***/
+/****************************************************************************/
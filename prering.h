@@ -0,0 +1,110 @@
+#ifndef PRERING_H
+#define PRERING_H
+
+/****************************************************************************/
+/***        Include files                                                 ***/
+/****************************************************************************/
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+
+#ifndef _WIN32
+#include <pthread.h>
+#endif
+
+#include "common.h"
+#include "rtp.h"
+#include "mp4.h"
+
+/****************************************************************************/
+/***        Macro Definitions                                             ***/
+/****************************************************************************/
+
+#define PRERING_DEFAULT_SECONDS         30
+#define PRERING_DEFAULT_DATA_LENGTH     (32 * 1024 * 1024)
+#define PRERING_MAX_FRAME_RATE          60                  // Sizes the frame descriptors, frames beyond it evict older ones early
+#define PRERING_MAX_GOP_SECONDS         10                  // Extra history kept so a dump can start at a key frame
+#define PRERING_MAX_PREFIX_LENGTH       200
+#define PRERING_DUMP_CHUNK_LENGTH       (256 * 1024)        // Written per call so a dump doesn't hold up the other cameras' dumps
+#define PRERING_MAX_DUMP_STREAMS        4                   // H.264 streams of one camera written to their own files at once
+#define PRERING_TRIGGER_CHECK_MS        100
+#define PRERING_TRIGGER_HOLDOFF_MS      1000                // Triggers closer together than this are merged
+
+/****************************************************************************/
+/***        Type Definitions                                              ***/
+/****************************************************************************/
+
+typedef struct {
+    uint64_t u64DataPos;                            // Position of the frame's first byte, the offset in the data area is this modulo u64DataLength
+    uint64_t u64ArrivalTimeUs;
+    uint32_t u32Length;
+    uint32_t u32Timestamp;
+    uint32_t u32Ssrc;
+    ORLACO_tuIP uSrcIP;
+    uint16_t u16Width;
+    uint16_t u16Height;
+    uint8_t u8Codec;
+    bool_t bKeyFrame;
+} PRERING_tsFrame;
+
+// Fixed size history of one camera's frames, shared by all of its streams. Both the
+// frame data and the descriptors are allocated up front and the oldest frames are
+// overwritten. The receive workers push while the dump thread writes, so both take
+// the lock, but frame data is written out without it as pinned frames never move.
+typedef struct {
+#ifndef _WIN32
+    pthread_mutex_t sLock;
+#endif
+    uint8_t *pu8Data;
+    uint64_t u64DataLength;
+    PRERING_tsFrame *psFrames;
+    uint32_t u32MaxFrames;
+    uint32_t u32Seconds;
+    uint64_t u64Head;                               // Sequence number of the next frame
+    uint64_t u64Tail;                               // Sequence number of the oldest frame held
+    uint64_t u64WritePos;
+    uint64_t u64Evicted;
+    uint64_t u64Dropped;                            // Frames not stored because a dump still needed the space
+
+    // Dump in progress, frames from u64DumpSeq up to u64DumpEnd are pinned until written
+    bool_t bDumping;
+    uint64_t u64DumpSeq;
+    uint64_t u64DumpEnd;
+    char acPrefix[PRERING_MAX_PREFIX_LENGTH];
+    bool_t abRecorders[PRERING_MAX_DUMP_STREAMS];
+    uint32_t au32RecorderSsrcs[PRERING_MAX_DUMP_STREAMS];
+    uint32_t u32NextRecorder;                       // Closed next when a dump holds more H.264 streams than recorders
+    MP4_tsRecorder asRecorders[PRERING_MAX_DUMP_STREAMS];
+    uint32_t u32DumpFrames;
+} PRERING_tsInstance;
+
+// Sources of dump requests: a file whose modification time changes when it is touched, and a
+// Unix datagram socket that accepts "dump" commands
+typedef struct {
+    char *pcFile;
+    time_t tFileModified;
+    bool_t bFileExists;
+    char *pcSocket;
+    int iSocket;
+    uint64_t u64NextCheckUs;
+} PRERING_tsTrigger;
+
+/****************************************************************************/
+/***        Exported Functions                                            ***/
+/****************************************************************************/
+
+bool_t PRERING_bInit(PRERING_tsInstance *psRing, uint64_t u64DataLength, uint32_t u32Seconds);
+void PRERING_vDeInit(PRERING_tsInstance *psRing);
+bool_t PRERING_bPush(PRERING_tsInstance *psRing, RTP_tsFrame *psFrame);
+bool_t PRERING_bStartDump(PRERING_tsInstance *psRing, char *pcPrefix);
+bool_t PRERING_bContinueDump(PRERING_tsInstance *psRing, uint32_t u32MaxLength);
+bool_t PRERING_bOpenTrigger(PRERING_tsTrigger *psTrigger, char *pcFile, char *pcSocket);
+bool_t PRERING_bCheckTrigger(PRERING_tsTrigger *psTrigger, uint64_t u64TimeUs);
+void PRERING_vCloseTrigger(PRERING_tsTrigger *psTrigger);
+
+#endif // PRERING_H
+
+/****************************************************************************/
+/***        END OF FILE                                                   ***/
+/****************************************************************************/
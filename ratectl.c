@@ -0,0 +1,631 @@
+/****************************************************************************
+ *
+ * Copyright 2021 Lee Mitchell <lee@indigopepper.com>
+ * This file is part of OCC (Orlaco Camera Configurator)
+ *
+ * OCC (Orlaco Camera Configurator) is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * OCC (Orlaco Camera Configurator) is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with OCC (Orlaco Camera Configurator).  If not,
+ * see <http://www.gnu.org/licenses/>.
+ *
+ ****************************************************************************/
+
+/****************************************************************************/
+/***        Include files                                                 ***/
+/****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "common.h"
+#include "rtp.h"
+#include "ratectl.h"
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+/****************************************************************************/
+/***        Macro Definitions                                             ***/
+/****************************************************************************/
+
+#define RATECTL_DECREASE_PERCENT        75                  // Multiplicative decrease
+#define RATECTL_POLL_MS                 100                 // How quickly a stop request is noticed
+
+/****************************************************************************/
+/***        Type Definitions                                              ***/
+/****************************************************************************/
+
+typedef enum {
+    E_RATECTL_ACTION_IDLE = 0,                      // Nothing received
+    E_RATECTL_ACTION_SETTLE,
+    E_RATECTL_ACTION_HOLD,
+    E_RATECTL_ACTION_DECREASE,
+    E_RATECTL_ACTION_INCREASE,
+} RATECTL_teAction;
+
+typedef struct {
+    uint64_t u64Expected;
+    uint64_t u64Lost;
+    uint64_t u64Bytes;
+    uint32_t u32JitterUs;
+} RATECTL_tsSample;
+
+/****************************************************************************/
+/***        Local Function Prototypes                                     ***/
+/****************************************************************************/
+
+#ifndef _WIN32
+static void *RATECTL_pvThread(void *pvRate);
+#endif
+static RATECTL_teAction RATECTL_eDecide(RATECTL_tsInstance *psRate, RATECTL_tsCamera *psCamera, RATECTL_tsSample *psSample, ORLACO_tsRegionOfInterest *psNew);
+static bool_t RATECTL_bClamp(RATECTL_tsInstance *psRate, RATECTL_tsCamera *psCamera, ORLACO_tsRegionOfInterest *psNew);
+static bool_t RATECTL_bApply(RATECTL_tsInstance *psRate, RATECTL_tsCamera *psCamera, ORLACO_tsRegionOfInterest *psNew);
+static bool_t RATECTL_bRefresh(RATECTL_tsInstance *psRate, RATECTL_tsCamera *psCamera);
+static void RATECTL_vPrint(RATECTL_tsInstance *psRate, RATECTL_tsCamera *psCamera, RATECTL_tsSample *psSample, RATECTL_teAction eAction, double dTime);
+
+/****************************************************************************/
+/***        Exported Variables                                            ***/
+/****************************************************************************/
+
+/****************************************************************************/
+/***        Local Variables                                               ***/
+/****************************************************************************/
+
+static const char *apcActions[] = { "idle", "settle", "hold", "decrease", "increase" };
+
+/****************************************************************************/
+/***        Exported Functions                                            ***/
+/****************************************************************************/
+
+/****************************************************************************
+ *
+ * NAME: RATECTL_bInit
+ *
+ * DESCRIPTION:
+ * Sets the bounds the controller keeps each camera's ROI within
+ *
+ * RETURNS:
+ * bool_t TRUE if successful, FALSE if the bounds don't make sense
+ *
+ ****************************************************************************/
+bool_t RATECTL_bInit(RATECTL_tsInstance *psRate, ORLACO_tsInstance *psOrlaco, uint32_t u32MinBitrate, uint32_t u32MaxBitrate, uint8_t u8MinFrameRate, uint8_t u8MaxFrameRate)
+{
+    memset(psRate, 0, sizeof(RATECTL_tsInstance));
+
+    if((u32MinBitrate == 0) || (u32MinBitrate > u32MaxBitrate) ||
+       ((u8MaxFrameRate != 0) && (u8MinFrameRate > u8MaxFrameRate)))
+    {
+        printf("Error: Rate control bounds must be at least 1Mbps and have the minimum below the maximum in %s\n", __FUNCTION__);
+        return FALSE;
+    }
+
+    psRate->psOrlaco = psOrlaco;
+    psRate->u32IntervalMs = RATECTL_DEFAULT_INTERVAL_MS;
+    psRate->u32MinBitrate = u32MinBitrate;
+    psRate->u32MaxBitrate = u32MaxBitrate;
+    psRate->u8MinFrameRate = u8MinFrameRate;
+    psRate->u8MaxFrameRate = u8MaxFrameRate;
+
+#ifndef _WIN32
+    pthread_mutex_init(&psRate->sLock, NULL);
+#endif
+
+    return TRUE;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: RATECTL_vDeInit
+ *
+ * DESCRIPTION:
+ * Prints what the controller did to each camera
+ *
+ * RETURNS:
+ * void
+ *
+ ****************************************************************************/
+void RATECTL_vDeInit(RATECTL_tsInstance *psRate)
+{
+    RATECTL_tsCamera *psCamera;
+    uint32_t n;
+
+    if((psRate->psOrlaco != NULL) && (psRate->psOrlaco->eVerbosity >= E_ORLACO_VERBOSITY_INFO))
+    {
+        for(n = 0; n < psRate->u32NumCameras; n++)
+        {
+            psCamera = &psRate->asCameras[n];
+            printf("Rate control %d.%d.%d.%d ROI %u left at %uMbps %ufps after %u decreases and %u increases\n",
+                   psCamera->uIP.au8IP[3], psCamera->uIP.au8IP[2], psCamera->uIP.au8IP[1], psCamera->uIP.au8IP[0],
+                   psCamera->u32RegionOfInterest, psCamera->sRoi.u32MaxBitrate, psCamera->sRoi.u8FrameRate,
+                   psCamera->u32Decreases, psCamera->u32Increases);
+        }
+    }
+
+#ifndef _WIN32
+    pthread_mutex_destroy(&psRate->sLock);
+#endif
+    psRate->u32NumCameras = 0;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: RATECTL_bAddCamera
+ *
+ * DESCRIPTION:
+ * Puts the ROI a camera streams under control, starting from its current
+ * configuration. Must be called before the controller is started.
+ *
+ * RETURNS:
+ * bool_t TRUE if successful, FALSE if there's no room for the camera
+ *
+ ****************************************************************************/
+bool_t RATECTL_bAddCamera(RATECTL_tsInstance *psRate, ORLACO_tuIP uIP, uint32_t u32RegionOfInterest, ORLACO_tsRegionOfInterest *psRoi)
+{
+    RATECTL_tsCamera *psCamera;
+
+    if(psRate->u32NumCameras >= RATECTL_MAX_CAMERAS)
+    {
+        return FALSE;
+    }
+
+    psCamera = &psRate->asCameras[psRate->u32NumCameras++];
+    memset(psCamera, 0, sizeof(RATECTL_tsCamera));
+    psCamera->uIP = uIP;
+    psCamera->u32RegionOfInterest = u32RegionOfInterest;
+    psCamera->sRoi = *psRoi;
+    psCamera->u8ConfiguredFrameRate = psRoi->u8FrameRate;
+    psCamera->u32Restarts = ORLACO_u32GetRestarts(psRate->psOrlaco, uIP);
+
+    return TRUE;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: RATECTL_bStart
+ *
+ * DESCRIPTION:
+ * Starts the controller thread. It first brings any ROI outside the bounds
+ * within them, then adjusts them every interval until stopped.
+ *
+ * RETURNS:
+ * bool_t TRUE if successful, FALSE otherwise
+ *
+ ****************************************************************************/
+bool_t RATECTL_bStart(RATECTL_tsInstance *psRate)
+{
+#ifdef _WIN32
+    printf("Error: Rate control needs threads, which aren't supported on this platform in %s\n", __FUNCTION__);
+    return FALSE;
+#else
+    psRate->bStop = FALSE;
+    if(pthread_create(&psRate->sThread, NULL, RATECTL_pvThread, psRate) != 0)
+    {
+        printf("Error: Failed to start the rate controller in %s\n", __FUNCTION__);
+        return FALSE;
+    }
+
+    return TRUE;
+#endif
+}
+
+
+/****************************************************************************
+ *
+ * NAME: RATECTL_vStop
+ *
+ * DESCRIPTION:
+ * Stops the controller thread, leaving each ROI as it was last set
+ *
+ * RETURNS:
+ * void
+ *
+ ****************************************************************************/
+void RATECTL_vStop(RATECTL_tsInstance *psRate)
+{
+#ifndef _WIN32
+    psRate->bStop = TRUE;
+    pthread_join(psRate->sThread, NULL);
+#endif
+}
+
+
+/****************************************************************************
+ *
+ * NAME: RATECTL_vAddSample
+ *
+ * DESCRIPTION:
+ * Adds what one of a camera's streams received since its previous sample.
+ * Called from the receive workers, samples from cameras that aren't under
+ * control are ignored.
+ *
+ * RETURNS:
+ * void
+ *
+ ****************************************************************************/
+void RATECTL_vAddSample(RATECTL_tsInstance *psRate, ORLACO_tuIP uIP, uint64_t u64Expected, uint64_t u64Lost, uint64_t u64Bytes, uint32_t u32JitterUs)
+{
+    RATECTL_tsCamera *psCamera;
+    uint32_t n;
+
+    for(n = 0; n < psRate->u32NumCameras; n++)
+    {
+        psCamera = &psRate->asCameras[n];
+        if(psCamera->uIP.u32IP != uIP.u32IP)
+        {
+            continue;
+        }
+
+#ifndef _WIN32
+        pthread_mutex_lock(&psRate->sLock);
+#endif
+        psCamera->u64Expected += u64Expected;
+        psCamera->u64Lost += u64Lost;
+        psCamera->u64Bytes += u64Bytes;
+        if(u32JitterUs > psCamera->u32JitterUs)
+        {
+            psCamera->u32JitterUs = u32JitterUs;
+        }
+#ifndef _WIN32
+        pthread_mutex_unlock(&psRate->sLock);
+#endif
+        return;
+    }
+}
+
+/****************************************************************************/
+/***        Local Functions                                               ***/
+/****************************************************************************/
+
+#ifndef _WIN32
+/****************************************************************************
+ *
+ * NAME: RATECTL_pvThread
+ *
+ * DESCRIPTION:
+ * Takes the samples of every camera each interval and adjusts their ROIs
+ *
+ * RETURNS:
+ * void * NULL
+ *
+ ****************************************************************************/
+static void *RATECTL_pvThread(void *pvRate)
+{
+    RATECTL_tsInstance *psRate = (RATECTL_tsInstance*)pvRate;
+    RATECTL_tsSample asSamples[RATECTL_MAX_CAMERAS];
+    RATECTL_tsCamera *psCamera;
+    ORLACO_tsRegionOfInterest sNew;
+    RATECTL_teAction eAction;
+    uint64_t u64StartTimeUs = RTP_u64GetTimeUs();
+    uint32_t u32WaitedMs;
+    uint32_t n;
+
+    for(n = 0; n < psRate->u32NumCameras; n++)
+    {
+        psCamera = &psRate->asCameras[n];
+        if(RATECTL_bClamp(psRate, psCamera, &sNew) && RATECTL_bApply(psRate, psCamera, &sNew))
+        {
+            psCamera->u32SettleIntervals = RATECTL_SETTLE_INTERVALS;
+        }
+    }
+
+    while(!psRate->bStop)
+    {
+        for(u32WaitedMs = 0; !psRate->bStop && (u32WaitedMs < psRate->u32IntervalMs); u32WaitedMs += RATECTL_POLL_MS)
+        {
+            usleep(RATECTL_POLL_MS * 1000);
+        }
+        if(psRate->bStop)
+        {
+            break;
+        }
+
+        // Hold the lock just long enough to take the samples, the workers are waiting on it
+        pthread_mutex_lock(&psRate->sLock);
+        for(n = 0; n < psRate->u32NumCameras; n++)
+        {
+            psCamera = &psRate->asCameras[n];
+            asSamples[n].u64Expected = psCamera->u64Expected;
+            asSamples[n].u64Lost = psCamera->u64Lost;
+            asSamples[n].u64Bytes = psCamera->u64Bytes;
+            asSamples[n].u32JitterUs = psCamera->u32JitterUs;
+            psCamera->u64Expected = 0;
+            psCamera->u64Lost = 0;
+            psCamera->u64Bytes = 0;
+            psCamera->u32JitterUs = 0;
+        }
+        pthread_mutex_unlock(&psRate->sLock);
+
+        // Notice any cameras that have announced a restart
+        ORLACO_vPollServiceDiscovery(psRate->psOrlaco);
+
+        for(n = 0; n < psRate->u32NumCameras; n++)
+        {
+            psCamera = &psRate->asCameras[n];
+            if(ORLACO_u32GetRestarts(psRate->psOrlaco, psCamera->uIP) != psCamera->u32Restarts)
+            {
+                // What the interval saw was of the camera before it restarted
+                RATECTL_bRefresh(psRate, psCamera);
+                continue;
+            }
+            eAction = RATECTL_eDecide(psRate, psCamera, &asSamples[n], &sNew);
+            if((eAction == E_RATECTL_ACTION_DECREASE) || (eAction == E_RATECTL_ACTION_INCREASE))
+            {
+                if(!RATECTL_bApply(psRate, psCamera, &sNew))
+                {
+                    // The camera keeps its old configuration, so try again next interval
+                    continue;
+                }
+                psCamera->u32SettleIntervals = RATECTL_SETTLE_INTERVALS;
+                if(eAction == E_RATECTL_ACTION_DECREASE) psCamera->u32Decreases++;
+                else psCamera->u32Increases++;
+            }
+            else if(psRate->psOrlaco->eVerbosity < E_ORLACO_VERBOSITY_DEBUG)
+            {
+                continue;
+            }
+            RATECTL_vPrint(psRate, psCamera, &asSamples[n], eAction, (double)(RTP_u64GetTimeUs() - u64StartTimeUs) / 1000000.0);
+        }
+        fflush(stdout);
+    }
+
+    return NULL;
+}
+#endif
+
+
+/****************************************************************************
+ *
+ * NAME: RATECTL_eDecide
+ *
+ * DESCRIPTION:
+ * Works out a camera's next configuration from one interval's samples. Loss
+ * or jitter at the high thresholds cuts the bitrate by a quarter, and once
+ * that's at its minimum the frame rate. Below the low thresholds for several
+ * intervals in a row the frame rate comes back first and then the bitrate
+ * creeps up. In between the configuration is held.
+ *
+ * RETURNS:
+ * RATECTL_teAction What was decided, psNew is only valid for an increase or a decrease
+ *
+ ****************************************************************************/
+static RATECTL_teAction RATECTL_eDecide(RATECTL_tsInstance *psRate, RATECTL_tsCamera *psCamera, RATECTL_tsSample *psSample, ORLACO_tsRegionOfInterest *psNew)
+{
+    uint8_t u8MaxFrameRate = (psRate->u8MaxFrameRate != 0) ? psRate->u8MaxFrameRate : psCamera->u8ConfiguredFrameRate;
+    uint8_t u8MinFrameRate = (psRate->u8MinFrameRate != 0) ? psRate->u8MinFrameRate : u8MaxFrameRate;
+    double dLossPercent;
+    double dJitterMs = (double)psSample->u32JitterUs / 1000.0;
+    uint32_t u32Value;
+
+    *psNew = psCamera->sRoi;
+
+    if(psCamera->u32SettleIntervals > 0)
+    {
+        // This interval straddles the change, it says nothing about the new rates
+        psCamera->u32SettleIntervals--;
+        psCamera->u32ClearIntervals = 0;
+        return E_RATECTL_ACTION_SETTLE;
+    }
+
+    if(psSample->u64Expected == 0)
+    {
+        psCamera->u32ClearIntervals = 0;
+        return E_RATECTL_ACTION_IDLE;
+    }
+    dLossPercent = (double)psSample->u64Lost * 100.0 / (double)psSample->u64Expected;
+
+    if((dLossPercent >= RATECTL_LOSS_HIGH_PERCENT) || (dJitterMs >= RATECTL_JITTER_HIGH_MS))
+    {
+        psCamera->u32ClearIntervals = 0;
+        if(psNew->u32MaxBitrate > psRate->u32MinBitrate)
+        {
+            u32Value = psNew->u32MaxBitrate * RATECTL_DECREASE_PERCENT / 100;
+            if(u32Value >= psNew->u32MaxBitrate) u32Value = psNew->u32MaxBitrate - 1;
+            psNew->u32MaxBitrate = (u32Value < psRate->u32MinBitrate) ? psRate->u32MinBitrate : u32Value;
+            return E_RATECTL_ACTION_DECREASE;
+        }
+        if(psNew->u8FrameRate > u8MinFrameRate)
+        {
+            u32Value = (uint32_t)psNew->u8FrameRate * RATECTL_DECREASE_PERCENT / 100;
+            if(u32Value >= psNew->u8FrameRate) u32Value = psNew->u8FrameRate - 1;
+            psNew->u8FrameRate = (uint8_t)((u32Value < u8MinFrameRate) ? u8MinFrameRate : u32Value);
+            return E_RATECTL_ACTION_DECREASE;
+        }
+        return E_RATECTL_ACTION_HOLD;
+    }
+
+    if((dLossPercent >= RATECTL_LOSS_LOW_PERCENT) || (dJitterMs >= (RATECTL_JITTER_HIGH_MS / 2.0)))
+    {
+        psCamera->u32ClearIntervals = 0;
+        return E_RATECTL_ACTION_HOLD;
+    }
+
+    if(++psCamera->u32ClearIntervals < RATECTL_CLEAR_INTERVALS)
+    {
+        return E_RATECTL_ACTION_HOLD;
+    }
+    psCamera->u32ClearIntervals = 0;
+
+    if(psNew->u8FrameRate < u8MaxFrameRate)
+    {
+        u32Value = (uint32_t)psNew->u8FrameRate + RATECTL_FRAME_RATE_STEP;
+        psNew->u8FrameRate = (uint8_t)((u32Value > u8MaxFrameRate) ? u8MaxFrameRate : u32Value);
+        return E_RATECTL_ACTION_INCREASE;
+    }
+    if(psNew->u32MaxBitrate < psRate->u32MaxBitrate)
+    {
+        u32Value = psNew->u32MaxBitrate + RATECTL_BITRATE_STEP_MBPS;
+        psNew->u32MaxBitrate = (u32Value > psRate->u32MaxBitrate) ? psRate->u32MaxBitrate : u32Value;
+        return E_RATECTL_ACTION_INCREASE;
+    }
+
+    return E_RATECTL_ACTION_HOLD;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: RATECTL_bClamp
+ *
+ * DESCRIPTION:
+ * Works out a camera's configuration brought within the bounds
+ *
+ * RETURNS:
+ * bool_t TRUE if it had to change, FALSE if it was already within them
+ *
+ ****************************************************************************/
+static bool_t RATECTL_bClamp(RATECTL_tsInstance *psRate, RATECTL_tsCamera *psCamera, ORLACO_tsRegionOfInterest *psNew)
+{
+    uint8_t u8MaxFrameRate = (psRate->u8MaxFrameRate != 0) ? psRate->u8MaxFrameRate : psCamera->u8ConfiguredFrameRate;
+    uint8_t u8MinFrameRate = (psRate->u8MinFrameRate != 0) ? psRate->u8MinFrameRate : u8MaxFrameRate;
+
+    *psNew = psCamera->sRoi;
+
+    if(psNew->u32MaxBitrate < psRate->u32MinBitrate) psNew->u32MaxBitrate = psRate->u32MinBitrate;
+    if(psNew->u32MaxBitrate > psRate->u32MaxBitrate) psNew->u32MaxBitrate = psRate->u32MaxBitrate;
+    if(psNew->u8FrameRate < u8MinFrameRate) psNew->u8FrameRate = u8MinFrameRate;
+    if(psNew->u8FrameRate > u8MaxFrameRate) psNew->u8FrameRate = u8MaxFrameRate;
+
+    return (psNew->u32MaxBitrate != psCamera->sRoi.u32MaxBitrate) || (psNew->u8FrameRate != psCamera->sRoi.u8FrameRate);
+}
+
+
+/****************************************************************************
+ *
+ * NAME: RATECTL_bApply
+ *
+ * DESCRIPTION:
+ * Writes a camera's new ROI configuration, keeping the old one if the
+ * camera doesn't accept it
+ *
+ * RETURNS:
+ * bool_t TRUE if successful, FALSE otherwise
+ *
+ ****************************************************************************/
+static bool_t RATECTL_bApply(RATECTL_tsInstance *psRate, RATECTL_tsCamera *psCamera, ORLACO_tsRegionOfInterest *psNew)
+{
+    ORLACO_tsInstance *psOrlaco = psRate->psOrlaco;
+    bool_t bOk;
+
+    psOrlaco->fdUnicast.sin_addr.s_addr = htonl(psCamera->uIP.u32IP);
+
+    bOk = ORLACO_bSetCamExclusive(psOrlaco, 100);
+    if(bOk)
+    {
+        bOk &= ORLACO_bSetRegionOfInterest(psOrlaco, psCamera->u32RegionOfInterest, psNew);
+        bOk &= ORLACO_bEraseCamExclusive(psOrlaco);
+    }
+
+    if(!bOk)
+    {
+        printf("Warning: Couldn't set ROI %u of camera %d.%d.%d.%d to %uMbps %ufps\n",
+               psCamera->u32RegionOfInterest,
+               psCamera->uIP.au8IP[3], psCamera->uIP.au8IP[2], psCamera->uIP.au8IP[1], psCamera->uIP.au8IP[0],
+               psNew->u32MaxBitrate, psNew->u8FrameRate);
+        return FALSE;
+    }
+
+    psCamera->sRoi = *psNew;
+
+    return TRUE;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: RATECTL_bRefresh
+ *
+ * DESCRIPTION:
+ * Reads back the configuration of the ROI of a camera that has restarted,
+ * which may no longer be what the controller last set, and brings it back
+ * within the limits
+ *
+ * RETURNS:
+ * bool_t TRUE if successful, FALSE to try again next interval
+ *
+ ****************************************************************************/
+static bool_t RATECTL_bRefresh(RATECTL_tsInstance *psRate, RATECTL_tsCamera *psCamera)
+{
+    ORLACO_tsInstance *psOrlaco = psRate->psOrlaco;
+    ORLACO_tsRegionOfInterest sNew;
+    uint32_t u32Restarts = ORLACO_u32GetRestarts(psOrlaco, psCamera->uIP);
+
+    psOrlaco->fdUnicast.sin_addr.s_addr = htonl(psCamera->uIP.u32IP);
+    if(!ORLACO_bGetRegionOfInterest(psOrlaco, psCamera->u32RegionOfInterest, &psCamera->sRoi))
+    {
+        return FALSE;
+    }
+
+    printf("Warning: %d.%d.%d.%d has restarted, its ROI %u is at %uMbps %ufps\n",
+           psCamera->uIP.au8IP[3], psCamera->uIP.au8IP[2], psCamera->uIP.au8IP[1], psCamera->uIP.au8IP[0],
+           psCamera->u32RegionOfInterest, psCamera->sRoi.u32MaxBitrate, psCamera->sRoi.u8FrameRate);
+
+    psCamera->u32Restarts = u32Restarts;
+    psCamera->u32ClearIntervals = 0;
+    psCamera->u32SettleIntervals = RATECTL_SETTLE_INTERVALS;
+    if(RATECTL_bClamp(psRate, psCamera, &sNew))
+    {
+        RATECTL_bApply(psRate, psCamera, &sNew);
+    }
+
+    return TRUE;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: RATECTL_vPrint
+ *
+ * DESCRIPTION:
+ * Prints one camera's interval and what was decided, along with the total
+ * configured and received bitrate of all cameras
+ *
+ * RETURNS:
+ * void
+ *
+ ****************************************************************************/
+static void RATECTL_vPrint(RATECTL_tsInstance *psRate, RATECTL_tsCamera *psCamera, RATECTL_tsSample *psSample, RATECTL_teAction eAction, double dTime)
+{
+    double dLossPercent = (psSample->u64Expected != 0) ? ((double)psSample->u64Lost * 100.0 / (double)psSample->u64Expected) : 0.0;
+    double dMbps = (double)psSample->u64Bytes * 8.0 / ((double)psRate->u32IntervalMs * 1000.0);
+    uint32_t u32FleetMaxBitrate = 0;
+    char acIP[16];
+    uint32_t n;
+
+    for(n = 0; n < psRate->u32NumCameras; n++)
+    {
+        u32FleetMaxBitrate += psRate->asCameras[n].sRoi.u32MaxBitrate;
+    }
+
+    sprintf(acIP, "%d.%d.%d.%d", psCamera->uIP.au8IP[3], psCamera->uIP.au8IP[2], psCamera->uIP.au8IP[1], psCamera->uIP.au8IP[0]);
+
+    if(psRate->bNdjson)
+    {
+        printf("{\"time\":%.3f,\"camera\":\"%s\",\"roi\":%u,\"action\":\"%s\",\"loss_pct\":%.2f,\"jitter_ms\":%.3f,\"mbps\":%.3f,"
+               "\"max_mbps\":%u,\"fps\":%u,\"fleet_max_mbps\":%u}\n",
+               dTime, acIP, psCamera->u32RegionOfInterest, apcActions[eAction], dLossPercent, (double)psSample->u32JitterUs / 1000.0, dMbps,
+               psCamera->sRoi.u32MaxBitrate, psCamera->sRoi.u8FrameRate, u32FleetMaxBitrate);
+    }
+    else
+    {
+        printf("Rate control %-15s ROI %u %-8s loss %.2f%% jitter %.2fms %.2fMbps, now %uMbps %ufps, all cameras %uMbps\n",
+               acIP, psCamera->u32RegionOfInterest, apcActions[eAction], dLossPercent, (double)psSample->u32JitterUs / 1000.0, dMbps,
+               psCamera->sRoi.u32MaxBitrate, psCamera->sRoi.u8FrameRate, u32FleetMaxBitrate);
+    }
+}
+
+/****************************************************************************/
+/***        END OF FILE                                                   ***/
+/****************************************************************************/
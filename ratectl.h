@@ -0,0 +1,91 @@
+#ifndef RATECTL_H
+#define RATECTL_H
+
+/****************************************************************************/
+/***        Include files                                                 ***/
+/****************************************************************************/
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#ifndef _WIN32
+#include <pthread.h>
+#endif
+
+#include "common.h"
+#include "orlaco.h"
+
+/****************************************************************************/
+/***        Macro Definitions                                             ***/
+/****************************************************************************/
+
+#define RATECTL_MAX_CAMERAS             16
+#define RATECTL_DEFAULT_INTERVAL_MS     2000
+#define RATECTL_LOSS_HIGH_PERCENT       2.0                 // Back off at or above this much loss
+#define RATECTL_LOSS_LOW_PERCENT        0.2                 // Only probe upwards below this much loss
+#define RATECTL_JITTER_HIGH_MS          30.0                // Back off at or above this much jitter, probe only below half of it
+#define RATECTL_CLEAR_INTERVALS         3                   // Clear intervals in a row before each step up
+#define RATECTL_SETTLE_INTERVALS        1                   // Intervals ignored after a change while the camera adjusts
+#define RATECTL_BITRATE_STEP_MBPS       1
+#define RATECTL_FRAME_RATE_STEP         2
+
+/****************************************************************************/
+/***        Type Definitions                                              ***/
+/****************************************************************************/
+
+typedef struct {
+    ORLACO_tuIP uIP;
+    uint32_t u32RegionOfInterest;                   // The ROI the camera streams, adjusted in place
+    ORLACO_tsRegionOfInterest sRoi;                 // Its current configuration
+    uint8_t u8ConfiguredFrameRate;                  // Before the controller started
+    uint32_t u32Restarts;                           // Of the camera when sRoi was last known to be right
+
+    // Summed by the workers of every stream from the camera, taken by the controller each interval
+    uint64_t u64Expected;
+    uint64_t u64Lost;
+    uint64_t u64Bytes;
+    uint32_t u32JitterUs;                           // Highest of the camera's streams
+
+    uint32_t u32ClearIntervals;
+    uint32_t u32SettleIntervals;
+    uint32_t u32Decreases;
+    uint32_t u32Increases;
+} RATECTL_tsCamera;
+
+// Additive increase, multiplicative decrease of the bitrate and then the frame
+// rate of each camera's ROI, driven by the loss and jitter its streams see.
+// Between the low and high thresholds nothing changes, so the rates settle
+// just under what the network can carry rather than oscillating around it.
+typedef struct {
+    ORLACO_tsInstance *psOrlaco;                    // Only used by the controller thread while it runs
+    RATECTL_tsCamera asCameras[RATECTL_MAX_CAMERAS];
+    uint32_t u32NumCameras;
+    uint32_t u32IntervalMs;
+    uint32_t u32MinBitrate;                         // Megabits per second
+    uint32_t u32MaxBitrate;
+    uint8_t u8MinFrameRate;                         // 0 to leave the frame rate alone
+    uint8_t u8MaxFrameRate;                         // 0 for each ROI's configured frame rate
+    bool_t bNdjson;
+    volatile bool_t bStop;
+#ifndef _WIN32
+    pthread_mutex_t sLock;                          // Samples arrive from every worker
+    pthread_t sThread;
+#endif
+} RATECTL_tsInstance;
+
+/****************************************************************************/
+/***        Exported Functions                                            ***/
+/****************************************************************************/
+
+bool_t RATECTL_bInit(RATECTL_tsInstance *psRate, ORLACO_tsInstance *psOrlaco, uint32_t u32MinBitrate, uint32_t u32MaxBitrate, uint8_t u8MinFrameRate, uint8_t u8MaxFrameRate);
+void RATECTL_vDeInit(RATECTL_tsInstance *psRate);
+bool_t RATECTL_bAddCamera(RATECTL_tsInstance *psRate, ORLACO_tuIP uIP, uint32_t u32RegionOfInterest, ORLACO_tsRegionOfInterest *psRoi);
+bool_t RATECTL_bStart(RATECTL_tsInstance *psRate);
+void RATECTL_vStop(RATECTL_tsInstance *psRate);
+void RATECTL_vAddSample(RATECTL_tsInstance *psRate, ORLACO_tuIP uIP, uint64_t u64Expected, uint64_t u64Lost, uint64_t u64Bytes, uint32_t u32JitterUs);
+
+#endif // RATECTL_H
+
+/****************************************************************************/
+/***        END OF FILE                                                   ***/
+/****************************************************************************/
@@ -0,0 +1,377 @@
+/****************************************************************************
+ *
+ * Copyright 2021 Lee Mitchell <lee@indigopepper.com>
+ * This file is part of OCC (Orlaco Camera Configurator)
+ *
+ * OCC (Orlaco Camera Configurator) is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * OCC (Orlaco Camera Configurator) is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with OCC (Orlaco Camera Configurator).  If not,
+ * see <http://www.gnu.org/licenses/>.
+ *
+ ****************************************************************************/
+
+/****************************************************************************/
+/***        Include files                                                 ***/
+/****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "common.h"
+#include "rtp.h"
+#include "roiswitch.h"
+
+/****************************************************************************/
+/***        Macro Definitions                                             ***/
+/****************************************************************************/
+
+/****************************************************************************/
+/***        Type Definitions                                              ***/
+/****************************************************************************/
+
+/****************************************************************************/
+/***        Local Function Prototypes                                     ***/
+/****************************************************************************/
+
+static bool_t ROISWITCH_bTransact(ROISWITCH_tsInstance *psSwitch, ORLACO_tsCommand *psCommand, uint32_t *pu32LatencyUs);
+static bool_t ROISWITCH_bRenew(ROISWITCH_tsInstance *psSwitch);
+static uint32_t ROISWITCH_u32GetRestarts(ROISWITCH_tsInstance *psSwitch);
+static int ROISWITCH_iCompare(const void *pvA, const void *pvB);
+
+/****************************************************************************/
+/***        Exported Variables                                            ***/
+/****************************************************************************/
+
+/****************************************************************************/
+/***        Local Variables                                               ***/
+/****************************************************************************/
+
+/****************************************************************************/
+/***        Exported Functions                                            ***/
+/****************************************************************************/
+
+/****************************************************************************
+ *
+ * NAME: ROISWITCH_bInit
+ *
+ * DESCRIPTION:
+ * Serialises the requests for the lease and for selecting each of the ROIs,
+ * and takes the exclusive lock on the camera at the unicast address
+ *
+ * RETURNS:
+ * bool_t TRUE if successful, FALSE otherwise
+ *
+ ****************************************************************************/
+bool_t ROISWITCH_bInit(ROISWITCH_tsInstance *psSwitch, ORLACO_tsInstance *psOrlaco, uint8_t *pu8RegionsOfInterest, uint32_t u32NumRegionsOfInterest, uint32_t u32LeaseSeconds)
+{
+    uint16_t u16Address = E_ORLACO_REGISTER_ADDRESS_SELECTED_ROI;
+    ROISWITCH_tsPreset *psPreset;
+    uint32_t n;
+
+    memset(psSwitch, 0, sizeof(ROISWITCH_tsInstance));
+    psSwitch->psOrlaco = psOrlaco;
+    psSwitch->u32LeaseSeconds = (u32LeaseSeconds != 0) ? u32LeaseSeconds : ROISWITCH_DEFAULT_LEASE;
+
+    if((u32NumRegionsOfInterest == 0) || (u32NumRegionsOfInterest > ROISWITCH_MAX_PRESETS))
+    {
+        printf("Error: Between 1 and %d ROIs can be switched between in %s\n", ROISWITCH_MAX_PRESETS, __FUNCTION__);
+        return FALSE;
+    }
+
+    for(n = 0; n < u32NumRegionsOfInterest; n++)
+    {
+        psPreset = &psSwitch->asPresets[n];
+        psPreset->u8RegionOfInterest = pu8RegionsOfInterest[n];
+        if((psPreset->u8RegionOfInterest == 0) || (psPreset->u8RegionOfInterest >= psOrlaco->u16NumRegionsOfInterest))
+        {
+            printf("Error: ROI %d doesn't exist in %s\n", psPreset->u8RegionOfInterest, __FUNCTION__);
+            return FALSE;
+        }
+        if(!ORLACO_bBuildSetRegisters(psOrlaco, &u16Address, &psPreset->u8RegionOfInterest, 1, &psPreset->sCommand))
+        {
+            return FALSE;
+        }
+    }
+    psSwitch->u32NumPresets = u32NumRegionsOfInterest;
+
+    if(!ORLACO_bBuildSetCamExclusive(psOrlaco, psSwitch->u32LeaseSeconds, &psSwitch->sLease))
+    {
+        return FALSE;
+    }
+
+    if(!ROISWITCH_bRenew(psSwitch))
+    {
+        printf("Error: Couldn't take the exclusive lock in %s\n", __FUNCTION__);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: ROISWITCH_vDeInit
+ *
+ * DESCRIPTION:
+ * Gives up the exclusive lock
+ *
+ * RETURNS:
+ * void
+ *
+ ****************************************************************************/
+void ROISWITCH_vDeInit(ROISWITCH_tsInstance *psSwitch)
+{
+    if(psSwitch->bLeased)
+    {
+        ORLACO_bEraseCamExclusive(psSwitch->psOrlaco);
+        psSwitch->bLeased = FALSE;
+    }
+}
+
+
+/****************************************************************************
+ *
+ * NAME: ROISWITCH_bSelect
+ *
+ * DESCRIPTION:
+ * Has the camera stream one of the preset ROIs and records how long it took
+ * to acknowledge it
+ *
+ * RETURNS:
+ * bool_t TRUE if successful, FALSE otherwise
+ *
+ ****************************************************************************/
+bool_t ROISWITCH_bSelect(ROISWITCH_tsInstance *psSwitch, uint8_t u8RegionOfInterest)
+{
+    uint32_t u32LatencyUs;
+    uint32_t n;
+
+    for(n = 0; n < psSwitch->u32NumPresets; n++)
+    {
+        if(psSwitch->asPresets[n].u8RegionOfInterest == u8RegionOfInterest)
+        {
+            break;
+        }
+    }
+    if(n == psSwitch->u32NumPresets)
+    {
+        printf("Error: ROI %d isn't one of the presets\n", u8RegionOfInterest);
+        return FALSE;
+    }
+
+    if(!ROISWITCH_bTransact(psSwitch, &psSwitch->asPresets[n].sCommand, &u32LatencyUs))
+    {
+        psSwitch->u32Failures++;
+        return FALSE;
+    }
+
+    psSwitch->au32LatencyUs[psSwitch->u32NumSamples % ROISWITCH_MAX_SAMPLES] = u32LatencyUs;
+    psSwitch->u32NumSamples++;
+
+    return TRUE;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: ROISWITCH_bService
+ *
+ * DESCRIPTION:
+ * Renews the lease if it's due, so that it's never renewed in the middle of
+ * a switch, or straight away if the camera has restarted and lost it.
+ * Should be called at least as often as *pu32NextMs asks.
+ *
+ * RETURNS:
+ * bool_t FALSE if the lease couldn't be renewed, TRUE otherwise.
+ * *pu32NextMs is set to the time until the next renewal is due.
+ *
+ ****************************************************************************/
+bool_t ROISWITCH_bService(ROISWITCH_tsInstance *psSwitch, uint32_t *pu32NextMs)
+{
+    bool_t bOk = TRUE;
+    uint64_t u64TimeUs = RTP_u64GetTimeUs();
+
+    if(psSwitch->bLeased && (ROISWITCH_u32GetRestarts(psSwitch) != psSwitch->u32Restarts))
+    {
+        printf("Warning: The camera has restarted, taking the exclusive lock again\n");
+        psSwitch->u64RenewUs = u64TimeUs;
+    }
+
+    if(u64TimeUs >= psSwitch->u64RenewUs)
+    {
+        bOk = ROISWITCH_bRenew(psSwitch);
+        if(!bOk)
+        {
+            printf("Warning: Couldn't renew the exclusive lock\n");
+        }
+        u64TimeUs = RTP_u64GetTimeUs();
+    }
+
+    if(pu32NextMs != NULL)
+    {
+        *pu32NextMs = (psSwitch->u64RenewUs > u64TimeUs) ? (uint32_t)((psSwitch->u64RenewUs - u64TimeUs + 999) / 1000) : 0;
+    }
+
+    return bOk;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: ROISWITCH_vGetStats
+ *
+ * DESCRIPTION:
+ * Works out the percentiles of the switch latencies kept
+ *
+ * RETURNS:
+ * void
+ *
+ ****************************************************************************/
+void ROISWITCH_vGetStats(ROISWITCH_tsInstance *psSwitch, ROISWITCH_tsStats *psStats)
+{
+    uint32_t au32Sorted[ROISWITCH_MAX_SAMPLES];
+    uint32_t u32Count = (psSwitch->u32NumSamples < ROISWITCH_MAX_SAMPLES) ? psSwitch->u32NumSamples : ROISWITCH_MAX_SAMPLES;
+
+    memset(psStats, 0, sizeof(ROISWITCH_tsStats));
+    psStats->u32Count = psSwitch->u32NumSamples;
+    if(u32Count == 0)
+    {
+        return;
+    }
+
+    memcpy(au32Sorted, psSwitch->au32LatencyUs, u32Count * sizeof(uint32_t));
+    qsort(au32Sorted, u32Count, sizeof(uint32_t), ROISWITCH_iCompare);
+
+    psStats->u32P50Us = au32Sorted[(u32Count - 1) * 50 / 100];
+    psStats->u32P90Us = au32Sorted[(u32Count - 1) * 90 / 100];
+    psStats->u32P99Us = au32Sorted[(u32Count - 1) * 99 / 100];
+    psStats->u32MaxUs = au32Sorted[u32Count - 1];
+}
+
+/****************************************************************************/
+/***        Local Functions                                               ***/
+/****************************************************************************/
+
+/****************************************************************************
+ *
+ * NAME: ROISWITCH_bTransact
+ *
+ * DESCRIPTION:
+ * Sends a serialised request and spins until its response arrives
+ *
+ * RETURNS:
+ * bool_t TRUE if the camera accepted the request, FALSE otherwise
+ *
+ ****************************************************************************/
+static bool_t ROISWITCH_bTransact(ROISWITCH_tsInstance *psSwitch, ORLACO_tsCommand *psCommand, uint32_t *pu32LatencyUs)
+{
+    bool_t bAnswered = FALSE;
+    bool_t bOk;
+    uint64_t u64StartUs;
+    uint64_t u64TimeUs;
+
+    u64StartUs = RTP_u64GetTimeUs();
+    bOk = ORLACO_bSendCommand(psSwitch->psOrlaco, psCommand);
+
+    for(u64TimeUs = u64StartUs; bOk && !bAnswered; u64TimeUs = RTP_u64GetTimeUs())
+    {
+        if(u64TimeUs - u64StartUs >= ROISWITCH_TIMEOUT_US)
+        {
+            printf("Error: No response in %s\n", __FUNCTION__);
+            return FALSE;
+        }
+        bOk = ORLACO_bPollCommand(psSwitch->psOrlaco, psCommand, &bAnswered);
+    }
+
+    if(pu32LatencyUs != NULL)
+    {
+        *pu32LatencyUs = (uint32_t)(u64TimeUs - u64StartUs);
+    }
+
+    return bOk;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: ROISWITCH_bRenew
+ *
+ * DESCRIPTION:
+ * Asks for the exclusive lock again and schedules the next renewal
+ *
+ * RETURNS:
+ * bool_t TRUE if successful, FALSE otherwise
+ *
+ ****************************************************************************/
+static bool_t ROISWITCH_bRenew(ROISWITCH_tsInstance *psSwitch)
+{
+    uint64_t u64PeriodUs = (uint64_t)psSwitch->u32LeaseSeconds * 1000000ULL / ROISWITCH_RENEW_DIVISOR;
+
+    if(!ROISWITCH_bTransact(psSwitch, &psSwitch->sLease, NULL))
+    {
+        // Try again soon rather than waiting out the period, in case the lease is still held
+        psSwitch->u64RenewUs = RTP_u64GetTimeUs() + (u64PeriodUs / 10);
+        return FALSE;
+    }
+
+    psSwitch->bLeased = TRUE;
+    psSwitch->u64RenewUs = RTP_u64GetTimeUs() + u64PeriodUs;
+    psSwitch->u32Restarts = ROISWITCH_u32GetRestarts(psSwitch);
+
+    return TRUE;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: ROISWITCH_u32GetRestarts
+ *
+ * DESCRIPTION:
+ * Counts the restarts seen of the camera being switched
+ *
+ * RETURNS:
+ * uint32_t The number of restarts
+ *
+ ****************************************************************************/
+static uint32_t ROISWITCH_u32GetRestarts(ROISWITCH_tsInstance *psSwitch)
+{
+    ORLACO_tuIP uIP;
+
+    uIP.u32IP = ntohl(psSwitch->psOrlaco->fdUnicast.sin_addr.s_addr);
+
+    return ORLACO_u32GetRestarts(psSwitch->psOrlaco, uIP);
+}
+
+
+/****************************************************************************
+ *
+ * NAME: ROISWITCH_iCompare
+ *
+ * DESCRIPTION:
+ * Orders latencies for qsort
+ *
+ * RETURNS:
+ * int less than, equal to or greater than zero
+ *
+ ****************************************************************************/
+static int ROISWITCH_iCompare(const void *pvA, const void *pvB)
+{
+    uint32_t u32A = *(const uint32_t *)pvA;
+    uint32_t u32B = *(const uint32_t *)pvB;
+
+    return (u32A > u32B) - (u32A < u32B);
+}
+
+/****************************************************************************/
+/***        END OF FILE                                                   ***/
+/****************************************************************************/
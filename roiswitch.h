@@ -0,0 +1,73 @@
+#ifndef ROISWITCH_H
+#define ROISWITCH_H
+
+/****************************************************************************/
+/***        Include files                                                 ***/
+/****************************************************************************/
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "common.h"
+#include "orlaco.h"
+
+/****************************************************************************/
+/***        Macro Definitions                                             ***/
+/****************************************************************************/
+
+#define ROISWITCH_MAX_PRESETS           10                  // One per ROI the camera has
+#define ROISWITCH_MAX_SAMPLES           4096                // Latencies kept for the percentiles, the oldest are overwritten
+#define ROISWITCH_DEFAULT_LEASE         10                  // Exclusive time requested, in seconds
+#define ROISWITCH_RENEW_DIVISOR         3                   // Renew once this fraction of the lease has passed
+#define ROISWITCH_TIMEOUT_US            100000              // Give up on a response after this long
+
+/****************************************************************************/
+/***        Type Definitions                                              ***/
+/****************************************************************************/
+
+typedef struct {
+    uint8_t u8RegionOfInterest;
+    ORLACO_tsCommand sCommand;                      // Selects the ROI
+} ROISWITCH_tsPreset;
+
+typedef struct {
+    uint32_t u32Count;
+    uint32_t u32P50Us;
+    uint32_t u32P90Us;
+    uint32_t u32P99Us;
+    uint32_t u32MaxUs;
+} ROISWITCH_tsStats;
+
+// Switches the ROI one camera streams with as little delay as possible. The
+// exclusive lock is held throughout and renewed well before it runs out, the
+// request for each ROI is serialised up front, and responses are busy polled
+// for rather than waited on, so a switch costs one round trip.
+typedef struct {
+    ORLACO_tsInstance *psOrlaco;                    // Its unicast address is the camera
+    ROISWITCH_tsPreset asPresets[ROISWITCH_MAX_PRESETS];
+    uint32_t u32NumPresets;
+    ORLACO_tsCommand sLease;
+    uint32_t u32LeaseSeconds;
+    bool_t bLeased;
+    uint64_t u64RenewUs;                            // When the lease is next due to be renewed
+    uint32_t u32Restarts;                           // Of the camera when the lease was last renewed
+    uint32_t au32LatencyUs[ROISWITCH_MAX_SAMPLES];
+    uint32_t u32NumSamples;                         // Total, only the last ROISWITCH_MAX_SAMPLES are kept
+    uint32_t u32Failures;
+} ROISWITCH_tsInstance;
+
+/****************************************************************************/
+/***        Exported Functions                                            ***/
+/****************************************************************************/
+
+bool_t ROISWITCH_bInit(ROISWITCH_tsInstance *psSwitch, ORLACO_tsInstance *psOrlaco, uint8_t *pu8RegionsOfInterest, uint32_t u32NumRegionsOfInterest, uint32_t u32LeaseSeconds);
+void ROISWITCH_vDeInit(ROISWITCH_tsInstance *psSwitch);
+bool_t ROISWITCH_bSelect(ROISWITCH_tsInstance *psSwitch, uint8_t u8RegionOfInterest);
+bool_t ROISWITCH_bService(ROISWITCH_tsInstance *psSwitch, uint32_t *pu32NextMs);
+void ROISWITCH_vGetStats(ROISWITCH_tsInstance *psSwitch, ROISWITCH_tsStats *psStats);
+
+#endif // ROISWITCH_H
+
+/****************************************************************************/
+/***        END OF FILE                                                   ***/
+/****************************************************************************/
@@ -0,0 +1,495 @@
+/****************************************************************************
+ *
+ * Copyright 2021 Lee Mitchell <lee@indigopepper.com>
+ * This file is part of OCC (Orlaco Camera Configurator)
+ *
+ * OCC (Orlaco Camera Configurator) is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * OCC (Orlaco Camera Configurator) is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with OCC (Orlaco Camera Configurator).  If not,
+ * see <http://www.gnu.org/licenses/>.
+ *
+ ****************************************************************************/
+
+/****************************************************************************/
+/***        Include files                                                 ***/
+/****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "common.h"
+#include "rtcp.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+/****************************************************************************/
+/***        Macro Definitions                                             ***/
+/****************************************************************************/
+
+/****************************************************************************/
+/***        Type Definitions                                              ***/
+/****************************************************************************/
+
+/****************************************************************************/
+/***        Local Function Prototypes                                     ***/
+/****************************************************************************/
+
+static uint32_t RTCP_u32Read32(const uint8_t *pu8Data);
+static uint32_t RTCP_u32Write32(uint8_t *pu8Data, uint32_t u32Value);
+
+/****************************************************************************/
+/***        Exported Variables                                            ***/
+/****************************************************************************/
+
+/****************************************************************************/
+/***        Local Variables                                               ***/
+/****************************************************************************/
+
+/****************************************************************************/
+/***        Exported Functions                                            ***/
+/****************************************************************************/
+
+/****************************************************************************
+ *
+ * NAME: RTCP_bIsRtcp
+ *
+ * DESCRIPTION:
+ * Tells RTCP from RTP by the packet type of the first packet (RFC 5761
+ * section 4), so both can share a port
+ *
+ * RETURNS:
+ * bool_t TRUE if the datagram is RTCP, FALSE otherwise
+ *
+ ****************************************************************************/
+bool_t RTCP_bIsRtcp(const uint8_t *pu8Data, uint32_t u32Length)
+{
+    if(u32Length < RTCP_HEADER_LENGTH)
+    {
+        return FALSE;
+    }
+
+    return (((pu8Data[0] >> 6) == RTCP_VERSION) && (pu8Data[1] >= RTCP_TYPE_FIRST) && (pu8Data[1] <= RTCP_TYPE_LAST)) ? TRUE : FALSE;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: RTCP_bParseSenderReport
+ *
+ * DESCRIPTION:
+ * Walks a compound RTCP packet and parses the sender info of the first
+ * sender report in it (RFC 3550 section 6.4.1)
+ *
+ * RETURNS:
+ * bool_t TRUE if a sender report was found, FALSE otherwise
+ *
+ ****************************************************************************/
+bool_t RTCP_bParseSenderReport(const uint8_t *pu8Data, uint32_t u32Length, RTCP_tsSenderReport *psReport)
+{
+    uint32_t u32Offset = 0;
+    uint32_t u32PacketLength;
+
+    while(u32Offset + RTCP_HEADER_LENGTH <= u32Length)
+    {
+        if((pu8Data[u32Offset] >> 6) != RTCP_VERSION)
+        {
+            return FALSE;
+        }
+
+        // The length is in 32 bit words minus one
+        u32PacketLength = ((((uint32_t)pu8Data[u32Offset + 2] << 8) | pu8Data[u32Offset + 3]) + 1) * 4;
+        if(u32Offset + u32PacketLength > u32Length)
+        {
+            return FALSE;
+        }
+
+        if((pu8Data[u32Offset + 1] == RTCP_TYPE_SR) && (u32PacketLength >= RTCP_SR_LENGTH))
+        {
+            psReport->u32Ssrc         = RTCP_u32Read32(&pu8Data[u32Offset + 4]);
+            psReport->u64NtpTime      = ((uint64_t)RTCP_u32Read32(&pu8Data[u32Offset + 8]) << 32) | RTCP_u32Read32(&pu8Data[u32Offset + 12]);
+            psReport->u32RtpTimestamp = RTCP_u32Read32(&pu8Data[u32Offset + 16]);
+            psReport->u32PacketCount  = RTCP_u32Read32(&pu8Data[u32Offset + 20]);
+            psReport->u32OctetCount   = RTCP_u32Read32(&pu8Data[u32Offset + 24]);
+            return TRUE;
+        }
+
+        u32Offset += u32PacketLength;
+    }
+
+    return FALSE;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: RTCP_u64NtpToUnixUs
+ *
+ * DESCRIPTION:
+ * Converts an NTP timestamp to microseconds since the Unix epoch
+ *
+ * RETURNS:
+ * uint64_t The time in microseconds, 0 if it is before the epoch
+ *
+ ****************************************************************************/
+uint64_t RTCP_u64NtpToUnixUs(uint64_t u64NtpTime)
+{
+    uint64_t u64Seconds = u64NtpTime >> 32;
+
+    if(u64Seconds < RTCP_NTP_UNIX_OFFSET)
+    {
+        return 0;
+    }
+
+    return ((u64Seconds - RTCP_NTP_UNIX_OFFSET) * 1000000ULL) + (((u64NtpTime & 0xffffffffULL) * 1000000ULL) >> 32);
+}
+
+
+/****************************************************************************
+ *
+ * NAME: RTCP_vUpdateClock
+ *
+ * DESCRIPTION:
+ * Takes the RTP to wall clock mapping from a sender report
+ *
+ * RETURNS:
+ * void
+ *
+ ****************************************************************************/
+void RTCP_vUpdateClock(RTCP_tsClock *psClock, RTCP_tsSenderReport *psReport, uint32_t u32ClockRate, uint64_t u64TimeUs)
+{
+    psClock->u32ClockRate = u32ClockRate;
+    psClock->u64NtpTime = psReport->u64NtpTime;
+    psClock->u32RtpTimestamp = psReport->u32RtpTimestamp;
+    psClock->u64ReceivedUs = u64TimeUs;
+    psClock->bValid = (RTCP_u64NtpToUnixUs(psReport->u64NtpTime) != 0) ? TRUE : FALSE;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: RTCP_bGetWallClockUs
+ *
+ * DESCRIPTION:
+ * Converts an RTP timestamp to the sender's wall clock. Timestamps up to
+ * half the RTP timestamp range either side of the sender report work, so
+ * frames from before the report map as well as those after it.
+ *
+ * RETURNS:
+ * bool_t TRUE if successful, FALSE if no sender report has been received
+ *
+ ****************************************************************************/
+bool_t RTCP_bGetWallClockUs(RTCP_tsClock *psClock, uint32_t u32Timestamp, uint64_t *pu64WallClockUs)
+{
+    int64_t i64Ticks;
+
+    if(!psClock->bValid || (psClock->u32ClockRate == 0))
+    {
+        return FALSE;
+    }
+
+    i64Ticks = (int32_t)(u32Timestamp - psClock->u32RtpTimestamp);
+    *pu64WallClockUs = (uint64_t)((int64_t)RTCP_u64NtpToUnixUs(psClock->u64NtpTime) + (i64Ticks * 1000000LL) / (int64_t)psClock->u32ClockRate);
+
+    return TRUE;
+}
+
+
+
+/****************************************************************************
+ *
+ * NAME: RTCP_vGetLastSr
+ *
+ * DESCRIPTION:
+ * Gets the LSR and DLSR fields of a reception report (RFC 3550 section
+ * 6.4.1), which let the sender work out the round trip time
+ *
+ * RETURNS:
+ * void
+ *
+ ****************************************************************************/
+void RTCP_vGetLastSr(RTCP_tsClock *psClock, uint64_t u64TimeUs, uint32_t *pu32LastSr, uint32_t *pu32DelaySinceLastSr)
+{
+    if(!psClock->bValid)
+    {
+        *pu32LastSr = 0;
+        *pu32DelaySinceLastSr = 0;
+        return;
+    }
+
+    *pu32LastSr = (uint32_t)(psClock->u64NtpTime >> 16);
+    *pu32DelaySinceLastSr = (uint32_t)(((u64TimeUs - psClock->u64ReceivedUs) << 16) / 1000000ULL);
+}
+
+
+/****************************************************************************
+ *
+ * NAME: RTCP_u64GetNtpTime
+ *
+ * DESCRIPTION:
+ * Gets the host's wall clock as an NTP timestamp
+ *
+ * RETURNS:
+ * uint64_t 32.32 fixed point seconds since 1900
+ *
+ ****************************************************************************/
+uint64_t RTCP_u64GetNtpTime(void)
+{
+    uint64_t u64Seconds;
+    uint64_t u64Nanoseconds;
+
+#ifdef _WIN32
+    FILETIME sFileTime;
+    uint64_t u64Ticks;
+
+    // 100ns ticks since 1601
+    GetSystemTimeAsFileTime(&sFileTime);
+    u64Ticks = ((uint64_t)sFileTime.dwHighDateTime << 32) | sFileTime.dwLowDateTime;
+    u64Seconds = (u64Ticks / 10000000ULL) - 11644473600ULL;
+    u64Nanoseconds = (u64Ticks % 10000000ULL) * 100ULL;
+#else
+    struct timespec sTime;
+
+    clock_gettime(CLOCK_REALTIME, &sTime);
+    u64Seconds = (uint64_t)sTime.tv_sec;
+    u64Nanoseconds = (uint64_t)sTime.tv_nsec;
+#endif
+
+    return ((u64Seconds + RTCP_NTP_UNIX_OFFSET) << 32) | ((u64Nanoseconds << 32) / 1000000000ULL);
+}
+
+
+/****************************************************************************
+ *
+ * NAME: RTCP_u32BuildReceiverReport
+ *
+ * DESCRIPTION:
+ * Builds a compound packet of a receiver report with one report block, the
+ * SDES CNAME every compound packet must carry, and an extended report with
+ * a receiver reference time block. A sender that supports RFC 3611 answers
+ * the last with a DLRR block, from which the round trip time follows.
+ * pu8Buffer must hold RTCP_MAX_PACKET_LENGTH bytes.
+ *
+ * RETURNS:
+ * uint32_t The length of the packet
+ *
+ ****************************************************************************/
+uint32_t RTCP_u32BuildReceiverReport(uint8_t *pu8Buffer, uint32_t u32Ssrc, RTCP_tsReportBlock *psBlock, const char *pcCname, uint64_t u64NtpTime)
+{
+    uint32_t u32Offset = 0;
+    uint32_t u32CnameLength = (uint32_t)strlen(pcCname);
+    uint32_t u32SdesLength;
+    int32_t i32Lost;
+
+    if(u32CnameLength > 64)
+    {
+        u32CnameLength = 64;
+    }
+
+    // Receiver report with one report block
+    pu8Buffer[u32Offset++] = (RTCP_VERSION << 6) | 1;
+    pu8Buffer[u32Offset++] = RTCP_TYPE_RR;
+    pu8Buffer[u32Offset++] = 0;
+    pu8Buffer[u32Offset++] = 7;
+    u32Offset += RTCP_u32Write32(&pu8Buffer[u32Offset], u32Ssrc);
+    u32Offset += RTCP_u32Write32(&pu8Buffer[u32Offset], psBlock->u32Ssrc);
+
+    // The cumulative number lost is clamped to 24 bits
+    i32Lost = psBlock->i32CumulativeLost;
+    if(i32Lost > 0x7fffff) i32Lost = 0x7fffff;
+    if(i32Lost < -0x800000) i32Lost = -0x800000;
+    u32Offset += RTCP_u32Write32(&pu8Buffer[u32Offset], ((uint32_t)psBlock->u8FractionLost << 24) | ((uint32_t)i32Lost & 0xffffff));
+    u32Offset += RTCP_u32Write32(&pu8Buffer[u32Offset], psBlock->u32HighestSeq);
+    u32Offset += RTCP_u32Write32(&pu8Buffer[u32Offset], psBlock->u32Jitter);
+    u32Offset += RTCP_u32Write32(&pu8Buffer[u32Offset], psBlock->u32LastSr);
+    u32Offset += RTCP_u32Write32(&pu8Buffer[u32Offset], psBlock->u32DelaySinceLastSr);
+
+    // Source description with the CNAME item, padded with at least one null to a 32 bit boundary
+    u32SdesLength = (4 + 4 + 2 + u32CnameLength + 4) & ~3U;
+    memset(&pu8Buffer[u32Offset], 0, u32SdesLength);
+    pu8Buffer[u32Offset + 0] = (RTCP_VERSION << 6) | 1;
+    pu8Buffer[u32Offset + 1] = RTCP_TYPE_SDES;
+    pu8Buffer[u32Offset + 2] = 0;
+    pu8Buffer[u32Offset + 3] = (uint8_t)(u32SdesLength / 4 - 1);
+    RTCP_u32Write32(&pu8Buffer[u32Offset + 4], u32Ssrc);
+    pu8Buffer[u32Offset + 8] = RTCP_SDES_CNAME;
+    pu8Buffer[u32Offset + 9] = (uint8_t)u32CnameLength;
+    memcpy(&pu8Buffer[u32Offset + 10], pcCname, u32CnameLength);
+    u32Offset += u32SdesLength;
+
+    // Extended report with a receiver reference time block
+    pu8Buffer[u32Offset++] = (RTCP_VERSION << 6);
+    pu8Buffer[u32Offset++] = RTCP_TYPE_XR;
+    pu8Buffer[u32Offset++] = 0;
+    pu8Buffer[u32Offset++] = 4;
+    u32Offset += RTCP_u32Write32(&pu8Buffer[u32Offset], u32Ssrc);
+    pu8Buffer[u32Offset++] = RTCP_XR_BLOCK_RRTR;
+    pu8Buffer[u32Offset++] = 0;
+    pu8Buffer[u32Offset++] = 0;
+    pu8Buffer[u32Offset++] = 2;
+    u32Offset += RTCP_u32Write32(&pu8Buffer[u32Offset], (uint32_t)(u64NtpTime >> 32));
+    u32Offset += RTCP_u32Write32(&pu8Buffer[u32Offset], (uint32_t)u64NtpTime);
+
+    return u32Offset;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: RTCP_bParseDlrr
+ *
+ * DESCRIPTION:
+ * Walks a compound RTCP packet for an extended report holding a DLRR
+ * sub-block about u32Ssrc (RFC 3611 section 4.5)
+ *
+ * RETURNS:
+ * bool_t TRUE if one was found, FALSE otherwise
+ *
+ ****************************************************************************/
+bool_t RTCP_bParseDlrr(const uint8_t *pu8Data, uint32_t u32Length, uint32_t u32Ssrc, uint32_t *pu32SenderSsrc, uint32_t *pu32LastRr, uint32_t *pu32DelaySinceLastRr)
+{
+    uint32_t u32Offset = 0;
+    uint32_t u32PacketLength;
+    uint32_t u32BlockOffset;
+    uint32_t u32BlockLength;
+    uint32_t u32SubBlock;
+
+    while(u32Offset + RTCP_HEADER_LENGTH <= u32Length)
+    {
+        if((pu8Data[u32Offset] >> 6) != RTCP_VERSION)
+        {
+            return FALSE;
+        }
+
+        u32PacketLength = ((((uint32_t)pu8Data[u32Offset + 2] << 8) | pu8Data[u32Offset + 3]) + 1) * 4;
+        if(u32Offset + u32PacketLength > u32Length)
+        {
+            return FALSE;
+        }
+
+        if((pu8Data[u32Offset + 1] == RTCP_TYPE_XR) && (u32PacketLength >= 8))
+        {
+            // Report blocks follow the sender's SSRC, each with a 4 byte header and its length in 32 bit words
+            u32BlockOffset = u32Offset + 8;
+            while(u32BlockOffset + 4 <= u32Offset + u32PacketLength)
+            {
+                u32BlockLength = (((uint32_t)pu8Data[u32BlockOffset + 2] << 8) | pu8Data[u32BlockOffset + 3]) * 4;
+                if(u32BlockOffset + 4 + u32BlockLength > u32Offset + u32PacketLength)
+                {
+                    break;
+                }
+
+                if(pu8Data[u32BlockOffset] == RTCP_XR_BLOCK_DLRR)
+                {
+                    for(u32SubBlock = u32BlockOffset + 4; u32SubBlock + 12 <= u32BlockOffset + 4 + u32BlockLength; u32SubBlock += 12)
+                    {
+                        if(RTCP_u32Read32(&pu8Data[u32SubBlock]) == u32Ssrc)
+                        {
+                            *pu32SenderSsrc = RTCP_u32Read32(&pu8Data[u32Offset + 4]);
+                            *pu32LastRr = RTCP_u32Read32(&pu8Data[u32SubBlock + 4]);
+                            *pu32DelaySinceLastRr = RTCP_u32Read32(&pu8Data[u32SubBlock + 8]);
+                            return TRUE;
+                        }
+                    }
+                }
+                u32BlockOffset += 4 + u32BlockLength;
+            }
+        }
+
+        u32Offset += u32PacketLength;
+    }
+
+    return FALSE;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: RTCP_u32GetRoundTripUs
+ *
+ * DESCRIPTION:
+ * Works out the round trip time from a DLRR sub-block received at
+ * u64NtpTime: the time since the reference time it echoes, less the time
+ * the sender held it. All in the middle 32 bits of NTP time.
+ *
+ * RETURNS:
+ * uint32_t The round trip time in microseconds, 0 if the block is invalid
+ *
+ ****************************************************************************/
+uint32_t RTCP_u32GetRoundTripUs(uint64_t u64NtpTime, uint32_t u32LastRr, uint32_t u32DelaySinceLastRr)
+{
+    uint32_t u32Now = (uint32_t)(u64NtpTime >> 16);
+    uint32_t u32RoundTrip;
+
+    if(u32LastRr == 0)
+    {
+        return 0;
+    }
+
+    u32RoundTrip = u32Now - u32LastRr - u32DelaySinceLastRr;
+    if(u32RoundTrip > 0x80000000UL)
+    {
+        // The sender's delay is longer than the time since our report, its clock is off
+        return 0;
+    }
+
+    return (uint32_t)(((uint64_t)u32RoundTrip * 1000000ULL) >> 16);
+}
+
+/****************************************************************************/
+/***        Local Functions                                               ***/
+/****************************************************************************/
+
+/****************************************************************************
+ *
+ * NAME: RTCP_u32Read32
+ *
+ * DESCRIPTION:
+ * Reads a big endian 32 bit value
+ *
+ * RETURNS:
+ * uint32_t The value
+ *
+ ****************************************************************************/
+static uint32_t RTCP_u32Read32(const uint8_t *pu8Data)
+{
+    return ((uint32_t)pu8Data[0] << 24) | ((uint32_t)pu8Data[1] << 16) | ((uint32_t)pu8Data[2] << 8) | pu8Data[3];
+}
+
+
+
+/****************************************************************************
+ *
+ * NAME: RTCP_u32Write32
+ *
+ * DESCRIPTION:
+ * Writes a big endian 32 bit value
+ *
+ * RETURNS:
+ * uint32_t The number of bytes written
+ *
+ ****************************************************************************/
+static uint32_t RTCP_u32Write32(uint8_t *pu8Data, uint32_t u32Value)
+{
+    pu8Data[0] = (uint8_t)(u32Value >> 24);
+    pu8Data[1] = (uint8_t)(u32Value >> 16);
+    pu8Data[2] = (uint8_t)(u32Value >> 8);
+    pu8Data[3] = (uint8_t)u32Value;
+
+    return 4;
+}
+
+/****************************************************************************/
+/***        END OF FILE                                                   ***/
+/****************************************************************************/
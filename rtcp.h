@@ -0,0 +1,88 @@
+#ifndef RTCP_H
+#define RTCP_H
+
+/****************************************************************************/
+/***        Include files                                                 ***/
+/****************************************************************************/
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "common.h"
+
+/****************************************************************************/
+/***        Macro Definitions                                             ***/
+/****************************************************************************/
+
+#define RTCP_VERSION                    2
+#define RTCP_HEADER_LENGTH              4
+
+#define RTCP_TYPE_FIRST                 192                 // Packet types that can't be mistaken for RTP
+#define RTCP_TYPE_LAST                  223
+#define RTCP_TYPE_SR                    200
+#define RTCP_TYPE_RR                    201
+#define RTCP_TYPE_SDES                  202
+#define RTCP_TYPE_BYE                   203
+#define RTCP_TYPE_APP                   204
+#define RTCP_TYPE_XR                    207                 // Extended reports, RFC 3611
+
+#define RTCP_XR_BLOCK_RRTR              4                   // Receiver reference time
+#define RTCP_XR_BLOCK_DLRR              5                   // Delay since last receiver report
+
+#define RTCP_SR_LENGTH                  28                  // Header, SSRC and sender info, without report blocks
+#define RTCP_NTP_UNIX_OFFSET            2208988800ULL       // Seconds from 1900 to 1970
+#define RTCP_SDES_CNAME                 1
+#define RTCP_MAX_PACKET_LENGTH          256
+
+/****************************************************************************/
+/***        Type Definitions                                              ***/
+/****************************************************************************/
+
+typedef struct {
+    uint32_t u32Ssrc;
+    uint64_t u64NtpTime;                            // 32.32 fixed point seconds since 1900
+    uint32_t u32RtpTimestamp;                       // Same instant as u64NtpTime on the RTP clock
+    uint32_t u32PacketCount;
+    uint32_t u32OctetCount;
+} RTCP_tsSenderReport;
+
+// Reception report about one source, as carried in receiver reports
+typedef struct {
+    uint32_t u32Ssrc;                               // Of the source reported on
+    uint8_t u8FractionLost;                         // Since the previous report, out of 256
+    int32_t i32CumulativeLost;                      // 24 bit signed on the wire
+    uint32_t u32HighestSeq;                         // Extended highest sequence number received
+    uint32_t u32Jitter;                             // In RTP timestamp units
+    uint32_t u32LastSr;                             // Middle 32 bits of the NTP time of the last sender report, 0 if none
+    uint32_t u32DelaySinceLastSr;                   // In units of 1/65536 seconds
+} RTCP_tsReportBlock;
+
+// Maps a sender's RTP timestamps to its wall clock, from its latest sender report
+typedef struct {
+    bool_t bValid;
+    uint32_t u32ClockRate;
+    uint64_t u64NtpTime;
+    uint32_t u32RtpTimestamp;
+    uint64_t u64ReceivedUs;                         // Arrival time of the sender report on the monotonic clock
+} RTCP_tsClock;
+
+/****************************************************************************/
+/***        Exported Functions                                            ***/
+/****************************************************************************/
+
+bool_t RTCP_bIsRtcp(const uint8_t *pu8Data, uint32_t u32Length);
+bool_t RTCP_bParseSenderReport(const uint8_t *pu8Data, uint32_t u32Length, RTCP_tsSenderReport *psReport);
+uint64_t RTCP_u64NtpToUnixUs(uint64_t u64NtpTime);
+void RTCP_vUpdateClock(RTCP_tsClock *psClock, RTCP_tsSenderReport *psReport, uint32_t u32ClockRate, uint64_t u64TimeUs);
+bool_t RTCP_bGetWallClockUs(RTCP_tsClock *psClock, uint32_t u32Timestamp, uint64_t *pu64WallClockUs);
+void RTCP_vGetLastSr(RTCP_tsClock *psClock, uint64_t u64TimeUs, uint32_t *pu32LastSr, uint32_t *pu32DelaySinceLastSr);
+uint64_t RTCP_u64GetNtpTime(void);
+uint32_t RTCP_u32BuildReceiverReport(uint8_t *pu8Buffer, uint32_t u32Ssrc, RTCP_tsReportBlock *psBlock, const char *pcCname, uint64_t u64NtpTime);
+bool_t RTCP_bParseDlrr(const uint8_t *pu8Data, uint32_t u32Length, uint32_t u32Ssrc, uint32_t *pu32SenderSsrc, uint32_t *pu32LastRr, uint32_t *pu32DelaySinceLastRr);
+uint32_t RTCP_u32GetRoundTripUs(uint64_t u64NtpTime, uint32_t u32LastRr, uint32_t u32DelaySinceLastRr);
+
+#endif // RTCP_H
+
+/****************************************************************************/
+/***        END OF FILE                                                   ***/
+/****************************************************************************/
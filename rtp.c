@@ -0,0 +1,200 @@
+/****************************************************************************
+ *
+ * Copyright 2021 Lee Mitchell <lee@indigopepper.com>
+ * This file is part of OCC (Orlaco Camera Configurator)
+ *
+ * OCC (Orlaco Camera Configurator) is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * OCC (Orlaco Camera Configurator) is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with OCC (Orlaco Camera Configurator).  If not,
+ * see <http://www.gnu.org/licenses/>.
+ *
+ ****************************************************************************/
+
+/****************************************************************************/
+/***        Include files                                                 ***/
+/****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "common.h"
+#include "rtp.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+/****************************************************************************/
+/***        Macro Definitions                                             ***/
+/****************************************************************************/
+
+/****************************************************************************/
+/***        Type Definitions                                              ***/
+/****************************************************************************/
+
+/****************************************************************************/
+/***        Local Function Prototypes                                     ***/
+/****************************************************************************/
+
+/****************************************************************************/
+/***        Exported Variables                                            ***/
+/****************************************************************************/
+
+/****************************************************************************/
+/***        Local Variables                                               ***/
+/****************************************************************************/
+
+/****************************************************************************/
+/***        Exported Functions                                            ***/
+/****************************************************************************/
+
+/****************************************************************************
+ *
+ * NAME: RTP_bParsePacket
+ *
+ * DESCRIPTION:
+ * Parses the fixed RTP header (RFC 3550 section 5.1), skipping any CSRC
+ * list and header extension, and strips padding from the payload
+ *
+ * RETURNS:
+ * bool_t TRUE if the packet is a valid RTP packet, FALSE otherwise
+ *
+ ****************************************************************************/
+bool_t RTP_bParsePacket(const uint8_t *pu8Data, uint32_t u32Length, RTP_tsPacket *psPacket)
+{
+    uint32_t u32Offset = RTP_HEADER_LENGTH;
+    uint32_t u32ExtensionLength;
+    uint8_t u8PaddingLength;
+
+    if(u32Length < RTP_HEADER_LENGTH)
+    {
+        return FALSE;
+    }
+
+    psPacket->u8Version         = (pu8Data[0] >> 6) & 0x03;
+    psPacket->bPadding          = (pu8Data[0] >> 5) & 0x01;
+    psPacket->bExtension        = (pu8Data[0] >> 4) & 0x01;
+    psPacket->u8CsrcCount       = (pu8Data[0] >> 0) & 0x0f;
+    psPacket->bMarker           = (pu8Data[1] >> 7) & 0x01;
+    psPacket->u8PayloadType     = (pu8Data[1] >> 0) & 0x7f;
+    psPacket->u16SequenceNumber = (uint16_t)((pu8Data[2] << 8) | pu8Data[3]);
+    psPacket->u32Timestamp      = ((uint32_t)pu8Data[4] << 24) | ((uint32_t)pu8Data[5] << 16) | ((uint32_t)pu8Data[6] << 8) | pu8Data[7];
+    psPacket->u32Ssrc           = ((uint32_t)pu8Data[8] << 24) | ((uint32_t)pu8Data[9] << 16) | ((uint32_t)pu8Data[10] << 8) | pu8Data[11];
+
+    if(psPacket->u8Version != RTP_VERSION)
+    {
+        return FALSE;
+    }
+
+    // Skip the contributing source list
+    u32Offset += psPacket->u8CsrcCount * 4;
+
+    // Skip the header extension, its length is given in 32 bit words
+    if(psPacket->bExtension)
+    {
+        if(u32Offset + 4 > u32Length)
+        {
+            return FALSE;
+        }
+        u32ExtensionLength = ((pu8Data[u32Offset + 2] << 8) | pu8Data[u32Offset + 3]) * 4;
+        u32Offset += 4 + u32ExtensionLength;
+    }
+
+    if(u32Offset > u32Length)
+    {
+        return FALSE;
+    }
+
+    // The last byte of the packet holds the number of padding bytes to ignore
+    if(psPacket->bPadding)
+    {
+        u8PaddingLength = pu8Data[u32Length - 1];
+        if((u8PaddingLength == 0) || (u32Offset + u8PaddingLength > u32Length))
+        {
+            return FALSE;
+        }
+        u32Length -= u8PaddingLength;
+    }
+
+    psPacket->pu8Payload = pu8Data + u32Offset;
+    psPacket->u32PayloadLength = u32Length - u32Offset;
+
+    return TRUE;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: RTP_u64GetTimeUs
+ *
+ * DESCRIPTION:
+ * Gets a monotonic timestamp used for packet arrival times
+ *
+ * RETURNS:
+ * uint64_t The time in microseconds
+ *
+ ****************************************************************************/
+uint64_t RTP_u64GetTimeUs(void)
+{
+#ifdef _WIN32
+    LARGE_INTEGER sFrequency;
+    LARGE_INTEGER sCounter;
+
+    QueryPerformanceFrequency(&sFrequency);
+    QueryPerformanceCounter(&sCounter);
+
+    return (uint64_t)((sCounter.QuadPart / sFrequency.QuadPart) * 1000000ULL +
+                      ((sCounter.QuadPart % sFrequency.QuadPart) * 1000000ULL) / sFrequency.QuadPart);
+#else
+    struct timespec sTime;
+
+    clock_gettime(CLOCK_MONOTONIC, &sTime);
+
+    return ((uint64_t)sTime.tv_sec * 1000000ULL) + ((uint64_t)sTime.tv_nsec / 1000ULL);
+#endif
+}
+
+
+/****************************************************************************
+ *
+ * NAME: RTP_pcGetCodecAsString
+ *
+ * DESCRIPTION:
+ * Gets a short name for the given codec
+ *
+ * RETURNS:
+ * char * - A pointer to the text representation of the codec
+ *
+ ****************************************************************************/
+char *RTP_pcGetCodecAsString(RTP_teCodec eCodec)
+{
+    switch(eCodec)
+    {
+    case E_RTP_CODEC_JPEG:
+        return "jpeg";
+
+    case E_RTP_CODEC_H264:
+        return "h264";
+
+    default:
+        return "unknown";
+    }
+}
+
+/****************************************************************************/
+/***        Local Functions                                               ***/
+/****************************************************************************/
+
+/****************************************************************************/
+/***        END OF FILE                                                   ***/
+/****************************************************************************/
@@ -0,0 +1,80 @@
+#ifndef RTP_H
+#define RTP_H
+
+/****************************************************************************/
+/***        Include files                                                 ***/
+/****************************************************************************/
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "common.h"
+#include "orlaco.h"
+
+/****************************************************************************/
+/***        Macro Definitions                                             ***/
+/****************************************************************************/
+
+#define RTP_VERSION                     2
+#define RTP_HEADER_LENGTH               12
+#define RTP_MAX_PACKET_LENGTH           2048
+
+#define RTP_PAYLOAD_TYPE_JPEG           26      // Static payload type from RFC 3551
+#define RTP_PAYLOAD_TYPE_DYNAMIC        96      // First dynamic payload type, H.264 has no static one
+
+/****************************************************************************/
+/***        Type Definitions                                              ***/
+/****************************************************************************/
+
+typedef enum {
+    E_RTP_CODEC_UNKNOWN = 0,
+    E_RTP_CODEC_JPEG,
+    E_RTP_CODEC_H264,
+} RTP_teCodec;
+
+// A single parsed RTP packet. The payload pointer refers into the receive buffer.
+typedef struct {
+    uint8_t u8Version;
+    bool_t bPadding;
+    bool_t bExtension;
+    uint8_t u8CsrcCount;
+    bool_t bMarker;
+    uint8_t u8PayloadType;
+    uint16_t u16SequenceNumber;
+    uint32_t u32Timestamp;
+    uint32_t u32Ssrc;
+    const uint8_t *pu8Payload;
+    uint32_t u32PayloadLength;
+    uint64_t u64ArrivalTimeUs;
+} RTP_tsPacket;
+
+// A complete, reassembled frame. pu8Data is only valid for the duration of the callback.
+typedef struct {
+    RTP_teCodec eCodec;
+    ORLACO_tuIP uSrcIP;
+    uint32_t u32Ssrc;
+    uint32_t u32Timestamp;
+    uint64_t u64FirstPacketTimeUs;                  // Arrival time of the first packet of the frame
+    uint64_t u64ArrivalTimeUs;                      // Arrival time of the packet that completed the frame
+    uint16_t u16Width;
+    uint16_t u16Height;
+    bool_t bKeyFrame;
+    uint32_t u32Length;
+    uint8_t *pu8Data;
+} RTP_tsFrame;
+
+typedef void (*RTP_tpfFrameCallback)(void *pvContext, RTP_tsFrame *psFrame);
+
+/****************************************************************************/
+/***        Exported Functions                                            ***/
+/****************************************************************************/
+
+bool_t RTP_bParsePacket(const uint8_t *pu8Data, uint32_t u32Length, RTP_tsPacket *psPacket);
+uint64_t RTP_u64GetTimeUs(void);
+char *RTP_pcGetCodecAsString(RTP_teCodec eCodec);
+
+#endif // RTP_H
+
+/****************************************************************************/
+/***        END OF FILE                                                   ***/
+/****************************************************************************/
@@ -0,0 +1,383 @@
+/****************************************************************************
+ *
+ * Copyright 2021 Lee Mitchell <lee@indigopepper.com>
+ * This file is part of OCC (Orlaco Camera Configurator)
+ *
+ * OCC (Orlaco Camera Configurator) is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * OCC (Orlaco Camera Configurator) is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with OCC (Orlaco Camera Configurator).  If not,
+ * see <http://www.gnu.org/licenses/>.
+ *
+ ****************************************************************************/
+
+/****************************************************************************/
+/***        Include files                                                 ***/
+/****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "common.h"
+#include "rtpstats.h"
+
+/****************************************************************************/
+/***        Macro Definitions                                             ***/
+/****************************************************************************/
+
+#define RTPSTATS_SEQ_MOD                (1 << 16)
+
+/****************************************************************************/
+/***        Type Definitions                                              ***/
+/****************************************************************************/
+
+/****************************************************************************/
+/***        Local Function Prototypes                                     ***/
+/****************************************************************************/
+
+static void RTPSTATS_vInitSequence(RTPSTATS_tsStream *psStats, uint16_t u16Seq);
+
+/****************************************************************************/
+/***        Exported Variables                                            ***/
+/****************************************************************************/
+
+/****************************************************************************/
+/***        Local Variables                                               ***/
+/****************************************************************************/
+
+/****************************************************************************/
+/***        Exported Functions                                            ***/
+/****************************************************************************/
+
+/****************************************************************************
+ *
+ * NAME: RTPSTATS_vInit
+ *
+ * DESCRIPTION:
+ * Resets the statistics of a stream
+ *
+ * RETURNS:
+ * void
+ *
+ ****************************************************************************/
+void RTPSTATS_vInit(RTPSTATS_tsStream *psStats, uint32_t u32ClockRate, uint64_t u64TimeUs)
+{
+    memset(psStats, 0, sizeof(RTPSTATS_tsStream));
+    psStats->u32ClockRate = u32ClockRate;
+    psStats->u64IntervalStartUs = u64TimeUs;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: RTPSTATS_vUpdatePacket
+ *
+ * DESCRIPTION:
+ * Accounts for a received packet, tracking sequence numbers for loss and
+ * reordering and the interarrival jitter
+ *
+ * RETURNS:
+ * void
+ *
+ ****************************************************************************/
+void RTPSTATS_vUpdatePacket(RTPSTATS_tsStream *psStats, RTP_tsPacket *psPacket, uint32_t u32Length)
+{
+    uint16_t u16Seq = psPacket->u16SequenceNumber;
+    uint16_t u16Delta;
+    uint32_t u32Arrival;
+    int32_t i32Transit;
+    int32_t i32D;
+
+    psStats->u64Bytes += u32Length;
+
+    if(!psStats->bStarted)
+    {
+        RTPSTATS_vInitSequence(psStats, u16Seq);
+        psStats->bStarted = TRUE;
+    }
+    else
+    {
+        u16Delta = (uint16_t)(u16Seq - psStats->u16MaxSeq);
+
+        if(u16Delta == 0)
+        {
+            psStats->u64Duplicates++;
+        }
+        else if(u16Delta < RTPSTATS_MAX_DROPOUT)
+        {
+            // In order, with a permissible gap
+            if(u16Seq < psStats->u16MaxSeq)
+            {
+                psStats->u32Cycles += RTPSTATS_SEQ_MOD;
+            }
+            psStats->u16MaxSeq = u16Seq;
+        }
+        else if(u16Delta <= RTPSTATS_SEQ_MOD - RTPSTATS_MAX_MISORDER)
+        {
+            // A very large jump, two sequential packets mean the sender restarted
+            if(u16Seq == psStats->u32BadSeq)
+            {
+                RTPSTATS_vInitSequence(psStats, u16Seq);
+            }
+            else
+            {
+                psStats->u32BadSeq = (u16Seq + 1) & (RTPSTATS_SEQ_MOD - 1);
+                return;
+            }
+        }
+        else
+        {
+            psStats->u64Reordered++;
+        }
+    }
+    psStats->u64Received++;
+
+    // Jitter is the smoothed difference of the transit times of consecutive packets
+    u32Arrival = (uint32_t)((psPacket->u64ArrivalTimeUs * psStats->u32ClockRate) / 1000000ULL);
+    i32Transit = (int32_t)(u32Arrival - psPacket->u32Timestamp);
+    if(psStats->u64Received > 1)
+    {
+        i32D = i32Transit - psStats->i32LastTransit;
+        if(i32D < 0)
+        {
+            i32D = -i32D;
+        }
+        psStats->u32Jitter += (uint32_t)i32D - ((psStats->u32Jitter + 8) >> 4);
+    }
+    psStats->i32LastTransit = i32Transit;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: RTPSTATS_vUpdateFrame
+ *
+ * DESCRIPTION:
+ * Accounts for a completed frame, tracking how long its packets took to
+ * arrive and how late it arrived compared with its RTP timestamp
+ *
+ * RETURNS:
+ * void
+ *
+ ****************************************************************************/
+void RTPSTATS_vUpdateFrame(RTPSTATS_tsStream *psStats, RTP_tsFrame *psFrame)
+{
+    uint64_t u64SpreadUs;
+    uint64_t u64DelayUs;
+    int64_t i64DelayUs;
+
+    psStats->u64Frames++;
+
+    u64SpreadUs = psFrame->u64ArrivalTimeUs - psFrame->u64FirstPacketTimeUs;
+    psStats->u64SpreadSumUs += u64SpreadUs;
+    if(u64SpreadUs > psStats->u64SpreadMaxUs)
+    {
+        psStats->u64SpreadMaxUs = u64SpreadUs;
+    }
+
+    // Unwrap the timestamp so the stream's sampling clock can be compared with ours
+    if(!psStats->bFrameStarted)
+    {
+        psStats->u64ExtendedTimestamp = psFrame->u32Timestamp;
+    }
+    else
+    {
+        psStats->u64ExtendedTimestamp += (int32_t)(psFrame->u32Timestamp - psStats->u32LastFrameTimestamp);
+    }
+    psStats->u32LastFrameTimestamp = psFrame->u32Timestamp;
+
+    i64DelayUs = (int64_t)psFrame->u64ArrivalTimeUs - (int64_t)((psStats->u64ExtendedTimestamp * 1000000ULL) / psStats->u32ClockRate);
+    if(!psStats->bFrameStarted || (i64DelayUs < psStats->i64MinDelayUs))
+    {
+        psStats->i64MinDelayUs = i64DelayUs;
+    }
+    psStats->bFrameStarted = TRUE;
+
+    u64DelayUs = (uint64_t)(i64DelayUs - psStats->i64MinDelayUs);
+    psStats->u64DelaySumUs += u64DelayUs;
+    if(u64DelayUs > psStats->u64DelayMaxUs)
+    {
+        psStats->u64DelayMaxUs = u64DelayUs;
+    }
+}
+
+
+/****************************************************************************
+ *
+ * NAME: RTPSTATS_vGetReport
+ *
+ * DESCRIPTION:
+ * Summarises the interval since the last report and starts a new interval
+ *
+ * RETURNS:
+ * void
+ *
+ ****************************************************************************/
+void RTPSTATS_vGetReport(RTPSTATS_tsStream *psStats, uint64_t u64TimeUs, RTPSTATS_tsReport *psReport)
+{
+    uint64_t u64Expected = RTPSTATS_u64GetExpected(psStats);
+    uint64_t u64Received;
+    uint64_t u64Frames;
+
+    memset(psReport, 0, sizeof(RTPSTATS_tsReport));
+
+    psReport->dIntervalS = (double)(u64TimeUs - psStats->u64IntervalStartUs) / 1000000.0;
+    if(psReport->dIntervalS <= 0.0)
+    {
+        psReport->dIntervalS = 0.000001;
+    }
+
+    u64Frames = psStats->u64Frames - psStats->u64FramesPrior;
+    u64Received = psStats->u64Received - psStats->u64ReceivedPrior;
+
+    psReport->dBitrateMbps = (double)(psStats->u64Bytes - psStats->u64BytesPrior) * 8.0 / (psReport->dIntervalS * 1000000.0);
+    psReport->dFrameRate = (double)u64Frames / psReport->dIntervalS;
+    psReport->u64Expected = u64Expected - psStats->u64ExpectedPrior;
+    psReport->u64Lost = (psReport->u64Expected > u64Received) ? (psReport->u64Expected - u64Received) : 0;
+    psReport->u64Reordered = psStats->u64Reordered - psStats->u64ReorderedPrior;
+    psReport->u64LostTotal = (u64Expected > psStats->u64Received) ? (u64Expected - psStats->u64Received) : 0;
+    psReport->dJitterMs = (double)(psStats->u32Jitter >> 4) * 1000.0 / (double)psStats->u32ClockRate;
+
+    if(u64Frames > 0)
+    {
+        psReport->dSpreadAvgMs = (double)psStats->u64SpreadSumUs / (double)u64Frames / 1000.0;
+        psReport->dDelayAvgMs = (double)psStats->u64DelaySumUs / (double)u64Frames / 1000.0;
+    }
+    psReport->dSpreadMaxMs = (double)psStats->u64SpreadMaxUs / 1000.0;
+    psReport->dDelayMaxMs = (double)psStats->u64DelayMaxUs / 1000.0;
+
+    psStats->u64IntervalStartUs = u64TimeUs;
+    psStats->u64ExpectedPrior = u64Expected;
+    psStats->u64ReceivedPrior = psStats->u64Received;
+    psStats->u64ReorderedPrior = psStats->u64Reordered;
+    psStats->u64BytesPrior = psStats->u64Bytes;
+    psStats->u64FramesPrior = psStats->u64Frames;
+    psStats->u64SpreadSumUs = 0;
+    psStats->u64SpreadMaxUs = 0;
+    psStats->u64DelaySumUs = 0;
+    psStats->u64DelayMaxUs = 0;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: RTPSTATS_u64GetExpected
+ *
+ * DESCRIPTION:
+ * Gets the number of packets the sender has sent since the stream started,
+ * from the first and the highest sequence number seen
+ *
+ * RETURNS:
+ * uint64_t The number of packets expected
+ *
+ ****************************************************************************/
+uint64_t RTPSTATS_u64GetExpected(RTPSTATS_tsStream *psStats)
+{
+    if(!psStats->bStarted)
+    {
+        return 0;
+    }
+
+    return ((uint64_t)psStats->u32Cycles + psStats->u16MaxSeq) - psStats->u32BaseSeq + 1;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: RTPSTATS_vGetReportBlock
+ *
+ * DESCRIPTION:
+ * Fills in the loss, sequence and jitter fields of a receiver report block
+ * (RFC 3550 appendix A.3). The fraction lost covers the time since the
+ * previous call. The SSRC and sender report fields are left to the caller.
+ *
+ * RETURNS:
+ * void
+ *
+ ****************************************************************************/
+void RTPSTATS_vGetReportBlock(RTPSTATS_tsStream *psStats, RTCP_tsReportBlock *psBlock)
+{
+    uint64_t u64Expected = RTPSTATS_u64GetExpected(psStats);
+    int64_t i64ExpectedInterval = (int64_t)(u64Expected - psStats->u64RtcpExpectedPrior);
+    int64_t i64ReceivedInterval = (int64_t)(psStats->u64Received - psStats->u64RtcpReceivedPrior);
+    int64_t i64LostInterval = i64ExpectedInterval - i64ReceivedInterval;
+
+    psBlock->i32CumulativeLost = (int32_t)((int64_t)u64Expected - (int64_t)psStats->u64Received);
+    psBlock->u32HighestSeq = psStats->u32Cycles + psStats->u16MaxSeq;
+    psBlock->u32Jitter = psStats->u32Jitter >> 4;
+    psBlock->u8FractionLost = 0;
+    if((i64ExpectedInterval > 0) && (i64LostInterval > 0))
+    {
+        psBlock->u8FractionLost = (i64LostInterval >= i64ExpectedInterval) ? 255 : (uint8_t)((i64LostInterval << 8) / i64ExpectedInterval);
+    }
+
+    psStats->u64RtcpExpectedPrior = u64Expected;
+    psStats->u64RtcpReceivedPrior = psStats->u64Received;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: RTPSTATS_vGetControlSample
+ *
+ * DESCRIPTION:
+ * Gets the packets expected and lost and the bytes received since the
+ * previous call, for rate control
+ *
+ * RETURNS:
+ * void
+ *
+ ****************************************************************************/
+void RTPSTATS_vGetControlSample(RTPSTATS_tsStream *psStats, uint64_t *pu64Expected, uint64_t *pu64Lost, uint64_t *pu64Bytes)
+{
+    uint64_t u64Expected = RTPSTATS_u64GetExpected(psStats);
+    uint64_t u64Received = psStats->u64Received - psStats->u64ControlReceivedPrior;
+
+    *pu64Expected = u64Expected - psStats->u64ControlExpectedPrior;
+    *pu64Lost = (*pu64Expected > u64Received) ? (*pu64Expected - u64Received) : 0;
+    *pu64Bytes = psStats->u64Bytes - psStats->u64ControlBytesPrior;
+
+    psStats->u64ControlExpectedPrior = u64Expected;
+    psStats->u64ControlReceivedPrior = psStats->u64Received;
+    psStats->u64ControlBytesPrior = psStats->u64Bytes;
+}
+
+/****************************************************************************/
+/***        Local Functions                                               ***/
+/****************************************************************************/
+
+/****************************************************************************
+ *
+ * NAME: RTPSTATS_vInitSequence
+ *
+ * DESCRIPTION:
+ * (Re)starts sequence number tracking from the given sequence number
+ *
+ * RETURNS:
+ * void
+ *
+ ****************************************************************************/
+static void RTPSTATS_vInitSequence(RTPSTATS_tsStream *psStats, uint16_t u16Seq)
+{
+    psStats->u32BaseSeq = u16Seq;
+    psStats->u16MaxSeq = u16Seq;
+    psStats->u32BadSeq = RTPSTATS_SEQ_MOD + 1;
+    psStats->u32Cycles = 0;
+    psStats->u64Received = 0;
+    psStats->u64ReceivedPrior = 0;
+    psStats->u64ExpectedPrior = 0;
+    psStats->u64ControlReceivedPrior = 0;
+    psStats->u64ControlExpectedPrior = 0;
+}
+
+/****************************************************************************/
+/***        END OF FILE                                                   ***/
+/****************************************************************************/
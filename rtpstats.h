@@ -0,0 +1,108 @@
+#ifndef RTPSTATS_H
+#define RTPSTATS_H
+
+/****************************************************************************/
+/***        Include files                                                 ***/
+/****************************************************************************/
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "common.h"
+#include "rtp.h"
+#include "rtcp.h"
+
+/****************************************************************************/
+/***        Macro Definitions                                             ***/
+/****************************************************************************/
+
+#define RTPSTATS_VIDEO_CLOCK_RATE       90000               // RTP timestamp rate of all video payload formats
+#define RTPSTATS_MAX_DROPOUT            3000                // RFC 3550 appendix A.1
+#define RTPSTATS_MAX_MISORDER           100
+
+/****************************************************************************/
+/***        Type Definitions                                              ***/
+/****************************************************************************/
+
+// Reception statistics of one stream, updated by the thread that owns the stream
+typedef struct {
+    bool_t bStarted;
+    uint32_t u32ClockRate;
+
+    // Sequence number tracking as described in RFC 3550 appendix A.1
+    uint16_t u16MaxSeq;
+    uint32_t u32Cycles;                             // Sequence number wraps, shifted by 16
+    uint32_t u32BaseSeq;
+    uint32_t u32BadSeq;
+    uint64_t u64Received;
+    uint64_t u64Reordered;
+    uint64_t u64Duplicates;
+
+    // Interarrival jitter as described in RFC 3550 appendix A.8, in timestamp units scaled by 16
+    int32_t i32LastTransit;
+    uint32_t u32Jitter;
+
+    uint64_t u64Bytes;
+    uint64_t u64Frames;
+
+    // Frame timing, the delay is relative to the quickest frame seen so far
+    bool_t bFrameStarted;
+    uint32_t u32LastFrameTimestamp;
+    uint64_t u64ExtendedTimestamp;
+    int64_t i64MinDelayUs;
+
+    // Interval state, reset every report
+    uint64_t u64IntervalStartUs;
+    uint64_t u64ExpectedPrior;
+    uint64_t u64ReceivedPrior;
+    uint64_t u64ReorderedPrior;
+    uint64_t u64BytesPrior;
+    uint64_t u64FramesPrior;
+    uint64_t u64SpreadSumUs;
+    uint64_t u64SpreadMaxUs;
+    uint64_t u64DelaySumUs;
+    uint64_t u64DelayMaxUs;
+
+    // Receiver report state as described in RFC 3550 appendix A.3, separate from the reporting interval
+    uint64_t u64RtcpExpectedPrior;
+    uint64_t u64RtcpReceivedPrior;
+
+    // Rate control sample state, separate again so sampling doesn't disturb either of the above
+    uint64_t u64ControlExpectedPrior;
+    uint64_t u64ControlReceivedPrior;
+    uint64_t u64ControlBytesPrior;
+} RTPSTATS_tsStream;
+
+// Snapshot of one reporting interval
+typedef struct {
+    double dIntervalS;
+    double dBitrateMbps;
+    double dFrameRate;
+    uint64_t u64Expected;                           // Over the interval
+    uint64_t u64Lost;                               // Over the interval, duplicates can hide losses
+    uint64_t u64Reordered;                          // Over the interval
+    uint64_t u64LostTotal;
+    double dJitterMs;
+    double dSpreadAvgMs;                            // Time from the first to the last packet of a frame
+    double dSpreadMaxMs;
+    double dDelayAvgMs;                             // Arrival delay above the best seen, grows as queues build up
+    double dDelayMaxMs;
+} RTPSTATS_tsReport;
+
+/****************************************************************************/
+/***        Exported Functions                                            ***/
+/****************************************************************************/
+
+void RTPSTATS_vInit(RTPSTATS_tsStream *psStats, uint32_t u32ClockRate, uint64_t u64TimeUs);
+void RTPSTATS_vUpdatePacket(RTPSTATS_tsStream *psStats, RTP_tsPacket *psPacket, uint32_t u32Length);
+void RTPSTATS_vUpdateFrame(RTPSTATS_tsStream *psStats, RTP_tsFrame *psFrame);
+void RTPSTATS_vGetReport(RTPSTATS_tsStream *psStats, uint64_t u64TimeUs, RTPSTATS_tsReport *psReport);
+uint64_t RTPSTATS_u64GetExpected(RTPSTATS_tsStream *psStats);
+void RTPSTATS_vGetReportBlock(RTPSTATS_tsStream *psStats, RTCP_tsReportBlock *psBlock);
+void RTPSTATS_vGetControlSample(RTPSTATS_tsStream *psStats, uint64_t *pu64Expected, uint64_t *pu64Lost, uint64_t *pu64Bytes);
+
+#endif // RTPSTATS_H
+
+/****************************************************************************/
+/***        END OF FILE                                                   ***/
+/****************************************************************************/
@@ -0,0 +1,453 @@
+/****************************************************************************
+ *
+ * Copyright 2021 Lee Mitchell <lee@indigopepper.com>
+ * This file is part of OCC (Orlaco Camera Configurator)
+ *
+ * OCC (Orlaco Camera Configurator) is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * OCC (Orlaco Camera Configurator) is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with OCC (Orlaco Camera Configurator).  If not,
+ * see <http://www.gnu.org/licenses/>.
+ *
+ ****************************************************************************/
+
+/****************************************************************************/
+/***        Include files                                                 ***/
+/****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "common.h"
+#include "rtp.h"
+#include "rxring.h"
+
+#ifdef __linux__
+#include <poll.h>
+#include <time.h>
+#include <net/if.h>
+#include <sys/mman.h>
+#include <linux/if_packet.h>
+#include <linux/if_ether.h>
+#include <linux/filter.h>
+#endif
+
+/****************************************************************************/
+/***        Macro Definitions                                             ***/
+/****************************************************************************/
+
+#define RXRING_IP_PROTOCOL_UDP          17
+#define RXRING_UDP_HEADER_LENGTH        8
+
+/****************************************************************************/
+/***        Type Definitions                                              ***/
+/****************************************************************************/
+
+/****************************************************************************/
+/***        Local Function Prototypes                                     ***/
+/****************************************************************************/
+
+#ifdef __linux__
+static uint32_t RXRING_u32BuildFilter(struct sock_filter *psFilter, uint16_t *pu16Ports, uint32_t u32NumPorts, ORLACO_tuIP *puCameraIPs, uint32_t u32NumCameraIPs);
+static void RXRING_vProcessBlock(RXRING_tsInstance *psRing, struct tpacket_block_desc *psBlock, RXRING_tpfPacketCallback prCallback, void *pvContext);
+#endif
+
+/****************************************************************************/
+/***        Exported Variables                                            ***/
+/****************************************************************************/
+
+/****************************************************************************/
+/***        Local Variables                                               ***/
+/****************************************************************************/
+
+/****************************************************************************/
+/***        Exported Functions                                            ***/
+/****************************************************************************/
+
+#ifdef __linux__
+
+/****************************************************************************
+ *
+ * NAME: RXRING_bOpen
+ *
+ * DESCRIPTION:
+ * Opens a packet socket with a memory mapped TPACKET_V3 receive ring.
+ * A BPF filter is attached so that only UDP datagrams from the given cameras
+ * (any camera if none given) to the given ports are copied into the ring.
+ * The kernel fills whole blocks of packets, so one wake up hands over many
+ * packets without any per packet system call or copy.
+ *
+ * If u16FanoutGroup is non zero the socket joins that fanout group, hashing
+ * each flow onto one of the group's sockets.
+ *
+ * RETURNS:
+ * bool_t TRUE if successful, FALSE otherwise
+ *
+ ****************************************************************************/
+bool_t RXRING_bOpen(RXRING_tsInstance *psRing, char *pcInterface, uint16_t *pu16Ports, uint32_t u32NumPorts, ORLACO_tuIP *puCameraIPs, uint32_t u32NumCameraIPs, uint16_t u16FanoutGroup)
+{
+    struct sock_filter asFilter[RXRING_MAX_FILTER_LENGTH];
+    struct sock_fprog sProgram;
+    struct tpacket_req3 sRequest;
+    struct sockaddr_ll sAddr;
+    int iVersion = TPACKET_V3;
+    int iFanout;
+
+    memset(psRing, 0, sizeof(RXRING_tsInstance));
+    psRing->iSocket = -1;
+
+    sProgram.len = (unsigned short)RXRING_u32BuildFilter(asFilter, pu16Ports, u32NumPorts, puCameraIPs, u32NumCameraIPs);
+    sProgram.filter = asFilter;
+    if(sProgram.len == 0)
+    {
+        printf("Error: Too many ports or cameras for the packet filter in %s\n", __FUNCTION__);
+        return FALSE;
+    }
+
+    // Protocol 0 receives nothing until the filter and ring are in place and the socket is bound
+    psRing->iSocket = socket(AF_PACKET, SOCK_DGRAM, 0);
+    if(psRing->iSocket < 0)
+    {
+        printf("Error: Can't create packet socket in %s (CAP_NET_RAW is required)\n", __FUNCTION__);
+        return FALSE;
+    }
+
+    if(setsockopt(psRing->iSocket, SOL_SOCKET, SO_ATTACH_FILTER, &sProgram, sizeof(sProgram)) != 0)
+    {
+        printf("Error: Can't attach packet filter in %s\n", __FUNCTION__);
+        RXRING_vClose(psRing);
+        return FALSE;
+    }
+
+    if(setsockopt(psRing->iSocket, SOL_PACKET, PACKET_VERSION, &iVersion, sizeof(iVersion)) != 0)
+    {
+        printf("Error: TPACKET_V3 isn't supported in %s\n", __FUNCTION__);
+        RXRING_vClose(psRing);
+        return FALSE;
+    }
+
+    memset(&sRequest, 0, sizeof(sRequest));
+    sRequest.tp_block_size = RXRING_BLOCK_SIZE;
+    sRequest.tp_block_nr = RXRING_NUM_BLOCKS;
+    sRequest.tp_frame_size = RXRING_FRAME_SIZE;
+    sRequest.tp_frame_nr = (RXRING_BLOCK_SIZE / RXRING_FRAME_SIZE) * RXRING_NUM_BLOCKS;
+    sRequest.tp_retire_blk_tov = RXRING_BLOCK_TIMEOUT_MS;
+
+    if(setsockopt(psRing->iSocket, SOL_PACKET, PACKET_RX_RING, &sRequest, sizeof(sRequest)) != 0)
+    {
+        printf("Error: Can't create packet ring in %s\n", __FUNCTION__);
+        RXRING_vClose(psRing);
+        return FALSE;
+    }
+
+    psRing->u32RingLength = RXRING_BLOCK_SIZE * RXRING_NUM_BLOCKS;
+    psRing->pu8Ring = (uint8_t*)mmap(NULL, psRing->u32RingLength, PROT_READ | PROT_WRITE, MAP_SHARED, psRing->iSocket, 0);
+    if(psRing->pu8Ring == MAP_FAILED)
+    {
+        printf("Error: Can't map packet ring in %s\n", __FUNCTION__);
+        psRing->pu8Ring = NULL;
+        RXRING_vClose(psRing);
+        return FALSE;
+    }
+
+    memset(&sAddr, 0, sizeof(sAddr));
+    sAddr.sll_family = AF_PACKET;
+    sAddr.sll_protocol = htons(ETH_P_IP);
+    if((pcInterface != NULL) && (strcmp(pcInterface, "any") != 0))
+    {
+        sAddr.sll_ifindex = (int)if_nametoindex(pcInterface);
+        if(sAddr.sll_ifindex == 0)
+        {
+            printf("Error: Unknown interface %s in %s\n", pcInterface, __FUNCTION__);
+            RXRING_vClose(psRing);
+            return FALSE;
+        }
+    }
+
+    if(bind(psRing->iSocket, (struct sockaddr*)&sAddr, sizeof(sAddr)) != 0)
+    {
+        printf("Error: Can't bind packet socket in %s\n", __FUNCTION__);
+        RXRING_vClose(psRing);
+        return FALSE;
+    }
+
+    if(u16FanoutGroup != 0)
+    {
+        iFanout = u16FanoutGroup | (PACKET_FANOUT_HASH << 16);
+        if(setsockopt(psRing->iSocket, SOL_PACKET, PACKET_FANOUT, &iFanout, sizeof(iFanout)) != 0)
+        {
+            printf("Error: Can't join packet fanout group in %s\n", __FUNCTION__);
+            RXRING_vClose(psRing);
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: RXRING_vClose
+ *
+ * DESCRIPTION:
+ * Unmaps the ring and closes the packet socket
+ *
+ * RETURNS:
+ * void
+ *
+ ****************************************************************************/
+void RXRING_vClose(RXRING_tsInstance *psRing)
+{
+    if(psRing->pu8Ring != NULL)
+    {
+        munmap(psRing->pu8Ring, psRing->u32RingLength);
+        psRing->pu8Ring = NULL;
+    }
+
+    if(psRing->iSocket >= 0)
+    {
+        close(psRing->iSocket);
+        psRing->iSocket = -1;
+    }
+}
+
+
+/****************************************************************************
+ *
+ * NAME: RXRING_bReceive
+ *
+ * DESCRIPTION:
+ * Waits up to iTimeoutMs for the kernel to hand over a block, then passes
+ * every packet in each ready block to the callback and returns the blocks
+ * to the kernel
+ *
+ * RETURNS:
+ * bool_t TRUE if successful, FALSE on a socket error
+ *
+ ****************************************************************************/
+bool_t RXRING_bReceive(RXRING_tsInstance *psRing, int iTimeoutMs, RXRING_tpfPacketCallback prCallback, void *pvContext)
+{
+    struct tpacket_block_desc *psBlock;
+    struct pollfd sPollFd;
+    uint32_t u32NumBlocks;
+
+    psBlock = (struct tpacket_block_desc*)(psRing->pu8Ring + (psRing->u32CurrentBlock * RXRING_BLOCK_SIZE));
+
+    if((__atomic_load_n(&psBlock->hdr.bh1.block_status, __ATOMIC_ACQUIRE) & TP_STATUS_USER) == 0)
+    {
+        sPollFd.fd = psRing->iSocket;
+        sPollFd.events = POLLIN | POLLERR;
+        sPollFd.revents = 0;
+        if(poll(&sPollFd, 1, iTimeoutMs) < 0)
+        {
+            return FALSE;
+        }
+    }
+
+    // Drain every block that is ready, but never lap the ring
+    for(u32NumBlocks = 0; u32NumBlocks < RXRING_NUM_BLOCKS; u32NumBlocks++)
+    {
+        psBlock = (struct tpacket_block_desc*)(psRing->pu8Ring + (psRing->u32CurrentBlock * RXRING_BLOCK_SIZE));
+        if((__atomic_load_n(&psBlock->hdr.bh1.block_status, __ATOMIC_ACQUIRE) & TP_STATUS_USER) == 0)
+        {
+            break;
+        }
+
+        RXRING_vProcessBlock(psRing, psBlock, prCallback, pvContext);
+
+        __atomic_store_n(&psBlock->hdr.bh1.block_status, TP_STATUS_KERNEL, __ATOMIC_RELEASE);
+        psRing->u32CurrentBlock = (psRing->u32CurrentBlock + 1) % RXRING_NUM_BLOCKS;
+    }
+
+    return TRUE;
+}
+
+#else
+
+bool_t RXRING_bOpen(RXRING_tsInstance *psRing, char *pcInterface, uint16_t *pu16Ports, uint32_t u32NumPorts, ORLACO_tuIP *puCameraIPs, uint32_t u32NumCameraIPs, uint16_t u16FanoutGroup)
+{
+    printf("Error: Packet ring capture is only supported on Linux\n");
+    return FALSE;
+}
+
+void RXRING_vClose(RXRING_tsInstance *psRing)
+{
+}
+
+bool_t RXRING_bReceive(RXRING_tsInstance *psRing, int iTimeoutMs, RXRING_tpfPacketCallback prCallback, void *pvContext)
+{
+    return FALSE;
+}
+
+#endif
+
+/****************************************************************************/
+/***        Local Functions                                               ***/
+/****************************************************************************/
+
+#ifdef __linux__
+
+/****************************************************************************
+ *
+ * NAME: RXRING_u32BuildFilter
+ *
+ * DESCRIPTION:
+ * Builds a classic BPF program accepting unfragmented IPv4 UDP datagrams
+ * from the given source addresses to the given destination ports. The
+ * program runs on the network header as the socket is SOCK_DGRAM.
+ *
+ * RETURNS:
+ * uint32_t The number of instructions, 0 if the program doesn't fit
+ *
+ ****************************************************************************/
+static uint32_t RXRING_u32BuildFilter(struct sock_filter *psFilter, uint16_t *pu16Ports, uint32_t u32NumPorts, ORLACO_tuIP *puCameraIPs, uint32_t u32NumCameraIPs)
+{
+    uint32_t u32Length;
+    uint32_t u32Drop;
+    uint32_t u32Accept;
+    uint32_t u32PortCheck;
+    uint32_t u32IP;
+    uint32_t n;
+    uint32_t i = 0;
+
+    u32Length = 4 + ((u32NumCameraIPs > 0) ? (u32NumCameraIPs + 2) : 0) + 2 + u32NumPorts + 2;
+    if((u32Length > RXRING_MAX_FILTER_LENGTH) || (u32Length > 255))
+    {
+        return 0;
+    }
+    u32Drop = u32Length - 2;
+    u32Accept = u32Length - 1;
+    u32PortCheck = 4 + ((u32NumCameraIPs > 0) ? (u32NumCameraIPs + 2) : 0);
+
+    // UDP only, and only the first fragment carries the UDP header so drop anything fragmented
+    psFilter[i] = (struct sock_filter)BPF_STMT(BPF_LD | BPF_B | BPF_ABS, 9); i++;
+    psFilter[i] = (struct sock_filter)BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, RXRING_IP_PROTOCOL_UDP, 0, u32Drop - (i + 1)); i++;
+    psFilter[i] = (struct sock_filter)BPF_STMT(BPF_LD | BPF_H | BPF_ABS, 6); i++;
+    psFilter[i] = (struct sock_filter)BPF_JUMP(BPF_JMP | BPF_JSET | BPF_K, 0x3fff, u32Drop - (i + 1), 0); i++;
+
+    // Source address must be one of the cameras
+    if(u32NumCameraIPs > 0)
+    {
+        psFilter[i] = (struct sock_filter)BPF_STMT(BPF_LD | BPF_W | BPF_ABS, 12); i++;
+        for(n = 0; n < u32NumCameraIPs; n++)
+        {
+            u32IP = ((uint32_t)puCameraIPs[n].au8IP[3] << 24) |
+                    ((uint32_t)puCameraIPs[n].au8IP[2] << 16) |
+                    ((uint32_t)puCameraIPs[n].au8IP[1] << 8) |
+                    ((uint32_t)puCameraIPs[n].au8IP[0] << 0);
+            psFilter[i] = (struct sock_filter)BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, u32IP, u32PortCheck - (i + 1), 0); i++;
+        }
+        psFilter[i] = (struct sock_filter)BPF_JUMP(BPF_JMP | BPF_JA, u32Drop - (i + 1), 0, 0); i++;
+    }
+
+    // Destination port must be one of ours, X holds the IP header length
+    psFilter[i] = (struct sock_filter)BPF_STMT(BPF_LDX | BPF_B | BPF_MSH, 0); i++;
+    psFilter[i] = (struct sock_filter)BPF_STMT(BPF_LD | BPF_H | BPF_IND, 2); i++;
+    for(n = 0; n < u32NumPorts; n++)
+    {
+        psFilter[i] = (struct sock_filter)BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, pu16Ports[n], u32Accept - (i + 1), 0); i++;
+    }
+
+    psFilter[i] = (struct sock_filter)BPF_STMT(BPF_RET | BPF_K, 0); i++;
+    psFilter[i] = (struct sock_filter)BPF_STMT(BPF_RET | BPF_K, 0xffff); i++;
+
+    return i;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: RXRING_vProcessBlock
+ *
+ * DESCRIPTION:
+ * Walks the packets of a block, extracting the UDP payloads. Each packet
+ * arrives at the time the kernel stamped it with, moved from the realtime
+ * clock to the monotonic one RTP_u64GetTimeUs uses by an offset taken once
+ * per block.
+ *
+ * RETURNS:
+ * void
+ *
+ ****************************************************************************/
+static void RXRING_vProcessBlock(RXRING_tsInstance *psRing, struct tpacket_block_desc *psBlock, RXRING_tpfPacketCallback prCallback, void *pvContext)
+{
+    struct tpacket_stats_v3 sStats;
+    socklen_t tStatsLength = sizeof(sStats);
+    struct tpacket3_hdr *psHeader;
+    struct sockaddr_ll *psAddr;
+    ORLACO_tuIP uSrcIP;
+    struct timespec sRealTime;
+    uint64_t u64NowUs;
+    uint64_t u64RealNowUs;
+    uint64_t u64TimeUs;
+    uint8_t *pu8IP;
+    uint8_t *pu8UDP;
+    uint32_t u32IPHeaderLength;
+    uint32_t u32UDPLength;
+    uint32_t n;
+
+    if(psBlock->hdr.bh1.block_status & TP_STATUS_LOSING)
+    {
+        if(getsockopt(psRing->iSocket, SOL_PACKET, PACKET_STATISTICS, &sStats, &tStatsLength) == 0)
+        {
+            psRing->u64Drops += sStats.tp_drops;
+        }
+    }
+
+    u64NowUs = RTP_u64GetTimeUs();
+    clock_gettime(CLOCK_REALTIME, &sRealTime);
+    u64RealNowUs = ((uint64_t)sRealTime.tv_sec * 1000000ULL) + ((uint64_t)sRealTime.tv_nsec / 1000ULL);
+
+    psHeader = (struct tpacket3_hdr*)((uint8_t*)psBlock + psBlock->hdr.bh1.offset_to_first_pkt);
+    for(n = 0; n < psBlock->hdr.bh1.num_pkts; n++, psHeader = (struct tpacket3_hdr*)((uint8_t*)psHeader + psHeader->tp_next_offset))
+    {
+        // On loopback every datagram is seen both going out and coming in
+        psAddr = (struct sockaddr_ll*)((uint8_t*)psHeader + TPACKET_ALIGN(sizeof(struct tpacket3_hdr)));
+        if(psAddr->sll_pkttype == PACKET_OUTGOING)
+        {
+            continue;
+        }
+
+        pu8IP = (uint8_t*)psHeader + psHeader->tp_net;
+        u32IPHeaderLength = (pu8IP[0] & 0x0f) * 4;
+        if(psHeader->tp_snaplen < u32IPHeaderLength + RXRING_UDP_HEADER_LENGTH)
+        {
+            continue;
+        }
+
+        pu8UDP = pu8IP + u32IPHeaderLength;
+        u32UDPLength = (pu8UDP[4] << 8) | pu8UDP[5];
+        if((u32UDPLength < RXRING_UDP_HEADER_LENGTH) || (u32IPHeaderLength + u32UDPLength > psHeader->tp_snaplen))
+        {
+            continue;
+        }
+
+        uSrcIP.au8IP[3] = pu8IP[12];
+        uSrcIP.au8IP[2] = pu8IP[13];
+        uSrcIP.au8IP[1] = pu8IP[14];
+        uSrcIP.au8IP[0] = pu8IP[15];
+
+        // Fall back to now for a packet without a stamp, or one the realtime clock has since been stepped past
+        u64TimeUs = ((uint64_t)psHeader->tp_sec * 1000000ULL) + ((uint64_t)psHeader->tp_nsec / 1000ULL);
+        u64TimeUs = ((psHeader->tp_sec != 0) && (u64TimeUs <= u64RealNowUs) && (u64RealNowUs - u64TimeUs < u64NowUs)) ?
+                    u64NowUs - (u64RealNowUs - u64TimeUs) : u64NowUs;
+
+        psRing->u64Packets++;
+        prCallback(pvContext, uSrcIP, (uint16_t)((pu8UDP[0] << 8) | pu8UDP[1]), pu8UDP + RXRING_UDP_HEADER_LENGTH, u32UDPLength - RXRING_UDP_HEADER_LENGTH, u64TimeUs);
+    }
+}
+
+#endif
+
+/****************************************************************************/
+/***        END OF FILE                                                   ***/
+/****************************************************************************/
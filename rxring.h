@@ -0,0 +1,53 @@
+#ifndef RXRING_H
+#define RXRING_H
+
+/****************************************************************************/
+/***        Include files                                                 ***/
+/****************************************************************************/
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "common.h"
+#include "orlaco.h"
+
+/****************************************************************************/
+/***        Macro Definitions                                             ***/
+/****************************************************************************/
+
+#define RXRING_BLOCK_SIZE               (1024 * 1024)       // Must be a multiple of the page size
+#define RXRING_NUM_BLOCKS               32
+#define RXRING_FRAME_SIZE               2048
+#define RXRING_BLOCK_TIMEOUT_MS         10                  // Hand a partly filled block over after this long
+#define RXRING_MAX_FILTER_LENGTH        256                 // BPF instructions
+
+/****************************************************************************/
+/***        Type Definitions                                              ***/
+/****************************************************************************/
+
+// Called for every UDP payload that passed the filter
+typedef void (*RXRING_tpfPacketCallback)(void *pvContext, ORLACO_tuIP uSrcIP, uint16_t u16SrcPort, uint8_t *pu8Data, uint32_t u32Length, uint64_t u64TimeUs);
+
+// A TPACKET_V3 receive ring on an AF_PACKET socket
+typedef struct {
+    int iSocket;
+    uint8_t *pu8Ring;
+    uint32_t u32RingLength;
+    uint32_t u32CurrentBlock;
+    uint64_t u64Packets;
+    uint64_t u64Drops;                              // Packets the kernel dropped because the ring was full
+} RXRING_tsInstance;
+
+/****************************************************************************/
+/***        Exported Functions                                            ***/
+/****************************************************************************/
+
+bool_t RXRING_bOpen(RXRING_tsInstance *psRing, char *pcInterface, uint16_t *pu16Ports, uint32_t u32NumPorts, ORLACO_tuIP *puCameraIPs, uint32_t u32NumCameraIPs, uint16_t u16FanoutGroup);
+void RXRING_vClose(RXRING_tsInstance *psRing);
+bool_t RXRING_bReceive(RXRING_tsInstance *psRing, int iTimeoutMs, RXRING_tpfPacketCallback prCallback, void *pvContext);
+
+#endif // RXRING_H
+
+/****************************************************************************/
+/***        END OF FILE                                                   ***/
+/****************************************************************************/
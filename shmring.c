@@ -0,0 +1,637 @@
+/****************************************************************************
+ *
+ * Copyright 2021 Lee Mitchell <lee@indigopepper.com>
+ * This file is part of OCC (Orlaco Camera Configurator)
+ *
+ * OCC (Orlaco Camera Configurator) is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * OCC (Orlaco Camera Configurator) is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with OCC (Orlaco Camera Configurator).  If not,
+ * see <http://www.gnu.org/licenses/>.
+ *
+ ****************************************************************************/
+
+/****************************************************************************/
+/***        Include files                                                 ***/
+/****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "common.h"
+#include "shmring.h"
+
+#ifndef _WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#ifdef __linux__
+#include <limits.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#endif
+
+/****************************************************************************/
+/***        Macro Definitions                                             ***/
+/****************************************************************************/
+
+/****************************************************************************/
+/***        Type Definitions                                              ***/
+/****************************************************************************/
+
+/****************************************************************************/
+/***        Local Function Prototypes                                     ***/
+/****************************************************************************/
+
+#ifndef _WIN32
+static bool_t SHMRING_bMap(SHMRING_tsInstance *psRing, char *pcName, bool_t bProducer, uint64_t u64Length);
+static bool_t SHMRING_bCheckHeader(SHMRING_tsHeader *psHeader, uint64_t u64MapLength);
+static bool_t SHMRING_bRemap(SHMRING_tsInstance *psRing);
+static void SHMRING_vWait(SHMRING_tsInstance *psRing, uint32_t u32Head, uint32_t u32TimeoutUs);
+static void SHMRING_vWake(SHMRING_tsInstance *psRing);
+#endif
+
+/****************************************************************************/
+/***        Exported Variables                                            ***/
+/****************************************************************************/
+
+/****************************************************************************/
+/***        Local Variables                                               ***/
+/****************************************************************************/
+
+/****************************************************************************/
+/***        Exported Functions                                            ***/
+/****************************************************************************/
+
+#ifndef _WIN32
+
+/****************************************************************************
+ *
+ * NAME: SHMRING_bCreate
+ *
+ * DESCRIPTION:
+ * Creates (or takes over) a shared memory ring as its only producer. Frames
+ * are published into the ring once and any number of consumers map it read
+ * only and use the frames in place.
+ *
+ * RETURNS:
+ * bool_t TRUE if successful, FALSE otherwise
+ *
+ ****************************************************************************/
+bool_t SHMRING_bCreate(SHMRING_tsInstance *psRing, char *pcName, uint32_t u32NumSlots, uint64_t u64DataLength)
+{
+    uint64_t u64SlotsOffset = sizeof(SHMRING_tsHeader);
+    uint64_t u64DataOffset;
+    uint32_t u32Generation;
+
+    memset(psRing, 0, sizeof(SHMRING_tsInstance));
+    psRing->iFd = -1;
+
+    if((u32NumSlots == 0) || (u64DataLength == 0))
+    {
+        return FALSE;
+    }
+
+    // Keep the frame data page aligned
+    u64DataOffset = u64SlotsOffset + ((uint64_t)u32NumSlots * sizeof(SHMRING_tsSlot));
+    u64DataOffset = (u64DataOffset + 4095) & ~(uint64_t)4095;
+
+    if(!SHMRING_bMap(psRing, pcName, TRUE, u64DataOffset + u64DataLength))
+    {
+        return FALSE;
+    }
+
+    psRing->psHeader = (SHMRING_tsHeader*)psRing->pu8Map;
+    psRing->psSlots = (SHMRING_tsSlot*)(psRing->pu8Map + u64SlotsOffset);
+    psRing->pu8Data = psRing->pu8Map + u64DataOffset;
+
+    // A ring left behind by an earlier producer may still have consumers, the new generation tells them to start over
+    u32Generation = psRing->u32Generation + 1;
+    __atomic_store_n(&psRing->psHeader->u32Generation, 0, __ATOMIC_RELEASE);
+
+    psRing->psHeader->u32Magic = SHMRING_MAGIC;
+    psRing->psHeader->u32Version = SHMRING_VERSION;
+    psRing->psHeader->u32NumSlots = u32NumSlots;
+    psRing->psHeader->u64DataLength = u64DataLength;
+    psRing->psHeader->u64SlotsOffset = u64SlotsOffset;
+    psRing->psHeader->u64DataOffset = u64DataOffset;
+    __atomic_store_n(&psRing->psHeader->u64Head, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&psRing->psHeader->u64ReservePos, 0, __ATOMIC_RELAXED);
+    memset(psRing->psSlots, 0, (size_t)u32NumSlots * sizeof(SHMRING_tsSlot));
+
+    __atomic_store_n(&psRing->psHeader->u32Generation, (u32Generation == 0) ? 1 : u32Generation, __ATOMIC_RELEASE);
+    SHMRING_vWake(psRing);
+
+    return TRUE;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: SHMRING_bPublish
+ *
+ * DESCRIPTION:
+ * Copies a frame into the ring and makes it visible to consumers. Frames
+ * are kept contiguous so consumers never have to deal with wrapping.
+ * Never blocks, slow consumers lose the oldest frames instead.
+ *
+ * RETURNS:
+ * bool_t TRUE if published, FALSE if the frame doesn't fit in the ring
+ *
+ ****************************************************************************/
+bool_t SHMRING_bPublish(SHMRING_tsInstance *psRing, RTP_tsFrame *psFrame)
+{
+    SHMRING_tsHeader *psHeader = psRing->psHeader;
+    SHMRING_tsSlot *psSlot;
+    uint64_t u64DataLength = psHeader->u64DataLength;
+    uint64_t u64Head;
+    uint64_t u64Pos;
+
+    if((psFrame->u32Length == 0) || (psFrame->u32Length > u64DataLength))
+    {
+        return FALSE;
+    }
+
+    u64Pos = psRing->u64WritePos;
+    if((u64Pos % u64DataLength) + psFrame->u32Length > u64DataLength)
+    {
+        u64Pos += u64DataLength - (u64Pos % u64DataLength);
+    }
+
+    // Claim the space before overwriting it so that consumers can tell their frame has gone
+    __atomic_store_n(&psHeader->u64ReservePos, u64Pos + psFrame->u32Length, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    memcpy(psRing->pu8Data + (u64Pos % u64DataLength), psFrame->pu8Data, psFrame->u32Length);
+
+    u64Head = __atomic_load_n(&psHeader->u64Head, __ATOMIC_RELAXED);
+    psSlot = &psRing->psSlots[u64Head % psHeader->u32NumSlots];
+
+    __atomic_store_n(&psSlot->u64Seq, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    psSlot->u64DataPos = u64Pos;
+    psSlot->u64ArrivalTimeUs = psFrame->u64ArrivalTimeUs;
+    psSlot->u32Length = psFrame->u32Length;
+    psSlot->u32SrcIP = psFrame->uSrcIP.u32IP;
+    psSlot->u32Ssrc = psFrame->u32Ssrc;
+    psSlot->u32Timestamp = psFrame->u32Timestamp;
+    psSlot->u16Width = psFrame->u16Width;
+    psSlot->u16Height = psFrame->u16Height;
+    psSlot->u8Codec = (uint8_t)psFrame->eCodec;
+    psSlot->u8KeyFrame = psFrame->bKeyFrame;
+    __atomic_store_n(&psSlot->u64Seq, u64Head + 1, __ATOMIC_RELEASE);
+
+    psRing->u64WritePos = u64Pos + psFrame->u32Length;
+
+    __atomic_store_n(&psHeader->u64Head, u64Head + 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&psHeader->u32Notify, (uint32_t)(u64Head + 1), __ATOMIC_RELEASE);
+    SHMRING_vWake(psRing);
+
+    return TRUE;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: SHMRING_bAttach
+ *
+ * DESCRIPTION:
+ * Maps an existing ring read only as a consumer, starting with the next
+ * frame to be published. Fails quietly if the ring doesn't exist yet.
+ *
+ * RETURNS:
+ * bool_t TRUE if successful, FALSE otherwise
+ *
+ ****************************************************************************/
+bool_t SHMRING_bAttach(SHMRING_tsInstance *psRing, char *pcName)
+{
+    memset(psRing, 0, sizeof(SHMRING_tsInstance));
+    psRing->iFd = -1;
+
+    if(!SHMRING_bMap(psRing, pcName, FALSE, 0))
+    {
+        return FALSE;
+    }
+
+    psRing->psHeader = (SHMRING_tsHeader*)psRing->pu8Map;
+    if(!SHMRING_bCheckHeader(psRing->psHeader, psRing->u64MapLength))
+    {
+        printf("Error: %s isn't a frame ring in %s\n", pcName, __FUNCTION__);
+        SHMRING_vClose(psRing, FALSE);
+        return FALSE;
+    }
+
+    psRing->psSlots = (SHMRING_tsSlot*)(psRing->pu8Map + psRing->psHeader->u64SlotsOffset);
+    psRing->pu8Data = psRing->pu8Map + psRing->psHeader->u64DataOffset;
+    psRing->u32Generation = __atomic_load_n(&psRing->psHeader->u32Generation, __ATOMIC_ACQUIRE);
+    psRing->u64ReadSeq = __atomic_load_n(&psRing->psHeader->u64Head, __ATOMIC_ACQUIRE);
+
+    return TRUE;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: SHMRING_bNext
+ *
+ * DESCRIPTION:
+ * Gets the next frame for a consumer, waiting up to iTimeoutMs for one to
+ * be published. psFrame->pu8Data points straight into the shared memory,
+ * so after using the data call SHMRING_bIsValid() to check the producer
+ * didn't overwrite it meanwhile.
+ *
+ * RETURNS:
+ * bool_t TRUE if a frame was returned, FALSE on timeout
+ *
+ ****************************************************************************/
+bool_t SHMRING_bNext(SHMRING_tsInstance *psRing, int iTimeoutMs, RTP_tsFrame *psFrame)
+{
+    SHMRING_tsHeader *psHeader = psRing->psHeader;
+    SHMRING_tsSlot *psSlot;
+    SHMRING_tsSlot sSlot;
+    uint64_t u64DeadlineUs = RTP_u64GetTimeUs() + ((uint64_t)iTimeoutMs * 1000ULL);
+    uint64_t u64TimeUs;
+    uint64_t u64Head;
+    uint64_t u64Seq;
+    uint32_t u32Generation;
+
+    while(1)
+    {
+        u32Generation = __atomic_load_n(&psHeader->u32Generation, __ATOMIC_ACQUIRE);
+        if(u32Generation != psRing->u32Generation)
+        {
+            if((u32Generation != 0) && !SHMRING_bRemap(psRing))
+            {
+                // Not usable yet, keep waiting for the producer
+                u32Generation = 0;
+            }
+            else
+            {
+                // The producer restarted the ring, pick up from its new start
+                psRing->u32Generation = u32Generation;
+                psRing->u64ReadSeq = 0;
+                psHeader = psRing->psHeader;
+            }
+        }
+
+        u64Head = __atomic_load_n(&psHeader->u64Head, __ATOMIC_ACQUIRE);
+        if((u32Generation != 0) && (psRing->u64ReadSeq < u64Head))
+        {
+            if(u64Head - psRing->u64ReadSeq > psHeader->u32NumSlots)
+            {
+                psRing->u64Overruns += u64Head - psHeader->u32NumSlots - psRing->u64ReadSeq;
+                psRing->u64ReadSeq = u64Head - psHeader->u32NumSlots;
+            }
+
+            // Copy the descriptor and check it didn't change while being copied
+            psSlot = &psRing->psSlots[psRing->u64ReadSeq % psHeader->u32NumSlots];
+            u64Seq = __atomic_load_n(&psSlot->u64Seq, __ATOMIC_ACQUIRE);
+            memcpy(&sSlot, psSlot, sizeof(SHMRING_tsSlot));
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+            if((u64Seq != psRing->u64ReadSeq + 1) || (__atomic_load_n(&psSlot->u64Seq, __ATOMIC_RELAXED) != u64Seq))
+            {
+                psRing->u64Overruns++;
+                psRing->u64ReadSeq++;
+                continue;
+            }
+            psRing->u64ReadSeq++;
+
+            psFrame->eCodec = (RTP_teCodec)sSlot.u8Codec;
+            psFrame->uSrcIP.u32IP = sSlot.u32SrcIP;
+            psFrame->u32Ssrc = sSlot.u32Ssrc;
+            psFrame->u32Timestamp = sSlot.u32Timestamp;
+            psFrame->u64FirstPacketTimeUs = sSlot.u64ArrivalTimeUs;
+            psFrame->u64ArrivalTimeUs = sSlot.u64ArrivalTimeUs;
+            psFrame->u16Width = sSlot.u16Width;
+            psFrame->u16Height = sSlot.u16Height;
+            psFrame->bKeyFrame = sSlot.u8KeyFrame;
+            psFrame->u32Length = sSlot.u32Length;
+            psFrame->pu8Data = psRing->pu8Data + (sSlot.u64DataPos % psHeader->u64DataLength);
+            psRing->u64LastDataPos = sSlot.u64DataPos;
+
+            if(!SHMRING_bIsValid(psRing))
+            {
+                psRing->u64Overruns++;
+                continue;
+            }
+
+            return TRUE;
+        }
+
+        u64TimeUs = RTP_u64GetTimeUs();
+        if(u64TimeUs >= u64DeadlineUs)
+        {
+            return FALSE;
+        }
+        SHMRING_vWait(psRing, (uint32_t)u64Head, (uint32_t)(u64DeadlineUs - u64TimeUs));
+    }
+}
+
+
+/****************************************************************************
+ *
+ * NAME: SHMRING_bIsValid
+ *
+ * DESCRIPTION:
+ * Checks that the data of the frame last returned by SHMRING_bNext()
+ * hasn't started to be overwritten by the producer
+ *
+ * RETURNS:
+ * bool_t TRUE if the frame data is still intact
+ *
+ ****************************************************************************/
+bool_t SHMRING_bIsValid(SHMRING_tsInstance *psRing)
+{
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+    if(__atomic_load_n(&psRing->psHeader->u32Generation, __ATOMIC_ACQUIRE) != psRing->u32Generation)
+    {
+        return FALSE;
+    }
+
+    return (__atomic_load_n(&psRing->psHeader->u64ReservePos, __ATOMIC_ACQUIRE) <= psRing->u64LastDataPos + psRing->psHeader->u64DataLength);
+}
+
+
+/****************************************************************************
+ *
+ * NAME: SHMRING_vClose
+ *
+ * DESCRIPTION:
+ * Unmaps a ring, the producer can also remove its name
+ *
+ * RETURNS:
+ * void
+ *
+ ****************************************************************************/
+void SHMRING_vClose(SHMRING_tsInstance *psRing, bool_t bUnlink)
+{
+    if(psRing->pu8Map != NULL)
+    {
+        munmap(psRing->pu8Map, psRing->u64MapLength);
+        psRing->pu8Map = NULL;
+    }
+
+    if(psRing->iFd >= 0)
+    {
+        close(psRing->iFd);
+        psRing->iFd = -1;
+    }
+
+    if(bUnlink && (psRing->acName[0] != '\0'))
+    {
+        shm_unlink(psRing->acName);
+    }
+    psRing->acName[0] = '\0';
+}
+
+#else
+
+bool_t SHMRING_bCreate(SHMRING_tsInstance *psRing, char *pcName, uint32_t u32NumSlots, uint64_t u64DataLength)
+{
+    printf("Error: Shared memory frame rings aren't supported on this platform\n");
+    return FALSE;
+}
+
+bool_t SHMRING_bPublish(SHMRING_tsInstance *psRing, RTP_tsFrame *psFrame)
+{
+    return FALSE;
+}
+
+bool_t SHMRING_bAttach(SHMRING_tsInstance *psRing, char *pcName)
+{
+    printf("Error: Shared memory frame rings aren't supported on this platform\n");
+    return FALSE;
+}
+
+bool_t SHMRING_bNext(SHMRING_tsInstance *psRing, int iTimeoutMs, RTP_tsFrame *psFrame)
+{
+    return FALSE;
+}
+
+bool_t SHMRING_bIsValid(SHMRING_tsInstance *psRing)
+{
+    return FALSE;
+}
+
+void SHMRING_vClose(SHMRING_tsInstance *psRing, bool_t bUnlink)
+{
+}
+
+#endif
+
+/****************************************************************************/
+/***        Local Functions                                               ***/
+/****************************************************************************/
+
+#ifndef _WIN32
+
+/****************************************************************************
+ *
+ * NAME: SHMRING_bMap
+ *
+ * DESCRIPTION:
+ * Opens and maps a POSIX shared memory object, read write and sized by the
+ * producer, read only at whatever size it is for consumers
+ *
+ * RETURNS:
+ * bool_t TRUE if successful, FALSE otherwise
+ *
+ ****************************************************************************/
+static bool_t SHMRING_bMap(SHMRING_tsInstance *psRing, char *pcName, bool_t bProducer, uint64_t u64Length)
+{
+    SHMRING_tsHeader *psHeader;
+    struct stat sStat;
+
+    // Shared memory names must start with a single slash
+    snprintf(psRing->acName, sizeof(psRing->acName), "%s%s", (pcName[0] == '/') ? "" : "/", pcName);
+
+    psRing->iFd = shm_open(psRing->acName, bProducer ? (O_RDWR | O_CREAT) : O_RDONLY, 0644);
+    if(psRing->iFd < 0)
+    {
+        // A consumer may well start before the producer, leave it to the caller to decide whether that is an error
+        if(bProducer || (errno != ENOENT)) printf("Error: Can't open shared memory %s in %s\n", psRing->acName, __FUNCTION__);
+        psRing->acName[0] = '\0';
+        return FALSE;
+    }
+
+    if(bProducer)
+    {
+        // Stop the consumers of a ring left behind by an earlier producer before it's resized under them
+        if((fstat(psRing->iFd, &sStat) == 0) && ((uint64_t)sStat.st_size >= sizeof(SHMRING_tsHeader)))
+        {
+            psHeader = (SHMRING_tsHeader*)mmap(NULL, sizeof(SHMRING_tsHeader), PROT_READ | PROT_WRITE, MAP_SHARED, psRing->iFd, 0);
+            if(psHeader != MAP_FAILED)
+            {
+                psRing->u32Generation = __atomic_exchange_n(&psHeader->u32Generation, 0, __ATOMIC_ACQ_REL);
+                munmap(psHeader, sizeof(SHMRING_tsHeader));
+            }
+        }
+
+        if(ftruncate(psRing->iFd, (off_t)u64Length) != 0)
+        {
+            printf("Error: Can't size shared memory %s in %s\n", psRing->acName, __FUNCTION__);
+            SHMRING_vClose(psRing, TRUE);
+            return FALSE;
+        }
+    }
+    else
+    {
+        if(fstat(psRing->iFd, &sStat) != 0)
+        {
+            SHMRING_vClose(psRing, FALSE);
+            return FALSE;
+        }
+        u64Length = (uint64_t)sStat.st_size;
+    }
+
+    psRing->u64MapLength = u64Length;
+    psRing->pu8Map = (uint8_t*)mmap(NULL, (size_t)u64Length, bProducer ? (PROT_READ | PROT_WRITE) : PROT_READ, MAP_SHARED, psRing->iFd, 0);
+    if(psRing->pu8Map == MAP_FAILED)
+    {
+        printf("Error: Can't map shared memory %s in %s\n", psRing->acName, __FUNCTION__);
+        psRing->pu8Map = NULL;
+        SHMRING_vClose(psRing, bProducer);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: SHMRING_bCheckHeader
+ *
+ * DESCRIPTION:
+ * Checks a consumer's mapping holds a ring and all of its slots and data
+ *
+ * RETURNS:
+ * bool_t TRUE if the ring fits in the mapping, FALSE otherwise
+ *
+ ****************************************************************************/
+static bool_t SHMRING_bCheckHeader(SHMRING_tsHeader *psHeader, uint64_t u64MapLength)
+{
+    return ((u64MapLength >= sizeof(SHMRING_tsHeader)) &&
+            (psHeader->u32Magic == SHMRING_MAGIC) &&
+            (psHeader->u32Version == SHMRING_VERSION) &&
+            (psHeader->u32NumSlots != 0) &&
+            (psHeader->u64DataLength != 0) &&
+            (psHeader->u64DataOffset + psHeader->u64DataLength <= u64MapLength) &&
+            (psHeader->u64SlotsOffset + ((uint64_t)psHeader->u32NumSlots * sizeof(SHMRING_tsSlot)) <= psHeader->u64DataOffset)) ? TRUE : FALSE;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: SHMRING_bRemap
+ *
+ * DESCRIPTION:
+ * Maps a consumer's ring again at its current size after the producer
+ * restarted it, as the new producer may have resized it. The old mapping
+ * is kept if the new one can't be used.
+ *
+ * RETURNS:
+ * bool_t TRUE if the ring is mapped at its new size, FALSE otherwise
+ *
+ ****************************************************************************/
+static bool_t SHMRING_bRemap(SHMRING_tsInstance *psRing)
+{
+    struct stat sStat;
+    uint8_t *pu8Map;
+    uint64_t u64Length;
+
+    if(fstat(psRing->iFd, &sStat) != 0)
+    {
+        return FALSE;
+    }
+    u64Length = (uint64_t)sStat.st_size;
+
+    pu8Map = (uint8_t*)mmap(NULL, (size_t)u64Length, PROT_READ, MAP_SHARED, psRing->iFd, 0);
+    if(pu8Map == MAP_FAILED)
+    {
+        return FALSE;
+    }
+
+    if(!SHMRING_bCheckHeader((SHMRING_tsHeader*)pu8Map, u64Length))
+    {
+        munmap(pu8Map, (size_t)u64Length);
+        return FALSE;
+    }
+
+    munmap(psRing->pu8Map, psRing->u64MapLength);
+    psRing->pu8Map = pu8Map;
+    psRing->u64MapLength = u64Length;
+    psRing->psHeader = (SHMRING_tsHeader*)pu8Map;
+    psRing->psSlots = (SHMRING_tsSlot*)(pu8Map + psRing->psHeader->u64SlotsOffset);
+    psRing->pu8Data = pu8Map + psRing->psHeader->u64DataOffset;
+
+    return TRUE;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: SHMRING_vWait
+ *
+ * DESCRIPTION:
+ * Sleeps until the producer publishes past u32Head or the timeout expires
+ *
+ * RETURNS:
+ * void
+ *
+ ****************************************************************************/
+static void SHMRING_vWait(SHMRING_tsInstance *psRing, uint32_t u32Head, uint32_t u32TimeoutUs)
+{
+#ifdef __linux__
+    struct timespec sTimeout;
+
+    sTimeout.tv_sec = u32TimeoutUs / 1000000;
+    sTimeout.tv_nsec = (long)(u32TimeoutUs % 1000000) * 1000;
+    syscall(SYS_futex, &psRing->psHeader->u32Notify, FUTEX_WAIT, u32Head, &sTimeout, NULL, 0);
+#else
+    (void)u32Head;
+    usleep((u32TimeoutUs < 1000) ? u32TimeoutUs : 1000);
+#endif
+}
+
+
+/****************************************************************************
+ *
+ * NAME: SHMRING_vWake
+ *
+ * DESCRIPTION:
+ * Wakes any consumers waiting for a frame
+ *
+ * RETURNS:
+ * void
+ *
+ ****************************************************************************/
+static void SHMRING_vWake(SHMRING_tsInstance *psRing)
+{
+#ifdef __linux__
+    syscall(SYS_futex, &psRing->psHeader->u32Notify, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+#else
+    (void)psRing;
+#endif
+}
+
+#endif
+
+/****************************************************************************/
+/***        END OF FILE                                                   ***/
+/****************************************************************************/
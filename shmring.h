@@ -0,0 +1,95 @@
+#ifndef SHMRING_H
+#define SHMRING_H
+
+/****************************************************************************/
+/***        Include files                                                 ***/
+/****************************************************************************/
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "common.h"
+#include "rtp.h"
+
+/****************************************************************************/
+/***        Macro Definitions                                             ***/
+/****************************************************************************/
+
+#define SHMRING_MAGIC                   0x5243434f          // "OCCR"
+#define SHMRING_VERSION                 1
+#define SHMRING_MAX_NAME_LENGTH         64
+#define SHMRING_DEFAULT_NUM_SLOTS       256
+#define SHMRING_DEFAULT_DATA_LENGTH     (32 * 1024 * 1024)
+#define SHMRING_CACHE_LINE              64
+
+/****************************************************************************/
+/***        Type Definitions                                              ***/
+/****************************************************************************/
+
+// Shared memory layout: header, then u32NumSlots slots, then u64DataLength bytes of frame data.
+// Fields written while consumers may be reading are only accessed atomically.
+typedef struct {
+    uint32_t u32Magic;
+    uint32_t u32Version;
+    uint32_t u32Generation;                         // Changes whenever a producer (re)starts the ring
+    uint32_t u32NumSlots;
+    uint64_t u64DataLength;
+    uint64_t u64SlotsOffset;
+    uint64_t u64DataOffset;
+    uint8_t au8Pad1[SHMRING_CACHE_LINE - 40];
+
+    uint64_t u64Head;                               // Sequence number of the next frame to be published
+    uint32_t u32Notify;                             // Low bits of u64Head, for futex waits
+    uint8_t au8Pad2[SHMRING_CACHE_LINE - 12];
+
+    uint64_t u64ReservePos;                         // Data below this position minus u64DataLength may have been overwritten
+    uint8_t au8Pad3[SHMRING_CACHE_LINE - 8];
+} SHMRING_tsHeader;
+
+// Frame descriptor, u64Seq is the frame's sequence number plus one once the slot is complete, 0 while it changes
+typedef struct {
+    uint64_t u64Seq;
+    uint64_t u64DataPos;                            // Position of the frame's first byte, the offset in the data area is this modulo u64DataLength
+    uint64_t u64ArrivalTimeUs;
+    uint32_t u32Length;
+    uint32_t u32SrcIP;                              // In ORLACO_tuIP order
+    uint32_t u32Ssrc;
+    uint32_t u32Timestamp;
+    uint16_t u16Width;
+    uint16_t u16Height;
+    uint8_t u8Codec;
+    uint8_t u8KeyFrame;
+    uint8_t au8Pad[18];
+} SHMRING_tsSlot;
+
+typedef struct {
+    int iFd;
+    uint8_t *pu8Map;
+    uint64_t u64MapLength;
+    char acName[SHMRING_MAX_NAME_LENGTH];
+    SHMRING_tsHeader *psHeader;
+    SHMRING_tsSlot *psSlots;
+    uint8_t *pu8Data;
+    uint64_t u64WritePos;                           // Producer only
+    uint64_t u64ReadSeq;                            // Consumer only
+    uint32_t u32Generation;                         // Consumer's last seen, or the one a producer takes over from
+    uint64_t u64LastDataPos;                        // Consumer only, position of the frame last returned
+    uint64_t u64Overruns;                           // Consumer only, frames overwritten before they were read
+} SHMRING_tsInstance;
+
+/****************************************************************************/
+/***        Exported Functions                                            ***/
+/****************************************************************************/
+
+bool_t SHMRING_bCreate(SHMRING_tsInstance *psRing, char *pcName, uint32_t u32NumSlots, uint64_t u64DataLength);
+bool_t SHMRING_bPublish(SHMRING_tsInstance *psRing, RTP_tsFrame *psFrame);
+bool_t SHMRING_bAttach(SHMRING_tsInstance *psRing, char *pcName);
+bool_t SHMRING_bNext(SHMRING_tsInstance *psRing, int iTimeoutMs, RTP_tsFrame *psFrame);
+bool_t SHMRING_bIsValid(SHMRING_tsInstance *psRing);
+void SHMRING_vClose(SHMRING_tsInstance *psRing, bool_t bUnlink);
+
+#endif // SHMRING_H
+
+/****************************************************************************/
+/***        END OF FILE                                                   ***/
+/****************************************************************************/
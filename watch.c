@@ -0,0 +1,303 @@
+/****************************************************************************
+ *
+ * Copyright 2021 Lee Mitchell <lee@indigopepper.com>
+ * This file is part of OCC (Orlaco Camera Configurator)
+ *
+ * OCC (Orlaco Camera Configurator) is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * OCC (Orlaco Camera Configurator) is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with OCC (Orlaco Camera Configurator).  If not,
+ * see <http://www.gnu.org/licenses/>.
+ *
+ ****************************************************************************/
+
+/****************************************************************************/
+/***        Include files                                                 ***/
+/****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "common.h"
+#include "rtp.h"
+#include "watch.h"
+
+/****************************************************************************/
+/***        Macro Definitions                                             ***/
+/****************************************************************************/
+
+/****************************************************************************/
+/***        Type Definitions                                              ***/
+/****************************************************************************/
+
+/****************************************************************************/
+/***        Local Function Prototypes                                     ***/
+/****************************************************************************/
+
+static void WATCH_vTick(WATCH_tsInstance *psWatch, uint32_t u32Tick);
+static void WATCH_vReport(WATCH_tsInstance *psWatch, WATCH_tsCamera *psCamera, ORLACO_tsRegisterWrite *psRead, double dTime);
+
+/****************************************************************************/
+/***        Exported Variables                                            ***/
+/****************************************************************************/
+
+/****************************************************************************/
+/***        Local Variables                                               ***/
+/****************************************************************************/
+
+/****************************************************************************/
+/***        Exported Functions                                            ***/
+/****************************************************************************/
+
+/****************************************************************************
+ *
+ * NAME: WATCH_bInit
+ *
+ * DESCRIPTION:
+ * Sets up polling of the registers at the given indexes every interval
+ *
+ * RETURNS:
+ * bool_t TRUE if successful, FALSE otherwise
+ *
+ ****************************************************************************/
+bool_t WATCH_bInit(WATCH_tsInstance *psWatch, ORLACO_tsInstance *psOrlaco, uint32_t u32IntervalMs, uint8_t *pu8Indexes, uint16_t u16NumRegisters)
+{
+    uint16_t n;
+
+    memset(psWatch, 0, sizeof(WATCH_tsInstance));
+    psWatch->psOrlaco = psOrlaco;
+    psWatch->u32IntervalMs = u32IntervalMs;
+
+    if((u32IntervalMs == 0) || (u16NumRegisters == 0) || (u16NumRegisters > ORLACO_MAX_WRITE_REGISTERS))
+    {
+        printf("Error: Between 1 and %d registers can be watched, at an interval of at least 1 ms, in %s\n", ORLACO_MAX_WRITE_REGISTERS, __FUNCTION__);
+        return FALSE;
+    }
+
+    for(n = 0; n < u16NumRegisters; n++)
+    {
+        if(pu8Indexes[n] >= psOrlaco->u16NumRegisters)
+        {
+            printf("Error: Register index %d is out of range, max is %d in %s\n", pu8Indexes[n], psOrlaco->u16NumRegisters - 1, __FUNCTION__);
+            return FALSE;
+        }
+        psWatch->au8Indexes[n] = pu8Indexes[n];
+    }
+    psWatch->u16NumRegisters = u16NumRegisters;
+
+    return TRUE;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: WATCH_bAddCamera
+ *
+ * DESCRIPTION:
+ * Adds a camera to be watched, and shares the cameras out over as many
+ * ticks as fit in the interval
+ *
+ * RETURNS:
+ * bool_t TRUE if successful, FALSE if there's no room for the camera
+ *
+ ****************************************************************************/
+bool_t WATCH_bAddCamera(WATCH_tsInstance *psWatch, ORLACO_tuIP uIP)
+{
+    uint32_t u32MaxTicks = psWatch->u32IntervalMs / WATCH_MIN_TICK_MS;
+
+    if(psWatch->u32NumCameras >= WATCH_MAX_CAMERAS)
+    {
+        return FALSE;
+    }
+
+    memset(&psWatch->asCameras[psWatch->u32NumCameras], 0, sizeof(WATCH_tsCamera));
+    psWatch->asCameras[psWatch->u32NumCameras].uIP = uIP;
+    psWatch->u32NumCameras++;
+
+    psWatch->u32NumTicks = (psWatch->u32NumCameras < u32MaxTicks) ? psWatch->u32NumCameras : u32MaxTicks;
+    if(psWatch->u32NumTicks == 0)
+    {
+        psWatch->u32NumTicks = 1;
+    }
+
+    return TRUE;
+}
+
+
+/****************************************************************************
+ *
+ * NAME: WATCH_bService
+ *
+ * DESCRIPTION:
+ * Runs the next tick if it's due. Should be called at least as often as
+ * *pu32NextMs asks. A tick that's fallen more than an interval behind is
+ * run late rather than being caught up with a burst of the ticks missed.
+ *
+ * RETURNS:
+ * bool_t TRUE if a tick was run, FALSE otherwise.
+ * *pu32NextMs is set to the time until the next tick is due.
+ *
+ ****************************************************************************/
+bool_t WATCH_bService(WATCH_tsInstance *psWatch, uint32_t *pu32NextMs)
+{
+    uint64_t u64TickUs = (uint64_t)psWatch->u32IntervalMs * 1000ULL / psWatch->u32NumTicks;
+    uint64_t u64TimeUs = RTP_u64GetTimeUs();
+    bool_t bTicked = FALSE;
+
+    if(psWatch->u64StartUs == 0)
+    {
+        psWatch->u64StartUs = u64TimeUs;
+        psWatch->u64NextUs = u64TimeUs;
+    }
+
+    if(u64TimeUs >= psWatch->u64NextUs)
+    {
+        WATCH_vTick(psWatch, psWatch->u32Tick);
+        psWatch->u32Tick = (psWatch->u32Tick + 1) % psWatch->u32NumTicks;
+        psWatch->u64NextUs += u64TickUs;
+
+        u64TimeUs = RTP_u64GetTimeUs();
+        if(u64TimeUs > psWatch->u64NextUs + (uint64_t)psWatch->u32IntervalMs * 1000ULL)
+        {
+            psWatch->u64NextUs = u64TimeUs;
+        }
+        bTicked = TRUE;
+    }
+
+    if(pu32NextMs != NULL)
+    {
+        *pu32NextMs = (psWatch->u64NextUs > u64TimeUs) ? (uint32_t)((psWatch->u64NextUs - u64TimeUs + 999) / 1000) : 0;
+    }
+
+    return bTicked;
+}
+
+/****************************************************************************/
+/***        Local Functions                                               ***/
+/****************************************************************************/
+
+/****************************************************************************
+ *
+ * NAME: WATCH_vTick
+ *
+ * DESCRIPTION:
+ * Reads the registers of the cameras on the tick, all at once, and reports
+ * what changed
+ *
+ * RETURNS:
+ * void
+ *
+ ****************************************************************************/
+static void WATCH_vTick(WATCH_tsInstance *psWatch, uint32_t u32Tick)
+{
+    ORLACO_tsRegisterWrite asReads[WATCH_MAX_CAMERAS];
+    WATCH_tsCamera *apsCameras[WATCH_MAX_CAMERAS];
+    uint32_t u32NumReads = 0;
+    double dTime;
+    uint32_t n;
+    uint16_t i;
+
+    for(n = u32Tick; n < psWatch->u32NumCameras; n += psWatch->u32NumTicks)
+    {
+        memset(&asReads[u32NumReads], 0, sizeof(ORLACO_tsRegisterWrite));
+        asReads[u32NumReads].uIP = psWatch->asCameras[n].uIP;
+        for(i = 0; i < psWatch->u16NumRegisters; i++)
+        {
+            asReads[u32NumReads].au16Addresses[i] = psWatch->psOrlaco->psRegisters[psWatch->au8Indexes[i]].u16Address;
+        }
+        asReads[u32NumReads].u16NumRegisters = psWatch->u16NumRegisters;
+        apsCameras[u32NumReads] = &psWatch->asCameras[n];
+        u32NumReads++;
+    }
+
+    if(u32NumReads == 0)
+    {
+        return;
+    }
+
+    ORLACO_bGetRegistersPipelined(psWatch->psOrlaco, asReads, u32NumReads);
+
+    dTime = (double)(RTP_u64GetTimeUs() - psWatch->u64StartUs) / 1000000.0;
+    for(n = 0; n < u32NumReads; n++)
+    {
+        WATCH_vReport(psWatch, apsCameras[n], &asReads[n], dTime);
+    }
+    fflush(stdout);
+}
+
+
+/****************************************************************************
+ *
+ * NAME: WATCH_vReport
+ *
+ * DESCRIPTION:
+ * Prints a line for each register of a camera whose value has changed since
+ * it was last read, every register the first time, and a line when the
+ * camera stops or starts answering
+ *
+ * RETURNS:
+ * void
+ *
+ ****************************************************************************/
+static void WATCH_vReport(WATCH_tsInstance *psWatch, WATCH_tsCamera *psCamera, ORLACO_tsRegisterWrite *psRead, double dTime)
+{
+    ORLACO_tsRegisterValue *psRegister;
+    char acIP[16];
+    char acWas[8];
+    uint16_t i;
+
+    sprintf(acIP, "%d.%d.%d.%d", psCamera->uIP.au8IP[3], psCamera->uIP.au8IP[2], psCamera->uIP.au8IP[1], psCamera->uIP.au8IP[0]);
+
+    if(!psRead->bOk)
+    {
+        if(psCamera->bResponding || !psCamera->bPolled)
+        {
+            printf("{\"time\":%.3f,\"camera\":\"%s\",\"responding\":false}\n", dTime, acIP);
+        }
+        psCamera->bResponding = FALSE;
+        psCamera->bPolled = TRUE;
+        return;
+    }
+
+    if(!psCamera->bResponding && psCamera->bPolled)
+    {
+        printf("{\"time\":%.3f,\"camera\":\"%s\",\"responding\":true}\n", dTime, acIP);
+    }
+    psCamera->bResponding = TRUE;
+    psCamera->bPolled = TRUE;
+
+    for(i = 0; i < psRead->u16NumRegisters; i++)
+    {
+        if(psCamera->bKnown && (psCamera->au8Values[i] == psRead->au8Values[i]))
+        {
+            continue;
+        }
+
+        psRegister = &psWatch->psOrlaco->psRegisters[psWatch->au8Indexes[i]];
+        if(psCamera->bKnown)
+        {
+            sprintf(acWas, "%u", psCamera->au8Values[i]);
+        }
+        else
+        {
+            strcpy(acWas, "null");
+        }
+        printf("{\"time\":%.3f,\"camera\":\"%s\",\"register\":%u,\"address\":\"0x%04x\",\"name\":\"%s\",\"value\":%u,\"was\":%s}\n",
+               dTime, acIP, psWatch->au8Indexes[i], psRegister->u16Address, psRegister->pcDescription, psRead->au8Values[i], acWas);
+        psCamera->au8Values[i] = psRead->au8Values[i];
+        psWatch->u32Changes++;
+    }
+    psCamera->bKnown = TRUE;
+}
+
+/****************************************************************************/
+/***        END OF FILE                                                   ***/
+/****************************************************************************/
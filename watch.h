@@ -0,0 +1,64 @@
+#ifndef WATCH_H
+#define WATCH_H
+
+/****************************************************************************/
+/***        Include files                                                 ***/
+/****************************************************************************/
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "common.h"
+#include "orlaco.h"
+
+/****************************************************************************/
+/***        Macro Definitions                                             ***/
+/****************************************************************************/
+
+#define WATCH_MAX_CAMERAS               64
+#define WATCH_MIN_TICK_MS               20                  // Ticks spread over the interval are no closer together than this
+
+/****************************************************************************/
+/***        Type Definitions                                              ***/
+/****************************************************************************/
+
+typedef struct {
+    ORLACO_tuIP uIP;
+    uint8_t au8Values[ORLACO_MAX_WRITE_REGISTERS];  // As last printed
+    bool_t bKnown;                                  // au8Values has been read at least once
+    bool_t bPolled;
+    bool_t bResponding;                             // To the last poll
+} WATCH_tsCamera;
+
+// Polls the same registers of several cameras every interval over the one
+// socket, printing only the values that changed as NDJSON. The cameras are
+// shared out over ticks spread evenly across the interval, and each tick
+// reads its share with one pipelined request per camera, so the load on the
+// host and the network is the same from one moment to the next.
+typedef struct {
+    ORLACO_tsInstance *psOrlaco;
+    WATCH_tsCamera asCameras[WATCH_MAX_CAMERAS];
+    uint32_t u32NumCameras;
+    uint8_t au8Indexes[ORLACO_MAX_WRITE_REGISTERS]; // Into the register table
+    uint16_t u16NumRegisters;
+    uint32_t u32IntervalMs;
+    uint32_t u32NumTicks;                           // Per interval, camera n is read on tick n % u32NumTicks
+    uint32_t u32Tick;                               // Next to run
+    uint64_t u64NextUs;                             // When it's due, on the RTP_u64GetTimeUs clock
+    uint64_t u64StartUs;
+    uint32_t u32Changes;
+} WATCH_tsInstance;
+
+/****************************************************************************/
+/***        Exported Functions                                            ***/
+/****************************************************************************/
+
+bool_t WATCH_bInit(WATCH_tsInstance *psWatch, ORLACO_tsInstance *psOrlaco, uint32_t u32IntervalMs, uint8_t *pu8Indexes, uint16_t u16NumRegisters);
+bool_t WATCH_bAddCamera(WATCH_tsInstance *psWatch, ORLACO_tuIP uIP);
+bool_t WATCH_bService(WATCH_tsInstance *psWatch, uint32_t *pu32NextMs);
+
+#endif // WATCH_H
+
+/****************************************************************************/
+/***        END OF FILE                                                   ***/
+/****************************************************************************/